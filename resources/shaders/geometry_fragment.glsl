@@ -27,32 +27,54 @@ layout ( location = 0 ) in Vertex_Out {
 	vec3 position;    // Fragment interpolated World-space position
 	vec2 texture_uv;  // Fragment interpolated texture UV
 	mat3 TBN;         // Fragment interpolated Tangent-Bitangent-Normal matrix (Tangent-space -> World-space transformation)
+	flat uint material_id;  // Same for the whole draw
 } fragment_in;
 
 layout ( location = 0 ) out vec3 gbuffer_position;        // G-Buffer Position texture attachment
 layout ( location = 1 ) out vec3 gbuffer_normal;          // G-Buffer Normal texture attachment
 layout ( location = 2 ) out vec4 gbuffer_color_specular;  // G-Buffer Color/Specular texture attachment
+layout ( location = 3 ) out uint gbuffer_material;        // G-Buffer Material texture attachment
 
-// Material textures:
-uniform sampler2D texture_diffuse0;
-uniform sampler2D texture_normal0;
-uniform sampler2D texture_specular0;
+// Texture array pools, see `Texture_Array_Pool`.  Unit N holds pool N.
+#define MAX_TEXTURE_ARRAY_POOLS 8
+layout ( binding = 0 ) uniform sampler2DArray texture_pools[ MAX_TEXTURE_ARRAY_POOLS ];
+
+// Parameters of all materials, indexed by the instance's material ID (see `Renderer_Material_Parameters`).
+struct Material_Parameters {
+	uint diffuse;       // Texture: ( texture array pool << 16 ) | layer
+	uint normal_map;    // Same as above
+	uint specular_map;  // Same as above
+	float shininess_exponent;
+};
+
+layout ( std430, binding = 4 ) readonly buffer Materials {
+	Material_Parameters materials[];
+} ssbo_materials;
+
+// All instances of a draw have the same material, so the pool index is dynamically uniform.
+vec4 SampleMaterialTexture( uint texture_reference, vec2 texture_uv ) {
+	uint pool = texture_reference >> 16;
+	float layer = float( texture_reference & 0xFFFFu );
+	return texture( texture_pools[ pool ], vec3( texture_uv, layer ) );
+}
 
 void main()
 {
+	Material_Parameters material = ssbo_materials.materials[ fragment_in.material_id ];
+
 	// Store Fragment XYZ World-space position as RGB color in G-Buffer Position texture.
 	gbuffer_position = fragment_in.position;
 	// gbuffer_position = vec3( 0.0, 1.0, 0.0 );
 
 	// Store Fragment XYZ World-space (normal mapped) normal vector as RGB color in G-Buffer Normal texture.
-	vec3 tangent_normal = texture( texture_normal0, fragment_in.texture_uv ).rgb;
+	vec3 tangent_normal = SampleMaterialTexture( material.normal_map, fragment_in.texture_uv ).rgb;
 	tangent_normal = tangent_normal * 2.0 - 1.0;  // [0; 1] -> [-1; 1]
 	vec3 world_normal = normalize( fragment_in.TBN * tangent_normal );  // Tangent-space -> World-space
     gbuffer_normal = world_normal;
     // gbuffer_normal = vec3( 0.0, 0.0, 1.0 );
 
     // Store Fragment RGB diffuse texture color as RGB color in G-Buffer Color/Specular texture.
-    gbuffer_color_specular.rgb = texture( texture_diffuse0, fragment_in.texture_uv ).rgb;
+    gbuffer_color_specular.rgb = SampleMaterialTexture( material.diffuse, fragment_in.texture_uv ).rgb;
     //gbuffer_color_specular.rgb = vec3( 1.0, 0.0, 0.0 );
 
     // Store Fragment Specular intensity as Alpha channel value in G-Buffer Color/Specular texture.
@@ -60,5 +82,8 @@ void main()
     // Roughness 1.0 == 0.0 Specular
     // Roughness 0.5 == 0.5 Specular
     // Roughness 0.0 == 1.0 Specular
-    gbuffer_color_specular.a = 1.0 - texture( texture_specular0, fragment_in.texture_uv ).r;
+    gbuffer_color_specular.a = 1.0 - SampleMaterialTexture( material.specular_map, fragment_in.texture_uv ).r;
+
+    // Store Material ID, so the lighting pass can shade all materials at once.
+    gbuffer_material = fragment_in.material_id;
 }
\ No newline at end of file
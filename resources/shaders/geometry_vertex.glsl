@@ -30,24 +30,55 @@ layout ( location = 0 ) out Vertex_Out {
 	vec3 position;    // Fragment interpolated World-space position
 	vec2 texture_uv;  // Fragment interpolated texture UV (no transformations needed)
 	mat3 TBN;         // Fragment interpolated Tangent-Bitangent-Normal matrix (Tangent-space -> World-space transformation)
+	flat uint material_id;  // Same for the whole draw, not interpolated
 } vertex_out;
 
-// Per-mesh
-uniform mat4 model;          // Local (Object) -> World space
-uniform mat3 normal_matrix;  // mat3( transpose( inverse( model ) ) ) - Correction matrix for non-uniform scaling
+// Per-instance, kept by the renderer for every render proxy and only re-uploaded when it changes (see `Renderer_Instance_Data`).
+struct Instance_Data {
+	mat4 model;             // Local (Object) -> World space
+	vec4 normal_matrix[3];  // Columns of mat3( transpose( inverse( model ) ) ) - Correction matrix for non-uniform scaling. Padded to vec4 for std430.
+	uint material_id;       // Index into `Materials`, see `geometry_fragment.glsl`.
+};
 
-// Per-material
-uniform mat4 view;           // World -> View (Camera/Eye) space
-uniform mat4 projection;     // View -> Clip space [-1.0; 1.0] (-> Screen space [1920; 1080])
+layout ( std430, binding = 0 ) readonly buffer Instances {
+	Instance_Data instances[];
+};
+
+// Written by the renderer for every frame: where the visible instances are in `instances`, in the sorted render queue order.
+// Indexed with `gl_BaseInstance + gl_InstanceID`: base instance is the batch's first command in the render queue.
+layout ( std430, binding = 5 ) readonly buffer Instance_Indices {
+	uint instance_indices[];
+};
+
+// Same for every draw of a frame, see `Renderer_Frame_Constants`.
+layout ( std140, binding = 0 ) uniform Frame_Constants {
+	mat4 view;                     // World -> View (Camera/Eye) space
+	mat4 projection;               // View -> Clip space [-1.0; 1.0] (-> Screen space [1920; 1080])
+	mat4 view_projection;          // World -> Clip space
+	mat4 inverse_view;
+	mat4 inverse_projection;
+	mat4 inverse_view_projection;
+	vec4 camera_position;          // .xyz: World-space position
+	vec4 ambient;                  // .rgb: ambient light color
+	float time;                    // Seconds since the start
+	float delta_time;              // Seconds since the previous frame
+	vec2 viewport_size;            // In pixels
+} frame;
 
 void main()
 {
+	Instance_Data instance = instances[ instance_indices[ gl_BaseInstance + gl_InstanceID ] ];
+	mat4 model = instance.model;
+	mat3 normal_matrix = mat3( instance.normal_matrix[0].xyz, instance.normal_matrix[1].xyz, instance.normal_matrix[2].xyz );
+
 	/* Position */
 
 	// Transform: Local space -> World space position.
 	vec4 position_xyzw = model * vec4( in_position, 1.0 );
 	vertex_out.position = position_xyzw.xyz;
 
+	vertex_out.material_id = instance.material_id;
+
 	/* Texture UV */
 
 	// Pass as is: no transformations needed.
@@ -63,6 +94,6 @@ void main()
 	vertex_out.TBN = mat3( T, B, N );
 
 	// ... * view * position_xyzw// `* model` is already applied.
-	gl_Position = projection * view * position_xyzw;
+	gl_Position = frame.view_projection * position_xyzw;
 	// gl_Position = vec4(0.0, 0.0, 0.5, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 460 core
+// Positional lights' markers, see `light_markers.cpp`.
+
+layout ( location = 0 ) out vec4 out_fragment_color;
+
+uniform vec3 light_color;
+
+void main()
+{
+	out_fragment_color = vec4( light_color, 1.0 );
+}
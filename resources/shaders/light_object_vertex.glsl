@@ -0,0 +1,13 @@
+#version 460 core
+// Positional lights' markers, see `light_markers.cpp`.
+
+layout ( location = 0 ) in vec3 in_position;  // Vertex Local-space position
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	gl_Position = projection * view * model * vec4( in_position, 1.0 );
+}
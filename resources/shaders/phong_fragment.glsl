@@ -60,24 +60,60 @@ layout ( location = 0 ) out vec4 fragment_color;
 uniform sampler2D gbuffer_position;
 uniform sampler2D gbuffer_normal;
 uniform sampler2D gbuffer_diffuse_specular;
+uniform usampler2D gbuffer_material;  // Material ID, 0xFFFF where nothing was drawn
+
+// Same for every draw of a frame, see `Renderer_Frame_Constants`.
+layout ( std140, binding = 0 ) uniform Frame_Constants {
+	mat4 view;                     // World -> View (Camera/Eye) space
+	mat4 projection;               // View -> Clip space [-1.0; 1.0] (-> Screen space [1920; 1080])
+	mat4 view_projection;          // World -> Clip space
+	mat4 inverse_view;
+	mat4 inverse_projection;
+	mat4 inverse_view_projection;
+	vec4 camera_position;          // .xyz: World-space position
+	vec4 ambient;                  // .rgb: ambient light color
+	float time;                    // Seconds since the start
+	float delta_time;              // Seconds since the previous frame
+	vec2 viewport_size;            // In pixels
+} frame;
+
+// Parameters of all materials, indexed by the G-Buffer Material ID (see `Renderer_Material_Parameters`).
+struct Material_Parameters {
+	uint diffuse;        // Textures are only sampled in the geometry pass.
+	uint normal_map;
+	uint specular_map;
+	float shininess_exponent;
+};
 
-uniform vec3 view_position;
-uniform vec3 ambient; // ambient light color
-
-// TODO: Make 'Material' Uniform Buffer
-uniform float shininess_exponent;
+layout ( std430, binding = 4 ) readonly buffer Materials {
+	Material_Parameters materials[];
+} ssbo_materials;
 
 struct Light {
-    vec4 position; // .w: positional -> 1, directional -> 0
+    vec4 position; // .xyz: world position (directional: direction towards the light), .w: attenuation radius
     vec4 color; // .a: intensity
 };
 
-#define MAX_LIGHT_SOURCES 32
-
-layout ( std140, binding = 0 ) uniform Uniform_Buffer_Lights {
-	Light lights[ MAX_LIGHT_SOURCES ];
-	uint lights_count;
-} ubo_lights;
+// See `Shader_Storage_Lights_Header` and the buffers after it in `map.h`.
+layout ( std430, binding = 1 ) readonly buffer Lights {
+	uint directional_lights_count;  // Directional lights come first and light every fragment.
+	uint positional_lights_count;   // Positional lights come after them and only light their clusters.
+	Light lights[];
+} ssbo_lights;
+
+// The view frustum split into a grid of clusters, each with a list of the positional lights that reach it.
+layout ( std430, binding = 2 ) readonly buffer Light_Clusters {
+	mat4 view;             // World -> View space
+	uvec4 dimensions;      // .xyz: clusters on each axis
+	float depth_scale;     // Slice of a view-space depth `d` is `log( d ) * depth_scale + depth_bias`.
+	float depth_bias;
+	vec2 _padding0;        // `clusters` starts at byte 96, same as in C++.
+	uvec2 clusters[];      // .x: offset into `light_indices`, .y: lights count
+} ssbo_clusters;
+
+layout ( std430, binding = 3 ) readonly buffer Light_Indices {
+	uint light_indices[];  // Indices of positional lights, 0 is the first one after the directional lights.
+} ssbo_light_indices;
 
 // sRGB to Linear
 vec3 SRGBToLinear( vec3 srgb ) {
@@ -296,6 +332,29 @@ float BlinnPhongSpecular( vec3 N, vec3 V, vec3 L, float shininess_exponent ) {
 	return pow( max( 0.0, N_dot_H ), shininess_exponent );
 }
 
+// Diffuse and specular light from a single light source.
+// L - Light direction vector, normalized.
+// light_color - .rgb: color, .a: intensity.
+vec3 ShadeLight( vec3 N, vec3 V, vec3 L, vec3 diffuse, float specular, float shininess_exponent, vec4 light_color, float attenuation ) {
+	/* Diffuse light */
+
+	// Convert Specular value to Roughness.
+	// They both describe the same physical property, just from different ends, so we can simply invert the value.
+	float roughness = 1.0 - specular;
+	float diffuse_term = OrenNayarDiffuse( N, V, L, roughness );
+	// float diffuse_term = LambertianDiffuse( N, L );
+	vec3 diffuse_light = diffuse_term * diffuse * light_color.rgb;
+
+	/* Specular highlight */
+
+	// `shininess_exponent` is expected to be at least >= 0!
+	// Either way, the minimal acceptable value is ~8 for Phong and ~16 for Blinn-Phong speculars.
+	float specular_term = PhongSpecular( N, V, L, shininess_exponent );
+	vec3 specular_highlight = specular * specular_term * light_color.rgb;
+
+	return ( diffuse_light + specular_highlight ) * light_color.a * attenuation;
+}
+
 void main()
 {
 	// Sample fragment data from G-Buffer textures.
@@ -304,66 +363,66 @@ void main()
 	vec3 N         = texture( gbuffer_normal,           fragment_in.texture_uv ).rgb; // 3D XYZ Normal direction vector
 	vec3 diffuse   = texture( gbuffer_diffuse_specular, fragment_in.texture_uv ).rgb; // RGB color
 	float specular = texture( gbuffer_diffuse_specular, fragment_in.texture_uv ).a;   // Specular highlight intensity
+	ivec2 material_texel = ivec2( fragment_in.texture_uv * vec2( textureSize( gbuffer_material, 0 ) ) );
+	uint material_id = texelFetch( gbuffer_material, material_texel, 0 ).r;
 
 	//   V - (V)iew direction vector.
-	vec3 V = normalize( view_position - position );
+	vec3 V = normalize( frame.camera_position.xyz - position );
 
 	/* Ambient light */
 
-	vec3 ambient_light = diffuse * ambient;
+	vec3 ambient_light = diffuse * frame.ambient.rgb;
 	vec3 final_color = ambient_light;
 
-	for ( int i = 0; i < ubo_lights.lights_count; i += 1 ) {
-		vec3  light_position  = ubo_lights.lights[ i ].position.xyz;
-		float w               = ubo_lights.lights[ i ].position.w;
-		vec3  light_color     = ubo_lights.lights[ i ].color.rgb;
-		float light_intensity = ubo_lights.lights[ i ].color.a;
-
-		// TODO: Replace if-branching with Vector4 multiplication
-		// vec3 L;  // Light direction vector, normalized.
-		// float light_distance;  // Distance from the fragment to a light source.
-		// if ( w == 1.0 ) {  // .w = 1  =>  Positional light
-		// 	L = normalize( light_position - position );
-		// 	light_distance = length( light_position - position );
-		// } else {  // .w = 0  => Directional light
-		// 	L = normalize( light_position );
-		// 	light_distance = 1.0;  // Directional light illumination (e.g. sunlight) does not fall off over distance.
-		// }
-
-		vec3 L = normalize( mix( light_position, light_position - position, w ) );
-		float light_distance = mix( 1.0, length( light_position - position ), w );
+	// Nothing was drawn here, there is nothing to light.
+	if ( material_id >= uint( ssbo_materials.materials.length() ) ) {
+		fragment_color = vec4( LinearToSRGB( final_color ), 1.0 );
+		return;
+	}
+	float shininess_exponent = ssbo_materials.materials[ material_id ].shininess_exponent;
+
+	// Directional lights reach everything.
+	for ( uint i = 0; i < ssbo_lights.directional_lights_count; i += 1 ) {
+		Light light = ssbo_lights.lights[ i ];
+		vec3 L = normalize( light.position.xyz );
+		// Directional light illumination (e.g. sunlight) does not fall off over distance.
+		final_color += ShadeLight( N, V, L, diffuse, specular, shininess_exponent, light.color, 1.0 );
+	}
+
+	// Positional lights only come from this fragment's cluster.
+	// Tile ( 0, 0 ) is the bottom left corner of the screen, the same as texture UV ( 0, 0 ).
+	uvec3 dimensions = ssbo_clusters.dimensions.xyz;
+	float view_depth = -( ssbo_clusters.view * vec4( position, 1.0 ) ).z;
+	float slice = log( max( view_depth, 1e-4 ) ) * ssbo_clusters.depth_scale + ssbo_clusters.depth_bias;
+	uvec3 cluster_xyz = uvec3(
+		clamp( fragment_in.texture_uv * vec2( dimensions.xy ), vec2( 0.0 ), vec2( dimensions.xy - 1 ) ),
+		clamp( slice, 0.0, float( dimensions.z - 1 ) )
+	);
+	uint cluster_index = ( cluster_xyz.z * dimensions.y + cluster_xyz.y ) * dimensions.x + cluster_xyz.x;
+	uvec2 cluster = ssbo_clusters.clusters[ cluster_index ];
+
+	for ( uint i = 0; i < cluster.y; i += 1 ) {
+		uint light_index = ssbo_lights.directional_lights_count + ssbo_light_indices.light_indices[ cluster.x + i ];
+		Light light = ssbo_lights.lights[ light_index ];
+		vec3 to_light = light.position.xyz - position;
+		float light_distance = length( to_light );
+		vec3 L = to_light / max( light_distance, 1e-4 );
 
 		// `1 / ( distance^2 )` is a close approximation of how a physical light behaves in a real world.
 		// If the light's brightness is seen to be too intense, then the lighting calculations are probably done
 		// in non-linear sRGB color space - with the sRGB gamma curve (~2.2) pre-multiplication - instead of linear space.
 		// It can be fixed using linear interpolation function instead: `1 / ( distance )`.
 		// It makes things work, but should not be really used, as working in an sRGB space is a fundamental mistake.
-		//
-		// In the case of:
-		// Positional  light:  `= 1.0 / ( distance^2 )`
-		// Directional light:  `= 1.0 / ( 1.0^2 ) = 1.0 / 1.0 = 1.0`
-		float attenuation = 1.0 / ( light_distance * light_distance );  // Quadratic, physically accurate
+		float attenuation = 1.0 / max( light_distance * light_distance, 1e-4 );  // Quadratic, physically accurate
 		// float attenuation = 1.0 / ( light_distance );  // Linear, kinda works for incorrect calculations in non-linear sRGB
 
-		/* Diffuse light */
-
-		// Convert Specular value to Roughness.
-		// They both describe the same physical property, just from different ends, so we can simply invert the value.
-		float roughness = 1.0 - specular;
-		float diffuse_term = OrenNayarDiffuse( N, V, L, roughness );
-		// float diffuse_term = LambertianDiffuse( N, L );
-
-		vec3 diffuse_light = diffuse_term * diffuse * light_color;
-		final_color += diffuse_light * light_intensity * attenuation;
-
-		/* Specular highlight */
-
-		// `shininess_exponent` uniform is expected to be at least >= 0!
-		// Either way, the minimal acceptable value is ~8 for Phong and ~16 for Blinn-Phong speculars.
-		float specular_term = PhongSpecular( N, V, L, shininess_exponent );
+		// The light has to reach exactly zero at its radius, or it would be cut off at cluster edges.
+		// Smooth window: `( 1 - ( distance / radius )^4 )^2`.
+		float distance_over_radius = light_distance / light.position.w;
+		float window = clamp( 1.0 - distance_over_radius * distance_over_radius * distance_over_radius * distance_over_radius, 0.0, 1.0 );
+		attenuation *= window * window;
 
-		vec3 specular_highlight = specular * specular_term * light_color;
-		final_color += specular_highlight * light_intensity * attenuation;
+		final_color += ShadeLight( N, V, L, diffuse, specular, shininess_exponent, light.color, attenuation );
 	}
 
 	// TODO: Do it in a separate post-processing pass.
@@ -1,13 +1,31 @@
 #include <stdlib.h> // malloc(), realloc(), free()
 #include <string.h>
+#include <chrono>
+#include <atomic>
 
 #include "allocator.h"
+#include "array.h"
+#include "heap_profiler.h"
+#include "jobs.h"
 
 #undef max
 #define max(a, b) (a > b) ? a : b
 
-static System_Allocator g_qlight_sys_allocator;
+static System_Allocator g_qlight_system_allocator;
+#if defined(QLIGHT_NO_HEAP_PROFILER)
+Allocator *sys_allocator = &g_qlight_system_allocator;
+#else
+// Constant-initialized, so it works for allocations made by static initializers.
+static Tracking_Allocator g_qlight_sys_allocator(&g_qlight_system_allocator);
 Allocator *sys_allocator = &g_qlight_sys_allocator;
+#endif
+
+// Counted on every thread, so a frame can be checked as a whole, job workers and the render thread included.
+static std::atomic< u64 > g_system_allocations_count = 0;
+
+u64 system_allocations_count() {
+	return g_system_allocations_count.load( std::memory_order_relaxed );
+}
 
 u8 *Allocator::request_allocate(u64 count, u64 size, CallerInfo caller) {
 	u8 *allocated = do_allocate(count, size, caller);
@@ -27,10 +45,12 @@ void Allocator::request_deallocate(void *memory_pointer, CallerInfo caller) {
 }
 
 u8 *System_Allocator::do_allocate(u64 count, u64 size, CallerInfo caller) {
+	g_system_allocations_count.fetch_add(1, std::memory_order_relaxed);
 	return (u8 *) malloc(count * size);
 }
 
 u8 *System_Allocator::do_reallocate(void *memory_pointer, u64 old_count, u64 new_count, u64 size, CallerInfo caller) {
+	g_system_allocations_count.fetch_add(1, std::memory_order_relaxed);
 	return (u8 *) realloc(memory_pointer, new_count * size);
 	// u8 *allocated = do_allocate(new_count, size, caller);
 	// memcpy(allocated, memory_pointer, old_count * size);
@@ -64,7 +84,7 @@ void Linear_Allocator::init(void *memory_pointer, u64 size) {
 
 void Linear_Allocator::deinit() {
     AssertMessage(memory_start, "Allocator is not initialized or already deinitialized");
-    free(memory_start);
+    Deallocate(sys_allocator, memory_start);
 
     memory_start = NULL;
     memory_end = NULL;
@@ -83,24 +103,48 @@ u64 Linear_Allocator::occupied() {
 	return cursor - memory_start;
 }
 
-u8 *Linear_Allocator::do_allocate(u64 count, u64 size, CallerInfo caller) {
-    AssertMessage(power_of_2(size), "Allocation size (alignment) must be power of 2");
-    u8 *aligned = (u8 *)(((u64)(cursor + size - 1)) & ~(size - 1));
-    if (aligned + count > memory_end)  return NULL;
+u64 Linear_Allocator::high_water_mark() {
+	return cursor_max - memory_start;
+}
+
+Linear_Allocator_Marker Linear_Allocator::marker() {
+	return Linear_Allocator_Marker { cursor };
+}
+
+void Linear_Allocator::rewind(Linear_Allocator_Marker marker) {
+    AssertMessage(marker.cursor >= memory_start && marker.cursor <= cursor, "Rewinding 'Linear_Allocator' to a marker it is not past");
+    cursor = marker.cursor;
+}
 
-    cursor = aligned + count;
+// Items are aligned to their size's largest power of 2 divisor, at most 16 bytes.
+static u64 item_alignment(u64 size) {
+    u64 alignment = size & (~size + 1);
+    return (alignment == 0 || alignment > 16) ? 16 : alignment;
+}
+
+u8 *Linear_Allocator::allocate_aligned(u64 size, u64 alignment) {
+    AssertMessage(power_of_2(alignment), "Allocation alignment must be power of 2");
+    u8 *aligned = (u8 *)(((u64)(cursor + alignment - 1)) & ~(alignment - 1));
+    if (aligned + size > memory_end)  return NULL;
+
+    cursor = aligned + size;
     cursor_max = max(cursor, cursor_max);
     return aligned;
 }
 
+u8 *Linear_Allocator::do_allocate(u64 count, u64 size, CallerInfo caller) {
+    return allocate_aligned(count * size, item_alignment(size));
+}
+
 u8 *Linear_Allocator::do_reallocate(void *memory_pointer, u64 old_count, u64 new_count, u64 size, CallerInfo caller) {
     if (!memory_pointer)  return do_allocate(new_count, size, caller);
 
-    if (memory_pointer == cursor - old_count && (u64)memory_pointer % size == 0) {
-        u8 *new_cursor = cursor - old_count + new_count;
-
+    u64 old_size = old_count * size;
+    u64 new_size = new_count * size;
+    if ((u8 *)memory_pointer + old_size == cursor) {
+        // The last allocation: grow or shrink it in place.
+        u8 *new_cursor = (u8 *)memory_pointer + new_size;
         if (new_cursor > memory_end)  return NULL;
-        AssertMessage(new_cursor < cursor, "New cursor is below the current cursor for some reason");
 
         cursor = new_cursor;
         cursor_max = max(cursor, cursor_max);
@@ -110,15 +154,433 @@ u8 *Linear_Allocator::do_reallocate(void *memory_pointer, u64 old_count, u64 new
     u8 *new_memory_pointer = do_allocate(new_count, size, caller);
     if (!new_memory_pointer)  return NULL;
 
-    memcpy(new_memory_pointer, memory_pointer, old_count);
+    memcpy(new_memory_pointer, memory_pointer, (old_size < new_size) ? old_size : new_size);
     return new_memory_pointer;
 }
 
 void Linear_Allocator::do_deallocate(void *memory_pointer, CallerInfo caller) {
-    if (!memory_pointer) {
-        reset(false);
+    // Memory comes back with `reset()` or `rewind()`.
+}
+
+constexpr u64 VIRTUAL_ARENA_COMMIT_STEP = 64 * 1024;
+constexpr u64 VIRTUAL_ARENA_HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static u64 round_up(u64 value, u64 step) {
+    return (value + step - 1) / step * step;
+}
+
+bool Virtual_Arena_Allocator::init(u64 reserve_size, bool huge_pages) {
+    AssertMessage(!reservation, "'Virtual_Arena_Allocator' is already initialized");
+    u64 page_size = platform_memory_page_size();
+    this->huge_pages = huge_pages;
+    commit_step = round_up(huge_pages ? VIRTUAL_ARENA_HUGE_PAGE_SIZE : VIRTUAL_ARENA_COMMIT_STEP, page_size);
+
+    // One extra step, so the start can be aligned to it.  Huge pages can only back aligned ranges.
+    reservation_size = round_up(reserve_size, commit_step) + commit_step;
+    reservation = (u8 *)platform_memory_reserve(reservation_size);
+    if (!reservation)  return false;
+
+    memory_start = (u8 *)round_up((u64)reservation, commit_step);
+    reserved_end = memory_start + round_up(reserve_size, commit_step);
+    committed_end = memory_start;
+    cursor = memory_start;
+
+    commits_count = 0;
+    copies_count = 0;
+    bytes_copied = 0;
+    return true;
+}
+
+void Virtual_Arena_Allocator::deinit() {
+    AssertMessage(reservation, "Allocator is not initialized or already deinitialized");
+    platform_memory_release(reservation, reservation_size);
+
+    reservation = NULL;
+    reservation_size = 0;
+    memory_start = NULL;
+    reserved_end = NULL;
+    committed_end = NULL;
+    cursor = NULL;
+}
+
+void Virtual_Arena_Allocator::reset(bool decommit) {
+    AssertMessage(reservation, "Allocator is not initialized or already deinitialized");
+    cursor = memory_start;
+    if (decommit && committed_end > memory_start) {
+        platform_memory_decommit(memory_start, committed_end - memory_start);
+        committed_end = memory_start;
+    }
+}
+
+u64 Virtual_Arena_Allocator::occupied() {
+    return cursor - memory_start;
+}
+
+u64 Virtual_Arena_Allocator::committed() {
+    return committed_end - memory_start;
+}
+
+static bool virtual_arena_commit_up_to(Virtual_Arena_Allocator *arena, u8 *end) {
+    if (end <= arena->committed_end)  return true;
+    if (end > arena->reserved_end)  return false;
+
+    u8 *new_committed_end = arena->memory_start + round_up(end - arena->memory_start, arena->commit_step);
+    if (new_committed_end > arena->reserved_end)  new_committed_end = arena->reserved_end;
+    if (!platform_memory_commit(arena->committed_end, new_committed_end - arena->committed_end, arena->huge_pages))
+        return false;
+
+    arena->committed_end = new_committed_end;
+    arena->commits_count += 1;
+    return true;
+}
+
+u8 *Virtual_Arena_Allocator::do_allocate(u64 count, u64 size, CallerInfo caller) {
+    u64 alignment = item_alignment(size);
+    u8 *aligned = (u8 *)(((u64)(cursor + alignment - 1)) & ~(alignment - 1));
+    u8 *end = aligned + count * size;
+    if (!virtual_arena_commit_up_to(this, end))  return NULL;
+
+    cursor = end;
+    return aligned;
+}
+
+u8 *Virtual_Arena_Allocator::do_reallocate(void *memory_pointer, u64 old_count, u64 new_count, u64 size, CallerInfo caller) {
+    if (!memory_pointer)  return do_allocate(new_count, size, caller);
+
+    u64 old_size = old_count * size;
+    u64 new_size = new_count * size;
+    if ((u8 *)memory_pointer + old_size == cursor) {
+        // The last allocation: the address space after it is reserved, so it grows in place.
+        u8 *new_cursor = (u8 *)memory_pointer + new_size;
+        if (!virtual_arena_commit_up_to(this, new_cursor))  return NULL;
+
+        cursor = new_cursor;
+        return (u8 *)memory_pointer;
+    }
+
+    u8 *new_memory_pointer = do_allocate(new_count, size, caller);
+    if (!new_memory_pointer)  return NULL;
+
+    u64 copy_size = (old_size < new_size) ? old_size : new_size;
+    memcpy(new_memory_pointer, memory_pointer, copy_size);
+    copies_count += 1;
+    bytes_copied += copy_size;
+    return new_memory_pointer;
+}
+
+void Virtual_Arena_Allocator::do_deallocate(void *memory_pointer, CallerInfo caller) {
+    // Memory comes back with `reset()`.
+}
+
+// Adds items one by one and counts how many times growth moved them.
+static f64 virtual_arena_benchmark_grow(Allocator *allocator, u32 items_count, u32 *out_moves, u64 *out_page_faults) {
+    u64 page_faults = platform_page_faults_count();
+    auto start = std::chrono::steady_clock::now();
+
+    Array< u64 > array = array_new< u64 >(allocator, 1);
+    u64 *data = array.data;
+    u32 moves = 0;
+    for (u32 item_idx = 0; item_idx < items_count; item_idx += 1) {
+        array_add(&array, (u64)item_idx);
+        if (array.data != data) {
+            moves += 1;
+            data = array.data;
+        }
+    }
+    array_free(&array);
+
+    f64 milliseconds = std::chrono::duration< f64, std::milli >(std::chrono::steady_clock::now() - start).count();
+    *out_moves = moves;
+    *out_page_faults = platform_page_faults_count() - page_faults;
+    return milliseconds;
+}
+
+Virtual_Arena_Benchmark virtual_arena_benchmark(u32 items_count) {
+    Virtual_Arena_Benchmark result = {};
+    result.items_count = items_count;
+    result.system_milliseconds = virtual_arena_benchmark_grow(sys_allocator, items_count, &result.system_moves, &result.system_page_faults);
+
+    // Doubling growth never needs more than twice the items.
+    u64 reserve_size = (u64)(max(items_count, 1u)) * sizeof(u64) * 2;
+    Virtual_Arena_Allocator arena;
+    if (arena.init(reserve_size, false)) {
+        u32 moves = 0;
+        result.arena_milliseconds = virtual_arena_benchmark_grow(&arena, items_count, &moves, &result.arena_page_faults);
+        result.arena_copies = arena.copies_count;
+        arena.deinit();
+    }
+
+    Virtual_Arena_Allocator huge_arena;
+    if (huge_arena.init(reserve_size, true)) {
+        u32 moves = 0;
+        result.huge_arena_milliseconds = virtual_arena_benchmark_grow(&huge_arena, items_count, &moves, &result.huge_arena_page_faults);
+        result.huge_arena_copies = huge_arena.copies_count;
+        huge_arena.deinit();
+    }
+
+    return result;
+}
+
+// Keeps the chunk's link to the previous chunk, slots start 16 bytes aligned after it.
+constexpr u64 POOL_CHUNK_HEADER_SIZE = 16;
+
+static u8 *&slot_next(u8 *slot) {
+    return *(u8 **)slot;
+}
+
+void Pool_Allocator::init(Allocator *backing_allocator, u64 slot_size, u32 slots_per_chunk) {
+    AssertMessage(backing_allocator, "Trying to initialize 'Pool_Allocator' without a backing allocator");
+    AssertMessage(slots_per_chunk > 0, "'Pool_Allocator' chunks must have at least one slot");
+
+    // A free slot holds the link to the next one.  Slots are 8 bytes aligned, 16 if they are bigger than that.
+    u64 alignment = (slot_size <= 8) ? 8 : 16;
+    this->backing_allocator = backing_allocator;
+    this->slot_size = ((max(slot_size, (u64)sizeof(u8 *))) + alignment - 1) & ~(alignment - 1);
+    this->slots_per_chunk = slots_per_chunk;
+
+    free_list = NULL;
+    chunks = NULL;
+    chunks_count = 0;
+    slots_used = 0;
+}
+
+void Pool_Allocator::deinit() {
+    u8 *chunk = chunks;
+    while (chunk) {
+        u8 *previous = slot_next(chunk);
+        Deallocate(backing_allocator, chunk);
+        chunk = previous;
+    }
+
+    free_list = NULL;
+    chunks = NULL;
+    chunks_count = 0;
+    slots_used = 0;
+}
+
+u64 Pool_Allocator::capacity() {
+    return (u64)chunks_count * slots_per_chunk;
+}
+
+static bool pool_add_chunk(Pool_Allocator *pool) {
+    u64 chunk_size = POOL_CHUNK_HEADER_SIZE + pool->slot_size * pool->slots_per_chunk;
+    u8 *chunk = pool->backing_allocator->do_allocate(1, chunk_size, QL_AllocatorEmptyCaller());
+    if (!chunk)  return false;
+
+    slot_next(chunk) = pool->chunks;
+    pool->chunks = chunk;
+    pool->chunks_count += 1;
+
+    // Linked back to front, so slots are handed out in address order.
+    u8 *slots = chunk + POOL_CHUNK_HEADER_SIZE;
+    for (u32 slot_idx = pool->slots_per_chunk; slot_idx > 0; slot_idx -= 1) {
+        u8 *slot = slots + (slot_idx - 1) * pool->slot_size;
+        slot_next(slot) = pool->free_list;
+        pool->free_list = slot;
+    }
+    return true;
+}
+
+u8 *Pool_Allocator::do_allocate(u64 count, u64 size, CallerInfo caller) {
+    AssertMessage(count * size <= slot_size, "Allocation does not fit into a 'Pool_Allocator' slot");
+    if (count * size > slot_size)  return NULL;
+    if (!free_list && !pool_add_chunk(this))  return NULL;
+
+    u8 *slot = free_list;
+    free_list = slot_next(slot);
+    slots_used += 1;
+    return slot;
+}
+
+u8 *Pool_Allocator::do_reallocate(void *memory_pointer, u64 old_count, u64 new_count, u64 size, CallerInfo caller) {
+    if (!memory_pointer)  return do_allocate(new_count, size, caller);
+    return (new_count * size <= slot_size) ? (u8 *)memory_pointer : NULL;
+}
+
+void Pool_Allocator::do_deallocate(void *memory_pointer, CallerInfo caller) {
+    u8 *slot = (u8 *)memory_pointer;
+    slot_next(slot) = free_list;
+    free_list = slot;
+    slots_used -= 1;
+}
+
+u8 *Pool_Allocator::take_slots(u32 count, u32 *out_taken) {
+    *out_taken = 0;
+    if (!free_list && !pool_add_chunk(this))  return NULL;
+
+    u8 *first = free_list;
+    u8 *last = first;
+    u32 taken = 1;
+    while (taken < count && slot_next(last)) {
+        last = slot_next(last);
+        taken += 1;
+    }
+    free_list = slot_next(last);
+    slot_next(last) = NULL;
+
+    slots_used += taken;
+    *out_taken = taken;
+    return first;
+}
+
+void Pool_Allocator::give_slots(u8 *first, u8 *last, u32 count) {
+    slot_next(last) = free_list;
+    free_list = first;
+    slots_used -= count;
+}
+
+void Pool_Allocator_Thread_Cache::init(Pool_Allocator_Shared *shared, u32 batch_size) {
+    AssertMessage(shared, "Trying to initialize 'Pool_Allocator_Thread_Cache' without a pool");
+    this->shared = shared;
+    this->batch_size = max(batch_size, 1u);
+    free_list = NULL;
+    free_count = 0;
+}
+
+void Pool_Allocator_Thread_Cache::deinit() {
+    if (free_list) {
+        u8 *last = free_list;
+        while (slot_next(last))  last = slot_next(last);
+
+        std::lock_guard< std::mutex > lock(shared->mutex);
+        shared->pool.give_slots(free_list, last, free_count);
+    }
+    free_list = NULL;
+    free_count = 0;
+}
+
+u8 *Pool_Allocator_Thread_Cache::do_allocate(u64 count, u64 size, CallerInfo caller) {
+    // The slot size does not change after `init()`, so it is read without the lock.
+    AssertMessage(count * size <= shared->pool.slot_size, "Allocation does not fit into a 'Pool_Allocator' slot");
+    if (count * size > shared->pool.slot_size)  return NULL;
+    if (!free_list) {
+        std::lock_guard< std::mutex > lock(shared->mutex);
+        free_list = shared->pool.take_slots(batch_size, &free_count);
+        if (!free_list)  return NULL;
+    }
+
+    u8 *slot = free_list;
+    free_list = slot_next(slot);
+    free_count -= 1;
+    return slot;
+}
+
+u8 *Pool_Allocator_Thread_Cache::do_reallocate(void *memory_pointer, u64 old_count, u64 new_count, u64 size, CallerInfo caller) {
+    if (!memory_pointer)  return do_allocate(new_count, size, caller);
+    return (new_count * size <= shared->pool.slot_size) ? (u8 *)memory_pointer : NULL;
+}
+
+void Pool_Allocator_Thread_Cache::do_deallocate(void *memory_pointer, CallerInfo caller) {
+    u8 *slot = (u8 *)memory_pointer;
+    slot_next(slot) = free_list;
+    free_list = slot;
+    free_count += 1;
+    if (free_count < 2 * batch_size)  return;
+
+    // Keep one batch, give the other one back.
+    u8 *last = free_list;
+    for (u32 slot_idx = 1; slot_idx < batch_size; slot_idx += 1)  last = slot_next(last);
+    u8 *first = free_list;
+    free_list = slot_next(last);
+    free_count -= batch_size;
+
+    std::lock_guard< std::mutex > lock(shared->mutex);
+    shared->pool.give_slots(first, last, batch_size);
+}
+
+/* Benchmark */
+
+constexpr u32 POOL_BENCHMARK_CHUNK_SLOTS = 256;
+constexpr u32 POOL_BENCHMARK_CACHE_BATCH = 64;
+
+struct Pool_Benchmark_Job {
+    Allocator *allocator;  // NULL - a thread cache of `shared`.
+    Pool_Allocator_Shared *shared;
+    u32 objects_count;
+    u32 operations_count;
+    u32 slot_size;
+};
+
+// Fills the objects, then frees and allocates random ones, then frees them all.
+static void pool_benchmark_churn(Allocator *allocator, u32 objects_count, u32 operations_count, u32 slot_size, u32 seed) {
+    u8 **objects = Allocate(sys_allocator, objects_count, u8 *);
+    for (u32 object_idx = 0; object_idx < objects_count; object_idx += 1) {
+        objects[object_idx] = QL_Allocate(allocator, 1, slot_size, QL_AllocatorEmptyCaller());
+        memset(objects[object_idx], (u8)object_idx, slot_size);
+    }
+
+    u32 random_state = seed * 2654435761u + 1;
+    for (u32 operation_idx = 0; operation_idx < operations_count; operation_idx += 1) {
+        u32 object_idx = QL_random_u32(&random_state) % objects_count;
+        Deallocate(allocator, objects[object_idx]);
+        objects[object_idx] = QL_Allocate(allocator, 1, slot_size, QL_AllocatorEmptyCaller());
+        memset(objects[object_idx], (u8)operation_idx, slot_size);
+    }
+
+    for (u32 object_idx = 0; object_idx < objects_count; object_idx += 1)
+        Deallocate(allocator, objects[object_idx]);
+    Deallocate(sys_allocator, objects);
+}
+
+static void pool_benchmark_job(void *data, u32 job_index) {
+    Pool_Benchmark_Job *job = (Pool_Benchmark_Job *)data;
+    if (job->allocator) {
+        pool_benchmark_churn(job->allocator, job->objects_count, job->operations_count, job->slot_size, job_index);
         return;
     }
 
-    AssertMessage(false, "Trying to deallocate with 'Linear_Allocator'");
+    Pool_Allocator_Thread_Cache cache;
+    cache.init(job->shared, POOL_BENCHMARK_CACHE_BATCH);
+    pool_benchmark_churn(&cache, job->objects_count, job->operations_count, job->slot_size, job_index);
+    cache.deinit();
+}
+
+Pool_Allocator_Benchmark pool_allocator_benchmark(u32 objects_count, u32 operations_count, u32 slot_size) {
+    auto milliseconds_since = [](std::chrono::steady_clock::time_point start) -> f64 {
+        return std::chrono::duration< f64, std::milli >(std::chrono::steady_clock::now() - start).count();
+    };
+
+    Pool_Allocator_Benchmark result = {};
+    result.objects_count = max(objects_count, 1u);
+    result.operations_count = operations_count;
+    result.slot_size = slot_size;
+    result.threads_count = jobs_workers_count() + 1;
+
+    Pool_Benchmark_Job job = {
+        .allocator = sys_allocator,
+        .shared = NULL,
+        .objects_count = result.objects_count,
+        .operations_count = operations_count,
+        .slot_size = slot_size
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    pool_benchmark_job(&job, 0);
+    result.system_milliseconds = milliseconds_since(start);
+
+    Pool_Allocator pool;
+    pool.init(sys_allocator, slot_size, POOL_BENCHMARK_CHUNK_SLOTS);
+    job.allocator = &pool;
+    start = std::chrono::steady_clock::now();
+    pool_benchmark_job(&job, 0);
+    result.pool_milliseconds = milliseconds_since(start);
+    result.pool_chunks_count = pool.chunks_count;
+    pool.deinit();
+
+    job.allocator = sys_allocator;
+    start = std::chrono::steady_clock::now();
+    jobs_run_parallel(result.threads_count, pool_benchmark_job, &job);
+    result.system_threads_milliseconds = milliseconds_since(start);
+
+    Pool_Allocator_Shared shared;
+    shared.pool.init(sys_allocator, slot_size, POOL_BENCHMARK_CHUNK_SLOTS);
+    job.allocator = NULL;
+    job.shared = &shared;
+    start = std::chrono::steady_clock::now();
+    jobs_run_parallel(result.threads_count, pool_benchmark_job, &job);
+    result.pool_threads_milliseconds = milliseconds_since(start);
+    AssertMessage(shared.pool.slots_used == 0, "Pool benchmark leaked slots");
+    shared.pool.deinit();
+
+    return result;
 }
@@ -1,6 +1,8 @@
 #ifndef QLIGHT_ALLOCATOR_H
 #define QLIGHT_ALLOCATOR_H
 
+#include <mutex>
+
 #include "platform.h"
 
 #if defined(QLIGHT_PLATFORM_WINDOWS)
@@ -94,6 +96,22 @@ struct System_Allocator : Allocator {
 	void do_deallocate(void *memory_pointer, CallerInfo caller);
 };
 
+// Allocations and reallocations made through `System_Allocator` by all threads so far.
+u64 system_allocations_count();
+
+// Where a `Linear_Allocator`'s cursor was, to rewind it back there.
+struct Linear_Allocator_Marker {
+	u8 *cursor;
+};
+
+/*
+	Bump allocator over one block of memory.
+
+	`Allocate()` and arrays get `count * size` bytes aligned to the item's size (up to 16 bytes),
+	  `allocate_aligned()` gets raw bytes.  Deallocation does nothing: memory comes back all at
+	  once with `reset()`, or down to a marker with `rewind()`.  A reallocation of the last
+	  allocation grows it in place.
+*/
 struct Linear_Allocator : Allocator {
 	u8 *memory_start = NULL;
 	u8 *memory_end = NULL;
@@ -107,10 +125,169 @@ struct Linear_Allocator : Allocator {
 	void do_deallocate(void *memory_pointer, CallerInfo caller);
 
 	void init(void *memory_pointer, u64 size);
+	// Gives the memory back to `sys_allocator`, which it must have come from.
 	void deinit();
 	void reset(bool zero_memory);
 
+	// Returns NULL if it does not fit, unlike `Allocate()`, which asserts.
+	u8 *allocate_aligned(u64 size, u64 alignment);
+
+	Linear_Allocator_Marker marker();
+	// Frees everything allocated since the marker was taken.
+	void rewind(Linear_Allocator_Marker marker);
+
+	u64 occupied();
+	// Most bytes ever occupied at once, resets do not lower it.
+	u64 high_water_mark();
+};
+
+/*
+	Rewinds the allocator to where it was when the scope began:
+
+	{
+		Linear_Allocator_Scope scope( arena );
+		Array< u32 > temporary = array_new< u32 >( arena, 64 );
+		...
+	}
+*/
+struct Linear_Allocator_Scope {
+	Linear_Allocator *allocator;
+	Linear_Allocator_Marker marker;
+
+	Linear_Allocator_Scope(Linear_Allocator *allocator) : allocator(allocator), marker(allocator->marker()) {}
+	~Linear_Allocator_Scope() { allocator->rewind(marker); }
+};
+
+/*
+	Bump allocator over a reserved range of address space, committed as the cursor reaches it.
+
+	The range is reserved once by `init()` and never moves, so a reallocation of the last
+	  allocation grows it in place: an array that owns an arena grows without copying its items,
+	  and pointers into it stay valid.  Other reallocations copy, like `Linear_Allocator`'s.
+	Memory is committed in steps of `commit_step` bytes, 2 MB with huge pages so the system can
+	  back every step with one.  Deallocation does nothing, `reset()` frees everything at once.
+*/
+struct Virtual_Arena_Allocator : Allocator {
+	u8 *memory_start = NULL;
+	u8 *reserved_end = NULL;
+	u8 *committed_end = NULL;
+	u8 *cursor = NULL;
+	u64 commit_step = 0;
+	bool huge_pages = false;
+	// What was reserved, `memory_start` is aligned to `commit_step` inside it.
+	u8 *reservation = NULL;
+	u64 reservation_size = 0;
+
+	u32 commits_count = 0;
+	u32 copies_count = 0;   // Reallocations that could not grow in place.
+	u64 bytes_copied = 0;
+
+	u8 *do_allocate(u64 count, u64 size, CallerInfo caller);
+	u8 *do_reallocate(void *memory_pointer, u64 old_count, u64 new_count, u64 size, CallerInfo caller);
+	void do_deallocate(void *memory_pointer, CallerInfo caller);
+
+	// Reserves `reserve_size` bytes of address space, which is all the arena can ever hold.
+	bool init(u64 reserve_size, bool huge_pages);
+	void deinit();
+	// Frees everything, `decommit` also gives the memory back to the system.
+	void reset(bool decommit);
+
 	u64 occupied();
+	u64 committed();
+};
+
+struct Virtual_Arena_Benchmark {
+	u32 items_count;          // `u64`s added one by one to an array that started empty.
+	f64 system_milliseconds;  // Array on `System_Allocator`.
+	u32 system_moves;         // Times growth moved its items.
+	u64 system_page_faults;
+	f64 arena_milliseconds;   // Array on a `Virtual_Arena_Allocator`.
+	u32 arena_copies;
+	u64 arena_page_faults;
+	f64 huge_arena_milliseconds;  // Same with huge pages.
+	u32 huge_arena_copies;
+	u64 huge_arena_page_faults;
+};
+
+// Grows an array to `items_count` items on each allocator and counts moves and page faults.
+Virtual_Arena_Benchmark virtual_arena_benchmark(u32 items_count);
+
+/*
+	Fixed-size slots for records that are created and destroyed often.
+
+	Slots are carved out of chunks of `slots_per_chunk` slots taken from the backing allocator
+	  when no slot is free.  Chunks go back only with `deinit()`, so live objects never move.
+	Free slots form a list through their first bytes, allocating and freeing is a pointer swap.
+	`Allocate()` gets one slot, `count * size` must fit into it, and a reallocation that still
+	  fits keeps it.  Not thread-safe, threads share a pool through `Pool_Allocator_Thread_Cache`.
+*/
+struct Pool_Allocator : Allocator {
+	Allocator *backing_allocator = NULL;
+	u64 slot_size = 0;  // Rounded up to hold a pointer and keep slots 16 bytes aligned at most.
+	u32 slots_per_chunk = 0;
+
+	u8 *free_list = NULL;
+	u8 *chunks = NULL;  // Each chunk starts with a pointer to the previous one.
+	u32 chunks_count = 0;
+	u32 slots_used = 0;  // Handed out, slots held by thread caches included.
+
+	u8 *do_allocate(u64 count, u64 size, CallerInfo caller);
+	u8 *do_reallocate(void *memory_pointer, u64 old_count, u64 new_count, u64 size, CallerInfo caller);
+	void do_deallocate(void *memory_pointer, CallerInfo caller);
+
+	void init(Allocator *backing_allocator, u64 slot_size, u32 slots_per_chunk);
+	// Frees all chunks, slots still in use become invalid.
+	void deinit();
+
+	u64 capacity();  // Slots of all chunks.
+
+	// Unlinks up to `count` free slots, growing the pool if there are none.  Returns the first one, slots link to the next.
+	u8 *take_slots(u32 count, u32 *out_taken);
+	// Links `count` slots, from `first` to `last`, back into the free list.
+	void give_slots(u8 *first, u8 *last, u32 count);
 };
 
+// A pool guarded by a mutex, for thread caches only.
+struct Pool_Allocator_Shared {
+	Pool_Allocator pool;
+	std::mutex mutex;
+};
+
+/*
+	One thread's free slots of a shared pool.  Slots come from the pool and go back to it in
+	  batches of `batch_size`, so the pool's mutex is taken once per batch.  A slot may be freed
+	  through any cache of the same pool.
+*/
+struct Pool_Allocator_Thread_Cache : Allocator {
+	Pool_Allocator_Shared *shared = NULL;
+	u32 batch_size = 0;
+
+	u8 *free_list = NULL;
+	u32 free_count = 0;
+
+	u8 *do_allocate(u64 count, u64 size, CallerInfo caller);
+	u8 *do_reallocate(void *memory_pointer, u64 old_count, u64 new_count, u64 size, CallerInfo caller);
+	void do_deallocate(void *memory_pointer, CallerInfo caller);
+
+	void init(Pool_Allocator_Shared *shared, u32 batch_size);
+	// Gives all free slots back to the pool.
+	void deinit();
+};
+
+struct Pool_Allocator_Benchmark {
+	u32 objects_count;
+	u32 operations_count;         // Frees followed by allocations, per thread.
+	u32 slot_size;
+	u32 threads_count;            // Of the multithreaded runs, the calling thread included.
+	f64 system_milliseconds;      // Single thread, `System_Allocator`.
+	f64 pool_milliseconds;        // Single thread, `Pool_Allocator`.
+	f64 system_threads_milliseconds;
+	f64 pool_threads_milliseconds;  // One `Pool_Allocator_Thread_Cache` per thread on a shared pool.
+	u32 pool_chunks_count;        // Of the single-threaded pool at the end.
+};
+
+// Keeps `objects_count` objects of `slot_size` bytes alive and replaces random ones `operations_count` times,
+//   on this thread and then on every job worker at once.  Each thread has its own objects.
+Pool_Allocator_Benchmark pool_allocator_benchmark(u32 objects_count, u32 operations_count, u32 slot_size);
+
 #endif /* QLIGHT_ALLOCATOR_H */
\ No newline at end of file
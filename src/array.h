@@ -37,7 +37,7 @@ template <typename T>
 Array<T> array_new(Allocator *allocator, ArrayView<T> source) {
 	Array<T> array;
 	array.allocator = allocator;
-	array.size = source.size;
+	array.size = 0;  // `array_add_many()` adds the items after it.
 	array.capacity = source.size;
 	if ( source.size > 0 ) {
 		array.data = TemplateAllocate(allocator, array.capacity, T);
@@ -131,6 +131,13 @@ u32 array_resize(Array<T> *array, u32 new_capacity) {
 	return array->capacity;
 }
 
+// Grows the capacity to hold at least `capacity` items, the size stays the same.
+template <typename T>
+void array_reserve(Array<T> *array, u32 capacity) {
+	if (capacity > array->capacity)
+		array_resize(array, capacity);
+}
+
 // Returns newly added item's index.
 template <typename T>
 u32 array_add(Array<T> *array, T item) {
@@ -0,0 +1,759 @@
+#include <math.h>
+#include <float.h>
+#include <string.h> // memset()
+#include <chrono>
+
+#include "bvh.h"
+#include "camera.h"
+
+constexpr u32 BVH_SAH_BINS_COUNT = 16;
+
+void bvh_init( BVH_Tree *tree, Allocator *allocator, u32 initial_capacity, f32 margin ) {
+	tree->nodes = array_new< BVH_Node >( allocator, initial_capacity );
+	tree->root = INVALID_BVH_NODE_ID;
+	tree->free_list = INVALID_BVH_NODE_ID;
+	tree->leaves_count = 0;
+	tree->margin = margin;
+	tree->traversal_stack = array_new< BVH_Traversal_Item >( allocator, 64 );
+}
+
+void bvh_destroy( BVH_Tree *tree ) {
+	array_free( &tree->nodes );
+	array_free( &tree->traversal_stack );
+	tree->root = INVALID_BVH_NODE_ID;
+	tree->free_list = INVALID_BVH_NODE_ID;
+	tree->leaves_count = 0;
+}
+
+void bvh_clear( BVH_Tree *tree ) {
+	array_clear( &tree->nodes );
+	tree->root = INVALID_BVH_NODE_ID;
+	tree->free_list = INVALID_BVH_NODE_ID;
+	tree->leaves_count = 0;
+}
+
+static inline bool node_is_leaf( BVH_Node *node ) {
+	return ( node->child1 == INVALID_BVH_NODE_ID );
+}
+
+static BVH_Node_ID node_allocate( BVH_Tree *tree ) {
+	BVH_Node_ID node_id = tree->free_list;
+	if ( node_id != INVALID_BVH_NODE_ID ) {
+		tree->free_list = tree->nodes.data[ node_id ].parent;
+	} else {
+		node_id = array_add( &tree->nodes, BVH_Node {} );
+	}
+
+	BVH_Node *node = &tree->nodes.data[ node_id ];
+	node->parent = INVALID_BVH_NODE_ID;
+	node->child1 = INVALID_BVH_NODE_ID;
+	node->child2 = INVALID_BVH_NODE_ID;
+	node->height = 0;
+	node->user_data = 0;
+	return node_id;
+}
+
+static void node_free( BVH_Tree *tree, BVH_Node_ID node_id ) {
+	BVH_Node *node = &tree->nodes.data[ node_id ];
+	node->parent = tree->free_list;
+	node->height = -1;
+	tree->free_list = node_id;
+}
+
+static void node_replace_child( BVH_Tree *tree, BVH_Node_ID parent_id, BVH_Node_ID old_child, BVH_Node_ID new_child ) {
+	if ( parent_id == INVALID_BVH_NODE_ID ) {
+		tree->root = new_child;
+		return;
+	}
+
+	BVH_Node *parent = &tree->nodes.data[ parent_id ];
+	if ( parent->child1 == old_child )
+		parent->child1 = new_child;
+	else
+		parent->child2 = new_child;
+}
+
+static void node_refit( BVH_Tree *tree, BVH_Node_ID node_id ) {
+	BVH_Node *nodes = tree->nodes.data;
+	BVH_Node *node = &nodes[ node_id ];
+	BVH_Node *child1 = &nodes[ node->child1 ];
+	BVH_Node *child2 = &nodes[ node->child2 ];
+	node->aabb = aabb_union( child1->aabb, child2->aabb );
+	node->height = 1 + QL_max2( child1->height, child2->height );
+}
+
+// Rotates the taller grandchild subtree up if the node is imbalanced (AVL-style, as in Box2D's b2DynamicTree).
+// Returns the node that is now at this node's place.
+static BVH_Node_ID node_balance( BVH_Tree *tree, BVH_Node_ID a_id ) {
+	BVH_Node *nodes = tree->nodes.data;
+	BVH_Node *a = &nodes[ a_id ];
+	if ( node_is_leaf( a ) || a->height < 2 )
+		return a_id;
+
+	BVH_Node_ID b_id = a->child1;
+	BVH_Node_ID c_id = a->child2;
+	BVH_Node *b = &nodes[ b_id ];
+	BVH_Node *c = &nodes[ c_id ];
+	s32 balance = c->height - b->height;
+
+	if ( balance > 1 ) {
+		// Rotate C up.
+		BVH_Node_ID f_id = c->child1;
+		BVH_Node_ID g_id = c->child2;
+		BVH_Node *f = &nodes[ f_id ];
+		BVH_Node *g = &nodes[ g_id ];
+
+		c->child1 = a_id;
+		c->parent = a->parent;
+		a->parent = c_id;
+		node_replace_child( tree, c->parent, a_id, c_id );
+
+		if ( f->height > g->height ) {
+			c->child2 = f_id;
+			a->child2 = g_id;
+			g->parent = a_id;
+		} else {
+			c->child2 = g_id;
+			a->child2 = f_id;
+			f->parent = a_id;
+		}
+
+		node_refit( tree, a_id );
+		node_refit( tree, c_id );
+		return c_id;
+	}
+
+	if ( balance < -1 ) {
+		// Rotate B up.
+		BVH_Node_ID d_id = b->child1;
+		BVH_Node_ID e_id = b->child2;
+		BVH_Node *d = &nodes[ d_id ];
+		BVH_Node *e = &nodes[ e_id ];
+
+		b->child1 = a_id;
+		b->parent = a->parent;
+		a->parent = b_id;
+		node_replace_child( tree, b->parent, a_id, b_id );
+
+		if ( d->height > e->height ) {
+			b->child2 = d_id;
+			a->child1 = e_id;
+			e->parent = a_id;
+		} else {
+			b->child2 = e_id;
+			a->child1 = d_id;
+			d->parent = a_id;
+		}
+
+		node_refit( tree, a_id );
+		node_refit( tree, b_id );
+		return b_id;
+	}
+
+	return a_id;
+}
+
+static void refit_ancestors( BVH_Tree *tree, BVH_Node_ID node_id ) {
+	while ( node_id != INVALID_BVH_NODE_ID ) {
+		node_id = node_balance( tree, node_id );
+		node_refit( tree, node_id );
+		node_id = tree->nodes.data[ node_id ].parent;
+	}
+}
+
+static void insert_leaf( BVH_Tree *tree, BVH_Node_ID leaf_id ) {
+	if ( tree->root == INVALID_BVH_NODE_ID ) {
+		tree->root = leaf_id;
+		tree->nodes.data[ leaf_id ].parent = INVALID_BVH_NODE_ID;
+		return;
+	}
+
+	// 1. Find the best sibling: descend while making the leaf a sibling of a child is cheaper
+	//   than making it a sibling of the current node (surface area heuristic).
+	AABB leaf_aabb = tree->nodes.data[ leaf_id ].aabb;
+	BVH_Node_ID sibling_id = tree->root;
+	while ( !node_is_leaf( &tree->nodes.data[ sibling_id ] ) ) {
+		BVH_Node *node = &tree->nodes.data[ sibling_id ];
+		BVH_Node *child1 = &tree->nodes.data[ node->child1 ];
+		BVH_Node *child2 = &tree->nodes.data[ node->child2 ];
+
+		f32 area = aabb_surface_area( node->aabb );
+		f32 combined_area = aabb_surface_area( aabb_union( node->aabb, leaf_aabb ) );
+		// Cost of a new parent for this node and the leaf.
+		f32 cost = 2.0f * combined_area;
+		// Minimum cost of pushing the leaf further down, every ancestor grows by this much.
+		f32 inheritance_cost = 2.0f * ( combined_area - area );
+
+		f32 cost1 = aabb_surface_area( aabb_union( child1->aabb, leaf_aabb ) ) + inheritance_cost;
+		if ( !node_is_leaf( child1 ) )
+			cost1 -= aabb_surface_area( child1->aabb );
+
+		f32 cost2 = aabb_surface_area( aabb_union( child2->aabb, leaf_aabb ) ) + inheritance_cost;
+		if ( !node_is_leaf( child2 ) )
+			cost2 -= aabb_surface_area( child2->aabb );
+
+		if ( cost < cost1 && cost < cost2 )
+			break;
+
+		sibling_id = ( cost1 < cost2 ) ? node->child1 : node->child2;
+	}
+
+	// 2. Put a new parent in the sibling's place.
+	BVH_Node_ID new_parent_id = node_allocate( tree );
+	BVH_Node *nodes = tree->nodes.data;
+	BVH_Node *sibling = &nodes[ sibling_id ];
+	BVH_Node *new_parent = &nodes[ new_parent_id ];
+	BVH_Node_ID old_parent_id = sibling->parent;
+	new_parent->parent = old_parent_id;
+	new_parent->aabb = aabb_union( sibling->aabb, leaf_aabb );
+	new_parent->height = sibling->height + 1;
+	new_parent->child1 = sibling_id;
+	new_parent->child2 = leaf_id;
+	node_replace_child( tree, old_parent_id, sibling_id, new_parent_id );
+	sibling->parent = new_parent_id;
+	nodes[ leaf_id ].parent = new_parent_id;
+
+	// 3. Walk back up, fixing boxes and heights.
+	refit_ancestors( tree, new_parent_id );
+}
+
+static void remove_leaf( BVH_Tree *tree, BVH_Node_ID leaf_id ) {
+	if ( leaf_id == tree->root ) {
+		tree->root = INVALID_BVH_NODE_ID;
+		return;
+	}
+
+	BVH_Node *nodes = tree->nodes.data;
+	BVH_Node_ID parent_id = nodes[ leaf_id ].parent;
+	BVH_Node *parent = &nodes[ parent_id ];
+	BVH_Node_ID grandparent_id = parent->parent;
+	BVH_Node_ID sibling_id = ( parent->child1 == leaf_id ) ? parent->child2 : parent->child1;
+
+	// The sibling takes the parent's place.
+	node_replace_child( tree, grandparent_id, parent_id, sibling_id );
+	nodes[ sibling_id ].parent = grandparent_id;
+	node_free( tree, parent_id );
+
+	refit_ancestors( tree, grandparent_id );
+}
+
+BVH_Node_ID bvh_insert( BVH_Tree *tree, AABB aabb, u32 user_data ) {
+	BVH_Node_ID leaf_id = node_allocate( tree );
+	BVH_Node *leaf = &tree->nodes.data[ leaf_id ];
+	leaf->aabb = aabb_expand( aabb, tree->margin );
+	leaf->user_data = user_data;
+	insert_leaf( tree, leaf_id );
+	tree->leaves_count += 1;
+	return leaf_id;
+}
+
+void bvh_remove( BVH_Tree *tree, BVH_Node_ID leaf ) {
+	Assert( leaf < tree->nodes.size );
+	Assert( node_is_leaf( &tree->nodes.data[ leaf ] ) );
+	remove_leaf( tree, leaf );
+	node_free( tree, leaf );
+	tree->leaves_count -= 1;
+}
+
+bool bvh_move( BVH_Tree *tree, BVH_Node_ID leaf, AABB aabb ) {
+	Assert( leaf < tree->nodes.size );
+	Assert( node_is_leaf( &tree->nodes.data[ leaf ] ) );
+	if ( aabb_contains( tree->nodes.data[ leaf ].aabb, aabb ) )
+		return false;
+
+	remove_leaf( tree, leaf );
+	tree->nodes.data[ leaf ].aabb = aabb_expand( aabb, tree->margin );
+	insert_leaf( tree, leaf );
+	return true;
+}
+
+struct BVH_Build_Item {
+	BVH_Node_ID node;
+	u32 begin;  // Range in the primitive indices.
+	u32 end;
+};
+
+struct BVH_Bin {
+	AABB aabb;
+	u32 count;
+};
+
+static f32 vector3_axis( Vector3_f32 v, u32 axis ) {
+	return ( axis == 0 ) ? v.x : ( axis == 1 ) ? v.y : v.z;
+}
+
+// Returns the index in `[ begin; end )` the range is split at.
+static u32 sah_partition( ArrayView< AABB > aabbs, Vector3_f32 *centroids, u32 *indices, u32 begin, u32 end ) {
+	AABB centroid_bounds = aabb_empty();
+	for ( u32 idx = begin; idx < end; idx += 1 ) {
+		aabb_add_point( &centroid_bounds, centroids[ indices[ idx ] ] );
+	}
+
+	Vector3_f32 extent = centroid_bounds.max - centroid_bounds.min;
+	u32 axis = ( extent.x > extent.y && extent.x > extent.z ) ? 0 : ( extent.y > extent.z ) ? 1 : 2;
+	f32 axis_min = vector3_axis( centroid_bounds.min, axis );
+	f32 axis_extent = vector3_axis( extent, axis );
+	u32 middle = begin + ( end - begin ) / 2;
+	if ( axis_extent <= 0.0f )
+		// All centroids are in one point, any split is as good.
+		return middle;
+
+	BVH_Bin bins[ BVH_SAH_BINS_COUNT ];
+	ForIt( bins, BVH_SAH_BINS_COUNT ) {
+		it = BVH_Bin { .aabb = aabb_empty(), .count = 0 };
+	}}
+
+	f32 bin_scale = ( f32 )BVH_SAH_BINS_COUNT / axis_extent;
+	auto bin_of = [ & ]( u32 primitive ) -> u32 {
+		u32 bin = ( u32 )( ( vector3_axis( centroids[ primitive ], axis ) - axis_min ) * bin_scale );
+		return QL_min2( bin, BVH_SAH_BINS_COUNT - 1 );
+	};
+
+	for ( u32 idx = begin; idx < end; idx += 1 ) {
+		BVH_Bin *bin = &bins[ bin_of( indices[ idx ] ) ];
+		bin->aabb = aabb_union( bin->aabb, aabbs.data[ indices[ idx ] ] );
+		bin->count += 1;
+	}
+
+	// Sweep from the right to get costs of all right sides, then from the left to pick the cheapest plane.
+	f32 right_areas[ BVH_SAH_BINS_COUNT ];
+	AABB right_aabb = aabb_empty();
+	u32 right_count = 0;
+	ForNamedBackwards( bin_idx, BVH_SAH_BINS_COUNT ) {
+		right_aabb = aabb_union( right_aabb, bins[ bin_idx ].aabb );
+		right_count += bins[ bin_idx ].count;
+		right_areas[ bin_idx ] = ( right_count ) ? aabb_surface_area( right_aabb ) * right_count : 0.0f;
+	}
+
+	f32 best_cost = F32_MAX;
+	u32 best_split = 0;  // Bins `[ 0; best_split ]` go left.
+	AABB left_aabb = aabb_empty();
+	u32 left_count = 0;
+	For( BVH_SAH_BINS_COUNT - 1 ) {
+		left_aabb = aabb_union( left_aabb, bins[ it_index ].aabb );
+		left_count += bins[ it_index ].count;
+		if ( left_count == 0 )
+			continue;
+
+		f32 cost = aabb_surface_area( left_aabb ) * left_count + right_areas[ it_index + 1 ];
+		if ( cost < best_cost ) {
+			best_cost = cost;
+			best_split = it_index;
+		}
+	}
+
+	// Partition in place.
+	u32 left = begin;
+	u32 right = end;
+	while ( left < right ) {
+		if ( bin_of( indices[ left ] ) <= best_split ) {
+			left += 1;
+		} else {
+			right -= 1;
+			u32 swap = indices[ left ];
+			indices[ left ] = indices[ right ];
+			indices[ right ] = swap;
+		}
+	}
+
+	if ( left == begin || left == end )
+		return middle;
+
+	return left;
+}
+
+void bvh_build_sah( BVH_Tree *tree, ArrayView< AABB > aabbs, ArrayView< u32 > user_data ) {
+	Assert( aabbs.size == user_data.size );
+	bvh_clear( tree );
+	u32 count = aabbs.size;
+	if ( count == 0 )
+		return;
+
+	Allocator *allocator = tree->nodes.allocator;
+	Array< u32 > indices = array_new< u32 >( allocator, count );
+	Array< Vector3_f32 > centroids = array_new< Vector3_f32 >( allocator, count );
+	For( count ) {
+		array_add( &indices, ( u32 )it_index );
+		array_add( &centroids, ( aabbs.data[ it_index ].min + aabbs.data[ it_index ].max ) * 0.5f );
+	}
+
+	// A binary tree with `count` leaves has `2 * count - 1` nodes.
+	array_resize( &tree->nodes, 2 * count - 1 );
+	array_clear( &tree->nodes );
+
+	// Explicit stack, so degenerate inputs can not overflow the call stack.
+	Array< BVH_Build_Item > stack = array_new< BVH_Build_Item >( allocator, 64 );
+	tree->root = node_allocate( tree );
+	array_add( &stack, BVH_Build_Item { .node = tree->root, .begin = 0, .end = count } );
+
+	BVH_Build_Item item;
+	while ( array_pop( &stack, &item ) ) {
+		AABB bounds = aabb_empty();
+		for ( u32 idx = item.begin; idx < item.end; idx += 1 ) {
+			bounds = aabb_union( bounds, aabbs.data[ indices.data[ idx ] ] );
+		}
+		tree->nodes.data[ item.node ].aabb = bounds;
+
+		if ( item.end - item.begin == 1 ) {
+			tree->nodes.data[ item.node ].user_data = user_data.data[ indices.data[ item.begin ] ];
+			continue;
+		}
+
+		u32 split = sah_partition( aabbs, centroids.data, indices.data, item.begin, item.end );
+		BVH_Node_ID child1 = node_allocate( tree );
+		BVH_Node_ID child2 = node_allocate( tree );
+		BVH_Node *node = &tree->nodes.data[ item.node ];
+		node->child1 = child1;
+		node->child2 = child2;
+		tree->nodes.data[ child1 ].parent = item.node;
+		tree->nodes.data[ child2 ].parent = item.node;
+		array_add( &stack, BVH_Build_Item { .node = child1, .begin = item.begin, .end = split } );
+		array_add( &stack, BVH_Build_Item { .node = child2, .begin = split, .end = item.end } );
+	}
+
+	// Children are always allocated after their parent, so a backwards pass sees them first.
+	ForItBackwards( tree->nodes.data, tree->nodes.size ) {
+		if ( !node_is_leaf( &it ) )
+			it.height = 1 + QL_max2( tree->nodes.data[ it.child1 ].height, tree->nodes.data[ it.child2 ].height );
+	}}
+
+	tree->leaves_count = count;
+	array_free( &stack );
+	array_free( &indices );
+	array_free( &centroids );
+}
+
+enum BVH_Query_Type : u8 {
+	BVHQueryType_Frustum = 0,
+	BVHQueryType_AABB,
+	BVHQueryType_Sphere,
+	BVHQueryType_Ray
+};
+
+struct BVH_Query {
+	BVH_Query_Type type;
+	Frustum *frustum;
+	AABB aabb;
+	Vector3_f32 center;  // Sphere center or ray origin.
+	Vector3_f32 one_over_direction;
+	f32 radius;          // Sphere radius or ray length.
+};
+
+static u32 bvh_query( BVH_Tree *tree, BVH_Query *query, Array< u32 > *out_user_data ) {
+	if ( tree->root == INVALID_BVH_NODE_ID )
+		return 0;
+
+	Array< BVH_Traversal_Item > *stack = &tree->traversal_stack;
+	array_clear( stack );
+	array_add( stack, BVH_Traversal_Item { .node = tree->root, .plane_mask = FRUSTUM_PLANE_MASK_ALL } );
+
+	BVH_Node *nodes = tree->nodes.data;
+	u32 found = 0;
+	BVH_Traversal_Item item;
+	while ( array_pop( stack, &item ) ) {
+		BVH_Node *node = &nodes[ item.node ];
+
+		u32 plane_mask = 0;
+		bool passes = false;
+		f32 distance;
+		switch ( query->type ) {
+			case BVHQueryType_Frustum:
+				// Once a node is fully inside, the mask is empty and the test is free.
+				passes = ( frustum_classify_aabb( query->frustum, node->aabb, item.plane_mask, &plane_mask ) != FrustumTest_Outside );
+				break;
+			case BVHQueryType_AABB:    passes = aabb_overlaps( node->aabb, query->aabb ); break;
+			case BVHQueryType_Sphere:  passes = aabb_overlaps_sphere( node->aabb, query->center, query->radius ); break;
+			case BVHQueryType_Ray:     passes = aabb_intersects_ray( node->aabb, query->center, query->one_over_direction, query->radius, &distance ); break;
+		}
+
+		if ( !passes )
+			continue;
+
+		if ( node_is_leaf( node ) ) {
+			array_add( out_user_data, node->user_data );
+			found += 1;
+			continue;
+		}
+
+		array_add( stack, BVH_Traversal_Item { .node = node->child1, .plane_mask = plane_mask } );
+		array_add( stack, BVH_Traversal_Item { .node = node->child2, .plane_mask = plane_mask } );
+	}
+
+	return found;
+}
+
+u32 bvh_query_frustum( BVH_Tree *tree, Frustum *frustum, Array< u32 > *out_user_data ) {
+	BVH_Query query = { .type = BVHQueryType_Frustum, .frustum = frustum };
+	return bvh_query( tree, &query, out_user_data );
+}
+
+u32 bvh_query_aabb( BVH_Tree *tree, AABB aabb, Array< u32 > *out_user_data ) {
+	BVH_Query query = { .type = BVHQueryType_AABB, .aabb = aabb };
+	return bvh_query( tree, &query, out_user_data );
+}
+
+u32 bvh_query_sphere( BVH_Tree *tree, Vector3_f32 center, f32 radius, Array< u32 > *out_user_data ) {
+	BVH_Query query = { .type = BVHQueryType_Sphere, .center = center, .radius = radius };
+	return bvh_query( tree, &query, out_user_data );
+}
+
+u32 bvh_query_ray( BVH_Tree *tree, Vector3_f32 origin, Vector3_f32 direction, f32 max_distance, Array< u32 > *out_user_data ) {
+	BVH_Query query = {
+		.type = BVHQueryType_Ray,
+		.center = origin,
+		.one_over_direction = Vector3_f32 { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z },
+		.radius = max_distance
+	};
+	return bvh_query( tree, &query, out_user_data );
+}
+
+s32 bvh_height( BVH_Tree *tree ) {
+	if ( tree->root == INVALID_BVH_NODE_ID )
+		return 0;
+
+	return tree->nodes.data[ tree->root ].height;
+}
+
+BVH_Benchmark bvh_benchmark( Matrix4x4_f32 *view_projection, u32 entries_count ) {
+	Frustum frustum = frustum_from_view_projection( view_projection );
+
+	// Fixed seed, so runs are reproducible.
+	u32 random_state = 0x9E3779B9;
+
+	// Keep the density roughly the same for any count.
+	f32 world_size = 10.0f * sqrtf( ( f32 )entries_count );
+	Array< AABB > aabbs = array_new< AABB >( sys_allocator, entries_count );
+	Array< u32 > user_data = array_new< u32 >( sys_allocator, entries_count );
+	For( entries_count ) {
+		Vector3_f32 center = { QL_random_f32( &random_state, -world_size, world_size ), QL_random_f32( &random_state, -50.0f, 50.0f ), QL_random_f32( &random_state, -world_size, world_size ) };
+		Vector3_f32 extent = { QL_random_f32( &random_state, 0.1f, 4.0f ), QL_random_f32( &random_state, 0.1f, 4.0f ), QL_random_f32( &random_state, 0.1f, 4.0f ) };
+		array_add( &aabbs, AABB { .min = center - extent, .max = center + extent } );
+		array_add( &user_data, ( u32 )it_index );
+	}
+
+	constexpr u32 QUERIES_COUNT = 1000;
+	Array< AABB > query_aabbs = array_new< AABB >( sys_allocator, QUERIES_COUNT );
+	Array< Vector3_f32 > query_directions = array_new< Vector3_f32 >( sys_allocator, QUERIES_COUNT );
+	For( QUERIES_COUNT ) {
+		Vector3_f32 center = { QL_random_f32( &random_state, -world_size, world_size ), QL_random_f32( &random_state, -50.0f, 50.0f ), QL_random_f32( &random_state, -world_size, world_size ) };
+		Vector3_f32 extent = { 10.0f, 10.0f, 10.0f };
+		array_add( &query_aabbs, AABB { .min = center - extent, .max = center + extent } );
+		Vector3_f32 direction = { QL_random_f32( &random_state, -1.0f, 1.0f ), QL_random_f32( &random_state, -0.1f, 0.1f ), QL_random_f32( &random_state, -1.0f, 1.0f ) };
+		array_add( &query_directions, direction );
+	}
+
+	Array< u32 > results = array_new< u32 >( sys_allocator, entries_count );
+	BVH_Benchmark result = { .entries_count = entries_count };
+	auto milliseconds_since = []( std::chrono::steady_clock::time_point start ) -> f64 {
+		return std::chrono::duration< f64, std::milli >( std::chrono::steady_clock::now() - start ).count();
+	};
+
+	auto run_queries = [ & ]( BVH_Tree *tree ) -> u32 {
+		array_clear( &results );
+		u32 visible_count = bvh_query_frustum( tree, &frustum, &results );
+		ForIt( query_aabbs.data, QUERIES_COUNT ) {
+			Vector3_f32 center = ( it.min + it.max ) * 0.5f;
+			array_clear( &results );
+			bvh_query_aabb( tree, it, &results );
+			array_clear( &results );
+			bvh_query_sphere( tree, center, 10.0f, &results );
+			array_clear( &results );
+			bvh_query_ray( tree, center, query_directions.data[ it_index ], world_size, &results );
+		}}
+		return visible_count;
+	};
+
+	// Static tree.
+	BVH_Tree static_tree;
+	bvh_init( &static_tree, sys_allocator, 2 * entries_count, 0.0f );
+
+	auto start = std::chrono::steady_clock::now();
+	bvh_build_sah( &static_tree, array_view( &aabbs ), array_view( &user_data ) );
+	result.static_build_milliseconds = milliseconds_since( start );
+
+	start = std::chrono::steady_clock::now();
+	result.static_visible_count = run_queries( &static_tree );
+	result.static_query_milliseconds = milliseconds_since( start );
+	result.static_height = bvh_height( &static_tree );
+	bvh_destroy( &static_tree );
+
+	// Dynamic tree.
+	BVH_Tree dynamic_tree;
+	bvh_init( &dynamic_tree, sys_allocator, 2 * entries_count, 0.1f );
+	Array< BVH_Node_ID > leaves = array_new< BVH_Node_ID >( sys_allocator, entries_count );
+
+	start = std::chrono::steady_clock::now();
+	ForIt( aabbs.data, aabbs.size ) {
+		array_add( &leaves, bvh_insert( &dynamic_tree, it, it_index ) );
+	}}
+	result.dynamic_build_milliseconds = milliseconds_since( start );
+
+	ForIt( aabbs.data, aabbs.size ) {
+		Vector3_f32 offset = { QL_random_f32( &random_state, -0.5f, 0.5f ), QL_random_f32( &random_state, -0.5f, 0.5f ), QL_random_f32( &random_state, -0.5f, 0.5f ) };
+		it.min = it.min + offset;
+		it.max = it.max + offset;
+	}}
+
+	start = std::chrono::steady_clock::now();
+	ForIt( aabbs.data, aabbs.size ) {
+		result.dynamic_reinserted_count += bvh_move( &dynamic_tree, leaves.data[ it_index ], it );
+	}}
+	result.dynamic_refit_milliseconds = milliseconds_since( start );
+
+	start = std::chrono::steady_clock::now();
+	result.dynamic_visible_count = run_queries( &dynamic_tree );
+	result.dynamic_query_milliseconds = milliseconds_since( start );
+	result.dynamic_height = bvh_height( &dynamic_tree );
+	bvh_destroy( &dynamic_tree );
+
+	array_free( &leaves );
+	array_free( &results );
+	array_free( &query_aabbs );
+	array_free( &query_directions );
+	array_free( &aabbs );
+	array_free( &user_data );
+	return result;
+}
+
+// Whether `results` holds every entry `expected` flags and nothing else, each once.
+// `seen` has an item per entry, it is left cleared.
+static bool
+bvh_test_results_equal( Array< u32 > *results, Array< u8 > *expected, Array< u8 > *seen ) {
+	bool equal = true;
+	ForIt( results->data, results->size ) {
+		equal &= ( it < expected->size ) && expected->data[ it ] && !seen->data[ it ];
+		if ( it < seen->size )
+			seen->data[ it ] = 1;
+	}}
+	ForIt( expected->data, expected->size ) {
+		equal &= ( it == seen->data[ it_index ] );
+		seen->data[ it_index ] = 0;
+	}}
+	return equal;
+}
+
+BVH_Test bvh_test( u32 entries_count, u32 queries_count ) {
+	BVH_Test test = { .entries_count = entries_count, .queries_count = queries_count };
+	constexpr f32 MARGIN = 0.5f;
+
+	// Fixed seed, so runs are reproducible.
+	u32 random_state = 0xBB67AE85;
+	f32 world_size = 10.0f * sqrtf( ( f32 )entries_count );
+	auto random_aabb = [ & ]( f32 max_extent ) -> AABB {
+		Vector3_f32 center = { QL_random_f32( &random_state, -world_size, world_size ), QL_random_f32( &random_state, -50.0f, 50.0f ), QL_random_f32( &random_state, -world_size, world_size ) };
+		Vector3_f32 extent = { QL_random_f32( &random_state, 0.1f, max_extent ), QL_random_f32( &random_state, 0.1f, max_extent ), QL_random_f32( &random_state, 0.1f, max_extent ) };
+		return AABB { .min = center - extent, .max = center + extent };
+	};
+
+	Array< AABB > aabbs = array_new< AABB >( sys_allocator, entries_count );
+	Array< u32 > user_data = array_new< u32 >( sys_allocator, entries_count );
+	For( entries_count ) {
+		array_add( &aabbs, random_aabb( 4.0f ) );
+		array_add( &user_data, ( u32 )it_index );
+	}
+
+	BVH_Tree static_tree;
+	bvh_init( &static_tree, sys_allocator, entries_count * 2, 0.0f );
+	bvh_build_sah( &static_tree, array_view( &aabbs ), array_view( &user_data ) );
+
+	// The dynamic tree ends up with a third of the boxes removed, a third moved, and as many inserted
+	//   as were removed.  `fat` is the box the tree should keep for every entry.
+	BVH_Tree dynamic_tree;
+	bvh_init( &dynamic_tree, sys_allocator, entries_count * 2, MARGIN );
+	u32 dynamic_entries_count = entries_count + entries_count / 3;
+	Array< BVH_Node_ID > leaves = array_new< BVH_Node_ID >( sys_allocator, dynamic_entries_count );
+	Array< AABB > fat = array_new< AABB >( sys_allocator, dynamic_entries_count );
+	ForIt( aabbs.data, aabbs.size ) {
+		array_add( &leaves, bvh_insert( &dynamic_tree, it, ( u32 )it_index ) );
+		array_add( &fat, aabb_expand( it, MARGIN ) );
+	}}
+	ForIt( leaves.data, leaves.size ) {
+		u32 action = QL_random_u32( &random_state ) % 3;
+		if ( action == 0 ) {
+			bvh_remove( &dynamic_tree, it );
+			it = INVALID_BVH_NODE_ID;
+			test.dynamic_removed_count += 1;
+		} else if ( action == 1 ) {
+			// Half the moves stay within the margin, half jump anywhere.
+			AABB moved = aabbs.data[ it_index ];
+			if ( QL_random_u32( &random_state ) % 2 == 0 ) {
+				Vector3_f32 offset = { QL_random_f32( &random_state, -0.4f, 0.4f ), QL_random_f32( &random_state, -0.4f, 0.4f ), QL_random_f32( &random_state, -0.4f, 0.4f ) };
+				moved = AABB { .min = moved.min + offset, .max = moved.max + offset };
+			} else {
+				moved = random_aabb( 4.0f );
+			}
+			if ( bvh_move( &dynamic_tree, it, moved ) ) {
+				fat.data[ it_index ] = aabb_expand( moved, MARGIN );
+				test.dynamic_reinserted_count += 1;
+			}
+		}
+	}}
+	while ( leaves.size < dynamic_entries_count ) {
+		AABB aabb = random_aabb( 4.0f );
+		array_add( &leaves, bvh_insert( &dynamic_tree, aabb, leaves.size ) );
+		array_add( &fat, aabb_expand( aabb, MARGIN ) );
+	}
+
+	Array< u32 > results = array_new< u32 >( sys_allocator, dynamic_entries_count );
+	Array< u8 > expected = array_new< u8 >( sys_allocator, dynamic_entries_count );
+	Array< u8 > seen = array_new< u8 >( sys_allocator, dynamic_entries_count );
+	array_resize( &seen, dynamic_entries_count );
+	memset( seen.data, 0, seen.size );
+
+	// Fills `expected` from the static tree's boxes, then from the dynamic tree's, with `passes`
+	//   and compares both trees' results with it.
+	auto compare = [ & ]( auto passes, auto query ) {
+		array_clear( &expected );
+		ForIt( aabbs.data, aabbs.size ) {
+			array_add( &expected, ( u8 )passes( it ) );
+		}}
+		array_clear( &results );
+		query( &static_tree );
+		test.static_mismatches_count += !bvh_test_results_equal( &results, &expected, &seen );
+
+		array_clear( &expected );
+		ForIt( fat.data, fat.size ) {
+			array_add( &expected, ( u8 )( leaves.data[ it_index ] != INVALID_BVH_NODE_ID && passes( it ) ) );
+		}}
+		array_clear( &results );
+		query( &dynamic_tree );
+		test.dynamic_mismatches_count += !bvh_test_results_equal( &results, &expected, &seen );
+	};
+
+	For( queries_count ) {
+		Vector3_f32 position = { QL_random_f32( &random_state, -world_size, world_size ), QL_random_f32( &random_state, -20.0f, 20.0f ), QL_random_f32( &random_state, -world_size, world_size ) };
+		Vector3_f32 direction = normalize( Vector3_f32 { QL_random_f32( &random_state, -1.0f, 1.0f ), QL_random_f32( &random_state, -0.3f, 0.3f ), QL_random_f32( &random_state, -1.0f, 1.0f ) } );
+		Matrix4x4_f32 view = camera_view_space_matrix( position, position + direction, Vector3_f32 { 0.0f, 1.0f, 0.0f } );
+		Matrix4x4_f32 projection = camera_projection_perspective( radians( QL_random_f32( &random_state, 30.0f, 90.0f ) ), 16.0f / 9.0f, 0.1f, world_size );
+		Matrix4x4_f32 view_projection = projection * view;
+		Frustum frustum = frustum_from_view_projection( &view_projection );
+		compare(
+			[ & ]( AABB aabb ) { return frustum_test_aabb( &frustum, aabb ); },
+			[ & ]( BVH_Tree *tree ) { bvh_query_frustum( tree, &frustum, &results ); }
+		);
+
+		AABB query_aabb = random_aabb( 20.0f );
+		compare(
+			[ & ]( AABB aabb ) { return aabb_overlaps( aabb, query_aabb ); },
+			[ & ]( BVH_Tree *tree ) { bvh_query_aabb( tree, query_aabb, &results ); }
+		);
+
+		Vector3_f32 center = ( query_aabb.min + query_aabb.max ) * 0.5f;
+		f32 radius = QL_random_f32( &random_state, 1.0f, 30.0f );
+		compare(
+			[ & ]( AABB aabb ) { return aabb_overlaps_sphere( aabb, center, radius ); },
+			[ & ]( BVH_Tree *tree ) { bvh_query_sphere( tree, center, radius, &results ); }
+		);
+	}
+
+	bvh_destroy( &static_tree );
+	bvh_destroy( &dynamic_tree );
+	array_free( &aabbs );
+	array_free( &user_data );
+	array_free( &leaves );
+	array_free( &fat );
+	array_free( &results );
+	array_free( &expected );
+	array_free( &seen );
+	return test;
+}
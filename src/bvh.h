@@ -0,0 +1,109 @@
+#ifndef QLIGHT_BVH_H
+#define QLIGHT_BVH_H
+
+#include "common.h"
+#include "array.h"
+#include "culling.h"
+
+/*
+	Bounding volume hierarchy over axis-aligned boxes.
+
+	A tree is either dynamic or static:
+	- Dynamic trees are built incrementally with `bvh_insert` / `bvh_remove` / `bvh_move`.
+	    Leaves keep "fat" boxes (grown by `margin`), so small moves do not touch the tree.
+	    Inserts pick the cheapest sibling by surface area and rebalance with rotations.
+	- Static trees are built once from all boxes with `bvh_build_sah` (binned surface area heuristic)
+	    and are never refit.  To change them, build them again.
+
+	Each leaf holds one box and a `u32` of user data, queries append the user data
+	  of every leaf that passes to `out_user_data`.  Nothing here touches the map or entities.
+*/
+
+typedef u32 BVH_Node_ID;
+constexpr BVH_Node_ID INVALID_BVH_NODE_ID = U32_MAX;
+
+struct BVH_Node {
+	AABB aabb;
+	BVH_Node_ID parent;  // Next free node while the node is in the free list.
+	BVH_Node_ID child1;  // `INVALID_BVH_NODE_ID` for leaves.
+	BVH_Node_ID child2;
+	s32 height;          // 0 for leaves, -1 for free nodes.
+	u32 user_data;
+};
+
+struct BVH_Traversal_Item {
+	BVH_Node_ID node;
+	u32 plane_mask;  // Frustum queries only.
+};
+
+struct BVH_Tree {
+	Array< BVH_Node > nodes;
+	BVH_Node_ID root;
+	BVH_Node_ID free_list;
+	u32 leaves_count;
+	f32 margin;  // How much leaf boxes are grown in dynamic trees.
+
+	// Reused by queries so they do not allocate.
+	Array< BVH_Traversal_Item > traversal_stack;
+};
+
+void bvh_init( BVH_Tree *tree, Allocator *allocator, u32 initial_capacity, f32 margin );
+void bvh_destroy( BVH_Tree *tree );
+void bvh_clear( BVH_Tree *tree );
+
+// --- Dynamic trees
+
+// Returns the leaf to pass to `bvh_move` and `bvh_remove`.
+BVH_Node_ID bvh_insert( BVH_Tree *tree, AABB aabb, u32 user_data );
+void bvh_remove( BVH_Tree *tree, BVH_Node_ID leaf );
+// Reinserts the leaf only if `aabb` has left its fat box.  Returns true if it was reinserted.
+bool bvh_move( BVH_Tree *tree, BVH_Node_ID leaf, AABB aabb );
+
+// --- Static trees
+
+// Replaces the tree's contents.  `aabbs` and `user_data` have the same size.
+void bvh_build_sah( BVH_Tree *tree, ArrayView< AABB > aabbs, ArrayView< u32 > user_data );
+
+// --- Queries (both kinds)
+
+// Whole subtrees that are inside the frustum are accepted without testing them.
+u32 bvh_query_frustum( BVH_Tree *tree, Frustum *frustum, Array< u32 > *out_user_data );
+u32 bvh_query_aabb( BVH_Tree *tree, AABB aabb, Array< u32 > *out_user_data );
+u32 bvh_query_sphere( BVH_Tree *tree, Vector3_f32 center, f32 radius, Array< u32 > *out_user_data );
+// Leaves whose boxes the segment from `origin` along `direction` up to `max_distance` hits, in no particular order.
+u32 bvh_query_ray( BVH_Tree *tree, Vector3_f32 origin, Vector3_f32 direction, f32 max_distance, Array< u32 > *out_user_data );
+
+s32 bvh_height( BVH_Tree *tree );
+
+struct BVH_Benchmark {
+	u32 entries_count;
+	f64 static_build_milliseconds;   // `bvh_build_sah` of all entries.
+	f64 dynamic_build_milliseconds;  // `bvh_insert` of all entries.
+	f64 dynamic_refit_milliseconds;  // `bvh_move` of all entries by a small random offset.
+	u32 dynamic_reinserted_count;    // How many of those left their fat boxes.
+	f64 static_query_milliseconds;   // `bvh_query_frustum` + 1000 each of AABB, sphere and ray queries.
+	f64 dynamic_query_milliseconds;  // Same as above.
+	u32 static_visible_count;
+	u32 dynamic_visible_count;
+	s32 static_height;
+	s32 dynamic_height;
+};
+
+// Builds both kinds of trees over `entries_count` pseudo-random boxes and times them.  CPU only.
+BVH_Benchmark bvh_benchmark( Matrix4x4_f32 *view_projection, u32 entries_count );
+
+struct BVH_Test {
+	u32 entries_count;
+	u32 queries_count;           // Of every kind, on both trees.
+	u32 dynamic_removed_count;
+	u32 dynamic_reinserted_count;
+	u32 static_mismatches_count;   // Queries whose leaves differ from a test of every box.
+	u32 dynamic_mismatches_count;
+};
+
+// Queries a static tree and a dynamic tree, after removing, moving and inserting some of its boxes,
+//   with frustum, AABB and sphere queries and compares what they find with testing every box.
+// The dynamic tree is compared with the fat boxes its leaves keep.  CPU only.
+BVH_Test bvh_test( u32 entries_count, u32 queries_count );
+
+#endif /* QLIGHT_BVH_H */
@@ -104,6 +104,11 @@ void camera_update_view( Camera *camera ) {
 	camera->view_matrix = camera_view_space_matrix2( camera->position, camera->rotation );
 }
 
+Frustum camera_frustum( Camera *camera ) {
+	Matrix4x4_f32 view_projection = camera->projection_matrix * camera->view_matrix;
+	return frustum_from_view_projection( &view_projection );
+}
+
 static int g_event_index = 0;
 
 void camera_update_projection( Camera *camera ) {
@@ -243,7 +248,7 @@ Matrix4x4_f32 camera_projection_orthographic( f32 x_min, f32 x_max, f32 y_min, f
 
 Matrix4x4_f32 camera_view_space_matrix( Vector3_f32 view_position, Vector3_f32 view_target, Vector3_f32 world_up ) {
 	// Right-handed
-	Vector3_f32 forward = Vector3_f32( normalize( view_position - view_target ) );
+	Vector3_f32 forward = Vector3_f32( normalize( view_target - view_position ) );
 	Vector3_f32 right = Vector3_f32( normalize( cross( forward, world_up ) ) );
 	Vector3_f32 up = Vector3_f32( cross( right, forward ) );
 
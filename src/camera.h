@@ -5,6 +5,7 @@
 #include "string.h"
 #include "math.h"
 #include "transform.h"
+#include "culling.h"
 
 enum Camera_Bit : u64 {
 	CameraBit_IsOrthographic = ( 1 << 0 ),
@@ -65,6 +66,9 @@ void camera_update_view( Camera *camera ); // Always updates view
 void camera_update_projection( Camera *camera ); // Always updates projection
 void camera_update_view_and_rotation( Camera *camera );
 
+// World space frustum of the current view and projection matrices.
+Frustum camera_frustum( Camera *camera );
+
 Vector3_f32 camera_direction_right( Camera *camera );
 Vector3_f32 camera_direction_up( Camera *camera );
 Vector3_f32 camera_direction_forward( Camera *camera );
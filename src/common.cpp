@@ -6,6 +6,7 @@
 // [SECTION] Function: max2
 // [SECTION] Function: abs
 // [SECTION] Function: bool_to_string
+// [SECTION] Function: random
 
 //-----------------------------------------------------------------------------
 // [SECTION] Function: clamp
@@ -120,3 +121,21 @@ const char *QL_bool_to_string(bool value) {
 	if (value)  return "true";
 	return "false";
 }
+
+//-----------------------------------------------------------------------------
+// [SECTION] Function: random
+//-----------------------------------------------------------------------------
+
+u32 QL_random_u32(u32 *state) {
+	u32 x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+f32 QL_random_f32(u32 *state, f32 min, f32 max) {
+	// The top 24 bits, all an f32 mantissa holds.
+	return min + (max - min) * ((f32)(QL_random_u32(state) >> 8) / (f32)(1 << 24));
+}
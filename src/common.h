@@ -18,7 +18,7 @@
 		log_info( "i=%u", i );
 	}
 */
-#define ForNamed( variable, count )  for ( auto variable = ( count & 0 ); variable < count; variable += 1 )
+#define ForNamed( variable, count )  for ( auto variable = ( ( count ) & 0 ); variable < ( count ); variable += 1 )
 
 // Use `s64` so the index can not underflow if `count` is unsigned.
 // It could be countered by checking for `count`'s type max value, but how do you get the type?
@@ -34,7 +34,7 @@
 		log_info( "i=%u", i );
 	}
 */
-#define ForNamedBackwards( variable, count )  for ( s64 variable = count - 1; variable >= 0; variable -= 1 )
+#define ForNamedBackwards( variable, count )  for ( s64 variable = ( count ) - 1; variable >= 0; variable -= 1 )
 
 /*
 	For( 3 ) {
@@ -173,4 +173,9 @@ f64 QL_abs(f64 x);
 
 const char *QL_bool_to_string(bool value);
 
+// xorshift32, `*state` must not be 0.  Repeatable, for benchmarks and tests, not for anything secret.
+u32 QL_random_u32(u32 *state);
+// In [min, max).
+f32 QL_random_f32(u32 *state, f32 min, f32 max);
+
 #endif /* QLIGHT_COMMON_H */
\ No newline at end of file
@@ -1,17 +1,31 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include <stdio.h>
+#include <stdarg.h>
+#include <wchar.h>
 
 #include "console.h"
+#include "platform.h"
+
+#if QLIGHT_PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOSERVICE
+#define NOMCX
+#define NOIME
+#undef APIENTRY
+#include <Windows.h>
+#endif
 
 constexpr const size_t CONSOLE_BUFFER_SIZE = 4096;
 
+#if QLIGHT_PLATFORM_WINDOWS
+
 struct G_Console {
 	HANDLE   input = NULL;
 	HANDLE   output = NULL;
 	  bool   allocated = false;
 } g_console;
 
-bool console_init( UINT code_page_id, const wchar_t *title_wide ) {
+bool console_init( const wchar_t *title_wide ) {
 	if ( g_console.allocated )
 		return false;
 
@@ -31,8 +45,8 @@ bool console_init( UINT code_page_id, const wchar_t *title_wide ) {
 	g_console.allocated = true;
 
 	// Make sure Unicode characters will be displayed properly.
-	SetConsoleCP( code_page_id );
-	SetConsoleOutputCP( code_page_id );
+	SetConsoleCP( CP_UTF8 );
+	SetConsoleOutputCP( CP_UTF8 );
 
 	// Enable processing of ANSI escape codes (changing foreground color, etc.).
 	DWORD console_mode;
@@ -55,15 +69,6 @@ void console_free() {
 	g_console.allocated = false;
 }
 
-void console_print_to( HANDLE output_handle, const char *format, ... ) {
-	va_list var_args;
-	va_start( var_args, format );
-
-	char buffer[ CONSOLE_BUFFER_SIZE ];
-	int written = vsnprintf( buffer, CONSOLE_BUFFER_SIZE, format, var_args );
-	WriteConsoleA( output_handle, buffer, static_cast< size_t >( written ), NULL, NULL );
-}
-
 void console_print( const char *format, ... ) {
 	if ( !g_console.allocated )
 		return;
@@ -73,7 +78,8 @@ void console_print( const char *format, ... ) {
 
 	char buffer[ CONSOLE_BUFFER_SIZE ];
 	int written = vsnprintf( buffer, CONSOLE_BUFFER_SIZE, format, var_args );
-	WriteConsoleA( g_console.output, buffer, static_cast< size_t >( written ), NULL, NULL );
+	va_end( var_args );
+	WriteConsoleA( g_console.output, buffer, static_cast< DWORD >( written ), NULL, NULL );
 }
 
 void console_print_unformatted( StringView_ASCII message ) {
@@ -83,23 +89,96 @@ void console_print_unformatted( StringView_ASCII message ) {
 	WriteConsoleA( g_console.output, message.data, ( DWORD )message.size, NULL, NULL );
 }
 
-void console_print_to_wide( HANDLE output_handle, const wchar_t *format_wide, ... ) {
+void console_print_wide( const wchar_t *format_wide, ... ) {
+	if ( !g_console.allocated )
+		return;
+
 	va_list var_args;
 	va_start( var_args, format_wide );
 
 	wchar_t buffer[ CONSOLE_BUFFER_SIZE ];
 	int written = _vsnwprintf( buffer, CONSOLE_BUFFER_SIZE, format_wide, var_args );
-	WriteConsoleW( output_handle, buffer, static_cast< size_t >( written ), NULL, NULL );
+	va_end( var_args );
+	WriteConsoleW( g_console.output, buffer, static_cast< DWORD >( written ), NULL, NULL );
+}
+
+#else
+
+// Terminals take UTF-8 and ANSI escape codes as they are, so there is nothing to set up.
+struct G_Console {
+	bool initialized = false;
+} g_console;
+
+// The title is left to the terminal.
+bool console_init( const wchar_t *title_wide ) {
+	if ( g_console.initialized )
+		return false;
+
+	g_console.initialized = true;
+	return true;
 }
 
+void console_free() {
+	if ( !g_console.initialized )
+		return;
+
+	fflush( stdout );
+	g_console.initialized = false;
+}
+
+void console_print( const char *format, ... ) {
+	if ( !g_console.initialized )
+		return;
+
+	va_list var_args;
+	va_start( var_args, format );
+	vfprintf( stdout, format, var_args );
+	va_end( var_args );
+}
+
+void console_print_unformatted( StringView_ASCII message ) {
+	if ( !g_console.initialized )
+		return;
+
+	fwrite( message.data, 1, message.size, stdout );
+}
+
+// `wchar_t` holds UTF-32 here.  It is encoded by hand, because a byte-oriented `stdout`
+//   does not take wide output and the locale may not be UTF-8.
 void console_print_wide( const wchar_t *format_wide, ... ) {
-	if ( !g_console.allocated )
+	if ( !g_console.initialized )
 		return;
 
 	va_list var_args;
 	va_start( var_args, format_wide );
 
 	wchar_t buffer[ CONSOLE_BUFFER_SIZE ];
-	int written = _vsnwprintf( buffer, CONSOLE_BUFFER_SIZE, format_wide, var_args );
-	WriteConsoleW( g_console.output, buffer, static_cast< size_t >( written ), NULL, NULL );
+	int written = vswprintf( buffer, CONSOLE_BUFFER_SIZE, format_wide, var_args );
+	va_end( var_args );
+	if ( written < 0 )
+		written = ( int )wcsnlen( buffer, CONSOLE_BUFFER_SIZE - 1 );
+
+	char utf8[ CONSOLE_BUFFER_SIZE * 4 ];
+	size_t size = 0;
+	for ( int char_idx = 0; char_idx < written; char_idx += 1 ) {
+		u32 code_point = ( u32 )buffer[ char_idx ];
+		if ( code_point < 0x80 ) {
+			utf8[ size++ ] = ( char )code_point;
+		} else if ( code_point < 0x800 ) {
+			utf8[ size++ ] = ( char )( 0xC0 | ( code_point >> 6 ) );
+			utf8[ size++ ] = ( char )( 0x80 | ( code_point & 0x3F ) );
+		} else if ( code_point < 0x10000 ) {
+			utf8[ size++ ] = ( char )( 0xE0 | ( code_point >> 12 ) );
+			utf8[ size++ ] = ( char )( 0x80 | ( ( code_point >> 6 ) & 0x3F ) );
+			utf8[ size++ ] = ( char )( 0x80 | ( code_point & 0x3F ) );
+		} else {
+			utf8[ size++ ] = ( char )( 0xF0 | ( code_point >> 18 ) );
+			utf8[ size++ ] = ( char )( 0x80 | ( ( code_point >> 12 ) & 0x3F ) );
+			utf8[ size++ ] = ( char )( 0x80 | ( ( code_point >> 6 ) & 0x3F ) );
+			utf8[ size++ ] = ( char )( 0x80 | ( code_point & 0x3F ) );
+		}
+	}
+	fwrite( utf8, 1, size, stdout );
 }
+
+#endif
@@ -1,13 +1,6 @@
 #ifndef QLIGHT_CONSOLE_H
 #define QLIGHT_CONSOLE_H
 
-#define WIN32_LEAN_AND_MEAN
-#define NOSERVICE
-#define NOMCX
-#define NOIME
-#undef APIENTRY
-#include <Windows.h>
-
 #include "common.h"
 #include "string.h"
 
@@ -25,16 +18,16 @@
 // 256-bit colors
 #define QL_COLOR_GRAY     "\x1b[38;5;244m"
 
-bool console_init( UINT code_page_id, const wchar_t *title_wide = NULL );
+// Switches the console to UTF-8 and ANSI escape codes.  On Windows, allocates one if the process has none,
+//   elsewhere prints to the standard output of the process.
+bool console_init( const wchar_t *title_wide = NULL );
 void console_free();
 
 // UTF-8:
-void console_print_to( HANDLE output_handle, const char *format, ... );
 void console_print( const char *format, ... );
 void console_print_unformatted( StringView_ASCII message );
 
-// UTF-16:
-void console_print_to_wide( HANDLE output_handle, const wchar_t *format, ... );
+// UTF-16 on Windows, UTF-32 elsewhere:
 void console_print_wide( const wchar_t *format_wide, ... );
 
 #endif /* QLIGHT_CONSOLE_H */
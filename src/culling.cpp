@@ -0,0 +1,317 @@
+#include <xmmintrin.h>
+#include <math.h>
+#include <chrono>
+
+#include "culling.h"
+#include "array.h"
+#include "camera.h"
+
+AABB aabb_empty() {
+	AABB aabb = {
+		.min = Vector3_f32 {  INFINITY,  INFINITY,  INFINITY },
+		.max = Vector3_f32 { -INFINITY, -INFINITY, -INFINITY }
+	};
+	return aabb;
+}
+
+void aabb_add_point( AABB *aabb, Vector3_f32 point ) {
+	if ( point.x < aabb->min.x ) aabb->min.x = point.x;
+	if ( point.y < aabb->min.y ) aabb->min.y = point.y;
+	if ( point.z < aabb->min.z ) aabb->min.z = point.z;
+	if ( point.x > aabb->max.x ) aabb->max.x = point.x;
+	if ( point.y > aabb->max.y ) aabb->max.y = point.y;
+	if ( point.z > aabb->max.z ) aabb->max.z = point.z;
+}
+
+AABB aabb_transform( AABB aabb, Matrix4x4_f32 *matrix ) {
+	// Transform the center, then project the extents onto the world axes
+	//   (Arvo, "Transforming Axis-Aligned Bounding Boxes").
+	Vector3_f32 center = ( aabb.min + aabb.max ) * 0.5f;
+	Vector3_f32 extent = ( aabb.max - aabb.min ) * 0.5f;
+
+	Vector4_f32 *m = matrix->columns;
+	Vector3_f32 world_center = {
+		m[ 0 ].x * center.x  +  m[ 1 ].x * center.y  +  m[ 2 ].x * center.z  +  m[ 3 ].x,
+		m[ 0 ].y * center.x  +  m[ 1 ].y * center.y  +  m[ 2 ].y * center.z  +  m[ 3 ].y,
+		m[ 0 ].z * center.x  +  m[ 1 ].z * center.y  +  m[ 2 ].z * center.z  +  m[ 3 ].z
+	};
+	Vector3_f32 world_extent = {
+		fabsf( m[ 0 ].x ) * extent.x  +  fabsf( m[ 1 ].x ) * extent.y  +  fabsf( m[ 2 ].x ) * extent.z,
+		fabsf( m[ 0 ].y ) * extent.x  +  fabsf( m[ 1 ].y ) * extent.y  +  fabsf( m[ 2 ].y ) * extent.z,
+		fabsf( m[ 0 ].z ) * extent.x  +  fabsf( m[ 1 ].z ) * extent.y  +  fabsf( m[ 2 ].z ) * extent.z
+	};
+
+	AABB result = {
+		.min = world_center - world_extent,
+		.max = world_center + world_extent
+	};
+	return result;
+}
+
+AABB aabb_expand( AABB aabb, f32 margin ) {
+	Vector3_f32 offset = { margin, margin, margin };
+	AABB result = { .min = aabb.min - offset, .max = aabb.max + offset };
+	return result;
+}
+
+bool aabb_overlaps_sphere( AABB aabb, Vector3_f32 center, f32 radius ) {
+	// Distance from the sphere's center to the closest point of the box.
+	Vector3_f32 closest = {
+		QL_clamp( center.x, aabb.min.x, aabb.max.x ),
+		QL_clamp( center.y, aabb.min.y, aabb.max.y ),
+		QL_clamp( center.z, aabb.min.z, aabb.max.z )
+	};
+	Vector3_f32 delta = center - closest;
+	f32 distance_squared = delta.x * delta.x  +  delta.y * delta.y  +  delta.z * delta.z;
+	return ( distance_squared <= radius * radius );
+}
+
+bool aabb_intersects_ray( AABB aabb, Vector3_f32 origin, Vector3_f32 one_over_direction, f32 max_distance, f32 *out_distance ) {
+	// Slab test.
+	f32 t1 = ( aabb.min.x - origin.x ) * one_over_direction.x;
+	f32 t2 = ( aabb.max.x - origin.x ) * one_over_direction.x;
+	f32 t_min = QL_min2( t1, t2 );
+	f32 t_max = QL_max2( t1, t2 );
+
+	t1 = ( aabb.min.y - origin.y ) * one_over_direction.y;
+	t2 = ( aabb.max.y - origin.y ) * one_over_direction.y;
+	t_min = QL_max2( t_min, QL_min2( t1, t2 ) );
+	t_max = QL_min2( t_max, QL_max2( t1, t2 ) );
+
+	t1 = ( aabb.min.z - origin.z ) * one_over_direction.z;
+	t2 = ( aabb.max.z - origin.z ) * one_over_direction.z;
+	t_min = QL_max2( t_min, QL_min2( t1, t2 ) );
+	t_max = QL_min2( t_max, QL_max2( t1, t2 ) );
+
+	t_min = QL_max2( t_min, 0.0f );
+	if ( t_max < t_min || t_min > max_distance )
+		return false;
+
+	*out_distance = t_min;
+	return true;
+}
+
+static Vector4_f32 plane_normalize( Vector4_f32 plane ) {
+	f32 length = sqrtf( plane.x * plane.x  +  plane.y * plane.y  +  plane.z * plane.z );
+	f32 one_over_length = ( length > 0.0f ) ? 1.0f / length : 0.0f;
+	Vector4_f32 result = { plane.x * one_over_length, plane.y * one_over_length, plane.z * one_over_length, plane.w * one_over_length };
+	return result;
+}
+
+Frustum frustum_from_view_projection( Matrix4x4_f32 *view_projection ) {
+	// Gribb & Hartmann: planes are sums and differences of the matrix rows.
+	// Matrix is column-major, so row `i` is `columns[ 0..3 ][ i ]`.
+	Vector4_f32 *c = view_projection->columns;
+	Vector4_f32 row0 = { c[ 0 ].x, c[ 1 ].x, c[ 2 ].x, c[ 3 ].x };
+	Vector4_f32 row1 = { c[ 0 ].y, c[ 1 ].y, c[ 2 ].y, c[ 3 ].y };
+	Vector4_f32 row2 = { c[ 0 ].z, c[ 1 ].z, c[ 2 ].z, c[ 3 ].z };
+	Vector4_f32 row3 = { c[ 0 ].w, c[ 1 ].w, c[ 2 ].w, c[ 3 ].w };
+
+	Frustum frustum;
+	frustum.planes[ FrustumPlane_Left ]   = plane_normalize( row3 + row0 );
+	frustum.planes[ FrustumPlane_Right ]  = plane_normalize( row3 - row0 );
+	frustum.planes[ FrustumPlane_Bottom ] = plane_normalize( row3 + row1 );
+	frustum.planes[ FrustumPlane_Top ]    = plane_normalize( row3 - row1 );
+	frustum.planes[ FrustumPlane_Near ]   = plane_normalize( row3 + row2 );
+	frustum.planes[ FrustumPlane_Far ]    = plane_normalize( row3 - row2 );
+	return frustum;
+}
+
+bool frustum_test_aabb( Frustum *frustum, AABB aabb ) {
+	Vector3_f32 center = ( aabb.min + aabb.max ) * 0.5f;
+	Vector3_f32 extent = ( aabb.max - aabb.min ) * 0.5f;
+	ForIt( frustum->planes, FrustumPlane_COUNT ) {
+		// Distance of the box's corner that is the farthest along the plane normal.
+		f32 distance = it.x * center.x  +  it.y * center.y  +  it.z * center.z  +  it.w;
+		f32 radius = fabsf( it.x ) * extent.x  +  fabsf( it.y ) * extent.y  +  fabsf( it.z ) * extent.z;
+		if ( distance + radius < 0.0f )
+			return false;
+	}}
+
+	return true;
+}
+
+Frustum_Test frustum_classify_aabb( Frustum *frustum, AABB aabb, u32 plane_mask, u32 *out_plane_mask ) {
+	Vector3_f32 center = ( aabb.min + aabb.max ) * 0.5f;
+	Vector3_f32 extent = ( aabb.max - aabb.min ) * 0.5f;
+	u32 straddled = 0;
+	ForIt( frustum->planes, FrustumPlane_COUNT ) {
+		if ( ( plane_mask & ( 1 << it_index ) ) == 0 )
+			continue;
+
+		f32 distance = it.x * center.x  +  it.y * center.y  +  it.z * center.z  +  it.w;
+		f32 radius = fabsf( it.x ) * extent.x  +  fabsf( it.y ) * extent.y  +  fabsf( it.z ) * extent.z;
+		if ( distance + radius < 0.0f )
+			return FrustumTest_Outside;
+
+		if ( distance - radius < 0.0f )
+			straddled |= ( 1 << it_index );
+	}}
+
+	*out_plane_mask = straddled;
+	return ( straddled ) ? FrustumTest_Intersects : FrustumTest_Inside;
+}
+
+void aabb_blocks_set( AABB_Block4 *blocks, u32 aabb_index, AABB aabb ) {
+	AABB_Block4 *block = &blocks[ aabb_index / AABB_BLOCK_WIDTH ];
+	u32 lane = aabb_index % AABB_BLOCK_WIDTH;
+	block->center_x[ lane ] = ( aabb.min.x + aabb.max.x ) * 0.5f;
+	block->center_y[ lane ] = ( aabb.min.y + aabb.max.y ) * 0.5f;
+	block->center_z[ lane ] = ( aabb.min.z + aabb.max.z ) * 0.5f;
+	block->extent_x[ lane ] = ( aabb.max.x - aabb.min.x ) * 0.5f;
+	block->extent_y[ lane ] = ( aabb.max.y - aabb.min.y ) * 0.5f;
+	block->extent_z[ lane ] = ( aabb.max.z - aabb.min.z ) * 0.5f;
+}
+
+// Tests all boxes of the block against one plane per iteration.
+// Returns a mask with a bit set for every box that intersects the frustum.
+static u32 frustum_cull_block( Frustum *frustum, AABB_Block4 *block ) {
+	__m128 center_x = _mm_loadu_ps( block->center_x );
+	__m128 center_y = _mm_loadu_ps( block->center_y );
+	__m128 center_z = _mm_loadu_ps( block->center_z );
+	__m128 extent_x = _mm_loadu_ps( block->extent_x );
+	__m128 extent_y = _mm_loadu_ps( block->extent_y );
+	__m128 extent_z = _mm_loadu_ps( block->extent_z );
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 inside = _mm_cmpeq_ps( zero, zero );  // All bits set.
+	ForIt( frustum->planes, FrustumPlane_COUNT ) {
+		__m128 plane_x = _mm_set1_ps( it.x );
+		__m128 plane_y = _mm_set1_ps( it.y );
+		__m128 plane_z = _mm_set1_ps( it.z );
+		__m128 plane_w = _mm_set1_ps( it.w );
+
+		// Summed in the order `frustum_test_aabb()` sums, so both round the same way.
+		__m128 distance = _mm_add_ps(
+			_mm_add_ps( _mm_add_ps( _mm_mul_ps( plane_x, center_x ), _mm_mul_ps( plane_y, center_y ) ), _mm_mul_ps( plane_z, center_z ) ),
+			plane_w
+		);
+		__m128 radius = _mm_add_ps(
+			_mm_add_ps( _mm_mul_ps( _mm_set1_ps( fabsf( it.x ) ), extent_x ), _mm_mul_ps( _mm_set1_ps( fabsf( it.y ) ), extent_y ) ),
+			_mm_mul_ps( _mm_set1_ps( fabsf( it.z ) ), extent_z )
+		);
+
+		inside = _mm_and_ps( inside, _mm_cmpge_ps( _mm_add_ps( distance, radius ), zero ) );
+	}}
+
+	return ( u32 )_mm_movemask_ps( inside );
+}
+
+u32 frustum_cull_aabb_blocks( Frustum *frustum, AABB_Block4 *blocks, u32 count, u8 *out_visible ) {
+	u32 visible_count = 0;
+	u32 blocks_count = aabb_blocks_count( count );
+	ForIt( blocks, blocks_count ) {
+		u32 mask = frustum_cull_block( frustum, &it );
+		u32 first_aabb = it_index * AABB_BLOCK_WIDTH;
+		u32 lanes = ( count - first_aabb < AABB_BLOCK_WIDTH ) ? count - first_aabb : AABB_BLOCK_WIDTH;
+		For2( lanes ) {
+			u8 visible = ( mask >> it2_index ) & 1;
+			out_visible[ first_aabb + it2_index ] = visible;
+			visible_count += visible;
+		}
+	}}
+
+	return visible_count;
+}
+
+Culling_Benchmark culling_benchmark( Matrix4x4_f32 *view_projection, u32 objects_count ) {
+	Frustum frustum = frustum_from_view_projection( view_projection );
+
+	Array< AABB > aabbs = array_new< AABB >( sys_allocator, objects_count );
+	Array< AABB_Block4 > blocks = array_new< AABB_Block4 >( sys_allocator, aabb_blocks_count( objects_count ) );
+	Array< u8 > visible = array_new< u8 >( sys_allocator, objects_count );
+
+	// Fixed seed, so runs are reproducible.
+	u32 random_state = 0x9E3779B9;
+
+	For( objects_count ) {
+		Vector3_f32 center = { QL_random_f32( &random_state, -500.0f, 500.0f ), QL_random_f32( &random_state, -50.0f, 50.0f ), QL_random_f32( &random_state, -500.0f, 500.0f ) };
+		Vector3_f32 extent = { QL_random_f32( &random_state, 0.1f, 4.0f ), QL_random_f32( &random_state, 0.1f, 4.0f ), QL_random_f32( &random_state, 0.1f, 4.0f ) };
+		AABB aabb = { .min = center - extent, .max = center + extent };
+		array_add( &aabbs, aabb );
+		aabb_blocks_set( blocks.data, it_index, aabb );
+	}
+	blocks.size = aabb_blocks_count( objects_count );
+	visible.size = objects_count;
+
+	Culling_Benchmark result = { .objects_count = objects_count };
+
+	auto scalar_start = std::chrono::steady_clock::now();
+	u32 scalar_visible_count = 0;
+	ForIt( aabbs.data, aabbs.size ) {
+		scalar_visible_count += frustum_test_aabb( &frustum, it );
+	}}
+	auto scalar_end = std::chrono::steady_clock::now();
+
+	auto blocks_start = std::chrono::steady_clock::now();
+	result.visible_count = frustum_cull_aabb_blocks( &frustum, blocks.data, objects_count, visible.data );
+	auto blocks_end = std::chrono::steady_clock::now();
+
+	AssertMessage( scalar_visible_count == result.visible_count, "Scalar and batched frustum tests disagree" );
+	result.scalar_milliseconds = std::chrono::duration< f64, std::milli >( scalar_end - scalar_start ).count();
+	result.blocks_milliseconds = std::chrono::duration< f64, std::milli >( blocks_end - blocks_start ).count();
+
+	array_free( &aabbs );
+	array_free( &blocks );
+	array_free( &visible );
+	return result;
+}
+
+Culling_Test culling_test( u32 scenes_count, u32 objects_count ) {
+	Culling_Test test = { .scenes_count = scenes_count, .objects_count = objects_count };
+	Array< AABB > aabbs = array_new< AABB >( sys_allocator, objects_count );
+	Array< AABB_Block4 > blocks = array_new< AABB_Block4 >( sys_allocator, aabb_blocks_count( objects_count ) );
+	Array< u8 > visible = array_new< u8 >( sys_allocator, objects_count );
+	blocks.size = aabb_blocks_count( objects_count );
+	visible.size = objects_count;
+
+	// Fixed seed, so runs are reproducible.
+	u32 random_state = 0x3C6EF372;
+	For( scenes_count ) {
+		Vector3_f32 position = { QL_random_f32( &random_state, -100.0f, 100.0f ), QL_random_f32( &random_state, -100.0f, 100.0f ), QL_random_f32( &random_state, -100.0f, 100.0f ) };
+		Vector3_f32 direction = normalize( Vector3_f32 { QL_random_f32( &random_state, -1.0f, 1.0f ), QL_random_f32( &random_state, -0.5f, 0.5f ), QL_random_f32( &random_state, -1.0f, 1.0f ) } );
+		f32 z_far = QL_random_f32( &random_state, 50.0f, 500.0f );
+		Matrix4x4_f32 view = camera_view_space_matrix( position, position + direction, Vector3_f32 { 0.0f, 1.0f, 0.0f } );
+		Matrix4x4_f32 projection = camera_projection_perspective(
+			radians( QL_random_f32( &random_state, 30.0f, 100.0f ) ),
+			QL_random_f32( &random_state, 1.0f, 2.5f ),
+			QL_random_f32( &random_state, 0.05f, 1.0f ),
+			z_far
+		);
+		Matrix4x4_f32 view_projection = projection * view;
+		Frustum frustum = frustum_from_view_projection( &view_projection );
+
+		For2( objects_count ) {
+			Vector3_f32 center = position + Vector3_f32 {
+				QL_random_f32( &random_state, -z_far, z_far ),
+				QL_random_f32( &random_state, -z_far, z_far ),
+				QL_random_f32( &random_state, -z_far, z_far )
+			};
+			Vector3_f32 extent = { QL_random_f32( &random_state, 0.01f, 20.0f ), QL_random_f32( &random_state, 0.01f, 20.0f ), QL_random_f32( &random_state, 0.01f, 20.0f ) };
+			// Every other box is moved to just touch a plane from outside, where rounding decides.
+			if ( it2_index % 2 == 1 ) {
+				Vector4_f32 plane = frustum.planes[ QL_random_u32( &random_state ) % FrustumPlane_COUNT ];
+				f32 distance = plane.x * center.x  +  plane.y * center.y  +  plane.z * center.z  +  plane.w;
+				f32 radius = fabsf( plane.x ) * extent.x  +  fabsf( plane.y ) * extent.y  +  fabsf( plane.z ) * extent.z;
+				f32 offset = distance + radius;
+				center = center - Vector3_f32 { plane.x, plane.y, plane.z } * offset;
+			}
+			AABB aabb = { .min = center - extent, .max = center + extent };
+			aabbs.data[ it2_index ] = aabb;
+			aabb_blocks_set( blocks.data, it2_index, aabb );
+		}
+		aabbs.size = objects_count;
+
+		u32 visible_count = frustum_cull_aabb_blocks( &frustum, blocks.data, objects_count, visible.data );
+		test.visible_count += visible_count;
+		ForIt( aabbs.data, aabbs.size ) {
+			if ( frustum_test_aabb( &frustum, it ) != ( visible.data[ it_index ] != 0 ) )
+				test.mismatches_count += 1;
+		}}
+	}
+
+	array_free( &aabbs );
+	array_free( &blocks );
+	array_free( &visible );
+	return test;
+}
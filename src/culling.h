@@ -0,0 +1,139 @@
+#ifndef QLIGHT_CULLING_H
+#define QLIGHT_CULLING_H
+
+#include "common.h"
+#include "math.h"
+
+/*
+	Visibility tests against the camera frustum.
+
+	Bounds are axis-aligned boxes.  For batched tests they are stored four at a time
+	  in `AABB_Block4` (structure of arrays), so one SSE iteration tests four boxes
+	  against a plane.
+*/
+
+struct AABB {
+	Vector3_f32 min;
+	Vector3_f32 max;
+};
+
+// Plane `xyz` is the normal pointing inside the frustum, `w` is the distance.
+// A point `p` is inside when `dot( xyz, p ) + w >= 0`.
+enum Frustum_Plane : u8 {
+	FrustumPlane_Left = 0,
+	FrustumPlane_Right,
+	FrustumPlane_Bottom,
+	FrustumPlane_Top,
+	FrustumPlane_Near,
+	FrustumPlane_Far,
+
+	FrustumPlane_COUNT
+};
+
+struct Frustum {
+	Vector4_f32 planes[ FrustumPlane_COUNT ];
+};
+
+constexpr u32 AABB_BLOCK_WIDTH = 4;
+
+// `AABB_BLOCK_WIDTH` boxes in center-extent form.
+struct AABB_Block4 {
+	f32 center_x[ AABB_BLOCK_WIDTH ];
+	f32 center_y[ AABB_BLOCK_WIDTH ];
+	f32 center_z[ AABB_BLOCK_WIDTH ];
+	f32 extent_x[ AABB_BLOCK_WIDTH ];
+	f32 extent_y[ AABB_BLOCK_WIDTH ];
+	f32 extent_z[ AABB_BLOCK_WIDTH ];
+};
+
+inline u32 aabb_blocks_count( u32 aabbs_count ) {
+	return ( aabbs_count + AABB_BLOCK_WIDTH - 1 ) / AABB_BLOCK_WIDTH;
+}
+
+AABB aabb_empty();
+void aabb_add_point( AABB *aabb, Vector3_f32 point );
+// Bounds of `aabb` after transforming it with an affine `matrix`.
+AABB aabb_transform( AABB aabb, Matrix4x4_f32 *matrix );
+AABB aabb_expand( AABB aabb, f32 margin );
+
+// These are on every tree traversal step, so they are inline.
+inline AABB aabb_union( AABB a, AABB b ) {
+	AABB result;
+	result.min.x = ( a.min.x < b.min.x ) ? a.min.x : b.min.x;
+	result.min.y = ( a.min.y < b.min.y ) ? a.min.y : b.min.y;
+	result.min.z = ( a.min.z < b.min.z ) ? a.min.z : b.min.z;
+	result.max.x = ( a.max.x > b.max.x ) ? a.max.x : b.max.x;
+	result.max.y = ( a.max.y > b.max.y ) ? a.max.y : b.max.y;
+	result.max.z = ( a.max.z > b.max.z ) ? a.max.z : b.max.z;
+	return result;
+}
+
+inline f32 aabb_surface_area( AABB aabb ) {
+	f32 x = aabb.max.x - aabb.min.x;
+	f32 y = aabb.max.y - aabb.min.y;
+	f32 z = aabb.max.z - aabb.min.z;
+	return 2.0f * ( x * y  +  y * z  +  z * x );
+}
+
+inline bool aabb_contains( AABB outer, AABB inner ) {
+	return
+		outer.min.x <= inner.min.x  &&  outer.min.y <= inner.min.y  &&  outer.min.z <= inner.min.z  &&
+		outer.max.x >= inner.max.x  &&  outer.max.y >= inner.max.y  &&  outer.max.z >= inner.max.z;
+}
+
+inline bool aabb_overlaps( AABB a, AABB b ) {
+	return
+		a.min.x <= b.max.x  &&  a.min.y <= b.max.y  &&  a.min.z <= b.max.z  &&
+		a.max.x >= b.min.x  &&  a.max.y >= b.min.y  &&  a.max.z >= b.min.z;
+}
+
+bool aabb_overlaps_sphere( AABB aabb, Vector3_f32 center, f32 radius );
+// `one_over_direction` is `1 / direction` per component, infinities are fine.
+// Writes the entry distance into `out_distance` on hit.
+bool aabb_intersects_ray( AABB aabb, Vector3_f32 origin, Vector3_f32 one_over_direction, f32 max_distance, f32 *out_distance );
+
+// Extracts planes from a projection * view matrix with OpenGL's [-1; 1] clip space depth.
+Frustum frustum_from_view_projection( Matrix4x4_f32 *view_projection );
+bool frustum_test_aabb( Frustum *frustum, AABB aabb );
+
+enum Frustum_Test : u8 {
+	FrustumTest_Outside = 0,
+	FrustumTest_Intersects,
+	FrustumTest_Inside
+};
+
+// Bit `i` of a plane mask is set when plane `i` still has to be tested.
+constexpr u32 FRUSTUM_PLANE_MASK_ALL = ( 1 << FrustumPlane_COUNT ) - 1;
+
+// Tests `aabb` against the planes in `plane_mask` only.  `out_plane_mask` gets the planes
+//   the box straddles, so children of a hierarchy can skip the planes their parent is fully inside of.
+Frustum_Test frustum_classify_aabb( Frustum *frustum, AABB aabb, u32 plane_mask, u32 *out_plane_mask );
+
+void aabb_blocks_set( AABB_Block4 *blocks, u32 aabb_index, AABB aabb );
+// Writes 1 to `out_visible[ i ]` for every of `count` boxes in `blocks` that intersects the frustum, 0 otherwise.
+// Returns the number of visible boxes.
+u32 frustum_cull_aabb_blocks( Frustum *frustum, AABB_Block4 *blocks, u32 count, u8 *out_visible );
+
+struct Culling_Benchmark {
+	u32 objects_count;
+	u32 visible_count;
+	f64 scalar_milliseconds;  // One `frustum_test_aabb` per box.
+	f64 blocks_milliseconds;  // `frustum_cull_aabb_blocks` over all boxes.
+};
+
+// Culls `objects_count` pseudo-random boxes scattered around the view of `view_projection`
+//   with both the scalar and the batched test, and times them.  CPU only.
+Culling_Benchmark culling_benchmark( Matrix4x4_f32 *view_projection, u32 objects_count );
+
+struct Culling_Test {
+	u32 scenes_count;
+	u32 objects_count;     // Per scene.
+	u32 visible_count;     // Summed over the scenes.
+	u32 mismatches_count;  // Boxes `frustum_cull_aabb_blocks` and `frustum_test_aabb` disagree on.
+};
+
+// Culls pseudo-random boxes from pseudo-random cameras with both the batched and the scalar test,
+//   half of them moved to touch a frustum plane.  CPU only.
+Culling_Test culling_test( u32 scenes_count, u32 objects_count );
+
+#endif /* QLIGHT_CULLING_H */
@@ -5,6 +5,8 @@
 #include "transform.h"
 #include "model.h"
 #include "camera.h"
+#include "bvh.h"
+#include "renderer.h"
 #include "math.h"
 
 enum Entity_Type : u16 {
@@ -23,7 +25,8 @@ enum Entity_Type : u16 {
 };
 
 enum EEntity_Bits : u32 {
-	EntityBit_NoDraw = ( 1 << 0 )
+	EntityBit_NoDraw = ( 1 << 0 ),
+	EntityBit_Occluder = ( 1 << 1 )  // Hides what is behind its bounds from drawing, see `map_draw()`.
 };
 typedef u16 Entity_Bits;
 
@@ -48,10 +51,20 @@ struct Entity_Camera : Entity {
 
 struct Entity_Static_Object : Entity {
 	Model_ID model;
+	// Model's mesh bounds in world space, updated when the transform's matrices are recalculated.
+	AABB world_bounds;
+	// Created by `map_entity_add()`, updated together with `world_bounds`.
+	Renderer_Proxy_ID render_proxy;
 };
 
 struct Entity_Dynamic_Object : Entity {
 	Model_ID model;
+	// Model's mesh bounds in world space, updated when the transform's matrices are recalculated.
+	AABB world_bounds;
+	// Leaf in the map's dynamic tree, `INVALID_BVH_NODE_ID` until the first `map_draw()`.
+	BVH_Node_ID bvh_leaf;
+	// Created by `map_entity_add()`, updated together with `world_bounds`.
+	Renderer_Proxy_ID render_proxy;
 };
 
 struct Entity_Directional_Light : Entity {
@@ -62,11 +75,13 @@ struct Entity_Directional_Light : Entity {
 struct Entity_Point_Light : Entity {
 	Vector3_f32 color;
 	f32 intensity;
+	f32 radius;  // Light fades out to nothing at this distance, it is binned into the clusters it reaches.
 };
 
 struct Entity_Spot_Light : Entity {
 	Vector3_f32 color;
 	f32 intensity;
+	f32 radius;  // Same as `Entity_Point_Light::radius`.
 };
 
 inline bool
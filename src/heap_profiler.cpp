@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+
+#include "heap_profiler.h"
+
+#define QL_LOG_CHANNEL "Heap"
+#include "log.h"
+
+constexpr u32 HEAP_BLOCK_MAGIC = 0x48454150;  // 'HEAP'
+// Callsites that did not fit into the table.
+constexpr u32 HEAP_OVERFLOW_CALLSITE_IDX = HEAP_PROFILER_MAX_CALLSITES;
+
+static_assert( ( HEAP_PROFILER_MAX_CALLSITES & ( HEAP_PROFILER_MAX_CALLSITES - 1 ) ) == 0, "HEAP_PROFILER_MAX_CALLSITES must be a power of 2" );
+
+// In front of every tracked block.  16 bytes, so the block keeps the backing allocator's alignment.
+struct Heap_Block_Header {
+	u64 size;
+	u32 callsite_idx;
+	u32 magic;
+};
+static_assert( sizeof( Heap_Block_Header ) == 16, "Heap_Block_Header must keep blocks 16 bytes aligned" );
+
+// Own cache line each, threads allocating at different callsites do not share counters.
+struct alignas( 64 ) Heap_Callsite {
+	std::atomic< u64 > key;     // 0 - the slot is free.
+	std::atomic< bool > ready;  // `caller` is written.
+	CallerInfo caller;
+
+	std::atomic< s64 > live_bytes;
+	std::atomic< s64 > peak_bytes;
+	std::atomic< s64 > live_count;
+	std::atomic< u64 > allocations_count;
+	std::atomic< u64 > allocated_bytes;
+};
+
+struct Heap_Profiler {
+	Heap_Callsite callsites[ HEAP_PROFILER_MAX_CALLSITES + 1 ];  // The last one is the overflow.
+	std::atomic< u32 > callsites_count;
+
+	alignas( 64 ) std::atomic< s64 > live_bytes;
+	std::atomic< s64 > peak_bytes;
+	std::atomic< s64 > live_count;
+	std::atomic< u64 > allocations_count;
+
+	alignas( 64 ) std::atomic< bool > trace_recording;
+	std::atomic< u64 > trace_events_count;
+	Heap_Trace_Event *trace_events;
+	u32 trace_capacity;
+};
+
+// Zero-initialized before any code runs, so allocations made by static initializers are tracked too.
+static Heap_Profiler g_heap_profiler;
+
+// Callsites are told apart by their string literals' addresses and the line.
+static u64
+callsite_key( CallerInfo caller ) {
+	u64 key = ( u64 )caller.file * 0x9E3779B97F4A7C15ull;
+	key ^= ( u64 )caller.function + 0x632BE59BD9B4E019ull + ( key << 6 ) + ( key >> 2 );
+	key ^= ( u64 )caller.line * 0xC2B2AE3D27D4EB4Full;
+	key ^= key >> 29;
+	return ( key == 0 ) ? 1 : key;
+}
+
+static u32
+callsite_find_or_add( CallerInfo caller ) {
+	u64 key = callsite_key( caller );
+	u32 mask = HEAP_PROFILER_MAX_CALLSITES - 1;
+	u32 idx = ( u32 )key & mask;
+	For( HEAP_PROFILER_MAX_CALLSITES ) {
+		Heap_Callsite *callsite = &g_heap_profiler.callsites[ idx ];
+		u64 slot_key = callsite->key.load( std::memory_order_acquire );
+		if ( slot_key == key )
+			return idx;
+
+		if ( slot_key == 0 ) {
+			if ( callsite->key.compare_exchange_strong( slot_key, key, std::memory_order_acq_rel ) ) {
+				callsite->caller = caller;
+				callsite->ready.store( true, std::memory_order_release );
+				g_heap_profiler.callsites_count.fetch_add( 1, std::memory_order_relaxed );
+				return idx;
+			}
+			// Another thread claimed it first, maybe for this callsite.
+			if ( slot_key == key )
+				return idx;
+		}
+		idx = ( idx + 1 ) & mask;
+	}
+	return HEAP_OVERFLOW_CALLSITE_IDX;
+}
+
+static void
+peak_update( std::atomic< s64 > *peak, s64 value ) {
+	s64 current = peak->load( std::memory_order_relaxed );
+	while ( value > current && !peak->compare_exchange_weak( current, value, std::memory_order_relaxed ) ) {}
+}
+
+// `bytes_delta` and `count_delta` change the live totals, `allocated` is what was handed out.
+static void
+record( u32 callsite_idx, s64 bytes_delta, s64 count_delta, u64 allocated ) {
+	Heap_Callsite *callsite = &g_heap_profiler.callsites[ callsite_idx ];
+	s64 live = callsite->live_bytes.fetch_add( bytes_delta, std::memory_order_relaxed ) + bytes_delta;
+	callsite->live_count.fetch_add( count_delta, std::memory_order_relaxed );
+	s64 total_live = g_heap_profiler.live_bytes.fetch_add( bytes_delta, std::memory_order_relaxed ) + bytes_delta;
+	g_heap_profiler.live_count.fetch_add( count_delta, std::memory_order_relaxed );
+	if ( bytes_delta > 0 ) {
+		peak_update( &callsite->peak_bytes, live );
+		peak_update( &g_heap_profiler.peak_bytes, total_live );
+	}
+	if ( allocated > 0 ) {
+		callsite->allocations_count.fetch_add( 1, std::memory_order_relaxed );
+		callsite->allocated_bytes.fetch_add( allocated, std::memory_order_relaxed );
+		g_heap_profiler.allocations_count.fetch_add( 1, std::memory_order_relaxed );
+	}
+}
+
+static void
+trace_record( Heap_Trace_Op op, void *pointer, void *old_pointer, u64 count, u64 size ) {
+	if ( !g_heap_profiler.trace_recording.load( std::memory_order_acquire ) )
+		return;
+
+	u64 event_idx = g_heap_profiler.trace_events_count.fetch_add( 1, std::memory_order_relaxed );
+	if ( event_idx < g_heap_profiler.trace_capacity ) {
+		g_heap_profiler.trace_events[ event_idx ] = Heap_Trace_Event {
+			.pointer = ( u64 )pointer,
+			.old_pointer = ( u64 )old_pointer,
+			.count = count,
+			.size = ( u32 )size,
+			.op = op
+		};
+	}
+}
+
+static Heap_Block_Header *
+block_header( void *memory_pointer ) {
+	Heap_Block_Header *header = ( Heap_Block_Header * )memory_pointer - 1;
+	AssertMessage( header->magic == HEAP_BLOCK_MAGIC, "Memory was not allocated by a 'Tracking_Allocator'" );
+	return header;
+}
+
+u8 *
+Tracking_Allocator::do_allocate( u64 count, u64 size, CallerInfo caller ) {
+	u64 bytes = count * size;
+	Heap_Block_Header *header = ( Heap_Block_Header * )backing_allocator->do_allocate( 1, sizeof( Heap_Block_Header ) + bytes, caller );
+	if ( !header )
+		return NULL;
+
+	u32 callsite_idx = callsite_find_or_add( caller );
+	*header = Heap_Block_Header { .size = bytes, .callsite_idx = callsite_idx, .magic = HEAP_BLOCK_MAGIC };
+	record( callsite_idx, ( s64 )bytes, 1, bytes );
+	trace_record( HeapTraceOp_Allocate, header + 1, NULL, count, size );
+	return ( u8 * )( header + 1 );
+}
+
+u8 *
+Tracking_Allocator::do_reallocate( void *memory_pointer, u64 old_count, u64 new_count, u64 size, CallerInfo caller ) {
+	if ( !memory_pointer )
+		return do_allocate( new_count, size, caller );
+
+	Heap_Block_Header *header = block_header( memory_pointer );
+	u64 old_bytes = header->size;
+	u64 new_bytes = new_count * size;
+	header = ( Heap_Block_Header * )backing_allocator->do_reallocate( header, 1, 1, sizeof( Heap_Block_Header ) + new_bytes, caller );
+	if ( !header )
+		return NULL;
+
+	header->size = new_bytes;
+	record( header->callsite_idx, ( s64 )new_bytes - ( s64 )old_bytes, 0, new_bytes );
+	trace_record( HeapTraceOp_Reallocate, header + 1, memory_pointer, new_count, size );
+	return ( u8 * )( header + 1 );
+}
+
+void
+Tracking_Allocator::do_deallocate( void *memory_pointer, CallerInfo caller ) {
+	Heap_Block_Header *header = block_header( memory_pointer );
+	record( header->callsite_idx, -( s64 )header->size, -1, 0 );
+	// Before the block is freed, so the event comes before the one of whoever gets the memory next.
+	trace_record( HeapTraceOp_Deallocate, memory_pointer, NULL, 0, 0 );
+	header->magic = 0;
+	backing_allocator->do_deallocate( header, caller );
+}
+
+StringView_ASCII
+heap_profiler_sort_name( Heap_Profiler_Sort sort ) {
+	switch ( sort ) {
+		case HeapProfilerSort_LiveBytes: return "Live bytes";
+		case HeapProfilerSort_PeakBytes: return "Peak bytes";
+		case HeapProfilerSort_Churn:     return "Churn";
+		default:                         return "(unknown)";
+	}
+}
+
+Heap_Profiler_Totals
+heap_profiler_totals() {
+	return Heap_Profiler_Totals {
+		.live_bytes = g_heap_profiler.live_bytes.load( std::memory_order_relaxed ),
+		.peak_bytes = g_heap_profiler.peak_bytes.load( std::memory_order_relaxed ),
+		.live_count = g_heap_profiler.live_count.load( std::memory_order_relaxed ),
+		.allocations_count = g_heap_profiler.allocations_count.load( std::memory_order_relaxed ),
+		.callsites_count = g_heap_profiler.callsites_count.load( std::memory_order_relaxed ),
+		.callsites_overflowed = g_heap_profiler.callsites[ HEAP_OVERFLOW_CALLSITE_IDX ].allocations_count.load( std::memory_order_relaxed ) > 0
+	};
+}
+
+static int
+compare_live_bytes( const void *lhs, const void *rhs ) {
+	s64 a = ( ( const Heap_Callsite_Stats * )lhs )->live_bytes;
+	s64 b = ( ( const Heap_Callsite_Stats * )rhs )->live_bytes;
+	return ( a < b ) - ( a > b );
+}
+
+static int
+compare_peak_bytes( const void *lhs, const void *rhs ) {
+	s64 a = ( ( const Heap_Callsite_Stats * )lhs )->peak_bytes;
+	s64 b = ( ( const Heap_Callsite_Stats * )rhs )->peak_bytes;
+	return ( a < b ) - ( a > b );
+}
+
+static int
+compare_churn( const void *lhs, const void *rhs ) {
+	f64 a = ( ( const Heap_Callsite_Stats * )lhs )->allocations_per_second;
+	f64 b = ( ( const Heap_Callsite_Stats * )rhs )->allocations_per_second;
+	return ( a < b ) - ( a > b );
+}
+
+void
+heap_profiler_snapshot_init( Heap_Profiler_Snapshot *snapshot ) {
+	snapshot->callsites = array_new< Heap_Callsite_Stats >( sys_allocator, HEAP_PROFILER_MAX_CALLSITES + 1 );
+	snapshot->previous_allocations = array_new< u64 >( sys_allocator, HEAP_PROFILER_MAX_CALLSITES + 1 );
+	array_resize( &snapshot->previous_allocations, HEAP_PROFILER_MAX_CALLSITES + 1 );
+	memset( snapshot->previous_allocations.data, 0, snapshot->previous_allocations.size * sizeof( u64 ) );
+	snapshot->totals = { 0 };
+	snapshot->previous_seconds = 0.0;
+}
+
+void
+heap_profiler_snapshot( Heap_Profiler_Snapshot *snapshot, Heap_Profiler_Sort sort ) {
+	Assert( snapshot->callsites.data );
+	f64 seconds = std::chrono::duration< f64 >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+	f64 elapsed = ( snapshot->previous_seconds > 0.0 ) ? seconds - snapshot->previous_seconds : 0.0;
+	snapshot->previous_seconds = seconds;
+	snapshot->totals = heap_profiler_totals();
+
+	array_clear( &snapshot->callsites );
+	ForIt( g_heap_profiler.callsites, HEAP_PROFILER_MAX_CALLSITES + 1 ) {
+		bool overflow = ( it_index == HEAP_OVERFLOW_CALLSITE_IDX );
+		if ( !overflow && !it.ready.load( std::memory_order_acquire ) )
+			continue;
+
+		u64 allocations = it.allocations_count.load( std::memory_order_relaxed );
+		if ( overflow && allocations == 0 )
+			continue;
+
+		u64 *previous = &snapshot->previous_allocations.data[ it_index ];
+		array_add( &snapshot->callsites, Heap_Callsite_Stats {
+			.caller = ( overflow ) ? CallerInfo { "(other callsites)", "-", "-", 0 } : it.caller,
+			.live_bytes = it.live_bytes.load( std::memory_order_relaxed ),
+			.peak_bytes = it.peak_bytes.load( std::memory_order_relaxed ),
+			.live_count = it.live_count.load( std::memory_order_relaxed ),
+			.allocations_count = allocations,
+			.allocated_bytes = it.allocated_bytes.load( std::memory_order_relaxed ),
+			.allocations_per_second = ( elapsed > 0.0 ) ? ( f64 )( allocations - *previous ) / elapsed : 0.0
+		} );
+		*previous = allocations;
+	}}
+
+	int ( *compare )( const void *, const void * ) = compare_live_bytes;
+	if ( sort == HeapProfilerSort_PeakBytes )
+		compare = compare_peak_bytes;
+	else if ( sort == HeapProfilerSort_Churn )
+		compare = compare_churn;
+	qsort( snapshot->callsites.data, snapshot->callsites.size, sizeof( Heap_Callsite_Stats ), compare );
+}
+
+void
+heap_profiler_snapshot_free( Heap_Profiler_Snapshot *snapshot ) {
+	array_free( &snapshot->callsites );
+	array_free( &snapshot->previous_allocations );
+	snapshot->previous_seconds = 0.0;
+}
+
+bool
+heap_profiler_dump( const char *file_path ) {
+	FILE *file = fopen( file_path, "w" );
+	if ( !file ) {
+		log_error( "Failed to open '%s' to dump the heap profile.", file_path );
+		return false;
+	}
+
+	Heap_Profiler_Snapshot snapshot;
+	heap_profiler_snapshot_init( &snapshot );
+	heap_profiler_snapshot( &snapshot, HeapProfilerSort_LiveBytes );
+	Heap_Profiler_Totals *totals = &snapshot.totals;
+	fprintf( file, "live bytes: %lld\npeak bytes: %lld\nlive allocations: %lld\nallocations: %llu\ncallsites: %u%s\n\n",
+		( long long )totals->live_bytes,
+		( long long )totals->peak_bytes,
+		( long long )totals->live_count,
+		( unsigned long long )totals->allocations_count,
+		totals->callsites_count,
+		( totals->callsites_overflowed ) ? " (table full)" : ""
+	);
+	fprintf( file, "%14s %14s %10s %12s %16s  %s\n", "live bytes", "peak bytes", "live", "allocations", "allocated bytes", "callsite" );
+	ForIt( snapshot.callsites.data, snapshot.callsites.size ) {
+		fprintf( file, "%14lld %14lld %10lld %12llu %16llu  %s:%ld %s %s\n",
+			( long long )it.live_bytes,
+			( long long )it.peak_bytes,
+			( long long )it.live_count,
+			( unsigned long long )it.allocations_count,
+			( unsigned long long )it.allocated_bytes,
+			it.caller.file,
+			it.caller.line,
+			it.caller.type,
+			it.caller.function
+		);
+	}}
+	heap_profiler_snapshot_free( &snapshot );
+
+	bool written = ( ferror( file ) == 0 );
+	fclose( file );
+	if ( written )
+		log_info( "Heap profile dumped into '%s'.", file_path );
+	else
+		log_error( "Failed to write the heap profile into '%s'.", file_path );
+	return written;
+}
+
+bool
+heap_profiler_trace_begin( u32 capacity ) {
+	if ( g_heap_profiler.trace_recording.load( std::memory_order_acquire ) || g_heap_profiler.trace_events )
+		return false;
+
+	// Straight from `calloc()`, the buffer is not a part of the trace.  Zeroed, so events
+	//   cut off by the end of the trace read as allocations of nothing.
+	Heap_Trace_Event *events = ( Heap_Trace_Event * )calloc( capacity, sizeof( Heap_Trace_Event ) );
+	if ( !events ) {
+		log_error( "Failed to take %u events for the allocation trace.", capacity );
+		return false;
+	}
+
+	g_heap_profiler.trace_events = events;
+	g_heap_profiler.trace_capacity = capacity;
+	g_heap_profiler.trace_events_count.store( 0, std::memory_order_relaxed );
+	g_heap_profiler.trace_recording.store( true, std::memory_order_release );
+	return true;
+}
+
+Heap_Trace
+heap_profiler_trace_end() {
+	g_heap_profiler.trace_recording.store( false, std::memory_order_release );
+	u64 events_count = g_heap_profiler.trace_events_count.load( std::memory_order_relaxed );
+	u32 kept_count = ( events_count < g_heap_profiler.trace_capacity ) ? ( u32 )events_count : g_heap_profiler.trace_capacity;
+
+	Heap_Trace trace = {
+		.events = ArrayView< Heap_Trace_Event > { kept_count, g_heap_profiler.trace_events },
+		.dropped_count = events_count - kept_count
+	};
+	if ( trace.dropped_count > 0 )
+		log_warning( "The allocation trace is full, %llu events were dropped.", ( unsigned long long )trace.dropped_count );
+	return trace;
+}
+
+bool
+heap_profiler_trace_recording() {
+	return g_heap_profiler.trace_recording.load( std::memory_order_relaxed );
+}
+
+void
+heap_profiler_trace_free( Heap_Trace *trace ) {
+	AssertMessage( !g_heap_profiler.trace_recording.load( std::memory_order_relaxed ), "Freeing the allocation trace while it is being recorded" );
+	free( g_heap_profiler.trace_events );
+	g_heap_profiler.trace_events = NULL;
+	g_heap_profiler.trace_capacity = 0;
+	*trace = Heap_Trace { 0 };
+}
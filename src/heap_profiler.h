@@ -0,0 +1,115 @@
+#ifndef QLIGHT_HEAP_PROFILER_H
+#define QLIGHT_HEAP_PROFILER_H
+
+#include "allocator.h"
+#include "array.h"
+#include "string.h"
+
+/*
+	Heap profiler: live bytes, peak bytes and allocation counts per callsite.
+
+	`Tracking_Allocator` wraps another allocator and files every allocation under the
+	  `CallerInfo` its `Allocate()` or `Reallocate()` was made with.  A 16-byte header in front
+	  of every block remembers its size and callsite, so `Deallocate()` finds both.
+	  Reallocations stay with the callsite that made the first allocation.
+	Callsites live in a fixed-size open addressing table, claimed with a compare-and-swap
+	  and counted with relaxed atomics, so tracking takes no lock and costs a few atomic
+	  adds per allocation.  `sys_allocator` is tracked unless `QLIGHT_NO_HEAP_PROFILER` is defined.
+
+	Template helpers (`array_new()`, `array_resize()`, ...) report their own line with the
+	  item type in the function name, so every array type is a callsite of its own.
+*/
+
+constexpr u32 HEAP_PROFILER_MAX_CALLSITES = 4096;  // Power of 2.  Callsites past it are counted together.
+
+struct Tracking_Allocator : Allocator {
+	Allocator *backing_allocator;
+
+	constexpr Tracking_Allocator( Allocator *backing_allocator ) : backing_allocator( backing_allocator ) {}
+
+	u8 *do_allocate( u64 count, u64 size, CallerInfo caller );
+	u8 *do_reallocate( void *memory_pointer, u64 old_count, u64 new_count, u64 size, CallerInfo caller );
+	void do_deallocate( void *memory_pointer, CallerInfo caller );
+};
+
+struct Heap_Callsite_Stats {
+	CallerInfo caller;
+	s64 live_bytes;
+	s64 peak_bytes;
+	s64 live_count;
+	u64 allocations_count;       // Reallocations included.
+	u64 allocated_bytes;         // Every allocation's and reallocation's size, summed.
+	f64 allocations_per_second;  // Churn since the previous snapshot.
+};
+
+struct Heap_Profiler_Totals {
+	s64 live_bytes;
+	s64 peak_bytes;
+	s64 live_count;
+	u64 allocations_count;
+	u32 callsites_count;
+	bool callsites_overflowed;   // The table is full, the rest are in one "(other callsites)" entry.
+};
+
+enum Heap_Profiler_Sort : u8 {
+	HeapProfilerSort_LiveBytes = 0,
+	HeapProfilerSort_PeakBytes,
+	HeapProfilerSort_Churn,
+
+	HeapProfilerSort_COUNT
+};
+
+struct Heap_Profiler_Snapshot {
+	Array< Heap_Callsite_Stats > callsites;
+	Heap_Profiler_Totals totals;
+	// Counts and time of the previous snapshot, for the churn.
+	Array< u64 > previous_allocations;
+	f64 previous_seconds;
+};
+
+StringView_ASCII heap_profiler_sort_name( Heap_Profiler_Sort sort );
+
+Heap_Profiler_Totals heap_profiler_totals();
+// Takes room for every callsite up front, so taking snapshots never allocates.
+void heap_profiler_snapshot_init( Heap_Profiler_Snapshot *snapshot );
+// Reads every callsite into the initialized snapshot, sorted.  Keep the snapshot around between calls for the churn.
+void heap_profiler_snapshot( Heap_Profiler_Snapshot *snapshot, Heap_Profiler_Sort sort );
+void heap_profiler_snapshot_free( Heap_Profiler_Snapshot *snapshot );
+// Writes the totals and every callsite, sorted by live bytes, as text.
+bool heap_profiler_dump( const char *file_path );
+
+/*
+	Allocation trace: the tracked allocations, reallocations and deallocations in the order they
+	  were made, to replay them on other allocators (see `tlsf_allocator_benchmark()`).
+
+	Events are written into a buffer taken up front, so recording costs an atomic add per event.
+	  Events past its capacity are counted, not kept.  Stop the trace while other threads are not
+	  allocating, or their last events may be cut off.
+*/
+
+enum Heap_Trace_Op : u8 {
+	HeapTraceOp_Allocate = 0,
+	HeapTraceOp_Reallocate,
+	HeapTraceOp_Deallocate,
+};
+
+struct Heap_Trace_Event {
+	u64 pointer;      // Handed out or freed.
+	u64 old_pointer;  // What a reallocation was given.
+	u64 count;        // Items, and the size of one, as `Allocate()` was asked.
+	u32 size;
+	Heap_Trace_Op op;
+};
+
+struct Heap_Trace {
+	ArrayView< Heap_Trace_Event > events;
+	u64 dropped_count;
+};
+
+// False if a trace is being recorded already.
+bool heap_profiler_trace_begin( u32 capacity );
+Heap_Trace heap_profiler_trace_end();
+bool heap_profiler_trace_recording();
+void heap_profiler_trace_free( Heap_Trace *trace );
+
+#endif /* QLIGHT_HEAP_PROFILER_H */
@@ -0,0 +1,154 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "jobs.h"
+
+#define QL_LOG_CHANNEL "Jobs"
+#include "log.h"
+
+struct Jobs_Batch {
+	Job_Function function;
+	void *data;
+	u32 jobs_count;
+};
+
+struct G_Jobs {
+	std::thread workers[ JOBS_MAX_WORKERS ];
+	u32 workers_count;
+	bool initialized;
+
+	std::mutex run_mutex;  // Serializes callers of `jobs_run_parallel`.
+
+	std::mutex mutex;  // Guards everything below except the atomics.
+	std::condition_variable wake;
+	std::condition_variable done;
+	Jobs_Batch batch;
+	u64 generation;
+	u32 active_workers;  // Workers that picked up the current batch and have not finished it.
+	bool quit;
+
+	std::atomic< u32 > next_job;
+	std::atomic< u32 > finished_jobs;
+} g_jobs;
+
+static thread_local bool g_jobs_is_worker_thread = false;
+
+static void
+jobs_work( Jobs_Batch batch ) {
+	while ( true ) {
+		u32 job_index = g_jobs.next_job.fetch_add( 1, std::memory_order_relaxed );
+		if ( job_index >= batch.jobs_count )
+			break;
+
+		batch.function( batch.data, job_index );
+		g_jobs.finished_jobs.fetch_add( 1, std::memory_order_release );
+	}
+}
+
+static void
+jobs_worker_main() {
+	g_jobs_is_worker_thread = true;
+	u64 seen_generation = 0;
+
+	while ( true ) {
+		Jobs_Batch batch;
+		{
+			std::unique_lock< std::mutex > lock( g_jobs.mutex );
+			g_jobs.wake.wait( lock, [ & ] { return g_jobs.quit || g_jobs.generation != seen_generation; } );
+			if ( g_jobs.quit )
+				return;
+
+			seen_generation = g_jobs.generation;
+			batch = g_jobs.batch;
+			g_jobs.active_workers += 1;
+		}
+
+		jobs_work( batch );
+
+		{
+			std::lock_guard< std::mutex > lock( g_jobs.mutex );
+			g_jobs.active_workers -= 1;
+		}
+		g_jobs.done.notify_all();
+	}
+}
+
+bool jobs_init( u32 workers_count ) {
+	if ( g_jobs.initialized )
+		return false;
+
+	if ( workers_count == 0 ) {
+		u32 hardware_threads = std::thread::hardware_concurrency();
+		workers_count = ( hardware_threads > 1 ) ? hardware_threads - 1 : 1;
+	}
+	workers_count = QL_min2( workers_count, JOBS_MAX_WORKERS );
+
+	g_jobs.batch = Jobs_Batch { 0 };
+	g_jobs.generation = 0;
+	g_jobs.active_workers = 0;
+	g_jobs.quit = false;
+	g_jobs.workers_count = workers_count;
+	for ( u32 worker_idx = 0; worker_idx < workers_count; worker_idx += 1 )
+		g_jobs.workers[ worker_idx ] = std::thread( jobs_worker_main );
+
+	g_jobs.initialized = true;
+	log_info( "Started %u job worker threads.", workers_count );
+	return true;
+}
+
+void jobs_shutdown() {
+	if ( !g_jobs.initialized )
+		return;
+
+	{
+		std::lock_guard< std::mutex > lock( g_jobs.mutex );
+		g_jobs.quit = true;
+	}
+	g_jobs.wake.notify_all();
+
+	for ( u32 worker_idx = 0; worker_idx < g_jobs.workers_count; worker_idx += 1 )
+		g_jobs.workers[ worker_idx ].join();
+
+	g_jobs.workers_count = 0;
+	g_jobs.initialized = false;
+}
+
+u32 jobs_workers_count() {
+	return g_jobs.workers_count;
+}
+
+void jobs_run_parallel( u32 jobs_count, Job_Function function, void *data ) {
+	if ( jobs_count == 0 )
+		return;
+
+	if ( !g_jobs.initialized || g_jobs_is_worker_thread || jobs_count == 1 ) {
+		for ( u32 job_index = 0; job_index < jobs_count; job_index += 1 )
+			function( data, job_index );
+		return;
+	}
+
+	std::lock_guard< std::mutex > run_lock( g_jobs.run_mutex );
+
+	Jobs_Batch batch = { .function = function, .data = data, .jobs_count = jobs_count };
+	{
+		// A worker that woke up late for the previous batch may still be leaving it.
+		std::unique_lock< std::mutex > lock( g_jobs.mutex );
+		g_jobs.done.wait( lock, [ & ] { return g_jobs.active_workers == 0; } );
+		g_jobs.batch = batch;
+		g_jobs.next_job.store( 0, std::memory_order_relaxed );
+		g_jobs.finished_jobs.store( 0, std::memory_order_relaxed );
+		g_jobs.generation += 1;
+	}
+	g_jobs.wake.notify_all();
+
+	// The calling thread takes jobs too.
+	jobs_work( batch );
+
+	// Wait until every job is done.
+	std::unique_lock< std::mutex > lock( g_jobs.mutex );
+	g_jobs.done.wait( lock, [ & ] {
+		return g_jobs.finished_jobs.load( std::memory_order_acquire ) == jobs_count;
+	} );
+}
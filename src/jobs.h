@@ -0,0 +1,26 @@
+#ifndef QLIGHT_JOBS_H
+#define QLIGHT_JOBS_H
+
+#include "common.h"
+
+/*
+	A small pool of worker threads for data-parallel work.
+
+	`jobs_run_parallel` splits work into `jobs_count` jobs, runs them on the workers
+	  and the calling thread, and returns when all of them are done.  Jobs must not
+	  depend on each other.  One batch runs at a time; a call from inside a job, or
+	  before `jobs_init()`, runs its jobs on the calling thread.
+*/
+
+constexpr u32 JOBS_MAX_WORKERS = 31;
+
+typedef void ( *Job_Function )( void *data, u32 job_index );
+
+// `workers_count == 0` picks one less than the number of hardware threads.
+bool jobs_init( u32 workers_count = 0 );
+void jobs_shutdown();
+u32 jobs_workers_count();
+
+void jobs_run_parallel( u32 jobs_count, Job_Function function, void *data );
+
+#endif /* QLIGHT_JOBS_H */
@@ -0,0 +1,288 @@
+#include <xmmintrin.h>
+#include <math.h>
+#include <string.h>
+
+#include "light_clusters.h"
+#include "jobs.h"
+#include "camera.h"
+
+static void
+light_clusters_slice_init( Light_Clusters_Slice *slice, Allocator *allocator ) {
+	slice->center_x = array_new< f32 >( allocator, 16 );
+	slice->center_y = array_new< f32 >( allocator, 16 );
+	slice->center_z = array_new< f32 >( allocator, 16 );
+	slice->radius_squared = array_new< f32 >( allocator, 16 );
+	slice->light_index = array_new< u32 >( allocator, 16 );
+	slice->light_indices = array_new< u32 >( allocator, 64 );
+}
+
+static void
+light_clusters_slice_destroy( Light_Clusters_Slice *slice ) {
+	array_free( &slice->center_x );
+	array_free( &slice->center_y );
+	array_free( &slice->center_z );
+	array_free( &slice->radius_squared );
+	array_free( &slice->light_index );
+	array_free( &slice->light_indices );
+}
+
+void light_clusters_init( Light_Clusters *clusters, Allocator *allocator ) {
+	*clusters = Light_Clusters {
+		.projection = { 0 },
+		.z_near = 0.0f,
+		.z_far = 0.0f,
+		.depth_scale = 0.0f,
+		.depth_bias = 0.0f,
+		.bounds = array_new< AABB >( allocator, LIGHT_CLUSTERS_COUNT ),
+		.clusters = array_new< Light_Cluster >( allocator, LIGHT_CLUSTERS_COUNT ),
+		.light_indices = array_new< u32 >( allocator, 256 ),
+		.max_cluster_lights = 0,
+		.view = { 0 },
+		.view_spheres = array_new< Vector4_f32 >( allocator, 16 )
+		// .slices
+	};
+	clusters->bounds.size = LIGHT_CLUSTERS_COUNT;
+	clusters->clusters.size = LIGHT_CLUSTERS_COUNT;
+
+	for ( u32 slice_idx = 0; slice_idx < LIGHT_CLUSTERS_Z; slice_idx += 1 )
+		light_clusters_slice_init( &clusters->slices[ slice_idx ], allocator );
+}
+
+void light_clusters_destroy( Light_Clusters *clusters ) {
+	array_free( &clusters->bounds );
+	array_free( &clusters->clusters );
+	array_free( &clusters->light_indices );
+	array_free( &clusters->view_spheres );
+	for ( u32 slice_idx = 0; slice_idx < LIGHT_CLUSTERS_Z; slice_idx += 1 )
+		light_clusters_slice_destroy( &clusters->slices[ slice_idx ] );
+}
+
+static f32
+light_clusters_slice_depth( Light_Clusters *clusters, u32 slice_idx ) {
+	// Exponential slicing keeps clusters roughly cube-shaped at every distance.
+	return clusters->z_near * powf( clusters->z_far / clusters->z_near, ( f32 )slice_idx / ( f32 )LIGHT_CLUSTERS_Z );
+}
+
+static void
+light_clusters_update_bounds( Light_Clusters *clusters, Matrix4x4_f32 *projection ) {
+	clusters->projection = *projection;
+
+	// Column-major: `columns[ 2 ].z` is the third row of the third column, etc.
+	Vector4_f32 *p = projection->columns;
+	clusters->z_near = p[ 3 ].z / ( p[ 2 ].z - 1.0f );
+	clusters->z_far = p[ 3 ].z / ( p[ 2 ].z + 1.0f );
+	f32 log_far_over_near = logf( clusters->z_far / clusters->z_near );
+	clusters->depth_scale = ( f32 )LIGHT_CLUSTERS_Z / log_far_over_near;
+	clusters->depth_bias = -( f32 )LIGHT_CLUSTERS_Z * logf( clusters->z_near ) / log_far_over_near;
+
+	for ( u32 z = 0; z < LIGHT_CLUSTERS_Z; z += 1 ) {
+		f32 depths[ 2 ] = { light_clusters_slice_depth( clusters, z ), light_clusters_slice_depth( clusters, z + 1 ) };
+
+		for ( u32 y = 0; y < LIGHT_CLUSTERS_Y; y += 1 ) {
+			f32 ndc_y[ 2 ] = {
+				-1.0f + 2.0f * ( f32 )y / ( f32 )LIGHT_CLUSTERS_Y,
+				-1.0f + 2.0f * ( f32 )( y + 1 ) / ( f32 )LIGHT_CLUSTERS_Y
+			};
+
+			for ( u32 x = 0; x < LIGHT_CLUSTERS_X; x += 1 ) {
+				f32 ndc_x[ 2 ] = {
+					-1.0f + 2.0f * ( f32 )x / ( f32 )LIGHT_CLUSTERS_X,
+					-1.0f + 2.0f * ( f32 )( x + 1 ) / ( f32 )LIGHT_CLUSTERS_X
+				};
+
+				// Bounds of the tile's corners at both ends of the slice.
+				// With `clip.w = depth`, `ndc.x = ( p00 * x + p20 * z ) / depth` and `z = -depth`.
+				AABB bounds = aabb_empty();
+				for ( u32 corner_idx = 0; corner_idx < 8; corner_idx += 1 ) {
+					f32 depth = depths[ ( corner_idx >> 2 ) & 1 ];
+					Vector3_f32 corner = {
+						depth * ( ndc_x[ corner_idx & 1 ] + p[ 2 ].x ) / p[ 0 ].x,
+						depth * ( ndc_y[ ( corner_idx >> 1 ) & 1 ] + p[ 2 ].y ) / p[ 1 ].y,
+						-depth
+					};
+					aabb_add_point( &bounds, corner );
+				}
+				clusters->bounds.data[ light_clusters_index( x, y, z ) ] = bounds;
+			}
+		}
+	}
+}
+
+static void
+light_clusters_bin_slice( void *data, u32 slice_idx ) {
+	Light_Clusters *clusters = ( Light_Clusters * )data;
+	Light_Clusters_Slice *slice = &clusters->slices[ slice_idx ];
+	array_clear( &slice->center_x );
+	array_clear( &slice->center_y );
+	array_clear( &slice->center_z );
+	array_clear( &slice->radius_squared );
+	array_clear( &slice->light_index );
+	array_clear( &slice->light_indices );
+
+	// 1. Gather the lights that reach into this slice's depth range.
+	f32 slice_near = light_clusters_slice_depth( clusters, slice_idx );
+	f32 slice_far = light_clusters_slice_depth( clusters, slice_idx + 1 );
+	ForIt( clusters->view_spheres.data, clusters->view_spheres.size ) {
+		f32 depth = -it.z;
+		if ( depth + it.w < slice_near || depth - it.w > slice_far )
+			continue;
+
+		array_add( &slice->center_x, it.x );
+		array_add( &slice->center_y, it.y );
+		array_add( &slice->center_z, it.z );
+		array_add( &slice->radius_squared, it.w * it.w );
+		array_add( &slice->light_index, ( u32 )it_index );
+	}}
+
+	// Pad to a multiple of 4 with spheres that never hit anything.
+	while ( slice->center_x.size % 4 != 0 ) {
+		array_add( &slice->center_x, 0.0f );
+		array_add( &slice->center_y, 0.0f );
+		array_add( &slice->center_z, 0.0f );
+		array_add( &slice->radius_squared, -1.0f );
+		array_add( &slice->light_index, U32_MAX );
+	}
+
+	// 2. Test every cluster of the slice against 4 lights at a time.
+	const __m128 zero = _mm_setzero_ps();
+	u32 slice_first_cluster = light_clusters_index( 0, 0, slice_idx );
+	for ( u32 cluster_idx = 0; cluster_idx < LIGHT_CLUSTERS_PER_SLICE; cluster_idx += 1 ) {
+		AABB bounds = clusters->bounds.data[ slice_first_cluster + cluster_idx ];
+		__m128 min_x = _mm_set1_ps( bounds.min.x ), max_x = _mm_set1_ps( bounds.max.x );
+		__m128 min_y = _mm_set1_ps( bounds.min.y ), max_y = _mm_set1_ps( bounds.max.y );
+		__m128 min_z = _mm_set1_ps( bounds.min.z ), max_z = _mm_set1_ps( bounds.max.z );
+
+		u32 offset = slice->light_indices.size;
+		for ( u32 light_idx = 0; light_idx < slice->center_x.size; light_idx += 4 ) {
+			__m128 center_x = _mm_loadu_ps( &slice->center_x.data[ light_idx ] );
+			__m128 center_y = _mm_loadu_ps( &slice->center_y.data[ light_idx ] );
+			__m128 center_z = _mm_loadu_ps( &slice->center_z.data[ light_idx ] );
+
+			// Distance from each center to the closest point of the cluster.
+			__m128 distance_x = _mm_max_ps( _mm_max_ps( _mm_sub_ps( min_x, center_x ), _mm_sub_ps( center_x, max_x ) ), zero );
+			__m128 distance_y = _mm_max_ps( _mm_max_ps( _mm_sub_ps( min_y, center_y ), _mm_sub_ps( center_y, max_y ) ), zero );
+			__m128 distance_z = _mm_max_ps( _mm_max_ps( _mm_sub_ps( min_z, center_z ), _mm_sub_ps( center_z, max_z ) ), zero );
+			__m128 distance_squared = _mm_add_ps(
+				_mm_add_ps( _mm_mul_ps( distance_x, distance_x ), _mm_mul_ps( distance_y, distance_y ) ),
+				_mm_mul_ps( distance_z, distance_z )
+			);
+
+			__m128 radius_squared = _mm_loadu_ps( &slice->radius_squared.data[ light_idx ] );
+			s32 hits = _mm_movemask_ps( _mm_cmple_ps( distance_squared, radius_squared ) );
+			for ( u32 lane = 0; hits != 0; lane += 1, hits >>= 1 ) {
+				if ( hits & 1 )
+					array_add( &slice->light_indices, slice->light_index.data[ light_idx + lane ] );
+			}
+		}
+
+		slice->clusters[ cluster_idx ] = Light_Cluster { .offset = offset, .count = slice->light_indices.size - offset };
+	}
+}
+
+void light_clusters_build( Light_Clusters *clusters, Matrix4x4_f32 *view, Matrix4x4_f32 *projection, ArrayView< Light_Sphere > lights ) {
+	if ( memcmp( &clusters->projection, projection, sizeof( Matrix4x4_f32 ) ) != 0 )
+		light_clusters_update_bounds( clusters, projection );
+
+	// 1. Move the lights into view space, where cluster bounds are.
+	clusters->view = *view;
+	Vector4_f32 *m = view->columns;
+	array_clear( &clusters->view_spheres );
+	ForIt( lights.data, lights.size ) {
+		Vector3_f32 p = it.position;
+		Vector4_f32 sphere = {
+			m[ 0 ].x * p.x  +  m[ 1 ].x * p.y  +  m[ 2 ].x * p.z  +  m[ 3 ].x,
+			m[ 0 ].y * p.x  +  m[ 1 ].y * p.y  +  m[ 2 ].y * p.z  +  m[ 3 ].y,
+			m[ 0 ].z * p.x  +  m[ 1 ].z * p.y  +  m[ 2 ].z * p.z  +  m[ 3 ].z,
+			it.radius
+		};
+		array_add( &clusters->view_spheres, sphere );
+	}}
+
+	// Room for every light in every cluster, taken only when lights are added,
+	//   so binning never allocates while the lights and the camera move.
+	u32 padded_count = ( lights.size + 3 ) & ~3u;
+	ForIt( clusters->slices, LIGHT_CLUSTERS_Z ) {
+		array_reserve( &it.center_x, padded_count );
+		array_reserve( &it.center_y, padded_count );
+		array_reserve( &it.center_z, padded_count );
+		array_reserve( &it.radius_squared, padded_count );
+		array_reserve( &it.light_index, padded_count );
+		array_reserve( &it.light_indices, LIGHT_CLUSTERS_PER_SLICE * lights.size );
+	}}
+	array_reserve( &clusters->light_indices, LIGHT_CLUSTERS_COUNT * lights.size );
+
+	// 2. Bin them, one job per slice.
+	jobs_run_parallel( LIGHT_CLUSTERS_Z, light_clusters_bin_slice, clusters );
+
+	// 3. Concatenate the slices.
+	array_clear( &clusters->light_indices );
+	clusters->max_cluster_lights = 0;
+	for ( u32 slice_idx = 0; slice_idx < LIGHT_CLUSTERS_Z; slice_idx += 1 ) {
+		Light_Clusters_Slice *slice = &clusters->slices[ slice_idx ];
+		u32 base = clusters->light_indices.size;
+		array_add_many( &clusters->light_indices, array_view( &slice->light_indices ) );
+
+		u32 slice_first_cluster = light_clusters_index( 0, 0, slice_idx );
+		for ( u32 cluster_idx = 0; cluster_idx < LIGHT_CLUSTERS_PER_SLICE; cluster_idx += 1 ) {
+			Light_Cluster cluster = slice->clusters[ cluster_idx ];
+			cluster.offset += base;
+			clusters->clusters.data[ slice_first_cluster + cluster_idx ] = cluster;
+			clusters->max_cluster_lights = QL_max2( clusters->max_cluster_lights, cluster.count );
+		}
+	}
+}
+
+Light_Clusters_Test light_clusters_test( u32 lights_count ) {
+	Light_Clusters_Test test = { 0 };
+	test.lights_count = lights_count;
+
+	// Lights spread over a room in front of the camera, some past its far plane and behind it.
+	Array< Light_Sphere > lights = array_new< Light_Sphere >( sys_allocator, lights_count );
+	u32 random_state = 0x2545F491;
+	For( lights_count ) {
+		Light_Sphere light = {
+			.position = {
+				QL_random_f32( &random_state, -40.0f, 40.0f ),
+				QL_random_f32( &random_state, -10.0f, 10.0f ),
+				QL_random_f32( &random_state, -110.0f, 10.0f )
+			},
+			.radius = QL_random_f32( &random_state, 0.5f, 8.0f )
+		};
+		array_add( &lights, light );
+	}
+
+	Matrix4x4_f32 view = camera_view_space_matrix( Vector3_f32 { 0.0f, 2.0f, 5.0f }, Vector3_f32 { 0.0f, 0.0f, -50.0f }, Vector3_f32 { 0.0f, 1.0f, 0.0f } );
+	Matrix4x4_f32 projection = camera_projection_perspective( radians( 60.0f ), 16.0f / 9.0f, 0.1f, 100.0f );
+	Light_Clusters clusters;
+	light_clusters_init( &clusters, sys_allocator );
+	light_clusters_build( &clusters, &view, &projection, array_view( &lights ) );
+	test.binned_count = clusters.light_indices.size;
+	test.max_cluster_lights = clusters.max_cluster_lights;
+
+	// Every cluster must list exactly the lights whose sphere touches its box, in the order of the lights.
+	For( LIGHT_CLUSTERS_COUNT ) {
+		AABB bounds = clusters.bounds.data[ it_index ];
+		Light_Cluster cluster = clusters.clusters.data[ it_index ];
+		u32 matched = 0;
+		bool equal = true;
+		ForIt2( clusters.view_spheres.data, clusters.view_spheres.size ) {
+			if ( !aabb_overlaps_sphere( bounds, Vector3_f32 { it2.x, it2.y, it2.z }, it2.w ) )
+				continue;
+
+			if ( matched >= cluster.count || clusters.light_indices.data[ cluster.offset + matched ] != it2_index ) {
+				equal = false;
+				break;
+			}
+			matched += 1;
+		}}
+
+		if ( !equal || matched != cluster.count )
+			test.mismatched_clusters += 1;
+	}
+
+	// A camera that sees no light would pass with empty clusters.
+	test.bins_equal = ( test.mismatched_clusters == 0 ) && ( test.binned_count > 0 );
+	light_clusters_destroy( &clusters );
+	array_free( &lights );
+	return test;
+}
@@ -0,0 +1,101 @@
+#ifndef QLIGHT_LIGHT_CLUSTERS_H
+#define QLIGHT_LIGHT_CLUSTERS_H
+
+#include "common.h"
+#include "array.h"
+#include "math.h"
+#include "culling.h"
+
+/*
+	Clustered light culling.
+
+	The view frustum is split into a grid of clusters ("froxels"): `LIGHT_CLUSTERS_X` by
+	  `LIGHT_CLUSTERS_Y` screen tiles, and `LIGHT_CLUSTERS_Z` depth slices whose thickness
+	  grows exponentially from the near to the far plane.  Every frame the spheres of
+	  positional lights are binned into the clusters they touch, so shading a pixel only
+	  loops over the lights of its cluster.
+
+	Binning runs on the CPU, one parallel job per depth slice, testing 4 lights at a time
+	  with SSE.  Nothing here touches the renderer, the results are uploaded by the caller.
+
+	Cluster `( x, y, z )` is at `clusters[ ( z * LIGHT_CLUSTERS_Y + y ) * LIGHT_CLUSTERS_X + x ]`,
+	  tile ( 0, 0 ) is the bottom left of the screen and slice 0 starts at the near plane.
+	Its lights are `light_indices[ offset .. offset + count )`, indices into the binned lights.
+*/
+
+constexpr u32 LIGHT_CLUSTERS_X = 16;
+constexpr u32 LIGHT_CLUSTERS_Y = 9;
+constexpr u32 LIGHT_CLUSTERS_Z = 24;
+constexpr u32 LIGHT_CLUSTERS_PER_SLICE = LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y;
+constexpr u32 LIGHT_CLUSTERS_COUNT = LIGHT_CLUSTERS_PER_SLICE * LIGHT_CLUSTERS_Z;
+
+// World-space bounds of a positional light.
+struct Light_Sphere {
+	Vector3_f32 position;
+	f32 radius;
+};
+
+// Matches `uvec2` of the clusters buffer in shaders.
+struct Light_Cluster {
+	u32 offset;
+	u32 count;
+};
+
+// Lights of one depth slice, filled by its own job.
+struct Light_Clusters_Slice {
+	// View-space spheres that overlap the slice's depth range, 4 at a time.
+	Array< f32 > center_x;
+	Array< f32 > center_y;
+	Array< f32 > center_z;
+	Array< f32 > radius_squared;
+	Array< u32 > light_index;
+
+	Light_Cluster clusters[ LIGHT_CLUSTERS_PER_SLICE ];  // Offsets into `light_indices` below.
+	Array< u32 > light_indices;
+};
+
+struct Light_Clusters {
+	// The projection `bounds` were calculated for.
+	Matrix4x4_f32 projection;
+	f32 z_near;
+	f32 z_far;
+	// Slice of a view-space depth `d` (positive) is `floor( log( d ) * depth_scale + depth_bias )`.
+	f32 depth_scale;
+	f32 depth_bias;
+	Array< AABB > bounds;  // View space.
+
+	Array< Light_Cluster > clusters;
+	Array< u32 > light_indices;
+	u32 max_cluster_lights;
+
+	// Scratch, reused between frames.
+	Matrix4x4_f32 view;
+	Array< Vector4_f32 > view_spheres;  // xyz: view-space center, w: radius.
+	Light_Clusters_Slice slices[ LIGHT_CLUSTERS_Z ];
+};
+
+void light_clusters_init( Light_Clusters *clusters, Allocator *allocator );
+void light_clusters_destroy( Light_Clusters *clusters );
+
+// Rebuilds `clusters` and `light_indices` for the given camera.  Indices refer to `lights`.
+// `projection` must be a perspective projection with OpenGL's [-1, 1] depth range.
+void light_clusters_build( Light_Clusters *clusters, Matrix4x4_f32 *view, Matrix4x4_f32 *projection, ArrayView< Light_Sphere > lights );
+
+struct Light_Clusters_Test {
+	u32 lights_count;
+	u32 binned_count;           // Light indices in all clusters.
+	u32 mismatched_clusters;    // Whose lights differ from the scalar test's.
+	u32 max_cluster_lights;
+	bool bins_equal;
+};
+
+// Bins `lights_count` random lights around a fixed camera and checks every cluster against a scalar
+//   sphere-box test of every light, done on the same view-space spheres, which must agree exactly.
+// Needs the job system.
+Light_Clusters_Test light_clusters_test( u32 lights_count );
+
+inline u32 light_clusters_index( u32 x, u32 y, u32 z ) {
+	return ( z * LIGHT_CLUSTERS_Y + y ) * LIGHT_CLUSTERS_X + x;
+}
+
+#endif /* QLIGHT_LIGHT_CLUSTERS_H */
@@ -0,0 +1,132 @@
+#include "light_markers.h"
+#include "renderer_commands.h"
+#include "transform.h"
+#include "jobs.h"
+
+constexpr u32 LIGHT_MARKERS_BUFFER_SETS = 2;
+constexpr u32 LIGHT_MARKERS_MAX_JOBS = JOBS_MAX_WORKERS + 1;
+// A marker sets 2 uniforms and draws, with headers and padding.  Job 0 also records the shared setup, about as big.
+constexpr u64 LIGHT_MARKER_PACKET_MAX_SIZE = 256;
+constexpr f32 LIGHT_MARKER_SCALE = 0.05f;
+
+struct Light_Markers_Buffer_Set {
+	Renderer_Command_Buffer buffers[ LIGHT_MARKERS_MAX_JOBS ];
+	Renderer_Command_Buffer *buffer_pointers[ LIGHT_MARKERS_MAX_JOBS ];
+	Renderer_Command_Stream stream;
+};
+
+struct G_Light_Markers {
+	Light_Markers_Buffer_Set sets[ LIGHT_MARKERS_BUFFER_SETS ];
+	u32 set_idx;
+	u32 jobs_count;
+	Mesh_ID mesh_id;
+	bool initialized;
+	bool enabled;
+
+	// Of the frame being recorded, read by the jobs.
+	Renderer_Shader_Program *program;  // Looked up every frame.
+	ArrayView< Shader_Storage_Light > lights;
+	Camera *camera;
+} g_light_markers;
+
+void light_markers_init( Mesh_ID mesh_id ) {
+	g_light_markers.jobs_count = QL_min2( jobs_workers_count() + 1, LIGHT_MARKERS_MAX_JOBS );
+	u64 buffer_capacity = ( LIGHT_MARKERS_MAX / g_light_markers.jobs_count + 2 ) * LIGHT_MARKER_PACKET_MAX_SIZE;
+	// 3 commands per marker and 3 for the setup, so merging never has to grow the stream.
+	u32 stream_capacity = ( LIGHT_MARKERS_MAX + 1 ) * 3;
+	ForIt( g_light_markers.sets, LIGHT_MARKERS_BUFFER_SETS ) {
+		For2( g_light_markers.jobs_count ) {
+			renderer_command_buffer_init( &it.buffers[ it2_index ], buffer_capacity );
+			it.buffer_pointers[ it2_index ] = &it.buffers[ it2_index ];
+		}
+		renderer_command_stream_init( &it.stream, sys_allocator, stream_capacity );
+	}}
+
+	g_light_markers.set_idx = 0;
+	g_light_markers.mesh_id = mesh_id;
+	g_light_markers.initialized = true;
+	g_light_markers.enabled = true;
+}
+
+void light_markers_shutdown() {
+	if ( !g_light_markers.initialized )
+		return;
+
+	ForIt( g_light_markers.sets, LIGHT_MARKERS_BUFFER_SETS ) {
+		For2( g_light_markers.jobs_count ) {
+			renderer_command_buffer_destroy( &it.buffers[ it2_index ] );
+		}
+		renderer_command_stream_destroy( &it.stream );
+	}}
+	g_light_markers.initialized = false;
+}
+
+static void
+light_markers_record_job( void *data, u32 job_index ) {
+	Light_Markers_Buffer_Set *set = ( Light_Markers_Buffer_Set * )data;
+	Renderer_Command_Buffer *buffer = &set->buffers[ job_index ];
+	Renderer_Shader_Program *program = g_light_markers.program;
+	Renderer_Uniform_ID model_uniform = renderer_shader_program_find_uniform( program, "model" );
+	Renderer_Uniform_ID color_uniform = renderer_shader_program_find_uniform( program, "light_color" );
+
+	// Key 0 sets up what all markers share, the markers follow in the order of the lights.
+	if ( job_index == 0 ) {
+		renderer_command_buffer_set_sort_key( buffer, 0 );
+		renderer_record_bind_program( buffer, program );
+		renderer_record_set_uniform( buffer, program, renderer_shader_program_find_uniform( program, "view" ), &g_light_markers.camera->view_matrix );
+		renderer_record_set_uniform( buffer, program, renderer_shader_program_find_uniform( program, "projection" ), &g_light_markers.camera->projection_matrix );
+	}
+
+	u32 lights_count = g_light_markers.lights.size;
+	u32 lights_per_job = ( lights_count + g_light_markers.jobs_count - 1 ) / g_light_markers.jobs_count;
+	u32 first_light = job_index * lights_per_job;
+	u32 last_light = QL_min2( first_light + lights_per_job, lights_count );
+	for ( u32 light_idx = first_light; light_idx < last_light; light_idx += 1 ) {
+		Shader_Storage_Light *light = &g_light_markers.lights.data[ light_idx ];
+		Transform transform = transform_identity();
+		transform.position = Vector3_f32 { light->position.x, light->position.y, light->position.z };
+		transform.scale = Vector3_f32 { LIGHT_MARKER_SCALE, LIGHT_MARKER_SCALE, LIGHT_MARKER_SCALE };
+		transform_recalculate_matrices( &transform );
+		Vector3_f32 color = { light->color.x, light->color.y, light->color.z };
+
+		renderer_command_buffer_set_sort_key( buffer, ( u64 )light_idx + 1 );
+		renderer_record_set_uniform( buffer, program, model_uniform, &transform.model_matrix );
+		renderer_record_set_uniform( buffer, program, color_uniform, &color );
+		renderer_record_draw( buffer, g_light_markers.mesh_id );
+	}
+}
+
+void light_markers_draw( Lights_Manager *lights, Camera *camera ) {
+	if ( !g_light_markers.initialized || !g_light_markers.enabled )
+		return;
+
+	Renderer_Shader_Program *program = renderer_find_shader_program( "light_object_program" );
+	if ( !program )
+		return;
+
+	// Positional lights follow the directional ones.
+	u32 directional_count = lights->directional_lights_count;
+	u32 positional_count = QL_min2( lights->lights.size - directional_count, LIGHT_MARKERS_MAX );
+	g_light_markers.program = program;
+	g_light_markers.lights = array_view( lights->lights.data + directional_count, positional_count );
+	g_light_markers.camera = camera;
+
+	// The other set is still read by the frame the render thread draws.
+	Light_Markers_Buffer_Set *set = &g_light_markers.sets[ g_light_markers.set_idx ];
+	g_light_markers.set_idx = ( g_light_markers.set_idx + 1 ) % LIGHT_MARKERS_BUFFER_SETS;
+	For( g_light_markers.jobs_count ) {
+		renderer_command_buffer_reset( &set->buffers[ it_index ] );
+	}
+
+	jobs_run_parallel( g_light_markers.jobs_count, light_markers_record_job, set );
+	renderer_command_stream_merge( &set->stream, array_view( set->buffer_pointers, g_light_markers.jobs_count ) );
+	renderer_submit_command_stream( &set->stream );
+}
+
+void light_markers_set_enabled( bool enabled ) {
+	g_light_markers.enabled = enabled;
+}
+
+bool light_markers_enabled() {
+	return g_light_markers.enabled;
+}
@@ -0,0 +1,30 @@
+#ifndef QLIGHT_LIGHT_MARKERS_H
+#define QLIGHT_LIGHT_MARKERS_H
+
+#include "common.h"
+#include "model.h"
+#include "camera.h"
+#include "map.h"
+
+/*
+	Small unlit cubes in the colors of the positional lights, drawn over the lit image.
+
+	Every frame the job workers record the markers into their own command buffers, which are
+	  merged into one stream and submitted with `renderer_submit_command_stream()`.
+	The stream is replayed by the frame drawn by the next `renderer_draw_frame()`, so two sets
+	  of buffers take turns: one is recorded while the render thread may still read the other.
+*/
+
+// Light markers past this are not drawn.
+constexpr u32 LIGHT_MARKERS_MAX = 4096;
+
+// `mesh_id` is drawn for every marker, scaled down, with the `light_object_program` shader program.
+void light_markers_init( Mesh_ID mesh_id );
+void light_markers_shutdown();
+
+// Records the markers of `lights`' positional lights, seen by `camera`, and submits them for the next frame.
+void light_markers_draw( Lights_Manager *lights, Camera *camera );
+void light_markers_set_enabled( bool enabled );
+bool light_markers_enabled();
+
+#endif /* QLIGHT_LIGHT_MARKERS_H */
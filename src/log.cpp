@@ -1,5 +1,6 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include <stdio.h>
+#include <stdarg.h>
 
 #include "log.h"
 
@@ -59,6 +60,7 @@ void log( Log_Level level, StringView_ASCII channel, const char *format, ... ) {
 	/* Insert '\n\0' at the end of message/buffer */
 
 	cursor += vsnprintf( buffer + cursor, LOG_BUFFER_SIZE - cursor, format, var_args );
+	va_end( var_args );
 	// `cursor - 1`: Ignore null-terminator so it points to the last char
 	int last_char_idx = ( cursor < LOG_BUFFER_SIZE ) ? cursor - 1 : LOG_BUFFER_SIZE - 3;
 	buffer[ last_char_idx + 1 ] = '\n';
@@ -7,14 +7,16 @@
 // Define this in the module.
 // #define QL_LOG_CHANNEL "Name"
 
-#define log_info( format, ... )     log( LogLevel_Info, QL_LOG_CHANNEL, format, __VA_ARGS__ )
-#define log_warning( format, ... )  log( LogLevel_Warning, QL_LOG_CHANNEL, format, __VA_ARGS__ )
-#define log_error( format, ... )    log( LogLevel_Error, QL_LOG_CHANNEL, format, __VA_ARGS__ )
+// The format is the first of the variadic arguments, so a message without any arguments
+//   leaves no trailing comma behind on compilers that do not drop it.
+#define log_info( ... )     log( LogLevel_Info, QL_LOG_CHANNEL, __VA_ARGS__ )
+#define log_warning( ... )  log( LogLevel_Warning, QL_LOG_CHANNEL, __VA_ARGS__ )
+#define log_error( ... )    log( LogLevel_Error, QL_LOG_CHANNEL, __VA_ARGS__ )
 
 #ifdef QLIGHT_DEBUG
-#define log_debug( format, ... )    log( LogLevel_Debug, QL_LOG_CHANNEL, format, __VA_ARGS__ )
+#define log_debug( ... )    log( LogLevel_Debug, QL_LOG_CHANNEL, __VA_ARGS__ )
 #else
-#define log_debug( format, ... )
+#define log_debug( ... )
 #endif
 
 enum Log_Level : u8 {
@@ -1,6 +1,10 @@
+#include <chrono>
+
 #include "imgui/imgui.h"
+#ifndef QLIGHT_HEADLESS
 #include "imgui/imgui_impl_glfw.h"
 #include "imgui/imgui_impl_opengl3.h"
+#endif
 
 #include "opengl.h"
 #include "texture.h"
@@ -9,9 +13,22 @@
 #include "map.h"
 #include "math.h"
 #include "renderer.h"
+#include "renderer_batch.h"
+#include "renderer_capture.h"
+#include "renderer_commands.h"
+#include "renderer_opengl_state.h"
+#include "renderer_software.h"
+#include "renderer_thread.h"
+#include "radix_sort.h"
 #include "console.h"
 #include "transform.h"
 #include "camera.h"
+#include "jobs.h"
+#include "heap_profiler.h"
+#include "tlsf_allocator.h"
+#include "light_markers.h"
+#include "light_clusters.h"
+#include "occlusion.h"
 
 #define QL_LOG_CHANNEL "App"
 #include "log.h"
@@ -28,6 +45,9 @@ bool imgui_draw_demo_window = false;
 bool imgui_draw_entities_window = true;
 bool imgui_draw_textures_window = true;
 bool imgui_draw_materials_window = true;
+bool imgui_draw_heap_window = true;
+// Taken at start, so opening the heap window does not allocate.
+Heap_Profiler_Snapshot g_heap_snapshot;
 bool freeze_light_change = false;
 bool freeze_camera = false;
 
@@ -36,6 +56,7 @@ Vector2_f32 g_cursor_position;
 //
 // --- Callbacks ---
 //
+#ifndef QLIGHT_HEADLESS
 void framebuffer_size_callback(GLFWwindow* window, int new_screen_width, int new_screen_height) {
 	screen.width = new_screen_width;
 	screen.height = new_screen_height;
@@ -179,10 +200,12 @@ void glfw_error_callback(int error_code, const char* description) {
 		error_code
 	);
 }
+#endif
 
 static void
 load_phong_lighting_shader() {
-	Array< Renderer_Shader_Stage * > stages  = array_new< Renderer_Shader_Stage * >( sys_allocator, RendererShaderKind_COUNT );
+	Linear_Allocator_Scope scratch_scope( renderer_frame_arena() );
+	Array< Renderer_Shader_Stage * > stages  = array_new< Renderer_Shader_Stage * >( renderer_frame_arena(), RendererShaderKind_COUNT );
 
 	// Vertex
 	array_add( &stages, renderer_load_shader_stage(
@@ -215,72 +238,45 @@ load_phong_lighting_shader() {
 		.bits = RendererVertexAttributeBit_Active
 	} );
 
-	/* Uniforms */
-
-	Array< Renderer_Uniform > *phong_uniforms = &shader->uniforms;
-
-	/* Vertex stage uniforms */
-
-	/* Fragment stage uniforms */
-
-	array_add( phong_uniforms, Renderer_Uniform {
-		.name = "gbuffer_position",
-		.data_type = RendererDataType_s32,
-	} );
-
-	array_add( phong_uniforms, Renderer_Uniform {
-		.name = "gbuffer_normal",
-		.data_type = RendererDataType_s32,
-	} );
-
-	array_add( phong_uniforms, Renderer_Uniform {
-		.name = "gbuffer_diffuse_specular",
-		.data_type = RendererDataType_s32,
-	} );
-
-	array_add( phong_uniforms, Renderer_Uniform {
-		.name = "view_position",
-		.data_type = RendererDataType_Vector3_f32,
-	} );
-
-	array_add( phong_uniforms, Renderer_Uniform {
-		.name = "ambient",
-		.data_type = RendererDataType_Vector3_f32,
-	} );
-
-	array_add( phong_uniforms, Renderer_Uniform {
-		.name = "shininess_exponent",
-		.data_type = RendererDataType_f32,
-	} );
+	// Lights are read from shader storage buffers bound by `maps_update_lights_manager()`,
+	//   see `LIGHTS_STORAGE_BUFFER_BINDING` and the ones after it.
+}
 
-	renderer_shader_program_update_uniform_locations( shader );
+// Unlit, in one color: the light markers, see `light_markers.h`.
+static void
+load_light_object_shader() {
+	Linear_Allocator_Scope scratch_scope( renderer_frame_arena() );
+	Array< Renderer_Shader_Stage * > stages  = array_new< Renderer_Shader_Stage * >( renderer_frame_arena(), RendererShaderKind_COUNT );
 
-	/* Uniform Buffers */
+	array_add( &stages, renderer_load_shader_stage(
+		"light_object_vertex",
+		RendererShaderKind_Vertex,
+		"resources/shaders/light_object_vertex.glsl"
+	) );
 
-	Array< Renderer_Uniform_Buffer > *phong_uniform_buffers = &shader->uniform_buffers;
+	array_add( &stages, renderer_load_shader_stage(
+		"light_object_fragment",
+		RendererShaderKind_Fragment,
+		"resources/shaders/light_object_fragment.glsl"
+	) );
 
-	// Here we reconstruct shader-bound declaration info.
-	// Ideally, this should be done by some shader parser.
-	array_add( phong_uniform_buffers, Renderer_Uniform_Buffer {
-		.name = "Lights",
-		.size = sizeof( Uniform_Buffer_Lights ),
-		.binding = 0
-		// .storage_bits
-		// .opengl_ubo
-	} );
+	renderer_create_and_compile_shader_program(
+		"light_object_program",
+		array_view( &stages )
+	);
 }
 
 void load_shaders() {
 	load_phong_lighting_shader();
+	load_light_object_shader();
+	// Every material is lit by it, in a single pass.
+	renderer_set_lighting_shader_program( renderer_find_shader_program( "phong_program" ) );
 }
 
 void load_texture( StringView_ASCII name, StringView_ASCII file_path, Texture_Channels channels, GLint opengl_storage_format ) {
 	Texture_ID texture_id = texture_load_from_file( name, file_path, channels );
-	Texture *texture = texture_instance( texture_id );
-	renderer_texture_2d_upload(
+	renderer_texture_array_upload(
 		/*            texture_id */ texture_id,
-		/*                origin */ { 0, 0 },
-		/*            dimensions */ texture->dimensions,
 		/*         mipmap_levels */ 5,
 		/* opengl_storage_format */ opengl_storage_format,
 		/*     opengl_pixel_type */ GL_UNSIGNED_BYTE
@@ -315,7 +311,7 @@ void create_materials() {
 	Texture_ID specular = INVALID_TEXTURE_ID;
 	float shininess_exponent = 0.0f;
 
-	material_create( "dummy", NULL, INVALID_TEXTURE_ID, INVALID_TEXTURE_ID, INVALID_TEXTURE_ID, 0.0f );
+	material_create( "dummy", shader, INVALID_TEXTURE_ID, INVALID_TEXTURE_ID, INVALID_TEXTURE_ID, 0.0f );
 
 //#ifdef LOAD_TEXTURES
 	diffuse = texture_find( "bark_diffuse" );
@@ -358,6 +354,7 @@ void create_materials() {
 	material_create( "rocks-medium", shader, diffuse, normal, specular, shininess_exponent );
 }
 
+#ifndef QLIGHT_HEADLESS
 // Not sure whether this is the right place...
 // The `Entity` header does not have any functions as well as a source file.
 // Maybe it would be moved there when there would be one.
@@ -379,6 +376,49 @@ entity_type_name( Entity_Type type ) {
 	}
 }
 
+// Copied into a texture every frame the view is open.
+static Texture_ID g_occlusion_texture = INVALID_TEXTURE_ID;
+static Array< u8 > g_occlusion_pixels = { 0 };
+
+// Creates the texture up front, the game thread cannot call OpenGL once the render thread runs.
+static void
+imgui_occlusion_buffer_view_init() {
+	Occlusion_Buffer *occlusion = map_occlusion_buffer();
+	Vector2_u16 dimensions = { ( u16 )occlusion->width, ( u16 )occlusion->height };
+	g_occlusion_pixels = array_new< u8 >( sys_allocator, dimensions.width * dimensions.height * 4 );
+	g_occlusion_pixels.size = g_occlusion_pixels.capacity;
+	g_occlusion_texture = texture_create(
+		/*       name */ "Occlusion Buffer",
+		/* dimensions */ dimensions,
+		/*   channels */ TextureChannels_RGBA,
+		/*      bytes */ array_view( &g_occlusion_pixels ),
+		/*  allocator */ NULL
+	);
+	renderer_texture_2d_upload(
+		/*            texture_id */ g_occlusion_texture,
+		/*                origin */ { 0, 0 },
+		/*            dimensions */ dimensions,
+		/*         mipmap_levels */ 1,
+		/* opengl_storage_format */ GL_RGBA8,
+		/*     opengl_pixel_type */ GL_UNSIGNED_BYTE
+	);
+}
+
+static void
+imgui_occlusion_buffer_view() {
+	Occlusion_Buffer *occlusion = map_occlusion_buffer();
+	Vector2_u16 dimensions = { ( u16 )occlusion->width, ( u16 )occlusion->height };
+
+	Texture *texture = texture_instance( g_occlusion_texture );
+	occlusion_buffer_debug_rgba( occlusion, g_occlusion_pixels.data );
+	renderer_texture_2d_update( g_occlusion_texture );
+
+	// Row 0 of the buffer is the top of the screen and the first row of the texture, so UVs are not flipped.
+	ImTextureID image_id = ( ImTextureID )( intptr_t )texture->opengl_id;
+	ImGui::Image( image_id, ImVec2( dimensions.width * 2.0f, dimensions.height * 2.0f ) );
+	ImGui::Text( "%ux%u, %u occluders, %u triangles", occlusion->width, occlusion->height, occlusion->occluders_count, occlusion->triangles.size );
+}
+
 static bool
 imgui_entity_base_fields( Entity *entity ) {
 	ImGui::TextDisabled( "--- Entity ---" );
@@ -389,6 +429,7 @@ imgui_entity_base_fields( Entity *entity ) {
 
 	if ( ImGui::TreeNode( "Bits" ) ) {
 		modified |= ImGui::CheckboxFlags( "NoDraw", ( u32 * )&entity->bits, EntityBit_NoDraw );
+		modified |= ImGui::CheckboxFlags( "Occluder", ( u32 * )&entity->bits, EntityBit_Occluder );
 
 		ImGui::TreePop();
 	}
@@ -401,8 +442,9 @@ imgui_entity_base_fields( Entity *entity ) {
 		modified_transform |= ImGui::DragFloat3("Scale", &t->scale[ 0 ], 0.01f, 0.0f, 100.0f, "%.1f", ImGuiSliderFlags_Logarithmic | ImGuiSliderFlags_NoRoundToFormat );
 		modified |= modified_transform;
 
+		// Matrices and bounds are recalculated before the next draw.
 		if ( modified_transform )
-			transform_recalculate_matrices( t );
+			transform_set_dirty( t, true );
 
 		ImGui::TreePop();
 	}
@@ -447,11 +489,30 @@ imgui_entity_camera_fields( Entity_Camera *entity ) {
 	return modified;
 }
 
+// The material of the model's mesh, shared by every object that draws the model.
+static bool
+imgui_model_mesh_material_field( Model_ID model_id ) {
+	Model *model = model_instance( model_id );
+	if ( !model )
+		return false;
+
+	Mesh *mesh = mesh_instance( model->meshes.data[ 0 ] );
+	if ( !ImGui::InputScalar( "Mesh Material ID", ImGuiDataType_U16, &mesh->material_id ) )
+		return false;
+
+	map_render_proxies_set_dirty();  // Render proxies are sorted by their material.
+	return true;
+}
+
 static bool
 imgui_entity_static_object_fields( Entity_Static_Object *object ) {
 	ImGui::TextDisabled( "--- Entity_Static_Object ---" );
 	bool modified = false;
 	modified |= ImGui::InputScalar( "Model ID", ImGuiDataType_U16, &object->model );
+	if ( modified )
+		transform_set_dirty( &object->transform, true );  // World bounds and the render proxy depend on the model.
+	modified |= imgui_model_mesh_material_field( object->model );
+
 	return modified;
 }
 
@@ -460,6 +521,9 @@ imgui_entity_dynamic_object_fields( Entity_Dynamic_Object *object ) {
 	ImGui::TextDisabled( "--- Entity_Dynamic_Object ---" );
 	bool modified = false;
 	modified |= ImGui::InputScalar( "Model ID", ImGuiDataType_U16, &object->model );
+	if ( modified )
+		transform_set_dirty( &object->transform, true );  // World bounds and the render proxy depend on the model.
+	modified |= imgui_model_mesh_material_field( object->model );
 	return modified;
 }
 
@@ -478,6 +542,7 @@ imgui_entity_point_light_fields( Entity_Point_Light *light ) {
 	bool modified = false;
 	modified |= ImGui::ColorEdit3( "Color", &light->color[ 0 ] );
 	modified |= ImGui::DragFloat( "Intensity", &light->intensity, 0.001f, 0.0f, 100.0f, "%.3f", ImGuiSliderFlags_NoRoundToFormat);
+	modified |= ImGui::DragFloat( "Radius", &light->radius, 0.01f, 0.01f, 1000.0f, "%.2f", ImGuiSliderFlags_NoRoundToFormat);
 	return modified;
 }
 
@@ -487,6 +552,7 @@ imgui_entity_spot_light_fields( Entity_Spot_Light *light ) {
 	bool modified = false;
 	modified |= ImGui::ColorEdit3( "Color", &light->color[ 0 ] );
 	modified |= ImGui::DragFloat( "Intensity", &light->intensity, 0.001f, 0.0f, 100.0f, "%.3f", ImGuiSliderFlags_NoRoundToFormat);
+	modified |= ImGui::DragFloat( "Radius", &light->radius, 0.01f, 0.01f, 1000.0f, "%.2f", ImGuiSliderFlags_NoRoundToFormat);
 	return modified;
 }
 
@@ -508,12 +574,318 @@ imgui_entity_derived_fields( Entity *entity ) {
 			return false;
 	}
 }
+#endif
 
-int main()
-{
-	console_init( CP_UTF8 );
-	log_init();
+struct App_Options {
+	// Frames to run on the null renderer without a window, 0 opens the window as usual.
+	u32 benchmark_frames;
+	// Cubes added to the map in a grid, so the benchmark has something to chew on.
+	u32 benchmark_objects;
+	// NULL - stay on the map `maps_init()` starts with.
+	const char *map_name;
+
+	// Frames `capture_first_frame` to `capture_first_frame + capture_frames - 1` are captured into `capture_file`.
+	const char *capture_file;
+	u32 capture_first_frame;
+	u32 capture_frames;
+	// Replayed instead of running the main loop, on `replay_backend`.
+	const char *replay_file;
+	Renderer_Backend replay_backend;
+
+	// Headless runs draw their frames on the software rasterizer instead of dropping them.
+	bool software;
+	// The last benchmark frame is written into it, implies `software`.
+	const char *screenshot_file;
+	// 0 - the default screen size.
+	u32 width;
+	u32 height;
+	// 0 - one less than the number of hardware threads.
+	u32 workers_count;
+	// The heap profile is written into it on exit.
+	const char *heap_dump_file;
+	// Allocations are traced from the start, through the benchmark or up to the main loop,
+	//   and replayed on `System_Allocator` and `TLSF_Allocator`.
+	bool tlsf_benchmark;
+	// Run the self tests on the null renderer instead of the main loop.
+	bool self_test;
+};
+
+/*
+	--benchmark <frames>          Run headless on the null renderer and log CPU timings of every frame stage.
+	--benchmark-objects <count>   Add that many cubes to the map first.
+	--map <name>                  Change to the map before the scene is set up.
+	--capture <file> <first> <n>  Capture the OpenGL calls of `n` frames from frame `first` on, see `renderer_capture.h`.
+	--replay <file>               Replay a capture on OpenGL and log the cost of every call, then quit.
+	--replay-null <file>          The same without a window, on the null renderer.
+	--software                    Run the benchmark on the software rasterizer instead of the null renderer.
+	--screenshot <file>           Draw the benchmark on the software rasterizer and write its last frame
+	                                into the file (PPM), 1 frame unless `--benchmark` says otherwise.
+	--size <width> <height>       Screen size, of the window or of the headless frames.
+	--workers <count>             Job worker threads.
+	--heap-dump <file>            Write the heap profile into the file on exit, see `heap_profiler.h`.
+	--tlsf-benchmark              Trace the allocations of startup (and of the benchmark) and replay them
+	                                on the TLSF allocator, see `tlsf_allocator.h`.
+	--self-test                   Run the self tests without a window, on the null renderer, then quit.
+	                                The exit code is nonzero if any of them failed.
+*/
+static App_Options
+parse_command_line( int argc, char **argv ) {
+	App_Options options = { 0 };
+	for ( int arg_idx = 1; arg_idx < argc; arg_idx += 1 ) {
+		const char *arg = argv[ arg_idx ];
+		const char *value = ( arg_idx + 1 < argc ) ? argv[ arg_idx + 1 ] : NULL;
+		if ( value && strcmp( arg, "--benchmark" ) == 0 ) {
+			options.benchmark_frames = ( u32 )strtoul( value, NULL, 10 );
+			arg_idx += 1;
+		} else if ( value && strcmp( arg, "--benchmark-objects" ) == 0 ) {
+			options.benchmark_objects = ( u32 )strtoul( value, NULL, 10 );
+			arg_idx += 1;
+		} else if ( value && strcmp( arg, "--map" ) == 0 ) {
+			options.map_name = value;
+			arg_idx += 1;
+		} else if ( arg_idx + 3 < argc && strcmp( arg, "--capture" ) == 0 ) {
+			options.capture_file = value;
+			options.capture_first_frame = ( u32 )strtoul( argv[ arg_idx + 2 ], NULL, 10 );
+			options.capture_frames = ( u32 )strtoul( argv[ arg_idx + 3 ], NULL, 10 );
+			arg_idx += 3;
+		} else if ( value && ( strcmp( arg, "--replay" ) == 0 || strcmp( arg, "--replay-null" ) == 0 ) ) {
+			options.replay_file = value;
+			options.replay_backend = ( strcmp( arg, "--replay-null" ) == 0 ) ? RendererBackend_Null : RendererBackend_OpenGL;
+			arg_idx += 1;
+		} else if ( strcmp( arg, "--software" ) == 0 ) {
+			options.software = true;
+		} else if ( value && strcmp( arg, "--screenshot" ) == 0 ) {
+			options.screenshot_file = value;
+			options.software = true;
+			arg_idx += 1;
+		} else if ( arg_idx + 2 < argc && strcmp( arg, "--size" ) == 0 ) {
+			options.width = ( u32 )strtoul( value, NULL, 10 );
+			options.height = ( u32 )strtoul( argv[ arg_idx + 2 ], NULL, 10 );
+			arg_idx += 2;
+		} else if ( value && strcmp( arg, "--workers" ) == 0 ) {
+			options.workers_count = ( u32 )strtoul( value, NULL, 10 );
+			arg_idx += 1;
+		} else if ( value && strcmp( arg, "--heap-dump" ) == 0 ) {
+			options.heap_dump_file = value;
+			arg_idx += 1;
+		} else if ( strcmp( arg, "--tlsf-benchmark" ) == 0 ) {
+			options.tlsf_benchmark = true;
+		} else if ( strcmp( arg, "--self-test" ) == 0 ) {
+			options.self_test = true;
+		} else {
+			log_warning( "Unknown command line argument '%s', ignored.", arg );
+		}
+	}
 
+	if ( options.screenshot_file && options.benchmark_frames == 0 )
+		options.benchmark_frames = 1;
+	// The renderer keeps frame dimensions in 16 bits.
+	if ( options.width > U16_MAX || options.height > U16_MAX ) {
+		log_warning( "Screen size %ux%u is too big, using the default one.", options.width, options.height );
+		options.width = 0;
+		options.height = 0;
+	}
+
+	return options;
+}
+
+static void
+benchmark_objects_add( Map *map, Model_ID model_id, u32 count ) {
+	// Square grid on the ground, centered under the scene.
+	u32 side = 1;
+	while ( side * side < count )
+		side += 1;
+
+	constexpr f32 spacing = 1.5f;
+	f32 half_extent = ( f32 )( side - 1 ) * spacing * 0.5f;
+	For( count ) {
+		Entity_Static_Object entity_cube;
+		// Entity
+		entity_cube.type = EntityType_StaticObject;
+		entity_cube.parent = INVALID_ENTITY_ID;
+		entity_cube.bits = 0;
+		entity_cube.transform = transform_identity();
+		// Entity_Static_Object
+		entity_cube.model = model_id;
+		entity_cube.transform.scale = { 0.5f, 0.5f, 0.5f };
+		entity_cube.transform.position = {
+			( f32 )( it_index % side ) * spacing - half_extent,
+			-2.0f,
+			( f32 )( it_index / side ) * spacing - half_extent + 4.0f
+		};
+		map_entity_add( map, &entity_cube );
+	}
+}
+
+// `sys_allocator` calls of the last frame, by every thread, from its update to its `renderer_draw_frame()`.
+static u64 g_frame_system_allocations = 0;
+
+// `frame_start_allocations` - `system_allocations_count()` before the frame began.
+static void
+frame_system_allocations_check( u64 frame_start_allocations ) {
+	g_frame_system_allocations = system_allocations_count() - frame_start_allocations;
+	AssertMessage( !renderer_frame_steady_state() || g_frame_system_allocations == 0,
+		"Steady-state frame allocated through sys_allocator" );
+}
+
+struct Frame_Benchmark_Stage {
+	const char *name;
+	f64 total_milliseconds;
+	f64 min_milliseconds;
+	f64 max_milliseconds;
+};
+
+static void
+frame_benchmark_stage_add( Frame_Benchmark_Stage *stage, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end ) {
+	f64 milliseconds = std::chrono::duration< f64, std::milli >( end - start ).count();
+	stage->total_milliseconds += milliseconds;
+	stage->min_milliseconds = QL_min2( stage->min_milliseconds, milliseconds );
+	stage->max_milliseconds = QL_max2( stage->max_milliseconds, milliseconds );
+}
+
+// Runs the frames the main loop would, minus input and UI, with the camera orbiting the scene.
+// Frames are a fixed step apart on the null renderer, so the same arguments give the same frames.
+static void
+run_frame_benchmark( Map *map, u32 frames_count ) {
+	enum {
+		Stage_Camera = 0,
+		Stage_Lights,
+		Stage_Map,
+		Stage_Renderer,
+		Stage_Frame,
+
+		Stage_COUNT
+	};
+	Frame_Benchmark_Stage stages[ Stage_COUNT ] = {
+		{ .name = "Cameras update" },
+		{ .name = "Lights manager" },
+		{ .name = "Map draw (culling, proxies, markers)" },
+		{ .name = "Renderer frame (packet, batches)" },
+		{ .name = "Whole frame" }
+	};
+	ForIt( stages, Stage_COUNT ) {
+		it.min_milliseconds = F64_MAX;
+		it.max_milliseconds = 0.0;
+	}}
+
+	log_info( "Running %u benchmark frames on the " StringViewFormat " renderer...",
+		frames_count,
+		StringViewArgument( renderer_backend_name( renderer_backend() ) )
+	);
+
+	Vector3_f32 orbit_center = { 0.0f, 0.0f, 4.0f };
+	constexpr f32 orbit_radius = 8.0f;
+	constexpr f32 orbit_height = 2.5f;
+	constexpr u32 orbit_frames = 600;
+	For( frames_count ) {
+		// One full turn every `orbit_frames`, facing the center.
+		f32 angle = PI2 * ( f32 )( it_index % orbit_frames ) / ( f32 )orbit_frames;
+		Vector3_f32 position = orbit_center + Vector3_f32 { sinf( angle ) * orbit_radius, orbit_height, cosf( angle ) * orbit_radius };
+		camera_set_position( g_camera, position );
+		camera_set_rotation_quaternion( g_camera, quaternion_from_axis_angle( WORLD_DIRECTION_UP, angle ) );
+
+		u64 frame_start_allocations = system_allocations_count();
+		auto frame_start = std::chrono::steady_clock::now();
+		cameras_update();
+		auto camera_end = std::chrono::steady_clock::now();
+		maps_update_lights_manager( g_camera );
+		auto lights_end = std::chrono::steady_clock::now();
+		map_draw( map, g_camera );
+		light_markers_draw( maps_lights_manager(), g_camera );
+		auto map_end = std::chrono::steady_clock::now();
+		renderer_draw_frame();
+		auto frame_end = std::chrono::steady_clock::now();
+		frame_system_allocations_check( frame_start_allocations );
+
+		frame_benchmark_stage_add( &stages[ Stage_Camera ], frame_start, camera_end );
+		frame_benchmark_stage_add( &stages[ Stage_Lights ], camera_end, lights_end );
+		frame_benchmark_stage_add( &stages[ Stage_Map ], lights_end, map_end );
+		frame_benchmark_stage_add( &stages[ Stage_Renderer ], map_end, frame_end );
+		frame_benchmark_stage_add( &stages[ Stage_Frame ], frame_start, frame_end );
+	}
+
+	ForIt( stages, Stage_COUNT ) {
+		log_info( "Benchmark: %-36s avg %8.4f ms, min %8.4f ms, max %8.4f ms",
+			it.name,
+			it.total_milliseconds / ( f64 )frames_count,
+			it.min_milliseconds,
+			it.max_milliseconds
+		);
+	}}
+
+	if ( renderer_backend() == RendererBackend_Software ) {
+		Renderer_Software_Stats software_stats = renderer_software_stats();
+		log_info( "Benchmark: last frame on the software rasterizer: %u triangles, %u binned into %u tiles (%u tile triangles), %u setup jobs; setup %.4f ms, tiles %.4f ms, %u workers.",
+			software_stats.triangles_submitted,
+			software_stats.triangles_binned,
+			software_stats.tiles,
+			software_stats.tile_triangles,
+			software_stats.setup_jobs,
+			software_stats.setup_milliseconds,
+			software_stats.tiles_milliseconds,
+			jobs_workers_count()
+		);
+	}
+
+	Map_Culling_Stats culling_stats = map_culling_stats();
+	log_info( "Benchmark: last frame: %u visible, %u culled, %u occluded (%u total); %u proxies, %u draw commands, %u draw calls, %u state changes (%u elided).",
+		culling_stats.visible,
+		culling_stats.culled,
+		culling_stats.occluded,
+		culling_stats.total,
+		renderer_proxies_count(),
+		renderer_draw_commands(),
+		renderer_draw_calls(),
+		renderer_state_changes_issued(),
+		renderer_state_changes_elided()
+	);
+	log_info( "Benchmark: frame arena high-water mark %llu KB, last frame made %llu sys_allocator calls.",
+		( unsigned long long )( renderer_frame_arena_high_water_mark() / 1024 ),
+		( unsigned long long )g_frame_system_allocations
+	);
+}
+
+// Events the allocation trace holds, 32 MB of them.
+constexpr u32 ALLOCATION_TRACE_EVENTS = 1024 * 1024;
+
+// Ends the allocation trace and replays it, see `tlsf_allocator_benchmark()`.
+static TLSF_Benchmark
+run_tlsf_benchmark() {
+	Heap_Trace trace = heap_profiler_trace_end();
+	TLSF_Benchmark benchmark = tlsf_allocator_benchmark( trace.events );
+	heap_profiler_trace_free( &trace );
+
+	log_info( "TLSF benchmark: %u events, peak %.3f MB in %u blocks.",
+		benchmark.events_count,
+		( f64 )benchmark.peak_live_bytes / ( 1024.0 * 1024.0 ),
+		benchmark.peak_live_blocks
+	);
+	TLSF_Latency *latencies[] = { &benchmark.system, &benchmark.tlsf };
+	const char *names[] = { "system", "TLSF" };
+	ForIt( latencies, ARRAY_SIZE( latencies ) ) {
+		log_info( "TLSF benchmark: %-6s %.3f ms, p50 %llu ns, p90 %llu ns, p99 %llu ns, p99.9 %llu ns, max %llu ns.",
+			names[ it_index ],
+			it->total_milliseconds,
+			( unsigned long long )it->percentile_50_ns,
+			( unsigned long long )it->percentile_90_ns,
+			( unsigned long long )it->percentile_99_ns,
+			( unsigned long long )it->percentile_999_ns,
+			( unsigned long long )it->max_ns
+		);
+	}}
+	log_info( "TLSF benchmark: bytes taken per byte asked for at the peak: system %.3f, TLSF %.3f; TLSF free memory fragmentation %.1f%%, arenas %.3f MB.",
+		benchmark.system_block_overhead,
+		benchmark.tlsf_block_overhead,
+		benchmark.tlsf_external_fragmentation * 100.0,
+		( f64 )benchmark.tlsf_arenas_size / ( 1024.0 * 1024.0 )
+	);
+	return benchmark;
+}
+
+#ifndef QLIGHT_HEADLESS
+// Opens the window, makes its OpenGL context current and hooks up the input callbacks.
+static GLFWwindow *
+create_window() {
 	GLFWwindow* window;
 
 	glfwSetErrorCallback(glfw_error_callback);
@@ -588,11 +960,190 @@ int main()
 	// 3 - 1/3...
 	glfwSwapInterval(1);
 
+	return window;
+}
+#endif
+
+static bool
+self_test_report( const char *name, bool passed ) {
+	if ( passed )
+		log_info( "Self test: %s: passed.", name );
+	else
+		log_error( "Self test: %s: FAILED.", name );
+	return passed;
+}
+
+// Checks that need no window, run by `--self-test` on the null renderer after the scene is set up.
+// Returns false if any of them failed.
+static bool
+run_self_tests() {
+	bool passed = true;
+
+	Renderer_Commands_Test commands_test = renderer_commands_test( 10000 );
+	passed &= self_test_report( "command streams recorded on one thread and on the job workers are equal", commands_test.streams_equal );
+
+	OpenGL_State_Test state_test = opengl_state_test();
+	log_info( "Self test: OpenGL state cache: %u calls reached the dispatch, %u expected, %u elided.",
+		state_test.calls_count,
+		state_test.expected_calls_count,
+		state_test.counters.elided
+	);
+	passed &= self_test_report( "the OpenGL state cache filters redundant binds", state_test.redundant_filtered );
+
+	Renderer_Batches_Test batches_test = renderer_batches_test();
+	log_info( "Self test: batched %u commands: %u draw calls before, %u after, %u with batches split.",
+		batches_test.commands_count,
+		batches_test.commands_count,
+		batches_test.batches_count,
+		batches_test.split_batches_count
+	);
+	passed &= self_test_report( "commands sharing mesh and material merge into instanced draws", batches_test.batches_expected && batches_test.indices_expected );
+	passed &= self_test_report( "batches split at the instance limit", batches_test.split_expected );
+
+	Renderer_Indirect_Draws_Test indirect_test = renderer_indirect_draws_test();
+	log_info( "Self test: %u batches became %u indirect commands in %u multi-draws.",
+		indirect_test.batches_count,
+		indirect_test.commands_count,
+		indirect_test.draws_count
+	);
+	passed &= self_test_report( "indirect commands point at their mesh and batch", indirect_test.commands_expected && indirect_test.draws_expected );
+
+	Offset_Allocator_Test offset_test = offset_allocator_test( 20000 );
+	log_info( "Self test: offset allocator: %u operations, %u allocations did not fit, %u failed with room left, %u overlapped.",
+		offset_test.operations_count,
+		offset_test.failed_count,
+		offset_test.false_failures_count,
+		offset_test.overlaps_count
+	);
+	passed &= self_test_report( "the offset allocator fits what has room and coalesces back to one range",
+		offset_test.false_failures_count == 0 && offset_test.overlaps_count == 0 && offset_test.ranges_consistent && offset_test.coalesced
+	);
+
+	Renderer_Commands_Replay_Test replay_test = renderer_commands_replay_test( 10000 );
+	log_info( "Self test: replayed %u commands: %u state changes (%u elided), %u draws; direct submission: %u state changes, %u draws.",
+		replay_test.commands_count,
+		replay_test.replayed_calls_count,
+		replay_test.replayed_elided,
+		replay_test.replayed_draw_calls,
+		replay_test.direct_calls_count,
+		replay_test.direct_draw_calls
+	);
+	passed &= self_test_report( "a replayed command stream reaches OpenGL like direct submission", replay_test.outputs_equal );
+
+	Culling_Test culling = culling_test( 64, 1001 );
+	log_info( "Self test: culled %u boxes in %u scenes: %u visible, %u disagree.",
+		culling.objects_count * culling.scenes_count,
+		culling.scenes_count,
+		culling.visible_count,
+		culling.mismatches_count
+	);
+	passed &= self_test_report( "SSE frustum culling agrees with the scalar test", culling.mismatches_count == 0 );
+
+	BVH_Test bvh = bvh_test( 5000, 200 );
+	log_info( "Self test: BVH: %u queries of each kind over %u boxes; dynamic tree: %u removed, %u reinserted; %u static and %u dynamic results differ.",
+		bvh.queries_count,
+		bvh.entries_count,
+		bvh.dynamic_removed_count,
+		bvh.dynamic_reinserted_count,
+		bvh.static_mismatches_count,
+		bvh.dynamic_mismatches_count
+	);
+	passed &= self_test_report( "static and dynamic BVH queries find what testing every box finds", bvh.static_mismatches_count == 0 && bvh.dynamic_mismatches_count == 0 );
+
+	Light_Clusters_Test clusters_test = light_clusters_test( 2000 );
+	log_info( "Self test: binned %u lights: %u cluster entries, at most %u in a cluster, %u clusters differ.",
+		clusters_test.lights_count,
+		clusters_test.binned_count,
+		clusters_test.max_cluster_lights,
+		clusters_test.mismatched_clusters
+	);
+	passed &= self_test_report( "light clusters hold the lights a scalar sphere-box test finds", clusters_test.bins_equal );
+
+	Occlusion_Test occlusion = occlusion_test();
+	log_info( "Self test: occlusion: %u of %u boxes hidden, %u wrong.",
+		occlusion.hidden_count,
+		occlusion.boxes_count,
+		occlusion.wrong_count
+	);
+	passed &= self_test_report( "boxes behind an occluder are hidden, the others visible", occlusion.results_expected );
+
+	Map_Render_Proxies_Test proxies_test = map_render_proxies_test( map_current(), g_camera );
+	passed &= self_test_report( "render proxies follow their mesh's material", proxies_test.object_found && proxies_test.rekeyed && proxies_test.restored );
+
+	Radix_Sort_Benchmark sort_benchmark = radix_sort_benchmark( 10000 );
+	log_info( "Self test: sorted %u keys: exchange sort %.3f ms, qsort %.3f ms, radix sort %.3f ms.",
+		sort_benchmark.items_count,
+		sort_benchmark.exchange_milliseconds,
+		sort_benchmark.qsort_milliseconds,
+		sort_benchmark.radix_milliseconds
+	);
+	passed &= self_test_report( "radix sort orders keys like qsort and the old exchange sort", sort_benchmark.results_equal );
+
+	Renderer_Software_Test software_test = renderer_software_test();
+	log_info( "Self test: software rasterizer: %u pixels covered, %u expected, checksum %08X, %08X expected.",
+		software_test.covered_pixels,
+		software_test.expected_covered_pixels,
+		software_test.checksum,
+		software_test.expected_checksum
+	);
+	passed &= self_test_report( "the software rasterizer covers shared edges once and draws the checked-in image",
+		software_test.covered_pixels == software_test.expected_covered_pixels && software_test.checksum == software_test.expected_checksum
+	);
+
+	Renderer_Capture_Replay_Test capture_test = renderer_capture_replay_test();
+	passed &= self_test_report( "a capture replay skips damaged records", capture_test.rejected_damaged );
+
+	return passed;
+}
+
+// What every way out of `main()` shares, after its own part.  False if the heap profile could not be written.
+static bool
+app_shutdown( const App_Options *options ) {
+	bool dumped = ( !options->heap_dump_file || heap_profiler_dump( options->heap_dump_file ) );
+	heap_profiler_snapshot_free( &g_heap_snapshot );
+	light_markers_shutdown();
+	jobs_shutdown();
+#ifndef QLIGHT_HEADLESS
+	// Does nothing if GLFW was never initialized, as in headless runs.
+	glfwTerminate();
+#endif
+	return dumped;
+}
+
+int main( int argc, char **argv )
+{
+	console_init();
+	log_init();
+
+	App_Options options = parse_command_line( argc, argv );
+	if ( options.tlsf_benchmark )
+		heap_profiler_trace_begin( ALLOCATION_TRACE_EVENTS );
+	bool benchmark = ( options.benchmark_frames > 0 );
+	bool headless = benchmark || options.self_test || ( options.replay_file && options.replay_backend == RendererBackend_Null );
+	if ( options.width > 0 && options.height > 0 ) {
+		screen.width = ( int )options.width;
+		screen.height = ( int )options.height;
+		screen.aspect_ratio = ( float )screen.width / ( float )screen.height;
+	}
+#ifdef QLIGHT_HEADLESS
+	if ( !headless ) {
+		log_error( "This build has no window, run it with --benchmark, --self-test or --replay-null." );
+		return EXIT_FAILURE;
+	}
+#else
+	GLFWwindow* window = ( headless ) ? NULL : create_window();
+#endif
+
+	jobs_init( options.workers_count );
+	heap_profiler_snapshot_init( &g_heap_snapshot );
 	textures_init();
 	materials_init();
 	models_init();
-	renderer_init();
+	Renderer_Backend headless_backend = ( options.software && benchmark ) ? RendererBackend_Software : RendererBackend_Null;
+	renderer_init( ( headless ) ? headless_backend : RendererBackend_OpenGL );
 	maps_init();
+	if ( options.map_name && !map_change( string_view( options.map_name ) ) )
+		log_warning( "There is no '%s' map, staying on the default one.", options.map_name );
 
 	load_textures();
 	load_shaders();
@@ -608,6 +1159,7 @@ int main()
 	Mesh *cube_mesh = mesh_instance( cube_mesh_id );
 	cube_mesh->material_id = material_find( "metal-plate-02" );
 	// cube_mesh->material_id = material_find( "rocks-medium" );
+	light_markers_init( cube_mesh_id );
 
 	Model_ID model_plane_id = model_load_from_file( "plane", "resources/models/plane.obj" );
 	renderer_model_meshes_upload( model_plane_id );
@@ -637,7 +1189,7 @@ int main()
 		/*        fov */ 40.0f,
 		/*     z_near */ 0.1f,
 		/*      z_far */ 2000.0f,
-		/*   viewport */ { 1280, 720 }
+		/*   viewport */ { ( f32 )screen.width, ( f32 )screen.height }
 	);
 
 	renderer_set_camera_position_pointer( &g_camera->position );
@@ -668,6 +1220,7 @@ int main()
 		// Entity_Point_Light
 		entity_point_light1.color = { 244 / 255.0f, 233 / 255.0f, 155 / 255.0f };
 		entity_point_light1.intensity = 1.0f;
+		entity_point_light1.radius = 10.0f;
 		map_entity_add( map, &entity_point_light1 );
 
 		Entity_Point_Light entity_point_light2;
@@ -680,6 +1233,7 @@ int main()
 		// Entity_Point_Light
 		entity_point_light2.color = { 130 / 255.0f, 137 / 255.0f, 255 / 255.0f };
 		entity_point_light2.intensity = 1.0f;
+		entity_point_light2.radius = 10.0f;
 		map_entity_add( map, &entity_point_light2 );
 
 		Entity_Camera entity_camera;
@@ -718,7 +1272,7 @@ int main()
 		// Entity
 		entity_plane1.type = EntityType_StaticObject;
 		entity_plane1.parent = INVALID_ENTITY_ID;
-		entity_plane1.bits = 0;
+		entity_plane1.bits = EntityBit_Occluder;
 		entity_plane1.transform = transform_identity();
 		// Entity_Static_Object
 		entity_plane1.model = model_plane_id;
@@ -729,7 +1283,7 @@ int main()
 		// Entity
 		entity_plane2.type = EntityType_StaticObject;
 		entity_plane2.parent = INVALID_ENTITY_ID;
-		entity_plane2.bits = 0;
+		entity_plane2.bits = EntityBit_Occluder;
 		entity_plane2.transform = transform_identity();
 		// Entity_Static_Object
 		entity_plane2.model = model_plane_id;
@@ -763,6 +1317,42 @@ int main()
 		map_entity_add( map, &entity_cube3 );
 	}
 
+	if ( options.benchmark_objects > 0 )
+		benchmark_objects_add( map, model_cube_id, options.benchmark_objects );
+
+	renderer_set_view_matrix_pointer( &g_camera->view_matrix );
+	renderer_set_projection_matrix_pointer( &g_camera->projection_matrix );
+
+	if ( benchmark ) {
+		run_frame_benchmark( map, options.benchmark_frames );
+		if ( options.tlsf_benchmark )
+			run_tlsf_benchmark();
+		bool written = ( !options.screenshot_file || renderer_screenshot_write_ppm( options.screenshot_file ) );
+		written &= app_shutdown( &options );
+		return ( written ) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if ( options.self_test ) {
+		bool passed = run_self_tests();
+		passed &= app_shutdown( &options );
+		return ( passed ) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if ( options.replay_file ) {
+		// Everything the capture names was created above, the same way it was in the capturing session.
+		Renderer_Capture_Replay_Report report;
+		bool replayed = renderer_capture_replay( options.replay_file, &report );
+		if ( replayed )
+			renderer_capture_replay_report_log( &report );
+		replayed &= app_shutdown( &options );
+		return ( replayed ) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Startup is all the trace has, the main loop's allocations are traced from the "Heap" window.
+	if ( options.tlsf_benchmark )
+		run_tlsf_benchmark();
+
+#ifndef QLIGHT_HEADLESS
 	glViewport(
 		0,
 		0,
@@ -770,9 +1360,6 @@ int main()
 		( GLsizei ) g_camera->viewport.height
 	);
 
-	renderer_set_view_matrix_pointer( &g_camera->view_matrix );
-	renderer_set_projection_matrix_pointer( &g_camera->projection_matrix );
-
 	log_info(
 		"GPU Vendor: " StringViewFormat ", GPU Name: " StringViewFormat,
 		StringViewArgument( renderer_device_vendor() ),
@@ -806,51 +1393,23 @@ int main()
 	const char* glsl_version = "#version 330";
 	ImGui_ImplOpenGL3_Init(glsl_version);
 	ImGui::SetCurrentContext(imgui_context);
+	// Normally created lazily by the first `ImGui_ImplOpenGL3_NewFrame()`,
+	//   but only the render thread may call OpenGL from now on.
+	ImGui_ImplOpenGL3_CreateDeviceObjects();
+	imgui_occlusion_buffer_view_init();
+
+	renderer_thread_start( window );
 
 	while (!glfwWindowShouldClose(window))
 	{
+		u64 frame_start_allocations = system_allocations_count();
 		process_input(window);
 
 		cameras_update();
 
-		// renderer_queue_draw_command(
-		// 	/*     mesh_id */ cube_mesh_id,
-		// 	/* material_id */ cube_mesh->material_id,
-		// 	/*   transform */ &model_cube->transform
-		// );
-
-		// Update Uniform_Buffer_Lights
-		maps_update_lights_manager();
-
-		// Draw entities
-		ForIt( map->entity_table.entities.data, map->entity_table.entities.size ) {
-			if ( it == NULL )
-				continue;
-
-			if ( it->bits & EntityBit_NoDraw )
-				continue;
-
-			if ( it->type == EntityType_StaticObject ) {
-				Entity_Static_Object *static_object = ( Entity_Static_Object * )it;
-				Model *model = model_instance( static_object->model );
-				Mesh *mesh = mesh_instance( model->meshes.data[ 0 ] );
-				transform_recalculate_dirty_matrices( &static_object->transform );
-				Transform_XYZW *transform_xyzw = ( Transform_XYZW * )&static_object->transform;
-				renderer_queue_draw_command(
-					/*     mesh_id */ model->meshes.data[ 0 ],
-					/* material_id */ mesh->material_id,
-					/*   transform */ &static_object->transform
-				);
-			}
-		}}
-
-		renderer_draw_frame();
-
 		//
-		// --- ImGui Render ---
+		// --- ImGui ---
 		//
-		glBindFramebuffer( GL_FRAMEBUFFER, 0 );
-		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
 		ImGui::NewFrame();
 
@@ -933,10 +1492,228 @@ int main()
 					renderer_set_output_channel( output_channel );
 				}
 
+				static const char *g_gl_error_check_modes[] = { "Off", "Debug Callback", "Sampled" };
+				int gl_error_check_mode = ( int )renderer_gl_error_check_mode();
+				if ( ImGui::Combo( "GL Error Checks", &gl_error_check_mode, g_gl_error_check_modes, ARRAY_SIZE( g_gl_error_check_modes ) ) ) {
+					renderer_set_gl_error_check_mode( ( Renderer_GL_Error_Check_Mode )gl_error_check_mode );
+				}
+
+				if ( renderer_gl_error_check_mode() == RendererGLErrorCheckMode_Sampled ) {
+					int gl_error_check_interval = ( int )renderer_gl_error_check_interval();
+					if ( ImGui::InputInt( "Check every N frames", &gl_error_check_interval ) ) {
+						renderer_set_gl_error_check_interval( ( gl_error_check_interval > 0 ) ? ( u32 )gl_error_check_interval : 0 );
+					}
+
+					if ( ImGui::Button( "Check GL errors next frame" ) ) {
+						renderer_request_gl_error_check();
+					}
+				}
+
 				ImGui::Text("GPU Vendor: " StringViewFormat, StringViewArgument( renderer_device_vendor() ));
 				ImGui::Text("GPU Name: " StringViewFormat, StringViewArgument( renderer_device_name() ));
 				ImGui::Text("ImGui: Frametime: %.3f ms/frame (%.1f FPS)", 1000.0f / imgui_io.Framerate, imgui_io.Framerate);
 				ImGui::Text("Renderer: Frametime: %.3f ms/frame (%.1f FPS)", frame_time, 1000.0f / frame_time);
+				ImGui::Text("Renderer: State changes: %u issued, %u elided", renderer_state_changes_issued(), renderer_state_changes_elided());
+				ImGui::Text("Renderer: Draw calls: %u (%u commands)", renderer_draw_calls(), renderer_draw_commands());
+				ImGui::Text("Renderer: Proxies: %u (%u instances uploaded)", renderer_proxies_count(), renderer_proxy_instances_uploaded());
+				ImGui::Text("Renderer: Frame arena: %llu KB high-water mark, %llu allocations last frame", ( unsigned long long )( renderer_frame_arena_high_water_mark() / 1024 ), ( unsigned long long )g_frame_system_allocations);
+				ImGui::Text("Renderer: Frame ring buffer: %u allocations did not fit", renderer_frame_ring_overflows());
+				Renderer_Thread_Stats thread_stats = renderer_thread_stats();
+				ImGui::Text("Render thread: %.3f ms drawing, stalls: game %.3f ms, render %.3f ms",
+					thread_stats.render_milliseconds,
+					thread_stats.game_stall_milliseconds,
+					thread_stats.render_stall_milliseconds
+				);
+
+				Map_Culling_Stats culling_stats = map_culling_stats();
+				ImGui::Text("Culling: %u visible, %u culled (%u total)", culling_stats.visible, culling_stats.culled, culling_stats.total);
+				ImGui::Text("Culling: %u occluded by %u occluders", culling_stats.occluded, culling_stats.occluders);
+				ImGui::Text("Culling: BVH heights: %d static, %d dynamic", culling_stats.static_tree_height, culling_stats.dynamic_tree_height);
+				Lights_Manager *lights_manager = maps_lights_manager();
+				ImGui::Text("Lights: %u directional, %u positional", lights_manager->directional_lights_count, lights_manager->positional_spheres.size);
+				ImGui::Text("Light clusters: %ux%ux%u, %u indices, at most %u lights per cluster",
+					LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z,
+					lights_manager->clusters.light_indices.size, lights_manager->clusters.max_cluster_lights);
+
+				bool occlusion_culling = map_occlusion_culling();
+				if ( ImGui::Checkbox( "Occlusion culling", &occlusion_culling ) )
+					map_set_occlusion_culling( occlusion_culling );
+				bool light_markers = light_markers_enabled();
+				if ( ImGui::Checkbox( "Light markers", &light_markers ) )
+					light_markers_set_enabled( light_markers );
+
+				if ( ImGui::TreeNode( "Occlusion buffer" ) ) {
+					imgui_occlusion_buffer_view();
+					ImGui::TreePop();
+				}
+
+				static Culling_Benchmark g_culling_benchmark = { 0 };
+				if ( ImGui::Button( "Run culling benchmark (100k objects)" ) ) {
+					Matrix4x4_f32 view_projection = g_camera->projection_matrix * g_camera->view_matrix;
+					g_culling_benchmark = culling_benchmark( &view_projection, 100000 );
+					log_info( "Culling benchmark: %u objects, %u visible, scalar: %.3f ms, batched: %.3f ms.",
+						g_culling_benchmark.objects_count,
+						g_culling_benchmark.visible_count,
+						g_culling_benchmark.scalar_milliseconds,
+						g_culling_benchmark.blocks_milliseconds
+					);
+				}
+
+				if ( g_culling_benchmark.objects_count > 0 ) {
+					ImGui::Text("Culling benchmark: scalar %.3f ms, batched %.3f ms (%u/%u visible)",
+						g_culling_benchmark.scalar_milliseconds,
+						g_culling_benchmark.blocks_milliseconds,
+						g_culling_benchmark.visible_count,
+						g_culling_benchmark.objects_count
+					);
+				}
+
+				static Radix_Sort_Benchmark g_sort_benchmark = { 0 };
+				u32 sort_benchmark_items_count = 0;
+				if ( ImGui::Button( "Run sort benchmark (1k keys)" ) )  sort_benchmark_items_count = 1000;
+				ImGui::SameLine();
+				if ( ImGui::Button( "(10k keys)" ) )  sort_benchmark_items_count = 10000;
+				ImGui::SameLine();
+				// The exchange sort takes seconds here.
+				if ( ImGui::Button( "(100k keys)" ) )  sort_benchmark_items_count = 100000;
+				if ( sort_benchmark_items_count > 0 ) {
+					g_sort_benchmark = radix_sort_benchmark( sort_benchmark_items_count );
+					log_info( "Sort benchmark: %u keys, exchange sort %.3f ms, qsort %.3f ms, radix sort %.3f ms, results %s.",
+						g_sort_benchmark.items_count,
+						g_sort_benchmark.exchange_milliseconds,
+						g_sort_benchmark.qsort_milliseconds,
+						g_sort_benchmark.radix_milliseconds,
+						g_sort_benchmark.results_equal ? "equal" : "DIFFER"
+					);
+				}
+
+				if ( g_sort_benchmark.items_count > 0 ) {
+					ImGui::Text("Sort benchmark (%u): exchange %.3f ms, qsort %.3f ms, radix %.3f ms, results %s",
+						g_sort_benchmark.items_count,
+						g_sort_benchmark.exchange_milliseconds,
+						g_sort_benchmark.qsort_milliseconds,
+						g_sort_benchmark.radix_milliseconds,
+						g_sort_benchmark.results_equal ? "equal" : "DIFFER"
+					);
+				}
+
+				static BVH_Benchmark g_bvh_benchmark = { 0 };
+				u32 bvh_benchmark_entries_count = 0;
+				if ( ImGui::Button( "Run BVH benchmark (10k entries)" ) )  bvh_benchmark_entries_count = 10000;
+				ImGui::SameLine();
+				if ( ImGui::Button( "(1M entries)" ) )  bvh_benchmark_entries_count = 1000000;
+				if ( bvh_benchmark_entries_count > 0 ) {
+					Matrix4x4_f32 view_projection = g_camera->projection_matrix * g_camera->view_matrix;
+					g_bvh_benchmark = bvh_benchmark( &view_projection, bvh_benchmark_entries_count );
+					log_info( "BVH benchmark: %u entries, static: build %.3f ms, query %.3f ms, height %d; dynamic: build %.3f ms, refit %.3f ms (%u reinserted), query %.3f ms, height %d.",
+						g_bvh_benchmark.entries_count,
+						g_bvh_benchmark.static_build_milliseconds,
+						g_bvh_benchmark.static_query_milliseconds,
+						g_bvh_benchmark.static_height,
+						g_bvh_benchmark.dynamic_build_milliseconds,
+						g_bvh_benchmark.dynamic_refit_milliseconds,
+						g_bvh_benchmark.dynamic_reinserted_count,
+						g_bvh_benchmark.dynamic_query_milliseconds,
+						g_bvh_benchmark.dynamic_height
+					);
+				}
+
+				if ( g_bvh_benchmark.entries_count > 0 ) {
+					ImGui::Text("BVH benchmark (%u): static build %.3f ms, query %.3f ms",
+						g_bvh_benchmark.entries_count,
+						g_bvh_benchmark.static_build_milliseconds,
+						g_bvh_benchmark.static_query_milliseconds
+					);
+					ImGui::Text("BVH benchmark (%u): dynamic build %.3f ms, refit %.3f ms, query %.3f ms",
+						g_bvh_benchmark.entries_count,
+						g_bvh_benchmark.dynamic_build_milliseconds,
+						g_bvh_benchmark.dynamic_refit_milliseconds,
+						g_bvh_benchmark.dynamic_query_milliseconds
+					);
+				}
+
+				static Renderer_Commands_Test g_commands_test = { 0 };
+				if ( ImGui::Button( "Run command recording test (100k packets)" ) ) {
+					g_commands_test = renderer_commands_test( 100000 );
+					log_info( "Command recording test: %u packets, %u commands, single-threaded %.3f ms, %u buffers %.3f ms, merge %.3f ms, streams %s.",
+						g_commands_test.packets_count,
+						g_commands_test.commands_count,
+						g_commands_test.single_record_milliseconds,
+						g_commands_test.buffers_count,
+						g_commands_test.parallel_record_milliseconds,
+						g_commands_test.merge_milliseconds,
+						g_commands_test.streams_equal ? "equal" : "DIFFER"
+					);
+				}
+
+				if ( g_commands_test.packets_count > 0 ) {
+					ImGui::Text("Command recording (%u): single %.3f ms, %u buffers %.3f ms, merge %.3f ms, streams %s",
+						g_commands_test.packets_count,
+						g_commands_test.single_record_milliseconds,
+						g_commands_test.buffers_count,
+						g_commands_test.parallel_record_milliseconds,
+						g_commands_test.merge_milliseconds,
+						g_commands_test.streams_equal ? "equal" : "DIFFER"
+					);
+				}
+
+				static Pool_Allocator_Benchmark g_pool_benchmark = { 0 };
+				if ( ImGui::Button( "Run pool allocator benchmark (10k objects, 1M operations)" ) ) {
+					g_pool_benchmark = pool_allocator_benchmark( 10000, 1000000, sizeof( Entity_Dynamic_Object ) );
+					log_info( "Pool allocator benchmark: %u objects of %u bytes, %u operations, single-threaded: system %.3f ms, pool %.3f ms (%u chunks); %u threads: system %.3f ms, pool %.3f ms.",
+						g_pool_benchmark.objects_count,
+						g_pool_benchmark.slot_size,
+						g_pool_benchmark.operations_count,
+						g_pool_benchmark.system_milliseconds,
+						g_pool_benchmark.pool_milliseconds,
+						g_pool_benchmark.pool_chunks_count,
+						g_pool_benchmark.threads_count,
+						g_pool_benchmark.system_threads_milliseconds,
+						g_pool_benchmark.pool_threads_milliseconds
+					);
+				}
+
+				static Virtual_Arena_Benchmark g_virtual_arena_benchmark = { 0 };
+				if ( ImGui::Button( "Run virtual arena benchmark (16M items)" ) ) {
+					g_virtual_arena_benchmark = virtual_arena_benchmark( 16 * 1024 * 1024 );
+					log_info( "Virtual arena benchmark: %u items, system %.3f ms (%u moves, %llu page faults), arena %.3f ms (%u copies, %llu page faults), huge pages %.3f ms (%u copies, %llu page faults).",
+						g_virtual_arena_benchmark.items_count,
+						g_virtual_arena_benchmark.system_milliseconds,
+						g_virtual_arena_benchmark.system_moves,
+						( unsigned long long )g_virtual_arena_benchmark.system_page_faults,
+						g_virtual_arena_benchmark.arena_milliseconds,
+						g_virtual_arena_benchmark.arena_copies,
+						( unsigned long long )g_virtual_arena_benchmark.arena_page_faults,
+						g_virtual_arena_benchmark.huge_arena_milliseconds,
+						g_virtual_arena_benchmark.huge_arena_copies,
+						( unsigned long long )g_virtual_arena_benchmark.huge_arena_page_faults
+					);
+				}
+
+				if ( g_virtual_arena_benchmark.items_count > 0 ) {
+					ImGui::Text("Virtual arena (%u): system %.3f ms, %u moves, %llu faults; arena %.3f ms, %u copies, %llu faults; huge %.3f ms, %llu faults",
+						g_virtual_arena_benchmark.items_count,
+						g_virtual_arena_benchmark.system_milliseconds,
+						g_virtual_arena_benchmark.system_moves,
+						( unsigned long long )g_virtual_arena_benchmark.system_page_faults,
+						g_virtual_arena_benchmark.arena_milliseconds,
+						g_virtual_arena_benchmark.arena_copies,
+						( unsigned long long )g_virtual_arena_benchmark.arena_page_faults,
+						g_virtual_arena_benchmark.huge_arena_milliseconds,
+						( unsigned long long )g_virtual_arena_benchmark.huge_arena_page_faults
+					);
+				}
+
+				if ( g_pool_benchmark.objects_count > 0 ) {
+					ImGui::Text("Pool allocator (%u): system %.3f ms, pool %.3f ms; %u threads: system %.3f ms, pool %.3f ms",
+						g_pool_benchmark.objects_count,
+						g_pool_benchmark.system_milliseconds,
+						g_pool_benchmark.pool_milliseconds,
+						g_pool_benchmark.threads_count,
+						g_pool_benchmark.system_threads_milliseconds,
+						g_pool_benchmark.pool_threads_milliseconds
+					);
+				}
 			}
 
 			if ( g_frame_idx == 2 ) {
@@ -962,7 +1739,6 @@ int main()
 
 					Entity_ID entity_id = map->entity_table.ids.data[ it_index ];
 					StringView_ASCII type_name = entity_type_name( it->type );
-					bool is_light_entity = entity_type_is_light_source( it->type );
 					if ( ImGui::TreeNode( (void*)(intptr_t)it_index, "%hu: " StringViewFormat, entity_id, StringViewArgument( type_name ) ) ) {
 						bool modified = false;
 						bool is_light_entity = entity_type_is_light_source( it->type );
@@ -1087,21 +1863,116 @@ int main()
 			ImGui::End();
 		}
 
+		if ( imgui_draw_heap_window ) {
+			static int g_heap_sort = HeapProfilerSort_LiveBytes;
+			static f64 g_heap_snapshot_time = -1.0;
+			ImGui::SetNextWindowCollapsed( true, ImGuiCond_FirstUseEver );
+			if ( ImGui::Begin( "Heap", NULL, ImGuiWindowFlags_AlwaysAutoResize ) ) {
+				static const char *g_heap_sorts[] = { "Live bytes", "Peak bytes", "Churn" };
+				static_assert( ARRAY_SIZE( g_heap_sorts ) == HeapProfilerSort_COUNT, "Heap sort names are out of date" );
+				bool resort = ImGui::Combo( "Sort by", &g_heap_sort, g_heap_sorts, ARRAY_SIZE( g_heap_sorts ) );
+				// Churn is counted over the time between snapshots, so they are taken once a second.
+				f64 time = glfwGetTime();
+				if ( resort || g_heap_snapshot_time < 0.0 || time - g_heap_snapshot_time >= 1.0 ) {
+					heap_profiler_snapshot( &g_heap_snapshot, ( Heap_Profiler_Sort )g_heap_sort );
+					g_heap_snapshot_time = time;
+				}
+
+				Heap_Profiler_Totals *totals = &g_heap_snapshot.totals;
+				ImGui::Text( "Live: %.3f MB in %lld blocks, peak %.3f MB, %llu allocations, %u callsites%s",
+					( f64 )totals->live_bytes / ( 1024.0 * 1024.0 ),
+					( long long )totals->live_count,
+					( f64 )totals->peak_bytes / ( 1024.0 * 1024.0 ),
+					( unsigned long long )totals->allocations_count,
+					totals->callsites_count,
+					( totals->callsites_overflowed ) ? " (table full)" : ""
+				);
+				if ( ImGui::Button( "Dump to heap_profile.txt" ) )
+					heap_profiler_dump( "heap_profile.txt" );
+
+				static TLSF_Benchmark g_tlsf_benchmark = { 0 };
+				ImGui::SameLine();
+				if ( !heap_profiler_trace_recording() ) {
+					if ( ImGui::Button( "Record allocation trace" ) )
+						heap_profiler_trace_begin( ALLOCATION_TRACE_EVENTS );
+				} else if ( ImGui::Button( "Stop and replay on TLSF" ) ) {
+					g_tlsf_benchmark = run_tlsf_benchmark();
+				}
+				if ( g_tlsf_benchmark.events_count > 0 ) {
+					ImGui::Text( "TLSF replay (%u events): system p50 %llu ns, p99 %llu ns, max %llu ns; TLSF p50 %llu ns, p99 %llu ns, max %llu ns",
+						g_tlsf_benchmark.events_count,
+						( unsigned long long )g_tlsf_benchmark.system.percentile_50_ns,
+						( unsigned long long )g_tlsf_benchmark.system.percentile_99_ns,
+						( unsigned long long )g_tlsf_benchmark.system.max_ns,
+						( unsigned long long )g_tlsf_benchmark.tlsf.percentile_50_ns,
+						( unsigned long long )g_tlsf_benchmark.tlsf.percentile_99_ns,
+						( unsigned long long )g_tlsf_benchmark.tlsf.max_ns
+					);
+					ImGui::Text( "TLSF replay: bytes per byte asked for: system %.3f, TLSF %.3f; TLSF fragmentation %.1f%%",
+						g_tlsf_benchmark.system_block_overhead,
+						g_tlsf_benchmark.tlsf_block_overhead,
+						g_tlsf_benchmark.tlsf_external_fragmentation * 100.0
+					);
+				}
+
+				constexpr u32 HEAP_WINDOW_CALLSITES = 32;
+				if ( ImGui::BeginTable( "Callsites", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) ) {
+					ImGui::TableSetupColumn( "Live KB" );
+					ImGui::TableSetupColumn( "Peak KB" );
+					ImGui::TableSetupColumn( "Blocks" );
+					ImGui::TableSetupColumn( "Allocs/s" );
+					ImGui::TableSetupColumn( "Callsite" );
+					ImGui::TableHeadersRow();
+					ForIt( g_heap_snapshot.callsites.data, QL_min2( g_heap_snapshot.callsites.size, HEAP_WINDOW_CALLSITES ) ) {
+						ImGui::TableNextRow();
+						ImGui::TableNextColumn();
+						ImGui::Text( "%.1f", ( f64 )it.live_bytes / 1024.0 );
+						ImGui::TableNextColumn();
+						ImGui::Text( "%.1f", ( f64 )it.peak_bytes / 1024.0 );
+						ImGui::TableNextColumn();
+						ImGui::Text( "%lld", ( long long )it.live_count );
+						ImGui::TableNextColumn();
+						ImGui::Text( "%.0f", it.allocations_per_second );
+						ImGui::TableNextColumn();
+						ImGui::Text( "%s:%ld %s", it.caller.file, it.caller.line, it.caller.type );
+						if ( ImGui::IsItemHovered() )
+							ImGui::SetTooltip( "%s", it.caller.function );
+					}}
+					ImGui::EndTable();
+				}
+			}
+
+			ImGui::End();
+		}
+
 		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-		glfwSwapBuffers(window);
+		// Bin lights into the camera's clusters and upload them.
+		maps_update_lights_manager( g_camera );
+
+		// Draw entities
+		map_draw( map, g_camera );
+		light_markers_draw( maps_lights_manager(), g_camera );
+
+		// Hands the frame over to the render thread, which also swaps the buffers.
+		renderer_set_ui_draw_data( ImGui::GetDrawData() );
+		if ( options.capture_file && ( u32 )g_frame_idx == options.capture_first_frame )
+			renderer_capture_frames( options.capture_file, options.capture_frames );
+		renderer_draw_frame();
+		frame_system_allocations_check( frame_start_allocations );
+
 		glfwPollEvents();
-		glFlush();
 
 		g_frame_idx += 1;
 	}
 
+	renderer_thread_stop();
+
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
+#endif
 
-	glfwTerminate();
-
-	exit(EXIT_SUCCESS);
+	bool shut_down = app_shutdown( &options );
+	return ( shut_down ) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file
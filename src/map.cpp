@@ -1,71 +1,60 @@
 #include "map.h"
 #include "renderer.h"
 
+#include <new>
+
+// How much dynamic tree leaves are grown, so small moves do not touch the tree.
+constexpr f32 MAP_DYNAMIC_TREE_MARGIN = 0.1f;
+
+// Per-frame culling scratch, reused between frames.
+struct Map_Culling {
+	Array< u32 > visible_slots;
+	// Static tree build input.
+	Array< AABB > static_aabbs;
+	Array< u32 > static_slots;
+	// Depth of the visible occluders, tested against by everything else.
+	Occlusion_Buffer occlusion;
+	bool occlusion_enabled;
+	Map_Culling_Stats stats;
+};
+
 struct G_Maps {
 	Array< Map > maps;
 	Map *current;
 	Map *changing_to;
 	Lights_Manager lights_manager;
 	bool lights_manager_needs_update;
+	bool render_proxies_need_update;  // Their keys, after a mesh's material or a material's shader program changed.
+	Map_Culling culling;
 } g_maps;
 
 static void
 lights_manager_init() {
-	Renderer_GL_Buffer_Storage_Bits storage_bits = renderer_gl_buffer_storage_bits(
-		RendererGLBufferStorageBit_Write |
-		RendererGLBufferStorageBit_Persistent |
-		RendererGLBufferStorageBit_Coherent
-	);
-
-	Renderer_Uniform_Buffer *uniform_buffer_lights = renderer_uniform_buffer_create(
-		/*         name */ "Lights",
-		/*         size */ sizeof( Uniform_Buffer_Lights ),
-		/* storage_bits */ storage_bits,
-		/*      binding */ 0
-	);
-
-	Renderer_GL_Map_Access_Bits access_bits = renderer_gl_buffer_storage_bits_to_map_access_bits( storage_bits );
-	u32 size = sizeof( Uniform_Buffer_Lights );
-	u32 offset = 0;
-
-	void *uniform_data = renderer_uniform_buffer_memory_map(
-		/* uniform_buffer */ uniform_buffer_lights,
-		/*    access_bits */ access_bits,
-		/*           size */ size,
-		/*         offset */ offset
-	);
-
-	Renderer_GL_Buffer_Mapping mapping = {
-		.view = array_view< u8 >( ( u8 * )uniform_data, size, 0, size ),
-		.offset = offset,
-		.access_bits = access_bits,
-		.opengl_buffer_id = uniform_buffer_lights->opengl_ubo
-	};
-
-	g_maps.lights_manager = {
-		.uniform_buffer = uniform_buffer_lights,
-		.mapping = mapping,
-		.current_slot = 0,
-		.prev_lights_count = 0,
-		.lights_count = 0,
-		.empty_slots = array_new< u16 >( sys_allocator, 16 ),
-		.light_entities = array_new< Entity_ID >( sys_allocator, MAX_LIGHT_SOURCES )
-	};
+	Lights_Manager *lights = &g_maps.lights_manager;
+	lights->lights = array_new< Shader_Storage_Light >( sys_allocator, 16 );
+	lights->positional_spheres = array_new< Light_Sphere >( sys_allocator, 16 );
+	lights->directional_lights_count = 0;
+	light_clusters_init( &lights->clusters, sys_allocator );
 }
 
 static void
 lights_manager_destroy() {
 	Lights_Manager *lights = &g_maps.lights_manager;
-	bool destroyed = renderer_uniform_buffer_destroy( lights->uniform_buffer );
-	Assert( destroyed );
-
-	array_free( &lights->empty_slots );
-	array_free( &lights->light_entities );
+	array_free( &lights->lights );
+	array_free( &lights->positional_spheres );
+	light_clusters_destroy( &lights->clusters );
+	lights->directional_lights_count = 0;
+}
 
-	lights->uniform_buffer = NULL;
-	lights->current_slot = 0;
-	lights->prev_lights_count = 0;
-	lights->lights_count = 0;
+static void
+lights_manager_add_positional( Lights_Manager *lights, Entity *entity, Vector3_f32 color, f32 intensity, f32 radius ) {
+	Vector3_f32 *t_pos = &entity->transform.position;
+	Shader_Storage_Light light = {
+		.position = { t_pos->x, t_pos->y, t_pos->z, radius },
+		.color = { color.r, color.g, color.b, intensity }
+	};
+	array_add( &lights->lights, light );
+	array_add( &lights->positional_spheres, Light_Sphere { .position = *t_pos, .radius = radius } );
 }
 
 static void
@@ -73,120 +62,131 @@ lights_manager_update() {
 	Lights_Manager *lights = &g_maps.lights_manager;
 	Map *map = g_maps.current;
 
-	lights->current_slot = 0;
-	lights->prev_lights_count = lights->lights_count;
-	lights->lights_count = 0;
-
-	CArrayView c_directional_lights = map_stored_entities_of_type( map, EntityType_DirectionalLight );
-	CArrayView c_point_lights = map_stored_entities_of_type( map, EntityType_PointLight );
-	CArrayView c_spot_lights = map_stored_entities_of_type( map, EntityType_SpotLight );
-
-	ArrayView< Entity_Directional_Light > directional_lights = array_view< Entity_Directional_Light >(
-		/* data */ ( Entity_Directional_Light * )c_directional_lights.data,
-		/* size */ c_directional_lights.size
-	);
-	ArrayView< Entity_Point_Light > point_lights = array_view< Entity_Point_Light >(
-		/* data */ ( Entity_Point_Light * )c_point_lights.data,
-		/* size */ c_point_lights.size
-	);
-	ArrayView< Entity_Spot_Light > spot_lights = array_view< Entity_Spot_Light >(
-		/* data */ ( Entity_Spot_Light * )c_spot_lights.data,
-		/* size */ c_spot_lights.size
-	);
-
-	/*
-		if ( it.type == EntityType_DirectionalLight ) {
-			// what about Entity_Spot_Light?
-			position.w = 0.0f; // positional -> directional
-		}
-	*/
+	array_clear( &lights->lights );
+	array_clear( &lights->positional_spheres );
+	lights->directional_lights_count = 0;
 
-	Uniform_Buffer_Lights *uniform_data = ( Uniform_Buffer_Lights * )lights->mapping.view.data;
-	Uniform_Buffer_Struct_Light *data_lights = ( Uniform_Buffer_Struct_Light * )lights->mapping.view.data;
-	ForIt( directional_lights.data, directional_lights.size ) {
-		if ( it.bits & EntityBit_NoDraw )
+	// Entities are in pool slots, so lights are found through the lookup table.
+	// Directional lights come first in the buffer, see `Shader_Storage_Lights_Header`.
+	ArrayView< Entity * > entities = array_view( &map->entity_table.entities );
+	ForIt( entities.data, entities.size ) {
+		if ( !it || it->type != EntityType_DirectionalLight || ( it->bits & EntityBit_NoDraw ) )
 			continue;
 
-		Vector4_f32 color = { it.color.r, it.color.g, it.color.b, it.intensity };
-		Vector3_f32 *t_pos = &it.transform.position;
-		Vector4_f32 position = { t_pos->x, t_pos->y, t_pos->z, 0.0f }; // directional -> .w = 0
-
-		Uniform_Buffer_Struct_Light uniform_light = {
-			.position = position,
-			.color = color
-			// ._padding0 = { 0 }
+		Entity_Directional_Light *directional_light = ( Entity_Directional_Light * )it;
+		Vector3_f32 *t_pos = &it->transform.position;
+		Shader_Storage_Light light = {
+			.position = { t_pos->x, t_pos->y, t_pos->z, 0.0f }, // Direction, no attenuation.
+			.color = { directional_light->color.r, directional_light->color.g, directional_light->color.b, directional_light->intensity }
 		};
-		data_lights[ lights->current_slot ] = uniform_light;
-		lights->current_slot += 1;
-		lights->lights_count += 1;
+		array_add( &lights->lights, light );
+		lights->directional_lights_count += 1;
 	}}
 
-	ForIt( point_lights.data, point_lights.size ) {
-		if ( it.bits & EntityBit_NoDraw )
+	ForIt( entities.data, entities.size ) {
+		if ( !it || ( it->bits & EntityBit_NoDraw ) )
 			continue;
 
-		Vector4_f32 color = { it.color.r, it.color.g, it.color.b, it.intensity };
-		Vector3_f32 *t_pos = &it.transform.position;
-		Vector4_f32 position = { t_pos->x, t_pos->y, t_pos->z, 1.0f }; // positional -> .w = 1
-
-		Uniform_Buffer_Struct_Light uniform_light = {
-			.position = position,
-			.color = color
-			// ._padding0 = { 0 }
-		};
-		data_lights[ lights->current_slot ] = uniform_light;
-		lights->current_slot += 1;
-		lights->lights_count += 1;
+		if ( it->type == EntityType_PointLight ) {
+			Entity_Point_Light *point_light = ( Entity_Point_Light * )it;
+			lights_manager_add_positional( lights, it, point_light->color, point_light->intensity, point_light->radius );
+		} else if ( it->type == EntityType_SpotLight ) {
+			// Entities have no direction or cone for spot lights, so they light like point lights.
+			Entity_Spot_Light *spot_light = ( Entity_Spot_Light * )it;
+			lights_manager_add_positional( lights, it, spot_light->color, spot_light->intensity, spot_light->radius );
+		}
 	}}
 
-	ForIt( spot_lights.data, spot_lights.size ) {
-		if ( it.bits & EntityBit_NoDraw )
-			continue;
+	g_maps.lights_manager_needs_update = false;
+}
 
-		Vector4_f32 color = { it.color.r, it.color.g, it.color.b, it.intensity };
-		Vector3_f32 *t_pos = &it.transform.position;
-		Vector4_f32 position = { t_pos->x, t_pos->y, t_pos->z, 1.0f }; // positional -> .w = 1
+static void
+lights_manager_upload() {
+	// The render thread may still draw the previous frame, so every frame gets its own copy.
+	Lights_Manager *lights = &g_maps.lights_manager;
+	Light_Clusters *clusters = &lights->clusters;
 
-		Uniform_Buffer_Struct_Light uniform_light = {
-			.position = position,
-			.color = color
-			// ._padding0 = { 0 }
-		};
-		data_lights[ lights->current_slot ] = uniform_light;
-		lights->current_slot += 1;
-		lights->lights_count += 1;
-	}}
+	u32 lights_size = sizeof( Shader_Storage_Lights_Header ) + lights->lights.size * sizeof( Shader_Storage_Light );
+	u32 clusters_size = sizeof( Shader_Storage_Light_Clusters_Header ) + clusters->clusters.size * sizeof( Light_Cluster );
+	// An empty binding is not allowed, so there is always at least one index.
+	u32 indices_size = QL_max2( clusters->light_indices.size, 1u ) * sizeof( u32 );
 
-	u32 lights_count_offset = offsetof( Uniform_Buffer_Lights, lights_count );
-	u32 *uniform_lights_count = ( u32 * )( ( u8 * )uniform_data + lights_count_offset );
-	// lights->prev_lights_count = *uniform_lights_count;
-	*uniform_lights_count = lights->lights_count;
+	u8 *lights_data = ( u8 * )renderer_frame_storage_buffer( LIGHTS_STORAGE_BUFFER_BINDING, lights_size );
+	u8 *clusters_data = ( u8 * )renderer_frame_storage_buffer( LIGHT_CLUSTERS_STORAGE_BUFFER_BINDING, clusters_size );
+	u8 *indices_data = ( u8 * )renderer_frame_storage_buffer( LIGHT_INDICES_STORAGE_BUFFER_BINDING, indices_size );
+	if ( !lights_data || !clusters_data || !indices_data )
+		return;
 
-	g_maps.lights_manager_needs_update = false;
+	Shader_Storage_Lights_Header lights_header = {
+		.directional_lights_count = lights->directional_lights_count,
+		.positional_lights_count = lights->lights.size - lights->directional_lights_count,
+		._padding0 = { 0 }
+	};
+	memcpy( lights_data, &lights_header, sizeof( lights_header ) );
+	memcpy( lights_data + sizeof( lights_header ), lights->lights.data, lights->lights.size * sizeof( Shader_Storage_Light ) );
+
+	Shader_Storage_Light_Clusters_Header clusters_header = {
+		.view = clusters->view,
+		.dimensions = { LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z, 0 },
+		.depth_scale = clusters->depth_scale,
+		.depth_bias = clusters->depth_bias,
+		._padding0 = { 0 }
+	};
+	memcpy( clusters_data, &clusters_header, sizeof( clusters_header ) );
+	memcpy( clusters_data + sizeof( clusters_header ), clusters->clusters.data, clusters->clusters.size * sizeof( Light_Cluster ) );
+
+	memcpy( indices_data, clusters->light_indices.data, clusters->light_indices.size * sizeof( u32 ) );
+}
+
+static u64
+entity_type_size( Entity_Type type ) {
+	switch ( type ) {
+		case EntityType_Player: return sizeof( Entity_Player );
+		case EntityType_Camera: return sizeof( Entity_Camera );
+		case EntityType_StaticObject: return sizeof( Entity_Static_Object );
+		case EntityType_DynamicObject: return sizeof( Entity_Dynamic_Object );
+		case EntityType_DirectionalLight: return sizeof( Entity_Directional_Light );
+		case EntityType_PointLight: return sizeof( Entity_Point_Light );
+		case EntityType_SpotLight: return sizeof( Entity_Spot_Light );
+		default: return 0;
+	}
 }
 
 static void
 entity_storages_free( Map *map ) {
-	carray_free( &map->entity_storages[ EntityType_Player ] );
-	carray_free( &map->entity_storages[ EntityType_Camera ] );
-	carray_free( &map->entity_storages[ EntityType_StaticObject ] );
-	carray_free( &map->entity_storages[ EntityType_DynamicObject ] );
-
-	carray_free( &map->entity_storages[ EntityType_DirectionalLight ] );
-	carray_free( &map->entity_storages[ EntityType_PointLight ] );
-	carray_free( &map->entity_storages[ EntityType_SpotLight ] );
+	ForIt( map->entity_pools, EntityType_COUNT ) {
+		it.deinit();
+	}}
 }
 
 static void
 entity_storages_init( Map *map ) {
-	map->entity_storages[ EntityType_Player ] = carray_new( sys_allocator, sizeof( Entity_Player ), 2 );
-	map->entity_storages[ EntityType_Camera ] = carray_new( sys_allocator, sizeof( Entity_Camera ), 2 );
-	map->entity_storages[ EntityType_StaticObject ] = carray_new( sys_allocator, sizeof( Entity_Static_Object ), 16 );
-	map->entity_storages[ EntityType_DynamicObject ] = carray_new( sys_allocator, sizeof( Entity_Dynamic_Object ), 8 );
+	// `Map`s are copied into `g_maps.maps` by assignment, which leaves the pools without their vtable.
+	ForIt( map->entity_pools, EntityType_COUNT ) {
+		new ( &it ) Pool_Allocator();
+	}}
+
+	map->entity_pools[ EntityType_Player ].init( sys_allocator, entity_type_size( EntityType_Player ), 2 );
+	map->entity_pools[ EntityType_Camera ].init( sys_allocator, entity_type_size( EntityType_Camera ), 2 );
+	map->entity_pools[ EntityType_StaticObject ].init( sys_allocator, entity_type_size( EntityType_StaticObject ), 64 );
+	map->entity_pools[ EntityType_DynamicObject ].init( sys_allocator, entity_type_size( EntityType_DynamicObject ), 32 );
+
+	map->entity_pools[ EntityType_DirectionalLight ].init( sys_allocator, entity_type_size( EntityType_DirectionalLight ), 2 );
+	map->entity_pools[ EntityType_PointLight ].init( sys_allocator, entity_type_size( EntityType_PointLight ), 16 );
+	map->entity_pools[ EntityType_SpotLight ].init( sys_allocator, entity_type_size( EntityType_SpotLight ), 8 );
+}
 
-	map->entity_storages[ EntityType_DirectionalLight ] = carray_new( sys_allocator, sizeof( Entity_Directional_Light ), 2 );
-	map->entity_storages[ EntityType_PointLight ] = carray_new( sys_allocator, sizeof( Entity_Point_Light ), 8 );
-	map->entity_storages[ EntityType_SpotLight ] = carray_new( sys_allocator, sizeof( Entity_Point_Light ), 4 );
+static void
+spatial_trees_init( Map *map ) {
+	bvh_init( &map->static_tree, sys_allocator, 32, /* margin */ 0.0f );
+	bvh_init( &map->dynamic_tree, sys_allocator, 16, MAP_DYNAMIC_TREE_MARGIN );
+	map->static_tree_needs_rebuild = false;
+}
+
+static void
+spatial_trees_destroy( Map *map ) {
+	bvh_destroy( &map->static_tree );
+	bvh_destroy( &map->dynamic_tree );
 }
 
 bool maps_init() {
@@ -196,33 +196,45 @@ bool maps_init() {
 	g_maps.maps = array_new< Map >( sys_allocator, 2 );
 	g_maps.current = NULL;
 	g_maps.changing_to = NULL;
+	g_maps.render_proxies_need_update = false;
 	lights_manager_init();
+	g_maps.culling = {
+		.visible_slots = array_new< u32 >( sys_allocator, 64 ),
+		.static_aabbs = array_new< AABB >( sys_allocator, 64 ),
+		.static_slots = array_new< u32 >( sys_allocator, 64 ),
+		// .occlusion
+		.occlusion_enabled = true,
+		.stats = { 0 }
+	};
+	occlusion_buffer_init( &g_maps.culling.occlusion, sys_allocator, OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT );
 
 	Map map_empty = {
 		.name = "empty",
 		.title = "",
 		.description = "",
 		.file_path = "",
-		// .entity_storages
+		// .entity_pools
 		.state = MapState_Loaded
 	};
 	u32 map_empty_idx = array_add( &g_maps.maps, map_empty );
 	Map *map = &g_maps.maps.data[ map_empty_idx ];
 	entity_storages_init( map );
 	entity_table_init( &map->entity_table, sys_allocator, 32 );
+	spatial_trees_init( map );
 
 	Map map_test = {
 		.name = "test",
 		.title = "Test Map",
 		.description = "",
 		.file_path = "test.map",
-		// .entity_storages
+		// .entity_pools
 		.state = MapState_NotLoaded
 	};
 	u32 map_test_idx = array_add( &g_maps.maps, map_test );
 	map = &g_maps.maps.data[ map_test_idx ];
 	entity_storages_init( map );
 	entity_table_init( &map->entity_table, sys_allocator, 32 );
+	spatial_trees_init( map );
 
 	// This is so we do not dereference NULL pointer on first change.
 	g_maps.current = &g_maps.maps.data[ map_empty_idx ];
@@ -237,13 +249,29 @@ void maps_shutdown() {
 	ForIt( g_maps.maps.data, g_maps.maps.size ) {
 		entity_storages_free( &it );
 		entity_table_destroy( &it.entity_table );
+		spatial_trees_destroy( &it );
 	}}
 	array_free( &g_maps.maps );
+
+	array_free( &g_maps.culling.visible_slots );
+	array_free( &g_maps.culling.static_aabbs );
+	array_free( &g_maps.culling.static_slots );
+	occlusion_buffer_destroy( &g_maps.culling.occlusion );
+	lights_manager_destroy();
 }
 
-void maps_update_lights_manager() {
+void maps_update_lights_manager( Camera *camera ) {
+	Lights_Manager *lights = &g_maps.lights_manager;
 	if ( g_maps.lights_manager_needs_update )
 		lights_manager_update();
+
+	// Lights and the camera both move, so clusters are binned every frame.
+	light_clusters_build( &lights->clusters, &camera->view_matrix, &camera->projection_matrix, array_view( &lights->positional_spheres ) );
+	lights_manager_upload();
+}
+
+Lights_Manager * maps_lights_manager() {
+	return &g_maps.lights_manager;
 }
 
 Map *map_load_from_file( StringView_ASCII name, StringView_ASCII file_path ) {
@@ -359,19 +387,190 @@ void map_end( Map *map ) {
 	map->state = MapState_Ended;
 }
 
-void map_draw( Map *map ) {
-	/*
-	for ( u32 model_idx = 0; model_idx < map->models.size; model_idx += 1 ) {
-		Model_ID model_id = map->models.data[ model_idx ];
-		Model *model = model_instance( model_id );
-		for ( u32 mesh_idx = 0; mesh_idx < model->meshes.size; mesh_idx += 1 ) {
-			Mesh_ID mesh_id = model->meshes.data[ mesh_idx ];
-			bool no_draw = mesh_is_no_draw( mesh_id );
-			if ( !no_draw );
-				renderer_queue_draw_mesh( mesh_id );
+static AABB
+model_world_bounds( Model_ID model_id, Transform *transform ) {
+	Model *model = model_instance( model_id );
+	if ( !model ) {
+		// Nothing to draw, but keep a valid box for the trees.
+		AABB point = { .min = transform->position, .max = transform->position };
+		return point;
+	}
+
+	Mesh *mesh = mesh_instance( model->meshes.data[ 0 ] );
+	return aabb_transform( mesh->bounds, &transform->model_matrix );
+}
+
+// Points the render proxy at the model's mesh and its material.
+static void
+render_proxy_update_mesh( Renderer_Proxy_ID proxy_id, Model_ID model_id ) {
+	Model *model = model_instance( model_id );
+	Mesh_ID mesh_id = INVALID_MESH_ID;
+	Material_ID material_id = INVALID_MATERIAL_ID;
+	if ( model ) {
+		mesh_id = model->meshes.data[ 0 ];
+		material_id = mesh_instance( mesh_id )->material_id;
+	}
+
+	renderer_proxy_set_mesh( proxy_id, mesh_id, material_id );
+}
+
+// Also copies the transform, which must be up to date.
+static void
+render_proxy_update( Renderer_Proxy_ID proxy_id, Model_ID model_id, Transform *transform ) {
+	render_proxy_update_mesh( proxy_id, model_id );
+	renderer_proxy_set_transform( proxy_id, transform );
+}
+
+static AABB
+entity_world_bounds( Entity *entity ) {
+	if ( entity->type == EntityType_StaticObject )
+		return ( ( Entity_Static_Object * )entity )->world_bounds;
+
+	Assert( entity->type == EntityType_DynamicObject );
+	return ( ( Entity_Dynamic_Object * )entity )->world_bounds;
+}
+
+static Renderer_Proxy_ID
+entity_render_proxy( Entity *entity ) {
+	if ( entity->type == EntityType_StaticObject )
+		return ( ( Entity_Static_Object * )entity )->render_proxy;
+
+	Assert( entity->type == EntityType_DynamicObject );
+	return ( ( Entity_Dynamic_Object * )entity )->render_proxy;
+}
+
+static void
+static_tree_rebuild( Map *map ) {
+	Map_Culling *culling = &g_maps.culling;
+	array_clear( &culling->static_aabbs );
+	array_clear( &culling->static_slots );
+	ForIt( map->entity_table.entities.data, map->entity_table.entities.size ) {
+		if ( it == NULL || it->type != EntityType_StaticObject )
+			continue;
+
+		Entity_Static_Object *static_object = ( Entity_Static_Object * )it;
+		array_add( &culling->static_aabbs, static_object->world_bounds );
+		array_add( &culling->static_slots, ( u32 )it_index );
+	}}
+
+	bvh_build_sah( &map->static_tree, array_view( &culling->static_aabbs ), array_view( &culling->static_slots ) );
+	map->static_tree_needs_rebuild = false;
+}
+
+void map_draw( Map *map, Camera *camera ) {
+	Map_Culling *culling = &g_maps.culling;
+
+	// 1. Bring the trees up to date.  Moved dynamic objects are refit in place,
+	//   a moved static object rebuilds the whole static tree.
+	// Proxies of objects that did not move are only re-keyed, if meshes or materials changed.
+	bool rekey_proxies = g_maps.render_proxies_need_update;
+	ForIt( map->entity_table.entities.data, map->entity_table.entities.size ) {
+		if ( it == NULL )
+			continue;
+
+		if ( it->type == EntityType_StaticObject ) {
+			Entity_Static_Object *static_object = ( Entity_Static_Object * )it;
+			if ( !transform_recalculate_dirty_matrices( &static_object->transform ) ) {
+				if ( rekey_proxies )
+					render_proxy_update_mesh( static_object->render_proxy, static_object->model );
+				continue;
+			}
+
+			static_object->world_bounds = model_world_bounds( static_object->model, &static_object->transform );
+			render_proxy_update( static_object->render_proxy, static_object->model, &static_object->transform );
+			map->static_tree_needs_rebuild = true;
+		} else if ( it->type == EntityType_DynamicObject ) {
+			Entity_Dynamic_Object *dynamic_object = ( Entity_Dynamic_Object * )it;
+			bool moved = transform_recalculate_dirty_matrices( &dynamic_object->transform );
+			bool inserted = ( dynamic_object->bvh_leaf != INVALID_BVH_NODE_ID );
+			if ( !moved && inserted ) {
+				if ( rekey_proxies )
+					render_proxy_update_mesh( dynamic_object->render_proxy, dynamic_object->model );
+				continue;
+			}
+
+			dynamic_object->world_bounds = model_world_bounds( dynamic_object->model, &dynamic_object->transform );
+			render_proxy_update( dynamic_object->render_proxy, dynamic_object->model, &dynamic_object->transform );
+			if ( inserted )
+				bvh_move( &map->dynamic_tree, dynamic_object->bvh_leaf, dynamic_object->world_bounds );
+			else
+				dynamic_object->bvh_leaf = bvh_insert( &map->dynamic_tree, dynamic_object->world_bounds, ( u32 )it_index );
 		}
+	}}
+	g_maps.render_proxies_need_update = false;
+
+	if ( map->static_tree_needs_rebuild )
+		static_tree_rebuild( map );
+
+	// 2. Cull both trees against the frustum.
+	Frustum frustum = camera_frustum( camera );
+	array_clear( &culling->visible_slots );
+	bvh_query_frustum( &map->static_tree, &frustum, &culling->visible_slots );
+	bvh_query_frustum( &map->dynamic_tree, &frustum, &culling->visible_slots );
+
+	// 3. Rasterize the occluders that survived the frustum.
+	Occlusion_Buffer *occlusion = &culling->occlusion;
+	if ( culling->occlusion_enabled ) {
+		Matrix4x4_f32 view_projection = camera->projection_matrix * camera->view_matrix;
+		occlusion_buffer_begin( occlusion, &view_projection );
+		ForIt( culling->visible_slots.data, culling->visible_slots.size ) {
+			Entity *entity = map->entity_table.entities.data[ it ];
+			if ( entity == NULL || !( entity->bits & EntityBit_Occluder ) || ( entity->bits & EntityBit_NoDraw ) )
+				continue;
+
+			occlusion_buffer_add_occluder( occlusion, entity_world_bounds( entity ) );
+		}}
+		occlusion_buffer_rasterize( occlusion );
 	}
-	*/
+
+	// 4. Queue the proxies of the ones that are not hidden behind occluders.
+	u32 visible_count = 0;
+	u32 occluded_count = 0;
+	ForIt( culling->visible_slots.data, culling->visible_slots.size ) {
+		Entity *entity = map->entity_table.entities.data[ it ];
+		if ( entity == NULL || ( entity->bits & EntityBit_NoDraw ) )
+			continue;
+
+		bool is_occluder = ( entity->bits & EntityBit_Occluder );
+		if ( culling->occlusion_enabled && !is_occluder && !occlusion_buffer_test_aabb( occlusion, entity_world_bounds( entity ) ) ) {
+			occluded_count += 1;
+			continue;
+		}
+
+		renderer_queue_draw_proxy( entity_render_proxy( entity ) );
+		visible_count += 1;
+	}}
+
+	u32 total_count = map->static_tree.leaves_count + map->dynamic_tree.leaves_count;
+	culling->stats = Map_Culling_Stats {
+		.total = total_count,
+		.visible = visible_count,
+		.culled = total_count - visible_count,
+		.occluded = occluded_count,
+		.occluders = culling->occlusion_enabled ? occlusion->occluders_count : 0,
+		.static_tree_height = bvh_height( &map->static_tree ),
+		.dynamic_tree_height = bvh_height( &map->dynamic_tree )
+	};
+}
+
+Map_Culling_Stats map_culling_stats() {
+	return g_maps.culling.stats;
+}
+
+void map_set_occlusion_culling( bool enabled ) {
+	g_maps.culling.occlusion_enabled = enabled;
+}
+
+bool map_occlusion_culling() {
+	return g_maps.culling.occlusion_enabled;
+}
+
+Occlusion_Buffer * map_occlusion_buffer() {
+	return &g_maps.culling.occlusion;
+}
+
+void map_render_proxies_set_dirty() {
+	g_maps.render_proxies_need_update = true;
 }
 
 Map * map_current() {
@@ -384,16 +583,28 @@ Map * map_changing_to() {
 
 Entity_ID
 map_entity_add( Map *map, Entity *entity ) {
-	// 1. Store `Entity` in an entity storage of that `Entity_Type`.
-	CArray *entity_storage = &map->entity_storages[ entity->type ];
-	u32 storage_idx = carray_add( entity_storage, entity );
-	Entity *storage_entity = ( Entity * )carray_at( entity_storage, storage_idx );
-	Assert( memcmp( storage_entity, entity, sizeof( Entity ) ) == 0 );
+	// 1. Store `Entity` in a slot of the entity pool of that `Entity_Type`.
+	Pool_Allocator *entity_pool = &map->entity_pools[ entity->type ];
+	u64 entity_size = entity_type_size( entity->type );
+	Entity *storage_entity = ( Entity * )QL_Allocate( entity_pool, 1, entity_size, QL_AllocatorTypeCaller( Entity ) );
+	memcpy( storage_entity, entity, entity_size );
 
 	// 2. Add reference to that stored `Entity` to the map's `Entity_Lookup_Table`.
 	Entity_ID entity_id = entity_table_add( &map->entity_table, storage_entity );
 
 	switch ( entity->type ) {
+		case EntityType_StaticObject:
+			// World bounds and the render proxy's mesh and transform are set by the next `map_draw()`,
+			//   which then rebuilds the static tree.
+			( ( Entity_Static_Object * )storage_entity )->render_proxy = renderer_proxy_create( INVALID_MESH_ID, INVALID_MATERIAL_ID );
+			transform_set_dirty( &storage_entity->transform, true );
+			break;
+		case EntityType_DynamicObject:
+			// Inserted into the dynamic tree by the next `map_draw()`.
+			( ( Entity_Dynamic_Object * )storage_entity )->bvh_leaf = INVALID_BVH_NODE_ID;
+			( ( Entity_Dynamic_Object * )storage_entity )->render_proxy = renderer_proxy_create( INVALID_MESH_ID, INVALID_MATERIAL_ID );
+			transform_set_dirty( &storage_entity->transform, true );
+			break;
 		case EntityType_DirectionalLight:
 		case EntityType_PointLight:
 		case EntityType_SpotLight:
@@ -416,9 +627,20 @@ map_entity_remove( Map *map, Entity_ID entity_id ) {
 	if ( !entity )
 		return false;
 
-	// 2. Remove `Entity` from the entity storage of that `Entity_Type`.
-	CArray *entity_storage = &map->entity_storages[ entity->type ];
-	carray_remove_at_pointer( entity_storage, entity );
+	// 2. Remove it from the spatial trees and the renderer.
+	if ( entity->type == EntityType_StaticObject ) {
+		map->static_tree_needs_rebuild = true;
+		renderer_proxy_destroy( ( ( Entity_Static_Object * )entity )->render_proxy );
+	} else if ( entity->type == EntityType_DynamicObject ) {
+		Entity_Dynamic_Object *dynamic_object = ( Entity_Dynamic_Object * )entity;
+		if ( dynamic_object->bvh_leaf != INVALID_BVH_NODE_ID )
+			bvh_remove( &map->dynamic_tree, dynamic_object->bvh_leaf );
+		renderer_proxy_destroy( dynamic_object->render_proxy );
+	}
+
+	// 3. Give the slot back to the entity pool of that `Entity_Type`.
+	Pool_Allocator *entity_pool = &map->entity_pools[ entity->type ];
+	Deallocate( entity_pool, entity );
 
 	bool removed = entity_table_remove( table, entity_id );
 
@@ -436,9 +658,47 @@ map_entity_light_update( Map *map, Entity_Type type, Entity *storage_light_entit
 	g_maps.lights_manager_needs_update = true;
 }
 
-CArrayView
-map_stored_entities_of_type( Map *map, Entity_Type type ) {
-	CArray *entity_storage = &map->entity_storages[ type ];
-	CArrayView view = carray_view( entity_storage );
-	return view;
+Map_Render_Proxies_Test map_render_proxies_test( Map *map, Camera *camera ) {
+	Map_Render_Proxies_Test test = { 0 };
+	map_draw( map, camera );
+
+	Renderer_Proxy_ID proxy_id = INVALID_RENDERER_PROXY_ID;
+	Mesh *mesh = NULL;
+	ForIt( map->entity_table.entities.data, map->entity_table.entities.size ) {
+		if ( it == NULL || ( it->type != EntityType_StaticObject && it->type != EntityType_DynamicObject ) )
+			continue;
+
+		Model_ID model_id = ( it->type == EntityType_StaticObject ) ? ( ( Entity_Static_Object * )it )->model : ( ( Entity_Dynamic_Object * )it )->model;
+		Model *model = model_instance( model_id );
+		if ( model ) {
+			proxy_id = entity_render_proxy( it );
+			mesh = mesh_instance( model->meshes.data[ 0 ] );
+			break;
+		}
+	}}
+
+	Material_ID first_material_id = ( mesh ) ? mesh->material_id : INVALID_MATERIAL_ID;
+	Material_ID other_material_id = INVALID_MATERIAL_ID;
+	ArrayView< Material > materials = materials_get_storage_view();
+	ForIt( materials.data, materials.size ) {
+		if ( it.name.data != NULL && ( Material_ID )it_index != first_material_id ) {
+			other_material_id = ( Material_ID )it_index;
+			break;
+		}
+	}}
+
+	test.object_found = ( mesh != NULL ) && ( other_material_id != INVALID_MATERIAL_ID );
+	if ( !test.object_found )
+		return test;
+
+	mesh->material_id = other_material_id;
+	map_render_proxies_set_dirty();
+	map_draw( map, camera );
+	test.rekeyed = ( renderer_proxy_material( proxy_id ) == other_material_id );
+
+	mesh->material_id = first_material_id;
+	map_render_proxies_set_dirty();
+	map_draw( map, camera );
+	test.restored = ( renderer_proxy_material( proxy_id ) == first_material_id );
+	return test;
 }
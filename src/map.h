@@ -7,32 +7,47 @@
 #include "model.h"
 #include "entity.h"
 #include "entity_table.h"
+#include "occlusion.h"
+#include "light_clusters.h"
 #include "renderer.h"
 
-// std140 - 16-byte alignment required
-struct Uniform_Buffer_Struct_Light {
-	Vector4_f32 position; // w=0: directional, w=1: positional
+// std430, matches `Light` in the lighting shader.
+struct Shader_Storage_Light {
+	Vector4_f32 position; // xyz: world position (direction towards the light for directional lights), w: attenuation radius
 	Vector4_f32 color;    // rgb: color, a: intensity
-	// f32 _padding0[ 4 ]; // Align to 16 bytes.
 };
 
-#define MAX_LIGHT_SOURCES 32
+// std430, matches the head of the `Lights` block; `lights[]` follows it.
+struct Shader_Storage_Lights_Header {
+	u32 directional_lights_count; // Directional lights come first and light every pixel.
+	u32 positional_lights_count;  // Positional lights come after them and only light their clusters.
+	u32 _padding0[ 2 ];           // `lights[]` is aligned to 16 bytes.
+};
 
-// std140 - 16-byte alignment required
-struct Uniform_Buffer_Lights {
-	Uniform_Buffer_Struct_Light lights[ MAX_LIGHT_SOURCES ];
-	u32 lights_count;
-	f32 _padding0[ 3 ]; // Align to 16 bytes.
+// std430, matches the head of the `Light_Clusters` block; `clusters[]` (offset, count) follows it.
+struct Shader_Storage_Light_Clusters_Header {
+	Matrix4x4_f32 view;        // World -> View space, to find a pixel's depth slice.
+	u32 dimensions[ 4 ];       // xyz: clusters on each axis.
+	f32 depth_scale;           // See `Light_Clusters`.
+	f32 depth_bias;
+	f32 _padding0[ 2 ];
 };
 
+static_assert( sizeof( Shader_Storage_Light ) == 32, "Shader_Storage_Light must match the std430 layout" );
+static_assert( sizeof( Shader_Storage_Lights_Header ) == 16, "Shader_Storage_Lights_Header must match the std430 layout" );
+static_assert( sizeof( Shader_Storage_Light_Clusters_Header ) == 96, "Shader_Storage_Light_Clusters_Header must match the std430 layout" );
+
+#define LIGHTS_STORAGE_BUFFER_BINDING 1
+#define LIGHT_CLUSTERS_STORAGE_BUFFER_BINDING 2
+#define LIGHT_INDICES_STORAGE_BUFFER_BINDING 3
+
 struct Lights_Manager {
-	Renderer_Uniform_Buffer *uniform_buffer;
-	Renderer_GL_Buffer_Mapping mapping;
-	u32 current_slot;
-	u32 prev_lights_count;
-	u32 lights_count;
-	Array< u16 > empty_slots;
-	Array< Entity_ID > light_entities;
+	// CPU copies, rebuilt when lights change.  Directional lights first, then positional ones.
+	Array< Shader_Storage_Light > lights;
+	Array< Light_Sphere > positional_spheres;  // Same order as the positional lights.
+	u32 directional_lights_count;
+	// Rebuilt from the camera every frame, then copied into the renderer's frame ring buffer with the lights.
+	Light_Clusters clusters;
 };
 
 enum Map_State : u32 {
@@ -52,15 +67,33 @@ enum Map_State : u32 {
 	MapState_Unloaded
 };
 
+struct Map_Culling_Stats {
+	u32 total;    // Objects in both trees.
+	u32 visible;
+	u32 culled;   // By the frustum or by occluders.
+	u32 occluded; // Of the culled, by occluders.
+	u32 occluders;
+	s32 static_tree_height;
+	s32 dynamic_tree_height;
+};
+
 struct Map {
 	StringView_ASCII name; // Technical name
 	StringView_ASCII title; // Display name
 	StringView_ASCII description;
 	StringView_ASCII file_path;
 
-	CArray entity_storages[ EntityType_COUNT ];
+	// One slot per entity of that type.  Slots never move, so `entity_table` points right into them.
+	Pool_Allocator entity_pools[ EntityType_COUNT ];
 	Entity_Lookup_Table entity_table;
 	Map_State state;
+
+	// Spatial indexes over the world bounds of objects.  Leaves hold `entity_table` slots.
+	// Static objects are in a tree built from scratch when any of them changes,
+	//   dynamic ones are in an incrementally updated tree.
+	BVH_Tree static_tree;
+	BVH_Tree dynamic_tree;
+	bool static_tree_needs_rebuild;
 	// Array< Entity > entities;
 	// Array< Player > players;
 
@@ -70,7 +103,9 @@ struct Map {
 bool maps_init();
 void maps_shutdown();
 
-void maps_update_lights_manager();
+// Bins the lights into the clusters of `camera` and hands them to the renderer for this frame.
+void maps_update_lights_manager( Camera *camera );
+Lights_Manager * maps_lights_manager();
 
 Map * map_load_from_file( StringView_ASCII name, StringView_ASCII file_path );
 Map * map_load_by_name( StringView_ASCII name );
@@ -82,7 +117,25 @@ void map_start( Map *map );
 void map_end( Map *map );
 // void map_save( Map *map );
 
-void map_draw( Map *map );
+// Updates the map's trees, culls objects against the camera's frustum and the depth
+//   of `EntityBit_Occluder` objects, and queues the visible ones for drawing.
+void map_draw( Map *map, Camera *camera );
+Map_Culling_Stats map_culling_stats();  // Of the last `map_draw()`.
+void map_set_occlusion_culling( bool enabled );
+bool map_occlusion_culling();
+Occlusion_Buffer * map_occlusion_buffer();  // As of the last `map_draw()`.
+// Re-keys the render proxies of all objects in the next `map_draw()`.  Call it after changing
+//   a mesh's material or a material's shader program, which the proxies are sorted by.
+void map_render_proxies_set_dirty();
+
+struct Map_Render_Proxies_Test {
+	bool object_found;  // With a model, whose mesh's material is switched to another one and back.
+	bool rekeyed;       // The object's proxy took the other material, after `map_render_proxies_set_dirty()`.
+	bool restored;      // And the first one back.
+};
+
+// Draws `map` a few times to check that proxies follow their mesh's material.  Leaves the materials as they were.
+Map_Render_Proxies_Test map_render_proxies_test( Map *map, Camera *camera );
 
 Map * map_current();
 Map * map_changing_to();
@@ -91,8 +144,6 @@ Entity_ID map_entity_add( Map *map, Entity *entity );
 bool map_entity_remove( Map *map, Entity_ID entity_id );
 void map_entity_light_update( Map *map, Entity_Type type, Entity *storage_light_entity );
 
-CArrayView map_stored_entities_of_type( Map *map, Entity_Type type );
-
 void lights_manager_init( Map *map, Renderer_Uniform_Buffer *uniform_buffer_lights );
 void lights_manager_destroy( Map *map );
 
@@ -139,10 +139,11 @@ Model_ID model_load_from_file( StringView_ASCII name, StringView_ASCII file_path
 		.indices = carray_new( sys_allocator, index_type_size, indices_count ), // Meshes are assumed to be triangulated (3 vertices per face)
 		.material_id = INVALID_MATERIAL_ID,
 		.bits1 = 0,
+		.bounds = aabb_empty(),
 		.vertex_attributes = attributes
-		// .opengl_vao
-		// .opengl_vbo
-		// .opengl_ebo
+		// .geometry_pool_id
+		// .base_vertex
+		// .first_index
 	};
 
 	// Combine vertex data from sparse arrays:
@@ -161,6 +162,7 @@ Model_ID model_load_from_file( StringView_ASCII name, StringView_ASCII file_path
 				.y = ai_mesh->mVertices[ it_index ].y,
 				.z = ai_mesh->mVertices[ it_index ].z
 			};
+			aabb_add_point( &mesh.bounds, *position );
 
 			Vector3_f32 *normal = &normals[ triangle_vertex_idx ];
 			*normal = {
@@ -288,3 +290,7 @@ bool mesh_is_dirty( Mesh *mesh ) {
 bool mesh_is_no_draw( Mesh *mesh ) {
 	return ( mesh->bits1 & MeshBit_NoDraw );
 }
+
+bool mesh_is_uploaded( Mesh *mesh ) {
+	return ( mesh->bits1 & MeshBit_Uploaded );
+}
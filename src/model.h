@@ -8,6 +8,8 @@
 #include "material.h"
 #include "texture.h"
 #include "transform.h"
+#include "renderer_geometry.h"
+#include "culling.h"
 
 // #include "renderer.h"
 struct Vertex_3D;
@@ -23,7 +25,8 @@ struct Mesh_Data {
 enum EMesh_Bits : u16 {
 	MeshBit_Dynamic  = ( 1 << 0 ),  // Dynamic geometry.
 	MeshBit_Dirty    = ( 1 << 1 ),  // Needs `normal_matrix` update.
-	MeshBit_NoDraw   = ( 1 << 2 )   // Do not draw.
+	MeshBit_NoDraw   = ( 1 << 2 ),  // Do not draw.
+	MeshBit_Uploaded = ( 1 << 3 )   // Geometry is in the renderer's geometry pool.
 };
 typedef u16 Mesh_Bits;
 
@@ -56,6 +59,9 @@ struct Mesh {
 	Material_ID material_id;
 	Mesh_Bits bits1; // Internal flags
 
+	// Bounds of the vertex positions in model space.
+	AABB bounds;
+
 	/*
 		Vertex attributes.
 
@@ -66,30 +72,16 @@ struct Mesh {
 	*/
 	Array< Renderer_Vertex_Attribute > vertex_attributes;
 
-	// OpenGL-specific:
-	/*
-		Vertex Array Object
-
-		Stores state of vertex attribute layout configuration (enabled vertex attribute pointers),
-		and implicitly bound VBO and EBO.
-	*/
-	GLuint opengl_vao;
-
-	/*
-		Vertex Buffer Object
-
-		A handle to VRAM buffer (GPU memory) which contains vertex data.
-		Gets bound to active VAO after calling `glVertexAttribPointer`.
-	*/
-	GLuint opengl_vbo;
-
 	/*
-		Element Buffer Object
+		GPU mesh data.
 
-		A handle to VRAM buffer (GPU memory) which contains vertex index data.
-		Gets bound to active VAO after calling `glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebo )`.
+		Meshes with the same vertex format share one vertex buffer and one index buffer
+		  (a geometry pool, owned by the renderer).  The mesh only knows where its part is.
+		Valid when `MeshBit_Uploaded` is set.
 	*/
-	GLuint opengl_ebo;
+	Geometry_Pool_ID geometry_pool_id;
+	u32 base_vertex;  // Offset of the first vertex in the pool's vertex buffer, in vertices.
+	u32 first_index;  // Offset of the first index in the pool's index buffer, in indices.
 };
 
 struct Model {
@@ -115,5 +107,6 @@ u32 mesh_vertex_attributes_size( Mesh *mesh, u8 binding );
 bool mesh_is_dynamic( Mesh *mesh );
 bool mesh_is_dirty( Mesh *mesh );
 bool mesh_is_no_draw( Mesh *mesh );
+bool mesh_is_uploaded( Mesh *mesh );
 
 #endif /* QLIGHT_MODEL_H */
\ No newline at end of file
@@ -0,0 +1,335 @@
+#include <xmmintrin.h>
+#include <math.h>
+
+#include "occlusion.h"
+#include "jobs.h"
+#include "camera.h"
+
+// Rows rasterized by one job.
+constexpr u32 OCCLUSION_BAND_HEIGHT = 16;
+
+// Corner `i` of a box takes `max` on axis X if bit 0 is set, Y for bit 1, Z for bit 2.
+static const u8 g_occlusion_box_faces[ 6 ][ 4 ] = {
+	{ 0, 2, 6, 4 },  // -X
+	{ 1, 3, 7, 5 },  // +X
+	{ 0, 1, 5, 4 },  // -Y
+	{ 2, 3, 7, 6 },  // +Y
+	{ 0, 1, 3, 2 },  // -Z
+	{ 4, 5, 7, 6 }   // +Z
+};
+
+struct Occlusion_Screen_Vertex {
+	f32 x;
+	f32 y;
+	f32 depth;
+};
+
+void occlusion_buffer_init( Occlusion_Buffer *buffer, Allocator *allocator, u32 width, u32 height ) {
+	AssertMessage( width % 4 == 0, "Occlusion buffer width must be a multiple of 4" );
+	*buffer = Occlusion_Buffer {
+		.width = width,
+		.height = height,
+		.depth = array_new< f32 >( allocator, width * height ),
+		.view_projection = { 0 },
+		.triangles = array_new< Occlusion_Triangle >( allocator, 256 ),
+		.occluders_count = 0
+	};
+	buffer->depth.size = width * height;
+	ForIt( buffer->depth.data, buffer->depth.size ) {
+		it = 1.0f;
+	}}
+}
+
+void occlusion_buffer_destroy( Occlusion_Buffer *buffer ) {
+	array_free( &buffer->depth );
+	array_free( &buffer->triangles );
+	buffer->occluders_count = 0;
+}
+
+void occlusion_buffer_begin( Occlusion_Buffer *buffer, Matrix4x4_f32 *view_projection ) {
+	buffer->view_projection = *view_projection;
+	array_clear( &buffer->triangles );
+	buffer->occluders_count = 0;
+
+	__m128 far_depth = _mm_set1_ps( 1.0f );
+	for ( u32 pixel_idx = 0; pixel_idx < buffer->depth.size; pixel_idx += 4 )
+		_mm_storeu_ps( &buffer->depth.data[ pixel_idx ], far_depth );
+}
+
+static void
+occlusion_box_corners_to_clip( Matrix4x4_f32 *view_projection, AABB aabb, Vector4_f32 out_corners[ 8 ] ) {
+	Vector4_f32 *m = view_projection->columns;
+	for ( u32 corner_idx = 0; corner_idx < 8; corner_idx += 1 ) {
+		f32 x = ( corner_idx & 1 ) ? aabb.max.x : aabb.min.x;
+		f32 y = ( corner_idx & 2 ) ? aabb.max.y : aabb.min.y;
+		f32 z = ( corner_idx & 4 ) ? aabb.max.z : aabb.min.z;
+		out_corners[ corner_idx ] = Vector4_f32 {
+			m[ 0 ].x * x  +  m[ 1 ].x * y  +  m[ 2 ].x * z  +  m[ 3 ].x,
+			m[ 0 ].y * x  +  m[ 1 ].y * y  +  m[ 2 ].y * z  +  m[ 3 ].y,
+			m[ 0 ].z * x  +  m[ 1 ].z * y  +  m[ 2 ].z * z  +  m[ 3 ].z,
+			m[ 0 ].w * x  +  m[ 1 ].w * y  +  m[ 2 ].w * z  +  m[ 3 ].w
+		};
+	}
+}
+
+static Occlusion_Screen_Vertex
+occlusion_clip_to_screen( Occlusion_Buffer *buffer, Vector4_f32 clip ) {
+	f32 one_over_w = 1.0f / clip.w;
+	Occlusion_Screen_Vertex vertex = {
+		.x = ( clip.x * one_over_w * 0.5f + 0.5f ) * ( f32 )buffer->width,
+		.y = ( 0.5f - clip.y * one_over_w * 0.5f ) * ( f32 )buffer->height,
+		.depth = clip.z * one_over_w * 0.5f + 0.5f
+	};
+	return vertex;
+}
+
+static void
+occlusion_triangle_setup( Occlusion_Buffer *buffer, Occlusion_Screen_Vertex v0, Occlusion_Screen_Vertex v1, Occlusion_Screen_Vertex v2 ) {
+	f32 area = ( v1.x - v0.x ) * ( v2.y - v0.y )  -  ( v2.x - v0.x ) * ( v1.y - v0.y );
+	if ( fabsf( area ) < 1e-6f )
+		return;
+
+	// Pixels whose centers are in the triangle's bounds.
+	f32 min_x = QL_min2( v0.x, QL_min2( v1.x, v2.x ) );
+	f32 min_y = QL_min2( v0.y, QL_min2( v1.y, v2.y ) );
+	f32 max_x = QL_max2( v0.x, QL_max2( v1.x, v2.x ) );
+	f32 max_y = QL_max2( v0.y, QL_max2( v1.y, v2.y ) );
+	s32 pixel_min_x = ( s32 )QL_max2( ceilf( min_x - 0.5f ), 0.0f );
+	s32 pixel_min_y = ( s32 )QL_max2( ceilf( min_y - 0.5f ), 0.0f );
+	s32 pixel_max_x = ( s32 )QL_min2( floorf( max_x - 0.5f ), ( f32 )buffer->width - 1.0f );
+	s32 pixel_max_y = ( s32 )QL_min2( floorf( max_y - 0.5f ), ( f32 )buffer->height - 1.0f );
+	if ( pixel_min_x > pixel_max_x || pixel_min_y > pixel_max_y )
+		return;
+
+	Occlusion_Triangle triangle;
+	triangle.min_x = pixel_min_x;
+	triangle.min_y = pixel_min_y;
+	triangle.max_x = pixel_max_x;
+	triangle.max_y = pixel_max_y;
+
+	// Edge `i` goes from vertex `i` to the next one, its function is the
+	//   signed area of the edge and the point, flipped to be positive inside.
+	Occlusion_Screen_Vertex vertices[ 3 ] = { v0, v1, v2 };
+	f32 orientation = ( area > 0.0f ) ? 1.0f : -1.0f;
+	for ( u32 edge_idx = 0; edge_idx < 3; edge_idx += 1 ) {
+		Occlusion_Screen_Vertex a = vertices[ edge_idx ];
+		Occlusion_Screen_Vertex b = vertices[ ( edge_idx + 1 ) % 3 ];
+		triangle.edge_a[ edge_idx ] = orientation * ( a.y - b.y );
+		triangle.edge_b[ edge_idx ] = orientation * ( b.x - a.x );
+		triangle.edge_c[ edge_idx ] = orientation * ( a.x * b.y - b.x * a.y );
+	}
+
+	f32 one_over_area = 1.0f / area;
+	f32 depth_1 = v1.depth - v0.depth;
+	f32 depth_2 = v2.depth - v0.depth;
+	triangle.depth_a = ( depth_1 * ( v2.y - v0.y )  -  depth_2 * ( v1.y - v0.y ) ) * one_over_area;
+	triangle.depth_b = ( depth_2 * ( v1.x - v0.x )  -  depth_1 * ( v2.x - v0.x ) ) * one_over_area;
+	triangle.depth_c = v0.depth  -  triangle.depth_a * v0.x  -  triangle.depth_b * v0.y;
+
+	array_add( &buffer->triangles, triangle );
+}
+
+void occlusion_buffer_add_occluder( Occlusion_Buffer *buffer, AABB aabb ) {
+	Vector4_f32 corners[ 8 ];
+	occlusion_box_corners_to_clip( &buffer->view_projection, aabb, corners );
+
+	for ( u32 face_idx = 0; face_idx < 6; face_idx += 1 ) {
+		// Clip the face against the near plane ( z + w >= 0 ), which adds at most one vertex.
+		Vector4_f32 clipped[ 5 ];
+		u32 clipped_count = 0;
+		for ( u32 vertex_idx = 0; vertex_idx < 4; vertex_idx += 1 ) {
+			Vector4_f32 a = corners[ g_occlusion_box_faces[ face_idx ][ vertex_idx ] ];
+			Vector4_f32 b = corners[ g_occlusion_box_faces[ face_idx ][ ( vertex_idx + 1 ) % 4 ] ];
+			f32 distance_a = a.z + a.w;
+			f32 distance_b = b.z + b.w;
+
+			if ( distance_a >= 0.0f )
+				clipped[ clipped_count++ ] = a;
+
+			if ( ( distance_a >= 0.0f ) != ( distance_b >= 0.0f ) ) {
+				f32 t = distance_a / ( distance_a - distance_b );
+				clipped[ clipped_count++ ] = Vector4_f32 {
+					a.x + ( b.x - a.x ) * t,
+					a.y + ( b.y - a.y ) * t,
+					a.z + ( b.z - a.z ) * t,
+					a.w + ( b.w - a.w ) * t
+				};
+			}
+		}
+		if ( clipped_count < 3 )
+			continue;
+
+		Occlusion_Screen_Vertex screen[ 5 ];
+		for ( u32 vertex_idx = 0; vertex_idx < clipped_count; vertex_idx += 1 )
+			screen[ vertex_idx ] = occlusion_clip_to_screen( buffer, clipped[ vertex_idx ] );
+
+		for ( u32 vertex_idx = 2; vertex_idx < clipped_count; vertex_idx += 1 )
+			occlusion_triangle_setup( buffer, screen[ 0 ], screen[ vertex_idx - 1 ], screen[ vertex_idx ] );
+	}
+
+	buffer->occluders_count += 1;
+}
+
+static void
+occlusion_rasterize_band( void *data, u32 band_idx ) {
+	Occlusion_Buffer *buffer = ( Occlusion_Buffer * )data;
+	s32 band_min_y = ( s32 )( band_idx * OCCLUSION_BAND_HEIGHT );
+	s32 band_max_y = ( s32 )QL_min2( ( band_idx + 1 ) * OCCLUSION_BAND_HEIGHT, buffer->height ) - 1;
+
+	const __m128 pixel_offsets = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+	const __m128 zero = _mm_setzero_ps();
+
+	ForIt( buffer->triangles.data, buffer->triangles.size ) {
+		s32 min_y = QL_max2( it.min_y, band_min_y );
+		s32 max_y = QL_min2( it.max_y, band_max_y );
+		if ( min_y > max_y )
+			continue;
+
+		__m128 edge_a0 = _mm_set1_ps( it.edge_a[ 0 ] );
+		__m128 edge_a1 = _mm_set1_ps( it.edge_a[ 1 ] );
+		__m128 edge_a2 = _mm_set1_ps( it.edge_a[ 2 ] );
+		__m128 depth_a = _mm_set1_ps( it.depth_a );
+		s32 start_x = it.min_x & ~3;
+
+		for ( s32 y = min_y; y <= max_y; y += 1 ) {
+			f32 pixel_y = ( f32 )y + 0.5f;
+			__m128 row0 = _mm_set1_ps( it.edge_b[ 0 ] * pixel_y + it.edge_c[ 0 ] );
+			__m128 row1 = _mm_set1_ps( it.edge_b[ 1 ] * pixel_y + it.edge_c[ 1 ] );
+			__m128 row2 = _mm_set1_ps( it.edge_b[ 2 ] * pixel_y + it.edge_c[ 2 ] );
+			__m128 row_depth = _mm_set1_ps( it.depth_b * pixel_y + it.depth_c );
+			f32 *row_pixels = &buffer->depth.data[ y * buffer->width ];
+
+			for ( s32 x = start_x; x <= it.max_x; x += 4 ) {
+				__m128 pixel_x = _mm_add_ps( _mm_set1_ps( ( f32 )x ), pixel_offsets );
+				__m128 edge0 = _mm_add_ps( _mm_mul_ps( edge_a0, pixel_x ), row0 );
+				__m128 edge1 = _mm_add_ps( _mm_mul_ps( edge_a1, pixel_x ), row1 );
+				__m128 edge2 = _mm_add_ps( _mm_mul_ps( edge_a2, pixel_x ), row2 );
+				__m128 inside = _mm_and_ps(
+					_mm_and_ps( _mm_cmpge_ps( edge0, zero ), _mm_cmpge_ps( edge1, zero ) ),
+					_mm_cmpge_ps( edge2, zero )
+				);
+				if ( _mm_movemask_ps( inside ) == 0 )
+					continue;
+
+				__m128 depth = _mm_add_ps( _mm_mul_ps( depth_a, pixel_x ), row_depth );
+				__m128 current = _mm_loadu_ps( &row_pixels[ x ] );
+				__m128 nearest = _mm_min_ps( current, depth );
+				_mm_storeu_ps( &row_pixels[ x ], _mm_or_ps( _mm_and_ps( inside, nearest ), _mm_andnot_ps( inside, current ) ) );
+			}
+		}
+	}}
+}
+
+void occlusion_buffer_rasterize( Occlusion_Buffer *buffer ) {
+	if ( buffer->triangles.size == 0 )
+		return;
+
+	u32 bands_count = ( buffer->height + OCCLUSION_BAND_HEIGHT - 1 ) / OCCLUSION_BAND_HEIGHT;
+	jobs_run_parallel( bands_count, occlusion_rasterize_band, buffer );
+}
+
+bool occlusion_buffer_test_aabb( Occlusion_Buffer *buffer, AABB aabb ) {
+	if ( buffer->occluders_count == 0 )
+		return true;
+
+	Vector4_f32 corners[ 8 ];
+	occlusion_box_corners_to_clip( &buffer->view_projection, aabb, corners );
+
+	f32 min_x =  INFINITY, min_y =  INFINITY, min_depth = INFINITY;
+	f32 max_x = -INFINITY, max_y = -INFINITY;
+	for ( u32 corner_idx = 0; corner_idx < 8; corner_idx += 1 ) {
+		Vector4_f32 clip = corners[ corner_idx ];
+		if ( clip.z + clip.w < 0.0f )
+			return true;
+
+		Occlusion_Screen_Vertex vertex = occlusion_clip_to_screen( buffer, clip );
+		min_x = QL_min2( min_x, vertex.x );
+		min_y = QL_min2( min_y, vertex.y );
+		max_x = QL_max2( max_x, vertex.x );
+		max_y = QL_max2( max_y, vertex.y );
+		min_depth = QL_min2( min_depth, vertex.depth );
+	}
+
+	// Every pixel the screen rectangle touches.
+	s32 pixel_min_x = ( s32 )QL_max2( floorf( min_x ), 0.0f );
+	s32 pixel_min_y = ( s32 )QL_max2( floorf( min_y ), 0.0f );
+	s32 pixel_max_x = ( s32 )QL_min2( ceilf( max_x ) - 1.0f, ( f32 )buffer->width - 1.0f );
+	s32 pixel_max_y = ( s32 )QL_min2( ceilf( max_y ) - 1.0f, ( f32 )buffer->height - 1.0f );
+	if ( pixel_min_x > pixel_max_x || pixel_min_y > pixel_max_y )
+		return true;
+
+	// Visible if any pixel's occluder is not nearer than the box's nearest point.
+	// The extra pixels of the first and last groups of 4 only make the test more conservative.
+	__m128 box_depth = _mm_set1_ps( min_depth );
+	s32 start_x = pixel_min_x & ~3;
+	for ( s32 y = pixel_min_y; y <= pixel_max_y; y += 1 ) {
+		f32 *row_pixels = &buffer->depth.data[ y * buffer->width ];
+		for ( s32 x = start_x; x <= pixel_max_x; x += 4 ) {
+			__m128 occluder_depth = _mm_loadu_ps( &row_pixels[ x ] );
+			if ( _mm_movemask_ps( _mm_cmpge_ps( occluder_depth, box_depth ) ) != 0 )
+				return true;
+		}
+	}
+	return false;
+}
+
+void occlusion_buffer_debug_rgba( Occlusion_Buffer *buffer, u8 *out_rgba ) {
+	// Stretch the range of written depths, they are mostly close to 1.
+	f32 min_depth = 1.0f;
+	ForIt( buffer->depth.data, buffer->depth.size ) {
+		min_depth = QL_min2( min_depth, it );
+	}}
+	f32 scale = ( min_depth < 1.0f ) ? 255.0f / ( 1.0f - min_depth ) : 0.0f;
+
+	ForIt( buffer->depth.data, buffer->depth.size ) {
+		f32 brightness = QL_clamp( ( 1.0f - it ) * scale, 0.0f, 255.0f );
+		u8 *pixel = &out_rgba[ it_index * 4 ];
+		pixel[ 0 ] = ( u8 )brightness;
+		pixel[ 1 ] = ( u8 )brightness;
+		pixel[ 2 ] = ( u8 )brightness;
+		pixel[ 3 ] = 255;
+	}}
+}
+
+struct Occlusion_Test_Box {
+	AABB bounds;
+	bool visible;
+};
+
+Occlusion_Test occlusion_test() {
+	// The camera looks down -Z from the origin, the wall is 10 wide and 10 away,
+	//   so it hides everything behind it closer than 5 / 10 of the depth to the axis.
+	AABB wall = { .min = { -5.0f, -5.0f, -10.5f }, .max = { 5.0f, 5.0f, -10.0f } };
+	Occlusion_Test_Box boxes[] = {
+		{ .bounds = { .min = { -1.0f, -1.0f, -21.0f }, .max = { 1.0f, 1.0f, -19.0f } }, .visible = false },  // Behind.
+		{ .bounds = { .min = { -8.0f, -8.0f, -41.0f }, .max = { 8.0f, 8.0f, -39.0f } }, .visible = false },  // Far behind, bigger than the wall.
+		{ .bounds = { .min = { -1.0f, -1.0f, -6.0f }, .max = { 1.0f, 1.0f, -4.0f } }, .visible = true },     // In front.
+		{ .bounds = { .min = { 12.0f, -1.0f, -21.0f }, .max = { 14.0f, 1.0f, -19.0f } }, .visible = true },  // Beside.
+		{ .bounds = { .min = { 8.0f, -1.0f, -21.0f }, .max = { 12.0f, 1.0f, -19.0f } }, .visible = true },   // Partly behind the edge.
+		{ .bounds = { .min = { -1.0f, -1.0f, -1.0f }, .max = { 1.0f, 1.0f, 1.0f } }, .visible = true }       // Across the near plane.
+	};
+
+	Matrix4x4_f32 view = camera_view_space_matrix( Vector3_f32 { 0.0f, 0.0f, 0.0f }, Vector3_f32 { 0.0f, 0.0f, -1.0f }, Vector3_f32 { 0.0f, 1.0f, 0.0f } );
+	Matrix4x4_f32 projection = camera_projection_perspective( radians( 60.0f ), ( f32 )OCCLUSION_BUFFER_WIDTH / ( f32 )OCCLUSION_BUFFER_HEIGHT, 0.1f, 100.0f );
+	Matrix4x4_f32 view_projection = projection * view;
+
+	Occlusion_Buffer buffer;
+	occlusion_buffer_init( &buffer, sys_allocator, OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT );
+	occlusion_buffer_begin( &buffer, &view_projection );
+	occlusion_buffer_add_occluder( &buffer, wall );
+	occlusion_buffer_rasterize( &buffer );
+
+	Occlusion_Test test = { 0 };
+	test.boxes_count = ARRAY_SIZE( boxes );
+	ForIt( boxes, ARRAY_SIZE( boxes ) ) {
+		bool visible = occlusion_buffer_test_aabb( &buffer, it.bounds );
+		if ( !visible )
+			test.hidden_count += 1;
+		if ( visible != it.visible )
+			test.wrong_count += 1;
+	}}
+
+	test.results_expected = ( test.wrong_count == 0 );
+	occlusion_buffer_destroy( &buffer );
+	return test;
+}
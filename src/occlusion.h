@@ -0,0 +1,81 @@
+#ifndef QLIGHT_OCCLUSION_H
+#define QLIGHT_OCCLUSION_H
+
+#include "common.h"
+#include "array.h"
+#include "math.h"
+#include "culling.h"
+
+/*
+	Software occlusion culling.
+
+	The boxes of large occluders are rasterized into a small depth buffer on the CPU,
+	  then the boxes of other objects are tested against it.  An occluder is assumed to
+	  fill its box, so only flat or box-shaped objects (walls, floors) should be occluders.
+
+	Depth is `[ 0, 1 ]` from the near to the far plane, the buffer is cleared to 1.
+	Row 0 is the top of the screen.  The width must be a multiple of 4, because pixels
+	  are rasterized and tested 4 at a time with SSE.
+
+	Usage every frame:
+		occlusion_buffer_begin( buffer, &view_projection );
+		occlusion_buffer_add_occluder( buffer, occluder_bounds );  // For each occluder.
+		occlusion_buffer_rasterize( buffer );
+		if ( occlusion_buffer_test_aabb( buffer, bounds ) ) { ... }  // Possibly visible.
+*/
+
+constexpr u32 OCCLUSION_BUFFER_WIDTH = 256;
+constexpr u32 OCCLUSION_BUFFER_HEIGHT = 128;
+
+// Screen-space triangle, set up for rasterization.
+struct Occlusion_Triangle {
+	// Pixel rectangle, inclusive.
+	s32 min_x, min_y;
+	s32 max_x, max_y;
+	// Edge functions `a * x + b * y + c`, non-negative inside.
+	f32 edge_a[ 3 ];
+	f32 edge_b[ 3 ];
+	f32 edge_c[ 3 ];
+	// Depth plane `depth = depth_a * x + depth_b * y + depth_c`.
+	f32 depth_a, depth_b, depth_c;
+};
+
+struct Occlusion_Buffer {
+	u32 width;
+	u32 height;
+	Array< f32 > depth;
+
+	Matrix4x4_f32 view_projection;
+	Array< Occlusion_Triangle > triangles;
+	u32 occluders_count;
+};
+
+void occlusion_buffer_init( Occlusion_Buffer *buffer, Allocator *allocator, u32 width, u32 height );
+void occlusion_buffer_destroy( Occlusion_Buffer *buffer );
+
+// Clears the buffer and its occluders.
+void occlusion_buffer_begin( Occlusion_Buffer *buffer, Matrix4x4_f32 *view_projection );
+// Clips the box's triangles against the near plane and sets them up.
+void occlusion_buffer_add_occluder( Occlusion_Buffer *buffer, AABB aabb );
+// Rasterizes all added occluders, split into horizontal bands run as parallel jobs.
+void occlusion_buffer_rasterize( Occlusion_Buffer *buffer );
+
+// False if the box is hidden behind the rasterized occluders.
+// Boxes that cross the near plane are always visible.
+bool occlusion_buffer_test_aabb( Occlusion_Buffer *buffer, AABB aabb );
+
+// Writes `width * height` RGBA8 pixels, nearer is brighter, empty is black.
+void occlusion_buffer_debug_rgba( Occlusion_Buffer *buffer, u8 *out_rgba );
+
+struct Occlusion_Test {
+	u32 boxes_count;
+	u32 hidden_count;
+	u32 wrong_count;  // Boxes hidden that should be visible, or the other way round.
+	bool results_expected;
+};
+
+// Rasterizes a wall in front of a fixed camera and tests boxes in front of it, behind it,
+//   beside it, partly behind its edge and across the near plane.  Needs the job system.
+Occlusion_Test occlusion_test();
+
+#endif /* QLIGHT_OCCLUSION_H */
@@ -40,4 +40,25 @@
 
 extern "C" void platform_assert_fail(const char *expression, const char *message, const char *file, long line);
 
+/*
+	Virtual memory.
+
+	Address space is reserved first and backed by memory only where it is committed.
+	Reserved, uncommitted pages fault on access.  Sizes and addresses are multiples of
+	  `platform_memory_page_size()`.
+*/
+
+u64 platform_memory_page_size();
+// NULL if the address space is not available.
+void *platform_memory_reserve(u64 size);
+// `huge_pages` asks the system to back the range with huge pages where it can, nothing more.
+bool platform_memory_commit(void *memory, u64 size, bool huge_pages);
+// Gives the memory back, the range stays reserved.
+void platform_memory_decommit(void *memory, u64 size);
+void platform_memory_release(void *memory, u64 size);
+// Page faults of the process so far, soft and hard ones.
+u64 platform_page_faults_count();
+// Bytes `malloc()` really set aside for the block, at least the requested size.
+u64 platform_malloc_usable_size(void *memory);
+
 #endif /* QLIGHT_PLATFORM_H */
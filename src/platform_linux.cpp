@@ -1,6 +1,10 @@
 #include "platform.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <malloc.h>       // malloc_usable_size()
+#include <unistd.h>       // sysconf()
+#include <sys/mman.h>     // mmap(), mprotect(), madvise(), munmap()
+#include <sys/resource.h> // getrusage()
 
 void platform_assert_fail(const char *expression, const char *message, const char *file, long line) {
 	const char title[] = "Assertion failed";
@@ -21,3 +25,45 @@ void platform_assert_fail(const char *expression, const char *message, const cha
 	fwrite(text, sizeof(char), cursor, stderr);
 	exit(EXIT_FAILURE); // TODO(nilsoncore): Cause a debug breakpoint instead.
 }
+
+u64 platform_memory_page_size() {
+	static u64 page_size = (u64)sysconf(_SC_PAGESIZE);
+	return page_size;
+}
+
+void *platform_memory_reserve(u64 size) {
+	// No access and no swap reserved, so nothing is committed until `platform_memory_commit()`.
+	void *memory = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return (memory == MAP_FAILED) ? NULL : memory;
+}
+
+bool platform_memory_commit(void *memory, u64 size, bool huge_pages) {
+	if (mprotect(memory, size, PROT_READ | PROT_WRITE) != 0)
+		return false;
+
+	// Only a hint: transparent huge pages may be disabled or unavailable.
+	if (huge_pages)
+		madvise(memory, size, MADV_HUGEPAGE);
+	return true;
+}
+
+void platform_memory_decommit(void *memory, u64 size) {
+	madvise(memory, size, MADV_DONTNEED);
+	mprotect(memory, size, PROT_NONE);
+}
+
+void platform_memory_release(void *memory, u64 size) {
+	munmap(memory, size);
+}
+
+u64 platform_page_faults_count() {
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+	return (u64)usage.ru_minflt + (u64)usage.ru_majflt;
+}
+
+u64 platform_malloc_usable_size(void *memory) {
+	return malloc_usable_size(memory);
+}
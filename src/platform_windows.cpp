@@ -3,10 +3,12 @@
 #include "platform.h"
 #include <stdio.h> // snprintf()
 #include <stdlib.h> // exit()
+#include <malloc.h> // _msize()
 
 #define WIN32_LEAN_AND_MEAN
 #define NOGDI
 #include <Windows.h>
+#include <Psapi.h> // GetProcessMemoryInfo()
 
 void platform_assert_fail(const char *expression, const char *message, const char *file, long line) {
 	const char title[] = "Assertion failed";
@@ -86,3 +88,42 @@ void platform_assert_fail(const char *expression, const char *message, const cha
 		}
 	}
 }
+
+u64 platform_memory_page_size() {
+	static u64 page_size = 0;
+	if (page_size == 0) {
+		SYSTEM_INFO system_info;
+		GetSystemInfo(&system_info);
+		page_size = system_info.dwPageSize;
+	}
+	return page_size;
+}
+
+void *platform_memory_reserve(u64 size) {
+	return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+bool platform_memory_commit(void *memory, u64 size, bool huge_pages) {
+	// Large pages need a privilege and must be allocated whole up front, so they are not used here.
+	return VirtualAlloc(memory, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+void platform_memory_decommit(void *memory, u64 size) {
+	VirtualFree(memory, size, MEM_DECOMMIT);
+}
+
+void platform_memory_release(void *memory, u64 size) {
+	VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+u64 platform_page_faults_count() {
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+
+	return counters.PageFaultCount;
+}
+
+u64 platform_malloc_usable_size(void *memory) {
+	return _msize(memory);
+}
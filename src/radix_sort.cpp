@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <chrono>
+
+#include "radix_sort.h"
+#include "renderer_sort_key.h"
+
+// Histograms for all digits are gathered in a single read over the keys, and
+//   passes where every key has the same digit are skipped entirely (which is
+//   usually the case for the high bits of sort keys).
+Array< Radix_Sort_Item > *
+radix_sort( Array< Radix_Sort_Item > *items, Array< Radix_Sort_Item > *swap ) {
+	constexpr u32 DIGIT_BITS = 8;
+	constexpr u32 DIGIT_VALUES = 1 << DIGIT_BITS;
+	constexpr u32 DIGIT_MASK = DIGIT_VALUES - 1;
+	constexpr u32 DIGIT_PASSES = ( sizeof( u64 ) * 8 ) / DIGIT_BITS;
+	Assert( items->size == swap->size );
+
+	u32 histograms[ DIGIT_PASSES ][ DIGIT_VALUES ] = {};
+	ForIt( items->data, items->size ) {
+		For2( DIGIT_PASSES ) {
+			histograms[ it2_index ][ ( it.key >> ( it2_index * DIGIT_BITS ) ) & DIGIT_MASK ] += 1;
+		}
+	}}
+
+	Array< Radix_Sort_Item > *source = items;
+	Array< Radix_Sort_Item > *destination = swap;
+	u32 offsets[ DIGIT_VALUES ];
+	for ( u32 pass = 0; pass < DIGIT_PASSES; pass += 1 ) {
+		u32 *histogram = histograms[ pass ];
+		u32 shift = pass * DIGIT_BITS;
+
+		u32 first_digit = ( source->data[ 0 ].key >> shift ) & DIGIT_MASK;
+		if ( histogram[ first_digit ] == source->size )
+			continue;
+
+		u32 offset = 0;
+		For( DIGIT_VALUES ) {
+			offsets[ it_index ] = offset;
+			offset += histogram[ it_index ];
+		}
+
+		ForIt( source->data, source->size ) {
+			u32 digit = ( it.key >> shift ) & DIGIT_MASK;
+			destination->data[ offsets[ digit ] ] = it;
+			offsets[ digit ] += 1;
+		}}
+
+		Array< Radix_Sort_Item > *temp = source;
+		source = destination;
+		destination = temp;
+	}
+
+	return source;
+}
+
+// Swaps every later item with a smaller key into place, as the render queue did before the radix sort.
+static void
+exchange_sort( Array< Radix_Sort_Item > *items ) {
+	for ( u32 a = 0; a < items->size; a += 1 ) {
+		for ( u32 b = a + 1; b < items->size; b += 1 ) {
+			if ( items->data[ b ].key < items->data[ a ].key ) {
+				Radix_Sort_Item temp = items->data[ a ];
+				items->data[ a ] = items->data[ b ];
+				items->data[ b ] = temp;
+			}
+		}
+	}
+}
+
+static int
+radix_sort_item_compare( const void *a, const void *b ) {
+	u64 key_a = ( ( const Radix_Sort_Item * )a )->key;
+	u64 key_b = ( ( const Radix_Sort_Item * )b )->key;
+	return ( key_a > key_b ) - ( key_a < key_b );
+}
+
+static bool
+radix_sort_keys_equal( Array< Radix_Sort_Item > *a, Array< Radix_Sort_Item > *b ) {
+	ForIt( a->data, a->size ) {
+		if ( it.key != b->data[ it_index ].key )
+			return false;
+	}}
+	return true;
+}
+
+Radix_Sort_Benchmark radix_sort_benchmark( u32 items_count ) {
+	Radix_Sort_Benchmark result = { .items_count = items_count };
+	if ( items_count == 0 )
+		return result;
+
+	// Laid out like render proxy keys: few passes and programs, more materials and meshes, and a depth below them.
+	// Fixed seed, so runs are reproducible.
+	u32 random_state = 0x9E3779B9;
+	Array< Radix_Sort_Item > keys = array_new< Radix_Sort_Item >( sys_allocator, items_count );
+	For( items_count ) {
+		u64 pass = QL_random_u32( &random_state ) % 3;
+		u64 program = QL_random_u32( &random_state ) % 4;
+		u64 material = QL_random_u32( &random_state ) % 64;
+		u64 mesh = QL_random_u32( &random_state ) % 1024;
+		u64 depth = QL_random_u32( &random_state ) & ( ( 1u << RENDERER_SORT_KEY_DEPTH_BITS ) - 1 );
+		u64 key = ( pass << RENDERER_SORT_KEY_PASS_SHIFT )
+		        | ( program << RENDERER_SORT_KEY_PROGRAM_SHIFT )
+		        | ( material << RENDERER_SORT_KEY_MATERIAL_SHIFT )
+		        | ( mesh << RENDERER_SORT_KEY_MESH_SHIFT )
+		        | depth;
+		array_add( &keys, Radix_Sort_Item { .key = key, .index = it_index } );
+	}
+
+	Array< Radix_Sort_Item > exchange_items = array_new( sys_allocator, array_view( &keys ) );
+	Array< Radix_Sort_Item > qsort_items = array_new( sys_allocator, array_view( &keys ) );
+	Array< Radix_Sort_Item > radix_items = array_new( sys_allocator, array_view( &keys ) );
+	Array< Radix_Sort_Item > radix_swap = array_new( sys_allocator, array_view( &keys ) );
+	auto milliseconds_since = []( std::chrono::steady_clock::time_point start ) -> f64 {
+		return std::chrono::duration< f64, std::milli >( std::chrono::steady_clock::now() - start ).count();
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	exchange_sort( &exchange_items );
+	result.exchange_milliseconds = milliseconds_since( start );
+
+	start = std::chrono::steady_clock::now();
+	qsort( qsort_items.data, qsort_items.size, sizeof( Radix_Sort_Item ), radix_sort_item_compare );
+	result.qsort_milliseconds = milliseconds_since( start );
+
+	start = std::chrono::steady_clock::now();
+	Array< Radix_Sort_Item > *sorted = radix_sort( &radix_items, &radix_swap );
+	result.radix_milliseconds = milliseconds_since( start );
+
+	result.results_equal = radix_sort_keys_equal( &exchange_items, &qsort_items ) && radix_sort_keys_equal( sorted, &qsort_items );
+
+	array_free( &keys );
+	array_free( &exchange_items );
+	array_free( &qsort_items );
+	array_free( &radix_items );
+	array_free( &radix_swap );
+	return result;
+}
@@ -0,0 +1,33 @@
+#ifndef QLIGHT_RADIX_SORT_H
+#define QLIGHT_RADIX_SORT_H
+
+#include "common.h"
+#include "array.h"
+
+/*
+	Least significant digit radix sort of 64-bit keys, 8 bits per pass.
+	It is stable: items with equal keys keep their order, which callers rely on
+	  to break ties by the order items were added in.
+*/
+
+struct Radix_Sort_Item {
+	u64 key;
+	u32 index;  // Caller's, carried along with the key.
+};
+
+// Sorts `items` by key, using `swap` as the second buffer.  Both arrays must be of the same size.
+// Returns the one holding the sorted result.
+Array< Radix_Sort_Item > * radix_sort( Array< Radix_Sort_Item > *items, Array< Radix_Sort_Item > *swap );
+
+struct Radix_Sort_Benchmark {
+	u32 items_count;
+	f64 exchange_milliseconds;  // The exchange sort the render queue had before, O(n^2).
+	f64 qsort_milliseconds;
+	f64 radix_milliseconds;
+	bool results_equal;         // All three ordered the keys the same.
+};
+
+// Sorts the same `items_count` keys, laid out like render proxy keys (see `renderer_sort_key.h`), with each of the sorts.
+Radix_Sort_Benchmark radix_sort_benchmark( u32 items_count );
+
+#endif /* QLIGHT_RADIX_SORT_H */
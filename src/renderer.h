@@ -12,6 +12,8 @@
 #include "transform.h"
 #include "texture.h"
 
+struct ImDrawData;
+
 constexpr float NEAR_CLIP_PLANE_DISTANCE = 0.01f;
 constexpr float FAR_CLIP_PLANE_DISTANCE = 200.0f;
 constexpr float PITCH_MAX_ANGLE = 89.0f;
@@ -54,8 +56,8 @@ enum Renderer_GL_Buffer_Usage : GLenum {
 };
 
 // These forward declarations are needed for bits casting functions down below.
-enum Renderer_GL_Map_Access_Bits;
-enum Renderer_GL_Buffer_Storage_Bits;
+enum Renderer_GL_Map_Access_Bits : GLbitfield;
+enum Renderer_GL_Buffer_Storage_Bits : GLbitfield;
 
 // More info at: `docs.gl/gl4/glMapBufferRange`
 enum Renderer_GL_Map_Access_Bits : GLbitfield {
@@ -319,13 +321,35 @@ struct Renderer_Vertex_Attribute {
 	Renderer_Vertex_Attribute_Bits bits;
 };
 
+enum Renderer_Uniform_Bit : u8 {
+	RendererUniformBit_None = 0,
+
+	// `shadow_value` holds the value that was last uploaded.
+	RendererUniformBit_HasShadowValue = ( 1 << 0 ),
+	// `name` was allocated for the uniform and is freed with its program.
+	RendererUniformBit_OwnsName = ( 1 << 1 )
+};
+typedef u8 Renderer_Uniform_Bits;
+
+// Large enough to hold any supported uniform data type (up to Matrix4x4_f32).
+// Arrays that do not fit are uploaded every time they are set.
+constexpr u32 RENDERER_UNIFORM_SHADOW_VALUE_SIZE = sizeof( f32 ) * 4 * 4;
+
 struct Renderer_Uniform {
-	StringView_ASCII name;
+	StringView_ASCII name;  // Of an array, without the "[0]" OpenGL reports.
 	Renderer_Data_Type data_type;
+	Renderer_Uniform_Bits bits;
+	u32 elements;  // 1, or the length of an array, which is set whole.
+	// Copy of the last uploaded value, so uploading the same value again is skipped.
+	u8 shadow_value[ RENDERER_UNIFORM_SHADOW_VALUE_SIZE ];
 
 	// OpenGL-specific:
 	GLint opengl_location;
 };
+// Index into `Renderer_Shader_Program::uniforms`.
+// Resolve it once with `renderer_shader_program_find_uniform()` and use it in per-draw code.
+typedef u8 Renderer_Uniform_ID;
+constexpr Renderer_Uniform_ID INVALID_UNIFORM_ID = U8_MAX;
 
 typedef void UBO_Struct;
 struct Renderer_Uniform_Buffer {
@@ -339,6 +363,16 @@ struct Renderer_Uniform_Buffer {
 };
 constexpr u32 INVALID_UNIFORM_BUFFER_BINDING = U32_MAX;
 
+// Part of the renderer's per-frame ring buffer, valid until the end of the frame it was allocated in.
+struct Renderer_Frame_Allocation {
+	void *data;  // Write-only, persistently mapped memory.
+	u32 offset;  // From the start of the buffer.
+	u32 size;
+
+	// OpenGL-specific:
+	GLuint opengl_buffer;
+};
+
 struct Renderer_Shader_Program {
 	StringView_ASCII name;
 	Renderer_Shader_Stage      *shaders[ RendererShaderKind_COUNT ]; // stages
@@ -427,10 +461,51 @@ struct Renderer_Framebuffer_Attachment {
 	};
 };
 
+enum Renderer_Render_Pass : u8 {
+	RendererRenderPass_Opaque = 0,
+
+	RendererRenderPass_COUNT
+};
+
+// Retained drawable object, see `renderer_proxy_create()`.
+typedef u32 Renderer_Proxy_ID;
+constexpr Renderer_Proxy_ID INVALID_RENDERER_PROXY_ID = U32_MAX;
+
 struct Renderer_Render_Command {
 	Mesh_ID mesh_id;
 	Material_ID material_id;
-	Transform *transform;
+	Renderer_Render_Pass pass;
+	// Slot of the proxy's instance data in the retained instance buffer.
+	u32 instance_idx;
+	// Packed key the proxy is sorted by.
+	u64 sort_key;
+};
+
+enum Renderer_GL_Error_Check_Mode : u8 {
+	// No error checking at all.
+	RendererGLErrorCheckMode_Off = 0,
+
+	// Driver reports errors asynchronously through the KHR_debug output callback.
+	RendererGLErrorCheckMode_DebugCallback,
+
+	// `glGetError` around wrapped calls, but only every Nth frame or on request.
+	// Compiled out of Release builds.
+	RendererGLErrorCheckMode_Sampled,
+
+	RendererGLErrorCheckMode_COUNT
+};
+
+enum Renderer_Backend : u8 {
+	RendererBackend_OpenGL = 0,
+
+	// Makes no OpenGL calls at all, so it runs without a window or a GPU.
+	// Resources keep their IDs and bookkeeping and get made-up OpenGL names,
+	//   frames are batched and their recorded commands walked on the CPU, then dropped.
+	RendererBackend_Null,
+	// Keeps the null backend's bookkeeping and draws every frame on the CPU, see `renderer_software.h`.
+	RendererBackend_Software,
+
+	RendererBackend_COUNT
 };
 
 enum Renderer_Output_Channel : u8 {
@@ -456,8 +531,11 @@ struct Vertex_3D_XYZ {
 	// Vector3_f32 texture_uvw;
 };
 
-bool renderer_init();
+// The OpenGL backend needs a current context, the null and software backends need nothing.
+bool renderer_init( Renderer_Backend backend = RendererBackend_OpenGL );
 void renderer_shutdown();
+Renderer_Backend renderer_backend();
+StringView_ASCII renderer_backend_name( Renderer_Backend backend );
 
 StringView_ASCII
 opengl_storage_format_name( GLint internal_format );
@@ -496,6 +574,15 @@ renderer_create_and_compile_shader_program( StringView_ASCII name, ArrayView< Re
 bool
 renderer_shader_program_set_uniform( Renderer_Shader_Program *program, StringView_ASCII uniform_name, Renderer_Data_Type data_type, void *value );
 
+bool
+renderer_shader_program_set_uniform( Renderer_Shader_Program *program, Renderer_Uniform_ID uniform_id, void *value );
+
+Renderer_Uniform_ID
+renderer_shader_program_find_uniform( Renderer_Shader_Program *program, StringView_ASCII uniform_name );
+
+u32
+renderer_shader_program_query_uniforms( Renderer_Shader_Program *program );
+
 u32
 renderer_shader_program_update_uniform_locations( Renderer_Shader_Program *program );
 
@@ -505,6 +592,10 @@ renderer_set_uniforms_transpose_matrix( bool value );
 u32
 renderer_data_type_size( Renderer_Data_Type data_type );
 
+// Of the whole value, all elements of an array.
+u32
+renderer_uniform_size( Renderer_Uniform *uniform );
+
 GLenum
 renderer_data_type_to_opengl_type( Renderer_Data_Type data_type );
 
@@ -543,9 +634,20 @@ renderer_is_framebuffer_complete( Renderer_Framebuffer_ID framebuffer_id );
 void
 renderer_set_active_framebuffer_color_attachment_points( Renderer_Framebuffer_ID framebuffer_id, ArrayView< Renderer_Framebuffer_Attachment_Point > attachment_points );
 
+// Finishes the frame packet built since the last call and draws it, see `renderer_thread.h`.
+// With the render thread running, waits for it to finish the previous packet and hands this one over.
 void
 renderer_draw_frame();
 
+// Copies ImGui's draw data into the frame being built, it is drawn over everything else.
+void
+renderer_set_ui_draw_data( ImDrawData *draw_data );
+
+// Returns `size` bytes to fill for the frame being built, bound as a shader storage buffer at `binding`
+//   when the frame is drawn.  NULL if the frame's packet is full.
+void *
+renderer_frame_storage_buffer( u32 binding, u32 size );
+
 bool
 renderer_bind_framebuffer( Renderer_Framebuffer_ID framebuffer_id );
 
@@ -555,8 +657,37 @@ renderer_bind_shader_program( Renderer_Shader_Program *program );
 bool
 renderer_bind_texture( u32 texture_slot_idx, Texture_ID texture_id );
 
+// Render proxies are kept by the renderer between frames, presorted, with their instance data already on the GPU.
+// Create one per drawable object and update it only when the object changes.
+Renderer_Proxy_ID
+renderer_proxy_create( Mesh_ID mesh_id, Material_ID material_id );
+
+void
+renderer_proxy_destroy( Renderer_Proxy_ID proxy_id );
+
+// Re-sorts the proxy if the mesh or the material changed, does nothing otherwise.
 void
-renderer_queue_draw_command( Mesh_ID mesh_id, Material_ID material_id, Transform *transform );
+renderer_proxy_set_mesh( Renderer_Proxy_ID proxy_id, Mesh_ID mesh_id, Material_ID material_id );
+
+// Copies the transform's matrices, which must be up to date.  Call it only when they were recalculated.
+void
+renderer_proxy_set_transform( Renderer_Proxy_ID proxy_id, Transform *transform );
+
+// Draws the proxy in the next frame.
+void
+renderer_queue_draw_proxy( Renderer_Proxy_ID proxy_id );
+
+// The proxy is sorted and drawn with, `INVALID_MATERIAL_ID` if there is no such proxy.
+Material_ID
+renderer_proxy_material( Renderer_Proxy_ID proxy_id );
+
+// Render proxies that exist right now.
+u32
+renderer_proxies_count();
+
+// Proxy instance data uploaded in the last frame, only what changed or moved since the frame before.
+u32
+renderer_proxy_instances_uploaded();
 
 void
 renderer_set_view_matrix_pointer( Matrix4x4_f32 *view );
@@ -583,9 +714,24 @@ renderer_texture_2d_upload(
 	GLenum opengl_pixel_type
 );
 
+// Uploads the texture into a layer of the texture array pool of its size and format, creating or growing the pool if needed.
+// Materials can only refer to textures uploaded this way, anything else is replaced by a default texture.
+// `opengl_id` becomes a 2D view of the layer, so the texture can be bound on its own too.
+bool
+renderer_texture_array_upload( Texture_ID texture_id, u8 mipmap_levels, GLint opengl_storage_format, GLenum opengl_pixel_type );
+
+// Copies the texture's bytes into the frame being built, they are uploaded into its existing storage when the frame is drawn.
+// For textures changed on the CPU every frame.
+bool
+renderer_texture_2d_update( Texture_ID texture_id );
+
 bool
 renderer_mesh_upload( Mesh_ID mesh_id );
 
+// Gives the mesh's space in its geometry pool back.  The mesh can be uploaded again afterwards.
+void
+renderer_mesh_release( Mesh_ID mesh_id );
+
 bool
 renderer_model_meshes_upload( Model_ID model_id );
 
@@ -634,9 +780,29 @@ renderer_uniform_buffer_read( Renderer_Uniform_Buffer *uniform_buffer, Array< u8
 bool
 renderer_uniform_buffer_destroy( Renderer_Uniform_Buffer *uniform_buffer );
 
+// Returns `size` bytes of GPU-visible memory for data that changes every frame.
+// Only for the thread drawing frames: it is the render thread once started, see `renderer_frame_storage_buffer()` otherwise.
+// `data` is NULL if this frame's part of the ring buffer is full.
+Renderer_Frame_Allocation
+renderer_frame_allocate( u32 size );
+
+void
+renderer_frame_allocation_bind_uniform_buffer( Renderer_Frame_Allocation *allocation, u32 binding );
+
+// Per-frame ring buffer allocations that did not fit into their frame's region so far.
+u32
+renderer_frame_ring_overflows();
+
+void
+renderer_frame_allocation_bind_shader_storage_buffer( Renderer_Frame_Allocation *allocation, u32 binding );
+
 void
 renderer_set_camera_position_pointer( Vector3_f32 *camera_position );
 
+// Program of the fullscreen lighting pass.  It reads the G-Buffer and the parameters of all materials at once.
+void
+renderer_set_lighting_shader_program( Renderer_Shader_Program *program );
+
 void
 renderer_set_ambient_light_color( Vector3_f32 ambient_light );
 
@@ -646,10 +812,61 @@ renderer_get_ambient_light_pointer();
 StringView_ASCII
 renderer_framebuffer_attachment_point_name( Renderer_Framebuffer_Attachment_Point attachment_point );
 
+// With the null backend frames are a fixed step apart, so runs are reproducible.
 f32
 renderer_frame_time_delta();
 
+// Bind and state change calls of the previous frame that reached OpenGL.
+u32
+renderer_state_changes_issued();
+
+// Bind and state change calls of the previous frame that were dropped as redundant.
+u32
+renderer_state_changes_elided();
+
+// Render commands submitted in the last frame, i.e. how many draw calls there would be without instancing.
+u32
+renderer_draw_commands();
+
+// Scratch of the frame being built, reset by `renderer_draw_frame()`.  Use it under a `Linear_Allocator_Scope`.
+Linear_Allocator *
+renderer_frame_arena();
+
+// Most bytes either frame arena ever held.
+u64
+renderer_frame_arena_high_water_mark();
+
+// Whether the last frame, and the one the render thread may have drawn alongside it, were not expected
+//   to allocate through `sys_allocator`: no loading, no proxies created or changed, no capture.
+bool
+renderer_frame_steady_state();
+
+// Geometry draw calls issued in the last frame after merging commands into instanced multi-draws.
+u32
+renderer_draw_calls();
+
 void
 renderer_set_output_channel( Renderer_Output_Channel channel );
 
+void
+renderer_set_gl_error_check_mode( Renderer_GL_Error_Check_Mode mode );
+
+Renderer_GL_Error_Check_Mode
+renderer_gl_error_check_mode();
+
+// 0 - check only on request.
+void
+renderer_set_gl_error_check_interval( u32 frames );
+
+u32
+renderer_gl_error_check_interval();
+
+// Check the next frame in `RendererGLErrorCheckMode_Sampled` mode regardless of the interval.
+void
+renderer_request_gl_error_check();
+
+// Records the OpenGL calls of the next `frames_count` frames into the file, see `renderer_capture.h`.
+bool
+renderer_capture_frames( const char *file_path, u32 frames_count );
+
 #endif /* QLIGHT_RENDERER_H */
@@ -0,0 +1,347 @@
+#ifndef QLIGHT_RENDERER_BACKEND_H
+#define QLIGHT_RENDERER_BACKEND_H
+
+#include "renderer.h"
+#include "renderer_batch.h"
+#include "renderer_commands.h"
+#include "renderer_proxy.h"
+#include "renderer_opengl_state.h"
+#include "renderer_ring_buffer.h"
+#include "renderer_software.h"
+#include "allocator.h"
+
+/*
+	State shared by the renderer and its backends.  Only the renderer's own translation units include this.
+
+	`renderer_opengl.cpp` keeps everything every backend has in common: resource arrays, frame packets,
+	  proxies and the state cache.  Whatever a backend does with the GPU goes through
+	  `Renderer_Backend_Dispatch`, the way the state cache goes through `OpenGL_State_Dispatch`:
+	- `renderer_backend_opengl.cpp`: the OpenGL calls.  Not part of headless builds, see `QLIGHT_HEADLESS`;
+	- `renderer_backend_null.cpp`: the null backend, which makes up object names and skips the calls,
+	  and the software backend, which is the null one drawing frames with `renderer_software.h`.
+*/
+
+// Per-frame part of the ring buffer for instance data, indirect commands and other dynamic data.
+constexpr u32 RENDERER_FRAME_RING_BUFFER_SIZE = 8 * 1024 * 1024;
+
+// Each of the two frame packets has its own arena of this size, see `Renderer_Frame_Packet`.
+constexpr u64 RENDERER_FRAME_PACKET_ARENA_SIZE = 32 * 1024 * 1024;
+constexpr u64 RENDERER_FRAME_PACKET_ALIGNMENT = 16;
+constexpr u32 RENDERER_FRAME_PACKET_MAX_STORAGE_BUFFERS = 8;
+constexpr u32 RENDERER_FRAME_PACKET_MAX_TEXTURE_UPDATES = 8;
+
+// Per-material parameters as seen by `geometry_fragment.glsl` and `phong_fragment.glsl` (std430).
+// Indexed by the instance's material ID in the geometry pass and by the G-Buffer material ID in the lighting pass.
+// Textures are `( texture array pool << 16 ) | layer`, see `texture_array_reference()`.
+struct Renderer_Material_Parameters {
+	u32 diffuse;
+	u32 normal_map;
+	u32 specular_map;
+	f32 shininess_exponent;
+};
+// std430 packs an array of this struct at its 16-byte size, with no padding between the members or the elements.
+static_assert( offsetof( Renderer_Material_Parameters, diffuse ) == 0, "Renderer_Material_Parameters must match std430 layout" );
+static_assert( offsetof( Renderer_Material_Parameters, normal_map ) == 4, "Renderer_Material_Parameters must match std430 layout" );
+static_assert( offsetof( Renderer_Material_Parameters, specular_map ) == 8, "Renderer_Material_Parameters must match std430 layout" );
+static_assert( offsetof( Renderer_Material_Parameters, shininess_exponent ) == 12, "Renderer_Material_Parameters must match std430 layout" );
+static_assert( sizeof( Renderer_Material_Parameters ) == 16, "Renderer_Material_Parameters must match std430 layout" );
+
+// One immutable 2D array texture shared by all textures with the same size, storage format and mipmap levels.
+// Every texture is a layer of it, so switching between them does not need any binding.
+struct Texture_Array_Pool {
+	Vector2_u16 dimensions;
+	u8 mipmap_levels;
+	GLint opengl_storage_format;
+	Array< Texture_ID > layers;  // Texture in each used layer.
+	u32 layers_capacity;
+
+	GLuint opengl_texture;
+};
+
+// Shared vertex and index buffers of all meshes with the same vertex format and index size.
+struct Geometry_Pool {
+	Array< Renderer_Vertex_Attribute > vertex_attributes;
+	u32 vertex_stride;
+	u32 index_size;
+	Offset_Allocator vertices;  // In vertices.
+	Offset_Allocator indices;   // In indices.
+
+	GLuint opengl_vao;
+	GLuint opengl_vbo;
+	GLuint opengl_ebo;
+};
+
+struct Geometry_Buffer {
+	Renderer_Framebuffer_ID framebuffer;
+	Renderer_Shader_Program *shader_program;
+	Texture_ID texture_position;
+	Texture_ID texture_normal;
+	Texture_ID texture_color_specular;  // 24-bit color, 8-bit specular combined
+	Texture_ID texture_material;        // 16-bit material ID, `INVALID_MATERIAL_ID` where nothing was drawn
+	Renderer_Renderbuffer_ID renderbuffer_depth_stencil;  // 24-bit depth, 8-bit stencil combined
+	Vector2_u16 dimensions;
+};
+
+struct GL_Constants {
+	u32 max_color_attachments;
+	u32 max_uniform_block_size;
+	u32 max_uniform_locations;
+	u32 max_uniform_buffer_bindings;
+	u32 min_map_buffer_alignment;
+	u32 uniform_buffer_offset_alignment;
+	u32 shader_storage_buffer_offset_alignment;
+	u32 max_array_texture_layers;
+};
+
+struct GL_Error_Checks {
+	Renderer_GL_Error_Check_Mode mode;
+	// Whether `GL_CHECK` family macros call `glGetError` right now.
+	// Only ever true in `RendererGLErrorCheckMode_Sampled` mode.
+	bool active;
+	// Check the next frame regardless of the interval.
+	bool requested;
+	// Check every Nth frame. 0 - only on request.
+	u32 sample_interval;
+	u32 frame_idx;
+};
+
+// Settings changed by the game thread at any time, each frame packet gets a copy.
+struct Renderer_Frame_Settings {
+	Renderer_Output_Channel output_channel;
+	Renderer_GL_Error_Check_Mode gl_error_check_mode;
+	u32 gl_error_check_interval;
+	bool gl_error_check_requested;
+	u32 capture_frames_count;  // Frames to capture from this one on, 0 - none.
+};
+
+struct Renderer_Frame_Storage_Buffer {
+	void *data;  // In the packet's arena.
+	u32 size;
+	u32 binding;
+};
+
+struct Renderer_Frame_Texture_Update {
+	Texture_ID texture_id;
+	void *bytes;  // Copy of the texture's bytes, in the packet's arena.
+};
+
+// Everything the render thread reads to draw one frame, see `renderer_thread.h`.
+// Built by the game thread between two `renderer_draw_frame()` calls and never changed after that.
+struct Renderer_Frame_Packet {
+	// Holds everything the packet points to.  Reset when the packet is built again.
+	Linear_Allocator arena;
+	u64 frame_idx;
+	Renderer_Frame_Settings settings;
+
+	Matrix4x4_f32 view;
+	Matrix4x4_f32 projection;
+	Vector3_f32 camera_position;
+	Vector3_f32 ambient_light;
+	Vector2_u16 viewport_dimensions;
+	f32 time;        // Seconds since the start.
+	f32 time_delta;  // Milliseconds since the previous frame.
+
+	// The proxy instance buffer is re-created if its capacity differs.
+	u32 instance_capacity;
+	// Instance data that changed since the previous packet, written from `dirty_first_instance` on.
+	u32 dirty_first_instance;
+	ArrayView< Renderer_Instance_Data > dirty_instances;
+	// Visible proxies in the sorted order.
+	ArrayView< Renderer_Render_Command > render_queue;
+	// Indexed by material ID, never empty.
+	ArrayView< Renderer_Material_Parameters > materials;
+	// The same materials by texture ID, only written for the software backend.
+	ArrayView< Renderer_Software_Material > software_materials;
+
+	Renderer_Frame_Storage_Buffer storage_buffers[ RENDERER_FRAME_PACKET_MAX_STORAGE_BUFFERS ];
+	u32 storage_buffers_count;
+	Renderer_Frame_Texture_Update texture_updates[ RENDERER_FRAME_PACKET_MAX_TEXTURE_UPDATES ];
+	u32 texture_updates_count;
+	ArrayView< Renderer_Command_Stream * > command_streams;
+	ImDrawData *ui_draw_data;  // NULL if there is no UI.
+	const char *capture_file_path;  // In the packet's arena, set if `settings.capture_frames_count` is.
+
+	// Scratch of the packet's frame, the render queue lives there too.
+	Linear_Allocator *frame_arena;
+	// Nothing is expected to grow: executing the packet must not allocate through `sys_allocator`.
+	bool steady_state;
+};
+
+/*
+	What a backend does with the GPU.  The renderer fills in everything backend-independent first,
+	  functions returning an OpenGL name return the one to store, made up by the null backend.
+*/
+struct Renderer_Backend_Dispatch {
+	// Sets `g_renderer.gl_constants` and `g_renderer.device`, and creates what the backend itself needs.
+	bool ( *init )();
+	// Releases what `init` created and the objects of the geometry and texture array pools.
+	void ( *shutdown )();
+	// What the state cache calls, see `OpenGL_State`.
+	OpenGL_State_Dispatch state;
+	// Takes effect right away, for the thread drawing frames.
+	void ( *set_error_check_mode )( Renderer_GL_Error_Check_Mode mode );
+	// Seconds since the start, taken once per frame.
+	f32 ( *current_time )();
+
+	// Compiles and links the stages, or only records them with the program.
+	void ( *program_create )( Renderer_Shader_Program *program, ArrayView< Renderer_Shader_Stage * > stages );
+	void ( *program_destroy )( Renderer_Shader_Program *program );
+	u32 ( *program_query_uniforms )( Renderer_Shader_Program *program );
+	GLint ( *program_uniform_location )( Renderer_Shader_Program *program, Renderer_Uniform *uniform );
+	// False if the value did not reach the program, only known when errors are checked.
+	bool ( *program_set_uniform )( Renderer_Shader_Program *program, Renderer_Uniform *uniform, void *value );
+
+	GLuint ( *renderbuffer_create )( StringView_ASCII name, Vector2_u16 dimensions, GLenum opengl_storage_format );
+	GLuint ( *framebuffer_create )( StringView_ASCII name );
+	void ( *framebuffer_attach_renderbuffer )( Renderer_Framebuffer *framebuffer, GLenum opengl_attachment, Renderer_Renderbuffer *renderbuffer );
+	void ( *framebuffer_attach_texture )( Renderer_Framebuffer *framebuffer, GLenum opengl_attachment, Texture *texture );
+	bool ( *framebuffer_is_complete )( Renderer_Framebuffer *framebuffer );
+	void ( *framebuffer_set_draw_buffers )( Renderer_Framebuffer *framebuffer, ArrayView< GLenum > opengl_color_attachments );
+
+	// Storage as the texture describes it, with its bytes uploaded if it has any.
+	GLuint ( *texture_2d_create )( Texture *texture );
+	GLuint ( *texture_array_create )( Vector2_u16 dimensions, u8 mipmap_levels, GLint opengl_storage_format, u32 layers, StringView_ASCII debug_name );
+	// New array texture with the pool's used layers copied over, the old one is deleted.
+	GLuint ( *texture_array_grow )( Texture_Array_Pool *pool, u32 layers_capacity );
+	// Writes the texture's bytes, if it has any, into the layer with all mipmap levels.
+	void ( *texture_array_upload_layer )( Texture_Array_Pool *pool, Texture *texture, u32 layer );
+	// 2D view of the layer that replaces the texture's `opengl_id`.
+	GLuint ( *texture_array_layer_view )( Texture_Array_Pool *pool, Texture *texture, u32 layer );
+
+	// Sets the pool's vertex array and buffers up for its vertex format.
+	void ( *geometry_pool_create )( Geometry_Pool *pool );
+	// Replaces `*buffer`, one of the pool's, by a larger one with the same contents.
+	void ( *geometry_pool_grow_buffer )( Geometry_Pool *pool, GLuint *buffer, u64 old_size, u64 new_size );
+	// Writes the mesh's vertices and indices where it was allocated in the pool.
+	void ( *mesh_upload )( Geometry_Pool *pool, Mesh *mesh );
+	// Issued right away, the pool's vertex array has to be bound.
+	void ( *mesh_draw )( Geometry_Pool *pool, Mesh *mesh, u32 instance_count, u32 first_instance );
+
+	// Draws the packet, on the render thread if there is one.
+	void ( *frame_packet_execute )( Renderer_Frame_Packet *packet );
+};
+
+#ifndef QLIGHT_HEADLESS
+Renderer_Backend_Dispatch renderer_backend_opengl();
+#endif
+Renderer_Backend_Dispatch renderer_backend_null();
+Renderer_Backend_Dispatch renderer_backend_software();
+
+struct G_Renderer {
+	Renderer_Backend backend;
+	Renderer_Backend_Dispatch dispatch;
+	GLuint null_object_name;  // Last made-up OpenGL name handed out by the null backend.
+	Renderer_Software software;  // Software backend only.
+
+	struct Frame_Time {
+		f32 last;
+		f32 current;
+		f32 delta;
+	} frame_time;
+
+	struct Device {
+		StringView_ASCII vendor;
+		StringView_ASCII name;
+	} device;
+
+	Array< Renderer_Framebuffer > framebuffers;
+	Array< Renderer_Renderbuffer > renderbuffers;
+	// Materials, commands and ring buffers keep pointers into these, so each grows in place on its own arena.
+	Array< Renderer_Shader_Program > programs;
+	Array< Renderer_Shader_Stage > stages;
+	Array< Renderer_Uniform_Buffer > uniform_buffers;
+	Virtual_Arena_Allocator programs_arena;
+	Virtual_Arena_Allocator stages_arena;
+	Virtual_Arena_Allocator uniform_buffers_arena;
+
+	Array< Geometry_Pool > geometry_pools;
+	Array< Texture_Array_Pool > texture_array_pools;
+	Geometry_Buffer gbuffer;
+
+	Vector3_f32 *camera_position;
+	Matrix4x4_f32 *view_matrix;
+	Matrix4x4_f32 *projection_matrix;
+	Vector3_f32 ambient_light;
+	Renderer_Frame_Settings settings;
+	char capture_file_path[ 256 ];  // Of the capture `settings.capture_frames_count` asks for.
+
+	// The game thread builds `packets[ packet_idx ]` while the render thread may draw the other one.
+	Renderer_Frame_Packet packets[ 2 ];
+	u32 packet_idx;
+	u64 frame_idx;
+	// Per-frame scratch, used in turns, see `frame_arena()`.
+	Linear_Allocator frame_arenas[ 2 ];
+	// Packets in a row that were in steady state, up to the last one drawn.
+	u32 steady_state_packets;
+
+	Vector4_f32 clear_color;
+	// Retained drawable objects, presorted.  Their instance data is mirrored in `proxy_instance_buffer`.
+	// Proxies and everything about them up to the render queue belong to the game thread,
+	//   the render thread only sees what `frame_packet_write_proxies()` copies.
+	Renderer_Proxy_Table proxies;
+	u32 proxy_instance_capacity;  // In instances, what the packets ask for.
+	GLuint proxy_instance_buffer;
+	u32 proxy_instance_buffer_capacity;  // In instances, what the buffer was created with.
+	// Proxies queued for the next frame, in no particular order.
+	Array< Renderer_Proxy_ID > visible_proxies;
+	// Recorded command streams replayed after the lighting pass of the next frame.
+	Array< Renderer_Command_Stream * > submitted_streams;
+	// Visible proxies in the sorted order, rebuilt every frame in the frame arena, the packet points to it.
+	Array< Renderer_Render_Command > render_queue;
+	// Render queue merged into instanced draws, rebuilt every frame in the packet's frame arena.
+	Array< Renderer_Instance_Batch > render_batches;
+	// Render batches as indirect commands, copied into `indirect_allocation` every frame.
+	Array< Renderer_Draw_Elements_Indirect_Command > indirect_commands;
+	Array< Renderer_Indirect_Draw > indirect_draws;
+	// Instance indices of the render queue and its indirect commands, in `frame_ring`.
+	Renderer_Frame_Allocation instance_indices_allocation;
+	Renderer_Frame_Allocation indirect_allocation;
+	// Parameters of all materials, indexed by material ID in the lighting pass.
+	Renderer_Frame_Allocation material_allocation;
+	Renderer_Frame_Allocation frame_constants_allocation;
+	Renderer_Ring_Buffer frame_ring;
+
+	// Shades the whole G-Buffer in a single fullscreen pass, whatever materials are visible.
+	Renderer_Shader_Program *lighting_program;
+
+	struct Draw_Stats {
+		u32 draw_commands;  // Render commands submitted, i.e. draw calls without instancing.
+		u32 draw_calls;     // Draw calls actually issued, one per multi-draw.
+		u32 proxy_instances_uploaded;  // Retained instance data re-uploaded because it changed or moved.
+	} draw_stats;
+
+	// Stats of the last drawn packet for the game thread, copied while the render thread is idle.
+	struct Reported_Stats {
+		Draw_Stats draw;
+		OpenGL_State_Counters state_changes;
+	} reported_stats;
+
+	Texture_ID texture_white;
+	Texture_ID texture_black;
+	Texture_ID texture_purple_checkers;
+
+	Mesh_ID fullscreen_quad;
+
+	// OpenGL-specific:
+	GL_Constants gl_constants;
+	OpenGL_State gl_state;
+	GL_Error_Checks gl_error_checks;
+	/*
+		OpenGL definition of glUniformMatrixNxM: 'The first number in the
+			command name is the number of columns; the second is the number of rows.'
+	*/
+	bool uniforms_transpose_matrix; // [columns] x [rows] -> [rows] x [columns]
+	String_ASCII opengl_error_log;
+	String_ASCII opengl_info_log;
+
+};
+
+extern G_Renderer g_renderer;
+
+// Merges the packet's render queue into instanced multi-draws, in `g_renderer.indirect_draws`.
+void build_render_batches( Renderer_Frame_Packet *packet );
+// Replays recorded commands in the stream's order.  Binds go through the state cache,
+//   so repeated binds of the same program or texture by different packets are elided.
+void replay_command_stream( Renderer_Command_Stream *stream );
+
+#endif /* QLIGHT_RENDERER_BACKEND_H */
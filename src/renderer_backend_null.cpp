@@ -0,0 +1,288 @@
+#include "renderer_backend.h"
+#include "map.h"
+
+#define QL_LOG_CHANNEL "Renderer"
+#include "log.h"
+
+/*
+	The null backend does what the renderer does on the CPU and makes no OpenGL calls,
+	  so it runs without a window and without a GPU: in tests, benchmarks and on servers.
+	The software backend is the null one that also draws the frames with `renderer_software.h`.
+*/
+
+// Time between frames of the null backend, in seconds.
+constexpr f32 RENDERER_NULL_FRAME_TIME_STEP = 1.0f / 60.0f;
+
+// Stands in for the names `glCreate*` would return, so checks for 0 keep working with the null backend.
+static GLuint
+null_object_name() {
+	g_renderer.null_object_name += 1;
+	return g_renderer.null_object_name;
+}
+
+// What the null backend reports instead of querying, the minimums OpenGL 4.6 guarantees or common values.
+static void
+null_set_constants() {
+	g_renderer.gl_constants = GL_Constants {
+		.max_color_attachments = 8,
+		.max_uniform_block_size = 16384,
+		.max_uniform_locations = 1024,
+		.max_uniform_buffer_bindings = 84,
+		.min_map_buffer_alignment = 64,
+		.uniform_buffer_offset_alignment = 256,
+		.shader_storage_buffer_offset_alignment = 256,
+		.max_array_texture_layers = 2048
+	};
+}
+
+static void GLAPIENTRY null_use_program( GLuint ) {}
+static void GLAPIENTRY null_bind_vertex_array( GLuint ) {}
+static void GLAPIENTRY null_bind_texture_unit( GLuint, GLuint ) {}
+static void GLAPIENTRY null_bind_framebuffer( GLenum, GLuint ) {}
+static void GLAPIENTRY null_viewport( GLint, GLint, GLsizei, GLsizei ) {}
+static void GLAPIENTRY null_capability( GLenum ) {}
+
+static void
+null_set_error_check_mode( Renderer_GL_Error_Check_Mode mode ) {
+	g_renderer.gl_error_checks.mode = mode;
+	g_renderer.gl_error_checks.active = false;
+}
+
+static u32
+null_program_query_uniforms( Renderer_Shader_Program *program ) {
+	return 0;
+}
+
+static void
+null_program_destroy( Renderer_Shader_Program *program ) {}
+
+// Nothing to compile, and without a linker there are no active uniforms to query either.
+static void
+null_program_create( Renderer_Shader_Program *program, ArrayView< Renderer_Shader_Stage * > shader_stages ) {
+	program->opengl_program = null_object_name();
+	ForIt( shader_stages.data, shader_stages.size ) {
+		it->opengl_shader = null_object_name();
+		program->shaders[ it_index ] = it;
+		program->linked_shaders |= renderer_shader_kind_bit( it->kind );
+	}}
+}
+
+static bool
+null_program_set_uniform( Renderer_Shader_Program *program, Renderer_Uniform *uniform, void *value ) {
+	return true;
+}
+
+// Locations stay what they were declared with.
+static GLint
+null_program_uniform_location( Renderer_Shader_Program *program, Renderer_Uniform *uniform ) {
+	return uniform->opengl_location;
+}
+
+static GLuint
+null_renderbuffer_create( StringView_ASCII name, Vector2_u16 dimensions, GLenum opengl_storage_format ) {
+	return null_object_name();
+}
+
+static GLuint
+null_framebuffer_create( StringView_ASCII name ) {
+	return null_object_name();
+}
+
+static void
+null_framebuffer_attach_renderbuffer( Renderer_Framebuffer *framebuffer, GLenum opengl_attachment, Renderer_Renderbuffer *renderbuffer ) {}
+
+static bool
+null_framebuffer_is_complete( Renderer_Framebuffer *framebuffer ) {
+	return true;
+}
+
+static void
+null_framebuffer_set_draw_buffers( Renderer_Framebuffer *framebuffer, ArrayView< GLenum > opengl_color_attachments ) {}
+
+static void
+null_mesh_draw( Geometry_Pool *pool, Mesh *mesh, u32 instance_count, u32 first_instance ) {}
+
+// Frames are a fixed step apart, so runs are reproducible.
+static f32
+null_current_time() {
+	return g_renderer.frame_time.last + RENDERER_NULL_FRAME_TIME_STEP;
+}
+
+// The null backend never allocates from the frame ring buffer, frames are not uploaded anywhere.
+static bool
+null_init() {
+	null_set_constants();
+	g_renderer.device.vendor = "None";
+	g_renderer.device.name = "Null Renderer";
+	return true;
+}
+
+static void
+null_shutdown() {}
+
+static bool
+software_init() {
+	null_set_constants();
+	g_renderer.device.vendor = "None";
+	g_renderer.device.name = "Software Rasterizer";
+	renderer_software_init( &g_renderer.software, sys_allocator );
+	return true;
+}
+
+static void
+software_shutdown() {
+	renderer_software_destroy( &g_renderer.software );
+}
+
+static void
+null_framebuffer_attach_texture( Renderer_Framebuffer *framebuffer, GLenum opengl_attachment, Texture *texture ) {}
+
+static GLuint
+null_texture_2d_create( Texture *texture ) {
+	return null_object_name();
+}
+
+static GLuint
+null_texture_array_create( Vector2_u16 dimensions, u8 mipmap_levels, GLint opengl_storage_format, u32 layers, StringView_ASCII debug_name ) {
+	return null_object_name();
+}
+
+static GLuint
+null_texture_array_layer_view( Texture_Array_Pool *pool, Texture *texture, u32 layer ) {
+	return null_object_name();
+}
+
+static GLuint
+null_texture_array_grow( Texture_Array_Pool *pool, u32 layers_capacity ) {
+	return null_object_name();
+}
+
+static void
+null_texture_array_upload_layer( Texture_Array_Pool *pool, Texture *texture, u32 layer ) {}
+
+// Vertex formats only matter to a vertex array.
+static void
+null_geometry_pool_create( Geometry_Pool *pool ) {
+	pool->opengl_vao = null_object_name();
+	pool->opengl_vbo = null_object_name();
+	pool->opengl_ebo = null_object_name();
+}
+
+static void
+null_geometry_pool_grow_buffer( Geometry_Pool *pool, GLuint *buffer, u64 old_size, u64 new_size ) {
+	*buffer = null_object_name();
+}
+
+static void
+null_mesh_upload( Geometry_Pool *pool, Mesh *mesh ) {}
+
+// The CPU side of drawing a frame: the render queue is batched and recorded commands go through the state cache.
+static void
+null_frame_packet_execute( Renderer_Frame_Packet *packet ) {
+	opengl_state_invalidate( &g_renderer.gl_state );
+	opengl_state_frame_begin( &g_renderer.gl_state );
+
+	g_renderer.draw_stats.proxy_instances_uploaded = packet->dirty_instances.size;
+	build_render_batches( packet );
+	g_renderer.draw_stats.draw_calls += g_renderer.indirect_draws.size;
+	ForIt( packet->command_streams.data, packet->command_streams.size ) {
+		replay_command_stream( it );
+	}}
+}
+
+static const Renderer_Frame_Storage_Buffer *
+frame_packet_storage_buffer( Renderer_Frame_Packet *packet, u32 binding ) {
+	ForIt( packet->storage_buffers, packet->storage_buffers_count ) {
+		if ( it.binding == binding )
+			return &it;
+	}}
+	return NULL;
+}
+
+// Does the null backend's work, then draws the frame on the CPU.
+static void
+software_frame_packet_execute( Renderer_Frame_Packet *packet ) {
+	null_frame_packet_execute( packet );
+	renderer_software_update_instances( &g_renderer.software, packet->instance_capacity, packet->dirty_first_instance, packet->dirty_instances );
+
+	Renderer_Software_Frame frame = {
+		.dimensions = packet->viewport_dimensions,
+		.view_projection = packet->projection * packet->view,
+		.camera_position = packet->camera_position,
+		.ambient_light = packet->ambient_light,
+		.output_channel = packet->settings.output_channel,
+		.render_queue = packet->render_queue,
+		.materials = packet->software_materials,
+		.fallback_diffuse = g_renderer.texture_purple_checkers,
+		.fallback_white = g_renderer.texture_white
+	};
+	const Renderer_Frame_Storage_Buffer *lights = frame_packet_storage_buffer( packet, LIGHTS_STORAGE_BUFFER_BINDING );
+	const Renderer_Frame_Storage_Buffer *light_clusters = frame_packet_storage_buffer( packet, LIGHT_CLUSTERS_STORAGE_BUFFER_BINDING );
+	const Renderer_Frame_Storage_Buffer *light_indices = frame_packet_storage_buffer( packet, LIGHT_INDICES_STORAGE_BUFFER_BINDING );
+	if ( lights ) {
+		frame.lights = ( const u8 * )lights->data;
+		frame.lights_size = lights->size;
+	}
+	if ( light_clusters && light_indices ) {
+		frame.light_clusters = ( const u8 * )light_clusters->data;
+		frame.light_clusters_size = light_clusters->size;
+		frame.light_indices = ( const u8 * )light_indices->data;
+		frame.light_indices_size = light_indices->size;
+	}
+	renderer_software_draw( &g_renderer.software, &frame );
+}
+
+Renderer_Backend_Dispatch
+renderer_backend_null() {
+	return Renderer_Backend_Dispatch {
+		.init = null_init,
+		.shutdown = null_shutdown,
+		// The state cache still runs and counts, its changes just go nowhere.
+		.state = OpenGL_State_Dispatch {
+			.use_program = null_use_program,
+			.bind_vertex_array = null_bind_vertex_array,
+			.bind_texture_unit = null_bind_texture_unit,
+			.bind_framebuffer = null_bind_framebuffer,
+			.viewport = null_viewport,
+			.enable = null_capability,
+			.disable = null_capability
+		},
+		.set_error_check_mode = null_set_error_check_mode,
+		.current_time = null_current_time,
+
+		.program_create = null_program_create,
+		.program_destroy = null_program_destroy,
+		.program_query_uniforms = null_program_query_uniforms,
+		.program_uniform_location = null_program_uniform_location,
+		.program_set_uniform = null_program_set_uniform,
+
+		.renderbuffer_create = null_renderbuffer_create,
+		.framebuffer_create = null_framebuffer_create,
+		.framebuffer_attach_renderbuffer = null_framebuffer_attach_renderbuffer,
+		.framebuffer_attach_texture = null_framebuffer_attach_texture,
+		.framebuffer_is_complete = null_framebuffer_is_complete,
+		.framebuffer_set_draw_buffers = null_framebuffer_set_draw_buffers,
+
+		.texture_2d_create = null_texture_2d_create,
+		.texture_array_create = null_texture_array_create,
+		.texture_array_grow = null_texture_array_grow,
+		.texture_array_upload_layer = null_texture_array_upload_layer,
+		.texture_array_layer_view = null_texture_array_layer_view,
+
+		.geometry_pool_create = null_geometry_pool_create,
+		.geometry_pool_grow_buffer = null_geometry_pool_grow_buffer,
+		.mesh_upload = null_mesh_upload,
+		.mesh_draw = null_mesh_draw,
+
+		.frame_packet_execute = null_frame_packet_execute
+	};
+}
+
+Renderer_Backend_Dispatch
+renderer_backend_software() {
+	Renderer_Backend_Dispatch dispatch = renderer_backend_null();
+	dispatch.init = software_init;
+	dispatch.shutdown = software_shutdown;
+	dispatch.frame_packet_execute = software_frame_packet_execute;
+	return dispatch;
+}
@@ -0,0 +1,1797 @@
+#include "renderer_backend.h"
+#include "renderer_capture.h"
+#include "texture.h"
+
+#include "imgui/imgui.h"
+#include "imgui/imgui_impl_opengl3.h"
+
+#define QL_LOG_CHANNEL "Renderer"
+#include "log.h"
+
+/*
+	The OpenGL backend: everything the renderer does with the GPU, see `Renderer_Backend_Dispatch`.
+	Not part of headless builds, which have no OpenGL context to call into.
+*/
+
+// Uniform buffer binding of `Renderer_Frame_Constants`, declared by every shader that reads them.
+constexpr GLuint RENDERER_FRAME_CONSTANTS_BINDING = 0;
+
+// Shader storage binding of the retained instance data of all render proxies, see `geometry_vertex.glsl`.
+constexpr GLuint RENDERER_INSTANCE_BUFFER_BINDING = 0;
+// Shader storage binding of the per-frame material parameters, see `phong_fragment.glsl`.
+// Bindings 1-3 are the lights, see `LIGHTS_STORAGE_BUFFER_BINDING`.
+constexpr GLuint RENDERER_MATERIALS_BUFFER_BINDING = 4;
+// Shader storage binding of the per-frame indices of visible instances in the sorted order.
+constexpr GLuint RENDERER_INSTANCE_INDICES_BUFFER_BINDING = 5;
+
+// Camera and scene data that is the same for every draw of a frame, as seen by the `Frame_Constants` block (std140).
+// Written once per frame by `renderer_draw_frame()`.
+struct Renderer_Frame_Constants {
+	Matrix4x4_f32 view;                     // World -> View space
+	Matrix4x4_f32 projection;               // View -> Clip space
+	Matrix4x4_f32 view_projection;          // World -> Clip space
+	Matrix4x4_f32 inverse_view;
+	Matrix4x4_f32 inverse_projection;
+	Matrix4x4_f32 inverse_view_projection;
+	Vector4_f32 camera_position;            // xyz: World-space position, w: unused
+	Vector4_f32 ambient;                    // rgb: ambient light color, a: unused
+	f32 time;                               // Seconds since the start
+	f32 delta_time;                         // Seconds since the previous frame
+	Vector2_f32 viewport_size;              // In pixels
+};
+static_assert( offsetof( Renderer_Frame_Constants, view ) == 0, "Renderer_Frame_Constants must match std140 layout" );
+static_assert( offsetof( Renderer_Frame_Constants, projection ) == 64, "Renderer_Frame_Constants must match std140 layout" );
+static_assert( offsetof( Renderer_Frame_Constants, view_projection ) == 128, "Renderer_Frame_Constants must match std140 layout" );
+static_assert( offsetof( Renderer_Frame_Constants, inverse_view ) == 192, "Renderer_Frame_Constants must match std140 layout" );
+static_assert( offsetof( Renderer_Frame_Constants, inverse_projection ) == 256, "Renderer_Frame_Constants must match std140 layout" );
+static_assert( offsetof( Renderer_Frame_Constants, inverse_view_projection ) == 320, "Renderer_Frame_Constants must match std140 layout" );
+static_assert( offsetof( Renderer_Frame_Constants, camera_position ) == 384, "Renderer_Frame_Constants must match std140 layout" );
+static_assert( offsetof( Renderer_Frame_Constants, ambient ) == 400, "Renderer_Frame_Constants must match std140 layout" );
+static_assert( offsetof( Renderer_Frame_Constants, time ) == 416, "Renderer_Frame_Constants must match std140 layout" );
+static_assert( offsetof( Renderer_Frame_Constants, delta_time ) == 420, "Renderer_Frame_Constants must match std140 layout" );
+static_assert( offsetof( Renderer_Frame_Constants, viewport_size ) == 424, "Renderer_Frame_Constants must match std140 layout" );
+static_assert( sizeof( Renderer_Frame_Constants ) == 432, "Renderer_Frame_Constants must match std140 layout" );
+
+// `glGetError` based checks are compiled into Debug builds only.
+// Whether they actually run is decided at runtime, see `Renderer_GL_Error_Check_Mode`.
+#ifdef QLIGHT_DEBUG
+#define QLIGHT_OPENGL_ERROR_CHECKS
+#endif
+
+#ifdef QLIGHT_OPENGL_ERROR_CHECKS
+#define GL_CHECK( expression )  \
+	do {  \
+		bool gl_check_active = g_renderer.gl_error_checks.active;  \
+		if ( gl_check_active )  opengl_error_clear();  \
+		expression;  \
+		if ( gl_check_active )  opengl_error_log( #expression, __FILE__, __LINE__ );  \
+	} while ( 0 )
+
+#define GL_CHECK_AND_STORE_RESULT( result_pointer, expression )  \
+	do {  \
+		bool gl_check_active = g_renderer.gl_error_checks.active;  \
+		if ( gl_check_active )  opengl_error_clear();  \
+		expression;  \
+		if ( gl_check_active )  *result_pointer = opengl_error_log( #expression, __FILE__, __LINE__ );  \
+	} while ( 0 )
+
+#define GL_ASSERT( expression )  \
+	do {  \
+		bool gl_check_active = g_renderer.gl_error_checks.active;  \
+		if ( gl_check_active )  opengl_error_clear();  \
+		expression;  \
+		if ( gl_check_active ) {  \
+			bool gl_call_generated_no_error = opengl_error_log( #expression, __FILE__, __LINE__ );  \
+			AssertMessage( gl_call_generated_no_error, #expression );  \
+		}  \
+	} while ( 0 )
+
+#else /* QLIGHT_OPENGL_ERROR_CHECKS */
+#define GL_CHECK( expression )  expression
+#define GL_CHECK_AND_STORE_RESULT( result_pointer, expression )  expression
+#define GL_ASSERT( expression )  expression
+#endif
+
+#define log_gl( log_level, ... )  log( log_level, QL_LOG_CHANNEL "/GL", __VA_ARGS__ )
+#define log_error_gl( ... )  log_gl( LogLevel_Error, __VA_ARGS__ )
+#define log_warning_gl( ... )  log_gl( LogLevel_Warning, __VA_ARGS__ )
+#ifdef QLIGHT_DEBUG
+#define log_debug_gl( ... )  log_gl( LogLevel_Debug, __VA_ARGS__ )
+#else
+#define log_debug_gl( ... )
+#endif
+
+static void
+opengl_error_clear() {
+    while ( glGetError() != GL_NO_ERROR ); // or !glGetError()
+}
+
+static bool
+opengl_error_log( const char *function, const char *file, int line ) {
+    while ( GLenum error = glGetError() ) {
+		log_error_gl( "OpenGL Error #%u generated at:\n%s:%d: %s",
+			error,
+			file,
+			line,
+			function
+		);
+        return false;
+    }
+    return true;
+}
+
+enum OpenGL_Object_Type : u32 {
+	OpenGL_Shader = GL_SHADER,
+	OpenGL_Program = GL_PROGRAM,
+	OpenGL_ProgramPipeline = GL_PROGRAM_PIPELINE
+};
+
+static StringView_ASCII
+opengl_get_info_log( OpenGL_Object_Type object, GLuint id ) {
+	GLint log_length;
+	// string_clear( g_renderer.opengl_info_log );
+
+	switch ( object ) {
+		case OpenGL_Shader:
+			glGetShaderiv( id, GL_INFO_LOG_LENGTH, &log_length );
+			glGetShaderInfoLog( id, log_length, &log_length, g_renderer.opengl_info_log.data );
+			break;
+		case OpenGL_Program:
+			glGetProgramiv( id, GL_INFO_LOG_LENGTH, &log_length );
+			glGetProgramInfoLog( id, log_length, &log_length, g_renderer.opengl_info_log.data );
+			break;
+		case OpenGL_ProgramPipeline:
+			glGetProgramPipelineiv( id, GL_INFO_LOG_LENGTH, &log_length );
+			glGetProgramPipelineInfoLog( id, log_length, &log_length, g_renderer.opengl_info_log.data );
+			break;
+		default:
+			return string_view( ( const char * )NULL );
+	}
+
+	g_renderer.opengl_info_log.size = log_length;
+
+	return string_view( &g_renderer.opengl_info_log );
+}
+
+static void
+opengl_generate_and_bind_vertex_array( GLuint *id, StringView_ASCII debug_name ) {
+	glGenVertexArrays( 1, id );
+	opengl_state_bind_vertex_array( &g_renderer.gl_state, *id );
+#ifdef QLIGHT_DEBUG
+	if ( debug_name.size > 0 )
+		glObjectLabel( GL_VERTEX_ARRAY, *id, debug_name.size, debug_name.data );
+#endif
+	log_debug_gl( "Generated and bound VAO '" StringViewFormat "' (gl_id: %u).",
+		StringViewArgument( debug_name ),
+		*id
+	);
+}
+
+static void
+opengl_create_vertex_array( GLuint *id, StringView_ASCII debug_name ) {
+	glCreateVertexArrays( 1, id );
+#ifdef QLIGHT_DEBUG
+	if ( debug_name.size > 0 )
+		glObjectLabel( GL_VERTEX_ARRAY, *id, debug_name.size, debug_name.data );
+#endif
+	log_debug_gl( "Created and bound VAO '" StringViewFormat "' (gl_id: %u).",
+		StringViewArgument( debug_name ),
+		*id
+	);
+}
+
+static void
+opengl_generate_and_bind_vertex_buffer( GLuint *id, StringView_ASCII debug_name ) {
+	glGenBuffers( 1, id );
+	glBindBuffer( GL_ARRAY_BUFFER, *id );
+#ifdef QLIGHT_DEBUG
+	if ( debug_name.size > 0 )
+		glObjectLabel( GL_BUFFER, *id, debug_name.size, debug_name.data );
+#endif
+	log_debug_gl( "Generated and bound VBO '" StringViewFormat "' (gl_id: %u).",
+		StringViewArgument( debug_name ),
+		*id
+	);
+}
+
+static void
+opengl_create_vertex_buffer( GLuint *id, StringView_ASCII debug_name ) {
+	glCreateBuffers( 1, id );
+#ifdef QLIGHT_DEBUG
+	if ( debug_name.size > 0 )
+		glObjectLabel( GL_BUFFER, *id, debug_name.size, debug_name.data );
+#endif
+	log_debug_gl( "Created and bound VBO '" StringViewFormat "' (gl_id: %u).",
+		StringViewArgument( debug_name ),
+		*id
+	);
+}
+
+static void
+opengl_generate_and_bind_element_buffer( GLuint *id, StringView_ASCII debug_name ) {
+	glGenBuffers( 1, id );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, *id );
+#ifdef QLIGHT_DEBUG
+	if ( debug_name.size > 0 )
+		glObjectLabel( GL_BUFFER, *id, debug_name.size, debug_name.data );
+#endif
+	log_debug_gl( "Generated and bound EBO '" StringViewFormat "' (gl_id: %u).",
+		StringViewArgument( debug_name ),
+		*id
+	);
+}
+
+static void
+opengl_create_element_buffer( GLuint *id, StringView_ASCII debug_name ) {
+	glCreateBuffers( 1, id );
+#ifdef QLIGHT_DEBUG
+	if ( debug_name.size > 0 )
+		glObjectLabel( GL_BUFFER, *id, debug_name.size, debug_name.data );
+#endif
+	log_debug_gl( "Created and bound EBO '" StringViewFormat "' (gl_id: %u).",
+		StringViewArgument( debug_name ),
+		*id
+	);
+}
+
+static GLenum
+index_type_size_to_opengl( u32 size ) {
+	switch ( size ) {
+		case 1: return GL_UNSIGNED_BYTE;
+		case 2: return GL_UNSIGNED_SHORT;
+		case 4: return GL_UNSIGNED_INT;
+		default: return 0;
+	}
+}
+
+static void
+draw_fullscreen_quad() {
+	Mesh *mesh = mesh_instance( g_renderer.fullscreen_quad );
+	Geometry_Pool *pool = &g_renderer.geometry_pools.data[ mesh->geometry_pool_id ];
+	opengl_state_bind_vertex_array( &g_renderer.gl_state, pool->opengl_vao );
+	GLenum index_type = index_type_size_to_opengl( pool->index_size );
+	if ( renderer_capture_active() )
+		renderer_capture_draw_elements( GL_TRIANGLES, mesh->indices.size, index_type, ( u64 )mesh->first_index * pool->index_size, 1, ( GLint )mesh->base_vertex, 0 );
+	glDrawElementsBaseVertex(
+		/*       mode */ GL_TRIANGLES,
+		/*      count */ mesh->indices.size,
+		/*       type */ index_type,
+		/*    indices */ ( void * )( ( u64 )mesh->first_index * pool->index_size ),
+		/* basevertex */ ( GLint )mesh->base_vertex
+	);
+}
+
+static StringView_ASCII
+opengl_debug_message_source_name( GLenum source ) {
+	switch ( source ) {
+		case GL_DEBUG_SOURCE_API:              return "API";
+		case GL_DEBUG_SOURCE_WINDOW_SYSTEM:    return "Window System";
+		case GL_DEBUG_SOURCE_SHADER_COMPILER:  return "Shader Compiler";
+		case GL_DEBUG_SOURCE_THIRD_PARTY:      return "Third Party";
+		case GL_DEBUG_SOURCE_APPLICATION:      return "Application";
+
+		case GL_DEBUG_SOURCE_OTHER:
+		default:                               return "Other";
+	}
+}
+
+static StringView_ASCII
+opengl_debug_message_type_name( GLenum type ) {
+	switch ( type ) {
+		case GL_DEBUG_TYPE_ERROR:                return "Error";
+		case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:  return "Deprecated";
+		case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:   return "Undefined";
+		case GL_DEBUG_TYPE_PORTABILITY:          return "Portability";
+		case GL_DEBUG_TYPE_PERFORMANCE:          return "Performance";
+		case GL_DEBUG_TYPE_MARKER:               return "Marker";
+		case GL_DEBUG_TYPE_PUSH_GROUP:           return "Push Group";
+		case GL_DEBUG_TYPE_POP_GROUP:            return "Pop Group";
+
+		case GL_DEBUG_TYPE_OTHER:
+		default:                                 return "Other";
+	}
+}
+
+static StringView_ASCII
+opengl_debug_message_severity_name( GLenum severity ) {
+	switch ( severity ) {
+		case GL_DEBUG_SEVERITY_HIGH:          return "High";
+		case GL_DEBUG_SEVERITY_MEDIUM:        return "Medium";
+		case GL_DEBUG_SEVERITY_LOW:           return "Low";
+		case GL_DEBUG_SEVERITY_NOTIFICATION:  return "Info";
+
+		default:                              return "(Unknown)";
+	}
+}
+
+static void
+opengl_debug_message_callback(
+	GLenum source,
+	GLenum type,
+	GLuint id,
+	GLenum severity,
+	GLsizei length,
+	const GLchar *message,
+	const void *user_parameter
+) {
+	StringView_ASCII msg = string_view( message, /* offset */ 0, /* length */ length );
+	StringView_ASCII source_name = opengl_debug_message_source_name( source );
+	StringView_ASCII type_name = opengl_debug_message_type_name( type );
+	StringView_ASCII severity_name = opengl_debug_message_severity_name( severity );
+	Log_Level log_level;
+	switch ( severity ) {
+		case GL_DEBUG_SEVERITY_HIGH:          log_level = LogLevel_Error; break;
+
+		case GL_DEBUG_SEVERITY_MEDIUM:
+		case GL_DEBUG_SEVERITY_LOW:           log_level = LogLevel_Warning; break;
+
+		case GL_DEBUG_SEVERITY_NOTIFICATION:
+		default:                              log_level = LogLevel_Debug; break;
+	}
+	// The function itself is called only with the OpenGL debug output set up,
+	// no need to wrap with `QLIGHT_DEBUG`.
+	log_gl(
+		log_level,
+		StringViewFormat "::" StringViewFormat " (#%d, " StringViewFormat "): " StringViewFormat,
+		StringViewArgument( source_name ),
+		StringViewArgument( type_name ),
+		id,
+		StringViewArgument( severity_name ),
+		StringViewArgument( msg )
+	);
+}
+
+inline static u32
+opengl_query_constant_as_u32( GLint constant, GLint *out_gl_result ) {
+	glGetIntegerv( constant, out_gl_result );
+	return ( u32 ) *out_gl_result;
+}
+
+static void
+opengl_query_constants() {
+	GL_Constants *gl = &g_renderer.gl_constants;
+	GLint gl_result;
+
+	gl->max_color_attachments       = opengl_query_constant_as_u32( GL_MAX_COLOR_ATTACHMENTS, &gl_result );
+	gl->max_uniform_block_size      = opengl_query_constant_as_u32( GL_MAX_UNIFORM_BLOCK_SIZE, &gl_result );
+	gl->max_uniform_locations       = opengl_query_constant_as_u32( GL_MAX_UNIFORM_LOCATIONS, &gl_result );
+	gl->max_uniform_buffer_bindings = opengl_query_constant_as_u32( GL_MAX_UNIFORM_BUFFER_BINDINGS, &gl_result );
+	gl->min_map_buffer_alignment    = opengl_query_constant_as_u32( GL_MIN_MAP_BUFFER_ALIGNMENT, &gl_result );
+	gl->uniform_buffer_offset_alignment        = opengl_query_constant_as_u32( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &gl_result );
+	gl->shader_storage_buffer_offset_alignment = opengl_query_constant_as_u32( GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &gl_result );
+	gl->max_array_texture_layers    = opengl_query_constant_as_u32( GL_MAX_ARRAY_TEXTURE_LAYERS, &gl_result );
+}
+
+static void
+opengl_error_checks_frame_begin() {
+	GL_Error_Checks *checks = &g_renderer.gl_error_checks;
+	checks->frame_idx += 1;
+	if ( checks->mode != RendererGLErrorCheckMode_Sampled ) {
+		checks->active = false;
+		return;
+	}
+
+#ifdef QLIGHT_OPENGL_ERROR_CHECKS
+	bool interval_hit = ( checks->sample_interval > 0 ) && ( checks->frame_idx % checks->sample_interval == 0 );
+	checks->active = checks->requested || interval_hit;
+	checks->requested = false;
+	if ( checks->active ) {
+		// Errors generated by unchecked calls since the last sampled frame are still queued,
+		//   report them instead of letting the first checked call silently clear them.
+		opengl_error_log( "(unchecked calls before this frame)", __FILE__, __LINE__ );
+	}
+#endif
+}
+
+static void
+opengl_error_checks_set_mode( Renderer_GL_Error_Check_Mode mode ) {
+	GL_Error_Checks *checks = &g_renderer.gl_error_checks;
+	checks->mode = mode;
+
+	if ( mode == RendererGLErrorCheckMode_DebugCallback ) {
+		glEnable( GL_DEBUG_OUTPUT );
+		// Let the driver report asynchronously instead of stalling on every call.
+		glDisable( GL_DEBUG_OUTPUT_SYNCHRONOUS );
+	} else {
+		glDisable( GL_DEBUG_OUTPUT );
+	}
+
+#ifdef QLIGHT_OPENGL_ERROR_CHECKS
+	// Keep checking until the next frame begins, so everything set up in between is covered too.
+	checks->active = ( mode == RendererGLErrorCheckMode_Sampled );
+#else
+	checks->active = false;
+	if ( mode == RendererGLErrorCheckMode_Sampled )
+		log_warning_gl( "Sampled OpenGL error checks are compiled out of this build." );
+#endif
+}
+
+static GLuint
+opengl_compile_shader_stage( Renderer_Shader_Stage *stage ) {
+	GLuint shader_type = renderer_shader_kind_to_opengl( stage->kind );
+	StringView_ASCII shader_kind = renderer_shader_kind_name( stage->kind );
+	log_debug_gl( "Compiling '" StringViewFormat "' " StringViewFormat " stage shader...",
+		StringViewArgument( stage->name ),
+		StringViewArgument( shader_kind )
+	);
+
+	GLuint shader_id = glCreateShader( shader_type );
+	const GLchar *sources[] = { stage->source_code.data };
+	const GLint lengths[] = { ( GLint )stage->source_code.size };
+	glShaderSource( shader_id, 1, sources, lengths );
+
+	GLint compile_result;
+	glCompileShader( shader_id );
+	glGetShaderiv( shader_id, GL_COMPILE_STATUS, &compile_result );
+	if ( compile_result != GL_TRUE ) {
+		StringView_ASCII info_log = opengl_get_info_log( OpenGL_Shader, shader_id );
+
+		log_error_gl( "Failed to compile '" StringViewFormat "' " StringViewFormat " stage shader! Error log:\n" StringViewFormat,
+			StringViewArgument( stage->name ),
+			StringViewArgument( shader_kind ),
+			StringViewArgument( info_log )
+		);
+
+		// No need to delete it now, it will be deleted later
+		//   in `renderer_create_and_compile_shader_program`
+		//   whether it compiled successfully or not.
+	} else {
+		log_debug_gl( "Compiled '" StringViewFormat "' " StringViewFormat" shader stage.",
+			StringViewArgument( stage->name ),
+			StringViewArgument( shader_kind )
+		);
+	}
+
+	return shader_id;
+}
+
+static Renderer_Data_Type
+opengl_uniform_type_to_renderer_data_type( GLenum opengl_type ) {
+	switch ( opengl_type ) {
+		// Samplers are set with the texture unit index.
+		case GL_SAMPLER_1D:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_2D_ARRAY_SHADOW:
+		case GL_SAMPLER_CUBE_SHADOW:
+		case GL_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_SAMPLER_BUFFER:
+		case GL_INT_SAMPLER_2D:
+		case GL_UNSIGNED_INT_SAMPLER_2D:
+		case GL_BOOL:
+		case GL_INT:             return RendererDataType_s32;
+		case GL_UNSIGNED_INT:    return RendererDataType_u32;
+		case GL_FLOAT:           return RendererDataType_f32;
+		case GL_FLOAT_VEC2:      return RendererDataType_Vector2_f32;
+		case GL_FLOAT_VEC3:      return RendererDataType_Vector3_f32;
+		case GL_FLOAT_VEC4:      return RendererDataType_Vector4_f32;
+		case GL_FLOAT_MAT3:      return RendererDataType_Matrix3x3_f32;
+		case GL_FLOAT_MAT4:      return RendererDataType_Matrix4x4_f32;
+
+		default: return RendererDataType_COUNT;
+	}
+}
+
+static u32
+opengl_program_query_uniforms( Renderer_Shader_Program *program ) {
+	GLint active_uniforms = 0;
+	GLint max_name_length = 0;
+	glGetProgramiv( program->opengl_program, GL_ACTIVE_UNIFORMS, &active_uniforms );
+	glGetProgramiv( program->opengl_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length );
+	if ( active_uniforms < 1 )
+		return 0;
+
+	String_ASCII name_buffer = string_new( sys_allocator, ( u32 )max_name_length );
+	u32 added = 0;
+	for ( GLint uniform_idx = 0; uniform_idx < active_uniforms; uniform_idx += 1 ) {
+		GLsizei name_length = 0;
+		GLint elements = 0;
+		GLenum opengl_type = GL_NONE;
+		glGetActiveUniform(
+			/*  program */ program->opengl_program,
+			/*    index */ ( GLuint )uniform_idx,
+			/* buf_size */ max_name_length,
+			/*   length */ &name_length,
+			/*     size */ &elements,
+			/*     type */ &opengl_type,
+			/*     name */ name_buffer.data
+		);
+		// Arrays are reported as their first element, they are registered by the base name and set whole.
+		if ( name_length > 3 && memcmp( name_buffer.data + name_length - 3, "[0]", 3 ) == 0 ) {
+			name_length -= 3;
+			name_buffer.data[ name_length ] = '\0';
+		}
+		StringView_ASCII name = StringView_ASCII( ( u32 )name_length, name_buffer.data );
+
+		// Uniform block members are active uniforms too, but they do not have a location.
+		GLint location = glGetUniformLocation( program->opengl_program, name_buffer.data );
+		if ( location == -1 )
+			continue;
+
+		if ( renderer_shader_program_find_uniform( program, name ) != INVALID_UNIFORM_ID )
+			continue;
+
+		Renderer_Data_Type data_type = opengl_uniform_type_to_renderer_data_type( opengl_type );
+		if ( data_type == RendererDataType_COUNT ) {
+			log_warning_gl( "Uniform '" StringViewFormat "' of '" StringViewFormat "' shader program has unsupported type 0x%X. Skipping.",
+				StringViewArgument( name ),
+				StringViewArgument( program->name ),
+				opengl_type
+			);
+			continue;
+		}
+
+		Assert( program->uniforms.size < INVALID_UNIFORM_ID );
+		if ( program->uniforms.size >= INVALID_UNIFORM_ID )
+			break;
+
+		// Names have to outlive the buffer and stay null-terminated for `glGetUniformLocation`.
+		char *name_data = Allocate( sys_allocator, name_length + 1, char );
+		memcpy( name_data, name_buffer.data, name_length );
+		name_data[ name_length ] = '\0';
+
+		array_add( &program->uniforms, Renderer_Uniform {
+			.name = StringView_ASCII( ( u32 )name_length, name_data ),
+			.data_type = data_type,
+			.bits = RendererUniformBit_OwnsName,
+			.elements = ( u32 )elements,
+			.opengl_location = location
+		} );
+		added += 1;
+	}
+	string_free( &name_buffer );
+
+	log_debug( "Queried %u active uniforms of '" StringViewFormat "' shader program.",
+		added,
+		StringViewArgument( program->name )
+	);
+	return added;
+}
+
+// Binds every texture array pool to the texture unit of the same index.
+static void
+geometry_pass_use_texture_array_pools() {
+	ForIt( g_renderer.texture_array_pools.data, g_renderer.texture_array_pools.size ) {
+		opengl_state_bind_texture_unit( &g_renderer.gl_state, it_index, it.opengl_texture );
+	}}
+}
+
+static void
+geometry_pass_draw_indirect( Renderer_Indirect_Draw *draw ) {
+	Geometry_Pool *pool = &g_renderer.geometry_pools.data[ draw->geometry_pool_id ];
+	opengl_state_bind_vertex_array( &g_renderer.gl_state, pool->opengl_vao );
+	GLenum index_type = index_type_size_to_opengl( pool->index_size );
+	u64 commands_offset = g_renderer.indirect_allocation.offset + ( u64 )draw->first_command * sizeof( Renderer_Draw_Elements_Indirect_Command );
+	if ( renderer_capture_active() )
+		renderer_capture_multi_draw_elements_indirect( GL_TRIANGLES, index_type, commands_offset, draw->command_count, 0 );
+	glMultiDrawElementsIndirect(
+		/*      mode */ GL_TRIANGLES,
+		/*      type */ index_type,
+		/*  indirect */ ( const void * )commands_offset,
+		/* drawcount */ draw->command_count,
+		/*    stride */ 0  // Tightly packed
+	);
+	g_renderer.draw_stats.draw_calls += 1;
+}
+
+static void
+draw_pass_geometry() {
+	opengl_state_set_capability( &g_renderer.gl_state, OpenGLStateCapability_DepthTest, true );
+
+	renderer_bind_framebuffer( g_renderer.gbuffer.framebuffer );
+	Renderer_Framebuffer *geometry_framebuffer = renderer_framebuffer_instance( g_renderer.gbuffer.framebuffer );
+	Vector2_u16 dimensions = g_renderer.gbuffer.dimensions;
+	opengl_state_viewport( &g_renderer.gl_state, 0, 0, ( GLsizei )dimensions.width, ( GLsizei )dimensions.height );
+
+	// Clear Geometry framebuffer Position attachment texture
+	if ( renderer_capture_active() )
+		renderer_capture_clear_framebuffer_fv( geometry_framebuffer->opengl_framebuffer, GL_COLOR, 0, &g_renderer.clear_color.x );
+	glClearNamedFramebufferfv(
+		/* framebuffer */ geometry_framebuffer->opengl_framebuffer,
+		/*      buffer */ GL_COLOR,
+		/*  drawbuffer */ 0,  // Attachment  index
+		/*       value */ &g_renderer.clear_color.x
+	);
+
+	// Clear Geometry framebuffer Normal Map attachment texture
+	if ( renderer_capture_active() )
+		renderer_capture_clear_framebuffer_fv( geometry_framebuffer->opengl_framebuffer, GL_COLOR, 1, &g_renderer.clear_color.x );
+	glClearNamedFramebufferfv(
+		/* framebuffer */ geometry_framebuffer->opengl_framebuffer,
+		/*      buffer */ GL_COLOR,
+		/*  drawbuffer */ 1,  // Attachment  index
+		/*       value */ &g_renderer.clear_color.x
+	);
+
+	// Clear Geometry framebuffer Color/Specular attachment texture
+	if ( renderer_capture_active() )
+		renderer_capture_clear_framebuffer_fv( geometry_framebuffer->opengl_framebuffer, GL_COLOR, 2, &g_renderer.clear_color.x );
+	glClearNamedFramebufferfv(
+		/* framebuffer */ geometry_framebuffer->opengl_framebuffer,
+		/*      buffer */ GL_COLOR,
+		/*  drawbuffer */ 2,  // Attachment  index
+		/*       value */ &g_renderer.clear_color.x
+	);
+
+	// Clear Geometry framebuffer Material attachment texture, so the lighting pass knows nothing was drawn there
+	GLuint clear_material_id[ 4 ] = { INVALID_MATERIAL_ID, 0, 0, 0 };
+	if ( renderer_capture_active() )
+		renderer_capture_clear_framebuffer_uiv( geometry_framebuffer->opengl_framebuffer, GL_COLOR, 3, clear_material_id );
+	glClearNamedFramebufferuiv(
+		/* framebuffer */ geometry_framebuffer->opengl_framebuffer,
+		/*      buffer */ GL_COLOR,
+		/*  drawbuffer */ 3,  // Attachment  index
+		/*       value */ clear_material_id
+	);
+
+	// Clear Geometry framebuffer's deapth-stencil attachment renderbuffer
+	if ( renderer_capture_active() )
+		renderer_capture_clear_framebuffer_fi( geometry_framebuffer->opengl_framebuffer, GL_DEPTH_STENCIL, 0, 1.0f, 0 );
+	glClearNamedFramebufferfi(
+		/* framebuffer */ geometry_framebuffer->opengl_framebuffer,
+		/*      buffer */ GL_DEPTH_STENCIL,
+		/*  drawbuffer */ 0,  // Must be 0 in this case.
+		/*       depth */ 1.0f,  // In the range of [0, 1]: 0.0 - near plane; 1.0 - far plane. So, default is the farthest one.
+		/*     stencil */ 0  // Neutral value
+	);
+
+	if ( g_renderer.indirect_draws.size < 1 )
+		return;
+
+	renderer_bind_shader_program( g_renderer.gbuffer.shader_program );
+	if ( renderer_capture_active() )
+		renderer_capture_bind_buffer_range( GL_SHADER_STORAGE_BUFFER, RENDERER_INSTANCE_BUFFER_BINDING, g_renderer.proxy_instance_buffer, 0, 0 );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, RENDERER_INSTANCE_BUFFER_BINDING, g_renderer.proxy_instance_buffer );
+	renderer_frame_allocation_bind_shader_storage_buffer( &g_renderer.instance_indices_allocation, RENDERER_INSTANCE_INDICES_BUFFER_BINDING );
+	if ( renderer_capture_active() )
+		renderer_capture_bind_buffer( GL_DRAW_INDIRECT_BUFFER, g_renderer.indirect_allocation.opengl_buffer );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, g_renderer.indirect_allocation.opengl_buffer );
+
+	// Materials are looked up by the shader, so only geometry pools switch between draws.
+	geometry_pass_use_texture_array_pools();
+	ForIt( g_renderer.indirect_draws.data, g_renderer.indirect_draws.size ) {
+		geometry_pass_draw_indirect( &it );
+	}}
+}
+
+static void lighting_pass_use_gbuffer_textures( Renderer_Shader_Program *lighting_shader ) {
+
+	/* G-Buffer Position texture */
+
+	s32 texture_position_index = 0; // make configurable
+	renderer_shader_program_set_uniform(
+		lighting_shader,
+		"gbuffer_position",
+		RendererDataType_s32,
+		&texture_position_index
+	);
+	Texture_ID gbuffer_texture_position = g_renderer.gbuffer.texture_position;
+	Texture_ID texture_position_id = ( gbuffer_texture_position != INVALID_TEXTURE_ID ) ? gbuffer_texture_position : g_renderer.texture_black;
+	renderer_bind_texture( texture_position_index, texture_position_id );
+
+	/* G-Buffer Normal texture */
+
+	s32 texture_normal_index = 1; // make configurable
+	renderer_shader_program_set_uniform(
+		lighting_shader,
+		"gbuffer_normal",
+		RendererDataType_s32,
+		&texture_normal_index
+	);
+	Texture_ID gbuffer_texture_normal = g_renderer.gbuffer.texture_normal;
+	Texture_ID texture_normal_id = ( gbuffer_texture_normal != INVALID_TEXTURE_ID ) ? gbuffer_texture_normal : g_renderer.texture_black;
+	renderer_bind_texture( texture_normal_index, texture_normal_id );
+
+	/* G-Buffer Diffuse/Specular texture */
+
+	s32 texture_diffuse_specular_index = 2; // make configurable
+	renderer_shader_program_set_uniform(
+		lighting_shader,
+		"gbuffer_diffuse_specular",
+		RendererDataType_s32,
+		&texture_diffuse_specular_index
+	);
+	Texture_ID gbuffer_texture_diffuse_specular = g_renderer.gbuffer.texture_color_specular;
+	Texture_ID texture_diffuse_specular_id = ( gbuffer_texture_diffuse_specular != INVALID_TEXTURE_ID ) ? gbuffer_texture_diffuse_specular : g_renderer.texture_black;
+	renderer_bind_texture( texture_diffuse_specular_index, texture_diffuse_specular_id );
+
+	/* G-Buffer Material texture */
+
+	s32 texture_material_index = 3; // make configurable
+	renderer_shader_program_set_uniform(
+		lighting_shader,
+		"gbuffer_material",
+		RendererDataType_s32,
+		&texture_material_index
+	);
+	renderer_bind_texture( texture_material_index, g_renderer.gbuffer.texture_material );
+}
+
+static void
+draw_pass_lighting( Renderer_Frame_Packet *packet ) {
+	opengl_state_set_capability( &g_renderer.gl_state, OpenGLStateCapability_DepthTest, false );
+
+	// Fullscreen Quad is in clockwise winding order, it will not be culled.
+	// glDisable( GL_CULL_FACE );
+
+	renderer_bind_framebuffer( 0 ); // Default framebuffer
+	Renderer_Framebuffer *default_framebuffer = renderer_framebuffer_instance( 0 );
+	Vector2_u16 dimensions = packet->viewport_dimensions;
+	opengl_state_viewport( &g_renderer.gl_state, 0, 0, ( GLsizei )dimensions.width, ( GLsizei )dimensions.height );
+
+	// Clear Backbuffer framebuffer color attachment texture
+	if ( renderer_capture_active() )
+		renderer_capture_clear_framebuffer_fv( default_framebuffer->opengl_framebuffer, GL_COLOR, 0, &g_renderer.clear_color.x );
+	glClearNamedFramebufferfv(
+		/* framebuffer */ default_framebuffer->opengl_framebuffer,
+		/*      buffer */ GL_COLOR,
+		/*  drawbuffer */ 0,  // Attachment  index
+		/*       value */ &g_renderer.clear_color.x
+	);
+
+	Renderer_Shader_Program *lighting_shader = g_renderer.lighting_program;
+	if ( !lighting_shader || !g_renderer.material_allocation.data )
+		return;
+
+	// One fullscreen pass for all materials: the cost does not depend on how many of them are visible.
+	renderer_bind_shader_program( lighting_shader );
+	// Camera position and ambient light come from the `Frame_Constants` block,
+	//   material parameters are bound by `upload_material_parameters()`.
+	// Lights and their clusters are storage buffers filled by `maps_update_lights_manager()` every frame.
+	lighting_pass_use_gbuffer_textures( lighting_shader );
+	draw_fullscreen_quad();
+}
+
+// Draws the submitted command streams on top of the lit image.  There is no depth buffer to test against.
+static void
+draw_pass_recorded_commands( Renderer_Frame_Packet *packet ) {
+	if ( packet->command_streams.size < 1 )
+		return;
+
+	renderer_bind_framebuffer( 0 );
+	ForIt( packet->command_streams.data, packet->command_streams.size ) {
+		replay_command_stream( it );
+	}}
+}
+
+static void
+post_processing_pass_draw() {
+
+}
+
+// ImGui's backend sets up and restores its own state, past the state cache.
+static void
+ui_pass_draw( Renderer_Frame_Packet *packet ) {
+	if ( !packet->ui_draw_data )
+		return;
+
+	renderer_bind_framebuffer( 0 );
+	ImGui_ImplOpenGL3_RenderDrawData( packet->ui_draw_data );
+}
+
+static GLuint
+opengl_create_proxy_instance_buffer( u32 capacity ) {
+	GLuint buffer;
+	glCreateBuffers( 1, &buffer );
+#ifdef QLIGHT_DEBUG
+	StringView_ASCII debug_name = "proxy_instances";
+	glObjectLabel( GL_BUFFER, buffer, debug_name.size, debug_name.data );
+#endif
+	// Changed instances are written with `glNamedBufferSubData`, so the storage has to be dynamic.
+	glNamedBufferStorage( buffer, ( GLsizeiptr )capacity * sizeof( Renderer_Instance_Data ), NULL, GL_DYNAMIC_STORAGE_BIT );
+	return buffer;
+}
+
+// Writes the instance data that changed or moved, re-creating the buffer first if the packet asks for another capacity.
+static void
+upload_render_proxies( Renderer_Frame_Packet *packet ) {
+	if ( packet->instance_capacity != g_renderer.proxy_instance_buffer_capacity || g_renderer.proxy_instance_buffer == 0 ) {
+		// Nothing worth copying over: the packet carries all instances then.
+		if ( g_renderer.proxy_instance_buffer != 0 )
+			glDeleteBuffers( 1, &g_renderer.proxy_instance_buffer );
+		g_renderer.proxy_instance_buffer = opengl_create_proxy_instance_buffer( packet->instance_capacity );
+		log_debug( "Grown proxy instance buffer from %u to %u instances (gl_id: %u).", g_renderer.proxy_instance_buffer_capacity, packet->instance_capacity, g_renderer.proxy_instance_buffer );
+		g_renderer.proxy_instance_buffer_capacity = packet->instance_capacity;
+	}
+
+	g_renderer.draw_stats.proxy_instances_uploaded = packet->dirty_instances.size;
+	if ( packet->dirty_instances.size > 0 ) {
+		if ( renderer_capture_active() ) {
+			renderer_capture_buffer_sub_data(
+				g_renderer.proxy_instance_buffer,
+				( GLintptr )packet->dirty_first_instance * sizeof( Renderer_Instance_Data ),
+				( GLsizeiptr )packet->dirty_instances.size * sizeof( Renderer_Instance_Data ),
+				packet->dirty_instances.data
+			);
+		}
+		glNamedBufferSubData(
+			/* buffer */ g_renderer.proxy_instance_buffer,
+			/* offset */ ( GLintptr )packet->dirty_first_instance * sizeof( Renderer_Instance_Data ),
+			/*   size */ ( GLsizeiptr )packet->dirty_instances.size * sizeof( Renderer_Instance_Data ),
+			/*   data */ packet->dirty_instances.data
+		);
+	}
+}
+
+// Records what was written into the allocation's mapped memory, if a capture is being recorded.
+static void
+capture_frame_allocation( Renderer_Frame_Allocation *allocation ) {
+	if ( renderer_capture_active() )
+		renderer_capture_mapped_write( allocation->opengl_buffer, allocation->offset, allocation->size, allocation->data );
+}
+
+// Writes the `Frame_Constants` block and binds it for the whole frame.
+static void
+upload_frame_constants( Renderer_Frame_Packet *packet ) {
+	g_renderer.frame_constants_allocation = renderer_frame_allocate( sizeof( Renderer_Frame_Constants ) );
+	if ( !g_renderer.frame_constants_allocation.data )
+		return;
+
+	Matrix4x4_f32 view = packet->view;
+	Matrix4x4_f32 projection = packet->projection;
+	Vector3_f32 camera_position = packet->camera_position;
+	Vector3_f32 ambient = packet->ambient_light;
+
+	Renderer_Frame_Constants *constants = ( Renderer_Frame_Constants * )g_renderer.frame_constants_allocation.data;
+	constants->view = view;
+	constants->projection = projection;
+	constants->view_projection = projection * view;
+	constants->inverse_view = matrix4x4_f32_inverse( view );
+	constants->inverse_projection = matrix4x4_f32_inverse( projection );
+	constants->inverse_view_projection = matrix4x4_f32_inverse( constants->view_projection );
+	constants->camera_position = Vector4_f32 { camera_position.x, camera_position.y, camera_position.z, 1.0f };
+	constants->ambient = Vector4_f32 { ambient.r, ambient.g, ambient.b, 1.0f };
+	constants->time = packet->time;
+	constants->delta_time = packet->time_delta / 1000.0f;  // ms -> sec
+	constants->viewport_size = Vector2_f32 { ( f32 )packet->viewport_dimensions.width, ( f32 )packet->viewport_dimensions.height };
+	capture_frame_allocation( &g_renderer.frame_constants_allocation );
+
+	// Indexed binding points are not part of the program, so this holds for every pass.
+	renderer_frame_allocation_bind_uniform_buffer( &g_renderer.frame_constants_allocation, RENDERER_FRAME_CONSTANTS_BINDING );
+}
+
+// Copies parameters of every material, so the shaders can look them up by material ID.
+static void
+upload_material_parameters( Renderer_Frame_Packet *packet ) {
+	g_renderer.material_allocation = Renderer_Frame_Allocation { 0 };
+	if ( packet->materials.size < 1 )
+		return;
+
+	u32 parameters_size = packet->materials.size * sizeof( Renderer_Material_Parameters );
+	g_renderer.material_allocation = renderer_frame_allocate( parameters_size );
+	if ( !g_renderer.material_allocation.data )
+		return;
+
+	memcpy( g_renderer.material_allocation.data, packet->materials.data, parameters_size );
+	capture_frame_allocation( &g_renderer.material_allocation );
+	// Both the geometry and the lighting pass read them.
+	renderer_frame_allocation_bind_shader_storage_buffer( &g_renderer.material_allocation, RENDERER_MATERIALS_BUFFER_BINDING );
+}
+
+// Copies the storage buffers filled by the game thread, the lights for example, and binds them for the whole frame.
+static void
+upload_storage_buffers( Renderer_Frame_Packet *packet ) {
+	ForIt( packet->storage_buffers, packet->storage_buffers_count ) {
+		Renderer_Frame_Allocation allocation = renderer_frame_allocate( it.size );
+		if ( !allocation.data )
+			continue;
+
+		memcpy( allocation.data, it.data, it.size );
+		capture_frame_allocation( &allocation );
+		renderer_frame_allocation_bind_shader_storage_buffer( &allocation, it.binding );
+	}}
+}
+
+static void
+upload_texture_updates( Renderer_Frame_Packet *packet ) {
+	ForIt( packet->texture_updates, packet->texture_updates_count ) {
+		Texture *texture = texture_instance( it.texture_id );
+		GLenum opengl_format = renderer_texture_channels_to_opengl( texture->channels );
+		if ( renderer_capture_active() ) {
+			renderer_capture_texture_sub_image_2d(
+				texture->opengl_id, 0,
+				( GLint )texture->origin.x, ( GLint )texture->origin.y,
+				( GLsizei )texture->dimensions.width, ( GLsizei )texture->dimensions.height,
+				opengl_format, texture->opengl_pixel_type,
+				it.bytes, texture->bytes.size
+			);
+		}
+		glTextureSubImage2D(
+			/* texture */ texture->opengl_id,
+			/*   level */ 0,
+			/* xoffset */ ( GLint )texture->origin.x,
+			/* yoffset */ ( GLint )texture->origin.y,
+			/*   width */ ( GLsizei )texture->dimensions.width,
+			/*  height */ ( GLsizei )texture->dimensions.height,
+			/*  format */ opengl_format,
+			/*    type */ texture->opengl_pixel_type,
+			/*   pixel */ it.bytes
+		);
+
+		if ( texture->mipmap_levels > 1 ) {
+			if ( renderer_capture_active() )
+				renderer_capture_generate_texture_mipmap( texture->opengl_id );
+			glGenerateTextureMipmap( texture->opengl_id );
+		}
+	}}
+}
+
+// Takes over settings the game thread changed, the ones that need OpenGL calls only if they did.
+static void
+apply_frame_settings( Renderer_Frame_Settings *settings ) {
+	GL_Error_Checks *checks = &g_renderer.gl_error_checks;
+	if ( settings->gl_error_check_mode != checks->mode )
+		opengl_error_checks_set_mode( settings->gl_error_check_mode );
+
+	checks->sample_interval = settings->gl_error_check_interval;
+	checks->requested |= settings->gl_error_check_requested;
+}
+
+static void
+draw_output_channel( Renderer_Frame_Packet *packet ) {
+	Renderer_Framebuffer_Attachment_Point attachment_point = RendererFramebufferAttachmentPoint_None;
+	switch ( packet->settings.output_channel ) {
+		case RendererOutputChannel_Position:
+			attachment_point = RendererFramebufferAttachmentPoint_Color0;
+			break;
+		case RendererOutputChannel_Normal:
+			attachment_point = RendererFramebufferAttachmentPoint_Color1;
+			break;
+		case RendererOutputChannel_DiffuseSpecular:
+			attachment_point = RendererFramebufferAttachmentPoint_Color2;
+			break;
+
+		case RendererOutputChannel_FinalColor:
+		default:
+			break;
+	}
+
+	if ( attachment_point != RendererFramebufferAttachmentPoint_None ) {
+		Renderer_Framebuffer *geometry_framebuffer = renderer_framebuffer_instance( g_renderer.gbuffer.framebuffer );
+		GLenum opengl_attachment = renderer_framebuffer_attachment_point_to_opengl( attachment_point );
+		if ( renderer_capture_active() ) {
+			GLint source_rect[ 4 ] = { 0, 0, g_renderer.gbuffer.dimensions.width, g_renderer.gbuffer.dimensions.height };
+			GLint destination_rect[ 4 ] = { 0, 0, packet->viewport_dimensions.width, packet->viewport_dimensions.height };
+			renderer_capture_blit_framebuffer( geometry_framebuffer->opengl_framebuffer, opengl_attachment, 0, source_rect, destination_rect, GL_COLOR_BUFFER_BIT, GL_LINEAR );
+		}
+		glNamedFramebufferReadBuffer( geometry_framebuffer->opengl_framebuffer, opengl_attachment );
+		glBlitNamedFramebuffer(
+			/*           source */ geometry_framebuffer->opengl_framebuffer,
+			/*      destination */ 0,
+			/*      source rect */ 0, 0, g_renderer.gbuffer.dimensions.width, g_renderer.gbuffer.dimensions.height,
+			/* destination rect */ 0, 0, packet->viewport_dimensions.width, packet->viewport_dimensions.height,
+			/*             mask */ GL_COLOR_BUFFER_BIT,
+			/*           filter */ GL_LINEAR
+		);
+	}
+}
+
+// Uploads the instance indices and indirect commands of what `build_render_batches()` merged.
+static void
+upload_render_batches( Renderer_Frame_Packet *packet ) {
+	ArrayView< Renderer_Render_Command > commands = packet->render_queue;
+	if ( g_renderer.indirect_draws.size < 1 )
+		return;
+
+	// Instance indices are written straight into mapped memory, there is no staging copy.
+	g_renderer.instance_indices_allocation = renderer_frame_allocate( commands.size * sizeof( u32 ) );
+	g_renderer.indirect_allocation = renderer_frame_allocate( g_renderer.indirect_commands.size * sizeof( Renderer_Draw_Elements_Indirect_Command ) );
+	if ( !g_renderer.instance_indices_allocation.data || !g_renderer.indirect_allocation.data ) {
+		// Out of ring buffer space: nothing can be drawn this frame.
+		array_clear( &g_renderer.indirect_draws );
+		return;
+	}
+
+	renderer_batches_write_instance_indices( commands, ( u32 * )g_renderer.instance_indices_allocation.data );
+	memcpy( g_renderer.indirect_allocation.data, g_renderer.indirect_commands.data, g_renderer.indirect_allocation.size );
+	capture_frame_allocation( &g_renderer.instance_indices_allocation );
+	capture_frame_allocation( &g_renderer.indirect_allocation );
+}
+
+static void
+opengl_frame_packet_execute( Renderer_Frame_Packet *packet ) {
+	apply_frame_settings( &packet->settings );
+
+	// Anything outside of the renderer (ImGui, direct OpenGL calls) might have
+	//   changed the bound state since the last frame, so start from scratch.
+	opengl_state_invalidate( &g_renderer.gl_state );
+	opengl_state_frame_begin( &g_renderer.gl_state );
+	opengl_error_checks_frame_begin();
+	if ( packet->capture_file_path )
+		renderer_capture_begin( packet->capture_file_path, packet->settings.capture_frames_count, &g_renderer.gl_state );
+	if ( renderer_capture_active() )
+		renderer_capture_frame_begin( packet->frame_idx );
+
+	upload_texture_updates( packet );
+	upload_render_proxies( packet );
+	build_render_batches( packet );
+	upload_render_batches( packet );
+	upload_frame_constants( packet );
+	upload_material_parameters( packet );
+	upload_storage_buffers( packet );
+	draw_pass_geometry();
+	draw_pass_lighting( packet );
+	draw_pass_recorded_commands( packet );
+	// renderer_draw_post_processsing_pass();
+	draw_output_channel( packet );
+	ui_pass_draw( packet );
+
+	// Everything that reads this frame's allocations has been issued.
+	renderer_ring_buffer_frame_end( &g_renderer.frame_ring );
+	if ( renderer_capture_active() )
+		renderer_capture_frame_end( g_renderer.gl_state.frame );
+}
+
+static void
+opengl_create_and_bind_uniform_buffer( GLuint *id, GLsizeiptr size, GLbitfield storage_bits, StringView_ASCII debug_name ) {
+	glGenBuffers( 1, id );
+	glBindBuffer( GL_UNIFORM_BUFFER, *id );
+#ifdef QLIGHT_DEBUG
+	if ( debug_name.size > 0 )
+		glObjectLabel( GL_BUFFER, *id, debug_name.size, debug_name.data );
+#endif
+	log_debug_gl( "Created and bound Uniform Buffer '" StringViewFormat "' (gl_id: %u).",
+		StringViewArgument( debug_name ),
+		*id
+	);
+	glNamedBufferStorage(
+		/* buffer */ *id,
+		/*   size */ size,
+		/*   data */ NULL,
+		/*  flags */ storage_bits
+	);
+}
+
+Renderer_Uniform_Buffer *
+renderer_uniform_buffer_create( StringView_ASCII name, u32 size, Renderer_GL_Buffer_Storage_Bits storage_bits, u32 binding ) {
+	Renderer_Uniform_Buffer _uniform_buffer = {
+		.name = name,
+		.size = size,
+		.binding = binding,
+		.storage_bits = storage_bits
+		// .opengl_ubo
+	};
+
+	opengl_create_and_bind_uniform_buffer( &_uniform_buffer.opengl_ubo, size, storage_bits, name );
+
+	u32 buffer_idx = array_add( &g_renderer.uniform_buffers, _uniform_buffer );
+	Renderer_Uniform_Buffer *uniform_buffer = &g_renderer.uniform_buffers.data[ buffer_idx ];
+
+	if ( binding != INVALID_UNIFORM_BUFFER_BINDING )
+		renderer_uniform_buffer_set_binding( uniform_buffer, binding );
+
+	return uniform_buffer;
+}
+
+void
+renderer_uniform_buffer_set_binding( Renderer_Uniform_Buffer *uniform_buffer, u32 binding ) {
+	glBindBuffer( GL_UNIFORM_BUFFER, uniform_buffer->opengl_ubo );
+	glBindBufferBase(
+		/* target */ GL_UNIFORM_BUFFER,
+		/* index  */ binding,
+		/* buffer */ uniform_buffer->opengl_ubo
+	);
+	uniform_buffer->binding = binding;
+}
+
+void *
+renderer_uniform_buffer_memory_map(
+	Renderer_Uniform_Buffer *uniform_buffer,
+	Renderer_GL_Map_Access_Bits access_bits,
+	u32 size,
+	u32 offset
+) {
+	u32 length = ( size != 0 ) ? size : uniform_buffer->size - offset;
+	Assert( offset < uniform_buffer->size );
+	void *uniform_data = glMapNamedBufferRange(
+		/* buffer */ uniform_buffer->opengl_ubo,
+		/* offset */ offset,
+		/* length */ length,
+		/* access */ access_bits
+	);
+
+	return uniform_data;
+}
+
+u32
+renderer_uniform_buffer_write( Renderer_Uniform_Buffer *uniform_buffer, ArrayView< u8 > write_data, u32 size, u32 offset ) {
+	if ( !write_data.data || write_data.size == 0 )
+		return 0;
+
+	Assert( size <= uniform_buffer->size - offset );
+	u32 write_size = size;
+	if ( size == 0 )
+		write_size = uniform_buffer->size - offset;
+
+
+	Renderer_GL_Map_Access_Bits access_bits = renderer_gl_buffer_storage_bits_to_map_access_bits( uniform_buffer->storage_bits );
+	void *uniform_data = renderer_uniform_buffer_memory_map( uniform_buffer, access_bits, write_size, offset );
+	memcpy( uniform_data, write_data.data, write_size );
+	Assert( renderer_uniform_buffer_memory_unmap( uniform_buffer, access_bits, size, offset ) );
+	return write_size;
+}
+
+u32
+renderer_uniform_buffer_read( Renderer_Uniform_Buffer *uniform_buffer, Array< u8 > *out_read_data, u32 size, u32 offset ) {
+	if ( !out_read_data )
+		return 0;
+
+	Assert( size <= uniform_buffer->size - offset );
+	ArrayView< u8 > read_view;
+	read_view.size = size;
+	if ( size == 0 )
+		read_view.size = uniform_buffer->size - offset;
+
+	Renderer_GL_Map_Access_Bits access_bits = renderer_gl_buffer_storage_bits_to_map_access_bits( uniform_buffer->storage_bits );
+	read_view.data = ( u8 * )renderer_uniform_buffer_memory_map( uniform_buffer, access_bits, size, offset );
+	u32 bytes_read = array_add_many( out_read_data, read_view );
+	Assert( renderer_uniform_buffer_memory_unmap( uniform_buffer, access_bits, size, offset ) );
+	return bytes_read;
+}
+
+bool
+renderer_uniform_buffer_memory_unmap( Renderer_Uniform_Buffer *uniform_buffer, Renderer_GL_Map_Access_Bits access_bits, u32 size, u32 offset ) {
+	// TODO: Handle specific cases based on access bits:
+	//   InvalidateRange,
+	//   InvalidateBuffer,
+	//   FlushExplicit,
+	//   Unsynchronized.
+
+	// u32 length = ( size != 0 ) ? size : uniform_buffer->size - offset;
+	// GL_ASSERT( glFlushMappedNamedBufferRange(
+	// 	/* buffer */ uniform_buffer->opengl_ubo,
+	// 	/* offset */ ( GLintptr )offset,
+	// 	/* length */ ( GLsizei )length
+	// ) );
+	bool result = glUnmapNamedBuffer( uniform_buffer->opengl_ubo );
+	return result;
+}
+
+bool
+renderer_uniform_buffer_destroy( Renderer_Uniform_Buffer *uniform_buffer ) {
+	return false;
+}
+
+Renderer_Frame_Allocation
+renderer_frame_allocate( u32 size ) {
+	return renderer_ring_buffer_allocate( &g_renderer.frame_ring, size );
+}
+
+void
+renderer_frame_allocation_bind_uniform_buffer( Renderer_Frame_Allocation *allocation, u32 binding ) {
+	Assert( allocation->data );
+	if ( renderer_capture_active() )
+		renderer_capture_bind_buffer_range( GL_UNIFORM_BUFFER, binding, allocation->opengl_buffer, allocation->offset, allocation->size );
+	glBindBufferRange(
+		/* target */ GL_UNIFORM_BUFFER,
+		/*  index */ binding,
+		/* buffer */ allocation->opengl_buffer,
+		/* offset */ allocation->offset,
+		/*   size */ allocation->size
+	);
+}
+
+void
+renderer_frame_allocation_bind_shader_storage_buffer( Renderer_Frame_Allocation *allocation, u32 binding ) {
+	Assert( allocation->data );
+	if ( renderer_capture_active() )
+		renderer_capture_bind_buffer_range( GL_SHADER_STORAGE_BUFFER, binding, allocation->opengl_buffer, allocation->offset, allocation->size );
+	glBindBufferRange(
+		/* target */ GL_SHADER_STORAGE_BUFFER,
+		/*  index */ binding,
+		/* buffer */ allocation->opengl_buffer,
+		/* offset */ allocation->offset,
+		/*   size */ allocation->size
+	);
+}
+
+static void
+opengl_program_destroy( Renderer_Shader_Program *program ) {
+	if ( program->opengl_program != 0 )
+		glDeleteProgram( program->opengl_program );
+}
+
+static void
+opengl_program_create( Renderer_Shader_Program *program, ArrayView< Renderer_Shader_Stage * > shader_stages ) {
+	GL_CHECK( program->opengl_program = glCreateProgram() );
+#ifdef QLIGHT_DEBUG
+	glObjectLabel( GL_PROGRAM, program->opengl_program, program->name.size, program->name.data );
+#endif
+
+	// Iterate over passes shader stages.
+	ForIt( shader_stages.data, shader_stages.size ) {
+		Renderer_Shader_Kind_Bits kind_bit = renderer_shader_kind_bit( it->kind );
+		if ( program->linked_shaders & kind_bit ) {
+			// Complain and skip.
+			StringView_ASCII shader_kind = renderer_shader_kind_name( it->kind );
+			log_warning_gl(
+				"WARNING: Trying to attach " StringFormat " stage shader to '" StringFormat "' shader program, but it already has one. Skipping.",
+				StringArgumentValue( shader_kind ),
+				StringArgumentValue( program->name )
+			);
+			continue;
+		}
+
+		it->opengl_shader = opengl_compile_shader_stage( it );
+		glAttachShader( program->opengl_program, it->opengl_shader );
+#ifdef QLIGHT_DEBUG
+		glObjectLabel( GL_SHADER, it->opengl_shader, it->name.size, it->name.data );
+#endif
+
+		program->shaders[ it_index ] = it;
+		program->linked_shaders |= kind_bit;
+	}}
+
+	GLint opengl_result;
+
+	GL_CHECK( glLinkProgram( program->opengl_program ) );
+	glGetProgramiv( program->opengl_program, GL_LINK_STATUS, &opengl_result );
+	if ( opengl_result != GL_TRUE ) {
+		StringView_ASCII info_log = opengl_get_info_log( OpenGL_Program, program->opengl_program );
+
+		log_error_gl(
+			"Failed to link '" StringFormat "' shader program! Error log:\n" StringFormat,
+			StringArgumentValue( program->name ),
+			StringViewArgument( info_log )
+		);
+	}
+
+	GL_CHECK( glValidateProgram( program->opengl_program ) );
+	glGetProgramiv( program->opengl_program, GL_VALIDATE_STATUS, &opengl_result );
+	if ( opengl_result != GL_TRUE ) {
+		StringView_ASCII info_log = opengl_get_info_log( OpenGL_Program, program->opengl_program );
+
+		log_error_gl(
+			"Failed to validate '" StringFormat "' shader program! Error log:\n" StringFormat,
+			StringArgumentValue( program->name ),
+			StringViewArgument( info_log )
+		);
+	}
+
+	// Fill uniforms with what the linker reports as active, so they do not have to be declared by hand.
+	opengl_program_query_uniforms( program );
+
+	// Iterate over program's shaders.
+	// No `.data` because it is a flat C array, not Array/ArrayView struct.
+	ForIt( program->shaders, RendererShaderKind_COUNT ) {
+		if ( !it )
+			continue;
+
+		Renderer_Shader_Kind_Bits kind_bit = renderer_shader_kind_bit( it->kind );
+		if ( !( program->linked_shaders & kind_bit ) )
+			continue;
+
+		GL_CHECK( glDeleteShader( it->opengl_shader ) );
+		glGetShaderiv( it->opengl_shader, GL_DELETE_STATUS, &opengl_result );
+		if ( opengl_result != GL_TRUE ) {
+			StringView_ASCII info_log = opengl_get_info_log( OpenGL_Program, program->opengl_program );
+
+			log_error_gl(
+				"Failed to mark '" StringFormat "' shader stage for deletion! Error log:\n" StringFormat,
+				StringArgumentValue( it->name ),
+				StringViewArgument( info_log )
+			);
+		}
+	}}
+}
+
+static bool
+opengl_program_set_uniform( Renderer_Shader_Program *program, Renderer_Uniform *uniform, void *value ) {
+	bool transpose = g_renderer.uniforms_transpose_matrix;
+
+	// The function can determine whether the OpenGL call was successfull
+	//   only if the OpenGL error logging is turned on.  Otherwise, it
+	//   will always return true.
+	// `success` can only be overwritten if `QLIGHT_OPENGL_ERROR_CHECKS` is defined
+	//   and `glProgramUniformXXX` call generates an error.
+	bool success = true;
+	bool *result = &success;
+	GLuint program_id = program->opengl_program;
+	GLint location = uniform->opengl_location;
+	GLsizei count = ( GLsizei )uniform->elements;
+	if ( renderer_capture_active() ) {
+		// Elements of an array have consecutive locations, captured one by one.
+		u32 element_size = renderer_data_type_size( uniform->data_type );
+		For( uniform->elements ) {
+			renderer_capture_set_uniform( program_id, location + ( GLint )it_index, uniform->data_type, transpose, ( u8 * )value + it_index * element_size );
+		}
+	}
+	switch ( uniform->data_type ) {
+		// Sampler2D ?
+		case RendererDataType_s32:
+			GL_CHECK_AND_STORE_RESULT( result, glProgramUniform1iv( program_id, location, count, ( s32 * )value ) ); break;
+		case RendererDataType_u32:
+			GL_CHECK_AND_STORE_RESULT( result, glProgramUniform1uiv( program_id, location, count, ( u32 * )value ) ); break;
+		case RendererDataType_f32:
+			GL_CHECK_AND_STORE_RESULT( result, glProgramUniform1fv( program_id, location, count, ( f32 * )value ) ); break;
+		case RendererDataType_Vector2_f32:
+			GL_CHECK_AND_STORE_RESULT( result, glProgramUniform2fv( program_id, location, count, ( f32 * )value ) ); break;
+		case RendererDataType_Vector3_f32:
+			GL_CHECK_AND_STORE_RESULT( result, glProgramUniform3fv( program_id, location, count, ( f32 * )value ) ); break;
+		case RendererDataType_Vector4_f32:
+			GL_CHECK_AND_STORE_RESULT( result, glProgramUniform4fv( program_id, location, count, ( f32 * )value ) ); break;
+		case RendererDataType_Matrix3x3_f32:
+			GL_CHECK_AND_STORE_RESULT( result, glProgramUniformMatrix3fv( program_id, location, count, transpose, ( f32 * )value ) ); break;
+		case RendererDataType_Matrix4x4_f32:
+			GL_CHECK_AND_STORE_RESULT( result, glProgramUniformMatrix4fv( program_id, location, count, transpose, ( f32 * )value ) ); break;
+		default:
+			AssertMessage( false, "Unsupported type" );
+			return false;
+	}
+
+	return success;
+}
+
+static GLint
+opengl_program_uniform_location( Renderer_Shader_Program *program, Renderer_Uniform *uniform ) {
+	return glGetUniformLocation( program->opengl_program, uniform->name.data );
+}
+
+static GLuint
+opengl_renderbuffer_create( StringView_ASCII name, Vector2_u16 dimensions, GLenum opengl_storage_format ) {
+	GLuint renderbuffer;
+	// Legacy: glGenRenderbuffers (cannot be used in Direct State Access functions (glNamedRenderbuffer).
+	GL_CHECK( glCreateRenderbuffers( 1, &renderbuffer ) );
+#ifdef QLIGHT_DEBUG
+	glObjectLabel( GL_RENDERBUFFER, renderbuffer, name.size, name.data );
+#endif
+	// glBindRenderbuffer( GL_RENDERBUFFER, renderbuffer );
+	// glRenderbufferStorage( GL_RENDERBUFFER, ... );
+	glNamedRenderbufferStorage(
+		/*   renderbuffer */ renderbuffer,
+		/* internalformat */ opengl_storage_format,
+		/*          width */ ( GLsizei )dimensions.width,
+		/*         height */ ( GLsizei )dimensions.height
+	);
+	return renderbuffer;
+}
+
+static GLuint
+opengl_framebuffer_create( StringView_ASCII name ) {
+	GLuint framebuffer;
+	// Legacy: glGenFramebuffers (cannot be used in Direct State Access functions (glNamedFramebuffer).
+	GL_CHECK( glCreateFramebuffers( 1, &framebuffer ) );
+#ifdef QLIGHT_DEBUG
+	glObjectLabel( GL_FRAMEBUFFER, framebuffer, name.size, name.data );
+#endif
+	return framebuffer;
+}
+
+static void
+opengl_framebuffer_attach_renderbuffer( Renderer_Framebuffer *framebuffer, GLenum opengl_attachment, Renderer_Renderbuffer *renderbuffer ) {
+	// glFramebufferRenderbuffer( GL_FRAMEBUFFER, ... );
+	glNamedFramebufferRenderbuffer(
+		/*        framebuffer */ framebuffer->opengl_framebuffer,
+		/*         attachment */ opengl_attachment,
+		/* renderbuffertarget */ GL_RENDERBUFFER,
+		/*       renderbuffer */ renderbuffer->opengl_renderbuffer
+	);
+}
+
+static bool
+opengl_framebuffer_is_complete( Renderer_Framebuffer *framebuffer ) {
+	GLenum opengl_framebuffer_status = glCheckNamedFramebufferStatus( framebuffer->opengl_framebuffer, GL_FRAMEBUFFER );
+	bool complete = ( opengl_framebuffer_status == GL_FRAMEBUFFER_COMPLETE );
+	return complete;
+}
+
+static void
+opengl_framebuffer_set_draw_buffers( Renderer_Framebuffer *framebuffer, ArrayView< GLenum > opengl_color_attachments ) {
+	glNamedFramebufferDrawBuffers( framebuffer->opengl_framebuffer, opengl_color_attachments.size, opengl_color_attachments.data );
+}
+
+static void
+opengl_mesh_draw( Geometry_Pool *pool, Mesh *mesh, u32 instance_count, u32 first_instance ) {
+	GLenum index_type = index_type_size_to_opengl( pool->index_size );
+	if ( renderer_capture_active() )
+		renderer_capture_draw_elements( GL_TRIANGLES, mesh->indices.size, index_type, ( u64 )mesh->first_index * pool->index_size, instance_count, ( GLint )mesh->base_vertex, first_instance );
+	glDrawElementsInstancedBaseVertexBaseInstance(
+		/*          mode */ GL_TRIANGLES,
+		/*         count */ mesh->indices.size,
+		/*          type */ index_type,
+		/*       indices */ ( void * )( ( u64 )mesh->first_index * pool->index_size ),
+		/* instancecount */ instance_count,
+		/*    basevertex */ ( GLint )mesh->base_vertex,
+		/*  baseinstance */ first_instance
+	);
+}
+
+static f32
+opengl_current_time() {
+	return ( f32 )glfwGetTime();
+}
+
+static bool
+opengl_init() {
+	GLuint disabled_messages[] {
+		/* Buffer detailed info */ 131185
+	};
+	glDebugMessageControl(
+	    /*   source */ GL_DEBUG_SOURCE_API,
+	    /*     type */ GL_DEBUG_TYPE_OTHER,
+	    /* severity */ GL_DONT_CARE,
+	    /*    count */ ARRAY_SIZE( disabled_messages ),
+	    /*      ids */ disabled_messages,
+	    /*  enabled */ GL_FALSE
+	);
+	glDebugMessageCallback( opengl_debug_message_callback, NULL );
+
+	opengl_query_constants();
+	g_renderer.device.vendor = string_view( ( const char * )glGetString( GL_VENDOR ) );
+	g_renderer.device.name = string_view( ( const char * )glGetString( GL_RENDERER ) );
+
+	// Allocations are bound as uniform and shader storage buffers and mapped directly, so satisfy all three.
+	GL_Constants *gl_constants = &g_renderer.gl_constants;
+	u32 ring_alignment = gl_constants->min_map_buffer_alignment;
+	if ( gl_constants->uniform_buffer_offset_alignment > ring_alignment )
+		ring_alignment = gl_constants->uniform_buffer_offset_alignment;
+	if ( gl_constants->shader_storage_buffer_offset_alignment > ring_alignment )
+		ring_alignment = gl_constants->shader_storage_buffer_offset_alignment;
+	if ( !renderer_ring_buffer_create( &g_renderer.frame_ring, "frame_ring_buffer", RENDERER_FRAME_RING_BUFFER_SIZE, ring_alignment ) )
+		return false;
+
+	// Set facet winding order to clockwise.
+	// Then, clockwise ordered facets are considered to be front-facing,
+	//   while counter-clockwise ordered to be back-facing.
+	glFrontFace( GL_CW );
+	return true;
+}
+
+static void
+opengl_shutdown() {
+	if ( g_renderer.proxy_instance_buffer != 0 )
+		glDeleteBuffers( 1, &g_renderer.proxy_instance_buffer );
+	renderer_ring_buffer_destroy( &g_renderer.frame_ring );
+
+	ForIt( g_renderer.geometry_pools.data, g_renderer.geometry_pools.size ) {
+		glDeleteVertexArrays( 1, &it.opengl_vao );
+		glDeleteBuffers( 1, &it.opengl_vbo );
+		glDeleteBuffers( 1, &it.opengl_ebo );
+	}}
+	ForIt( g_renderer.texture_array_pools.data, g_renderer.texture_array_pools.size ) {
+		glDeleteTextures( 1, &it.opengl_texture );
+	}}
+}
+
+static void
+opengl_framebuffer_attach_texture( Renderer_Framebuffer *framebuffer, GLenum opengl_attachment, Texture *texture ) {
+	glNamedFramebufferTexture(
+		/* framebuffer */ framebuffer->opengl_framebuffer,
+		/*  attachment */ opengl_attachment,
+		/*     texture */ texture->opengl_id,
+		/*       level */ 0  // mipmap
+	);
+}
+
+static void
+opengl_create_texture_2d( GLuint *id, StringView_ASCII debug_name ) {
+	glCreateTextures( GL_TEXTURE_2D, 1, id );
+#ifdef QLIGHT_DEBUG
+	if ( debug_name.size > 0 )
+		glObjectLabel( GL_TEXTURE, *id, debug_name.size, debug_name.data );
+	log_debug_gl( "Created 2D Texture '" StringViewFormat "' (gl_id: %u).",
+		StringViewArgument( debug_name ),
+		*id
+	);
+#endif
+}
+static bool
+opengl_storage_format_is_integer( GLint internal_format ) {
+	switch ( internal_format ) {
+		case GL_R8I: case GL_R8UI: case GL_R16I: case GL_R16UI: case GL_R32I: case GL_R32UI:
+		case GL_RG8I: case GL_RG8UI: case GL_RG16I: case GL_RG16UI: case GL_RG32I: case GL_RG32UI:
+		case GL_RGB8I: case GL_RGB8UI: case GL_RGB16I: case GL_RGB16UI: case GL_RGB32I: case GL_RGB32UI:
+		case GL_RGBA8I: case GL_RGBA8UI: case GL_RGBA16I: case GL_RGBA16UI: case GL_RGBA32I: case GL_RGBA32UI:
+		case GL_RGB10_A2UI:
+			return true;
+
+		default: return false;
+	}
+}
+
+static GLuint
+opengl_texture_2d_create( Texture *texture ) {
+	// 1. Create OpenGL identifier.
+	GLuint texture_id;
+	opengl_create_texture_2d( &texture_id, texture->name );
+
+	// 2. Allocate Immutable Texture Storage.
+	// It cannot be modified (reused) like the legacy one, a new one must be created.
+	glTextureStorage2D(
+		/*        texture */ texture_id,
+		/*         levels */ texture->mipmap_levels,
+		/* internalformat */ texture->opengl_storage_format, // Sized format, for example: `GL_RGBA8`.
+		/*          width */ ( GLsizei )texture->dimensions.width,
+		/*         height */ ( GLsizei )texture->dimensions.height
+	);
+
+#ifdef QLIGHT_DEBUG
+	// Make sure it actually uses Immutable Texture Storage.
+	GLint opengl_texture_storage_immutable = 0;
+	glGetTextureParameteriv( texture_id, GL_TEXTURE_IMMUTABLE_FORMAT, &opengl_texture_storage_immutable );
+	Assert( opengl_texture_storage_immutable == GL_TRUE );
+#endif
+
+	// 3. Upload texture data.
+	if ( texture->bytes.data ) {
+		GLenum opengl_format = renderer_texture_channels_to_opengl( texture->channels );
+		glTextureSubImage2D(
+			/* texture */ texture_id,
+			/*   level */ 0,  // 0th mipmap - Base image, full resolution.
+			/* xoffset */ ( GLint )texture->origin.x,
+			/* yoffset */ ( GLint )texture->origin.y,
+			/*   width */ ( GLsizei )texture->dimensions.width,
+			/*  height */ ( GLsizei )texture->dimensions.height,
+			/*  format */ opengl_format, // Generic channels layout format, for example: `GL_RGB`.
+			/*    type */ texture->opengl_pixel_type,  // Pixel data type, for example: `GL_UNSIGNED_BYTE`.
+			/*   pixel */ texture->bytes.data
+		);
+
+		// 4. Generate mipmaps automatically from the base level.
+		if ( texture->mipmap_levels > 1 )
+			glGenerateTextureMipmap( texture_id );
+	}
+
+	// 5. Set texture parameters.
+	// Integer textures are incomplete with linear filtering, even for `texelFetch`.
+	bool integer_format = opengl_storage_format_is_integer( texture->opengl_storage_format );
+	glTextureParameteri( texture_id, GL_TEXTURE_MIN_FILTER, ( integer_format ) ? GL_NEAREST : GL_LINEAR_MIPMAP_LINEAR );
+	glTextureParameteri( texture_id, GL_TEXTURE_MAG_FILTER, ( integer_format ) ? GL_NEAREST : GL_LINEAR );
+	// glTextureParameteri( texture_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER );
+	// glTextureParameteri( texture_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER );
+	return texture_id;
+}
+
+static GLuint
+opengl_create_texture_2d_array( Vector2_u16 dimensions, u8 mipmap_levels, GLint opengl_storage_format, u32 layers, StringView_ASCII debug_name ) {
+	GLuint texture;
+	glCreateTextures( GL_TEXTURE_2D_ARRAY, 1, &texture );
+#ifdef QLIGHT_DEBUG
+	if ( debug_name.size > 0 )
+		glObjectLabel( GL_TEXTURE, texture, debug_name.size, debug_name.data );
+#endif
+	glTextureStorage3D(
+		/*        texture */ texture,
+		/*         levels */ mipmap_levels,
+		/* internalformat */ opengl_storage_format,
+		/*          width */ ( GLsizei )dimensions.width,
+		/*         height */ ( GLsizei )dimensions.height,
+		/*          depth */ ( GLsizei )layers
+	);
+	glTextureParameteri( texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+	glTextureParameteri( texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	return texture;
+}
+// Copies `layers` layers starting at `source_layer` of every mipmap level from one texture to another of the same format.
+static void
+opengl_copy_texture_layers( GLuint source, GLenum source_target, u32 source_layer, GLuint destination, u32 destination_layer, Vector2_u16 dimensions, u8 mipmap_levels, u32 layers ) {
+	For( mipmap_levels ) {
+		GLsizei level_width = QL_max2( ( s32 )dimensions.width >> it_index, 1 );
+		GLsizei level_height = QL_max2( ( s32 )dimensions.height >> it_index, 1 );
+		glCopyImageSubData(
+			/*    srcName */ source,
+			/*  srcTarget */ source_target,
+			/*   srcLevel */ ( GLint )it_index,
+			/* srcX, Y, Z */ 0, 0, ( GLint )source_layer,
+			/*    dstName */ destination,
+			/*  dstTarget */ GL_TEXTURE_2D_ARRAY,
+			/*   dstLevel */ ( GLint )it_index,
+			/* dstX, Y, Z */ 0, 0, ( GLint )destination_layer,
+			/*      width */ level_width,
+			/*     height */ level_height,
+			/*      depth */ ( GLsizei )layers
+		);
+	}
+}
+static GLuint
+opengl_texture_array_layer_view( Texture_Array_Pool *pool, Texture *texture, u32 layer ) {
+	if ( texture->opengl_id != 0 )
+		glDeleteTextures( 1, &texture->opengl_id );
+
+	// Views need a name that has never been bound, which `glCreateTextures` does not give.
+	GLuint view;
+	glGenTextures( 1, &view );
+	glTextureView(
+		/*        texture */ view,
+		/*         target */ GL_TEXTURE_2D,
+		/* origtexture */  pool->opengl_texture,
+		/* internalformat */ pool->opengl_storage_format,
+		/*       minlevel */ 0,
+		/*      numlevels */ pool->mipmap_levels,
+		/*       minlayer */ layer,
+		/*      numlayers */ 1
+	);
+	glTextureParameteri( view, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+	glTextureParameteri( view, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+#ifdef QLIGHT_DEBUG
+	if ( texture->name.size > 0 )
+		glObjectLabel( GL_TEXTURE, view, texture->name.size, texture->name.data );
+#endif
+	return view;
+}
+static GLuint
+opengl_texture_array_grow( Texture_Array_Pool *pool, u32 layers_capacity ) {
+	GLuint texture = opengl_create_texture_2d_array( pool->dimensions, pool->mipmap_levels, pool->opengl_storage_format, layers_capacity, "texture_array_pool_grown" );
+	opengl_copy_texture_layers( pool->opengl_texture, GL_TEXTURE_2D_ARRAY, 0, texture, 0, pool->dimensions, pool->mipmap_levels, pool->layers.size );
+	glDeleteTextures( 1, &pool->opengl_texture );
+	return texture;
+}
+
+static void
+opengl_texture_array_upload_layer( Texture_Array_Pool *pool, Texture *texture, u32 layer ) {
+	if ( !texture->bytes.data )
+		return;
+
+	// Mipmaps of a single layer can not be generated in place, so build them in a staging 2D texture and copy them over.
+	GLuint staging_texture;
+	glCreateTextures( GL_TEXTURE_2D, 1, &staging_texture );
+	glTextureStorage2D( staging_texture, texture->mipmap_levels, texture->opengl_storage_format, ( GLsizei )texture->dimensions.width, ( GLsizei )texture->dimensions.height );
+	GLenum opengl_format = renderer_texture_channels_to_opengl( texture->channels );
+	glTextureSubImage2D(
+		/* texture */ staging_texture,
+		/*   level */ 0,
+		/* xoffset */ 0,
+		/* yoffset */ 0,
+		/*   width */ ( GLsizei )texture->dimensions.width,
+		/*  height */ ( GLsizei )texture->dimensions.height,
+		/*  format */ opengl_format,
+		/*    type */ texture->opengl_pixel_type,
+		/*   pixel */ texture->bytes.data
+	);
+	if ( texture->mipmap_levels > 1 )
+		glGenerateTextureMipmap( staging_texture );
+
+	opengl_copy_texture_layers( staging_texture, GL_TEXTURE_2D, 0, pool->opengl_texture, layer, texture->dimensions, texture->mipmap_levels, 1 );
+	glDeleteTextures( 1, &staging_texture );
+}
+
+static GLuint
+opengl_create_geometry_buffer( u64 size, StringView_ASCII debug_name ) {
+	GLuint buffer;
+	glCreateBuffers( 1, &buffer );
+#ifdef QLIGHT_DEBUG
+	if ( debug_name.size > 0 )
+		glObjectLabel( GL_BUFFER, buffer, debug_name.size, debug_name.data );
+#endif
+	// Mesh data is written with `glNamedBufferSubData`, so the storage has to be dynamic.
+	glNamedBufferStorage( buffer, size, NULL, GL_DYNAMIC_STORAGE_BIT );
+	return buffer;
+}
+static void
+opengl_geometry_pool_create( Geometry_Pool *pool ) {
+	opengl_create_vertex_array( &pool->opengl_vao, "geometry_pool" );
+	pool->opengl_vbo = opengl_create_geometry_buffer( ( u64 )pool->vertices.capacity * pool->vertex_stride, "geometry_pool_vertices" );
+	pool->opengl_ebo = opengl_create_geometry_buffer( ( u64 )pool->indices.capacity * pool->index_size, "geometry_pool_indices" );
+
+	/*
+		WARNING: Vertex attributes offsets are set sequentially!
+		If attribute indices do not correspond to indices within array, offsets will be completely wrong.
+		TODO: Do something about it.
+	*/
+	u32 relative_offset = 0;
+	ForIt( pool->vertex_attributes.data, pool->vertex_attributes.size ) {
+		// @TODO: Only binding 0 has a buffer for now.
+		Assert( it.binding == 0 );
+		GLenum opengl_data_type = renderer_data_type_to_opengl_type( it.data_type );
+		u32 data_type_size = ( u32 )renderer_data_type_size( it.data_type ) * it.elements;
+		bool active = it.bits & RendererVertexAttributeBit_Active;
+		bool normalize = it.bits & RendererVertexAttributeBit_Normalize;
+
+		// Set attribute format parameters.
+		glVertexArrayAttribFormat(
+			/*          vaobj */ pool->opengl_vao,
+			/*    attribindex */ it.index,
+			/*           size */ it.elements,
+			/*           type */ opengl_data_type,
+			/*     normalized */ normalize,
+			/* relativeoffset */ relative_offset
+		);
+
+		// Specify from which VBO (Vertex Buffer) to read the attribute from.
+		// Binding is a VAO (Vertex Array) slot a VBO (Vertex Buffer) is bound to.
+		glVertexArrayAttribBinding(
+			/*        vaobj */ pool->opengl_vao,
+			/*  attribindex */ it.index,
+			/* bindingindex */ it.binding
+		);
+		relative_offset += data_type_size;
+
+		if ( active ) {
+			glEnableVertexArrayAttrib( pool->opengl_vao, it.index );
+		} else {
+			glDisableVertexArrayAttrib( pool->opengl_vao, it.index );
+		}
+	}}
+
+	glVertexArrayVertexBuffer(
+		/*        vaobj */ pool->opengl_vao,
+		/* bindingindex */ 0,
+		/*       buffer */ pool->opengl_vbo,
+		/*       offset */ 0,
+		/*       stride */ pool->vertex_stride
+	);
+	glVertexArrayElementBuffer( pool->opengl_vao, pool->opengl_ebo );
+}
+
+static void
+opengl_geometry_pool_grow_buffer( Geometry_Pool *pool, GLuint *buffer, u64 old_size, u64 new_size ) {
+	GLuint new_buffer = opengl_create_geometry_buffer( new_size, "geometry_pool_grown" );
+	glCopyNamedBufferSubData(
+		/*  readBuffer */ *buffer,
+		/* writeBuffer */ new_buffer,
+		/*  readOffset */ 0,
+		/* writeOffset */ 0,
+		/*        size */ ( GLsizeiptr )old_size
+	);
+	glDeleteBuffers( 1, buffer );
+	*buffer = new_buffer;
+
+	glVertexArrayVertexBuffer( pool->opengl_vao, 0, pool->opengl_vbo, 0, pool->vertex_stride );
+	glVertexArrayElementBuffer( pool->opengl_vao, pool->opengl_ebo );
+}
+
+static void
+opengl_mesh_upload( Geometry_Pool *pool, Mesh *mesh ) {
+	glNamedBufferSubData(
+		/* buffer */ pool->opengl_vbo,
+		/* offset */ ( GLintptr )mesh->base_vertex * pool->vertex_stride,
+		/*   size */ ( GLsizeiptr )mesh->vertices.size * mesh->vertices.item_size,
+		/*   data */ mesh->vertices.data
+	);
+
+	glNamedBufferSubData(
+		/* buffer */ pool->opengl_ebo,
+		/* offset */ ( GLintptr )mesh->first_index * pool->index_size,
+		/*   size */ ( GLsizeiptr )mesh->indices.size * mesh->indices.item_size,
+		/*   data */ mesh->indices.data
+	);
+}
+
+Renderer_Backend_Dispatch
+renderer_backend_opengl() {
+	// GLEW function pointers are loaded by `glewInit()`, so the table is filled at runtime.
+	return Renderer_Backend_Dispatch {
+		.init = opengl_init,
+		.shutdown = opengl_shutdown,
+		.state = OpenGL_State_Dispatch {
+			.use_program = glUseProgram,
+			.bind_vertex_array = glBindVertexArray,
+			.bind_texture_unit = glBindTextureUnit,
+			.bind_framebuffer = glBindFramebuffer,
+			.viewport = glViewport,
+			.enable = glEnable,
+			.disable = glDisable
+		},
+		.set_error_check_mode = opengl_error_checks_set_mode,
+		.current_time = opengl_current_time,
+
+		.program_create = opengl_program_create,
+		.program_destroy = opengl_program_destroy,
+		.program_query_uniforms = opengl_program_query_uniforms,
+		.program_uniform_location = opengl_program_uniform_location,
+		.program_set_uniform = opengl_program_set_uniform,
+
+		.renderbuffer_create = opengl_renderbuffer_create,
+		.framebuffer_create = opengl_framebuffer_create,
+		.framebuffer_attach_renderbuffer = opengl_framebuffer_attach_renderbuffer,
+		.framebuffer_attach_texture = opengl_framebuffer_attach_texture,
+		.framebuffer_is_complete = opengl_framebuffer_is_complete,
+		.framebuffer_set_draw_buffers = opengl_framebuffer_set_draw_buffers,
+
+		.texture_2d_create = opengl_texture_2d_create,
+		.texture_array_create = opengl_create_texture_2d_array,
+		.texture_array_grow = opengl_texture_array_grow,
+		.texture_array_upload_layer = opengl_texture_array_upload_layer,
+		.texture_array_layer_view = opengl_texture_array_layer_view,
+
+		.geometry_pool_create = opengl_geometry_pool_create,
+		.geometry_pool_grow_buffer = opengl_geometry_pool_grow_buffer,
+		.mesh_upload = opengl_mesh_upload,
+		.mesh_draw = opengl_mesh_draw,
+
+		.frame_packet_execute = opengl_frame_packet_execute
+	};
+}
@@ -0,0 +1,244 @@
+#include "renderer_batch.h"
+
+u32 renderer_batches_build( ArrayView< Renderer_Render_Command > commands, Array< Renderer_Instance_Batch > *out_batches, u32 max_batch_instances ) {
+	Assert( max_batch_instances > 0 );
+	u32 batches_added = 0;
+	Renderer_Instance_Batch batch = { 0 };
+	ForIt( commands.data, commands.size ) {
+		bool same_batch = ( batch.instance_count > 0 ) &&
+			( batch.instance_count < max_batch_instances ) &&
+			( it.mesh_id == batch.mesh_id ) &&
+			( it.material_id == batch.material_id ) &&
+			( it.pass == batch.pass );
+
+		if ( same_batch ) {
+			batch.instance_count += 1;
+			continue;
+		}
+
+		if ( batch.instance_count > 0 ) {
+			array_add( out_batches, batch );
+			batches_added += 1;
+		}
+
+		batch = Renderer_Instance_Batch {
+			.mesh_id = it.mesh_id,
+			.material_id = it.material_id,
+			.pass = it.pass,
+			.first_instance = it_index,
+			.instance_count = 1
+		};
+	}}
+
+	if ( batch.instance_count > 0 ) {
+		array_add( out_batches, batch );
+		batches_added += 1;
+	}
+
+	return batches_added;
+}
+
+void renderer_batches_write_instance_indices( ArrayView< Renderer_Render_Command > commands, u32 *out_instance_indices ) {
+	ForIt( commands.data, commands.size ) {
+		out_instance_indices[ it_index ] = it.instance_idx;
+	}}
+}
+
+u32 renderer_indirect_draws_build( ArrayView< Renderer_Instance_Batch > batches, Renderer_Mesh_Geometry_Lookup lookup, Array< Renderer_Draw_Elements_Indirect_Command > *out_commands, Array< Renderer_Indirect_Draw > *out_draws ) {
+	u32 draws_added = 0;
+	Renderer_Indirect_Draw draw = { 0 };
+	Renderer_Render_Pass draw_pass = RendererRenderPass_COUNT;
+	ForIt( batches.data, batches.size ) {
+		Renderer_Mesh_Geometry geometry;
+		if ( !lookup( it.mesh_id, &geometry ) )
+			continue;
+
+		bool same_draw = ( draw.command_count > 0 ) &&
+			( it.pass == draw_pass ) &&
+			( geometry.geometry_pool_id == draw.geometry_pool_id );
+
+		if ( !same_draw ) {
+			if ( draw.command_count > 0 ) {
+				array_add( out_draws, draw );
+				draws_added += 1;
+			}
+
+			draw = Renderer_Indirect_Draw {
+				.geometry_pool_id = geometry.geometry_pool_id,
+				.first_command = out_commands->size,
+				.command_count = 0
+			};
+			draw_pass = it.pass;
+		}
+
+		array_add( out_commands, Renderer_Draw_Elements_Indirect_Command {
+			.index_count = geometry.index_count,
+			.instance_count = it.instance_count,
+			.first_index = geometry.first_index,
+			.base_vertex = ( s32 )geometry.base_vertex,
+			.base_instance = it.first_instance
+		} );
+		draw.command_count += 1;
+	}}
+
+	if ( draw.command_count > 0 ) {
+		array_add( out_draws, draw );
+		draws_added += 1;
+	}
+
+	return draws_added;
+}
+
+// --- Test
+
+struct Renderer_Batches_Test_Run {
+	Mesh_ID mesh_id;
+	Material_ID material_id;
+	u32 count;
+};
+
+static bool
+renderer_batches_equal( Array< Renderer_Instance_Batch > *batches, Renderer_Instance_Batch *expected, u32 expected_count ) {
+	if ( batches->size != expected_count )
+		return false;
+	ForIt( batches->data, batches->size ) {
+		Renderer_Instance_Batch *other = &expected[ it_index ];
+		if ( it.mesh_id != other->mesh_id || it.material_id != other->material_id || it.pass != other->pass ||
+			it.first_instance != other->first_instance || it.instance_count != other->instance_count )
+			return false;
+	}}
+	return true;
+}
+
+Renderer_Batches_Test renderer_batches_test() {
+	Renderer_Batches_Test test = { 0 };
+	// Sorted like the queue: the same mesh with another material, or the same material on
+	//   another mesh, starts a new batch.
+	Renderer_Batches_Test_Run runs[] = {
+		{ .mesh_id = 1, .material_id = 1, .count = 5 },
+		{ .mesh_id = 1, .material_id = 2, .count = 3 },
+		{ .mesh_id = 2, .material_id = 2, .count = 4 },
+		{ .mesh_id = 3, .material_id = 1, .count = 1 },
+		{ .mesh_id = 3, .material_id = 2, .count = 10 }
+	};
+	constexpr u32 MAX_BATCH_INSTANCES = 4;
+
+	Array< Renderer_Render_Command > commands = array_new< Renderer_Render_Command >( sys_allocator, 32 );
+	Array< Renderer_Instance_Batch > expected = array_new< Renderer_Instance_Batch >( sys_allocator, ARRAY_SIZE( runs ) );
+	Array< Renderer_Instance_Batch > expected_split = array_new< Renderer_Instance_Batch >( sys_allocator, 16 );
+	ForIt( runs, ARRAY_SIZE( runs ) ) {
+		Renderer_Instance_Batch batch = {
+			.mesh_id = it.mesh_id,
+			.material_id = it.material_id,
+			.pass = RendererRenderPass_Opaque,
+			.first_instance = commands.size,
+			.instance_count = it.count
+		};
+		array_add( &expected, batch );
+		for ( u32 first = 0; first < it.count; first += MAX_BATCH_INSTANCES ) {
+			Renderer_Instance_Batch split = batch;
+			split.first_instance += first;
+			split.instance_count = QL_min2( it.count - first, MAX_BATCH_INSTANCES );
+			array_add( &expected_split, split );
+		}
+
+		For2( it.count ) {
+			array_add( &commands, Renderer_Render_Command {
+				.mesh_id = it.mesh_id,
+				.material_id = it.material_id,
+				.pass = RendererRenderPass_Opaque,
+				// Slots out of the queue order, as proxies are after they move.
+				.instance_idx = 1000 - commands.size * 7
+			} );
+		}
+	}}
+	test.commands_count = commands.size;
+
+	Array< Renderer_Instance_Batch > batches = array_new< Renderer_Instance_Batch >( sys_allocator, 16 );
+	test.batches_count = renderer_batches_build( array_view( &commands ), &batches );
+	test.batches_expected = ( test.batches_count == batches.size ) && renderer_batches_equal( &batches, expected.data, expected.size );
+
+	array_clear( &batches );
+	test.split_batches_count = renderer_batches_build( array_view( &commands ), &batches, MAX_BATCH_INSTANCES );
+	test.split_expected = ( test.split_batches_count == batches.size ) && renderer_batches_equal( &batches, expected_split.data, expected_split.size );
+
+	Array< u32 > instance_indices = array_new< u32 >( sys_allocator, commands.size );
+	array_resize( &instance_indices, commands.size );
+	renderer_batches_write_instance_indices( array_view( &commands ), instance_indices.data );
+	test.indices_expected = true;
+	ForIt( commands.data, commands.size ) {
+		test.indices_expected &= ( instance_indices.data[ it_index ] == it.instance_idx );
+	}}
+
+	array_free( &commands );
+	array_free( &expected );
+	array_free( &expected_split );
+	array_free( &batches );
+	array_free( &instance_indices );
+	return test;
+}
+
+// Meshes 1 and 2 share pool 0, mesh 3 is alone in pool 1, mesh 4 is not uploaded.
+static bool
+renderer_indirect_draws_test_lookup( Mesh_ID mesh_id, Renderer_Mesh_Geometry *out_geometry ) {
+	static const Renderer_Mesh_Geometry geometries[] = {
+		{ .geometry_pool_id = 0, .base_vertex = 0, .first_index = 0, .index_count = 36 },
+		{ .geometry_pool_id = 0, .base_vertex = 24, .first_index = 36, .index_count = 6 },
+		{ .geometry_pool_id = 1, .base_vertex = 0, .first_index = 0, .index_count = 12 }
+	};
+	if ( mesh_id < 1 || mesh_id > ARRAY_SIZE( geometries ) )
+		return false;
+
+	*out_geometry = geometries[ mesh_id - 1 ];
+	return true;
+}
+
+Renderer_Indirect_Draws_Test renderer_indirect_draws_test() {
+	Renderer_Indirect_Draws_Test test = { 0 };
+	Renderer_Instance_Batch batches[] = {
+		{ .mesh_id = 1, .material_id = 1, .pass = RendererRenderPass_Opaque, .first_instance = 0, .instance_count = 3 },
+		{ .mesh_id = 2, .material_id = 1, .pass = RendererRenderPass_Opaque, .first_instance = 3, .instance_count = 2 },
+		{ .mesh_id = 4, .material_id = 1, .pass = RendererRenderPass_Opaque, .first_instance = 5, .instance_count = 1 },
+		{ .mesh_id = 3, .material_id = 2, .pass = RendererRenderPass_Opaque, .first_instance = 6, .instance_count = 4 },
+		{ .mesh_id = 1, .material_id = 2, .pass = RendererRenderPass_Opaque, .first_instance = 10, .instance_count = 1 }
+	};
+	Renderer_Draw_Elements_Indirect_Command expected_commands[] = {
+		{ .index_count = 36, .instance_count = 3, .first_index = 0, .base_vertex = 0, .base_instance = 0 },
+		{ .index_count = 6, .instance_count = 2, .first_index = 36, .base_vertex = 24, .base_instance = 3 },
+		{ .index_count = 12, .instance_count = 4, .first_index = 0, .base_vertex = 0, .base_instance = 6 },
+		{ .index_count = 36, .instance_count = 1, .first_index = 0, .base_vertex = 0, .base_instance = 10 }
+	};
+	Renderer_Indirect_Draw expected_draws[] = {
+		{ .geometry_pool_id = 0, .first_command = 0, .command_count = 2 },
+		{ .geometry_pool_id = 1, .first_command = 2, .command_count = 1 },
+		{ .geometry_pool_id = 0, .first_command = 3, .command_count = 1 }
+	};
+	test.batches_count = ARRAY_SIZE( batches );
+
+	Array< Renderer_Draw_Elements_Indirect_Command > commands = array_new< Renderer_Draw_Elements_Indirect_Command >( sys_allocator, 8 );
+	Array< Renderer_Indirect_Draw > draws = array_new< Renderer_Indirect_Draw >( sys_allocator, 8 );
+	test.draws_count = renderer_indirect_draws_build( ArrayView< Renderer_Instance_Batch > { ARRAY_SIZE( batches ), batches }, renderer_indirect_draws_test_lookup, &commands, &draws );
+	test.commands_count = commands.size;
+
+	test.commands_expected = ( commands.size == ARRAY_SIZE( expected_commands ) );
+	ForIt( commands.data, QL_min2( commands.size, ( u32 )( ARRAY_SIZE( expected_commands ) ) ) ) {
+		Renderer_Draw_Elements_Indirect_Command *other = &expected_commands[ it_index ];
+		test.commands_expected &= ( it.index_count == other->index_count ) &&
+			( it.instance_count == other->instance_count ) &&
+			( it.first_index == other->first_index ) &&
+			( it.base_vertex == other->base_vertex ) &&
+			( it.base_instance == other->base_instance );
+	}}
+
+	test.draws_expected = ( test.draws_count == draws.size ) && ( draws.size == ARRAY_SIZE( expected_draws ) );
+	ForIt( draws.data, QL_min2( draws.size, ( u32 )( ARRAY_SIZE( expected_draws ) ) ) ) {
+		Renderer_Indirect_Draw *other = &expected_draws[ it_index ];
+		test.draws_expected &= ( it.geometry_pool_id == other->geometry_pool_id ) &&
+			( it.first_command == other->first_command ) &&
+			( it.command_count == other->command_count );
+	}}
+
+	array_free( &commands );
+	array_free( &draws );
+	return test;
+}
@@ -0,0 +1,100 @@
+#ifndef QLIGHT_RENDERER_BATCH_H
+#define QLIGHT_RENDERER_BATCH_H
+
+#include "renderer.h"
+#include "renderer_geometry.h"
+
+/*
+	CPU-side batching of the sorted render queue.
+	Consecutive commands with the same pass, mesh and material are merged into
+	  a single instanced draw.  Consecutive batches whose meshes share a geometry
+	  pool are then submitted as a single multi-draw, whatever their materials:
+	  shaders look material parameters up by the instance's material ID.
+	Nothing here touches OpenGL.
+*/
+
+struct Renderer_Instance_Batch {
+	Mesh_ID mesh_id;
+	Material_ID material_id;
+	Renderer_Render_Pass pass;
+	// Index of the first command in the sorted queue.
+	// Instance indices are written in the queue order, so it is the first instance index too.
+	u32 first_instance;
+	u32 instance_count;
+};
+
+// Per-instance data as seen by `geometry_vertex.glsl` (std430).
+// Retained in the render proxies' order and looked up through the per-frame instance indices.
+struct Renderer_Instance_Data {
+	Matrix4x4_f32 model_matrix;
+	// Columns of the 3x3 normal matrix, `w` is std430 padding.
+	Vector4_f32 normal_matrix[ 3 ];
+	u32 material_id;
+	u32 _padding0[ 3 ];
+};
+static_assert( sizeof( Renderer_Instance_Data ) == 128, "Renderer_Instance_Data must match std430 layout" );
+
+// Same layout as OpenGL's `DrawElementsIndirectCommand`.
+struct Renderer_Draw_Elements_Indirect_Command {
+	u32 index_count;
+	u32 instance_count;
+	u32 first_index;
+	s32 base_vertex;
+	u32 base_instance;
+};
+static_assert( sizeof( Renderer_Draw_Elements_Indirect_Command ) == 20, "Renderer_Draw_Elements_Indirect_Command must match OpenGL layout" );
+
+// Consecutive indirect commands drawn with one `glMultiDrawElementsIndirect`.
+struct Renderer_Indirect_Draw {
+	Geometry_Pool_ID geometry_pool_id;
+	u32 first_command;
+	u32 command_count;
+};
+
+// Where a mesh's data is in the shared geometry buffers.
+struct Renderer_Mesh_Geometry {
+	Geometry_Pool_ID geometry_pool_id;
+	u32 base_vertex;
+	u32 first_index;
+	u32 index_count;
+};
+
+// Returns false if the mesh is not uploaded, such batches are skipped.
+typedef bool ( *Renderer_Mesh_Geometry_Lookup )( Mesh_ID mesh_id, Renderer_Mesh_Geometry *out_geometry );
+
+// Splits the sorted `commands` into batches, appending them to `out_batches`.
+// Returns the number of batches added.
+u32 renderer_batches_build( ArrayView< Renderer_Render_Command > commands, Array< Renderer_Instance_Batch > *out_batches, u32 max_batch_instances = U32_MAX );
+
+// Writes where the instance data of `commands` is, in the same order.
+// `out_instance_indices` must have room for `commands.size` items.
+void renderer_batches_write_instance_indices( ArrayView< Renderer_Render_Command > commands, u32 *out_instance_indices );
+
+// Turns `batches` into indirect commands and groups them into multi-draws, appending to `out_commands` and `out_draws`.
+// Returns the number of draws added.
+u32 renderer_indirect_draws_build( ArrayView< Renderer_Instance_Batch > batches, Renderer_Mesh_Geometry_Lookup lookup, Array< Renderer_Draw_Elements_Indirect_Command > *out_commands, Array< Renderer_Indirect_Draw > *out_draws );
+
+struct Renderer_Batches_Test {
+	u32 commands_count;       // Draw calls without batching, one per command.
+	u32 batches_count;        // Draw calls after merging.
+	u32 split_batches_count;  // Draw calls with `max_batch_instances` below the longest run.
+	bool batches_expected;    // Runs merged with the right first instance and instance count.
+	bool split_expected;
+	bool indices_expected;    // Instance indices written in the command order.
+};
+
+// Batches a fixed sorted queue of runs of shared mesh and material, once whole and once split.
+Renderer_Batches_Test renderer_batches_test();
+
+struct Renderer_Indirect_Draws_Test {
+	u32 batches_count;
+	u32 commands_count;
+	u32 draws_count;
+	bool commands_expected;  // Counts, base vertex, first index and base instance taken from the right mesh and batch.
+	bool draws_expected;     // Split where the geometry pool changes, batches of meshes not uploaded skipped.
+};
+
+// Turns a fixed list of batches over meshes in two geometry pools into indirect commands.
+Renderer_Indirect_Draws_Test renderer_indirect_draws_test();
+
+#endif /* QLIGHT_RENDERER_BATCH_H */
@@ -0,0 +1,916 @@
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "renderer_capture.h"
+
+#define QL_LOG_CHANNEL "Renderer"
+#include "log.h"
+
+constexpr u32 RENDERER_CAPTURE_MAGIC = 0x50434C51;  // "QLCP"
+constexpr u32 RENDERER_CAPTURE_VERSION = 1;
+
+struct Capture_File_Header {
+	u32 magic;
+	u32 version;
+	u32 frames_count;
+	u32 calls_count;
+};
+
+// Every record starts with this, `arguments_size` bytes of arguments and `data_size` bytes of data follow.
+struct Capture_Record {
+	Renderer_Capture_Call call;
+	u8 _padding0;
+	u16 arguments_size;
+	u32 data_size;
+};
+
+struct Capture_Frame_Begin {
+	u64 frame_idx;
+};
+
+struct Capture_Frame_End {
+	u32 state_changes_issued;
+	u32 state_changes_elided;
+};
+
+// Binds and capability changes: `target` is the capability for `Enable` and `Disable`, `index` the texture unit.
+struct Capture_Bind {
+	GLenum target;
+	GLuint index;
+	GLuint object;
+};
+
+struct Capture_Viewport {
+	GLint x;
+	GLint y;
+	GLsizei width;
+	GLsizei height;
+};
+
+// The value follows as data.
+struct Capture_Set_Uniform {
+	GLuint program;
+	GLint location;
+	Renderer_Data_Type data_type;
+	u32 transpose;
+};
+
+struct Capture_Bind_Buffer_Range {
+	GLenum target;
+	GLuint index;
+	GLuint buffer;
+	u32 _padding0;
+	u64 offset;
+	u64 size;
+};
+
+// `BufferSubData` and `MappedWrite`, the bytes follow as data.
+struct Capture_Buffer_Write {
+	GLuint buffer;
+	u32 _padding0;
+	u64 offset;
+};
+
+enum Capture_Clear_Kind : u32 {
+	CaptureClearKind_Float = 0,
+	CaptureClearKind_UnsignedInt,
+	CaptureClearKind_DepthStencil
+};
+
+struct Capture_Clear_Framebuffer {
+	GLuint framebuffer;
+	GLenum buffer;
+	GLint drawbuffer;
+	Capture_Clear_Kind kind;
+	union {
+		GLfloat f32[ 4 ];
+		GLuint u32[ 4 ];
+	} value;
+	GLfloat depth;
+	GLint stencil;
+};
+
+struct Capture_Draw_Elements {
+	GLenum mode;
+	GLsizei count;
+	GLenum type;
+	GLsizei instance_count;
+	u64 indices_offset;
+	GLint base_vertex;
+	GLuint base_instance;
+};
+
+struct Capture_Multi_Draw_Elements_Indirect {
+	GLenum mode;
+	GLenum type;
+	u64 indirect_offset;
+	GLsizei draw_count;
+	GLsizei stride;
+};
+
+// The pixels follow as data.
+struct Capture_Texture_Sub_Image_2D {
+	GLuint texture;
+	GLint level;
+	GLint x;
+	GLint y;
+	GLsizei width;
+	GLsizei height;
+	GLenum format;
+	GLenum type;
+};
+
+struct Capture_Blit_Framebuffer {
+	GLuint source;
+	GLenum read_buffer;
+	GLuint destination;
+	GLint source_rect[ 4 ];
+	GLint destination_rect[ 4 ];
+	GLbitfield mask;
+	GLenum filter;
+};
+
+struct G_Renderer_Capture {
+	FILE *file;
+	u32 frames_left;
+	Capture_File_Header header;
+
+	// The state cache records through a wrapping dispatch, this is the one it had before.
+	OpenGL_State *state;
+	OpenGL_State_Dispatch forward;
+} g_capture;
+
+StringView_ASCII
+renderer_capture_call_name( Renderer_Capture_Call call ) {
+	switch ( call ) {
+		case RendererCaptureCall_FrameBegin:                 return "Frame begin";
+		case RendererCaptureCall_FrameEnd:                   return "Frame end";
+		case RendererCaptureCall_UseProgram:                 return "glUseProgram";
+		case RendererCaptureCall_BindVertexArray:            return "glBindVertexArray";
+		case RendererCaptureCall_BindTextureUnit:            return "glBindTextureUnit";
+		case RendererCaptureCall_BindFramebuffer:            return "glBindFramebuffer";
+		case RendererCaptureCall_Viewport:                   return "glViewport";
+		case RendererCaptureCall_Enable:                     return "glEnable";
+		case RendererCaptureCall_Disable:                    return "glDisable";
+		case RendererCaptureCall_SetUniform:                 return "glProgramUniform*";
+		case RendererCaptureCall_BindBufferRange:            return "glBindBufferRange";
+		case RendererCaptureCall_BindBuffer:                 return "glBindBuffer";
+		case RendererCaptureCall_BufferSubData:              return "glNamedBufferSubData";
+		case RendererCaptureCall_MappedWrite:                return "Mapped buffer write";
+		case RendererCaptureCall_ClearFramebuffer:           return "glClearNamedFramebuffer*";
+		case RendererCaptureCall_DrawElements:               return "glDrawElements*";
+		case RendererCaptureCall_MultiDrawElementsIndirect:  return "glMultiDrawElementsIndirect";
+		case RendererCaptureCall_TextureSubImage2D:          return "glTextureSubImage2D";
+		case RendererCaptureCall_GenerateTextureMipmap:      return "glGenerateTextureMipmap";
+		case RendererCaptureCall_BlitFramebuffer:            return "glBlitNamedFramebuffer";
+
+		default: return "Unknown";
+	}
+}
+
+static void
+capture_record( Renderer_Capture_Call call, const void *arguments, u32 arguments_size, const void *data = NULL, u32 data_size = 0 ) {
+	Assert( g_capture.file );
+	Capture_Record record = {
+		.call = call,
+		._padding0 = 0,
+		.arguments_size = ( u16 )arguments_size,
+		.data_size = data_size
+	};
+	fwrite( &record, sizeof( record ), 1, g_capture.file );
+	fwrite( arguments, arguments_size, 1, g_capture.file );
+	if ( data_size > 0 )
+		fwrite( data, data_size, 1, g_capture.file );
+	g_capture.header.calls_count += 1;
+}
+
+template < typename T >
+static void
+capture_record( Renderer_Capture_Call call, T arguments, const void *data = NULL, u32 data_size = 0 ) {
+	capture_record( call, &arguments, sizeof( T ), data, data_size );
+}
+
+static void GLAPIENTRY
+capture_use_program( GLuint program ) {
+	capture_record( RendererCaptureCall_UseProgram, Capture_Bind { .object = program } );
+	g_capture.forward.use_program( program );
+}
+
+static void GLAPIENTRY
+capture_bind_vertex_array( GLuint vertex_array ) {
+	capture_record( RendererCaptureCall_BindVertexArray, Capture_Bind { .object = vertex_array } );
+	g_capture.forward.bind_vertex_array( vertex_array );
+}
+
+static void GLAPIENTRY
+capture_bind_texture_unit( GLuint unit, GLuint texture ) {
+	capture_record( RendererCaptureCall_BindTextureUnit, Capture_Bind { .index = unit, .object = texture } );
+	g_capture.forward.bind_texture_unit( unit, texture );
+}
+
+static void GLAPIENTRY
+capture_bind_framebuffer( GLenum target, GLuint framebuffer ) {
+	capture_record( RendererCaptureCall_BindFramebuffer, Capture_Bind { .target = target, .object = framebuffer } );
+	g_capture.forward.bind_framebuffer( target, framebuffer );
+}
+
+static void GLAPIENTRY
+capture_viewport( GLint x, GLint y, GLsizei width, GLsizei height ) {
+	capture_record( RendererCaptureCall_Viewport, Capture_Viewport { x, y, width, height } );
+	g_capture.forward.viewport( x, y, width, height );
+}
+
+static void GLAPIENTRY
+capture_enable( GLenum capability ) {
+	capture_record( RendererCaptureCall_Enable, Capture_Bind { .target = capability } );
+	g_capture.forward.enable( capability );
+}
+
+static void GLAPIENTRY
+capture_disable( GLenum capability ) {
+	capture_record( RendererCaptureCall_Disable, Capture_Bind { .target = capability } );
+	g_capture.forward.disable( capability );
+}
+
+bool
+renderer_capture_begin( const char *file_path, u32 frames_count, OpenGL_State *state ) {
+	if ( g_capture.file ) {
+		log_warning( "A capture is already being recorded, '%s' is not started.", file_path );
+		return false;
+	}
+
+	FILE *file = fopen( file_path, "wb" );
+	if ( !file ) {
+		log_error( "Failed to open capture file '%s'.", file_path );
+		return false;
+	}
+
+	g_capture.file = file;
+	g_capture.frames_left = frames_count;
+	g_capture.header = Capture_File_Header {
+		.magic = RENDERER_CAPTURE_MAGIC,
+		.version = RENDERER_CAPTURE_VERSION,
+		.frames_count = 0,
+		.calls_count = 0
+	};
+	// Rewritten with the final counts when the capture ends.
+	fwrite( &g_capture.header, sizeof( g_capture.header ), 1, file );
+
+	g_capture.state = state;
+	g_capture.forward = state->dispatch;
+	state->dispatch = OpenGL_State_Dispatch {
+		.use_program = capture_use_program,
+		.bind_vertex_array = capture_bind_vertex_array,
+		.bind_texture_unit = capture_bind_texture_unit,
+		.bind_framebuffer = capture_bind_framebuffer,
+		.viewport = capture_viewport,
+		.enable = capture_enable,
+		.disable = capture_disable
+	};
+
+	log_info( "Capturing %u frames into '%s'.", frames_count, file_path );
+	return true;
+}
+
+void
+renderer_capture_end() {
+	if ( !g_capture.file )
+		return;
+
+	g_capture.state->dispatch = g_capture.forward;
+	g_capture.state = NULL;
+
+	fseek( g_capture.file, 0, SEEK_SET );
+	fwrite( &g_capture.header, sizeof( g_capture.header ), 1, g_capture.file );
+	fclose( g_capture.file );
+	g_capture.file = NULL;
+
+	log_info( "Capture finished: %u frames, %u calls.", g_capture.header.frames_count, g_capture.header.calls_count );
+}
+
+bool
+renderer_capture_active() {
+	return g_capture.file != NULL;
+}
+
+void
+renderer_capture_frame_begin( u64 frame_idx ) {
+	capture_record( RendererCaptureCall_FrameBegin, Capture_Frame_Begin { frame_idx } );
+}
+
+void
+renderer_capture_frame_end( OpenGL_State_Counters state_changes ) {
+	capture_record( RendererCaptureCall_FrameEnd, Capture_Frame_End { state_changes.issued, state_changes.elided } );
+	g_capture.header.frames_count += 1;
+	g_capture.frames_left -= QL_min2( g_capture.frames_left, 1u );
+	if ( g_capture.frames_left == 0 )
+		renderer_capture_end();
+}
+
+void
+renderer_capture_set_uniform( GLuint program, GLint location, Renderer_Data_Type data_type, bool transpose, const void *value ) {
+	Capture_Set_Uniform arguments = {
+		.program = program,
+		.location = location,
+		.data_type = data_type,
+		.transpose = transpose
+	};
+	capture_record( RendererCaptureCall_SetUniform, arguments, value, renderer_data_type_size( data_type ) );
+}
+
+void
+renderer_capture_bind_buffer_range( GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size ) {
+	Capture_Bind_Buffer_Range arguments = {
+		.target = target,
+		.index = index,
+		.buffer = buffer,
+		._padding0 = 0,
+		.offset = ( u64 )offset,
+		.size = ( u64 )size
+	};
+	capture_record( RendererCaptureCall_BindBufferRange, arguments );
+}
+
+void
+renderer_capture_bind_buffer( GLenum target, GLuint buffer ) {
+	capture_record( RendererCaptureCall_BindBuffer, Capture_Bind { .target = target, .object = buffer } );
+}
+
+void
+renderer_capture_buffer_sub_data( GLuint buffer, GLintptr offset, GLsizeiptr size, const void *data ) {
+	capture_record( RendererCaptureCall_BufferSubData, Capture_Buffer_Write { buffer, 0, ( u64 )offset }, data, ( u32 )size );
+}
+
+void
+renderer_capture_mapped_write( GLuint buffer, u32 offset, u32 size, const void *data ) {
+	capture_record( RendererCaptureCall_MappedWrite, Capture_Buffer_Write { buffer, 0, offset }, data, size );
+}
+
+void
+renderer_capture_clear_framebuffer_fv( GLuint framebuffer, GLenum buffer, GLint drawbuffer, const GLfloat *value ) {
+	Capture_Clear_Framebuffer arguments = {
+		.framebuffer = framebuffer,
+		.buffer = buffer,
+		.drawbuffer = drawbuffer,
+		.kind = CaptureClearKind_Float
+	};
+	memcpy( arguments.value.f32, value, sizeof( arguments.value.f32 ) );
+	capture_record( RendererCaptureCall_ClearFramebuffer, arguments );
+}
+
+void
+renderer_capture_clear_framebuffer_uiv( GLuint framebuffer, GLenum buffer, GLint drawbuffer, const GLuint *value ) {
+	Capture_Clear_Framebuffer arguments = {
+		.framebuffer = framebuffer,
+		.buffer = buffer,
+		.drawbuffer = drawbuffer,
+		.kind = CaptureClearKind_UnsignedInt
+	};
+	memcpy( arguments.value.u32, value, sizeof( arguments.value.u32 ) );
+	capture_record( RendererCaptureCall_ClearFramebuffer, arguments );
+}
+
+void
+renderer_capture_clear_framebuffer_fi( GLuint framebuffer, GLenum buffer, GLint drawbuffer, GLfloat depth, GLint stencil ) {
+	Capture_Clear_Framebuffer arguments = {
+		.framebuffer = framebuffer,
+		.buffer = buffer,
+		.drawbuffer = drawbuffer,
+		.kind = CaptureClearKind_DepthStencil,
+		.depth = depth,
+		.stencil = stencil
+	};
+	capture_record( RendererCaptureCall_ClearFramebuffer, arguments );
+}
+
+void
+renderer_capture_draw_elements( GLenum mode, GLsizei count, GLenum type, u64 indices_offset, GLsizei instance_count, GLint base_vertex, GLuint base_instance ) {
+	Capture_Draw_Elements arguments = {
+		.mode = mode,
+		.count = count,
+		.type = type,
+		.instance_count = instance_count,
+		.indices_offset = indices_offset,
+		.base_vertex = base_vertex,
+		.base_instance = base_instance
+	};
+	capture_record( RendererCaptureCall_DrawElements, arguments );
+}
+
+void
+renderer_capture_multi_draw_elements_indirect( GLenum mode, GLenum type, u64 indirect_offset, GLsizei draw_count, GLsizei stride ) {
+	Capture_Multi_Draw_Elements_Indirect arguments = {
+		.mode = mode,
+		.type = type,
+		.indirect_offset = indirect_offset,
+		.draw_count = draw_count,
+		.stride = stride
+	};
+	capture_record( RendererCaptureCall_MultiDrawElementsIndirect, arguments );
+}
+
+void
+renderer_capture_texture_sub_image_2d( GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *pixels, u32 pixels_size ) {
+	Capture_Texture_Sub_Image_2D arguments = {
+		.texture = texture,
+		.level = level,
+		.x = x,
+		.y = y,
+		.width = width,
+		.height = height,
+		.format = format,
+		.type = type
+	};
+	capture_record( RendererCaptureCall_TextureSubImage2D, arguments, pixels, pixels_size );
+}
+
+void
+renderer_capture_generate_texture_mipmap( GLuint texture ) {
+	capture_record( RendererCaptureCall_GenerateTextureMipmap, Capture_Bind { .object = texture } );
+}
+
+void
+renderer_capture_blit_framebuffer( GLuint source, GLenum read_buffer, GLuint destination, GLint source_rect[ 4 ], GLint destination_rect[ 4 ], GLbitfield mask, GLenum filter ) {
+	Capture_Blit_Framebuffer arguments = {
+		.source = source,
+		.read_buffer = read_buffer,
+		.destination = destination,
+		.mask = mask,
+		.filter = filter
+	};
+	memcpy( arguments.source_rect, source_rect, sizeof( arguments.source_rect ) );
+	memcpy( arguments.destination_rect, destination_rect, sizeof( arguments.destination_rect ) );
+	capture_record( RendererCaptureCall_BlitFramebuffer, arguments );
+}
+
+/*
+	Replay
+*/
+
+// Last value set for a piece of state: a bind point, a capability, a uniform.
+struct Replay_Binding {
+	Renderer_Capture_Call call;
+	GLenum target;
+	GLuint index;
+	u32 value_size;
+	u8 value[ RENDERER_UNIFORM_SHADOW_VALUE_SIZE ];
+};
+
+struct Replay_State {
+	bool opengl;  // False on the null backend and in the test, calls are only decoded then.
+	// Forgotten at every frame's beginning, uniforms are kept by their programs and stay.
+	Array< Replay_Binding > bindings;
+	Array< Replay_Binding > uniforms;
+};
+
+// Sets the state and returns true if it already had the value.
+static bool
+replay_binding_set( Array< Replay_Binding > *bindings, Renderer_Capture_Call call, GLenum target, GLuint index, const void *value, u32 value_size ) {
+	Assert( value_size <= RENDERER_UNIFORM_SHADOW_VALUE_SIZE );
+	value_size = QL_min2( value_size, RENDERER_UNIFORM_SHADOW_VALUE_SIZE );
+	ForIt( bindings->data, bindings->size ) {
+		if ( it.call != call || it.target != target || it.index != index )
+			continue;
+
+		bool same = ( it.value_size == value_size ) && ( memcmp( it.value, value, value_size ) == 0 );
+		it.value_size = value_size;
+		memcpy( it.value, value, value_size );
+		return same;
+	}}
+
+	Replay_Binding binding = {
+		.call = call,
+		.target = target,
+		.index = index,
+		.value_size = value_size
+	};
+	memcpy( binding.value, value, value_size );
+	array_add( bindings, binding );
+	return false;
+}
+
+// Whether the call sets what is already set.  Runs before the call, outside of its timing.
+static bool
+replay_call_is_redundant( Replay_State *state, Capture_Record *record, u8 *arguments, u8 *data ) {
+	switch ( record->call ) {
+		case RendererCaptureCall_UseProgram:
+		case RendererCaptureCall_BindVertexArray:
+		case RendererCaptureCall_BindTextureUnit:
+		case RendererCaptureCall_BindFramebuffer:
+		case RendererCaptureCall_BindBuffer: {
+			Capture_Bind *bind = ( Capture_Bind * )arguments;
+			return replay_binding_set( &state->bindings, record->call, bind->target, bind->index, &bind->object, sizeof( bind->object ) );
+		}
+
+		case RendererCaptureCall_Enable:
+		case RendererCaptureCall_Disable: {
+			Capture_Bind *bind = ( Capture_Bind * )arguments;
+			bool enabled = ( record->call == RendererCaptureCall_Enable );
+			return replay_binding_set( &state->bindings, RendererCaptureCall_Enable, bind->target, 0, &enabled, sizeof( enabled ) );
+		}
+
+		case RendererCaptureCall_Viewport:
+			return replay_binding_set( &state->bindings, record->call, 0, 0, arguments, sizeof( Capture_Viewport ) );
+
+		case RendererCaptureCall_BindBufferRange: {
+			Capture_Bind_Buffer_Range *bind = ( Capture_Bind_Buffer_Range * )arguments;
+			u64 value[ 3 ] = { bind->buffer, bind->offset, bind->size };
+			return replay_binding_set( &state->bindings, record->call, bind->target, bind->index, value, sizeof( value ) );
+		}
+
+		case RendererCaptureCall_SetUniform: {
+			Capture_Set_Uniform *uniform = ( Capture_Set_Uniform * )arguments;
+			return replay_binding_set( &state->uniforms, record->call, uniform->program, ( GLuint )uniform->location, data, record->data_size );
+		}
+
+		default:
+			return false;
+	}
+}
+
+// Of the call's arguments struct, every record of the call must have exactly this many bytes of arguments.
+static u32
+capture_call_arguments_size( Renderer_Capture_Call call ) {
+	switch ( call ) {
+		case RendererCaptureCall_FrameBegin:                 return sizeof( Capture_Frame_Begin );
+		case RendererCaptureCall_FrameEnd:                   return sizeof( Capture_Frame_End );
+		case RendererCaptureCall_UseProgram:
+		case RendererCaptureCall_BindVertexArray:
+		case RendererCaptureCall_BindTextureUnit:
+		case RendererCaptureCall_BindFramebuffer:
+		case RendererCaptureCall_Enable:
+		case RendererCaptureCall_Disable:
+		case RendererCaptureCall_BindBuffer:
+		case RendererCaptureCall_GenerateTextureMipmap:      return sizeof( Capture_Bind );
+		case RendererCaptureCall_Viewport:                   return sizeof( Capture_Viewport );
+		case RendererCaptureCall_SetUniform:                 return sizeof( Capture_Set_Uniform );
+		case RendererCaptureCall_BindBufferRange:            return sizeof( Capture_Bind_Buffer_Range );
+		case RendererCaptureCall_BufferSubData:
+		case RendererCaptureCall_MappedWrite:                return sizeof( Capture_Buffer_Write );
+		case RendererCaptureCall_ClearFramebuffer:           return sizeof( Capture_Clear_Framebuffer );
+		case RendererCaptureCall_DrawElements:               return sizeof( Capture_Draw_Elements );
+		case RendererCaptureCall_MultiDrawElementsIndirect:  return sizeof( Capture_Multi_Draw_Elements_Indirect );
+		case RendererCaptureCall_TextureSubImage2D:          return sizeof( Capture_Texture_Sub_Image_2D );
+		case RendererCaptureCall_BlitFramebuffer:            return sizeof( Capture_Blit_Framebuffer );
+		default:                                             return 0;
+	}
+}
+
+// Whether the record's arguments and data can be read as its call's, so a damaged capture never
+//   makes the replay read or write past them.
+static bool
+replay_record_is_valid( const char *name, Capture_Record *record, u8 *arguments ) {
+	u32 arguments_size = capture_call_arguments_size( record->call );
+	if ( record->arguments_size != arguments_size ) {
+		log_error( "Capture '%s': '" StringViewFormat "' record has %u bytes of arguments instead of %u, skipped.",
+			name,
+			StringViewArgument( renderer_capture_call_name( record->call ) ),
+			( u32 )record->arguments_size,
+			arguments_size
+		);
+		return false;
+	}
+
+	if ( record->call == RendererCaptureCall_SetUniform ) {
+		Capture_Set_Uniform *uniform = ( Capture_Set_Uniform * )arguments;
+		u32 value_size = renderer_data_type_size( uniform->data_type );
+		if ( value_size == 0 || record->data_size != value_size || value_size > RENDERER_UNIFORM_SHADOW_VALUE_SIZE ) {
+			log_error( "Capture '%s': uniform value of %u bytes does not fit its data type, skipped.", name, record->data_size );
+			return false;
+		}
+	} else if ( record->call == RendererCaptureCall_MappedWrite ) {
+		Capture_Buffer_Write *write = ( Capture_Buffer_Write * )arguments;
+		u64 mapped_size;
+		u8 *mapped = renderer_mapped_buffer_memory( write->buffer, &mapped_size );
+		if ( mapped && ( write->offset > mapped_size || record->data_size > mapped_size - write->offset ) ) {
+			log_error( "Capture '%s': mapped write of %u bytes at %llu is past the %llu bytes mapped, skipped.",
+				name,
+				record->data_size,
+				( unsigned long long )write->offset,
+				( unsigned long long )mapped_size
+			);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+#ifndef QLIGHT_HEADLESS
+static void
+replay_set_uniform( Capture_Set_Uniform *uniform, void *value ) {
+	GLuint program = uniform->program;
+	GLint location = uniform->location;
+	GLboolean transpose = ( GLboolean )uniform->transpose;
+	switch ( uniform->data_type ) {
+		case RendererDataType_s32:           glProgramUniform1i( program, location, *( s32 * )value ); break;
+		case RendererDataType_u32:           glProgramUniform1ui( program, location, *( u32 * )value ); break;
+		case RendererDataType_f32:           glProgramUniform1f( program, location, *( f32 * )value ); break;
+		case RendererDataType_Vector2_f32:   glProgramUniform2fv( program, location, 1, ( f32 * )value ); break;
+		case RendererDataType_Vector3_f32:   glProgramUniform3fv( program, location, 1, ( f32 * )value ); break;
+		case RendererDataType_Vector4_f32:   glProgramUniform4fv( program, location, 1, ( f32 * )value ); break;
+		case RendererDataType_Matrix3x3_f32: glProgramUniformMatrix3fv( program, location, 1, transpose, ( f32 * )value ); break;
+		case RendererDataType_Matrix4x4_f32: glProgramUniformMatrix4fv( program, location, 1, transpose, ( f32 * )value ); break;
+		default: break;
+	}
+}
+
+static void
+replay_call( Capture_Record *record, u8 *arguments, u8 *data ) {
+	switch ( record->call ) {
+		case RendererCaptureCall_UseProgram:
+			glUseProgram( ( ( Capture_Bind * )arguments )->object ); break;
+		case RendererCaptureCall_BindVertexArray:
+			glBindVertexArray( ( ( Capture_Bind * )arguments )->object ); break;
+		case RendererCaptureCall_BindTextureUnit: {
+			Capture_Bind *bind = ( Capture_Bind * )arguments;
+			glBindTextureUnit( bind->index, bind->object );
+		} break;
+		case RendererCaptureCall_BindFramebuffer: {
+			Capture_Bind *bind = ( Capture_Bind * )arguments;
+			glBindFramebuffer( bind->target, bind->object );
+		} break;
+		case RendererCaptureCall_Viewport: {
+			Capture_Viewport *viewport = ( Capture_Viewport * )arguments;
+			glViewport( viewport->x, viewport->y, viewport->width, viewport->height );
+		} break;
+		case RendererCaptureCall_Enable:
+			glEnable( ( ( Capture_Bind * )arguments )->target ); break;
+		case RendererCaptureCall_Disable:
+			glDisable( ( ( Capture_Bind * )arguments )->target ); break;
+		case RendererCaptureCall_SetUniform:
+			replay_set_uniform( ( Capture_Set_Uniform * )arguments, data ); break;
+		case RendererCaptureCall_BindBufferRange: {
+			Capture_Bind_Buffer_Range *bind = ( Capture_Bind_Buffer_Range * )arguments;
+			if ( bind->size == 0 )
+				glBindBufferBase( bind->target, bind->index, bind->buffer );
+			else
+				glBindBufferRange( bind->target, bind->index, bind->buffer, ( GLintptr )bind->offset, ( GLsizeiptr )bind->size );
+		} break;
+		case RendererCaptureCall_BindBuffer: {
+			Capture_Bind *bind = ( Capture_Bind * )arguments;
+			glBindBuffer( bind->target, bind->object );
+		} break;
+		case RendererCaptureCall_BufferSubData: {
+			Capture_Buffer_Write *write = ( Capture_Buffer_Write * )arguments;
+			glNamedBufferSubData( write->buffer, ( GLintptr )write->offset, ( GLsizeiptr )record->data_size, data );
+		} break;
+		case RendererCaptureCall_MappedWrite: {
+			Capture_Buffer_Write *write = ( Capture_Buffer_Write * )arguments;
+			u64 mapped_size;  // Checked by `replay_record_is_valid()`.
+			u8 *mapped = renderer_mapped_buffer_memory( write->buffer, &mapped_size );
+			if ( mapped )
+				memcpy( mapped + write->offset, data, record->data_size );
+			else
+				glNamedBufferSubData( write->buffer, ( GLintptr )write->offset, ( GLsizeiptr )record->data_size, data );
+		} break;
+		case RendererCaptureCall_ClearFramebuffer: {
+			Capture_Clear_Framebuffer *clear = ( Capture_Clear_Framebuffer * )arguments;
+			if ( clear->kind == CaptureClearKind_Float )
+				glClearNamedFramebufferfv( clear->framebuffer, clear->buffer, clear->drawbuffer, clear->value.f32 );
+			else if ( clear->kind == CaptureClearKind_UnsignedInt )
+				glClearNamedFramebufferuiv( clear->framebuffer, clear->buffer, clear->drawbuffer, clear->value.u32 );
+			else
+				glClearNamedFramebufferfi( clear->framebuffer, clear->buffer, clear->drawbuffer, clear->depth, clear->stencil );
+		} break;
+		case RendererCaptureCall_DrawElements: {
+			Capture_Draw_Elements *draw = ( Capture_Draw_Elements * )arguments;
+			glDrawElementsInstancedBaseVertexBaseInstance(
+				draw->mode,
+				draw->count,
+				draw->type,
+				( void * )draw->indices_offset,
+				draw->instance_count,
+				draw->base_vertex,
+				draw->base_instance
+			);
+		} break;
+		case RendererCaptureCall_MultiDrawElementsIndirect: {
+			Capture_Multi_Draw_Elements_Indirect *draw = ( Capture_Multi_Draw_Elements_Indirect * )arguments;
+			glMultiDrawElementsIndirect( draw->mode, draw->type, ( const void * )draw->indirect_offset, draw->draw_count, draw->stride );
+		} break;
+		case RendererCaptureCall_TextureSubImage2D: {
+			Capture_Texture_Sub_Image_2D *image = ( Capture_Texture_Sub_Image_2D * )arguments;
+			glTextureSubImage2D( image->texture, image->level, image->x, image->y, image->width, image->height, image->format, image->type, data );
+		} break;
+		case RendererCaptureCall_GenerateTextureMipmap:
+			glGenerateTextureMipmap( ( ( Capture_Bind * )arguments )->object ); break;
+		case RendererCaptureCall_BlitFramebuffer: {
+			Capture_Blit_Framebuffer *blit = ( Capture_Blit_Framebuffer * )arguments;
+			glNamedFramebufferReadBuffer( blit->source, blit->read_buffer );
+			glBlitNamedFramebuffer(
+				blit->source,
+				blit->destination,
+				blit->source_rect[ 0 ], blit->source_rect[ 1 ], blit->source_rect[ 2 ], blit->source_rect[ 3 ],
+				blit->destination_rect[ 0 ], blit->destination_rect[ 1 ], blit->destination_rect[ 2 ], blit->destination_rect[ 3 ],
+				blit->mask,
+				blit->filter
+			);
+		} break;
+
+		default:
+			break;
+	}
+}
+#endif
+
+static bool
+read_entire_file( const char *file_path, u8 **out_bytes, u64 *out_size ) {
+	FILE *file = fopen( file_path, "rb" );
+	if ( !file )
+		return false;
+
+	fseek( file, 0, SEEK_END );
+	u64 file_size = ( u64 )ftell( file );
+	rewind( file );
+
+	u8 *bytes = Allocate( sys_allocator, QL_max2( file_size, ( u64 )1 ), u8 );
+	u64 read_size = fread( bytes, 1, file_size, file );
+	fclose( file );
+
+	*out_bytes = bytes;
+	*out_size = read_size;
+	return true;
+}
+
+// `name` - of the capture, for the log.  `opengl` - make the calls, otherwise only decode them.
+static bool
+replay_capture_bytes( const char *name, u8 *bytes, u64 size, bool opengl, Renderer_Capture_Replay_Report *out_report ) {
+	*out_report = Renderer_Capture_Replay_Report { 0 };
+
+	Capture_File_Header *header = ( Capture_File_Header * )bytes;
+	if ( size < sizeof( Capture_File_Header ) || header->magic != RENDERER_CAPTURE_MAGIC || header->version != RENDERER_CAPTURE_VERSION ) {
+		log_error( "'%s' is not a capture this build can replay.", name );
+		return false;
+	}
+
+	Replay_State state = {
+		.opengl = opengl,
+		.bindings = array_new< Replay_Binding >( sys_allocator, 64 ),
+		.uniforms = array_new< Replay_Binding >( sys_allocator, 64 )
+	};
+
+	u8 *cursor = bytes + sizeof( Capture_File_Header );
+	u8 *end = bytes + size;
+	while ( cursor + sizeof( Capture_Record ) <= end ) {
+		auto call_start = std::chrono::steady_clock::now();
+		Capture_Record *record = ( Capture_Record * )cursor;
+		u8 *arguments = cursor + sizeof( Capture_Record );
+		u8 *data = arguments + record->arguments_size;
+		cursor = data + record->data_size;
+		if ( cursor > end || record->call >= RendererCaptureCall_COUNT ) {
+			log_warning( "Capture '%s' is cut short or damaged after %u calls.", name, out_report->calls_count );
+			break;
+		}
+
+		if ( !replay_record_is_valid( name, record, arguments ) ) {
+			out_report->rejected_count += 1;
+			continue;
+		}
+
+		if ( record->call == RendererCaptureCall_FrameBegin ) {
+			array_clear( &state.bindings );
+		} else if ( record->call == RendererCaptureCall_FrameEnd ) {
+			out_report->frames_count += 1;
+			out_report->captured_state_changes_elided += ( ( Capture_Frame_End * )arguments )->state_changes_elided;
+		}
+
+		Renderer_Capture_Call_Stats *stats = &out_report->calls[ record->call ];
+		stats->count += 1;
+		if ( replay_call_is_redundant( &state, record, arguments, data ) )
+			stats->redundant += 1;
+		if ( record->call != RendererCaptureCall_FrameBegin && record->call != RendererCaptureCall_FrameEnd )
+			out_report->bytes_uploaded += record->data_size;
+		out_report->calls_count += 1;
+
+		// Decoding is timed with the call, the redundancy bookkeeping above is not.
+		auto bookkeeping = std::chrono::steady_clock::now() - call_start;
+#ifndef QLIGHT_HEADLESS
+		if ( state.opengl )
+			replay_call( record, arguments, data );
+#endif
+		f64 milliseconds = std::chrono::duration< f64, std::milli >( std::chrono::steady_clock::now() - call_start - bookkeeping ).count();
+		stats->total_milliseconds += milliseconds;
+		stats->max_milliseconds = QL_max2( stats->max_milliseconds, milliseconds );
+		out_report->total_milliseconds += milliseconds;
+
+#ifndef QLIGHT_HEADLESS
+		// Mapped writes of the next frame would race the GPU still reading this one.
+		if ( state.opengl && record->call == RendererCaptureCall_FrameEnd )
+			glFinish();
+#endif
+	}
+
+	array_free( &state.bindings );
+	array_free( &state.uniforms );
+	return true;
+}
+
+bool
+renderer_capture_replay( const char *file_path, Renderer_Capture_Replay_Report *out_report ) {
+	u8 *bytes;
+	u64 size;
+	if ( !read_entire_file( file_path, &bytes, &size ) ) {
+		*out_report = Renderer_Capture_Replay_Report { 0 };
+		log_error( "Failed to open capture file '%s'.", file_path );
+		return false;
+	}
+
+	bool opengl = ( renderer_backend() == RendererBackend_OpenGL );
+	bool replayed = replay_capture_bytes( file_path, bytes, size, opengl, out_report );
+	Deallocate( sys_allocator, bytes );
+	return replayed;
+}
+
+void
+renderer_capture_replay_report_log( Renderer_Capture_Replay_Report *report ) {
+	u32 frames_count = QL_max2( report->frames_count, 1u );
+	log_info( "Replayed %u frames, %u calls, %llu bytes uploaded, %.4f ms of calls per frame.",
+		report->frames_count,
+		report->calls_count,
+		( unsigned long long )report->bytes_uploaded,
+		report->total_milliseconds / frames_count
+	);
+	ForIt( report->calls, RendererCaptureCall_COUNT ) {
+		if ( it.count == 0 || it_index == RendererCaptureCall_FrameBegin || it_index == RendererCaptureCall_FrameEnd )
+			continue;
+
+		StringView_ASCII name = renderer_capture_call_name( ( Renderer_Capture_Call )it_index );
+		log_info( "  %-28.*s %8u calls (%6.1f per frame), %6u redundant, avg %8.5f ms, max %8.5f ms, %9.4f ms total",
+			( int )name.size, name.data,
+			it.count,
+			( f64 )it.count / frames_count,
+			it.redundant,
+			it.total_milliseconds / it.count,
+			it.max_milliseconds,
+			it.total_milliseconds
+		);
+	}}
+	log_info( "State changes the state cache dropped while capturing: %u (%.1f per frame).",
+		report->captured_state_changes_elided,
+		( f64 )report->captured_state_changes_elided / frames_count
+	);
+	if ( report->rejected_count > 0 )
+		log_warning( "Damaged records skipped: %u.", report->rejected_count );
+}
+
+// --- Replay test
+
+constexpr u32 CAPTURE_TEST_BYTES_SIZE = 1024;
+
+static u8 *
+capture_test_append( u8 *cursor, Renderer_Capture_Call call, const void *arguments, u32 arguments_size, const void *data = NULL, u32 data_size = 0 ) {
+	Capture_Record record = {
+		.call = call,
+		.arguments_size = ( u16 )arguments_size,
+		.data_size = data_size
+	};
+	memcpy( cursor, &record, sizeof( record ) );
+	cursor += sizeof( record );
+	memcpy( cursor, arguments, arguments_size );
+	cursor += arguments_size;
+	if ( data_size > 0 )
+		memcpy( cursor, data, data_size );
+	return cursor + data_size;
+}
+
+Renderer_Capture_Replay_Test renderer_capture_replay_test() {
+	Renderer_Capture_Replay_Test test = { 0 };
+	u8 bytes[ CAPTURE_TEST_BYTES_SIZE ];
+	Capture_File_Header header = {
+		.magic = RENDERER_CAPTURE_MAGIC,
+		.version = RENDERER_CAPTURE_VERSION,
+		.frames_count = 1,
+		.calls_count = 6
+	};
+	memcpy( bytes, &header, sizeof( header ) );
+	u8 *cursor = bytes + sizeof( header );
+
+	Capture_Frame_Begin frame_begin = { 0 };
+	Capture_Frame_End frame_end = { 0 };
+	Capture_Viewport viewport = { 0, 0, 1280, 720 };
+	Capture_Set_Uniform matrix_uniform = { .program = 1, .location = 0, .data_type = RendererDataType_Matrix4x4_f32 };
+	Capture_Set_Uniform float_uniform = { .program = 1, .location = 1, .data_type = RendererDataType_f32 };
+	f32 value = 1.0f;
+
+	cursor = capture_test_append( cursor, RendererCaptureCall_FrameBegin, &frame_begin, sizeof( frame_begin ) );
+	cursor = capture_test_append( cursor, RendererCaptureCall_Viewport, &viewport, sizeof( viewport ) );
+	// Arguments of another call.
+	cursor = capture_test_append( cursor, RendererCaptureCall_Viewport, &frame_end, sizeof( frame_end ) );
+	test.damaged_records_count += 1;
+	// A matrix with the value of a float.
+	cursor = capture_test_append( cursor, RendererCaptureCall_SetUniform, &matrix_uniform, sizeof( matrix_uniform ), &value, sizeof( value ) );
+	test.damaged_records_count += 1;
+	cursor = capture_test_append( cursor, RendererCaptureCall_SetUniform, &float_uniform, sizeof( float_uniform ), &value, sizeof( value ) );
+	cursor = capture_test_append( cursor, RendererCaptureCall_FrameEnd, &frame_end, sizeof( frame_end ) );
+	Assert( cursor <= bytes + CAPTURE_TEST_BYTES_SIZE );
+
+	bool replayed = replay_capture_bytes( "replay test", bytes, ( u64 )( cursor - bytes ), /* opengl */ false, &test.report );
+	test.rejected_damaged = replayed &&
+		test.report.rejected_count == test.damaged_records_count &&
+		test.report.calls_count == header.calls_count - test.damaged_records_count &&
+		test.report.frames_count == 1 &&
+		test.report.calls[ RendererCaptureCall_SetUniform ].count == 1;
+	return test;
+}
@@ -0,0 +1,119 @@
+#ifndef QLIGHT_RENDERER_CAPTURE_H
+#define QLIGHT_RENDERER_CAPTURE_H
+
+#include "renderer.h"
+#include "renderer_opengl_state.h"
+
+/*
+	Capture of the OpenGL calls made while drawing frames, to replay them away from the live session.
+
+	A capture file is a header followed by one record per call: the call's arguments and
+	  the bytes it hands to OpenGL (buffer and texture contents, uniform values), so a replay
+	  needs nothing but the file and the objects it names.  Writes into persistently mapped
+	  memory are recorded as calls too.
+	The OpenGL backend records calls right where it makes them, state changes by wrapping
+	  the state cache's dispatch.  Only calls that reach OpenGL are recorded, the ones the
+	  cache dropped are counted per frame.  Resource creation and ImGui's backend are not recorded.
+
+	Object names are those of the capturing session.  Everything created at startup is
+	  created in the same order every run, so a replay set up the same way finds it;
+	  calls naming objects that do not exist in the replaying session fail in the driver.
+	Recording and replaying both happen on the thread drawing frames.
+*/
+
+enum Renderer_Capture_Call : u8 {
+	RendererCaptureCall_FrameBegin = 0,
+	RendererCaptureCall_FrameEnd,
+	RendererCaptureCall_UseProgram,
+	RendererCaptureCall_BindVertexArray,
+	RendererCaptureCall_BindTextureUnit,
+	RendererCaptureCall_BindFramebuffer,
+	RendererCaptureCall_Viewport,
+	RendererCaptureCall_Enable,
+	RendererCaptureCall_Disable,
+	RendererCaptureCall_SetUniform,
+	RendererCaptureCall_BindBufferRange,
+	RendererCaptureCall_BindBuffer,
+	RendererCaptureCall_BufferSubData,
+	RendererCaptureCall_MappedWrite,
+	RendererCaptureCall_ClearFramebuffer,
+	RendererCaptureCall_DrawElements,
+	RendererCaptureCall_MultiDrawElementsIndirect,
+	RendererCaptureCall_TextureSubImage2D,
+	RendererCaptureCall_GenerateTextureMipmap,
+	RendererCaptureCall_BlitFramebuffer,
+
+	RendererCaptureCall_COUNT
+};
+
+StringView_ASCII renderer_capture_call_name( Renderer_Capture_Call call );
+
+// Starts recording into the file, replacing it, and wraps the state's dispatch until the capture ends.
+// The capture ends by itself after `frames_count` frames.
+bool renderer_capture_begin( const char *file_path, u32 frames_count, OpenGL_State *state );
+void renderer_capture_end();
+bool renderer_capture_active();
+
+void renderer_capture_frame_begin( u64 frame_idx );
+// `state_changes` - counters of the state cache for the frame.
+void renderer_capture_frame_end( OpenGL_State_Counters state_changes );
+
+// Recording functions, call them only while a capture is active.
+void renderer_capture_set_uniform( GLuint program, GLint location, Renderer_Data_Type data_type, bool transpose, const void *value );
+// `size` 0 - `glBindBufferBase()`.
+void renderer_capture_bind_buffer_range( GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size );
+void renderer_capture_bind_buffer( GLenum target, GLuint buffer );
+void renderer_capture_buffer_sub_data( GLuint buffer, GLintptr offset, GLsizeiptr size, const void *data );
+// `data` was just written at `offset` of the buffer's persistent mapping.
+void renderer_capture_mapped_write( GLuint buffer, u32 offset, u32 size, const void *data );
+void renderer_capture_clear_framebuffer_fv( GLuint framebuffer, GLenum buffer, GLint drawbuffer, const GLfloat *value );
+void renderer_capture_clear_framebuffer_uiv( GLuint framebuffer, GLenum buffer, GLint drawbuffer, const GLuint *value );
+void renderer_capture_clear_framebuffer_fi( GLuint framebuffer, GLenum buffer, GLint drawbuffer, GLfloat depth, GLint stencil );
+// Every indexed draw is replayed with `glDrawElementsInstancedBaseVertexBaseInstance()`.
+void renderer_capture_draw_elements( GLenum mode, GLsizei count, GLenum type, u64 indices_offset, GLsizei instance_count, GLint base_vertex, GLuint base_instance );
+void renderer_capture_multi_draw_elements_indirect( GLenum mode, GLenum type, u64 indirect_offset, GLsizei draw_count, GLsizei stride );
+void renderer_capture_texture_sub_image_2d( GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *pixels, u32 pixels_size );
+void renderer_capture_generate_texture_mipmap( GLuint texture );
+void renderer_capture_blit_framebuffer( GLuint source, GLenum read_buffer, GLuint destination, GLint source_rect[ 4 ], GLint destination_rect[ 4 ], GLbitfield mask, GLenum filter );
+
+struct Renderer_Capture_Call_Stats {
+	u32 count;
+	// Calls that set what was already set: same bind, same uniform value, same viewport.
+	// State set before a frame is forgotten, as calls made between frames are not recorded.
+	u32 redundant;
+	f64 total_milliseconds;
+	f64 max_milliseconds;
+};
+
+struct Renderer_Capture_Replay_Report {
+	u32 frames_count;
+	u32 calls_count;
+	u64 bytes_uploaded;      // Buffer, texture and uniform contents handed to OpenGL.
+	f64 total_milliseconds;  // Of all replayed calls, decoding included.
+	// State changes the state cache dropped while capturing, i.e. calls the capture does not have.
+	u32 captured_state_changes_elided;
+	// Records whose arguments or data do not fit their call, skipped and not counted in `calls`.
+	u32 rejected_count;
+	Renderer_Capture_Call_Stats calls[ RendererCaptureCall_COUNT ];
+};
+
+struct Renderer_Capture_Replay_Test {
+	u32 damaged_records_count;
+	Renderer_Capture_Replay_Report report;
+	bool rejected_damaged;  // Every damaged record was skipped and the valid ones were replayed.
+};
+
+// Persistent mapping of the buffer and its size, NULL if it is not mapped.  Implemented by the OpenGL backend.
+u8 * renderer_mapped_buffer_memory( GLuint buffer, u64 *out_size );
+
+// Re-executes the capture's calls on the current backend and times every one of them.
+// The OpenGL backend makes the calls and finishes each frame before the next one, so mapped writes
+//   never race the GPU; the null backend only decodes them.  Returns false if the file is not a capture.
+bool renderer_capture_replay( const char *file_path, Renderer_Capture_Replay_Report *out_report );
+void renderer_capture_replay_report_log( Renderer_Capture_Replay_Report *report );
+
+// Replays a capture made in memory, with records of the wrong arguments size and with too little
+//   uniform data among valid ones.  Decodes only, on any backend.
+Renderer_Capture_Replay_Test renderer_capture_replay_test();
+
+#endif /* QLIGHT_RENDERER_CAPTURE_H */
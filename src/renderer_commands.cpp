@@ -0,0 +1,304 @@
+#include <string.h>
+#include <chrono>
+
+#include "renderer_commands.h"
+#include "jobs.h"
+
+constexpr u64 RENDERER_COMMAND_ALIGNMENT = 8;
+
+static u64 align_up( u64 value, u64 alignment ) {
+	return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+// Reserves a command with `payload_size` bytes after the header.  Returns NULL if the arena is full.
+static void *
+command_buffer_push( Renderer_Command_Buffer *buffer, Renderer_Command_Type type, u64 payload_size ) {
+	u64 size = align_up( sizeof( Renderer_Command ) + payload_size, RENDERER_COMMAND_ALIGNMENT );
+	Assert( size <= U16_MAX );
+
+	// Not through `Allocate`, which asserts on failure: a full buffer only drops the command.
+	u8 *memory = buffer->arena.allocate_aligned( size, RENDERER_COMMAND_ALIGNMENT );
+	if ( !memory ) {
+		buffer->dropped_count += 1;
+		return NULL;
+	}
+
+	Renderer_Command *command = ( Renderer_Command * )memory;
+	*command = Renderer_Command {
+		.sort_key = buffer->sort_key,
+		.type = type,
+		._padding0 = 0,
+		.size = ( u16 )size,
+		._padding1 = 0
+	};
+	buffer->commands_count += 1;
+
+	// Keep padding deterministic, so streams can be compared byte for byte.
+	void *payload = renderer_command_payload( command );
+	memset( payload, 0, size - sizeof( Renderer_Command ) );
+	return payload;
+}
+
+void renderer_command_buffer_init( Renderer_Command_Buffer *buffer, u64 capacity ) {
+	// `Linear_Allocator::deinit` gives the memory back to `sys_allocator`.
+	u8 *memory = Allocate( sys_allocator, capacity, u8 );
+	buffer->arena = Linear_Allocator {};
+	buffer->arena.init( memory, capacity );
+	buffer->sort_key = 0;
+	buffer->commands_count = 0;
+	buffer->dropped_count = 0;
+}
+
+void renderer_command_buffer_destroy( Renderer_Command_Buffer *buffer ) {
+	buffer->arena.deinit();
+	buffer->commands_count = 0;
+	buffer->dropped_count = 0;
+}
+
+void renderer_command_buffer_reset( Renderer_Command_Buffer *buffer ) {
+	buffer->arena.reset( /* zero_memory */ false );
+	buffer->sort_key = 0;
+	buffer->commands_count = 0;
+	buffer->dropped_count = 0;
+}
+
+void renderer_command_buffer_set_sort_key( Renderer_Command_Buffer *buffer, u64 sort_key ) {
+	buffer->sort_key = sort_key;
+}
+
+bool renderer_record_bind_program( Renderer_Command_Buffer *buffer, Renderer_Shader_Program *program ) {
+	Renderer_Command_Bind_Program *command = ( Renderer_Command_Bind_Program * )command_buffer_push( buffer, RendererCommandType_BindProgram, sizeof( Renderer_Command_Bind_Program ) );
+	if ( !command )
+		return false;
+
+	command->program = program;
+	return true;
+}
+
+bool renderer_record_set_uniform( Renderer_Command_Buffer *buffer, Renderer_Shader_Program *program, Renderer_Uniform_ID uniform_id, const void *value ) {
+	// Uniform might have been optimized out by the shader compiler.
+	if ( uniform_id == INVALID_UNIFORM_ID || uniform_id >= program->uniforms.size )
+		return false;
+
+	u32 value_size = renderer_uniform_size( &program->uniforms.data[ uniform_id ] );
+	u64 payload_size = sizeof( Renderer_Command_Set_Uniform ) + value_size;
+	Renderer_Command_Set_Uniform *command = ( Renderer_Command_Set_Uniform * )command_buffer_push( buffer, RendererCommandType_SetUniform, payload_size );
+	if ( !command )
+		return false;
+
+	command->program = program;
+	command->uniform_id = uniform_id;
+	command->value_size = value_size;
+	memcpy( command + 1, value, value_size );
+	return true;
+}
+
+bool renderer_record_bind_texture( Renderer_Command_Buffer *buffer, u32 texture_slot_idx, Texture_ID texture_id ) {
+	Renderer_Command_Bind_Texture *command = ( Renderer_Command_Bind_Texture * )command_buffer_push( buffer, RendererCommandType_BindTexture, sizeof( Renderer_Command_Bind_Texture ) );
+	if ( !command )
+		return false;
+
+	command->texture_slot_idx = texture_slot_idx;
+	command->texture_id = texture_id;
+	return true;
+}
+
+bool renderer_record_draw( Renderer_Command_Buffer *buffer, Mesh_ID mesh_id, u32 instance_count, u32 first_instance ) {
+	Renderer_Command_Draw *command = ( Renderer_Command_Draw * )command_buffer_push( buffer, RendererCommandType_Draw, sizeof( Renderer_Command_Draw ) );
+	if ( !command )
+		return false;
+
+	command->mesh_id = mesh_id;
+	command->instance_count = instance_count;
+	command->first_instance = first_instance;
+	return true;
+}
+
+void renderer_command_stream_init( Renderer_Command_Stream *stream, Allocator *allocator, u32 initial_capacity ) {
+	stream->commands = array_new< Renderer_Command * >( allocator, initial_capacity );
+	stream->unsorted = array_new< Renderer_Command * >( allocator, initial_capacity );
+	stream->sort_items = array_new< Radix_Sort_Item >( allocator, initial_capacity );
+	stream->sort_items_swap = array_new< Radix_Sort_Item >( allocator, initial_capacity );
+}
+
+void renderer_command_stream_destroy( Renderer_Command_Stream *stream ) {
+	array_free( &stream->commands );
+	array_free( &stream->unsorted );
+	array_free( &stream->sort_items );
+	array_free( &stream->sort_items_swap );
+}
+
+u32 renderer_command_stream_merge( Renderer_Command_Stream *stream, ArrayView< Renderer_Command_Buffer * > buffers ) {
+	// 1. Gather commands buffer after buffer, in the order they were recorded.
+	array_clear( &stream->unsorted );
+	array_clear( &stream->sort_items );
+	ForIt( buffers.data, buffers.size ) {
+		u8 *cursor = it->arena.memory_start;
+		For2( it->commands_count ) {
+			Renderer_Command *command = ( Renderer_Command * )cursor;
+			array_add( &stream->sort_items, Radix_Sort_Item { .key = command->sort_key, .index = stream->unsorted.size } );
+			array_add( &stream->unsorted, command );
+			cursor += command->size;
+		}
+	}}
+
+	array_clear( &stream->commands );
+	u32 commands_count = stream->unsorted.size;
+	if ( commands_count < 1 )
+		return 0;
+
+	// 2. Stable sort by key, so ties keep the buffer and recording order.
+	array_resize( &stream->sort_items_swap, commands_count );
+	stream->sort_items_swap.size = commands_count;
+	Array< Radix_Sort_Item > *sorted = radix_sort( &stream->sort_items, &stream->sort_items_swap );
+
+	array_resize( &stream->commands, commands_count );
+	stream->commands.size = commands_count;
+	ForIt( sorted->data, sorted->size ) {
+		stream->commands.data[ it_index ] = stream->unsorted.data[ it.index ];
+	}}
+
+	return commands_count;
+}
+
+bool renderer_command_streams_equal( Renderer_Command_Stream *lhs, Renderer_Command_Stream *rhs ) {
+	if ( lhs->commands.size != rhs->commands.size )
+		return false;
+
+	For( lhs->commands.size ) {
+		Renderer_Command *lhs_command = lhs->commands.data[ it_index ];
+		Renderer_Command *rhs_command = rhs->commands.data[ it_index ];
+		if ( lhs_command->size != rhs_command->size || memcmp( lhs_command, rhs_command, lhs_command->size ) != 0 )
+			return false;
+	}
+
+	return true;
+}
+
+// --- Test
+
+constexpr u32 COMMANDS_TEST_PROGRAMS_COUNT = 4;
+constexpr u64 COMMANDS_TEST_PACKET_MAX_SIZE = 256;
+
+struct Commands_Test_Context {
+	Renderer_Shader_Program *programs;
+	Renderer_Command_Buffer *buffers;
+	u32 packets_count;
+	u32 jobs_count;
+};
+
+// Every packet depends only on its index, so it is the same whichever thread records it.
+static void
+commands_test_record_packet( Renderer_Command_Buffer *buffer, Renderer_Shader_Program *programs, u32 packet_idx ) {
+	u32 random_state = packet_idx * 2654435761u + 1;
+	u32 program_idx = QL_random_u32( &random_state ) % COMMANDS_TEST_PROGRAMS_COUNT;
+	Texture_ID texture_id = ( Texture_ID )( QL_random_u32( &random_state ) % 64 );
+	Mesh_ID mesh_id = ( Mesh_ID )( QL_random_u32( &random_state ) % 256 );
+
+	// Program, texture and mesh first; the packet index keeps keys unique.
+	u64 sort_key = ( ( u64 )program_idx << 56 ) | ( ( u64 )texture_id << 40 ) | ( ( u64 )mesh_id << 24 ) | ( packet_idx & 0xFFFFFF );
+	renderer_command_buffer_set_sort_key( buffer, sort_key );
+
+	Renderer_Shader_Program *program = &programs[ program_idx ];
+	Matrix4x4_f32 model( ( f32 )packet_idx );
+	Vector4_f32 color = { ( f32 )( packet_idx & 0xFF ) / 255.0f, 0.5f, 0.25f, 1.0f };
+	renderer_record_bind_program( buffer, program );
+	renderer_record_set_uniform( buffer, program, /* model */ 0, &model );
+	renderer_record_set_uniform( buffer, program, /* color */ 1, &color );
+	renderer_record_bind_texture( buffer, 0, texture_id );
+	renderer_record_draw( buffer, mesh_id );
+}
+
+static void
+commands_test_record_job( void *data, u32 job_index ) {
+	Commands_Test_Context *context = ( Commands_Test_Context * )data;
+	u32 packets_per_job = ( context->packets_count + context->jobs_count - 1 ) / context->jobs_count;
+	u32 first_packet = job_index * packets_per_job;
+	u32 last_packet = QL_min2( first_packet + packets_per_job, context->packets_count );
+	Renderer_Command_Buffer *buffer = &context->buffers[ job_index ];
+	for ( u32 packet_idx = first_packet; packet_idx < last_packet; packet_idx += 1 ) {
+		commands_test_record_packet( buffer, context->programs, packet_idx );
+	}
+}
+
+Renderer_Commands_Test renderer_commands_test( u32 packets_count ) {
+	Assert( packets_count <= 0xFFFFFF );
+	auto milliseconds_since = []( std::chrono::steady_clock::time_point start ) -> f64 {
+		return std::chrono::duration< f64, std::milli >( std::chrono::steady_clock::now() - start ).count();
+	};
+
+	// Programs are only compared by address, they are never linked.
+	Renderer_Shader_Program programs[ COMMANDS_TEST_PROGRAMS_COUNT ] = {};
+	For( COMMANDS_TEST_PROGRAMS_COUNT ) {
+		programs[ it_index ].uniforms = array_new< Renderer_Uniform >( sys_allocator, 2 );
+		array_add( &programs[ it_index ].uniforms, Renderer_Uniform { .name = "model", .data_type = RendererDataType_Matrix4x4_f32, .elements = 1 } );
+		array_add( &programs[ it_index ].uniforms, Renderer_Uniform { .name = "color", .data_type = RendererDataType_Vector4_f32, .elements = 1 } );
+	}
+
+	Renderer_Commands_Test result = { .packets_count = packets_count };
+
+	// Single-threaded recording.
+	Renderer_Command_Buffer single_buffer;
+	renderer_command_buffer_init( &single_buffer, ( u64 )packets_count * COMMANDS_TEST_PACKET_MAX_SIZE );
+	auto start = std::chrono::steady_clock::now();
+	For( packets_count ) {
+		commands_test_record_packet( &single_buffer, programs, it_index );
+	}
+	result.single_record_milliseconds = milliseconds_since( start );
+
+	// Multithreaded recording, one buffer per job.
+	u32 jobs_count = jobs_workers_count() + 1;
+	Array< Renderer_Command_Buffer > buffers = array_new< Renderer_Command_Buffer >( sys_allocator, jobs_count );
+	Array< Renderer_Command_Buffer * > buffer_pointers = array_new< Renderer_Command_Buffer * >( sys_allocator, jobs_count );
+	u64 job_capacity = ( ( u64 )packets_count / jobs_count + 1 ) * COMMANDS_TEST_PACKET_MAX_SIZE;
+	For( jobs_count ) {
+		Renderer_Command_Buffer buffer;
+		renderer_command_buffer_init( &buffer, job_capacity );
+		array_add( &buffers, buffer );
+	}
+	For( jobs_count ) {
+		array_add( &buffer_pointers, &buffers.data[ it_index ] );
+	}
+
+	Commands_Test_Context context = {
+		.programs = programs,
+		.buffers = buffers.data,
+		.packets_count = packets_count,
+		.jobs_count = jobs_count
+	};
+	start = std::chrono::steady_clock::now();
+	jobs_run_parallel( jobs_count, commands_test_record_job, &context );
+	result.parallel_record_milliseconds = milliseconds_since( start );
+	result.buffers_count = jobs_count;
+
+	// Merge both and compare.
+	Renderer_Command_Stream single_stream;
+	Renderer_Command_Stream parallel_stream;
+	renderer_command_stream_init( &single_stream, sys_allocator, single_buffer.commands_count );
+	renderer_command_stream_init( &parallel_stream, sys_allocator, single_buffer.commands_count );
+
+	Renderer_Command_Buffer *single_buffer_pointer = &single_buffer;
+	renderer_command_stream_merge( &single_stream, array_view( &single_buffer_pointer, 1 ) );
+	start = std::chrono::steady_clock::now();
+	result.commands_count = renderer_command_stream_merge( &parallel_stream, array_view( &buffer_pointers ) );
+	result.merge_milliseconds = milliseconds_since( start );
+
+	u32 dropped_count = single_buffer.dropped_count;
+	ForIt( buffers.data, buffers.size ) {
+		dropped_count += it.dropped_count;
+	}}
+	result.streams_equal = ( dropped_count == 0 ) && renderer_command_streams_equal( &single_stream, &parallel_stream );
+
+	renderer_command_stream_destroy( &single_stream );
+	renderer_command_stream_destroy( &parallel_stream );
+	ForIt( buffers.data, buffers.size ) {
+		renderer_command_buffer_destroy( &it );
+	}}
+	array_free( &buffers );
+	array_free( &buffer_pointers );
+	renderer_command_buffer_destroy( &single_buffer );
+	For( COMMANDS_TEST_PROGRAMS_COUNT ) {
+		array_free( &programs[ it_index ].uniforms );
+	}
+	return result;
+}
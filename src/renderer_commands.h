@@ -0,0 +1,145 @@
+#ifndef QLIGHT_RENDERER_COMMANDS_H
+#define QLIGHT_RENDERER_COMMANDS_H
+
+#include "renderer.h"
+#include "allocator.h"
+#include "radix_sort.h"
+
+/*
+	Recorded render commands, for filling command lists on several threads at once.
+
+	Every thread (or job) records into its own `Renderer_Command_Buffer`: typed commands
+	  packed one after another into the buffer's linear arena, so recording never locks
+	  and never touches OpenGL.  Each command carries the sort key that was current when
+	  it was recorded, see `renderer_command_buffer_set_sort_key()`.
+
+	The submitting thread merges the buffers into a `Renderer_Command_Stream`, sorted by
+	  key.  The sort is stable and buffers are added in order, so commands with the same key
+	  stay in the order they were recorded in, and a group of commands recorded under one
+	  key (a "packet": bind program, set uniforms, bind textures, draw) stays together.
+	The stream is replayed through the OpenGL backend with `renderer_submit_command_stream()`.
+
+	Commands point to buffers' memory, so buffers must not be reset before the stream is replayed.
+*/
+
+enum Renderer_Command_Type : u8 {
+	RendererCommandType_BindProgram = 0,
+	RendererCommandType_SetUniform,
+	RendererCommandType_BindTexture,
+	RendererCommandType_Draw,
+
+	RendererCommandType_COUNT
+};
+
+// Every command starts with this header, its payload follows right after it.
+struct Renderer_Command {
+	u64 sort_key;
+	Renderer_Command_Type type;
+	u8 _padding0;
+	u16 size;  // Of the whole command, header included.
+	u32 _padding1;
+};
+
+struct Renderer_Command_Bind_Program {
+	Renderer_Shader_Program *program;
+};
+
+// The uniform's value follows, its size is given by the uniform's data type.
+struct Renderer_Command_Set_Uniform {
+	Renderer_Shader_Program *program;
+	Renderer_Uniform_ID uniform_id;
+	u32 value_size;
+};
+
+struct Renderer_Command_Bind_Texture {
+	u32 texture_slot_idx;
+	Texture_ID texture_id;
+};
+
+// Draws the whole mesh from its geometry pool with the currently bound program.
+struct Renderer_Command_Draw {
+	Mesh_ID mesh_id;
+	u32 instance_count;
+	u32 first_instance;
+};
+
+struct Renderer_Command_Buffer {
+	Linear_Allocator arena;
+	u64 sort_key;        // Given to every command recorded next.
+	u32 commands_count;
+	u32 dropped_count;   // Commands that did not fit into the arena.
+};
+
+struct Renderer_Command_Stream {
+	// Commands of all merged buffers, sorted by key.
+	Array< Renderer_Command * > commands;
+	// Merge scratch, kept around between merges.
+	Array< Renderer_Command * > unsorted;
+	Array< Radix_Sort_Item > sort_items;
+	Array< Radix_Sort_Item > sort_items_swap;
+};
+
+// The arena is `capacity` bytes allocated once, recording never allocates.
+void renderer_command_buffer_init( Renderer_Command_Buffer *buffer, u64 capacity );
+void renderer_command_buffer_destroy( Renderer_Command_Buffer *buffer );
+// Drops all recorded commands, keeping the arena.
+void renderer_command_buffer_reset( Renderer_Command_Buffer *buffer );
+void renderer_command_buffer_set_sort_key( Renderer_Command_Buffer *buffer, u64 sort_key );
+
+// Recording functions return false if the command did not fit, it is dropped then.
+bool renderer_record_bind_program( Renderer_Command_Buffer *buffer, Renderer_Shader_Program *program );
+// Copies the value, so it may be a local variable.  Uniform IDs come from `renderer_shader_program_find_uniform()`.
+bool renderer_record_set_uniform( Renderer_Command_Buffer *buffer, Renderer_Shader_Program *program, Renderer_Uniform_ID uniform_id, const void *value );
+bool renderer_record_bind_texture( Renderer_Command_Buffer *buffer, u32 texture_slot_idx, Texture_ID texture_id );
+bool renderer_record_draw( Renderer_Command_Buffer *buffer, Mesh_ID mesh_id, u32 instance_count = 1, u32 first_instance = 0 );
+
+// Payload of a command, right after its header.
+inline void *
+renderer_command_payload( Renderer_Command *command ) {
+	return ( void * )( command + 1 );
+}
+
+void renderer_command_stream_init( Renderer_Command_Stream *stream, Allocator *allocator, u32 initial_capacity );
+void renderer_command_stream_destroy( Renderer_Command_Stream *stream );
+// Replaces the stream's commands with those of all `buffers`, sorted by key.
+// Returns the number of commands in the stream.
+u32 renderer_command_stream_merge( Renderer_Command_Stream *stream, ArrayView< Renderer_Command_Buffer * > buffers );
+// True if both streams have the same commands in the same order, byte for byte.
+bool renderer_command_streams_equal( Renderer_Command_Stream *lhs, Renderer_Command_Stream *rhs );
+
+// Replays the stream after the lighting pass of the frame drawn by the next `renderer_draw_frame()`, into the default framebuffer.
+// That frame may be drawn on the render thread, so the stream and its buffers must stay untouched
+//   until the `renderer_draw_frame()` after it returns.
+void renderer_submit_command_stream( Renderer_Command_Stream *stream );
+
+struct Renderer_Commands_Test {
+	u32 packets_count;
+	u32 commands_count;
+	u32 buffers_count;                 // Used by the multithreaded recording.
+	f64 single_record_milliseconds;    // Recording of all packets into one buffer on this thread.
+	f64 parallel_record_milliseconds;  // Recording of the same packets into one buffer per job.
+	f64 merge_milliseconds;            // Merging and sorting the buffers of the parallel recording.
+	bool streams_equal;                // Whether both merged streams replay the same commands.
+};
+
+// Records `packets_count` pseudo-random packets single-threaded and on the job workers,
+//   merges both and compares the streams.  CPU only, nothing is replayed through OpenGL.
+Renderer_Commands_Test renderer_commands_test( u32 packets_count );
+
+struct Renderer_Commands_Replay_Test {
+	u32 packets_count;
+	u32 commands_count;
+	u32 replayed_calls_count;  // State changes that reached OpenGL, replaying the merged stream.
+	u32 direct_calls_count;    // Same, calling the backend directly with the packets in key order.
+	u32 replayed_elided;       // State changes the cache dropped on the replay.
+	u32 replayed_draw_calls;
+	u32 direct_draw_calls;
+	bool outputs_equal;        // Same OpenGL calls in the same order, same uniform values and draws.
+};
+
+// Records `packets_count` pseudo-random packets into several buffers and replays their merged stream
+//   through a mock `OpenGL_State_Dispatch`, then submits the same packets directly and compares
+//   what reached the dispatch.  Runs on the null and software backends only, it borrows the state cache.
+Renderer_Commands_Replay_Test renderer_commands_replay_test( u32 packets_count );
+
+#endif /* QLIGHT_RENDERER_COMMANDS_H */
@@ -0,0 +1,228 @@
+#include "renderer_geometry.h"
+
+#include <string.h> // memmove()
+
+constexpr u32 OFFSET_ALLOCATOR_INITIAL_FREE_RANGES_CAPACITY = 16;
+
+Offset_Allocator offset_allocator_new( Allocator *allocator, u32 capacity ) {
+	Offset_Allocator offset_allocator = {
+		.free_ranges = array_new< Offset_Range >( allocator, OFFSET_ALLOCATOR_INITIAL_FREE_RANGES_CAPACITY ),
+		.capacity = capacity,
+		.allocated = 0
+	};
+
+	if ( capacity > 0 )
+		array_add( &offset_allocator.free_ranges, Offset_Range { .offset = 0, .size = capacity } );
+
+	return offset_allocator;
+}
+
+void offset_allocator_destroy( Offset_Allocator *offset_allocator ) {
+	array_free( &offset_allocator->free_ranges );
+	offset_allocator->capacity = 0;
+	offset_allocator->allocated = 0;
+}
+
+static void free_ranges_insert( Array< Offset_Range > *ranges, u32 index, Offset_Range range ) {
+	array_add( ranges, range );
+	u32 items_to_move = ranges->size - 1 - index;
+	if ( items_to_move > 0 ) {
+		memmove( &ranges->data[ index + 1 ], &ranges->data[ index ], items_to_move * sizeof( Offset_Range ) );
+		ranges->data[ index ] = range;
+	}
+}
+
+static void free_ranges_remove( Array< Offset_Range > *ranges, u32 index ) {
+	u32 items_to_move = ranges->size - 1 - index;
+	if ( items_to_move > 0 )
+		memmove( &ranges->data[ index ], &ranges->data[ index + 1 ], items_to_move * sizeof( Offset_Range ) );
+
+	ranges->size -= 1;
+}
+
+u32 offset_allocator_allocate( Offset_Allocator *offset_allocator, u32 size ) {
+	if ( size < 1 )
+		return OFFSET_ALLOCATOR_INVALID;
+
+	Array< Offset_Range > *ranges = &offset_allocator->free_ranges;
+	u32 best_fit_idx = U32_MAX;
+	u32 best_fit_size = U32_MAX;
+	ForIt( ranges->data, ranges->size ) {
+		if ( it.size < size || it.size >= best_fit_size )
+			continue;
+
+		best_fit_idx = it_index;
+		best_fit_size = it.size;
+		if ( it.size == size )
+			break;
+	}}
+
+	if ( best_fit_idx == U32_MAX )
+		return OFFSET_ALLOCATOR_INVALID;
+
+	Offset_Range *range = &ranges->data[ best_fit_idx ];
+	u32 offset = range->offset;
+	if ( range->size == size ) {
+		free_ranges_remove( ranges, best_fit_idx );
+	} else {
+		range->offset += size;
+		range->size -= size;
+	}
+
+	offset_allocator->allocated += size;
+	return offset;
+}
+
+void offset_allocator_release( Offset_Allocator *offset_allocator, u32 offset, u32 size ) {
+	if ( size < 1 )
+		return;
+
+	AssertMessage( offset + size <= offset_allocator->capacity, "Released range is out of bounds" );
+	AssertMessage( size <= offset_allocator->allocated, "Released more than was allocated" );
+	Array< Offset_Range > *ranges = &offset_allocator->free_ranges;
+
+	// Find the first free range past the released one.
+	u32 low = 0;
+	u32 high = ranges->size;
+	while ( low < high ) {
+		u32 middle = low + ( high - low ) / 2;
+		if ( ranges->data[ middle ].offset < offset )
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	u32 next_idx = low;
+
+	bool has_prev = ( next_idx > 0 );
+	bool has_next = ( next_idx < ranges->size );
+	Offset_Range *prev = ( has_prev ) ? &ranges->data[ next_idx - 1 ] : NULL;
+	Offset_Range *next = ( has_next ) ? &ranges->data[ next_idx ] : NULL;
+	AssertMessage( !prev || prev->offset + prev->size <= offset, "Released range overlaps a free range" );
+	AssertMessage( !next || offset + size <= next->offset, "Released range overlaps a free range" );
+
+	bool merge_prev = prev && ( prev->offset + prev->size == offset );
+	bool merge_next = next && ( offset + size == next->offset );
+	if ( merge_prev && merge_next ) {
+		prev->size += size + next->size;
+		free_ranges_remove( ranges, next_idx );
+	} else if ( merge_prev ) {
+		prev->size += size;
+	} else if ( merge_next ) {
+		next->offset = offset;
+		next->size += size;
+	} else {
+		free_ranges_insert( ranges, next_idx, Offset_Range { .offset = offset, .size = size } );
+	}
+
+	offset_allocator->allocated -= size;
+}
+
+void offset_allocator_grow( Offset_Allocator *offset_allocator, u32 new_capacity ) {
+	u32 old_capacity = offset_allocator->capacity;
+	if ( new_capacity <= old_capacity )
+		return;
+
+	Array< Offset_Range > *ranges = &offset_allocator->free_ranges;
+	u32 added_size = new_capacity - old_capacity;
+	Offset_Range *last = ( ranges->size > 0 ) ? &ranges->data[ ranges->size - 1 ] : NULL;
+	if ( last && last->offset + last->size == old_capacity )
+		last->size += added_size;
+	else
+		array_add( ranges, Offset_Range { .offset = old_capacity, .size = added_size } );
+
+	offset_allocator->capacity = new_capacity;
+}
+
+u32 offset_allocator_largest_free( Offset_Allocator *offset_allocator ) {
+	u32 largest = 0;
+	ForIt( offset_allocator->free_ranges.data, offset_allocator->free_ranges.size ) {
+		if ( it.size > largest )
+			largest = it.size;
+	}}
+
+	return largest;
+}
+
+// --- Test
+
+static bool
+offset_allocator_ranges_consistent( Offset_Allocator *offset_allocator ) {
+	u64 free_size = 0;
+	ForIt( offset_allocator->free_ranges.data, offset_allocator->free_ranges.size ) {
+		if ( it.size == 0 || it.offset + it.size > offset_allocator->capacity )
+			return false;
+		// Sorted, and merged with the next one if they touched.
+		if ( it_index + 1 < offset_allocator->free_ranges.size && it.offset + it.size >= offset_allocator->free_ranges.data[ it_index + 1 ].offset )
+			return false;
+		free_size += it.size;
+	}}
+	return ( free_size + offset_allocator->allocated == offset_allocator->capacity );
+}
+
+Offset_Allocator_Test offset_allocator_test( u32 operations_count ) {
+	Offset_Allocator_Test test = { .operations_count = operations_count, .ranges_consistent = true };
+	constexpr u32 CAPACITY = 4096;
+	constexpr u32 MAX_SIZE = 256;
+	Offset_Allocator offset_allocator = offset_allocator_new( sys_allocator, CAPACITY );
+	// Which items are taken, and what is still allocated.
+	Array< bool > taken = array_new< bool >( sys_allocator, CAPACITY );
+	array_resize( &taken, CAPACITY );
+	memset( taken.data, 0, CAPACITY * sizeof( bool ) );
+	Array< Offset_Range > live = array_new< Offset_Range >( sys_allocator, 64 );
+
+	// Fixed seed, so runs are reproducible.
+	u32 random_state = 0x2545F491;
+	For( operations_count ) {
+		// Allocate more often than release, so the allocator runs full and fragments.
+		bool release = ( live.size > 0 ) && ( QL_random_u32( &random_state ) % 5 < 2 );
+		if ( release ) {
+			u32 live_idx = QL_random_u32( &random_state ) % live.size;
+			Offset_Range range = live.data[ live_idx ];
+			live.data[ live_idx ] = live.data[ live.size - 1 ];
+			live.size -= 1;
+			offset_allocator_release( &offset_allocator, range.offset, range.size );
+			memset( &taken.data[ range.offset ], 0, range.size * sizeof( bool ) );
+		} else {
+			u32 size = 1 + QL_random_u32( &random_state ) % MAX_SIZE;
+			u32 offset = offset_allocator_allocate( &offset_allocator, size );
+			if ( offset == OFFSET_ALLOCATOR_INVALID ) {
+				// The longest run of free items tells whether it should have fit.
+				u32 run = 0;
+				u32 longest_run = 0;
+				For2( CAPACITY ) {
+					run = ( taken.data[ it2_index ] ) ? 0 : run + 1;
+					longest_run = QL_max2( longest_run, run );
+				}
+				if ( longest_run >= size )
+					test.false_failures_count += 1;
+				else
+					test.failed_count += 1;
+			} else {
+				bool overlaps = ( offset + size > CAPACITY );
+				for ( u32 item = offset; !overlaps && item < offset + size; item += 1 )
+					overlaps = taken.data[ item ];
+				if ( overlaps ) {
+					test.overlaps_count += 1;
+				} else {
+					memset( &taken.data[ offset ], 1, size * sizeof( bool ) );
+					array_add( &live, Offset_Range { .offset = offset, .size = size } );
+				}
+			}
+		}
+
+		test.ranges_consistent &= offset_allocator_ranges_consistent( &offset_allocator );
+	}
+
+	ForIt( live.data, live.size ) {
+		offset_allocator_release( &offset_allocator, it.offset, it.size );
+	}}
+	test.ranges_consistent &= offset_allocator_ranges_consistent( &offset_allocator );
+	test.coalesced = ( offset_allocator.free_ranges.size == 1 ) &&
+		( offset_allocator.free_ranges.data[ 0 ].offset == 0 ) &&
+		( offset_allocator.free_ranges.data[ 0 ].size == CAPACITY );
+
+	array_free( &taken );
+	array_free( &live );
+	offset_allocator_destroy( &offset_allocator );
+	return test;
+}
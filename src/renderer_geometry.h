@@ -0,0 +1,63 @@
+#ifndef QLIGHT_RENDERER_GEOMETRY_H
+#define QLIGHT_RENDERER_GEOMETRY_H
+
+#include "common.h"
+#include "array.h"
+
+/*
+	CPU-side bookkeeping for the shared geometry buffers.
+
+	Meshes with the same vertex format are packed into one big vertex buffer
+	  and one big index buffer (a "geometry pool").  Which parts of those buffers
+	  are taken is tracked by an `Offset_Allocator` per buffer, in items (vertices
+	  or indices), not bytes.  Nothing here touches OpenGL.
+*/
+
+struct Offset_Range {
+	u32 offset;
+	u32 size;
+};
+
+struct Offset_Allocator {
+	// Sorted by offset.  Neighbouring free ranges are always merged,
+	//   so two ranges never touch each other.
+	Array< Offset_Range > free_ranges;
+	u32 capacity;
+	u32 allocated;
+};
+
+constexpr u32 OFFSET_ALLOCATOR_INVALID = U32_MAX;
+
+// Index of a geometry pool, i.e. a vertex format with its shared buffers.
+typedef u8 Geometry_Pool_ID;
+constexpr Geometry_Pool_ID INVALID_GEOMETRY_POOL_ID = U8_MAX;
+
+Offset_Allocator offset_allocator_new( Allocator *allocator, u32 capacity );
+void offset_allocator_destroy( Offset_Allocator *offset_allocator );
+
+// Returns offset of `size` items or `OFFSET_ALLOCATOR_INVALID` if there is no free range large enough.
+// Picks the smallest free range that fits to keep large ranges for large meshes.
+u32 offset_allocator_allocate( Offset_Allocator *offset_allocator, u32 size );
+
+// Gives back a range returned by `offset_allocator_allocate`, merging it with free neighbours.
+void offset_allocator_release( Offset_Allocator *offset_allocator, u32 offset, u32 size );
+
+// Extends the managed range up to `new_capacity` items.  Shrinking is not supported.
+void offset_allocator_grow( Offset_Allocator *offset_allocator, u32 new_capacity );
+
+// Size of the largest free range.
+u32 offset_allocator_largest_free( Offset_Allocator *offset_allocator );
+
+struct Offset_Allocator_Test {
+	u32 operations_count;
+	u32 failed_count;         // Allocations that failed with no free span large enough.
+	u32 false_failures_count; // Allocations that failed although a free span was large enough.
+	u32 overlaps_count;       // Allocations that handed out items already taken.
+	bool ranges_consistent;   // Free ranges stayed sorted, apart and summed to what is not allocated.
+	bool coalesced;           // Once everything was released, one free range covered it all.
+};
+
+// Allocates and releases random sizes, checking every result against a map of the taken items.
+Offset_Allocator_Test offset_allocator_test( u32 operations_count );
+
+#endif /* QLIGHT_RENDERER_GEOMETRY_H */
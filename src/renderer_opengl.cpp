@@ -1,7 +1,15 @@
 #define _CRT_SECURE_NO_WARNINGS // @TODO: Remove
-#include "renderer.h"
+#include "renderer_backend.h"
+#include "renderer_capture.h"
+#include "renderer_sort_key.h"
+#include "renderer_thread.h"
 #include "texture.h"
 
+#include "imgui/imgui.h"
+
+#include <stddef.h>
+#include <new>
+
 #define QL_LOG_CHANNEL "Renderer"
 #include "log.h"
 
@@ -10,263 +18,67 @@ constexpr u64 RENDERER_INITIAL_STAGES_CAPACITY = 16;
 constexpr u64 RENDERER_INITIAL_FRAMEBUFFERS_CAPACITY = 3;
 constexpr u64 RENDERER_INITIAL_RENDERBUFFERS_CAPACITY = 4;
 constexpr u64 RENDERER_INITIAL_UNIFORM_BUFFERS_CAPACITY = 12;
+// Address space reserved for programs, stages and uniform buffers, only what they use gets committed.
+constexpr u64 RENDERER_MAX_PROGRAMS = 1024;
+constexpr u64 RENDERER_MAX_STAGES = 2048;
+constexpr u64 RENDERER_MAX_UNIFORM_BUFFERS = 256;
 
 constexpr u64 RENDERER_INITIAL_FRAMEBUFFER_ATTACHMENTS_CAPACITY = 16;
 
 constexpr u64 RENDERER_OPENGL_ERROR_LOG_CAPACITY = 4096;
 constexpr u64 RENDERER_OPENGL_INFO_LOG_CAPACITY = 4096;
 
-struct Geometry_Buffer {
-	Renderer_Framebuffer_ID framebuffer;
-	Renderer_Shader_Program *shader_program;
-	Texture_ID texture_position;
-	Texture_ID texture_normal;
-	Texture_ID texture_color_specular;  // 24-bit color, 8-bit specular combined
-	Renderer_Renderbuffer_ID renderbuffer_depth_stencil;  // 24-bit depth, 8-bit stencil combined
-	Vector2_u16 dimensions;
-};
-
-struct GL_Constants {
-	u32 max_color_attachments;
-	u32 max_uniform_block_size;
-	u32 max_uniform_locations;
-	u32 max_uniform_buffer_bindings;
-	u32 min_map_buffer_alignment;
-};
-
-struct G_Renderer {
-	struct Frame_Time {
-		f32 last;
-		f32 current;
-		f32 delta;
-	} frame_time;
-
-	struct Device {
-		StringView_ASCII vendor;
-		StringView_ASCII name;
-	} device;
-
-	Array< Renderer_Framebuffer > framebuffers;
-	Array< Renderer_Renderbuffer > renderbuffers;
-	Array< Renderer_Shader_Program > programs;
-	Array< Renderer_Shader_Stage > stages;
-	Array< Renderer_Uniform_Buffer > uniform_buffers;
+constexpr u32 RENDERER_INITIAL_PROXIES_CAPACITY = 256;
 
-	Geometry_Buffer gbuffer;
+// Initial size of a geometry pool's buffers, in vertices and indices.  Pools grow on demand.
+constexpr u32 RENDERER_GEOMETRY_POOL_INITIAL_VERTICES = 64 * 1024;
+constexpr u32 RENDERER_GEOMETRY_POOL_INITIAL_INDICES = 3 * 64 * 1024;
+constexpr u64 RENDERER_INITIAL_GEOMETRY_POOLS_CAPACITY = 4;
 
-	Vector3_f32 *camera_position;
-	Matrix4x4_f32 *view_matrix;
-	Matrix4x4_f32 *projection_matrix;
-	Vector3_f32 ambient_light;
+// Texture array pools are bound to texture units [0; RENDERER_MAX_TEXTURE_ARRAY_POOLS) in the geometry pass,
+//   see `texture_pools[]` in `geometry_fragment.glsl`.
+constexpr u32 RENDERER_MAX_TEXTURE_ARRAY_POOLS = 8;
+constexpr u32 RENDERER_TEXTURE_ARRAY_POOL_INITIAL_LAYERS = 4;
 
-	Vector4_f32 clear_color;
-	Array< Renderer_Render_Command > render_queue;
-	// How many consecutive sorted render queue commands have same material.
-	Array< u16 > render_queue_material_sequence;
+// Each of the two frame arenas has this size, see `frame_arena()`.
+constexpr u64 RENDERER_FRAME_ARENA_SIZE = 8 * 1024 * 1024;
+// Frames from this one on must not allocate through `sys_allocator` unless proxies changed, checked in Debug builds.
+constexpr u64 RENDERER_STEADY_STATE_FIRST_FRAME = 2;
 
-	Texture_ID texture_white;
-	Texture_ID texture_black;
-	Texture_ID texture_purple_checkers;
+constexpr u32 RENDERER_GL_ERROR_CHECK_DEFAULT_SAMPLE_INTERVAL = 60;
 
-	Mesh_ID fullscreen_quad;
-
-	Renderer_Output_Channel output_channel;
-
-	// OpenGL-specific:
-	GL_Constants gl_constants;
-	/*
-		OpenGL definition of glUniformMatrixNxM: 'The first number in the
-			command name is the number of columns; the second is the number of rows.'
-	*/
-	bool uniforms_transpose_matrix; // [columns] x [rows] -> [rows] x [columns]
-	String_ASCII opengl_error_log;
-	String_ASCII opengl_info_log;
-
-} g_renderer;
+G_Renderer g_renderer;
 
 // Fullscreen quad attributes
 struct Vertex_Quad {
 	Vector2_f32 texture_uv;
 };
 
-#define QLIGHT_OPENGL_ERROR_CHECKS
-
-#ifdef QLIGHT_OPENGL_ERROR_CHECKS
-#define GL_CLEAR_LOG_AND_EXECUTE( expression )  \
-	opengl_error_clear();  \
-	expression
-
-#define GL_CHECK( expression )  \
-	GL_CLEAR_LOG_AND_EXECUTE( expression );  \
-	opengl_error_log( #expression, __FILE__, __LINE__ )
-
-#define GL_CHECK_AND_STORE_RESULT( result_pointer, expression )  \
-	GL_CLEAR_LOG_AND_EXECUTE( expression );  \
-	*result_pointer = opengl_error_log( #expression, __FILE__, __LINE__ )
-
-#define GL_ASSERT( expression )  \
-	GL_CLEAR_LOG_AND_EXECUTE( expression );  \
-	bool gl_call_generated_error = opengl_error_log( #expression, __FILE__, __LINE__ );  \
-	AssertMessage( gl_call_generated_error == GL_TRUE, #expression )
-
-#else /* QLIGHT_OPENGL_ERROR_CHECKS */
-#define GL_CLEAR_LOG_AND_EXECUTE( expression )  expression
-#define GL_CHECK( expression )  expression
-#define GL_CHECK_AND_STORE_RESULT( result_pointer, expression )  expression
-#define GL_ASSERT( expression )  expression
-#endif
-
-
-#define log_gl( log_level, format, ... )  log( log_level, QL_LOG_CHANNEL "/GL", format, __VA_ARGS__ )
-#define log_error_gl( format, ... )  log_gl( LogLevel_Error, format, __VA_ARGS__ )
-#define log_warning_gl( format, ... )  log_gl( LogLevel_Warning, format, __VA_ARGS__ )
-#ifdef QLIGHT_DEBUG
-#define log_debug_gl( format, ... )  log_gl( LogLevel_Debug, format, __VA_ARGS__ )
-#else
-#define log_debug_gl( format, ... )
-#endif
-
-static void
-opengl_error_clear() {
-    while ( glGetError() != GL_NO_ERROR ); // or !glGetError()
-}
-
-static bool
-opengl_error_log( const char *function, const char *file, int line ) {
-    while ( GLenum error = glGetError() ) {
-		log_error_gl( "OpenGL Error #%u generated at:\n%s:%d: %s",
-			error,
-			file,
-			line,
-			function
-		);
-        return false;
-    }
-    return true;
-}
-
-enum OpenGL_Object_Type : u32 {
-	OpenGL_Shader = GL_SHADER,
-	OpenGL_Program = GL_PROGRAM,
-	OpenGL_ProgramPipeline = GL_PROGRAM_PIPELINE
-};
-
-static StringView_ASCII
-opengl_get_info_log( OpenGL_Object_Type object, GLuint id ) {
-	GLint log_length;
-	// string_clear( g_renderer.opengl_info_log );
-
-	switch ( object ) {
-		case OpenGL_Shader:
-			glGetShaderiv( id, GL_INFO_LOG_LENGTH, &log_length );
-			glGetShaderInfoLog( id, log_length, &log_length, g_renderer.opengl_info_log.data );
-			break;
-		case OpenGL_Program:
-			glGetProgramiv( id, GL_INFO_LOG_LENGTH, &log_length );
-			glGetProgramInfoLog( id, log_length, &log_length, g_renderer.opengl_info_log.data );
-			break;
-		case OpenGL_ProgramPipeline:
-			glGetProgramPipelineiv( id, GL_INFO_LOG_LENGTH, &log_length );
-			glGetProgramPipelineInfoLog( id, log_length, &log_length, g_renderer.opengl_info_log.data );
-			break;
-		default:
-			return string_view( ( const char * )NULL );
-	}
-
-	g_renderer.opengl_info_log.size = log_length;
-
-	return string_view( &g_renderer.opengl_info_log );
-}
-
-static void
-opengl_generate_and_bind_vertex_array( GLuint *id, StringView_ASCII debug_name ) {
-	glGenVertexArrays( 1, id );
-	glBindVertexArray( *id );
-#ifdef QLIGHT_DEBUG
-	if ( debug_name.size > 0 )
-		glObjectLabel( GL_VERTEX_ARRAY, *id, debug_name.size, debug_name.data );
-#endif
-	log_debug_gl( "Generated and bound VAO '" StringViewFormat "' (gl_id: %u).",
-		StringViewArgument( debug_name ),
-		*id
-	);
-}
-
-static void
-opengl_create_vertex_array( GLuint *id, StringView_ASCII debug_name ) {
-	glCreateVertexArrays( 1, id );
-#ifdef QLIGHT_DEBUG
-	if ( debug_name.size > 0 )
-		glObjectLabel( GL_VERTEX_ARRAY, *id, debug_name.size, debug_name.data );
-#endif
-	log_debug_gl( "Created and bound VAO '" StringViewFormat "' (gl_id: %u).",
-		StringViewArgument( debug_name ),
-		*id
-	);
-}
-
-static void
-opengl_generate_and_bind_vertex_buffer( GLuint *id, StringView_ASCII debug_name ) {
-	glGenBuffers( 1, id );
-	glBindBuffer( GL_ARRAY_BUFFER, *id );
-#ifdef QLIGHT_DEBUG
-	if ( debug_name.size > 0 )
-		glObjectLabel( GL_BUFFER, *id, debug_name.size, debug_name.data );
-#endif
-	log_debug_gl( "Generated and bound VBO '" StringViewFormat "' (gl_id: %u).",
-		StringViewArgument( debug_name ),
-		*id
-	);
-}
-
-static void
-opengl_create_vertex_buffer( GLuint *id, StringView_ASCII debug_name ) {
-	glCreateBuffers( 1, id );
-#ifdef QLIGHT_DEBUG
-	if ( debug_name.size > 0 )
-		glObjectLabel( GL_BUFFER, *id, debug_name.size, debug_name.data );
-#endif
-	log_debug_gl( "Created and bound VBO '" StringViewFormat "' (gl_id: %u).",
-		StringViewArgument( debug_name ),
-		*id
-	);
-}
-
-static void
-opengl_generate_and_bind_element_buffer( GLuint *id, StringView_ASCII debug_name ) {
-	glGenBuffers( 1, id );
-	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, *id );
-#ifdef QLIGHT_DEBUG
-	if ( debug_name.size > 0 )
-		glObjectLabel( GL_BUFFER, *id, debug_name.size, debug_name.data );
-#endif
-	log_debug_gl( "Generated and bound EBO '" StringViewFormat "' (gl_id: %u).",
-		StringViewArgument( debug_name ),
-		*id
-	);
-}
-
-static void
-opengl_create_element_buffer( GLuint *id, StringView_ASCII debug_name ) {
-	glCreateBuffers( 1, id );
-#ifdef QLIGHT_DEBUG
-	if ( debug_name.size > 0 )
-		glObjectLabel( GL_BUFFER, *id, debug_name.size, debug_name.data );
-#endif
-	log_debug_gl( "Created and bound EBO '" StringViewFormat "' (gl_id: %u).",
-		StringViewArgument( debug_name ),
-		*id
-	);
-}
-
-static GLenum
-index_type_size_to_opengl( u32 size ) {
-	switch ( size ) {
-		case 1: return GL_UNSIGNED_BYTE;
-		case 2: return GL_UNSIGNED_SHORT;
-		case 4: return GL_UNSIGNED_INT;
-		default: return 0;
+// Scratch of the frame the game thread is building, reset when `renderer_draw_frame()` starts it.
+// What the frame put there stays until the frame after the next one starts: the render thread
+//   draws the packet, reading it, while the next frame is built in the other arena.
+// Outside of `renderer_draw_frame()` it only fits temporaries, see `Linear_Allocator_Scope`.
+static Linear_Allocator *
+frame_arena() {
+	return &g_renderer.frame_arenas[ g_renderer.frame_idx % ARRAY_SIZE( g_renderer.frame_arenas ) ];
+}
+
+// Array with room for `capacity` items, so it never grows.  Empty if the arena is full.
+template < typename T >
+static Array< T >
+frame_arena_array( Linear_Allocator *arena, u32 capacity ) {
+	Array< T > array = { 0 };
+	array.allocator = arena;
+	if ( capacity == 0 )
+		return array;
+
+	// Not through `Allocate`, which asserts on failure.
+	T *data = ( T * )arena->allocate_aligned( ( u64 )capacity * sizeof( T ), alignof( T ) );
+	if ( data ) {
+		array.capacity = capacity;
+		array.data = data;
 	}
+	return array;
 }
 
 StringView_ASCII
@@ -415,11 +227,9 @@ create_default_textures() {
 		/*      bytes */ white_bytes_view,
 		/*  allocator */ NULL
 	);
-	Texture *white_texture = texture_instance( white_texture_id );
-	renderer_texture_2d_upload(
+	// In a texture array pool, so materials can fall back to it.
+	renderer_texture_array_upload(
 		/*            texture_id */ white_texture_id,
-		/*                origin */ { 0, 0 },
-		/*            dimensions */ white_texture->dimensions,
 		/*         mipmap_levels */ 1,
 		/* opengl_storage_format */ GL_RGBA8,
 		/*     opengl_pixel_type */ GL_UNSIGNED_BYTE
@@ -437,11 +247,9 @@ create_default_textures() {
 		/*      bytes */ black_bytes_view,
 		/*  allocator */ NULL
 	);
-	Texture *black_texture = texture_instance( black_texture_id );
-	renderer_texture_2d_upload(
+	// In a texture array pool, so materials can fall back to it.
+	renderer_texture_array_upload(
 		/*            texture_id */ black_texture_id,
-		/*                origin */ { 0, 0 },
-		/*            dimensions */ black_texture->dimensions,
 		/*         mipmap_levels */ 1,
 		/* opengl_storage_format */ GL_RGBA8,
 		/*     opengl_pixel_type */ GL_UNSIGNED_BYTE
@@ -465,11 +273,9 @@ create_default_textures() {
 		/*      bytes */ checkboard_view,
 		/*  allocator */ NULL
 	);
-	Texture *checkboard_texture = texture_instance( checkboard_texture_id );
-	renderer_texture_2d_upload(
+	// In a texture array pool, so materials can fall back to it.
+	renderer_texture_array_upload(
 		/*            texture_id */ checkboard_texture_id,
-		/*                origin */ { 0, 0 },
-		/*            dimensions */ checkboard_texture->dimensions,
 		/*         mipmap_levels */ 1,
 		/* opengl_storage_format */ GL_RGBA8,
 		/*     opengl_pixel_type */ GL_UNSIGNED_BYTE
@@ -500,9 +306,9 @@ setup_fullscreen_quad() {
 		.material_id = INVALID_MATERIAL_ID,
 		.bits1 = 0,
 		.vertex_attributes = attributes
-		// .opengl_vao
-		// .opengl_vbo
-		// .opengl_ebo
+		// .geometry_pool_id
+		// .base_vertex
+		// .first_index
 	};
 
 	u32 vertex_size = mesh_vertex_attributes_size( &quad_mesh, /* binding */ 0 );
@@ -542,25 +348,13 @@ setup_fullscreen_quad() {
 	log_debug( "Fullscreen Quad has been set up." );
 }
 
-static void
-draw_fullscreen_quad() {
-	Mesh *mesh = mesh_instance( g_renderer.fullscreen_quad );
-	glBindVertexArray( mesh->opengl_vao );
-	GLenum index_type = index_type_size_to_opengl( mesh->indices.item_size );
-	glDrawElements(
-		/*    mode */ GL_TRIANGLES,
-		/*   count */ mesh->indices.size,
-		/*    type */ index_type,
-		/* indices */ NULL
-	);
-}
-
 Renderer_Shader_Program *
 load_geometry_buffer_shader( StringView_ASCII vertex_stage_filepath, StringView_ASCII fragment_stage_filepath ) {
 
 	/* Stages */
 
-	Array< Renderer_Shader_Stage * > stages = array_new< Renderer_Shader_Stage * >( sys_allocator, RendererShaderKind_COUNT );
+	Linear_Allocator_Scope scratch_scope( frame_arena() );
+	Array< Renderer_Shader_Stage * > stages = array_new< Renderer_Shader_Stage * >( frame_arena(), RendererShaderKind_COUNT );
 
 	// Vertex
 	array_add( &stages, renderer_load_shader_stage(
@@ -623,48 +417,8 @@ load_geometry_buffer_shader( StringView_ASCII vertex_stage_filepath, StringView_
 
 	/* Uniforms */
 
-	Array< Renderer_Uniform > *uniforms = &shader->uniforms;
-
-	/* Vertex stage uniforms */
-
-	array_add( uniforms, Renderer_Uniform {
-		.name = "model",
-		.data_type = RendererDataType_Matrix4x4_f32,
-	} );
-
-	array_add( uniforms, Renderer_Uniform {
-		.name = "view",
-		.data_type = RendererDataType_Matrix4x4_f32,
-	} );
-
-	array_add( uniforms, Renderer_Uniform {
-		.name = "projection",
-		.data_type = RendererDataType_Matrix4x4_f32,
-	} );
-
-	array_add( uniforms, Renderer_Uniform {
-		.name = "normal_matrix",
-		.data_type = RendererDataType_Matrix3x3_f32,
-	} );
-
-	/* Fragment stage uniforms */
-
-	array_add( uniforms, Renderer_Uniform {
-		.name = "texture_diffuse0",
-		.data_type = RendererDataType_s32, // Sampler2D
-	} );
-
-	array_add( uniforms, Renderer_Uniform {
-		.name = "texture_normal0",
-		.data_type = RendererDataType_s32, // Sampler2D
-	} );
-
-	array_add( uniforms, Renderer_Uniform {
-		.name = "texture_specular0",
-		.data_type = RendererDataType_s32, // Sampler2D
-	} );
+	// Active uniforms are queried by `renderer_create_and_compile_shader_program()`.
 
-	renderer_shader_program_update_uniform_locations( shader );
 	return shader;
 }
 
@@ -680,6 +434,8 @@ setup_geometry_buffer( Vector2_u16 framebuffer_dimensions ) {
 		"resources/shaders/geometry_fragment.glsl"
 	);
 
+	// Material textures and parameters are looked up by the shader itself, there are no per-material uniforms.
+
 	/* G-Buffer Position texture */
 
 	g_renderer.gbuffer.texture_position = texture_create(
@@ -749,10 +505,34 @@ setup_geometry_buffer( Vector2_u16 framebuffer_dimensions ) {
 		RendererFramebufferAttachmentPoint_Color2
 	);
 
+	/* G-Buffer Material texture */
+
+	g_renderer.gbuffer.texture_material = texture_create(
+		/*       name */ "gbuffer_material",
+		/* dimensions */ framebuffer_dimensions,
+		/*   channels */ TextureChannels_Red,
+		/*      bytes */ ArrayView< u8 > {},
+		/*  allocator */ NULL
+	);
+	renderer_texture_2d_upload(
+		/*            texture_id */ g_renderer.gbuffer.texture_material,
+		/*                origin */ { 0, 0 },
+		/*            dimensions */ framebuffer_dimensions,
+		/*         mipmap_levels */ 1,
+		/* opengl_storage_format */ GL_R16UI,
+		/*    opengl_pixel_type  */ GL_UNSIGNED_SHORT
+	);
+	renderer_texture_attach_to_framebuffer(
+		g_renderer.gbuffer.texture_material,
+		g_renderer.gbuffer.framebuffer,
+		RendererFramebufferAttachmentPoint_Color3
+	);
+
 	Renderer_Framebuffer_Attachment_Point active_attachment_points[] = {
 		RendererFramebufferAttachmentPoint_Color0,  // position
 		RendererFramebufferAttachmentPoint_Color1,  // normal
-		RendererFramebufferAttachmentPoint_Color2   // color + specular
+		RendererFramebufferAttachmentPoint_Color2,  // color + specular
+		RendererFramebufferAttachmentPoint_Color3   // material ID
 	};
 
 	renderer_set_active_framebuffer_color_attachment_points(
@@ -790,127 +570,71 @@ renderer_create_default_framebuffer() {
 	renderer_bind_framebuffer( 0 );
 }
 
-static StringView_ASCII
-opengl_debug_message_source_name( GLenum source ) {
-	switch ( source ) {
-		case GL_DEBUG_SOURCE_API:              return "API";
-		case GL_DEBUG_SOURCE_WINDOW_SYSTEM:    return "Window System";
-		case GL_DEBUG_SOURCE_SHADER_COMPILER:  return "Shader Compiler";
-		case GL_DEBUG_SOURCE_THIRD_PARTY:      return "Third Party";
-		case GL_DEBUG_SOURCE_APPLICATION:      return "Application";
-
-		case GL_DEBUG_SOURCE_OTHER:
-		default:                               return "Other";
-	}
-}
-
-static StringView_ASCII
-opengl_debug_message_type_name( GLenum type ) {
-	switch ( type ) {
-		case GL_DEBUG_TYPE_ERROR:                return "Error";
-		case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:  return "Deprecated";
-		case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:   return "Undefined";
-		case GL_DEBUG_TYPE_PORTABILITY:          return "Portability";
-		case GL_DEBUG_TYPE_PERFORMANCE:          return "Performance";
-		case GL_DEBUG_TYPE_MARKER:               return "Marker";
-		case GL_DEBUG_TYPE_PUSH_GROUP:           return "Push Group";
-		case GL_DEBUG_TYPE_POP_GROUP:            return "Pop Group";
-
-		case GL_DEBUG_TYPE_OTHER:
-		default:                                 return "Other";
-	}
-}
-
-static StringView_ASCII
-opengl_debug_message_severity_name( GLenum severity ) {
-	switch ( severity ) {
-		case GL_DEBUG_SEVERITY_HIGH:          return "High";
-		case GL_DEBUG_SEVERITY_MEDIUM:        return "Medium";
-		case GL_DEBUG_SEVERITY_LOW:           return "Low";
-		case GL_DEBUG_SEVERITY_NOTIFICATION:  return "Info";
-
-		default:                              return "(Unknown)";
-	}
-}
-
-static void
-opengl_debug_message_callback(
-	GLenum source,
-	GLenum type,
-	GLuint id,
-	GLenum severity,
-	GLsizei length,
-	const GLchar *message,
-	const void *user_parameter
-) {
-	StringView_ASCII msg = string_view( message, /* offset */ 0, /* length */ length );
-	StringView_ASCII source_name = opengl_debug_message_source_name( source );
-	StringView_ASCII type_name = opengl_debug_message_type_name( type );
-	StringView_ASCII severity_name = opengl_debug_message_severity_name( severity );
-	Log_Level log_level;
-	switch ( severity ) {
-		case GL_DEBUG_SEVERITY_HIGH:          log_level = LogLevel_Error; break;
-
-		case GL_DEBUG_SEVERITY_MEDIUM:
-		case GL_DEBUG_SEVERITY_LOW:           log_level = LogLevel_Warning; break;
-
-		case GL_DEBUG_SEVERITY_NOTIFICATION:
-		default:                              log_level = LogLevel_Debug; break;
-	}
-	// The function itself is called only with the OpenGL debug output set up,
-	// no need to wrap with `QLIGHT_DEBUG`.
-	log_gl(
-		log_level,
-		StringViewFormat "::" StringViewFormat " (#%d, " StringViewFormat "): " StringViewFormat,
-		StringViewArgument( source_name ),
-		StringViewArgument( type_name ),
-		id,
-		StringViewArgument( severity_name ),
-		StringViewArgument( msg )
-	);
-}
-
-inline static u32
-opengl_query_constant_as_u32( GLint constant, GLint *out_gl_result ) {
-	glGetIntegerv( constant, out_gl_result );
-	return ( u32 ) *out_gl_result;
-}
-
+// Starts building the packet again.  The render thread must be done with it.
 static void
-opengl_query_constants() {
-	GL_Constants *gl = &g_renderer.gl_constants;
-	GLint gl_result;
-
-	gl->max_color_attachments       = opengl_query_constant_as_u32( GL_MAX_COLOR_ATTACHMENTS, &gl_result );
-	gl->max_uniform_block_size      = opengl_query_constant_as_u32( GL_MAX_UNIFORM_BLOCK_SIZE, &gl_result );
-	gl->max_uniform_locations       = opengl_query_constant_as_u32( GL_MAX_UNIFORM_LOCATIONS, &gl_result );
-	gl->max_uniform_buffer_bindings = opengl_query_constant_as_u32( GL_MAX_UNIFORM_BUFFER_BINDINGS, &gl_result );
-	gl->min_map_buffer_alignment    = opengl_query_constant_as_u32( GL_MIN_MAP_BUFFER_ALIGNMENT, &gl_result );
+frame_packet_begin( Renderer_Frame_Packet *packet ) {
+	packet->arena.reset( /* zero_memory */ false );
+	packet->dirty_instances = ArrayView< Renderer_Instance_Data > { 0 };
+	packet->render_queue = ArrayView< Renderer_Render_Command > { 0 };
+	packet->materials = ArrayView< Renderer_Material_Parameters > { 0 };
+	packet->storage_buffers_count = 0;
+	packet->texture_updates_count = 0;
+	packet->command_streams = ArrayView< Renderer_Command_Stream * > { 0 };
+	packet->ui_draw_data = NULL;
+	packet->capture_file_path = NULL;
+}
+
+// Returns NULL if the packet's arena is full.
+static void *
+frame_packet_allocate( Renderer_Frame_Packet *packet, u64 size, u64 alignment = RENDERER_FRAME_PACKET_ALIGNMENT ) {
+	// Not through `Allocate`, which asserts on failure: a full packet only drops what did not fit.
+	return packet->arena.allocate_aligned( size, alignment );
+}
+
+template < typename T >
+static T *
+frame_packet_copy( Renderer_Frame_Packet *packet, const T *data, u32 count ) {
+	T *copy = ( T * )frame_packet_allocate( packet, ( u64 )count * sizeof( T ), QL_max2( ( u64 )alignof( T ), RENDERER_FRAME_PACKET_ALIGNMENT ) );
+	if ( copy && count > 0 )
+		memcpy( copy, data, ( u64 )count * sizeof( T ) );
+	return copy;
 }
 
 bool
-renderer_init() {
+renderer_init( Renderer_Backend backend ) {
 	log_debug( "Initializing Renderer..." );
 	if ( g_renderer.programs.data )
 		return false;
 
-//#if QLIGHT_DEBUG
-#if 1
-	glEnable( GL_DEBUG_OUTPUT );
-	glEnable( GL_DEBUG_OUTPUT_SYNCHRONOUS );
-	GLuint disabled_messages[] {
-		/* Buffer detailed info */ 131185
-	};
-	glDebugMessageControl(
-	    /*   source */ GL_DEBUG_SOURCE_API,
-	    /*     type */ GL_DEBUG_TYPE_OTHER,
-	    /* severity */ GL_DONT_CARE,
-	    /*    count */ ARRAY_SIZE( disabled_messages ),
-	    /*      ids */ disabled_messages,
-	    /*  enabled */ GL_FALSE
-	);
-	glDebugMessageCallback( opengl_debug_message_callback, NULL );
+	g_renderer.backend = backend;
+	g_renderer.null_object_name = 0;
+	switch ( backend ) {
+#ifndef QLIGHT_HEADLESS
+		case RendererBackend_OpenGL:   g_renderer.dispatch = renderer_backend_opengl(); break;
+#endif
+		case RendererBackend_Null:     g_renderer.dispatch = renderer_backend_null(); break;
+		case RendererBackend_Software: g_renderer.dispatch = renderer_backend_software(); break;
+
+		default:
+			log_error( "Renderer backend " StringViewFormat " is not part of this build.", StringViewArgument( renderer_backend_name( backend ) ) );
+			return false;
+	}
+
+	g_renderer.settings = Renderer_Frame_Settings {
+		.output_channel = RendererOutputChannel_FinalColor,
+#ifdef QLIGHT_DEBUG
+		.gl_error_check_mode = RendererGLErrorCheckMode_DebugCallback,
+#else
+		.gl_error_check_mode = RendererGLErrorCheckMode_Off,
 #endif
+		.gl_error_check_interval = RENDERER_GL_ERROR_CHECK_DEFAULT_SAMPLE_INTERVAL,
+		.gl_error_check_requested = false,
+		.capture_frames_count = 0
+	};
+	g_renderer.gl_error_checks.sample_interval = g_renderer.settings.gl_error_check_interval;
+	g_renderer.gl_error_checks.frame_idx = 0;
+	g_renderer.gl_error_checks.requested = false;
+	g_renderer.dispatch.set_error_check_mode( g_renderer.settings.gl_error_check_mode );
 
 	g_renderer.opengl_error_log = string_new( sys_allocator, RENDERER_OPENGL_ERROR_LOG_CAPACITY );
 	g_renderer.opengl_info_log = string_new( sys_allocator, RENDERER_OPENGL_INFO_LOG_CAPACITY );
@@ -924,41 +648,77 @@ renderer_init() {
 	g_renderer.uniforms_transpose_matrix = false;
 	g_renderer.framebuffers = array_new< Renderer_Framebuffer >( sys_allocator, RENDERER_INITIAL_FRAMEBUFFERS_CAPACITY );
 	g_renderer.renderbuffers = array_new< Renderer_Renderbuffer >( sys_allocator, RENDERER_INITIAL_RENDERBUFFERS_CAPACITY );
-	g_renderer.programs = array_new< Renderer_Shader_Program >( sys_allocator, RENDERER_INITIAL_PROGRAMS_CAPACITY );
-	g_renderer.stages = array_new< Renderer_Shader_Stage >( sys_allocator, RENDERER_INITIAL_STAGES_CAPACITY );
-	g_renderer.uniform_buffers = array_new< Renderer_Uniform_Buffer >( sys_allocator, RENDERER_INITIAL_UNIFORM_BUFFERS_CAPACITY );
-
-	opengl_query_constants();
+	if ( !g_renderer.programs_arena.init( RENDERER_MAX_PROGRAMS * sizeof( Renderer_Shader_Program ), false ) ||
+		!g_renderer.stages_arena.init( RENDERER_MAX_STAGES * sizeof( Renderer_Shader_Stage ), false ) ||
+		!g_renderer.uniform_buffers_arena.init( RENDERER_MAX_UNIFORM_BUFFERS * sizeof( Renderer_Uniform_Buffer ), false )
+	) {
+		log_error( "Failed to reserve address space for shader programs, stages and uniform buffers." );
+		return false;
+	}
+	g_renderer.programs = array_new< Renderer_Shader_Program >( &g_renderer.programs_arena, RENDERER_INITIAL_PROGRAMS_CAPACITY );
+	g_renderer.stages = array_new< Renderer_Shader_Stage >( &g_renderer.stages_arena, RENDERER_INITIAL_STAGES_CAPACITY );
+	g_renderer.uniform_buffers = array_new< Renderer_Uniform_Buffer >( &g_renderer.uniform_buffers_arena, RENDERER_INITIAL_UNIFORM_BUFFERS_CAPACITY );
+	g_renderer.geometry_pools = array_new< Geometry_Pool >( sys_allocator, RENDERER_INITIAL_GEOMETRY_POOLS_CAPACITY );
+	g_renderer.texture_array_pools = array_new< Texture_Array_Pool >( sys_allocator, RENDERER_MAX_TEXTURE_ARRAY_POOLS );
+
+	// Uniform buffers the backend creates are added to `uniform_buffers`.
+	if ( !g_renderer.dispatch.init() )
+		return false;
+	opengl_state_init( &g_renderer.gl_state, g_renderer.dispatch.state );
 
-	g_renderer.device.vendor = string_view( ( const char * )glGetString( GL_VENDOR ) );
-	g_renderer.device.name = string_view( ( const char * )glGetString( GL_RENDERER ) );
+	// Before anything that needs scratch.  `Linear_Allocator::deinit` gives the memory back to `sys_allocator`.
+	ForIt( g_renderer.frame_arenas, ARRAY_SIZE( g_renderer.frame_arenas ) ) {
+		u8 *arena_memory = Allocate( sys_allocator, RENDERER_FRAME_ARENA_SIZE, u8 );
+		it = Linear_Allocator {};
+		it.init( arena_memory, RENDERER_FRAME_ARENA_SIZE );
+	}}
+	g_renderer.steady_state_packets = 0;
 
 	renderer_create_default_framebuffer();
 	constexpr Vector2_u16 TEMP_dimensions = { 1280, 720 };
 	setup_geometry_buffer( TEMP_dimensions );
 	setup_fullscreen_quad();
 
-	g_renderer.output_channel = RendererOutputChannel_FinalColor;
-
 	g_renderer.camera_position = NULL;
 	g_renderer.view_matrix = NULL;
 	g_renderer.projection_matrix = NULL;
 	g_renderer.ambient_light = Vector3_f32 { 0, 0, 0 };
 
-	g_renderer.render_queue = array_new< Renderer_Render_Command >( sys_allocator, 32 );
-	g_renderer.render_queue_material_sequence = array_new< u16 >( sys_allocator, 32 );
+	renderer_proxy_table_init( &g_renderer.proxies, sys_allocator, RENDERER_INITIAL_PROXIES_CAPACITY );
+	g_renderer.proxy_instance_capacity = 0;
+	g_renderer.proxy_instance_buffer = 0;
+	g_renderer.proxy_instance_buffer_capacity = 0;
+	g_renderer.visible_proxies = array_new< Renderer_Proxy_ID >( sys_allocator, RENDERER_INITIAL_PROXIES_CAPACITY );
+	g_renderer.submitted_streams = array_new< Renderer_Command_Stream * >( sys_allocator, 4 );
+	// In the frame arenas, set every frame.
+	g_renderer.render_queue = Array< Renderer_Render_Command > { 0 };
+	g_renderer.render_batches = Array< Renderer_Instance_Batch > { 0 };
+	g_renderer.indirect_commands = Array< Renderer_Draw_Elements_Indirect_Command > { 0 };
+	g_renderer.indirect_draws = Array< Renderer_Indirect_Draw > { 0 };
+	g_renderer.instance_indices_allocation = Renderer_Frame_Allocation { 0 };
+	g_renderer.indirect_allocation = Renderer_Frame_Allocation { 0 };
+	g_renderer.material_allocation = Renderer_Frame_Allocation { 0 };
+	g_renderer.frame_constants_allocation = Renderer_Frame_Allocation { 0 };
+	g_renderer.lighting_program = NULL;
+	g_renderer.draw_stats = G_Renderer::Draw_Stats { 0 };
+	g_renderer.reported_stats = G_Renderer::Reported_Stats { 0 };
+
+	// `Linear_Allocator::deinit` gives the memory back to `sys_allocator`.
+	ForIt( g_renderer.packets, ARRAY_SIZE( g_renderer.packets ) ) {
+		u8 *arena_memory = Allocate( sys_allocator, RENDERER_FRAME_PACKET_ARENA_SIZE, u8 );
+		it.arena = Linear_Allocator {};
+		it.arena.init( arena_memory, RENDERER_FRAME_PACKET_ARENA_SIZE );
+	}}
+	g_renderer.packet_idx = 0;
+	g_renderer.frame_idx = 0;
+	frame_packet_begin( &g_renderer.packets[ g_renderer.packet_idx ] );
 
 	create_default_textures();
 
-	// Set facet winding order to clockwise.
-	// Then, clockwise ordered facets are considered to be front-facing,
-	//   while counter-clockwise ordered to be back-facing.
-	glFrontFace( GL_CW );
-
 	// Enable back-facing facets culling.
-	glEnable( GL_CULL_FACE );
+	opengl_state_set_capability( &g_renderer.gl_state, OpenGLStateCapability_CullFace, true );
 
-	log_debug( "Renderer has been initialized." );
+	log_debug( "Renderer has been initialized (" StringViewFormat " backend).", StringViewArgument( renderer_backend_name( backend ) ) );
 	return true;
 }
 
@@ -967,14 +727,65 @@ renderer_shutdown() {
 	if ( !g_renderer.programs.data )
 		return;
 
+	renderer_capture_end();
+	g_renderer.dispatch.shutdown();
+
 	array_free( &g_renderer.framebuffers );
 	array_free( &g_renderer.renderbuffers );
+	ForIt( g_renderer.programs.data, g_renderer.programs.size ) {
+		renderer_destroy_shader_program( &it );
+	}}
 	array_free( &g_renderer.programs );
 	array_free( &g_renderer.stages );
 	array_free( &g_renderer.uniform_buffers );
+	g_renderer.programs_arena.deinit();
+	g_renderer.stages_arena.deinit();
+	g_renderer.uniform_buffers_arena.deinit();
+
+	renderer_proxy_table_destroy( &g_renderer.proxies );
+	g_renderer.proxy_instance_buffer = 0;
+	g_renderer.proxy_instance_buffer_capacity = 0;
+	g_renderer.proxy_instance_capacity = 0;
+	array_free( &g_renderer.visible_proxies );
+	array_free( &g_renderer.submitted_streams );
+	g_renderer.render_queue = Array< Renderer_Render_Command > { 0 };
+	g_renderer.render_batches = Array< Renderer_Instance_Batch > { 0 };
+	g_renderer.indirect_commands = Array< Renderer_Draw_Elements_Indirect_Command > { 0 };
+	g_renderer.indirect_draws = Array< Renderer_Indirect_Draw > { 0 };
+	ForIt( g_renderer.packets, ARRAY_SIZE( g_renderer.packets ) ) {
+		it.arena.deinit();
+	}}
+	ForIt( g_renderer.frame_arenas, ARRAY_SIZE( g_renderer.frame_arenas ) ) {
+		it.deinit();
+	}}
+
+	ForIt( g_renderer.geometry_pools.data, g_renderer.geometry_pools.size ) {
+		array_free( &it.vertex_attributes );
+		offset_allocator_destroy( &it.vertices );
+		offset_allocator_destroy( &it.indices );
+	}}
+	array_free( &g_renderer.geometry_pools );
+
+	ForIt( g_renderer.texture_array_pools.data, g_renderer.texture_array_pools.size ) {
+		array_free( &it.layers );
+	}}
+	array_free( &g_renderer.texture_array_pools );
+}
+
+Renderer_Backend
+renderer_backend() {
+	return g_renderer.backend;
+}
 
-	array_free( &g_renderer.render_queue );
-	array_free( &g_renderer.render_queue_material_sequence );
+StringView_ASCII
+renderer_backend_name( Renderer_Backend backend ) {
+	switch ( backend ) {
+		case RendererBackend_OpenGL:  return "OpenGL";
+		case RendererBackend_Null:    return "Null";
+		case RendererBackend_Software: return "Software";
+
+		default: return string_view( ( const char * )NULL );
+	}
 }
 
 static void
@@ -1017,11 +828,22 @@ renderer_destroy_shader_stage( Renderer_Shader_Stage *stage ) {
 
 bool
 renderer_destroy_shader_program( Renderer_Shader_Program *program ) {
-	printf(
-		"WARNING: renderer_destroy_shader_program( \"" StringViewFormat "\" ): Not implemented yet.\n",
+	log_debug( "Destroying '" StringViewFormat "' shader program.",
 		StringViewArgument( program->name )
 	);
-	Assert( false );
+	ForIt( program->uniforms.data, program->uniforms.size ) {
+		if ( it.bits & RendererUniformBit_OwnsName )
+			Deallocate( sys_allocator, ( void * )it.name.data );
+	}}
+	array_free( &program->vertex_attributes );
+	array_free( &program->uniforms );
+	array_free( &program->uniform_buffers );
+
+	g_renderer.dispatch.program_destroy( program );
+	program->opengl_program = 0;
+	program->linked_shaders = 0;
+	// The slot stays, so pointers to the other programs stay valid, but it is not found by name anymore.
+	program->name = StringView_ASCII();
 	return true;
 }
 
@@ -1041,45 +863,6 @@ renderer_shader_kind_name( Renderer_Shader_Kind kind ) {
 
 #include <stdio.h> // @TODO: Remove
 
-static GLuint
-opengl_compile_shader_stage( Renderer_Shader_Stage *stage ) {
-	GLuint shader_type = renderer_shader_kind_to_opengl( stage->kind );
-	StringView_ASCII shader_kind = renderer_shader_kind_name( stage->kind );
-	log_debug_gl( "Compiling '" StringViewFormat "' " StringViewFormat " stage shader...",
-		StringViewArgument( stage->name ),
-		StringViewArgument( shader_kind )
-	);
-
-	GLuint shader_id = glCreateShader( shader_type );
-	const GLchar *sources[] = { stage->source_code.data };
-	const GLint lengths[] = { ( GLint )stage->source_code.size };
-	glShaderSource( shader_id, 1, sources, lengths );
-
-	GLint compile_result;
-	glCompileShader( shader_id );
-	glGetShaderiv( shader_id, GL_COMPILE_STATUS, &compile_result );
-	if ( compile_result != GL_TRUE ) {
-		StringView_ASCII info_log = opengl_get_info_log( OpenGL_Shader, shader_id );
-
-		log_error_gl( "Failed to compile '" StringViewFormat "' " StringViewFormat " stage shader! Error log:\n" StringViewFormat,
-			StringViewArgument( stage->name ),
-			StringViewArgument( shader_kind ),
-			StringViewArgument( info_log )
-		);
-
-		// No need to delete it now, it will be deleted later
-		//   in `renderer_create_and_compile_shader_program`
-		//   whether it compiled successfully or not.
-	} else {
-		log_debug_gl( "Compiled '" StringViewFormat "' " StringViewFormat" shader stage.",
-			StringViewArgument( stage->name ),
-			StringViewArgument( shader_kind )
-		);
-	}
-
-	return shader_id;
-}
-
 GLenum
 renderer_shader_kind_to_opengl( Renderer_Shader_Kind kind ) {
 	switch ( kind ) {
@@ -1150,134 +933,73 @@ renderer_create_and_compile_shader_program( StringView_ASCII name, ArrayView< Re
 		.uniform_buffers = array_new< Renderer_Uniform_Buffer >( sys_allocator, SHADER_PROGRAM_UNIFORM_BUFFERS_INITIAL_CAPACITY )
 	};
 
-	GL_CHECK( program.opengl_program = glCreateProgram() );
-#ifdef QLIGHT_DEBUG
-	glObjectLabel( GL_PROGRAM, program.opengl_program, name.size, name.data );
-#endif
-
-	// Iterate over passes shader stages.
-	ForIt( shader_stages.data, shader_stages.size ) {
-		Renderer_Shader_Kind_Bits kind_bit = renderer_shader_kind_bit( it->kind );
-		if ( program.linked_shaders & kind_bit ) {
-			// Complain and skip.
-			StringView_ASCII shader_kind = renderer_shader_kind_name( it->kind );
-			log_warning_gl(
-				"WARNING: Trying to attach " StringFormat " stage shader to '" StringFormat "' shader program, but it already has one. Skipping.",
-				StringArgumentValue( shader_kind ),
-				StringArgumentValue( name )
-			);
-			continue;
-		}
+	g_renderer.dispatch.program_create( &program, shader_stages );
 
-		it->opengl_shader = opengl_compile_shader_stage( it );
-		glAttachShader( program.opengl_program, it->opengl_shader );
-#ifdef QLIGHT_DEBUG
-		glObjectLabel( GL_SHADER, it->opengl_shader, it->name.size, it->name.data );
-#endif
+	u32 program_idx = array_add( &g_renderer.programs, program );
+	Renderer_Shader_Program * program_ptr = &g_renderer.programs.data[ program_idx ];
+	log_debug( "Created and compiled '" StringViewFormat "' shader program.",
+		StringViewArgument( name )
+	);
+	return program_ptr;
+}
 
-		program.shaders[ it_index ] = it;
-		program.linked_shaders |= kind_bit;
+Renderer_Uniform_ID
+renderer_shader_program_find_uniform( Renderer_Shader_Program *program, StringView_ASCII uniform_name ) {
+	ForIt( program->uniforms.data, program->uniforms.size ) {
+		if ( string_equals( uniform_name, it.name ) )
+			return ( Renderer_Uniform_ID )it_index;
 	}}
 
-	GLint opengl_result;
+	return INVALID_UNIFORM_ID;
+}
 
-	GL_CHECK( glLinkProgram( program.opengl_program ) );
-	glGetProgramiv( program.opengl_program, GL_LINK_STATUS, &opengl_result );
-	if ( opengl_result != GL_TRUE ) {
-		StringView_ASCII info_log = opengl_get_info_log( OpenGL_Program, program.opengl_program );
+bool
+renderer_shader_program_set_uniform( Renderer_Shader_Program *program, Renderer_Uniform_ID uniform_id, void *value ) {
+	// Uniform might have been optimized out by the shader compiler.
+	if ( uniform_id == INVALID_UNIFORM_ID )
+		return false;
 
-		log_error_gl(
-			"Failed to link '" StringFormat "' shader program! Error log:\n" StringFormat,
-			StringArgumentValue( program.name ),
-			StringViewArgument( info_log )
-		);
-	}
+	Assert( uniform_id < program->uniforms.size );
+	if ( uniform_id >= program->uniforms.size )
+		return false;
 
-	GL_CHECK( glValidateProgram( program.opengl_program ) );
-	glGetProgramiv( program.opengl_program, GL_VALIDATE_STATUS, &opengl_result );
-	if ( opengl_result != GL_TRUE ) {
-		StringView_ASCII info_log = opengl_get_info_log( OpenGL_Program, program.opengl_program );
+	Renderer_Uniform *uniform = &program->uniforms.data[ uniform_id ];
+	u32 value_size = renderer_uniform_size( uniform );
+	bool shadowed = ( value_size <= RENDERER_UNIFORM_SHADOW_VALUE_SIZE );
 
-		log_error_gl(
-			"Failed to validate '" StringFormat "' shader program! Error log:\n" StringFormat,
-			StringArgumentValue( program.name ),
-			StringViewArgument( info_log )
-		);
-	}
+	// Program uniforms keep their values until the program is relinked,
+	//   so if the value has not changed since the last upload, there is nothing to do.
+	if ( shadowed && ( uniform->bits & RendererUniformBit_HasShadowValue ) && memcmp( uniform->shadow_value, value, value_size ) == 0 )
+		return true;
 
-	// Iterate over program's shaders.
-	// No `.data` because it is a flat C array, not Array/ArrayView struct.
-	ForIt( program.shaders, RendererShaderKind_COUNT ) {
-		if ( !it )
-			continue;
-
-		Renderer_Shader_Kind_Bits kind_bit = renderer_shader_kind_bit( it->kind );
-		if ( !( program.linked_shaders & kind_bit ) )
-			continue;
-
-		GL_CHECK( glDeleteShader( it->opengl_shader ) );
-		glGetShaderiv( it->opengl_shader, GL_DELETE_STATUS, &opengl_result );
-		if ( opengl_result != GL_TRUE ) {
-			StringView_ASCII info_log = opengl_get_info_log( OpenGL_Program, program.opengl_program );
-
-			log_error_gl(
-				"Failed to mark '" StringFormat "' shader stage for deletion! Error log:\n" StringFormat,
-				StringArgumentValue( it->name ),
-				StringViewArgument( info_log )
-			);
-		}
-	}}
+	if ( !g_renderer.dispatch.program_set_uniform( program, uniform, value ) )
+		return false;
 
-	u32 program_idx = array_add( &g_renderer.programs, program );
-	Renderer_Shader_Program * program_ptr = &g_renderer.programs.data[ program_idx ];
-	log_debug( "Created and compiled '" StringViewFormat "' shader program.",
-		StringViewArgument( name )
-	);
-	return program_ptr;
+	if ( shadowed ) {
+		memcpy( uniform->shadow_value, value, value_size );
+		uniform->bits |= RendererUniformBit_HasShadowValue;
+	}
+
+	return true;
 }
 
 bool
 renderer_shader_program_set_uniform( Renderer_Shader_Program *program, StringView_ASCII uniform_name, Renderer_Data_Type data_type, void *value ) {
-	bool transpose = g_renderer.uniforms_transpose_matrix;
-
-	// The function can determine whether the OpenGL call was successfull
-	//   only if the OpenGL error logging is turned on.  Otherwise, it
-	//   will always return true.
-	// `success` can only be overwritten if `QLIGHT_OPENGL_ERROR_CHECKS` is defined
-	//   and `glUniformXXX` call generates an error.
-	bool success = true;
-	bool *result = &success;
-	ForIt( program->uniforms.data, program->uniforms.size ) {
-		if ( string_equals( uniform_name, it.name ) ) {
-			Assert( data_type == it.data_type );
-			if ( data_type != it.data_type )
-				return false;
-
-			GLuint location = it.opengl_location;
-			switch ( data_type ) {
-				// Sampler2D ?
-				case RendererDataType_s32:
-					GL_CHECK_AND_STORE_RESULT( result, glUniform1i( location, *( s32 *)value ) ); break;
-				case RendererDataType_f32:
-					GL_CHECK_AND_STORE_RESULT( result, glUniform1f( location, *( f32 *)value ) ); break;
-				case RendererDataType_Vector2_f32:
-					GL_CHECK_AND_STORE_RESULT( result, glUniform2fv( location, 1, ( f32 * )value ) ); break;
-				case RendererDataType_Vector3_f32:
-					GL_CHECK_AND_STORE_RESULT( result, glUniform3fv( location, 1, ( f32 * )value ) ); break;
-				case RendererDataType_Vector4_f32:
-					GL_CHECK_AND_STORE_RESULT( result, glUniform4fv( location, 1, ( f32 * )value ) ); break;
-				case RendererDataType_Matrix3x3_f32:
-					GL_CHECK_AND_STORE_RESULT( result, glUniformMatrix3fv( location, 1, transpose, ( f32 * )value ) ); break;
-				case RendererDataType_Matrix4x4_f32:
-					GL_CHECK_AND_STORE_RESULT( result, glUniformMatrix4fv( location, 1, transpose, ( f32 * )value ) ); break;
-				default:
-					AssertMessage( false, "Unsupported type" );
-					return false;
-			}
-		}
-	}}
+	Renderer_Uniform_ID uniform_id = renderer_shader_program_find_uniform( program, uniform_name );
+	if ( uniform_id == INVALID_UNIFORM_ID )
+		return false;
+
+	Renderer_Uniform *uniform = &program->uniforms.data[ uniform_id ];
+	Assert( data_type == uniform->data_type );
+	if ( data_type != uniform->data_type )
+		return false;
+
+	return renderer_shader_program_set_uniform( program, uniform_id, value );
+}
 
-	return success;
+u32
+renderer_shader_program_query_uniforms( Renderer_Shader_Program *program ) {
+	return g_renderer.dispatch.program_query_uniforms( program );
 }
 
 u32
@@ -1286,7 +1008,9 @@ renderer_shader_program_update_uniform_locations( Renderer_Shader_Program *progr
 	ForIt( program->uniforms.data, program->uniforms.size ) {
 		// @Warning: uniform's name must be null-terminated!
 		// @TODO: Check for OpenGL errors
-		it.opengl_location = glGetUniformLocation( program->opengl_program, it.name.data );
+		it.opengl_location = g_renderer.dispatch.program_uniform_location( program, &it );
+		// Relinked program starts with default uniform values.
+		it.bits &= ~RendererUniformBit_HasShadowValue;
 		if ( it.opengl_location != -1 )
 			updated += 1;
 		else
@@ -1306,7 +1030,22 @@ renderer_shader_program_update_uniform_locations( Renderer_Shader_Program *progr
 
 void
 renderer_set_uniforms_transpose_matrix( bool value ) {
+	if ( g_renderer.uniforms_transpose_matrix == value )
+		return;
+
 	g_renderer.uniforms_transpose_matrix = value;
+
+	// Shadowed matrices were uploaded with the other layout.
+	ForIt( g_renderer.programs.data, g_renderer.programs.size ) {
+		ForIt2( it.uniforms.data, it.uniforms.size ) {
+			it2.bits &= ~RendererUniformBit_HasShadowValue;
+		}}
+	}}
+}
+
+u32
+renderer_uniform_size( Renderer_Uniform *uniform ) {
+	return renderer_data_type_size( uniform->data_type ) * uniform->elements;
 }
 
 u32
@@ -1389,19 +1128,7 @@ renderer_create_renderbuffer(
 		// .opengl_renderbuffer
 	};
 
-	// Legacy: glGenRenderbuffers (cannot be used in Direct State Access functions (glNamedRenderbuffer).
-	GL_CHECK( glCreateRenderbuffers( 1, &renderbuffer.opengl_renderbuffer ) );
-#ifdef QLIGHT_DEBUG
-	glObjectLabel( GL_RENDERBUFFER, renderbuffer.opengl_renderbuffer, name.size, name.data );
-#endif
-	// glBindRenderbuffer( GL_RENDERBUFFER, renderbuffer.opengl_renderbuffer );
-	// glRenderbufferStorage( GL_RENDERBUFFER, ... );
-	glNamedRenderbufferStorage(
-		/*   renderbuffer */ renderbuffer.opengl_renderbuffer,
-		/* internalformat */ opengl_storage_format,
-		/*          width */ ( GLsizei )dimensions.width,
-		/*         height */ ( GLsizei )dimensions.height
-	);
+	renderbuffer.opengl_renderbuffer = g_renderer.dispatch.renderbuffer_create( name, dimensions, opengl_storage_format );
 
 	u32 renderbuffer_idx = array_add( &g_renderer.renderbuffers, renderbuffer );
 	StringView_ASCII attachment_point_name = renderer_framebuffer_attachment_point_name( renderbuffer.attachment_point );
@@ -1443,11 +1170,7 @@ renderer_create_framebuffer( StringView_ASCII name ) {
 		// .opengl_framebuffer
 	};
 
-	// Legacy: glGenFramebuffers (cannot be used in Direct State Access functions (glNamedFramebuffer).
-	GL_CHECK( glCreateFramebuffers( 1, &framebuffer.opengl_framebuffer ) );
-#ifdef QLIGHT_DEBUG
-	glObjectLabel( GL_FRAMEBUFFER, framebuffer.opengl_framebuffer, name.size, name.data );
-#endif
+	framebuffer.opengl_framebuffer = g_renderer.dispatch.framebuffer_create( name );
 
 	u32 framebuffer_idx = array_add( &g_renderer.framebuffers, framebuffer );
 	log_info( "Created Framebuffer '" StringViewFormat "' (#%u).",
@@ -1485,13 +1208,7 @@ renderer_renderbuffer_attach_to_framebuffer( Renderer_Framebuffer_ID framebuffer
 	if ( opengl_framebuffer_attachment == GL_INVALID_ENUM )
 		return false;
 
-	// glFramebufferRenderbuffer( GL_FRAMEBUFFER, ... );
-	glNamedFramebufferRenderbuffer(
-		/*        framebuffer */ framebuffer->opengl_framebuffer,
-		/*         attachment */ opengl_framebuffer_attachment,
-		/* renderbuffertarget */ GL_RENDERBUFFER,
-		/*       renderbuffer */ renderbuffer->opengl_renderbuffer
-	);
+	g_renderer.dispatch.framebuffer_attach_renderbuffer( framebuffer, opengl_framebuffer_attachment, renderbuffer );
 
 	Renderer_Framebuffer_Attachment attachment = {
 		.attachment_point = attachment_point,
@@ -1553,9 +1270,7 @@ renderer_framebuffer_attachment_point_to_opengl( Renderer_Framebuffer_Attachment
 bool
 renderer_is_framebuffer_complete( Renderer_Framebuffer_ID framebuffer_id ) {
 	Renderer_Framebuffer *framebuffer = renderer_framebuffer_instance( framebuffer_id );
-	GLenum opengl_framebuffer_status = glCheckNamedFramebufferStatus( framebuffer->opengl_framebuffer, GL_FRAMEBUFFER );
-	bool complete = ( opengl_framebuffer_status == GL_FRAMEBUFFER_COMPLETE );
-	return complete;
+	return g_renderer.dispatch.framebuffer_is_complete( framebuffer );
 }
 
 void
@@ -1567,9 +1282,8 @@ renderer_set_active_framebuffer_color_attachment_points( Renderer_Framebuffer_ID
 
 	Renderer_Framebuffer *framebuffer = renderer_framebuffer_instance( framebuffer_id );
 
-	// Can we do it nicely without memory allocation?
-	Array< GLenum > opengl_color_attachments = array_new< GLenum >( sys_allocator, color_attachment_points.size );
-	// GLenum opengl_color_attachments[ GL_MAX_COLOR_ATTACHMENTS ];
+	Linear_Allocator_Scope scratch_scope( frame_arena() );
+	Array< GLenum > opengl_color_attachments = array_new< GLenum >( frame_arena(), color_attachment_points.size );
 
 	// Mark all color attachments as not active (depth/stencil is always active).
 	ForIt( framebuffer->attachments.data, framebuffer->attachments.size ) {
@@ -1596,341 +1310,349 @@ renderer_set_active_framebuffer_color_attachment_points( Renderer_Framebuffer_ID
 		array_add( &opengl_color_attachments, opengl_color_attachment );
 	}}
 
-	glNamedFramebufferDrawBuffers( framebuffer->opengl_framebuffer, opengl_color_attachments.size, opengl_color_attachments.data );
-	array_free( &opengl_color_attachments );
+	g_renderer.dispatch.framebuffer_set_draw_buffers( framebuffer, array_view( &opengl_color_attachments ) );
 }
 
+// TODO: Remove
+#include "opengl.h"
+extern Screen screen;
+
 static void
-geometry_pass_use_material( Material *material ) {
-	// We do not bind material's shader here since it is a Geometry pass
-	Renderer_Shader_Program *gbuffer_shader = g_renderer.gbuffer.shader_program;
-
-	// These are pointers to bound camera's matrices.
-	renderer_shader_program_set_uniform( gbuffer_shader, "view", RendererDataType_Matrix4x4_f32, g_renderer.view_matrix );
-	renderer_shader_program_set_uniform( gbuffer_shader, "projection", RendererDataType_Matrix4x4_f32, g_renderer.projection_matrix );
-
-	/* Diffuse texture */
-
-	// uniform sampler2D texture_diffuse0;
-	s32 texture_diffuse_index = 0; // make configurable
-	renderer_shader_program_set_uniform(
-		gbuffer_shader,
-		"texture_diffuse0",
-		RendererDataType_s32,
-		&texture_diffuse_index
-	);
-	Texture_ID texture_diffuse_id = ( material->diffuse != INVALID_TEXTURE_ID ) ? material->diffuse : g_renderer.texture_purple_checkers;
-	renderer_bind_texture( texture_diffuse_index, texture_diffuse_id );
-
-	/* Normal map texture */
-
-	// uniform sampler2D texture_normal0;
-	s32 texture_normal_index = 1; // make configurable
-	renderer_shader_program_set_uniform(
-		gbuffer_shader,
-		"texture_normal0",
-		RendererDataType_s32,
-		&texture_normal_index
-	);
-	Texture_ID texture_normal_id = ( material->normal_map != INVALID_TEXTURE_ID ) ? material->normal_map : g_renderer.texture_white;
-	renderer_bind_texture( texture_normal_index, texture_normal_id );
-
-	/* Specular map texture */
-
-	// uniform sampler2D texture_specular0;
-	s32 texture_specular_index = 2; // make configurable
-	renderer_shader_program_set_uniform(
-		gbuffer_shader,
-		"texture_specular0",
-		RendererDataType_s32,
-		&texture_specular_index
-	);
-	Texture_ID texture_specular_id = ( material->specular_map != INVALID_TEXTURE_ID ) ? material->specular_map : g_renderer.texture_white;
-	renderer_bind_texture( texture_specular_index, texture_specular_id );
+replay_command_draw( Renderer_Command_Draw *draw ) {
+	Mesh *mesh = mesh_instance( draw->mesh_id );
+	if ( !mesh || !mesh_is_uploaded( mesh ) )
+		return;
+
+	Geometry_Pool *pool = &g_renderer.geometry_pools.data[ mesh->geometry_pool_id ];
+	opengl_state_bind_vertex_array( &g_renderer.gl_state, pool->opengl_vao );
+	g_renderer.draw_stats.draw_calls += 1;
+	g_renderer.dispatch.mesh_draw( pool, mesh, draw->instance_count, draw->first_instance );
 }
 
-static void
-geometry_pass_draw_same_material_commands( ArrayView< Renderer_Render_Command > commands ) {
-	Material_ID material_id = commands.data[ 0 ].material_id;
-	Material *material = material_instance( material_id );
-	Renderer_Shader_Program *gbuffer_shader = g_renderer.gbuffer.shader_program;
-	renderer_bind_shader_program( gbuffer_shader );
-	geometry_pass_use_material( material );
-
-	ForIt( commands.data, commands.size ) {
-		Mesh *mesh = mesh_instance( it.mesh_id );
-		transform_recalculate_dirty_matrices( it.transform );
-		renderer_shader_program_set_uniform( gbuffer_shader, "model", RendererDataType_Matrix4x4_f32, &it.transform->model_matrix );
-		renderer_shader_program_set_uniform( gbuffer_shader, "normal_matrix", RendererDataType_Matrix3x3_f32, &it.transform->normal_matrix );
-
-		glBindVertexArray( mesh->opengl_vao );
-		GLenum index_type = index_type_size_to_opengl( mesh->indices.item_size );
-		glDrawElements(
-			/*    mode */ GL_TRIANGLES,
-			/*   count */ mesh->indices.size,
-			/*    type */ index_type,
-			/* indices */ NULL
-		);
+void
+replay_command_stream( Renderer_Command_Stream *stream ) {
+	ForIt( stream->commands.data, stream->commands.size ) {
+		void *payload = renderer_command_payload( it );
+		switch ( it->type ) {
+			case RendererCommandType_BindProgram: {
+				Renderer_Command_Bind_Program *command = ( Renderer_Command_Bind_Program * )payload;
+				renderer_bind_shader_program( command->program );
+			} break;
+
+			case RendererCommandType_SetUniform: {
+				Renderer_Command_Set_Uniform *command = ( Renderer_Command_Set_Uniform * )payload;
+				renderer_shader_program_set_uniform( command->program, command->uniform_id, command + 1 );
+			} break;
+
+			case RendererCommandType_BindTexture: {
+				Renderer_Command_Bind_Texture *command = ( Renderer_Command_Bind_Texture * )payload;
+				renderer_bind_texture( command->texture_slot_idx, command->texture_id );
+			} break;
+
+			case RendererCommandType_Draw: {
+				replay_command_draw( ( Renderer_Command_Draw * )payload );
+			} break;
+
+			default:
+				Assert( false );
+				break;
+		}
 	}}
 }
 
-// TODO: Remove
-#include "opengl.h"
-extern Screen screen;
-
+template < typename T >
 static void
-draw_pass_geometry() {
-	glEnable( GL_DEPTH_TEST );
-
-	renderer_bind_framebuffer( g_renderer.gbuffer.framebuffer );
-	Renderer_Framebuffer *geometry_framebuffer = renderer_framebuffer_instance( g_renderer.gbuffer.framebuffer );
-	Vector2_u16 dimensions = g_renderer.gbuffer.dimensions;
-	glViewport( 0, 0, ( GLsizei )dimensions.width, ( GLsizei )dimensions.height );
-
-	// Clear Geometry framebuffer Position attachment texture
-	glClearNamedFramebufferfv(
-		/* framebuffer */ geometry_framebuffer->opengl_framebuffer,
-		/*      buffer */ GL_COLOR,
-		/*  drawbuffer */ 0,  // Attachment  index
-		/*       value */ &g_renderer.clear_color.x
-	);
-
-	// Clear Geometry framebuffer Normal Map attachment texture
-	glClearNamedFramebufferfv(
-		/* framebuffer */ geometry_framebuffer->opengl_framebuffer,
-		/*      buffer */ GL_COLOR,
-		/*  drawbuffer */ 1,  // Attachment  index
-		/*       value */ &g_renderer.clear_color.x
-	);
-
-	// Clear Geometry framebuffer Color/Specular attachment texture
-	glClearNamedFramebufferfv(
-		/* framebuffer */ geometry_framebuffer->opengl_framebuffer,
-		/*      buffer */ GL_COLOR,
-		/*  drawbuffer */ 2,  // Attachment  index
-		/*       value */ &g_renderer.clear_color.x
-	);
+imvector_point_to( ImVector< T > *vector, T *data, int size ) {
+	vector->Size = size;
+	vector->Capacity = size;
+	vector->Data = data;
+}
+
+// ImGui's draw lists belong to its context and are rebuilt by the next `ImGui::NewFrame()`, so the render thread draws a copy.
+// The copied lists are never destructed: their vectors point into the packet's arena.
+static ImDrawData *
+frame_packet_copy_ui_draw_data( Renderer_Frame_Packet *packet, ImDrawData *draw_data ) {
+	u32 lists_count = ( u32 )draw_data->CmdListsCount;
+	ImDrawData *copy = frame_packet_copy( packet, draw_data, 1 );
+	ImDrawList **lists = ( ImDrawList ** )frame_packet_allocate( packet, QL_max2( lists_count, 1u ) * sizeof( ImDrawList * ) );
+	if ( !copy || !lists )
+		return NULL;
 
-	// Clear Geometry framebuffer's deapth-stencil attachment renderbuffer
-	glClearNamedFramebufferfi(
-		/* framebuffer */ geometry_framebuffer->opengl_framebuffer,
-		/*      buffer */ GL_DEPTH_STENCIL,
-		/*  drawbuffer */ 0,  // Must be 0 in this case.
-		/*       depth */ 1.0f,  // In the range of [0, 1]: 0.0 - near plane; 1.0 - far plane. So, default is the farthest one.
-		/*     stencil */ 0  // Neutral value
-	);
+	copy->CmdLists = lists;
+	ForIt( draw_data->CmdLists, lists_count ) {
+		void *list_memory = frame_packet_allocate( packet, sizeof( ImDrawList ), alignof( ImDrawList ) );
+		ImDrawCmd *commands = frame_packet_copy( packet, it->CmdBuffer.Data, ( u32 )it->CmdBuffer.Size );
+		ImDrawIdx *indices = frame_packet_copy( packet, it->IdxBuffer.Data, ( u32 )it->IdxBuffer.Size );
+		ImDrawVert *vertices = frame_packet_copy( packet, it->VtxBuffer.Data, ( u32 )it->VtxBuffer.Size );
+		if ( !list_memory || !commands || !indices || !vertices ) {
+			log_warning( "Frame packet is full, the UI is not drawn this frame." );
+			return NULL;
+		}
 
-	u32 command_idx = 0;
-	ForIt( g_renderer.render_queue_material_sequence.data, g_renderer.render_queue_material_sequence.size ) {
-		Renderer_Render_Command *command_ptr = &g_renderer.render_queue.data[ command_idx ];
-		ArrayView< Renderer_Render_Command > commands = { .size = it, .data = command_ptr };
-		geometry_pass_draw_same_material_commands( commands );
-		command_idx += it;
+		ImDrawList *list = new ( list_memory ) ImDrawList( NULL );
+		list->Flags = it->Flags;
+		imvector_point_to( &list->CmdBuffer, commands, it->CmdBuffer.Size );
+		imvector_point_to( &list->IdxBuffer, indices, it->IdxBuffer.Size );
+		imvector_point_to( &list->VtxBuffer, vertices, it->VtxBuffer.Size );
+		lists[ it_index ] = list;
 	}}
-
-	Assert( command_idx == g_renderer.render_queue.size );
+	return copy;
 }
 
-static void
-lighting_pass_use_material( Material *material ) {
-	renderer_shader_program_set_uniform(
-		material->shader_program,
-		"view_position",
-		RendererDataType_Vector3_f32,
-		g_renderer.camera_position
-	);
+static u64
+render_proxy_sort_key( Renderer_Render_Pass pass, Mesh_ID mesh_id, Material_ID material_id ) {
+	u64 program_idx = 0;
+	Material *material = material_instance( material_id );
+	if ( material && material->shader_program )
+		program_idx = ( u64 )( material->shader_program - g_renderer.programs.data );
 
-	renderer_shader_program_set_uniform(
-		material->shader_program,
-		"ambient",
-		RendererDataType_Vector3_f32,
-		&g_renderer.ambient_light
-	);
+	return ( ( ( u64 )pass & 0xF ) << RENDERER_SORT_KEY_PASS_SHIFT )
+	     | ( ( program_idx & 0xFF ) << RENDERER_SORT_KEY_PROGRAM_SHIFT )
+	     | ( ( u64 )material_id << RENDERER_SORT_KEY_MATERIAL_SHIFT )
+	     | ( ( u64 )mesh_id << RENDERER_SORT_KEY_MESH_SHIFT );
+}
 
-	renderer_shader_program_set_uniform(
-		material->shader_program,
-		"shininess_exponent",
-		RendererDataType_f32,
-		&material->shininess_exponent
-	);
+static bool
+mesh_geometry_lookup( Mesh_ID mesh_id, Renderer_Mesh_Geometry *out_geometry ) {
+	Mesh *mesh = mesh_instance( mesh_id );
+	if ( !mesh || !mesh_is_uploaded( mesh ) )
+		return false;
 
-	// Uniform_Buffer_Lights gets updated in `maps_lights_manager_update()`
-	//   every time light entity added/removed.
+	*out_geometry = Renderer_Mesh_Geometry {
+		.geometry_pool_id = mesh->geometry_pool_id,
+		.base_vertex = mesh->base_vertex,
+		.first_index = mesh->first_index,
+		.index_count = mesh->indices.size
+	};
+	return true;
 }
 
-static void lighting_pass_use_gbuffer_textures( Renderer_Shader_Program *material_shader ) {
-
-	/* G-Buffer Position texture */
+void
+build_render_batches( Renderer_Frame_Packet *packet ) {
+	ArrayView< Renderer_Render_Command > commands = packet->render_queue;
+	g_renderer.draw_stats.draw_commands = commands.size;
+	g_renderer.draw_stats.draw_calls = 0;
+	g_renderer.indirect_commands = Array< Renderer_Draw_Elements_Indirect_Command > { 0 };
+	g_renderer.indirect_draws = Array< Renderer_Indirect_Draw > { 0 };
+	// There are never more batches than commands, nor indirect commands or draws than batches,
+	//   so none of these arrays grow.
+	g_renderer.render_batches = frame_arena_array< Renderer_Instance_Batch >( packet->frame_arena, commands.size );
+	if ( commands.size < 1 )
+		return;
+	if ( g_renderer.render_batches.capacity < commands.size ) {
+		log_warning( "Frame arena is full, %u render commands are not drawn.", commands.size );
+		return;
+	}
 
-	s32 texture_position_index = 0; // make configurable
-	renderer_shader_program_set_uniform(
-		material_shader,
-		"gbuffer_position",
-		RendererDataType_s32,
-		&texture_position_index
-	);
-	Texture_ID gbuffer_texture_position = g_renderer.gbuffer.texture_position;
-	Texture_ID texture_position_id = ( gbuffer_texture_position != INVALID_TEXTURE_ID ) ? gbuffer_texture_position : g_renderer.texture_black;
-	renderer_bind_texture( texture_position_index, texture_position_id );
+	renderer_batches_build( commands, &g_renderer.render_batches );
 
-	/* G-Buffer Normal texture */
+	ArrayView< Renderer_Instance_Batch > batches = array_view( &g_renderer.render_batches );
+	g_renderer.indirect_commands = frame_arena_array< Renderer_Draw_Elements_Indirect_Command >( packet->frame_arena, batches.size );
+	g_renderer.indirect_draws = frame_arena_array< Renderer_Indirect_Draw >( packet->frame_arena, batches.size );
+	if ( g_renderer.indirect_commands.capacity < batches.size || g_renderer.indirect_draws.capacity < batches.size ) {
+		log_warning( "Frame arena is full, %u render commands are not drawn.", commands.size );
+		g_renderer.indirect_draws.size = 0;
+		return;
+	}
+	renderer_indirect_draws_build( batches, mesh_geometry_lookup, &g_renderer.indirect_commands, &g_renderer.indirect_draws );
+}
+
+// Where a texture is in the texture array pools, as `Renderer_Material_Parameters` stores it.
+// Textures that are not in any pool are replaced by `fallback_id`, which always is.
+static u32
+texture_array_reference( Texture_ID texture_id, Texture_ID fallback_id ) {
+	// `texture_instance()` does not check the ID.
+	Texture *texture = ( texture_id != INVALID_TEXTURE_ID ) ? texture_instance( texture_id ) : NULL;
+	if ( !texture || texture->texture_array_pool_id == INVALID_TEXTURE_ARRAY_POOL_ID )
+		texture = ( fallback_id != INVALID_TEXTURE_ID ) ? texture_instance( fallback_id ) : NULL;
+	if ( !texture || texture->texture_array_pool_id == INVALID_TEXTURE_ARRAY_POOL_ID )
+		return 0;
 
-	s32 texture_normal_index = 1; // make configurable
-	renderer_shader_program_set_uniform(
-		material_shader,
-		"gbuffer_normal",
-		RendererDataType_s32,
-		&texture_normal_index
-	);
-	Texture_ID gbuffer_texture_normal = g_renderer.gbuffer.texture_normal;
-	Texture_ID texture_normal_id = ( gbuffer_texture_normal != INVALID_TEXTURE_ID ) ? gbuffer_texture_normal : g_renderer.texture_black;
-	renderer_bind_texture( texture_normal_index, texture_normal_id );
-
-	/* G-Buffer Diffuse/Specular texture */
-
-	s32 texture_diffuse_specular_index = 2; // make configurable
-	renderer_shader_program_set_uniform(
-		material_shader,
-		"gbuffer_diffuse_specular",
-		RendererDataType_s32,
-		&texture_diffuse_specular_index
-	);
-	Texture_ID gbuffer_texture_diffuse_specular = g_renderer.gbuffer.texture_color_specular;
-	Texture_ID texture_diffuse_specular_id = ( gbuffer_texture_diffuse_specular != INVALID_TEXTURE_ID ) ? gbuffer_texture_diffuse_specular : g_renderer.texture_black;
-	renderer_bind_texture( texture_diffuse_specular_index, texture_diffuse_specular_id );
+	return ( ( u32 )texture->texture_array_pool_id << 16 ) | texture->texture_array_layer;
 }
 
+// Commits proxy changes and copies what the render thread needs of them:
+//   the visible proxies in the sorted order, and the instance data that changed.
 static void
-lighting_pass_draw_same_material_commands( ArrayView< Renderer_Render_Command > commands ) {
-	Material_ID material_id = commands.data[ 0 ].material_id;
-	Material *material = material_instance( material_id );
-	Renderer_Shader_Program *material_shader = material->shader_program;
-	renderer_bind_shader_program( material->shader_program );
-	lighting_pass_use_gbuffer_textures( material->shader_program );
-	lighting_pass_use_material( material );
-
-	draw_fullscreen_quad();
-}
+frame_packet_write_proxies( Renderer_Frame_Packet *packet ) {
+	Renderer_Proxy_Table *table = &g_renderer.proxies;
+	renderer_proxy_table_commit( table );
 
-static void
-draw_pass_lighting() {
-	glDisable( GL_DEPTH_TEST );
-
-	// Fullscreen Quad is in clockwise winding order, it will not be culled.
-	// glDisable( GL_CULL_FACE );
-
-	renderer_bind_framebuffer( 0 ); // Default framebuffer
-	Renderer_Framebuffer *default_framebuffer = renderer_framebuffer_instance( 0 );
-	Vector2_u16 dimensions = { ( u16 )screen.width, ( u16 )screen.height };
-	glViewport( 0, 0, ( GLsizei )dimensions.width, ( GLsizei )dimensions.height );
-
-	// Clear Backbuffer framebuffer color attachment texture
-	glClearNamedFramebufferfv(
-		/* framebuffer */ default_framebuffer->opengl_framebuffer,
-		/*      buffer */ GL_COLOR,
-		/*  drawbuffer */ 0,  // Attachment  index
-		/*       value */ &g_renderer.clear_color.x
-	);
+	// Every visible proxy adds one command at most, so the queue never grows.
+	Array< Renderer_Render_Command > *queue = &g_renderer.render_queue;
+	u32 visible_count = g_renderer.visible_proxies.size;
+	*queue = frame_arena_array< Renderer_Render_Command >( frame_arena(), visible_count );
+	if ( queue->capacity < visible_count )
+		log_warning( "Frame arena is full, %u visible proxies dropped.", visible_count );
+	else
+		renderer_proxy_table_build_queue( table, array_view( &g_renderer.visible_proxies ), queue );
+	packet->render_queue = ArrayView< Renderer_Render_Command > { queue->size, queue->data };
+
+	u32 instances_count = table->instances.size;
+	if ( instances_count > g_renderer.proxy_instance_capacity ) {
+		// The render thread re-creates the buffer, so everything has to be uploaded again.
+		g_renderer.proxy_instance_capacity = QL_max2( QL_max2( g_renderer.proxy_instance_capacity * 2, instances_count ), RENDERER_INITIAL_PROXIES_CAPACITY );
+		table->dirty_begin = 0;
+		table->dirty_end = instances_count;
+	}
+	packet->instance_capacity = QL_max2( g_renderer.proxy_instance_capacity, RENDERER_INITIAL_PROXIES_CAPACITY );
 
-	u32 command_idx = 0;
-	ForIt( g_renderer.render_queue_material_sequence.data, g_renderer.render_queue_material_sequence.size ) {
-		Renderer_Render_Command *command_ptr = &g_renderer.render_queue.data[ command_idx ];
-		ArrayView< Renderer_Render_Command > commands = { .size = it, .data = command_ptr };
-		lighting_pass_draw_same_material_commands( commands );
-		command_idx += it;
-	}}
+	packet->dirty_first_instance = table->dirty_begin;
+	if ( table->dirty_begin >= table->dirty_end )
+		return;
 
-	Assert( command_idx == g_renderer.render_queue.size );
+	// Whatever does not fit stays dirty for the next packet.
+	u64 free_bytes = ( u64 )( packet->arena.memory_end - packet->arena.cursor );
+	u64 fitting_count = ( free_bytes > RENDERER_FRAME_PACKET_ALIGNMENT ) ? ( free_bytes - RENDERER_FRAME_PACKET_ALIGNMENT ) / sizeof( Renderer_Instance_Data ) : 0;
+	u32 dirty_count = QL_min2( table->dirty_end - table->dirty_begin, ( u32 )QL_min2( fitting_count, ( u64 )U32_MAX ) );
+	Renderer_Instance_Data *dirty_copy = frame_packet_copy( packet, &table->instances.data[ table->dirty_begin ], dirty_count );
+	if ( !dirty_copy || dirty_count == 0 )
+		return;
 
+	packet->dirty_instances = array_view( dirty_copy, dirty_count );
+	table->dirty_begin += dirty_count;
+	if ( table->dirty_begin >= table->dirty_end )
+		renderer_proxy_table_clear_dirty( table );
 }
 
 static void
-post_processing_pass_draw() {
+frame_packet_write_materials( Renderer_Frame_Packet *packet ) {
+	ArrayView< Material > materials = materials_get_storage_view();
+	// Never empty, so there is always something to bind.
+	u32 parameters_count = QL_max2( materials.size, 1u );
+	Renderer_Material_Parameters *parameters = ( Renderer_Material_Parameters * )frame_packet_allocate( packet, parameters_count * sizeof( Renderer_Material_Parameters ) );
+	if ( !parameters )
+		return;
 
-}
+	parameters[ 0 ] = Renderer_Material_Parameters { 0 };  // In case there are no materials.
+	ForIt( materials.data, materials.size ) {
+		parameters[ it_index ] = Renderer_Material_Parameters {
+			.diffuse = texture_array_reference( it.diffuse, g_renderer.texture_purple_checkers ),
+			.normal_map = texture_array_reference( it.normal_map, g_renderer.texture_white ),
+			.specular_map = texture_array_reference( it.specular_map, g_renderer.texture_white ),
+			.shininess_exponent = it.shininess_exponent
+		};
+	}}
+	packet->materials = array_view( parameters, parameters_count );
+	if ( g_renderer.backend != RendererBackend_Software )
+		return;
 
-static void
-ui_pass_draw() {
+	// Texture IDs rather than texture array references, the software rasterizer samples the textures' own bytes.
+	Renderer_Software_Material *software_materials = ( Renderer_Software_Material * )frame_packet_allocate( packet, materials.size * sizeof( Renderer_Software_Material ) );
+	if ( !software_materials )
+		return;
 
+	ForIt( materials.data, materials.size ) {
+		software_materials[ it_index ] = Renderer_Software_Material {
+			.diffuse = it.diffuse,
+			.normal_map = it.normal_map,
+			.specular_map = it.specular_map,
+			.shininess_exponent = it.shininess_exponent
+		};
+	}}
+	packet->software_materials = array_view( software_materials, materials.size );
 }
 
+// Copies everything else the render thread reads, the rest of the packet is written during the frame.
 static void
-sort_render_queue() {
-	Array< Renderer_Render_Command > *queue = &g_renderer.render_queue;
-	Renderer_Render_Command *cmd_a = NULL;
-	Renderer_Render_Command *cmd_b;
-	Renderer_Render_Command temp;
-	u16 material_sequence = 1;
-	array_clear( &g_renderer.render_queue_material_sequence );
-	for ( u32 a = 0; a < queue->size; a += 1 ) {
-		cmd_a = &queue->data[ a ];
-		cmd_b = NULL;
-		for ( u32 b = a + 1; b < queue->size; b += 1 ) {
-			cmd_b = &queue->data[ b ];
-			if ( cmd_b->material_id < cmd_a->material_id ) {
-				temp = *cmd_a;
-				*cmd_a = *cmd_b;
-				*cmd_b = temp;
-			}
-		}
-
-		if ( cmd_b ) {
-			if ( cmd_a->material_id == cmd_b->material_id ) {
-				material_sequence += 1;
-			} else {
-				array_add( &g_renderer.render_queue_material_sequence, material_sequence );
-				material_sequence = 1;
-			}
-		} else {
-			array_add( &g_renderer.render_queue_material_sequence, material_sequence );
-		}
+frame_packet_finish( Renderer_Frame_Packet *packet ) {
+	packet->frame_idx = g_renderer.frame_idx;
+	packet->settings = g_renderer.settings;
+	g_renderer.settings.gl_error_check_requested = false;
+	if ( g_renderer.settings.capture_frames_count > 0 ) {
+		u32 path_size = ( u32 )strlen( g_renderer.capture_file_path ) + 1;
+		packet->capture_file_path = frame_packet_copy( packet, g_renderer.capture_file_path, path_size );
+		g_renderer.settings.capture_frames_count = 0;
 	}
+
+	Matrix4x4_f32 identity( 1.0f );
+	packet->view = ( g_renderer.view_matrix ) ? *g_renderer.view_matrix : identity;
+	packet->projection = ( g_renderer.projection_matrix ) ? *g_renderer.projection_matrix : identity;
+	packet->camera_position = ( g_renderer.camera_position ) ? *g_renderer.camera_position : Vector3_f32 { 0, 0, 0 };
+	packet->ambient_light = g_renderer.ambient_light;
+	packet->viewport_dimensions = Vector2_u16 { ( u16 )screen.width, ( u16 )screen.height };
+	packet->time = g_renderer.frame_time.current;
+	packet->time_delta = g_renderer.frame_time.delta;
+	packet->frame_arena = frame_arena();
+	// Proxy changes are committed below, which may grow the proxy table.
+	Renderer_Proxy_Table *proxies = &g_renderer.proxies;
+	packet->steady_state = ( g_renderer.frame_idx >= RENDERER_STEADY_STATE_FIRST_FRAME ) &&
+		( proxies->pending.size == 0 && proxies->stale_count == 0 ) &&
+		( packet->capture_file_path == NULL ) &&
+		// The software rasterizer's buffers grow with what is on screen.
+		( g_renderer.backend != RendererBackend_Software );
+
+	frame_packet_write_materials( packet );
+	frame_packet_write_proxies( packet );
+
+	Renderer_Command_Stream **streams = frame_packet_copy( packet, g_renderer.submitted_streams.data, g_renderer.submitted_streams.size );
+	if ( streams )
+		packet->command_streams = array_view( streams, g_renderer.submitted_streams.size );
+
+	array_clear( &g_renderer.visible_proxies );
+	array_clear( &g_renderer.submitted_streams );
 }
 
 void
-renderer_draw_frame() {
-	sort_render_queue();
-	draw_pass_geometry();
-	draw_pass_lighting();
-	// renderer_draw_post_processsing_pass();
-	// renderer_draw_ui_pass();
+renderer_frame_packet_execute( Renderer_Frame_Packet *packet ) {
+	g_renderer.dispatch.frame_packet_execute( packet );
+}
 
-	g_renderer.frame_time.current = ( f32 )glfwGetTime();
+void
+renderer_draw_frame() {
+	g_renderer.frame_time.current = g_renderer.dispatch.current_time();
 	g_renderer.frame_time.delta = ( g_renderer.frame_time.current - g_renderer.frame_time.last ) * 1000.0f; // sec -> ms
 	g_renderer.frame_time.last = g_renderer.frame_time.current;
 
-	Renderer_Framebuffer_Attachment_Point attachment_point = RendererFramebufferAttachmentPoint_None;
-	switch ( g_renderer.output_channel ) {
-		case RendererOutputChannel_Position:
-			attachment_point = RendererFramebufferAttachmentPoint_Color0;
-			break;
-		case RendererOutputChannel_Normal:
-			attachment_point = RendererFramebufferAttachmentPoint_Color1;
-			break;
-		case RendererOutputChannel_DiffuseSpecular:
-			attachment_point = RendererFramebufferAttachmentPoint_Color2;
-			break;
-
-		case RendererOutputChannel_FinalColor:
-		default:
-			break;
-	}
+	Renderer_Frame_Packet *packet = &g_renderer.packets[ g_renderer.packet_idx ];
+	frame_packet_finish( packet );
+
+	// The render thread is idle from here on until the packet is submitted, so its stats can be read.
+	bool threaded = renderer_thread_running();
+	if ( threaded )
+		renderer_thread_wait_idle();
+	else
+		renderer_frame_packet_execute( packet );
+	g_renderer.reported_stats = G_Renderer::Reported_Stats {
+		.draw = g_renderer.draw_stats,
+		.state_changes = g_renderer.gl_state.frame
+	};
+	if ( threaded )
+		renderer_thread_submit( packet );
 
-	if ( attachment_point != RendererFramebufferAttachmentPoint_None ) {
-		Renderer_Framebuffer *geometry_framebuffer = renderer_framebuffer_instance( g_renderer.gbuffer.framebuffer );
-		GLenum opengl_attachment = renderer_framebuffer_attachment_point_to_opengl( attachment_point );
-		glNamedFramebufferReadBuffer( geometry_framebuffer->opengl_framebuffer, opengl_attachment );
-		glBlitNamedFramebuffer(
-			/*           source */ geometry_framebuffer->opengl_framebuffer,
-			/*      destination */ 0,
-			/*      source rect */ 0, 0, g_renderer.gbuffer.dimensions.width, g_renderer.gbuffer.dimensions.height,
-			/* destination rect */ 0, 0, screen.width, screen.height,
-			/*             mask */ GL_COLOR_BUFFER_BIT,
-			/*           filter */ GL_LINEAR
-		);
-	}
+	// The whole frame is checked against `sys_allocator` calls by its caller, see `renderer_frame_steady_state()`.
+	g_renderer.steady_state_packets = ( packet->steady_state ) ? QL_min2( g_renderer.steady_state_packets + 1, ( u32 )( ARRAY_SIZE( g_renderer.packets ) ) ) : 0;
+
+	// The other packet was drawn before this one was submitted, so its arenas are free.
+	g_renderer.frame_idx += 1;
+	g_renderer.packet_idx = ( g_renderer.packet_idx + 1 ) % ARRAY_SIZE( g_renderer.packets );
+	frame_packet_begin( &g_renderer.packets[ g_renderer.packet_idx ] );
+	frame_arena()->reset( false );
+}
 
-	array_clear( &g_renderer.render_queue );
+void
+renderer_set_ui_draw_data( ImDrawData *draw_data ) {
+	Renderer_Frame_Packet *packet = &g_renderer.packets[ g_renderer.packet_idx ];
+	packet->ui_draw_data = ( draw_data && draw_data->Valid ) ? frame_packet_copy_ui_draw_data( packet, draw_data ) : NULL;
+}
+
+void *
+renderer_frame_storage_buffer( u32 binding, u32 size ) {
+	Renderer_Frame_Packet *packet = &g_renderer.packets[ g_renderer.packet_idx ];
+	if ( packet->storage_buffers_count >= RENDERER_FRAME_PACKET_MAX_STORAGE_BUFFERS )
+		return NULL;
+
+	void *data = frame_packet_allocate( packet, size );
+	if ( !data )
+		return NULL;
+
+	packet->storage_buffers[ packet->storage_buffers_count ] = Renderer_Frame_Storage_Buffer {
+		.data = data,
+		.size = size,
+		.binding = binding
+	};
+	packet->storage_buffers_count += 1;
+	return data;
 }
 
 bool
@@ -1942,7 +1664,7 @@ renderer_bind_framebuffer( Renderer_Framebuffer_ID framebuffer_id ) {
 	}
 
 	Renderer_Framebuffer *framebuffer = renderer_framebuffer_instance( framebuffer_id );
-	glBindFramebuffer( GL_FRAMEBUFFER, framebuffer->opengl_framebuffer );
+	opengl_state_bind_framebuffer( &g_renderer.gl_state, framebuffer->opengl_framebuffer );
 
 	return true;
 }
@@ -1954,7 +1676,7 @@ renderer_bind_shader_program( Renderer_Shader_Program *program ) {
 		return false;
 
 	Assert( program->opengl_program != 0 );
-	glUseProgram( program->opengl_program );
+	opengl_state_use_program( &g_renderer.gl_state, program->opengl_program );
 	return true;
 }
 
@@ -1972,19 +1694,276 @@ renderer_bind_texture( u32 texture_slot_idx, Texture_ID texture_id ) {
 	if ( texture->opengl_id == 0 )
 		return false;
 
-	glActiveTexture( GL_TEXTURE0 + texture_slot_idx );
-	glBindTexture( GL_TEXTURE_2D, texture->opengl_id );
-	// glActiveTexture( GL_TEXTURE0 );
+	opengl_state_bind_texture_unit( &g_renderer.gl_state, texture_slot_idx, texture->opengl_id );
 	return true;
 }
 
+Renderer_Proxy_ID
+renderer_proxy_create( Mesh_ID mesh_id, Material_ID material_id ) {
+	Renderer_Render_Pass pass = RendererRenderPass_Opaque;
+	u64 sort_key = render_proxy_sort_key( pass, mesh_id, material_id );
+	return renderer_proxy_table_add( &g_renderer.proxies, sort_key, mesh_id, material_id, pass );
+}
+
 void
-renderer_queue_draw_command( Mesh_ID mesh_id, Material_ID material_id, Transform *transform ) {
-	array_add( &g_renderer.render_queue, Renderer_Render_Command {
-		.mesh_id = mesh_id,
-		.material_id = material_id,
-		.transform = transform
-	} );
+renderer_proxy_destroy( Renderer_Proxy_ID proxy_id ) {
+	if ( proxy_id == INVALID_RENDERER_PROXY_ID )
+		return;
+
+	renderer_proxy_table_remove( &g_renderer.proxies, proxy_id );
+}
+
+void
+renderer_proxy_set_mesh( Renderer_Proxy_ID proxy_id, Mesh_ID mesh_id, Material_ID material_id ) {
+	Renderer_Proxy *proxy = renderer_proxy_table_find( &g_renderer.proxies, proxy_id );
+	if ( !proxy )
+		return;
+
+	u64 sort_key = render_proxy_sort_key( proxy->pass, mesh_id, material_id );
+	renderer_proxy_table_set_key( &g_renderer.proxies, proxy_id, sort_key, mesh_id, material_id );
+}
+
+void
+renderer_proxy_set_transform( Renderer_Proxy_ID proxy_id, Transform *transform ) {
+	if ( proxy_id == INVALID_RENDERER_PROXY_ID )
+		return;
+
+	renderer_proxy_table_set_transform( &g_renderer.proxies, proxy_id, transform );
+}
+
+void
+renderer_queue_draw_proxy( Renderer_Proxy_ID proxy_id ) {
+	if ( proxy_id == INVALID_RENDERER_PROXY_ID )
+		return;
+
+	array_add( &g_renderer.visible_proxies, proxy_id );
+}
+
+Material_ID
+renderer_proxy_material( Renderer_Proxy_ID proxy_id ) {
+	Renderer_Proxy *proxy = renderer_proxy_table_find( &g_renderer.proxies, proxy_id );
+	return ( proxy ) ? proxy->material_id : INVALID_MATERIAL_ID;
+}
+
+void
+renderer_submit_command_stream( Renderer_Command_Stream *stream ) {
+	Assert( stream );
+	array_add( &g_renderer.submitted_streams, stream );
+}
+
+// --- Replay test
+
+constexpr u32 REPLAY_TEST_PROGRAMS_COUNT = 4;
+constexpr u32 REPLAY_TEST_BUFFERS_COUNT = 4;
+constexpr u32 REPLAY_TEST_MAX_MESHES = 16;
+constexpr u64 REPLAY_TEST_PACKET_MAX_SIZE = 256;
+
+// A call that reached the mock dispatch.
+struct Replay_Test_Call {
+	u32 function;  // Index of the function in `OpenGL_State_Dispatch`.
+	u32 arguments[ 2 ];
+};
+
+// The mock dispatch has no context pointer, so it logs into this.
+static Array< Replay_Test_Call > *g_replay_test_calls;
+
+static void GLAPIENTRY replay_test_use_program( GLuint program ) { array_add( g_replay_test_calls, Replay_Test_Call { 0, { program, 0 } } ); }
+static void GLAPIENTRY replay_test_bind_vertex_array( GLuint vertex_array ) { array_add( g_replay_test_calls, Replay_Test_Call { 1, { vertex_array, 0 } } ); }
+static void GLAPIENTRY replay_test_bind_texture_unit( GLuint unit, GLuint texture ) { array_add( g_replay_test_calls, Replay_Test_Call { 2, { unit, texture } } ); }
+static void GLAPIENTRY replay_test_bind_framebuffer( GLenum target, GLuint framebuffer ) { array_add( g_replay_test_calls, Replay_Test_Call { 3, { target, framebuffer } } ); }
+static void GLAPIENTRY replay_test_viewport( GLint, GLint, GLsizei, GLsizei ) { array_add( g_replay_test_calls, Replay_Test_Call { 4, { 0, 0 } } ); }
+static void GLAPIENTRY replay_test_enable( GLenum capability ) { array_add( g_replay_test_calls, Replay_Test_Call { 5, { capability, 0 } } ); }
+static void GLAPIENTRY replay_test_disable( GLenum capability ) { array_add( g_replay_test_calls, Replay_Test_Call { 6, { capability, 0 } } ); }
+
+struct Replay_Test_Packet {
+	u32 program_idx;
+	Texture_ID texture_id;
+	Mesh_ID mesh_id;
+	Matrix4x4_f32 model;
+	Vector4_f32 color;
+};
+
+// Every packet depends only on its index and the meshes and textures available.
+static Replay_Test_Packet
+replay_test_packet( u32 packet_idx, ArrayView< Mesh_ID > meshes, Texture_ID *textures, u64 *sort_key ) {
+	u32 random_state = packet_idx * 2654435761u + 1;
+	u32 program_idx = QL_random_u32( &random_state ) % REPLAY_TEST_PROGRAMS_COUNT;
+	u32 texture_idx = QL_random_u32( &random_state ) % 2;
+	u32 mesh_idx = QL_random_u32( &random_state ) % QL_max2( meshes.size, 1u );
+	Replay_Test_Packet packet = {
+		.program_idx = program_idx,
+		.texture_id = textures[ texture_idx ],
+		.mesh_id = ( meshes.size > 0 ) ? meshes.data[ mesh_idx ] : INVALID_MESH_ID,
+		.model = Matrix4x4_f32( ( f32 )( packet_idx % 7 ) ),
+		.color = { ( f32 )( packet_idx & 0xFF ) / 255.0f, 0.5f, 0.25f, 1.0f }
+	};
+
+	// Program, texture and mesh first, the packet index keeps keys unique.
+	*sort_key = ( ( u64 )program_idx << 56 ) | ( ( u64 )texture_idx << 48 ) | ( ( u64 )mesh_idx << 32 ) | packet_idx;
+	return packet;
+}
+
+// Uniform values of all programs one after another, as the last set left them.
+static void
+replay_test_snapshot_uniforms( Renderer_Shader_Program *programs, Array< u8 > *snapshot ) {
+	array_clear( snapshot );
+	ForIt( programs, REPLAY_TEST_PROGRAMS_COUNT ) {
+		Array< Renderer_Uniform > *uniforms = &it.uniforms;
+		For2( uniforms->size ) {
+			Renderer_Uniform *uniform = &uniforms->data[ it2_index ];
+			array_add( snapshot, uniform->bits );
+			For3( RENDERER_UNIFORM_SHADOW_VALUE_SIZE ) {
+				array_add( snapshot, uniform->shadow_value[ it3_index ] );
+			}
+			uniform->bits = RendererUniformBit_None;
+			memset( uniform->shadow_value, 0, RENDERER_UNIFORM_SHADOW_VALUE_SIZE );
+		}
+	}}
+}
+
+Renderer_Commands_Replay_Test
+renderer_commands_replay_test( u32 packets_count ) {
+	Renderer_Commands_Replay_Test result = { .packets_count = packets_count };
+	if ( g_renderer.backend == RendererBackend_OpenGL ) {
+		log_warning( "The command replay test runs on headless backends only, the render thread owns the OpenGL state." );
+		return result;
+	}
+
+	// Programs are never linked, their names only have to differ.
+	Renderer_Shader_Program programs[ REPLAY_TEST_PROGRAMS_COUNT ] = {};
+	For( REPLAY_TEST_PROGRAMS_COUNT ) {
+		programs[ it_index ].opengl_program = 1000 + it_index;
+		programs[ it_index ].uniforms = array_new< Renderer_Uniform >( sys_allocator, 2 );
+		array_add( &programs[ it_index ].uniforms, Renderer_Uniform { .name = "model", .data_type = RendererDataType_Matrix4x4_f32, .elements = 1 } );
+		array_add( &programs[ it_index ].uniforms, Renderer_Uniform { .name = "color", .data_type = RendererDataType_Vector4_f32, .elements = 1 } );
+	}
+	Texture_ID textures[ 2 ] = { g_renderer.texture_white, g_renderer.texture_purple_checkers };
+	Mesh_ID meshes_data[ REPLAY_TEST_MAX_MESHES ];
+	u32 meshes_count = 0;
+	For( REPLAY_TEST_MAX_MESHES ) {
+		Mesh *mesh = mesh_instance( ( Mesh_ID )it_index );
+		if ( mesh && mesh_is_uploaded( mesh ) )
+			meshes_data[ meshes_count++ ] = ( Mesh_ID )it_index;
+	}
+	ArrayView< Mesh_ID > meshes = array_view( meshes_data, meshes_count );
+
+	// Recorded into several buffers, as jobs would, and merged.
+	Renderer_Command_Buffer buffers[ REPLAY_TEST_BUFFERS_COUNT ];
+	Renderer_Command_Buffer *buffer_pointers[ REPLAY_TEST_BUFFERS_COUNT ];
+	For( REPLAY_TEST_BUFFERS_COUNT ) {
+		renderer_command_buffer_init( &buffers[ it_index ], ( ( u64 )packets_count / REPLAY_TEST_BUFFERS_COUNT + 1 ) * REPLAY_TEST_PACKET_MAX_SIZE );
+		buffer_pointers[ it_index ] = &buffers[ it_index ];
+	}
+	Array< Radix_Sort_Item > sort_items = array_new< Radix_Sort_Item >( sys_allocator, packets_count );
+	Array< Radix_Sort_Item > sort_items_swap = array_new< Radix_Sort_Item >( sys_allocator, packets_count );
+	For( packets_count ) {
+		u64 sort_key;
+		Replay_Test_Packet packet = replay_test_packet( it_index, meshes, textures, &sort_key );
+		Renderer_Shader_Program *program = &programs[ packet.program_idx ];
+		Renderer_Command_Buffer *buffer = &buffers[ it_index % REPLAY_TEST_BUFFERS_COUNT ];
+		renderer_command_buffer_set_sort_key( buffer, sort_key );
+		renderer_record_bind_program( buffer, program );
+		renderer_record_set_uniform( buffer, program, /* model */ 0, &packet.model );
+		renderer_record_set_uniform( buffer, program, /* color */ 1, &packet.color );
+		renderer_record_bind_texture( buffer, 0, packet.texture_id );
+		renderer_record_draw( buffer, packet.mesh_id );
+		array_add( &sort_items, Radix_Sort_Item { .key = sort_key, .index = it_index } );
+	}
+	Renderer_Command_Stream stream;
+	renderer_command_stream_init( &stream, sys_allocator, packets_count * 5 );
+	result.commands_count = renderer_command_stream_merge( &stream, array_view( buffer_pointers, REPLAY_TEST_BUFFERS_COUNT ) );
+
+	// Both runs start from an unknown state, through the mock dispatch.
+	OpenGL_State saved_state = g_renderer.gl_state;
+	u32 saved_draw_calls = g_renderer.draw_stats.draw_calls;
+	OpenGL_State_Dispatch dispatch = {
+		.use_program = replay_test_use_program,
+		.bind_vertex_array = replay_test_bind_vertex_array,
+		.bind_texture_unit = replay_test_bind_texture_unit,
+		.bind_framebuffer = replay_test_bind_framebuffer,
+		.viewport = replay_test_viewport,
+		.enable = replay_test_enable,
+		.disable = replay_test_disable
+	};
+	Array< Replay_Test_Call > replayed_calls = array_new< Replay_Test_Call >( sys_allocator, result.commands_count );
+	Array< Replay_Test_Call > direct_calls = array_new< Replay_Test_Call >( sys_allocator, result.commands_count );
+	Array< u8 > replayed_uniforms = array_new< u8 >( sys_allocator, 256 );
+	Array< u8 > direct_uniforms = array_new< u8 >( sys_allocator, 256 );
+
+	// 1. Replay of the merged stream.
+	opengl_state_init( &g_renderer.gl_state, dispatch );
+	g_renderer.draw_stats.draw_calls = 0;
+	g_replay_test_calls = &replayed_calls;
+	replay_command_stream( &stream );
+	result.replayed_draw_calls = g_renderer.draw_stats.draw_calls;
+	result.replayed_elided = g_renderer.gl_state.frame.elided;
+	replay_test_snapshot_uniforms( programs, &replayed_uniforms );
+
+	// 2. The same packets sorted the same way, straight through the backend's functions.
+	opengl_state_init( &g_renderer.gl_state, dispatch );
+	g_renderer.draw_stats.draw_calls = 0;
+	g_replay_test_calls = &direct_calls;
+	array_resize( &sort_items_swap, packets_count );
+	sort_items_swap.size = packets_count;
+	Array< Radix_Sort_Item > *sorted = radix_sort( &sort_items, &sort_items_swap );
+	ForIt( sorted->data, sorted->size ) {
+		u64 sort_key;
+		Replay_Test_Packet packet = replay_test_packet( it.index, meshes, textures, &sort_key );
+		Renderer_Shader_Program *program = &programs[ packet.program_idx ];
+		renderer_bind_shader_program( program );
+		renderer_shader_program_set_uniform( program, /* model */ 0, &packet.model );
+		renderer_shader_program_set_uniform( program, /* color */ 1, &packet.color );
+		renderer_bind_texture( 0, packet.texture_id );
+		// There is no other way to draw a single mesh, so the draw is a command built in place.
+		Renderer_Command_Draw draw = { .mesh_id = packet.mesh_id, .instance_count = 1, .first_instance = 0 };
+		replay_command_draw( &draw );
+	}}
+	result.direct_draw_calls = g_renderer.draw_stats.draw_calls;
+	replay_test_snapshot_uniforms( programs, &direct_uniforms );
+
+	g_replay_test_calls = NULL;
+	g_renderer.gl_state = saved_state;
+	g_renderer.draw_stats.draw_calls = saved_draw_calls;
+
+	result.replayed_calls_count = replayed_calls.size;
+	result.direct_calls_count = direct_calls.size;
+	result.outputs_equal =
+		( replayed_calls.size == direct_calls.size ) &&
+		( memcmp( replayed_calls.data, direct_calls.data, replayed_calls.size * sizeof( Replay_Test_Call ) ) == 0 ) &&
+		( replayed_uniforms.size == direct_uniforms.size ) &&
+		( memcmp( replayed_uniforms.data, direct_uniforms.data, replayed_uniforms.size ) == 0 ) &&
+		( result.replayed_draw_calls == result.direct_draw_calls );
+	u32 dropped_count = 0;
+	For( REPLAY_TEST_BUFFERS_COUNT ) {
+		dropped_count += buffers[ it_index ].dropped_count;
+	}
+	result.outputs_equal &= ( dropped_count == 0 );
+
+	array_free( &replayed_calls );
+	array_free( &direct_calls );
+	array_free( &replayed_uniforms );
+	array_free( &direct_uniforms );
+	array_free( &sort_items );
+	array_free( &sort_items_swap );
+	renderer_command_stream_destroy( &stream );
+	For( REPLAY_TEST_BUFFERS_COUNT ) {
+		renderer_command_buffer_destroy( &buffers[ it_index ] );
+	}
+	For( REPLAY_TEST_PROGRAMS_COUNT ) {
+		array_free( &programs[ it_index ].uniforms );
+	}
+	return result;
+}
+
+u32
+renderer_proxies_count() {
+	Renderer_Proxy_Table *table = &g_renderer.proxies;
+	return table->proxies.size - table->stale_count + table->pending.size;
+}
+
+u32
+renderer_proxy_instances_uploaded() {
+	return g_renderer.reported_stats.draw.proxy_instances_uploaded;
 }
 
 void
@@ -2045,12 +2024,7 @@ renderer_texture_attach_to_framebuffer( Texture_ID texture_id, Renderer_Framebuf
 	}
 
 	GLenum opengl_framebuffer_attachment = renderer_framebuffer_attachment_point_to_opengl( attachment_point );
-	glNamedFramebufferTexture(
-		/* framebuffer */ framebuffer->opengl_framebuffer,
-		/*  attachment */ opengl_framebuffer_attachment,
-		/*     texture */ texture->opengl_id,
-		/*       level */ 0  // mipmap
-	);
+	g_renderer.dispatch.framebuffer_attach_texture( framebuffer, opengl_framebuffer_attachment, texture );
 
 	Renderer_Framebuffer_Attachment attachment = {
 		.attachment_point = attachment_point,
@@ -2079,33 +2053,6 @@ renderer_texture_attach_to_framebuffer( Texture_ID texture_id, Renderer_Framebuf
 	return true;
 }
 
-static void
-opengl_create_and_bind_texture_2d( GLuint *id, StringView_ASCII debug_name ) {
-	glGenTextures( 1, id );
-	glBindTexture( GL_TEXTURE_2D, *id );
-#ifdef QLIGHT_DEBUG
-	if ( debug_name.size > 0 )
-		glObjectLabel( GL_TEXTURE, *id, debug_name.size, debug_name.data );
-	log_debug_gl( "Created and bound 2D Texture '" StringViewFormat "' (gl_id: %u).",
-		StringViewArgument( debug_name ),
-		*id
-	);
-#endif
-}
-
-static void
-opengl_create_texture_2d( GLuint *id, StringView_ASCII debug_name ) {
-	glCreateTextures( GL_TEXTURE_2D, 1, id );
-#ifdef QLIGHT_DEBUG
-	if ( debug_name.size > 0 )
-		glObjectLabel( GL_TEXTURE, *id, debug_name.size, debug_name.data );
-	log_debug_gl( "Created 2D Texture '" StringViewFormat "' (gl_id: %u).",
-		StringViewArgument( debug_name ),
-		*id
-	);
-#endif
-}
-
 bool
 renderer_texture_2d_upload(
 	Texture_ID texture_id,
@@ -2124,52 +2071,7 @@ renderer_texture_2d_upload(
 	texture->mipmap_levels = mipmap_levels;
 	texture->opengl_storage_format = opengl_storage_format;
 	texture->opengl_pixel_type = opengl_pixel_type;
-
-	// 1. Create OpenGL identifier.
-	opengl_create_texture_2d( &texture->opengl_id, texture->name );
-
-	// 2. Allocate Immutable Texture Storage.
-	// It cannot be modified (reused) like the legacy one, a new one must be created.
-	glTextureStorage2D(
-		/*        texture */ texture->opengl_id,
-		/*         levels */ texture->mipmap_levels,
-		/* internalformat */ texture->opengl_storage_format, // Sized format, for example: `GL_RGBA8`.
-		/*          width */ ( GLsizei )texture->dimensions.width,
-		/*         height */ ( GLsizei )texture->dimensions.height
-	);
-
-#ifdef QLIGHT_DEBUG
-	// Make sure it actually uses Immutable Texture Storage.
-	GLint opengl_texture_storage_immutable = 0;
-	glGetTextureParameteriv( texture->opengl_id, GL_TEXTURE_IMMUTABLE_FORMAT, &opengl_texture_storage_immutable );
-	Assert( opengl_texture_storage_immutable == GL_TRUE );
-#endif
-
-	// 3. Upload texture data.
-	if ( texture->bytes.data ) {
-		GLenum opengl_format = renderer_texture_channels_to_opengl( texture->channels );
-		glTextureSubImage2D(
-			/* texture */ texture->opengl_id,
-			/*   level */ 0,  // 0th mipmap - Base image, full resolution.
-			/* xoffset */ ( GLint )texture->origin.x,
-			/* yoffset */ ( GLint )texture->origin.y,
-			/*   width */ ( GLsizei )texture->dimensions.width,
-			/*  height */ ( GLsizei )texture->dimensions.height,
-			/*  format */ opengl_format, // Generic channels layout format, for example: `GL_RGB`.
-			/*    type */ texture->opengl_pixel_type,  // Pixel data type, for example: `GL_UNSIGNED_BYTE`.
-			/*   pixel */ texture->bytes.data
-		);
-
-		// 4. Generate mipmaps automatically from the base level.
-		if ( texture->mipmap_levels > 1 )
-			glGenerateTextureMipmap( texture->opengl_id );
-	}
-
-	// 5. Set texture parameters.
-	glTextureParameteri( texture->opengl_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
-	glTextureParameteri( texture->opengl_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-	// glTextureParameteri( texture->opengl_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER );
-	// glTextureParameteri( texture->opengl_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER );
+	texture->opengl_id = g_renderer.dispatch.texture_2d_create( texture );
 
 	StringView_ASCII storage_format_name = opengl_storage_format_name( texture->opengl_storage_format );
 	StringView_ASCII pixel_type_name = opengl_pixel_type_name( texture->opengl_pixel_type );
@@ -2190,123 +2092,274 @@ renderer_texture_2d_upload(
 	return true;
 }
 
+static Texture_Array_Pool_ID
+texture_array_pool_find_or_create( Vector2_u16 dimensions, u8 mipmap_levels, GLint opengl_storage_format ) {
+	ForIt( g_renderer.texture_array_pools.data, g_renderer.texture_array_pools.size ) {
+		bool same_dimensions = ( it.dimensions.width == dimensions.width ) && ( it.dimensions.height == dimensions.height );
+		if ( same_dimensions && it.mipmap_levels == mipmap_levels && it.opengl_storage_format == opengl_storage_format )
+			return ( Texture_Array_Pool_ID )it_index;
+	}}
+
+	if ( g_renderer.texture_array_pools.size >= RENDERER_MAX_TEXTURE_ARRAY_POOLS )
+		return INVALID_TEXTURE_ARRAY_POOL_ID;
+
+	u32 layers_capacity = QL_min2( RENDERER_TEXTURE_ARRAY_POOL_INITIAL_LAYERS, g_renderer.gl_constants.max_array_texture_layers );
+	Texture_Array_Pool pool = {
+		.dimensions = dimensions,
+		.mipmap_levels = mipmap_levels,
+		.opengl_storage_format = opengl_storage_format,
+		.layers = array_new< Texture_ID >( sys_allocator, layers_capacity ),
+		.layers_capacity = layers_capacity,
+		.opengl_texture = g_renderer.dispatch.texture_array_create( dimensions, mipmap_levels, opengl_storage_format, layers_capacity, "texture_array_pool" )
+	};
+
+	Texture_Array_Pool_ID pool_id = ( Texture_Array_Pool_ID )array_add( &g_renderer.texture_array_pools, pool );
+	log_debug( "Created Texture Array Pool #%u (%hux%hu, %hhu mips, " StringViewFormat ", %u layers, gl_id: %u).",
+		pool_id,
+		dimensions.width,
+		dimensions.height,
+		mipmap_levels,
+		StringViewArgument( opengl_storage_format_name( opengl_storage_format ) ),
+		layers_capacity,
+		pool.opengl_texture
+	);
+	return pool_id;
+}
+
+// Moves the pool's layers into a new array texture with twice as many layers.
+static bool
+texture_array_pool_grow( Texture_Array_Pool *pool ) {
+	u32 old_capacity = pool->layers_capacity;
+	u32 new_capacity = QL_min2( old_capacity * 2, g_renderer.gl_constants.max_array_texture_layers );
+	if ( new_capacity <= old_capacity )
+		return false;
+
+	GLuint new_texture = g_renderer.dispatch.texture_array_grow( pool, new_capacity );
+	pool->opengl_texture = new_texture;
+	pool->layers_capacity = new_capacity;
+
+	// Views keep the old storage alive, so point them at the new one.
+	ForIt( pool->layers.data, pool->layers.size ) {
+		Texture *texture = texture_instance( it );
+		texture->opengl_id = g_renderer.dispatch.texture_array_layer_view( pool, texture, it_index );
+	}}
+
+	log_debug( "Grown Texture Array Pool from %u to %u layers (gl_id: %u).", old_capacity, new_capacity, new_texture );
+	return true;
+}
+
 bool
-renderer_mesh_upload( Mesh_ID mesh_id ) {
-	Mesh *mesh = mesh_instance( mesh_id );
+renderer_texture_array_upload( Texture_ID texture_id, u8 mipmap_levels, GLint opengl_storage_format, GLenum opengl_pixel_type ) {
+	Texture *texture = texture_instance( texture_id );
+	if ( texture->opengl_id != 0 )
+		return false;
 
-	if ( mesh->opengl_vao != 0 || mesh->opengl_vbo != 0 || mesh->opengl_ebo != 0 ) {
-		printf(
-			"WARNING: mesh_upload_to_renderer: Trying to upload already uploaded mesh (id: %u, name: \"" StringViewFormat "\"). Skipping.\n",
-			mesh_id,
-			StringViewArgument( mesh->name )
+	Texture_Array_Pool_ID pool_id = texture_array_pool_find_or_create( texture->dimensions, mipmap_levels, opengl_storage_format );
+	if ( pool_id == INVALID_TEXTURE_ARRAY_POOL_ID ) {
+		log_warning( "Too many texture array pools (sizes and formats), Texture '" StringViewFormat "' (#%u) is uploaded on its own. Materials will not see it.",
+			StringViewArgument( texture->name ),
+			texture_id
+		);
+		return renderer_texture_2d_upload( texture_id, { 0, 0 }, texture->dimensions, mipmap_levels, opengl_storage_format, opengl_pixel_type );
+	}
+
+	Texture_Array_Pool *pool = &g_renderer.texture_array_pools.data[ pool_id ];
+	if ( pool->layers.size >= pool->layers_capacity && !texture_array_pool_grow( pool ) ) {
+		log_error( "Texture Array Pool #%u is full, can not upload Texture '" StringViewFormat "' (#%u).",
+			pool_id,
+			StringViewArgument( texture->name ),
+			texture_id
 		);
 		return false;
 	}
 
-	/* 1. Create Vertex Array Object */
+	texture->origin = { 0, 0 };
+	texture->mipmap_levels = mipmap_levels;
+	texture->opengl_storage_format = opengl_storage_format;
+	texture->opengl_pixel_type = opengl_pixel_type;
+	u32 layer = array_add( &pool->layers, texture_id );
 
-	opengl_create_vertex_array( &mesh->opengl_vao, string_view( &mesh->name ) );
+	g_renderer.dispatch.texture_array_upload_layer( pool, texture, layer );
 
-	/* 2. Create Vertex Buffer Object */
+	texture->texture_array_pool_id = pool_id;
+	texture->texture_array_layer = ( u16 )layer;
+	texture->opengl_id = g_renderer.dispatch.texture_array_layer_view( pool, texture, layer );
 
-	opengl_create_vertex_buffer( &mesh->opengl_vbo, string_view( &mesh->name ) );
+	log_debug(
+		"Uploaded 2D Texture '" StringViewFormat "' (#%u, %u bytes) to Texture Array Pool #%u, layer %u (%hux%hu, %hhu mips, view gl_id: %u).",
+		StringViewArgument( texture->name ),
+		texture_id,
+		texture->bytes.size,
+		pool_id,
+		layer,
+		texture->dimensions.width,
+		texture->dimensions.height,
+		texture->mipmap_levels,
+		texture->opengl_id
+	);
+	return true;
+}
 
-	/* 3. Upload Vertex data */
+bool
+renderer_texture_2d_update( Texture_ID texture_id ) {
+	Texture *texture = texture_instance( texture_id );
+	if ( texture->opengl_id == 0 || texture->bytes.data == NULL )
+		return false;
 
-	GLenum opengl_vertex_buffer_usage = ( mesh_is_dynamic( mesh ) ) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
-	u32 vertices_size = mesh->vertices.size * mesh->vertices.item_size;
-	u8 *vertices_data = mesh->vertices.data;
-	glNamedBufferData( mesh->opengl_vbo, vertices_size, vertices_data, opengl_vertex_buffer_usage );
+	Renderer_Frame_Packet *packet = &g_renderer.packets[ g_renderer.packet_idx ];
+	if ( packet->texture_updates_count >= RENDERER_FRAME_PACKET_MAX_TEXTURE_UPDATES )
+		return false;
 
-	/* 4. Define vertex attributes */
+	// The game thread may change the bytes again while the render thread uploads them.
+	u8 *bytes = frame_packet_copy( packet, texture->bytes.data, texture->bytes.size );
+	if ( !bytes )
+		return false;
 
-	/*
-		WARNING: Vertex attributes offsets are set sequentially!
-		If attribute indices do not correspond to indices within array, offsets will be completely wrong.
-		TODO: Do something about it.
-	*/
-	constexpr u32 MAX_BINDINGS = 2;  // @TODO: Handle in run-time.
-	u32 binding_offsets[ MAX_BINDINGS ];
-	u32 binding_strides[ MAX_BINDINGS ];
-	For( MAX_BINDINGS ) {
-		binding_offsets[ it_index ] = 0;
-		binding_strides[ it_index ] = mesh_vertex_attributes_size( mesh, /* binding */ it_index );
-	}
+	packet->texture_updates[ packet->texture_updates_count ] = Renderer_Frame_Texture_Update {
+		.texture_id = texture_id,
+		.bytes = bytes
+	};
+	packet->texture_updates_count += 1;
+	return true;
+}
 
-	// Bind VBO (Vertex Buffer) to a VAO (Vertex Array) binding slot.
-	glVertexArrayVertexBuffer(
-		/*        vaobj */ mesh->opengl_vao,
-		/* bindingindex */ 0,
-		/*       buffer */ mesh->opengl_vbo,
-		/*       offset */ 0,
-		/*       stride */ binding_strides[ 0 ]
-	);
+static bool
+geometry_pool_accepts_mesh( Geometry_Pool *pool, Mesh *mesh ) {
+	if ( pool->index_size != mesh->indices.item_size )
+		return false;
 
-	ForIt( mesh->vertex_attributes.data, mesh->vertex_attributes.size ) {
-		GLenum opengl_data_type = renderer_data_type_to_opengl_type( it.data_type );
-		u32 data_type_size = ( u32 )renderer_data_type_size( it.data_type ) * it.elements;
-		bool active = it.bits & RendererVertexAttributeBit_Active;
-		bool normalize = it.bits & RendererVertexAttributeBit_Normalize;
-
-		u32 *offset = &binding_offsets[ it.binding ];
-		// Set attribute format parameters.
-		glVertexArrayAttribFormat(
-			/*          vaobj */ mesh->opengl_vao,
-			/*    attribindex */ it.index,
-			/*           size */ it.elements,
-			/*           type */ opengl_data_type,
-			/*     normalized */ normalize,
-			/* relativeoffset */ *offset
-		);
+	if ( pool->vertex_attributes.size != mesh->vertex_attributes.size )
+		return false;
 
-		// Specify from which VBO (Vertex Buffer) to read the attribute from.
-		// Binding is a VAO (Vertex Array) slot a VBO (Vertex Buffer) is bound to.
-		glVertexArrayAttribBinding(
-			/*        vaobj */ mesh->opengl_vao,
-			/*  attribindex */ it.index,
-			/* bindingindex */ it.binding
-		);
-		*offset += data_type_size;
+	ForIt( pool->vertex_attributes.data, pool->vertex_attributes.size ) {
+		Renderer_Vertex_Attribute *other = &mesh->vertex_attributes.data[ it_index ];
+		bool same_attribute = ( it.index == other->index ) &&
+			( it.binding == other->binding ) &&
+			( it.elements == other->elements ) &&
+			( it.data_type == other->data_type ) &&
+			( it.bits == other->bits );
 
-		if ( active ) {
-			glEnableVertexArrayAttrib(
-				/* vaobj */ mesh->opengl_vao,
-				/* index */ it.index
-			);
-		} else {
-			glDisableVertexArrayAttrib(
-				/* vaobj */ mesh->opengl_vao,
-				/* index */ it.index
-			);
-		}
+		if ( !same_attribute )
+			return false;
 	}}
 
-	/* 5. Create Element Buffer Object */
+	return true;
+}
+
+static Geometry_Pool_ID
+geometry_pool_create( Mesh *mesh ) {
+	if ( g_renderer.geometry_pools.size >= INVALID_GEOMETRY_POOL_ID ) {
+		log_error( "Too many geometry pools (vertex formats), can not add one for Mesh '" StringViewFormat "'.", StringViewArgument( mesh->name ) );
+		return INVALID_GEOMETRY_POOL_ID;
+	}
 
-	opengl_create_element_buffer( &mesh->opengl_ebo, string_view( &mesh->name ) );
+	Geometry_Pool pool = {
+		.vertex_attributes = array_new< Renderer_Vertex_Attribute >( sys_allocator, array_view( &mesh->vertex_attributes ) ),
+		.vertex_stride = mesh_vertex_attributes_size( mesh, /* binding */ 0 ),
+		.index_size = mesh->indices.item_size,
+		.vertices = offset_allocator_new( sys_allocator, RENDERER_GEOMETRY_POOL_INITIAL_VERTICES ),
+		.indices = offset_allocator_new( sys_allocator, RENDERER_GEOMETRY_POOL_INITIAL_INDICES ),
+	};
 
-	GLenum opengl_index_buffer_usage = ( mesh_is_dynamic( mesh ) ) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
-	u32 indices_size = mesh->indices.size * mesh->indices.item_size;
-	u8 *indices_data = mesh->indices.data;
-	glNamedBufferData( mesh->opengl_ebo, indices_size, indices_data, opengl_index_buffer_usage );
+	g_renderer.dispatch.geometry_pool_create( &pool );
 
-	glVertexArrayElementBuffer(
-		/*  vaobj */ mesh->opengl_vao,
-		/* buffer */ mesh->opengl_ebo
+	Geometry_Pool_ID pool_id = ( Geometry_Pool_ID )array_add( &g_renderer.geometry_pools, pool );
+	log_debug( "Created Geometry Pool #%u (vertex stride: %u, index size: %u, VAO: %u, VBO: %u, EBO: %u).",
+		pool_id,
+		pool.vertex_stride,
+		pool.index_size,
+		pool.opengl_vao,
+		pool.opengl_vbo,
+		pool.opengl_ebo
 	);
+	return pool_id;
+}
+
+static Geometry_Pool_ID
+geometry_pool_find_or_create( Mesh *mesh ) {
+	ForIt( g_renderer.geometry_pools.data, g_renderer.geometry_pools.size ) {
+		if ( geometry_pool_accepts_mesh( &it, mesh ) )
+			return ( Geometry_Pool_ID )it_index;
+	}}
+
+	return geometry_pool_create( mesh );
+}
+
+// Allocates `size` items from `offset_allocator`, moving `*buffer` into a larger one if it does not fit.
+static u32
+geometry_pool_allocate( Geometry_Pool *pool, Offset_Allocator *offset_allocator, GLuint *buffer, u32 item_size, u32 size ) {
+	if ( size < 1 )
+		return 0;
+
+	u32 offset = offset_allocator_allocate( offset_allocator, size );
+	if ( offset != OFFSET_ALLOCATOR_INVALID )
+		return offset;
+
+	u32 old_capacity = offset_allocator->capacity;
+	u32 new_capacity = old_capacity * 2;
+	if ( new_capacity < old_capacity + size )
+		new_capacity = old_capacity + size;
+
+	g_renderer.dispatch.geometry_pool_grow_buffer( pool, buffer, ( u64 )old_capacity * item_size, ( u64 )new_capacity * item_size );
+
+	log_debug( "Grown Geometry Pool buffer from %u to %u items (gl_id: %u).", old_capacity, new_capacity, *buffer );
+	offset_allocator_grow( offset_allocator, new_capacity );
+	offset = offset_allocator_allocate( offset_allocator, size );
+	Assert( offset != OFFSET_ALLOCATOR_INVALID );
+	return offset;
+}
+
+bool
+renderer_mesh_upload( Mesh_ID mesh_id ) {
+	Mesh *mesh = mesh_instance( mesh_id );
+
+	if ( mesh_is_uploaded( mesh ) ) {
+		log_warning( "Trying to upload already uploaded Mesh '" StringViewFormat "' (#%u). Skipping.",
+			StringViewArgument( mesh->name ),
+			mesh_id
+		);
+		return false;
+	}
+
+	Geometry_Pool_ID pool_id = geometry_pool_find_or_create( mesh );
+	if ( pool_id == INVALID_GEOMETRY_POOL_ID )
+		return false;
+
+	Geometry_Pool *pool = &g_renderer.geometry_pools.data[ pool_id ];
+	Assert( mesh->vertices.item_size == pool->vertex_stride );
+	u32 base_vertex = geometry_pool_allocate( pool, &pool->vertices, &pool->opengl_vbo, pool->vertex_stride, mesh->vertices.size );
+	u32 first_index = geometry_pool_allocate( pool, &pool->indices, &pool->opengl_ebo, pool->index_size, mesh->indices.size );
 
-	log_debug( "Uploaded Mesh '" StringViewFormat "' (#%u, %u vertices, %u indices) to GPU memory (VAO: %u, VBO: %u, EBO: %u).",
+	mesh->geometry_pool_id = pool_id;
+	mesh->base_vertex = base_vertex;
+	mesh->first_index = first_index;
+	g_renderer.dispatch.mesh_upload( pool, mesh );
+	mesh->bits1 |= MeshBit_Uploaded;
+
+	log_debug( "Uploaded Mesh '" StringViewFormat "' (#%u, %u vertices, %u indices) to Geometry Pool #%u (base vertex: %u, first index: %u).",
 		StringViewArgument( mesh->name ),
 		mesh_id,
 		mesh->vertices.size,
 		mesh->indices.size,
-		mesh->opengl_vao,
-		mesh->opengl_vbo,
-		mesh->opengl_ebo
+		pool_id,
+		base_vertex,
+		first_index
 	);
 	return true;
 }
 
+void
+renderer_mesh_release( Mesh_ID mesh_id ) {
+	Mesh *mesh = mesh_instance( mesh_id );
+	if ( !mesh || !mesh_is_uploaded( mesh ) )
+		return;
+
+	Geometry_Pool *pool = &g_renderer.geometry_pools.data[ mesh->geometry_pool_id ];
+	offset_allocator_release( &pool->vertices, mesh->base_vertex, mesh->vertices.size );
+	offset_allocator_release( &pool->indices, mesh->first_index, mesh->indices.size );
+	mesh->bits1 &= ~MeshBit_Uploaded;
+}
+
 bool
 renderer_model_meshes_upload( Model_ID model_id ) {
 	Model *model = model_instance( model_id );
@@ -2373,134 +2426,10 @@ renderer_texture_purple_checkers() {
 	return g_renderer.texture_purple_checkers;
 }
 
-static void
-opengl_create_and_bind_uniform_buffer( GLuint *id, GLsizeiptr size, GLbitfield storage_bits, StringView_ASCII debug_name ) {
-	glGenBuffers( 1, id );
-	glBindBuffer( GL_UNIFORM_BUFFER, *id );
-#ifdef QLIGHT_DEBUG
-	if ( debug_name.size > 0 )
-		glObjectLabel( GL_BUFFER, *id, debug_name.size, debug_name.data );
-#endif
-	log_debug_gl( "Created and bound Uniform Buffer '" StringViewFormat "' (gl_id: %u).",
-		StringViewArgument( debug_name ),
-		*id
-	);
-	glNamedBufferStorage(
-		/* buffer */ *id,
-		/*   size */ size,
-		/*   data */ NULL,
-		/*  flags */ storage_bits
-	);
-}
-
-Renderer_Uniform_Buffer *
-renderer_uniform_buffer_create( StringView_ASCII name, u32 size, Renderer_GL_Buffer_Storage_Bits storage_bits, u32 binding ) {
-	Renderer_Uniform_Buffer _uniform_buffer = {
-		.name = name,
-		.size = size,
-		.binding = binding,
-		.storage_bits = storage_bits
-		// .opengl_ubo
-	};
-
-	opengl_create_and_bind_uniform_buffer( &_uniform_buffer.opengl_ubo, size, storage_bits, name );
-
-	u32 buffer_idx = array_add( &g_renderer.uniform_buffers, _uniform_buffer );
-	Renderer_Uniform_Buffer *uniform_buffer = &g_renderer.uniform_buffers.data[ buffer_idx ];
-
-	if ( binding != INVALID_UNIFORM_BUFFER_BINDING )
-		renderer_uniform_buffer_set_binding( uniform_buffer, binding );
-
-	return uniform_buffer;
-}
-
-void
-renderer_uniform_buffer_set_binding( Renderer_Uniform_Buffer *uniform_buffer, u32 binding ) {
-	glBindBuffer( GL_UNIFORM_BUFFER, uniform_buffer->opengl_ubo );
-	glBindBufferBase(
-		/* target */ GL_UNIFORM_BUFFER,
-		/* index  */ binding,
-		/* buffer */ uniform_buffer->opengl_ubo
-	);
-	uniform_buffer->binding = binding;
-}
-
-void *
-renderer_uniform_buffer_memory_map(
-	Renderer_Uniform_Buffer *uniform_buffer,
-	Renderer_GL_Map_Access_Bits access_bits,
-	u32 size,
-	u32 offset
-) {
-	u32 length = ( size != 0 ) ? size : uniform_buffer->size - offset;
-	Assert( offset < uniform_buffer->size );
-	void *uniform_data = glMapNamedBufferRange(
-		/* buffer */ uniform_buffer->opengl_ubo,
-		/* offset */ offset,
-		/* length */ length,
-		/* access */ access_bits
-	);
-
-	return uniform_data;
-}
-
-u32
-renderer_uniform_buffer_write( Renderer_Uniform_Buffer *uniform_buffer, ArrayView< u8 > write_data, u32 size, u32 offset ) {
-	if ( !write_data.data || write_data.size == 0 )
-		return 0;
-
-	Assert( size <= uniform_buffer->size - offset );
-	u32 write_size = size;
-	if ( size == 0 )
-		write_size = uniform_buffer->size - offset;
-
-
-	Renderer_GL_Map_Access_Bits access_bits = renderer_gl_buffer_storage_bits_to_map_access_bits( uniform_buffer->storage_bits );
-	void *uniform_data = renderer_uniform_buffer_memory_map( uniform_buffer, access_bits, write_size, offset );
-	memcpy( uniform_data, write_data.data, write_size );
-	Assert( renderer_uniform_buffer_memory_unmap( uniform_buffer, access_bits, size, offset ) );
-	return write_size;
-}
-
 u32
-renderer_uniform_buffer_read( Renderer_Uniform_Buffer *uniform_buffer, Array< u8 > *out_read_data, u32 size, u32 offset ) {
-	if ( !out_read_data )
-		return 0;
-
-	Assert( size <= uniform_buffer->size - offset );
-	ArrayView< u8 > read_view;
-	read_view.size = size;
-	if ( size == 0 )
-		read_view.size = uniform_buffer->size - offset;
-
-	Renderer_GL_Map_Access_Bits access_bits = renderer_gl_buffer_storage_bits_to_map_access_bits( uniform_buffer->storage_bits );
-	read_view.data = ( u8 * )renderer_uniform_buffer_memory_map( uniform_buffer, access_bits, size, offset );
-	u32 bytes_read = array_add_many( out_read_data, read_view );
-	Assert( renderer_uniform_buffer_memory_unmap( uniform_buffer, access_bits, size, offset ) );
-	return bytes_read;
-}
-
-bool
-renderer_uniform_buffer_memory_unmap( Renderer_Uniform_Buffer *uniform_buffer, Renderer_GL_Map_Access_Bits access_bits, u32 size, u32 offset ) {
-	// TODO: Handle specific cases based on access bits:
-	//   InvalidateRange,
-	//   InvalidateBuffer,
-	//   FlushExplicit,
-	//   Unsynchronized.
-
-	// u32 length = ( size != 0 ) ? size : uniform_buffer->size - offset;
-	// GL_ASSERT( glFlushMappedNamedBufferRange(
-	// 	/* buffer */ uniform_buffer->opengl_ubo,
-	// 	/* offset */ ( GLintptr )offset,
-	// 	/* length */ ( GLsizei )length
-	// ) );
-	bool result = glUnmapNamedBuffer( uniform_buffer->opengl_ubo );
-	return result;
-}
-
-bool
-renderer_uniform_buffer_destroy( Renderer_Uniform_Buffer *uniform_buffer ) {
-	return false;
+renderer_frame_ring_overflows() {
+	// Headless backends never create the ring, it stays zeroed.
+	return g_renderer.frame_ring.overflows;
 }
 
 void
@@ -2508,6 +2437,11 @@ renderer_set_camera_position_pointer( Vector3_f32 *camera_position ) {
 	g_renderer.camera_position = camera_position;
 }
 
+void
+renderer_set_lighting_shader_program( Renderer_Shader_Program *program ) {
+	g_renderer.lighting_program = program;
+}
+
 void
 renderer_set_ambient_light_color( Vector3_f32 ambient_light ) {
 	g_renderer.ambient_light = ambient_light;
@@ -2552,7 +2486,119 @@ renderer_frame_time_delta() {
 	return g_renderer.frame_time.delta;
 }
 
+u32
+renderer_state_changes_issued() {
+	return g_renderer.reported_stats.state_changes.issued;
+}
+
+u32
+renderer_state_changes_elided() {
+	return g_renderer.reported_stats.state_changes.elided;
+}
+
+Linear_Allocator *
+renderer_frame_arena() {
+	return frame_arena();
+}
+
+u64
+renderer_frame_arena_high_water_mark() {
+	u64 high_water_mark = 0;
+	ForIt( g_renderer.frame_arenas, ARRAY_SIZE( g_renderer.frame_arenas ) ) {
+		high_water_mark = QL_max2( high_water_mark, it.high_water_mark() );
+	}}
+	return high_water_mark;
+}
+
+bool
+renderer_frame_steady_state() {
+	return g_renderer.steady_state_packets >= ARRAY_SIZE( g_renderer.packets );
+}
+
+u32
+renderer_draw_commands() {
+	return g_renderer.reported_stats.draw.draw_commands;
+}
+
+u32
+renderer_draw_calls() {
+	return g_renderer.reported_stats.draw.draw_calls;
+}
+
+void
+renderer_set_gl_error_check_mode( Renderer_GL_Error_Check_Mode mode ) {
+	g_renderer.settings.gl_error_check_mode = mode;
+}
+
+Renderer_GL_Error_Check_Mode
+renderer_gl_error_check_mode() {
+	return g_renderer.settings.gl_error_check_mode;
+}
+
+void
+renderer_set_gl_error_check_interval( u32 frames ) {
+	g_renderer.settings.gl_error_check_interval = frames;
+}
+
+u32
+renderer_gl_error_check_interval() {
+	return g_renderer.settings.gl_error_check_interval;
+}
+
+void
+renderer_request_gl_error_check() {
+	g_renderer.settings.gl_error_check_requested = true;
+}
+
+bool
+renderer_screenshot_write_ppm( const char *file_path ) {
+	if ( g_renderer.backend != RendererBackend_Software ) {
+		log_warning( "Only the software backend can write its frames into files." );
+		return false;
+	}
+
+	// The last frame may still be drawn on the render thread.
+	if ( renderer_thread_running() )
+		renderer_thread_wait_idle();
+	return renderer_software_write_ppm( &g_renderer.software, file_path );
+}
+
+Renderer_Software_Stats
+renderer_software_stats() {
+	if ( g_renderer.backend != RendererBackend_Software )
+		return Renderer_Software_Stats { 0 };
+
+	return g_renderer.software.stats;
+}
+
+bool
+renderer_capture_frames( const char *file_path, u32 frames_count ) {
+	if ( g_renderer.backend != RendererBackend_OpenGL ) {
+		log_warning( "The " StringViewFormat " backend makes no OpenGL calls, there is nothing to capture.", StringViewArgument( renderer_backend_name( g_renderer.backend ) ) );
+		return false;
+	}
+
+	u32 path_length = ( u32 )strlen( file_path );
+	if ( frames_count == 0 || path_length >= ARRAY_SIZE( g_renderer.capture_file_path ) )
+		return false;
+
+	memcpy( g_renderer.capture_file_path, file_path, path_length + 1 );
+	g_renderer.settings.capture_frames_count = frames_count;
+	return true;
+}
+
+u8 *
+renderer_mapped_buffer_memory( GLuint buffer, u64 *out_size ) {
+	*out_size = 0;
+	// Only the OpenGL backend maps its ring buffer.
+	if ( !g_renderer.frame_ring.mapped || buffer != g_renderer.frame_ring.opengl_buffer )
+		return NULL;
+
+	*out_size = ( u64 )g_renderer.frame_ring.frame_size * RENDERER_FRAMES_IN_FLIGHT;
+	return g_renderer.frame_ring.mapped;
+}
+
 void
 renderer_set_output_channel( Renderer_Output_Channel channel ) {
-	g_renderer.output_channel = channel;
+	g_renderer.settings.output_channel = channel;
 }
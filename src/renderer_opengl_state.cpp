@@ -0,0 +1,212 @@
+#include "renderer_opengl_state.h"
+
+void opengl_state_init( OpenGL_State *state, OpenGL_State_Dispatch dispatch ) {
+	state->dispatch = dispatch;
+	state->frame = OpenGL_State_Counters { 0 };
+	state->last_frame = OpenGL_State_Counters { 0 };
+	opengl_state_invalidate( state );
+}
+
+void opengl_state_invalidate( OpenGL_State *state ) {
+	state->program = OPENGL_STATE_UNKNOWN;
+	state->vertex_array = OPENGL_STATE_UNKNOWN;
+	state->framebuffer = OPENGL_STATE_UNKNOWN;
+	ForIt( state->textures, OPENGL_STATE_MAX_TEXTURE_UNITS ) {
+		it = OPENGL_STATE_UNKNOWN;
+	}}
+
+	state->viewport_known = false;
+	state->capabilities_enabled = 0;
+	state->capabilities_known = 0;
+}
+
+void opengl_state_frame_begin( OpenGL_State *state ) {
+	state->last_frame = state->frame;
+	state->frame = OpenGL_State_Counters { 0 };
+}
+
+GLenum opengl_state_capability_to_opengl( OpenGL_State_Capability capability ) {
+	switch ( capability ) {
+		case OpenGLStateCapability_DepthTest:    return GL_DEPTH_TEST;
+		case OpenGLStateCapability_StencilTest:  return GL_STENCIL_TEST;
+		case OpenGLStateCapability_CullFace:     return GL_CULL_FACE;
+		case OpenGLStateCapability_Blend:        return GL_BLEND;
+		case OpenGLStateCapability_ScissorTest:  return GL_SCISSOR_TEST;
+
+		default: return GL_NONE;
+	}
+}
+
+void opengl_state_use_program( OpenGL_State *state, GLuint program ) {
+	if ( state->program == program ) {
+		state->frame.elided += 1;
+		return;
+	}
+
+	state->dispatch.use_program( program );
+	state->program = program;
+	state->frame.issued += 1;
+}
+
+void opengl_state_bind_vertex_array( OpenGL_State *state, GLuint vertex_array ) {
+	if ( state->vertex_array == vertex_array ) {
+		state->frame.elided += 1;
+		return;
+	}
+
+	state->dispatch.bind_vertex_array( vertex_array );
+	state->vertex_array = vertex_array;
+	state->frame.issued += 1;
+}
+
+void opengl_state_bind_texture_unit( OpenGL_State *state, u32 unit, GLuint texture ) {
+	if ( unit >= OPENGL_STATE_MAX_TEXTURE_UNITS ) {
+		state->dispatch.bind_texture_unit( unit, texture );
+		state->frame.issued += 1;
+		return;
+	}
+
+	if ( state->textures[ unit ] == texture ) {
+		state->frame.elided += 1;
+		return;
+	}
+
+	state->dispatch.bind_texture_unit( unit, texture );
+	state->textures[ unit ] = texture;
+	state->frame.issued += 1;
+}
+
+void opengl_state_bind_framebuffer( OpenGL_State *state, GLuint framebuffer ) {
+	if ( state->framebuffer == framebuffer ) {
+		state->frame.elided += 1;
+		return;
+	}
+
+	state->dispatch.bind_framebuffer( GL_FRAMEBUFFER, framebuffer );
+	state->framebuffer = framebuffer;
+	state->frame.issued += 1;
+}
+
+void opengl_state_viewport( OpenGL_State *state, GLint x, GLint y, GLsizei width, GLsizei height ) {
+	OpenGL_State::Viewport *viewport = &state->viewport;
+	if ( state->viewport_known &&
+		 viewport->x == x && viewport->y == y &&
+		 viewport->width == width && viewport->height == height )
+	{
+		state->frame.elided += 1;
+		return;
+	}
+
+	state->dispatch.viewport( x, y, width, height );
+	*viewport = OpenGL_State::Viewport { x, y, width, height };
+	state->viewport_known = true;
+	state->frame.issued += 1;
+}
+
+void opengl_state_set_capability( OpenGL_State *state, OpenGL_State_Capability capability, bool enabled ) {
+	Assert( capability < OpenGLStateCapability_COUNT );
+	u32 capability_bit = 1u << capability;
+	bool known = ( state->capabilities_known & capability_bit ) != 0;
+	bool was_enabled = ( state->capabilities_enabled & capability_bit ) != 0;
+	if ( known && was_enabled == enabled ) {
+		state->frame.elided += 1;
+		return;
+	}
+
+	GLenum opengl_capability = opengl_state_capability_to_opengl( capability );
+	if ( enabled ) {
+		state->dispatch.enable( opengl_capability );
+		state->capabilities_enabled |= capability_bit;
+	} else {
+		state->dispatch.disable( opengl_capability );
+		state->capabilities_enabled &= ~capability_bit;
+	}
+
+	state->capabilities_known |= capability_bit;
+	state->frame.issued += 1;
+}
+
+// --- Test
+
+// The mock dispatch has no context pointer, so it counts into this.
+static u32 g_opengl_state_test_calls = 0;
+
+static void GLAPIENTRY opengl_state_test_use_program( GLuint )                       { g_opengl_state_test_calls += 1; }
+static void GLAPIENTRY opengl_state_test_bind_vertex_array( GLuint )                 { g_opengl_state_test_calls += 1; }
+static void GLAPIENTRY opengl_state_test_bind_texture_unit( GLuint, GLuint )         { g_opengl_state_test_calls += 1; }
+static void GLAPIENTRY opengl_state_test_bind_framebuffer( GLenum, GLuint )          { g_opengl_state_test_calls += 1; }
+static void GLAPIENTRY opengl_state_test_viewport( GLint, GLint, GLsizei, GLsizei )  { g_opengl_state_test_calls += 1; }
+static void GLAPIENTRY opengl_state_test_enable( GLenum )                            { g_opengl_state_test_calls += 1; }
+static void GLAPIENTRY opengl_state_test_disable( GLenum )                           { g_opengl_state_test_calls += 1; }
+
+OpenGL_State_Test opengl_state_test() {
+	OpenGL_State_Test test = { 0 };
+	OpenGL_State state;
+	opengl_state_init( &state, OpenGL_State_Dispatch {
+		.use_program = opengl_state_test_use_program,
+		.bind_vertex_array = opengl_state_test_bind_vertex_array,
+		.bind_texture_unit = opengl_state_test_bind_texture_unit,
+		.bind_framebuffer = opengl_state_test_bind_framebuffer,
+		.viewport = opengl_state_test_viewport,
+		.enable = opengl_state_test_enable,
+		.disable = opengl_state_test_disable
+	} );
+	g_opengl_state_test_calls = 0;
+
+	// Counts every state call made, whether the cache lets it through or not.
+	u32 binds_count = 0;
+#define OPENGL_STATE_TEST_CALL( function, ... )  ( binds_count += 1, opengl_state_##function( &state, __VA_ARGS__ ) )
+
+	// Every first bind goes through, the state is unknown.
+	OPENGL_STATE_TEST_CALL( use_program, 1 );
+	OPENGL_STATE_TEST_CALL( use_program, 1 );
+	OPENGL_STATE_TEST_CALL( use_program, 2 );
+	test.expected_calls_count += 2;
+
+	OPENGL_STATE_TEST_CALL( bind_vertex_array, 3 );
+	OPENGL_STATE_TEST_CALL( bind_vertex_array, 3 );
+	test.expected_calls_count += 1;
+
+	// Units are tracked apart, the same texture on another unit is a change.
+	OPENGL_STATE_TEST_CALL( bind_texture_unit, 0, 4 );
+	OPENGL_STATE_TEST_CALL( bind_texture_unit, 0, 4 );
+	OPENGL_STATE_TEST_CALL( bind_texture_unit, 1, 4 );
+	OPENGL_STATE_TEST_CALL( bind_texture_unit, 1, 5 );
+	test.expected_calls_count += 3;
+
+	// Units past the tracked ones always go through.
+	OPENGL_STATE_TEST_CALL( bind_texture_unit, OPENGL_STATE_MAX_TEXTURE_UNITS, 4 );
+	OPENGL_STATE_TEST_CALL( bind_texture_unit, OPENGL_STATE_MAX_TEXTURE_UNITS, 4 );
+	test.expected_calls_count += 2;
+
+	OPENGL_STATE_TEST_CALL( bind_framebuffer, 0 );
+	OPENGL_STATE_TEST_CALL( bind_framebuffer, 0 );
+	test.expected_calls_count += 1;
+
+	OPENGL_STATE_TEST_CALL( viewport, 0, 0, 1280, 720 );
+	OPENGL_STATE_TEST_CALL( viewport, 0, 0, 1280, 720 );
+	OPENGL_STATE_TEST_CALL( viewport, 0, 0, 640, 360 );
+	test.expected_calls_count += 2;
+
+	OPENGL_STATE_TEST_CALL( set_capability, OpenGLStateCapability_DepthTest, true );
+	OPENGL_STATE_TEST_CALL( set_capability, OpenGLStateCapability_DepthTest, true );
+	OPENGL_STATE_TEST_CALL( set_capability, OpenGLStateCapability_DepthTest, false );
+	OPENGL_STATE_TEST_CALL( set_capability, OpenGLStateCapability_Blend, false );
+	test.expected_calls_count += 3;
+
+	// After an invalidation nothing is known, so the same values go through once again.
+	opengl_state_invalidate( &state );
+	OPENGL_STATE_TEST_CALL( use_program, 2 );
+	OPENGL_STATE_TEST_CALL( bind_vertex_array, 3 );
+	OPENGL_STATE_TEST_CALL( bind_vertex_array, 3 );
+	test.expected_calls_count += 2;
+
+#undef OPENGL_STATE_TEST_CALL
+
+	test.calls_count = g_opengl_state_test_calls;
+	test.counters = state.frame;
+	test.redundant_filtered = ( test.calls_count == test.expected_calls_count ) &&
+		( test.counters.issued == test.expected_calls_count ) &&
+		( test.counters.issued + test.counters.elided == binds_count );
+	return test;
+}
@@ -0,0 +1,103 @@
+#ifndef QLIGHT_RENDERER_OPENGL_STATE_H
+#define QLIGHT_RENDERER_OPENGL_STATE_H
+
+// #define GLEW_STATIC - Defined in project settings.
+#include "../libs/GLEW/glew.h"
+
+#include "common.h"
+
+/*
+	Shadow copy of the OpenGL state that the renderer changes during a frame.
+	Binds and state changes that would not change anything are dropped here
+	  instead of going down to the driver.
+
+	The state does not call OpenGL directly, but goes through `OpenGL_State_Dispatch`.
+	The renderer fills it with the real OpenGL functions, while a mock dispatch
+	  can be used to drive the state without a GPU or a context.
+*/
+
+struct OpenGL_State_Dispatch {
+	void ( GLAPIENTRY *use_program )( GLuint program );
+	void ( GLAPIENTRY *bind_vertex_array )( GLuint vertex_array );
+	void ( GLAPIENTRY *bind_texture_unit )( GLuint unit, GLuint texture );
+	void ( GLAPIENTRY *bind_framebuffer )( GLenum target, GLuint framebuffer );
+	void ( GLAPIENTRY *viewport )( GLint x, GLint y, GLsizei width, GLsizei height );
+	void ( GLAPIENTRY *enable )( GLenum capability );
+	void ( GLAPIENTRY *disable )( GLenum capability );
+};
+
+enum OpenGL_State_Capability : u8 {
+	OpenGLStateCapability_DepthTest = 0,
+	OpenGLStateCapability_StencilTest,
+	OpenGLStateCapability_CullFace,
+	OpenGLStateCapability_Blend,
+	OpenGLStateCapability_ScissorTest,
+
+	OpenGLStateCapability_COUNT
+};
+
+// Texture units tracked by the cache.  Binds to units past this go straight to OpenGL.
+constexpr u32 OPENGL_STATE_MAX_TEXTURE_UNITS = 32;
+
+// Object name that is never returned by OpenGL, means "bound object is unknown".
+constexpr GLuint OPENGL_STATE_UNKNOWN = U32_MAX;
+
+struct OpenGL_State_Counters {
+	u32 issued;  // Calls that reached OpenGL.
+	u32 elided;  // Calls dropped because the state was already set.
+};
+
+struct OpenGL_State {
+	OpenGL_State_Dispatch dispatch;
+
+	GLuint program;
+	GLuint vertex_array;
+	GLuint framebuffer;
+	GLuint textures[ OPENGL_STATE_MAX_TEXTURE_UNITS ];
+
+	struct Viewport {
+		GLint x;
+		GLint y;
+		GLsizei width;
+		GLsizei height;
+	} viewport;
+	bool viewport_known;
+
+	u32 capabilities_enabled;  // Bit per `OpenGL_State_Capability`.
+	u32 capabilities_known;    // Bit per `OpenGL_State_Capability`.
+
+	OpenGL_State_Counters frame;       // Counted since `opengl_state_frame_begin()`.
+	OpenGL_State_Counters last_frame;  // Totals of the previous frame.
+};
+
+void opengl_state_init( OpenGL_State *state, OpenGL_State_Dispatch dispatch );
+
+// Forget everything that is known about the bound state, so the next change of each kind
+//   goes through.  Has to be called whenever OpenGL state might have been changed
+//   behind the cache's back (third-party code, direct OpenGL calls).
+void opengl_state_invalidate( OpenGL_State *state );
+
+// Moves the current frame counters to `last_frame` and resets them.
+void opengl_state_frame_begin( OpenGL_State *state );
+
+GLenum opengl_state_capability_to_opengl( OpenGL_State_Capability capability );
+
+void opengl_state_use_program( OpenGL_State *state, GLuint program );
+void opengl_state_bind_vertex_array( OpenGL_State *state, GLuint vertex_array );
+void opengl_state_bind_texture_unit( OpenGL_State *state, u32 unit, GLuint texture );
+void opengl_state_bind_framebuffer( OpenGL_State *state, GLuint framebuffer );
+void opengl_state_viewport( OpenGL_State *state, GLint x, GLint y, GLsizei width, GLsizei height );
+void opengl_state_set_capability( OpenGL_State *state, OpenGL_State_Capability capability, bool enabled );
+
+struct OpenGL_State_Test {
+	u32 calls_count;           // Made to the mock dispatch.
+	u32 expected_calls_count;  // Changes in the sequence, the rest repeat what is set.
+	OpenGL_State_Counters counters;
+	bool redundant_filtered;   // Only the changes reached the dispatch, and the counters agree.
+};
+
+// Drives a state through a mock dispatch with a fixed sequence of binds and changes, many of them
+//   repeating the current state, and counts what reaches the dispatch.
+OpenGL_State_Test opengl_state_test();
+
+#endif /* QLIGHT_RENDERER_OPENGL_STATE_H */
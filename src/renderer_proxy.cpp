@@ -0,0 +1,345 @@
+#include <string.h>
+
+#include "renderer_proxy.h"
+
+// Sets scratch array size to exactly `size` items, growing its capacity if needed.
+template < typename T >
+static void
+proxy_table_scratch_resize( Array< T > *array, u32 size ) {
+	// `array_resize` only updates the size when no reallocation happens.
+	array_resize( array, size );
+	array->size = size;
+}
+
+static void
+proxy_table_mark_dirty( Renderer_Proxy_Table *table, u32 begin, u32 end ) {
+	if ( begin >= end )
+		return;
+
+	if ( table->dirty_begin >= table->dirty_end ) {
+		table->dirty_begin = begin;
+		table->dirty_end = end;
+		return;
+	}
+
+	table->dirty_begin = QL_min2( table->dirty_begin, begin );
+	table->dirty_end = QL_max2( table->dirty_end, end );
+}
+
+static void
+instance_data_write_transform( Renderer_Instance_Data *instance, Transform *transform ) {
+	instance->model_matrix = transform->model_matrix;
+	Matrix3x3_f32 *normal_matrix = &transform->normal_matrix;
+	For( 3 ) {
+		Vector3_f32 column = normal_matrix->columns[ it_index ];
+		instance->normal_matrix[ it_index ] = Vector4_f32 { column.x, column.y, column.z, 0.0f };
+	}
+}
+
+// Swaps the last pending proxy into the removed one's place.
+static void
+pending_remove_at( Renderer_Proxy_Table *table, u32 pending_idx ) {
+	u32 last_idx = table->pending.size - 1;
+	if ( pending_idx != last_idx ) {
+		Renderer_Proxy last = table->pending.data[ last_idx ];
+		table->pending.data[ pending_idx ] = last;
+		table->pending_instances.data[ pending_idx ] = table->pending_instances.data[ last_idx ];
+		table->positions.data[ last.id ] = pending_idx | RENDERER_PROXY_POSITION_PENDING_BIT;
+	}
+
+	table->pending.size -= 1;
+	table->pending_instances.size -= 1;
+}
+
+void renderer_proxy_table_init( Renderer_Proxy_Table *table, Allocator *allocator, u32 initial_capacity ) {
+	*table = Renderer_Proxy_Table {
+		.proxies = array_new< Renderer_Proxy >( allocator, initial_capacity ),
+		.instances = array_new< Renderer_Instance_Data >( allocator, initial_capacity ),
+		.stale_count = 0,
+		.pending = array_new< Renderer_Proxy >( allocator, initial_capacity ),
+		.pending_instances = array_new< Renderer_Instance_Data >( allocator, initial_capacity ),
+		.positions = array_new< u32 >( allocator, initial_capacity ),
+		.free_ids = array_new< Renderer_Proxy_ID >( allocator, initial_capacity ),
+		.dirty_begin = 0,
+		.dirty_end = 0,
+		.visible_bits = array_new< u32 >( allocator, initial_capacity / 32 + 1 ),
+		.sort_items = array_new< Radix_Sort_Item >( allocator, initial_capacity ),
+		.sort_items_swap = array_new< Radix_Sort_Item >( allocator, initial_capacity ),
+		.merged = array_new< Renderer_Proxy >( allocator, initial_capacity ),
+		.merged_instances = array_new< Renderer_Instance_Data >( allocator, initial_capacity )
+	};
+}
+
+void renderer_proxy_table_destroy( Renderer_Proxy_Table *table ) {
+	array_free( &table->proxies );
+	array_free( &table->instances );
+	array_free( &table->pending );
+	array_free( &table->pending_instances );
+	array_free( &table->positions );
+	array_free( &table->free_ids );
+	array_free( &table->visible_bits );
+	array_free( &table->sort_items );
+	array_free( &table->sort_items_swap );
+	array_free( &table->merged );
+	array_free( &table->merged_instances );
+	table->stale_count = 0;
+	table->dirty_begin = 0;
+	table->dirty_end = 0;
+}
+
+Renderer_Proxy_ID renderer_proxy_table_add( Renderer_Proxy_Table *table, u64 sort_key, Mesh_ID mesh_id, Material_ID material_id, Renderer_Render_Pass pass ) {
+	Renderer_Proxy_ID proxy_id;
+	if ( !array_pop( &table->free_ids, &proxy_id ) )
+		proxy_id = array_add( &table->positions, RENDERER_PROXY_POSITION_INVALID );
+	Assert( proxy_id < RENDERER_PROXY_POSITION_PENDING_BIT );
+
+	Renderer_Instance_Data instance;
+	instance.model_matrix = Matrix4x4_f32( 1.0f );
+	instance.normal_matrix[ 0 ] = Vector4_f32 { 1.0f, 0.0f, 0.0f, 0.0f };
+	instance.normal_matrix[ 1 ] = Vector4_f32 { 0.0f, 1.0f, 0.0f, 0.0f };
+	instance.normal_matrix[ 2 ] = Vector4_f32 { 0.0f, 0.0f, 1.0f, 0.0f };
+	instance.material_id = material_id;
+	instance._padding0[ 0 ] = instance._padding0[ 1 ] = instance._padding0[ 2 ] = 0;
+
+	u32 pending_idx = array_add( &table->pending, Renderer_Proxy {
+		.sort_key = sort_key,
+		.id = proxy_id,
+		.mesh_id = mesh_id,
+		.material_id = material_id,
+		.pass = pass
+	} );
+	array_add( &table->pending_instances, instance );
+	table->positions.data[ proxy_id ] = pending_idx | RENDERER_PROXY_POSITION_PENDING_BIT;
+	return proxy_id;
+}
+
+void renderer_proxy_table_remove( Renderer_Proxy_Table *table, Renderer_Proxy_ID proxy_id ) {
+	Assert( proxy_id < table->positions.size );
+	if ( proxy_id >= table->positions.size )
+		return;
+
+	u32 position = table->positions.data[ proxy_id ];
+	Assert( position != RENDERER_PROXY_POSITION_INVALID );
+	if ( position == RENDERER_PROXY_POSITION_INVALID )
+		return;
+
+	if ( position & RENDERER_PROXY_POSITION_PENDING_BIT ) {
+		pending_remove_at( table, position & ~RENDERER_PROXY_POSITION_PENDING_BIT );
+	} else {
+		// Left in place so nothing moves until the next commit.
+		table->proxies.data[ position ].id = INVALID_RENDERER_PROXY_ID;
+		table->stale_count += 1;
+	}
+
+	table->positions.data[ proxy_id ] = RENDERER_PROXY_POSITION_INVALID;
+	array_add( &table->free_ids, proxy_id );
+}
+
+bool renderer_proxy_table_set_key( Renderer_Proxy_Table *table, Renderer_Proxy_ID proxy_id, u64 sort_key, Mesh_ID mesh_id, Material_ID material_id ) {
+	Renderer_Proxy *proxy = renderer_proxy_table_find( table, proxy_id );
+	if ( !proxy )
+		return false;
+
+	bool same = ( proxy->sort_key == sort_key ) && ( proxy->mesh_id == mesh_id ) && ( proxy->material_id == material_id );
+	if ( same )
+		return false;
+
+	u32 position = table->positions.data[ proxy_id ];
+	if ( position & RENDERER_PROXY_POSITION_PENDING_BIT ) {
+		// Not sorted yet, so it can be changed in place.
+		proxy->sort_key = sort_key;
+		proxy->mesh_id = mesh_id;
+		proxy->material_id = material_id;
+		table->pending_instances.data[ position & ~RENDERER_PROXY_POSITION_PENDING_BIT ].material_id = material_id;
+		return true;
+	}
+
+	Renderer_Proxy moved = *proxy;
+	moved.sort_key = sort_key;
+	moved.mesh_id = mesh_id;
+	moved.material_id = material_id;
+	Renderer_Instance_Data instance = table->instances.data[ position ];
+	instance.material_id = material_id;
+
+	proxy->id = INVALID_RENDERER_PROXY_ID;
+	table->stale_count += 1;
+
+	u32 pending_idx = array_add( &table->pending, moved );
+	array_add( &table->pending_instances, instance );
+	table->positions.data[ proxy_id ] = pending_idx | RENDERER_PROXY_POSITION_PENDING_BIT;
+	return true;
+}
+
+void renderer_proxy_table_set_transform( Renderer_Proxy_Table *table, Renderer_Proxy_ID proxy_id, Transform *transform ) {
+	Assert( proxy_id < table->positions.size );
+	if ( proxy_id >= table->positions.size )
+		return;
+
+	u32 position = table->positions.data[ proxy_id ];
+	if ( position == RENDERER_PROXY_POSITION_INVALID )
+		return;
+
+	if ( position & RENDERER_PROXY_POSITION_PENDING_BIT ) {
+		// Becomes dirty with the rest of the merged range.
+		instance_data_write_transform( &table->pending_instances.data[ position & ~RENDERER_PROXY_POSITION_PENDING_BIT ], transform );
+		return;
+	}
+
+	instance_data_write_transform( &table->instances.data[ position ], transform );
+	proxy_table_mark_dirty( table, position, position + 1 );
+}
+
+Renderer_Proxy * renderer_proxy_table_find( Renderer_Proxy_Table *table, Renderer_Proxy_ID proxy_id ) {
+	if ( proxy_id >= table->positions.size )
+		return NULL;
+
+	u32 position = table->positions.data[ proxy_id ];
+	if ( position == RENDERER_PROXY_POSITION_INVALID )
+		return NULL;
+
+	if ( position & RENDERER_PROXY_POSITION_PENDING_BIT )
+		return &table->pending.data[ position & ~RENDERER_PROXY_POSITION_PENDING_BIT ];
+
+	return &table->proxies.data[ position ];
+}
+
+void renderer_proxy_table_commit( Renderer_Proxy_Table *table ) {
+	u32 pending_count = table->pending.size;
+	if ( pending_count < 1 && table->stale_count < 1 )
+		return;
+
+	// 1. Sort only the pending proxies.
+	Radix_Sort_Item *sorted_pending = NULL;
+	if ( pending_count > 0 ) {
+		proxy_table_scratch_resize( &table->sort_items, pending_count );
+		proxy_table_scratch_resize( &table->sort_items_swap, pending_count );
+		ForIt( table->pending.data, pending_count ) {
+			table->sort_items.data[ it_index ] = Radix_Sort_Item { .key = it.sort_key, .index = it_index };
+		}}
+		sorted_pending = radix_sort( &table->sort_items, &table->sort_items_swap )->data;
+	}
+
+	// 2. Nothing before the first stale slot or before where the first pending proxy goes moves.
+	u32 sorted_count = table->proxies.size;
+	u32 first_changed = sorted_count;
+	if ( table->stale_count > 0 ) {
+		ForIt( table->proxies.data, sorted_count ) {
+			if ( it.id == INVALID_RENDERER_PROXY_ID ) {
+				first_changed = it_index;
+				break;
+			}
+		}}
+	}
+
+	if ( pending_count > 0 ) {
+		// Stale slots keep their keys, so binary search still works.  Equal keys go after the sorted ones.
+		u64 first_key = sorted_pending[ 0 ].key;
+		u32 low = 0;
+		u32 high = first_changed;
+		while ( low < high ) {
+			u32 middle = low + ( high - low ) / 2;
+			if ( table->proxies.data[ middle ].sort_key <= first_key )
+				low = middle + 1;
+			else
+				high = middle;
+		}
+		first_changed = low;
+	}
+
+	// 3. Merge the rest of the sorted proxies with the pending ones, dropping stale slots.
+	array_clear( &table->merged );
+	array_clear( &table->merged_instances );
+	u32 sorted_idx = first_changed;
+	u32 pending_idx = 0;
+	while ( sorted_idx < sorted_count || pending_idx < pending_count ) {
+		if ( sorted_idx < sorted_count && table->proxies.data[ sorted_idx ].id == INVALID_RENDERER_PROXY_ID ) {
+			sorted_idx += 1;
+			continue;
+		}
+
+		bool take_pending;
+		if ( pending_idx >= pending_count )
+			take_pending = false;
+		else if ( sorted_idx >= sorted_count )
+			take_pending = true;
+		else
+			take_pending = ( sorted_pending[ pending_idx ].key < table->proxies.data[ sorted_idx ].sort_key );
+
+		if ( take_pending ) {
+			u32 proxy_idx = sorted_pending[ pending_idx ].index;
+			array_add( &table->merged, table->pending.data[ proxy_idx ] );
+			array_add( &table->merged_instances, table->pending_instances.data[ proxy_idx ] );
+			pending_idx += 1;
+		} else {
+			array_add( &table->merged, table->proxies.data[ sorted_idx ] );
+			array_add( &table->merged_instances, table->instances.data[ sorted_idx ] );
+			sorted_idx += 1;
+		}
+	}
+
+	// 4. Copy the merged range back and point the IDs at their new slots.
+	table->proxies.size = first_changed;
+	table->instances.size = first_changed;
+	array_add_many( &table->proxies, array_view( &table->merged ) );
+	array_add_many( &table->instances, array_view( &table->merged_instances ) );
+	for ( u32 position = first_changed; position < table->proxies.size; position += 1 ) {
+		table->positions.data[ table->proxies.data[ position ].id ] = position;
+	}
+
+	array_clear( &table->pending );
+	array_clear( &table->pending_instances );
+	table->stale_count = 0;
+
+	u32 proxies_count = table->proxies.size;
+	table->dirty_end = QL_min2( table->dirty_end, proxies_count );
+	proxy_table_mark_dirty( table, first_changed, proxies_count );
+}
+
+void renderer_proxy_table_clear_dirty( Renderer_Proxy_Table *table ) {
+	table->dirty_begin = 0;
+	table->dirty_end = 0;
+}
+
+u32 renderer_proxy_table_build_queue( Renderer_Proxy_Table *table, ArrayView< Renderer_Proxy_ID > visible_ids, Array< Renderer_Render_Command > *out_commands ) {
+	Assert( table->pending.size == 0 && table->stale_count == 0 );
+	u32 words_count = ( table->proxies.size + 31 ) / 32;
+	proxy_table_scratch_resize( &table->visible_bits, words_count );
+	memset( table->visible_bits.data, 0, words_count * sizeof( u32 ) );
+
+	ForIt( visible_ids.data, visible_ids.size ) {
+		if ( it >= table->positions.size )
+			continue;
+
+		u32 position = table->positions.data[ it ];
+		if ( position == RENDERER_PROXY_POSITION_INVALID || ( position & RENDERER_PROXY_POSITION_PENDING_BIT ) )
+			continue;
+
+		table->visible_bits.data[ position / 32 ] |= ( 1u << ( position % 32 ) );
+	}}
+
+	// Walking the bits in order yields the visible proxies already sorted.
+	u32 commands_added = 0;
+	For( words_count ) {
+		u32 word = table->visible_bits.data[ it_index ];
+		if ( word == 0 )
+			continue;
+
+		For2( 32 ) {
+			if ( !( word & ( 1u << it2_index ) ) )
+				continue;
+
+			u32 position = it_index * 32 + it2_index;
+			Renderer_Proxy *proxy = &table->proxies.data[ position ];
+			array_add( out_commands, Renderer_Render_Command {
+				.mesh_id = proxy->mesh_id,
+				.material_id = proxy->material_id,
+				.pass = proxy->pass,
+				.instance_idx = position,
+				.sort_key = proxy->sort_key
+			} );
+			commands_added += 1;
+		}
+	}
+
+	return commands_added;
+}
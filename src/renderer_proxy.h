@@ -0,0 +1,85 @@
+#ifndef QLIGHT_RENDERER_PROXY_H
+#define QLIGHT_RENDERER_PROXY_H
+
+#include "renderer.h"
+#include "renderer_batch.h"
+#include "radix_sort.h"
+
+/*
+	Retained render proxies: what the renderer keeps of every drawable object between frames.
+
+	Proxies are kept sorted by their sort key (pass, shader program, material, mesh),
+	  so the visible ones are walked in order every frame instead of sorting a render queue.
+	Instance data is stored next to them in the same order and is only rewritten when
+	  a transform changes or when proxies move.
+
+	New and re-keyed proxies wait in `pending` until `renderer_proxy_table_commit()`,
+	  which sorts just them and merges them into the sorted ones.  Destroyed proxies
+	  stay in place until then, so only positions past the first change ever move.
+	Rewritten instance data is tracked as a single dirty range for the caller to upload.
+	Nothing here touches OpenGL.
+*/
+
+struct Renderer_Proxy {
+	u64 sort_key;
+	// `INVALID_RENDERER_PROXY_ID` once destroyed or re-keyed, the slot is dropped by the next commit.
+	Renderer_Proxy_ID id;
+	Mesh_ID mesh_id;
+	Material_ID material_id;
+	Renderer_Render_Pass pass;
+};
+
+// Set in `Renderer_Proxy_Table::positions` for proxies that are still in `pending`.
+constexpr u32 RENDERER_PROXY_POSITION_PENDING_BIT = ( 1u << 31 );
+constexpr u32 RENDERER_PROXY_POSITION_INVALID = U32_MAX;
+
+struct Renderer_Proxy_Table {
+	// Sorted by `sort_key`, `instances` is in the same order.
+	Array< Renderer_Proxy > proxies;
+	Array< Renderer_Instance_Data > instances;
+	u32 stale_count;  // Slots of `proxies` with an invalid ID.
+
+	// Created or re-keyed since the last commit, in no particular order.
+	Array< Renderer_Proxy > pending;
+	Array< Renderer_Instance_Data > pending_instances;
+
+	// Proxy ID -> index into `proxies`, or into `pending` with `RENDERER_PROXY_POSITION_PENDING_BIT`.
+	Array< u32 > positions;
+	Array< Renderer_Proxy_ID > free_ids;
+
+	// Range of `instances` rewritten since the last `renderer_proxy_table_clear_dirty()`.
+	u32 dirty_begin;
+	u32 dirty_end;
+
+	// One bit per slot of `proxies`, only set during `renderer_proxy_table_build_queue()`.
+	Array< u32 > visible_bits;
+
+	// Scratch for commits, kept around between them.
+	Array< Radix_Sort_Item > sort_items;
+	Array< Radix_Sort_Item > sort_items_swap;
+	Array< Renderer_Proxy > merged;
+	Array< Renderer_Instance_Data > merged_instances;
+};
+
+void renderer_proxy_table_init( Renderer_Proxy_Table *table, Allocator *allocator, u32 initial_capacity );
+void renderer_proxy_table_destroy( Renderer_Proxy_Table *table );
+
+// The proxy is drawn with identity transform until `renderer_proxy_table_set_transform()`.
+Renderer_Proxy_ID renderer_proxy_table_add( Renderer_Proxy_Table *table, u64 sort_key, Mesh_ID mesh_id, Material_ID material_id, Renderer_Render_Pass pass );
+void renderer_proxy_table_remove( Renderer_Proxy_Table *table, Renderer_Proxy_ID proxy_id );
+// Moves the proxy to `pending` if the key changed.  Returns false if nothing changed.
+bool renderer_proxy_table_set_key( Renderer_Proxy_Table *table, Renderer_Proxy_ID proxy_id, u64 sort_key, Mesh_ID mesh_id, Material_ID material_id );
+// Copies the transform's matrices, which must be up to date.
+void renderer_proxy_table_set_transform( Renderer_Proxy_Table *table, Renderer_Proxy_ID proxy_id, Transform *transform );
+Renderer_Proxy * renderer_proxy_table_find( Renderer_Proxy_Table *table, Renderer_Proxy_ID proxy_id );
+
+// Merges `pending` into the sorted proxies and drops destroyed ones.
+// Everything from the first slot that moved to the end becomes dirty.
+void renderer_proxy_table_commit( Renderer_Proxy_Table *table );
+void renderer_proxy_table_clear_dirty( Renderer_Proxy_Table *table );
+
+// Appends a command for every proxy of `visible_ids` in the sorted order, skipping duplicates and destroyed ones.
+// `instance_idx` of the commands is the proxy's slot in `instances`.  Call it only right after a commit.
+u32 renderer_proxy_table_build_queue( Renderer_Proxy_Table *table, ArrayView< Renderer_Proxy_ID > visible_ids, Array< Renderer_Render_Command > *out_commands );
+
+#endif /* QLIGHT_RENDERER_PROXY_H */
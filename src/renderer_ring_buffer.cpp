@@ -0,0 +1,137 @@
+#include "renderer_ring_buffer.h"
+
+#define QL_LOG_CHANNEL "Renderer"
+#include "log.h"
+
+// How long to wait for a fence before waiting again, in nanoseconds.
+constexpr GLuint64 RENDERER_RING_BUFFER_FENCE_TIMEOUT = 1000000;
+
+static u32 align_up( u32 value, u32 alignment ) {
+	return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+bool renderer_ring_buffer_create( Renderer_Ring_Buffer *ring, StringView_ASCII name, u32 frame_size, u32 alignment ) {
+	Assert( alignment > 0 );
+	frame_size = align_up( frame_size, alignment );
+
+	Renderer_GL_Buffer_Storage_Bits storage_bits = renderer_gl_buffer_storage_bits(
+		RendererGLBufferStorageBit_Write |
+		RendererGLBufferStorageBit_Persistent |
+		RendererGLBufferStorageBit_Coherent
+	);
+
+	u32 size = frame_size * RENDERER_FRAMES_IN_FLIGHT;
+	Renderer_Uniform_Buffer *uniform_buffer = renderer_uniform_buffer_create(
+		/*         name */ name,
+		/*         size */ size,
+		/* storage_bits */ storage_bits
+	);
+
+	Renderer_GL_Map_Access_Bits access_bits = renderer_gl_buffer_storage_bits_to_map_access_bits( storage_bits );
+	void *mapped = renderer_uniform_buffer_memory_map(
+		/* uniform_buffer */ uniform_buffer,
+		/*    access_bits */ access_bits,
+		/*           size */ size,
+		/*         offset */ 0
+	);
+
+	if ( !mapped ) {
+		log_error( "Failed to map Ring Buffer '" StringViewFormat "' (%u bytes).", StringViewArgument( name ), size );
+		return false;
+	}
+
+	*ring = Renderer_Ring_Buffer {
+		.uniform_buffer = uniform_buffer,
+		.opengl_buffer = uniform_buffer->opengl_ubo,
+		.mapped = ( u8 * )mapped,
+		.frame_size = frame_size,
+		.alignment = alignment,
+		.frame_idx = 0,
+		.frame_used = 0,
+		.frame_peak = 0,
+		.stalls = 0,
+		.overflows = 0
+	};
+
+	For( RENDERER_FRAMES_IN_FLIGHT ) {
+		ring->fences[ it_index ] = NULL;
+	}
+
+	log_debug( "Created Ring Buffer '" StringViewFormat "' (%u frames x %u bytes, alignment: %u).",
+		StringViewArgument( name ),
+		RENDERER_FRAMES_IN_FLIGHT,
+		frame_size,
+		alignment
+	);
+	return true;
+}
+
+void renderer_ring_buffer_destroy( Renderer_Ring_Buffer *ring ) {
+	For( RENDERER_FRAMES_IN_FLIGHT ) {
+		if ( ring->fences[ it_index ] ) {
+			glDeleteSync( ring->fences[ it_index ] );
+			ring->fences[ it_index ] = NULL;
+		}
+	}
+
+	Renderer_GL_Map_Access_Bits access_bits = renderer_gl_buffer_storage_bits_to_map_access_bits( ring->uniform_buffer->storage_bits );
+	renderer_uniform_buffer_memory_unmap( ring->uniform_buffer, access_bits, ring->uniform_buffer->size, 0 );
+	renderer_uniform_buffer_destroy( ring->uniform_buffer );
+	ring->uniform_buffer = NULL;
+	ring->mapped = NULL;
+}
+
+Renderer_Frame_Allocation renderer_ring_buffer_allocate( Renderer_Ring_Buffer *ring, u32 size ) {
+	Renderer_Frame_Allocation allocation = { 0 };
+	u32 aligned_size = align_up( size, ring->alignment );
+	if ( size < 1 || aligned_size > ring->frame_size - ring->frame_used ) {
+		// Once full, a region stays full for the rest of the frame, and so would the log every frame after.
+		if ( ring->overflows == 0 ) {
+			log_error( "Ring Buffer '" StringViewFormat "' is out of space: %u bytes requested, %u of %u used.  Further overflows are only counted.",
+				StringViewArgument( ring->uniform_buffer->name ),
+				size,
+				ring->frame_used,
+				ring->frame_size
+			);
+		}
+		ring->overflows += 1;
+		return allocation;
+	}
+
+	u32 offset = ring->frame_idx * ring->frame_size + ring->frame_used;
+	ring->frame_used += aligned_size;
+
+	allocation.data = ring->mapped + offset;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.opengl_buffer = ring->opengl_buffer;
+	return allocation;
+}
+
+void renderer_ring_buffer_frame_end( Renderer_Ring_Buffer *ring ) {
+	Assert( ring->fences[ ring->frame_idx ] == NULL );
+	ring->fences[ ring->frame_idx ] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+
+	if ( ring->frame_used > ring->frame_peak )
+		ring->frame_peak = ring->frame_used;
+
+	ring->frame_idx = ( ring->frame_idx + 1 ) % RENDERER_FRAMES_IN_FLIGHT;
+	ring->frame_used = 0;
+
+	GLsync fence = ring->fences[ ring->frame_idx ];
+	if ( !fence )
+		return;
+
+	// Poll first, so the common case (GPU is done) costs nothing.
+	GLenum wait_result = glClientWaitSync( fence, 0, 0 );
+	if ( wait_result == GL_TIMEOUT_EXPIRED ) {
+		ring->stalls += 1;
+		do {
+			wait_result = glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, RENDERER_RING_BUFFER_FENCE_TIMEOUT );
+		} while ( wait_result == GL_TIMEOUT_EXPIRED );
+	}
+
+	Assert( wait_result != GL_WAIT_FAILED );
+	glDeleteSync( fence );
+	ring->fences[ ring->frame_idx ] = NULL;
+}
@@ -0,0 +1,44 @@
+#ifndef QLIGHT_RENDERER_RING_BUFFER_H
+#define QLIGHT_RENDERER_RING_BUFFER_H
+
+#include "renderer.h"
+
+/*
+	Persistently mapped buffer for data that is rewritten every frame.
+
+	The buffer is split into `RENDERER_FRAMES_IN_FLIGHT` regions, one per frame.
+	The CPU writes into the current region while the GPU may still be reading
+	  the previous ones.  Each region is guarded by a fence placed after the last
+	  command of its frame, and the CPU waits on it before reusing the region.
+*/
+
+constexpr u32 RENDERER_FRAMES_IN_FLIGHT = 3;
+
+struct Renderer_Ring_Buffer {
+	Renderer_Uniform_Buffer *uniform_buffer;
+	GLuint opengl_buffer;
+	u8 *mapped;  // Whole buffer, mapped once for the buffer's lifetime.
+	u32 frame_size;
+	u32 alignment;
+
+	u32 frame_idx;   // Region that is written to right now.
+	u32 frame_used;  // Bytes taken from the current region.
+	u32 frame_peak;  // Most bytes taken by a single frame so far.
+	u32 stalls;      // Times the CPU had to wait for the GPU to release a region.
+	u32 overflows;   // Allocations that did not fit into their region, only the first one is logged.
+
+	GLsync fences[ RENDERER_FRAMES_IN_FLIGHT ];
+};
+
+bool renderer_ring_buffer_create( Renderer_Ring_Buffer *ring, StringView_ASCII name, u32 frame_size, u32 alignment );
+void renderer_ring_buffer_destroy( Renderer_Ring_Buffer *ring );
+
+// Returns `size` bytes from the current frame's region, aligned to `ring->alignment`.
+// Returned allocation has `data == NULL` if the region is full.
+Renderer_Frame_Allocation renderer_ring_buffer_allocate( Renderer_Ring_Buffer *ring, u32 size );
+
+// Fences the current region and moves to the next one, waiting for the GPU if it still reads from it.
+// Has to be called after the last command that reads this frame's allocations.
+void renderer_ring_buffer_frame_end( Renderer_Ring_Buffer *ring );
+
+#endif /* QLIGHT_RENDERER_RING_BUFFER_H */
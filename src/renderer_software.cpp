@@ -0,0 +1,1328 @@
+#include <emmintrin.h>
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+
+#include "renderer_software.h"
+#include "jobs.h"
+#include "map.h"
+
+#define QL_LOG_CHANNEL "Renderer"
+#include "log.h"
+
+constexpr u32 RENDERER_SOFTWARE_NO_TRIANGLE = U32_MAX;
+// A triangle ID is the index of its setup job above these bits and its index in the job's triangles in them.
+constexpr u32 RENDERER_SOFTWARE_TRIANGLE_INDEX_BITS = 26;
+constexpr u32 RENDERER_SOFTWARE_TRIANGLE_INDEX_MASK = ( 1u << RENDERER_SOFTWARE_TRIANGLE_INDEX_BITS ) - 1;
+static_assert( RENDERER_SOFTWARE_MAX_SETUP_JOBS <= ( 1u << ( 31 - RENDERER_SOFTWARE_TRIANGLE_INDEX_BITS ) ), "Triangle IDs must never be RENDERER_SOFTWARE_NO_TRIANGLE" );
+
+// Triangles of a setup job, at least, so small frames are not spread thin.
+constexpr u32 RENDERER_SOFTWARE_MIN_SETUP_JOB_TRIANGLES = 1024;
+constexpr u32 RENDERER_SOFTWARE_INITIAL_TRIANGLES_CAPACITY = 1024;
+constexpr u32 RENDERER_SOFTWARE_INITIAL_TILE_BIN_CAPACITY = 16;
+constexpr u8 RENDERER_SOFTWARE_NO_CHANNEL = U8_MAX;
+
+// Stands in for a texture when not even the fallback can be sampled.
+static const u8 g_software_white_texel[ 3 ] = { 255, 255, 255 };
+
+// Clip-space position and the attributes, interpolated together when a triangle is clipped.
+struct Renderer_Software_Clip_Vertex {
+	Vector4_f32 clip;
+	Renderer_Software_Vertex attributes;
+};
+
+struct Renderer_Software_Screen_Vertex {
+	f32 x;
+	f32 y;
+	f32 depth;
+	f32 one_over_w;
+};
+
+// The frame's storage buffers the lighting reads, checked against their sizes.
+struct Renderer_Software_Lights {
+	const Shader_Storage_Light *lights;
+	u32 directional_count;
+	u32 lights_count;  // Directional and positional.
+	const Shader_Storage_Light_Clusters_Header *clusters_header;
+	const Light_Cluster *clusters;
+	u32 clusters_count;
+	const u32 *indices;
+	u32 indices_count;
+};
+
+struct Renderer_Software_Vector3_x4 {
+	__m128 x;
+	__m128 y;
+	__m128 z;
+};
+
+// What lighting needs of 4 pixels, see `ShadeLight()` in `phong_fragment.glsl`.
+struct Renderer_Software_Surface_x4 {
+	__m128 position_x, position_y, position_z;
+	Renderer_Software_Vector3_x4 N;
+	Renderer_Software_Vector3_x4 V;
+	Renderer_Software_Vector3_x4 V_projected;  // On the surface's plane, normalized.
+	__m128 N_dot_V;
+	__m128 diffuse_r, diffuse_g, diffuse_b;
+	__m128 specular;
+	__m128 shininess;
+	// Oren-Nayar's A and B, they depend on the roughness only.
+	__m128 oren_nayar_a;
+	__m128 oren_nayar_b;
+};
+
+/* Scalar math */
+
+static inline f32
+software_dot3( Vector3_f32 a, Vector3_f32 b ) {
+	return a.x * b.x  +  a.y * b.y  +  a.z * b.z;
+}
+
+static inline Vector3_f32
+software_normalize3( Vector3_f32 v ) {
+	f32 length_squared = software_dot3( v, v );
+	if ( length_squared <= 1e-20f )
+		return v;
+
+	f32 one_over_length = 1.0f / sqrtf( length_squared );
+	return Vector3_f32 { v.x * one_over_length, v.y * one_over_length, v.z * one_over_length };
+}
+
+static inline Vector3_f32
+software_cross3( Vector3_f32 a, Vector3_f32 b ) {
+	return Vector3_f32 {
+		a.y * b.z  -  a.z * b.y,
+		a.z * b.x  -  a.x * b.z,
+		a.x * b.y  -  a.y * b.x
+	};
+}
+
+static inline Vector4_f32
+software_transform( const Matrix4x4_f32 *matrix, Vector3_f32 point, f32 w ) {
+	const Vector4_f32 *m = matrix->columns;
+	return Vector4_f32 {
+		m[ 0 ].x * point.x  +  m[ 1 ].x * point.y  +  m[ 2 ].x * point.z  +  m[ 3 ].x * w,
+		m[ 0 ].y * point.x  +  m[ 1 ].y * point.y  +  m[ 2 ].y * point.z  +  m[ 3 ].y * w,
+		m[ 0 ].z * point.x  +  m[ 1 ].z * point.y  +  m[ 2 ].z * point.z  +  m[ 3 ].z * w,
+		m[ 0 ].w * point.x  +  m[ 1 ].w * point.y  +  m[ 2 ].w * point.z  +  m[ 3 ].w * w
+	};
+}
+
+static inline Vector3_f32
+software_transform_normal( const Vector4_f32 normal_matrix[ 3 ], Vector3_f32 v ) {
+	return Vector3_f32 {
+		normal_matrix[ 0 ].x * v.x  +  normal_matrix[ 1 ].x * v.y  +  normal_matrix[ 2 ].x * v.z,
+		normal_matrix[ 0 ].y * v.x  +  normal_matrix[ 1 ].y * v.y  +  normal_matrix[ 2 ].y * v.z,
+		normal_matrix[ 0 ].z * v.x  +  normal_matrix[ 1 ].z * v.y  +  normal_matrix[ 2 ].z * v.z
+	};
+}
+
+static f32
+software_srgb_to_linear( f32 srgb ) {
+	return ( srgb < 0.04045f ) ? srgb / 12.92f : powf( ( srgb + 0.055f ) / 1.055f, 2.4f );
+}
+
+/* SSE math */
+
+static inline __m128
+software_dot3_x4( Renderer_Software_Vector3_x4 a, Renderer_Software_Vector3_x4 b ) {
+	return _mm_add_ps( _mm_add_ps( _mm_mul_ps( a.x, b.x ), _mm_mul_ps( a.y, b.y ) ), _mm_mul_ps( a.z, b.z ) );
+}
+
+// Vectors of zero length are left as they are, where GLSL's `normalize()` would give NaNs.
+static inline Renderer_Software_Vector3_x4
+software_normalize3_x4( Renderer_Software_Vector3_x4 v ) {
+	__m128 length = _mm_sqrt_ps( _mm_max_ps( software_dot3_x4( v, v ), _mm_set1_ps( 1e-20f ) ) );
+	__m128 one_over_length = _mm_div_ps( _mm_set1_ps( 1.0f ), length );
+	return Renderer_Software_Vector3_x4 { _mm_mul_ps( v.x, one_over_length ), _mm_mul_ps( v.y, one_over_length ), _mm_mul_ps( v.z, one_over_length ) };
+}
+
+// `a - b * s`
+static inline Renderer_Software_Vector3_x4
+software_subtract_scaled3_x4( Renderer_Software_Vector3_x4 a, Renderer_Software_Vector3_x4 b, __m128 s ) {
+	return Renderer_Software_Vector3_x4 { _mm_sub_ps( a.x, _mm_mul_ps( b.x, s ) ), _mm_sub_ps( a.y, _mm_mul_ps( b.y, s ) ), _mm_sub_ps( a.z, _mm_mul_ps( b.z, s ) ) };
+}
+
+// `2^x` with a degree 5 polynomial for the fraction, relative error below 1e-6.
+static inline __m128
+software_exp2_x4( __m128 x ) {
+	x = _mm_min_ps( _mm_max_ps( x, _mm_set1_ps( -126.0f ) ), _mm_set1_ps( 127.99f ) );
+	__m128i integer = _mm_cvttps_epi32( x );
+	__m128 integer_f = _mm_cvtepi32_ps( integer );
+	// Truncation rounds negative values up, take one off to floor them.
+	__m128 rounded_up = _mm_cmpgt_ps( integer_f, x );
+	integer = _mm_add_epi32( integer, _mm_castps_si128( rounded_up ) );
+	integer_f = _mm_sub_ps( integer_f, _mm_and_ps( rounded_up, _mm_set1_ps( 1.0f ) ) );
+	__m128 fraction = _mm_sub_ps( x, integer_f );
+
+	__m128 p = _mm_set1_ps( 1.8775767e-3f );
+	p = _mm_add_ps( _mm_mul_ps( p, fraction ), _mm_set1_ps( 8.9893397e-3f ) );
+	p = _mm_add_ps( _mm_mul_ps( p, fraction ), _mm_set1_ps( 5.5826318e-2f ) );
+	p = _mm_add_ps( _mm_mul_ps( p, fraction ), _mm_set1_ps( 2.4015361e-1f ) );
+	p = _mm_add_ps( _mm_mul_ps( p, fraction ), _mm_set1_ps( 6.9315308e-1f ) );
+	p = _mm_add_ps( _mm_mul_ps( p, fraction ), _mm_set1_ps( 9.9999994e-1f ) );
+
+	__m128 scale = _mm_castsi128_ps( _mm_slli_epi32( _mm_add_epi32( integer, _mm_set1_epi32( 127 ) ), 23 ) );
+	return _mm_mul_ps( p, scale );
+}
+
+// `log2( x )` for positive `x`, with a degree 5 polynomial for the mantissa.
+static inline __m128
+software_log2_x4( __m128 x ) {
+	__m128i bits = _mm_castps_si128( x );
+	__m128 exponent = _mm_cvtepi32_ps( _mm_sub_epi32( _mm_srli_epi32( bits, 23 ), _mm_set1_epi32( 127 ) ) );
+	// In [ 1, 2 ).
+	__m128 mantissa = _mm_or_ps( _mm_castsi128_ps( _mm_and_si128( bits, _mm_set1_epi32( 0x007FFFFF ) ) ), _mm_set1_ps( 1.0f ) );
+
+	__m128 p = _mm_set1_ps( 0.0596515482674574969533f );
+	p = _mm_add_ps( _mm_mul_ps( p, mantissa ), _mm_set1_ps( -0.465725644288844778798f ) );
+	p = _mm_add_ps( _mm_mul_ps( p, mantissa ), _mm_set1_ps( 1.48116647521213171641f ) );
+	p = _mm_add_ps( _mm_mul_ps( p, mantissa ), _mm_set1_ps( -2.52074962577807006663f ) );
+	p = _mm_add_ps( _mm_mul_ps( p, mantissa ), _mm_set1_ps( 2.8882704548164776201f ) );
+	p = _mm_mul_ps( p, _mm_sub_ps( mantissa, _mm_set1_ps( 1.0f ) ) );
+	return _mm_add_ps( p, exponent );
+}
+
+// `pow( x, y )` for `x >= 0`, 0 is raised as the smallest normal float.
+static inline __m128
+software_pow_x4( __m128 x, __m128 y ) {
+	__m128 positive = _mm_max_ps( x, _mm_set1_ps( 1.17549435e-38f ) );
+	return software_exp2_x4( _mm_mul_ps( y, software_log2_x4( positive ) ) );
+}
+
+static inline __m128
+software_select_x4( __m128 mask, __m128 if_set, __m128 if_clear ) {
+	return _mm_or_ps( _mm_and_ps( mask, if_set ), _mm_andnot_ps( mask, if_clear ) );
+}
+
+// `LinearToSRGB()` of `phong_fragment.glsl`, clamped to [ 0, 1 ] as the framebuffer would.
+static inline __m128
+software_linear_to_srgb_x4( __m128 linear ) {
+	linear = _mm_min_ps( _mm_max_ps( linear, _mm_setzero_ps() ), _mm_set1_ps( 1.0f ) );
+	__m128 low = _mm_mul_ps( linear, _mm_set1_ps( 12.92f ) );
+	__m128 high = _mm_sub_ps( _mm_mul_ps( _mm_set1_ps( 1.055f ), software_pow_x4( linear, _mm_set1_ps( 1.0f / 2.4f ) ) ), _mm_set1_ps( 0.055f ) );
+	__m128 cutoff = _mm_cmpge_ps( linear, _mm_set1_ps( 0.0031308f ) );
+	return _mm_min_ps( _mm_max_ps( software_select_x4( cutoff, high, low ), _mm_setzero_ps() ), _mm_set1_ps( 1.0f ) );
+}
+
+// Packs [ 0, 1 ] channels into RGBA8 pixels with full alpha.
+static inline __m128i
+software_pack_rgba8_x4( __m128 r, __m128 g, __m128 b ) {
+	__m128 scale = _mm_set1_ps( 255.0f );
+	__m128 half = _mm_set1_ps( 0.5f );
+	__m128i r8 = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( r, scale ), half ) );
+	__m128i g8 = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( g, scale ), half ) );
+	__m128i b8 = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( b, scale ), half ) );
+	__m128i rgba = _mm_or_si128( r8, _mm_or_si128( _mm_slli_epi32( g8, 8 ), _mm_slli_epi32( b8, 16 ) ) );
+	return _mm_or_si128( rgba, _mm_set1_epi32( ( int )0xFF000000 ) );
+}
+
+/* Textures */
+
+static Renderer_Software_Texture
+software_white_texture() {
+	Renderer_Software_Texture texture = {
+		.bytes = g_software_white_texel,
+		.width = 1,
+		.height = 1,
+		.texel_size = 3,
+		.channel_offsets = { 0, 1, 2 },
+		.srgb = false
+	};
+	return texture;
+}
+
+// False if the texture does not exist or its texels are not 8-bit.
+static bool
+software_texture_view( Texture_ID texture_id, Renderer_Software_Texture *out_texture ) {
+	// Materials without a map have no texture, `texture_instance()` does not check.
+	if ( texture_id == INVALID_TEXTURE_ID )
+		return false;
+
+	Texture *texture = texture_instance( texture_id );
+	if ( !texture || !texture->bytes.data || texture->opengl_pixel_type != GL_UNSIGNED_BYTE )
+		return false;
+
+	Renderer_Software_Texture view = {
+		.bytes = texture->bytes.data,
+		.width = texture->dimensions.width,
+		.height = texture->dimensions.height,
+		.texel_size = texture_channels_count( texture->channels ),
+		.channel_offsets = { RENDERER_SOFTWARE_NO_CHANNEL, RENDERER_SOFTWARE_NO_CHANNEL, RENDERER_SOFTWARE_NO_CHANNEL },
+		.srgb = ( texture->opengl_storage_format == GL_SRGB8 || texture->opengl_storage_format == GL_SRGB8_ALPHA8 )
+	};
+	switch ( texture->channels ) {
+		case TextureChannels_RGB:
+		case TextureChannels_RGBA:
+			view.channel_offsets[ 2 ] = 2;
+			// Fallthrough
+		case TextureChannels_RG:
+			view.channel_offsets[ 1 ] = 1;
+			// Fallthrough
+		case TextureChannels_Red:
+			view.channel_offsets[ 0 ] = 0;
+			break;
+
+		case TextureChannels_BGR:
+		case TextureChannels_BGRA:
+			view.channel_offsets[ 0 ] = 2;
+			view.channel_offsets[ 1 ] = 1;
+			view.channel_offsets[ 2 ] = 0;
+			break;
+
+		default:
+			return false;
+	}
+
+	u64 texels_size = ( u64 )view.width * view.height * view.texel_size;
+	if ( view.width == 0 || view.height == 0 || texels_size > texture->bytes.size )
+		return false;
+
+	*out_texture = view;
+	return true;
+}
+
+static Renderer_Software_Texture
+software_texture_view_or( Texture_ID texture_id, Renderer_Software_Texture fallback ) {
+	Renderer_Software_Texture view;
+	return ( software_texture_view( texture_id, &view ) ) ? view : fallback;
+}
+
+static inline f32
+software_texel_channel( Renderer_Software *software, const Renderer_Software_Texture *texture, const u8 *texel, u32 channel_idx ) {
+	u8 offset = texture->channel_offsets[ channel_idx ];
+	if ( offset == RENDERER_SOFTWARE_NO_CHANNEL )
+		return 0.0f;
+
+	return ( texture->srgb ) ? software->srgb_to_linear[ texel[ offset ] ] : ( f32 )texel[ offset ] * ( 1.0f / 255.0f );
+}
+
+// Bilinear filtering with repeat wrapping, what the texture arrays' samplers do at the top mipmap level.
+static void
+software_texture_sample( Renderer_Software *software, const Renderer_Software_Texture *texture, Vector2_f32 uv, f32 out_rgb[ 3 ] ) {
+	f32 x = uv.x * ( f32 )texture->width - 0.5f;
+	f32 y = uv.y * ( f32 )texture->height - 0.5f;
+	// Also catches NaNs.
+	if ( !( fabsf( x ) < 1e9f ) )  x = 0.0f;
+	if ( !( fabsf( y ) < 1e9f ) )  y = 0.0f;
+
+	f32 floor_x = floorf( x );
+	f32 floor_y = floorf( y );
+	f32 fraction_x = x - floor_x;
+	f32 fraction_y = y - floor_y;
+	s64 x0 = ( s64 )floor_x % ( s64 )texture->width;
+	s64 y0 = ( s64 )floor_y % ( s64 )texture->height;
+	if ( x0 < 0 )  x0 += texture->width;
+	if ( y0 < 0 )  y0 += texture->height;
+	s64 x1 = ( x0 + 1 < ( s64 )texture->width ) ? x0 + 1 : 0;
+	s64 y1 = ( y0 + 1 < ( s64 )texture->height ) ? y0 + 1 : 0;
+
+	u64 row_size = ( u64 )texture->width * texture->texel_size;
+	const u8 *texel00 = &texture->bytes[ ( u64 )y0 * row_size + ( u64 )x0 * texture->texel_size ];
+	const u8 *texel10 = &texture->bytes[ ( u64 )y0 * row_size + ( u64 )x1 * texture->texel_size ];
+	const u8 *texel01 = &texture->bytes[ ( u64 )y1 * row_size + ( u64 )x0 * texture->texel_size ];
+	const u8 *texel11 = &texture->bytes[ ( u64 )y1 * row_size + ( u64 )x1 * texture->texel_size ];
+	for ( u32 channel_idx = 0; channel_idx < 3; channel_idx += 1 ) {
+		f32 c00 = software_texel_channel( software, texture, texel00, channel_idx );
+		f32 c10 = software_texel_channel( software, texture, texel10, channel_idx );
+		f32 c01 = software_texel_channel( software, texture, texel01, channel_idx );
+		f32 c11 = software_texel_channel( software, texture, texel11, channel_idx );
+		f32 top = c00 + ( c10 - c00 ) * fraction_x;
+		f32 bottom = c01 + ( c11 - c01 ) * fraction_x;
+		out_rgb[ channel_idx ] = top + ( bottom - top ) * fraction_y;
+	}
+}
+
+/* Frame setup */
+
+void
+renderer_software_init( Renderer_Software *software, Allocator *allocator ) {
+	*software = Renderer_Software {};
+	software->allocator = allocator;
+	software->instances = array_new< Renderer_Instance_Data >( allocator, 0 );
+	software->draws = array_new< Renderer_Software_Draw >( allocator, 64 );
+	software->materials = array_new< Renderer_Software_Material_View >( allocator, 64 );
+	ForIt( software->setup_jobs, RENDERER_SOFTWARE_MAX_SETUP_JOBS ) {
+		it.triangles = array_new< Renderer_Software_Triangle >( allocator, RENDERER_SOFTWARE_INITIAL_TRIANGLES_CAPACITY );
+		it.attributes = array_new< Renderer_Software_Triangle_Attributes >( allocator, RENDERER_SOFTWARE_INITIAL_TRIANGLES_CAPACITY );
+		it.tile_bins = NULL;
+	}}
+	software->setup_jobs_count = 0;
+	software->frame = NULL;
+	software->stats = Renderer_Software_Stats { 0 };
+
+	For( 256 ) {
+		software->srgb_to_linear[ it_index ] = software_srgb_to_linear( ( f32 )it_index / 255.0f );
+	}
+}
+
+static void
+software_free_buffers( Renderer_Software *software ) {
+	array_free( &software->depth );
+	array_free( &software->visibility );
+	array_free( &software->gbuffer );
+	array_free( &software->color );
+	u32 tiles_count = software->tiles_x * software->tiles_y;
+	ForIt( software->setup_jobs, RENDERER_SOFTWARE_MAX_SETUP_JOBS ) {
+		if ( !it.tile_bins )
+			continue;
+
+		For2( tiles_count ) {
+			array_free( &it.tile_bins[ it2_index ] );
+		}
+		Deallocate( software->allocator, it.tile_bins );
+		it.tile_bins = NULL;
+	}}
+	software->has_frame = false;
+}
+
+void
+renderer_software_destroy( Renderer_Software *software ) {
+	software_free_buffers( software );
+	array_free( &software->instances );
+	array_free( &software->draws );
+	array_free( &software->materials );
+	ForIt( software->setup_jobs, RENDERER_SOFTWARE_MAX_SETUP_JOBS ) {
+		array_free( &it.triangles );
+		array_free( &it.attributes );
+	}}
+}
+
+static void
+software_resize( Renderer_Software *software, u32 width, u32 height ) {
+	if ( software->width == width && software->height == height && software->color.data )
+		return;
+
+	software_free_buffers( software );
+	software->width = width;
+	software->height = height;
+	software->stride = ( width + 3 ) & ~3u;
+	software->tiles_x = ( width + RENDERER_SOFTWARE_TILE_SIZE - 1 ) / RENDERER_SOFTWARE_TILE_SIZE;
+	software->tiles_y = ( height + RENDERER_SOFTWARE_TILE_SIZE - 1 ) / RENDERER_SOFTWARE_TILE_SIZE;
+	if ( width == 0 || height == 0 )
+		return;
+
+	u32 pixels_count = software->stride * height;
+	software->depth = array_new< f32 >( software->allocator, pixels_count );
+	software->visibility = array_new< u32 >( software->allocator, pixels_count );
+	software->gbuffer = array_new< f32 >( software->allocator, pixels_count * RendererSoftwarePlane_COUNT );
+	software->color = array_new< u32 >( software->allocator, pixels_count );
+	software->depth.size = pixels_count;
+	software->visibility.size = pixels_count;
+	software->gbuffer.size = pixels_count * RendererSoftwarePlane_COUNT;
+	software->color.size = pixels_count;
+
+	u32 tiles_count = software->tiles_x * software->tiles_y;
+	ForIt( software->setup_jobs, RENDERER_SOFTWARE_MAX_SETUP_JOBS ) {
+		it.tile_bins = Allocate( software->allocator, tiles_count, Array< u32 > );
+		For2( tiles_count ) {
+			it.tile_bins[ it2_index ] = array_new< u32 >( software->allocator, RENDERER_SOFTWARE_INITIAL_TILE_BIN_CAPACITY );
+		}
+	}}
+	log_debug( "Software rasterizer buffers are %ux%u now (%ux%u tiles).", width, height, software->tiles_x, software->tiles_y );
+}
+
+void
+renderer_software_update_instances( Renderer_Software *software, u32 capacity, u32 first_instance, ArrayView< Renderer_Instance_Data > instances ) {
+	if ( software->instances.size != capacity ) {
+		array_free( &software->instances );
+		software->instances = array_new< Renderer_Instance_Data >( software->allocator, capacity );
+		software->instances.size = capacity;
+	}
+
+	if ( instances.size == 0 || first_instance >= capacity )
+		return;
+
+	u32 count = QL_min2( instances.size, capacity - first_instance );
+	memcpy( &software->instances.data[ first_instance ], instances.data, count * sizeof( Renderer_Instance_Data ) );
+}
+
+static void
+software_build_materials( Renderer_Software *software ) {
+	Renderer_Software_Frame *frame = software->frame;
+	Renderer_Software_Texture fallback_diffuse = software_texture_view_or( frame->fallback_diffuse, software_white_texture() );
+	Renderer_Software_Texture fallback_white = software_texture_view_or( frame->fallback_white, software_white_texture() );
+
+	array_clear( &software->materials );
+	ForIt( frame->materials.data, frame->materials.size ) {
+		Renderer_Software_Material_View view = {
+			.diffuse = software_texture_view_or( it.diffuse, fallback_diffuse ),
+			.normal_map = software_texture_view_or( it.normal_map, fallback_white ),
+			.specular_map = software_texture_view_or( it.specular_map, fallback_white ),
+			.shininess_exponent = it.shininess_exponent
+		};
+		array_add( &software->materials, view );
+	}}
+
+	// Never empty, same as the materials the OpenGL backend binds.
+	if ( software->materials.size == 0 ) {
+		Renderer_Software_Material_View view = {
+			.diffuse = fallback_diffuse,
+			.normal_map = fallback_white,
+			.specular_map = fallback_white,
+			.shininess_exponent = 0.0f
+		};
+		array_add( &software->materials, view );
+	}
+}
+
+// Resolves the render queue into draws, returns the number of the frame's triangles.
+static u32
+software_build_draws( Renderer_Software *software ) {
+	array_clear( &software->draws );
+	Renderer_Software_Frame *frame = software->frame;
+	u32 triangles_count = 0;
+	ForIt( frame->render_queue.data, frame->render_queue.size ) {
+		Mesh *mesh = mesh_instance( it.mesh_id );
+		if ( !mesh || !mesh_is_uploaded( mesh ) || it.instance_idx >= software->instances.size )
+			continue;
+		if ( mesh->vertices.item_size != sizeof( Vertex_3D ) || ( mesh->indices.item_size != sizeof( u16 ) && mesh->indices.item_size != sizeof( u32 ) ) )
+			continue;
+
+		u32 mesh_triangles = mesh->indices.size / 3;
+		if ( mesh_triangles == 0 )
+			continue;
+
+		Renderer_Instance_Data *instance = &software->instances.data[ it.instance_idx ];
+		Renderer_Software_Draw draw = {
+			.vertices = ( const Vertex_3D * )mesh->vertices.data,
+			.indices = mesh->indices.data,
+			.index_size = mesh->indices.item_size,
+			.vertices_count = mesh->vertices.size,
+			.first_triangle = triangles_count,
+			.triangles_count = mesh_triangles,
+			.model = instance->model_matrix,
+			.normal_matrix = { instance->normal_matrix[ 0 ], instance->normal_matrix[ 1 ], instance->normal_matrix[ 2 ] },
+			.material_id = instance->material_id
+		};
+		array_add( &software->draws, draw );
+		triangles_count += mesh_triangles;
+	}}
+	return triangles_count;
+}
+
+/* Triangle setup */
+
+static Renderer_Software_Clip_Vertex
+software_clip_vertex_lerp( Renderer_Software_Clip_Vertex *a, Renderer_Software_Clip_Vertex *b, f32 t ) {
+	Renderer_Software_Clip_Vertex result;
+	f32 *values = ( f32 * )&result.attributes;
+	const f32 *a_values = ( const f32 * )&a->attributes;
+	const f32 *b_values = ( const f32 * )&b->attributes;
+	For( sizeof( Renderer_Software_Vertex ) / sizeof( f32 ) ) {
+		values[ it_index ] = a_values[ it_index ]  +  ( b_values[ it_index ] - a_values[ it_index ] ) * t;
+	}
+	result.clip = Vector4_f32 {
+		a->clip.x + ( b->clip.x - a->clip.x ) * t,
+		a->clip.y + ( b->clip.y - a->clip.y ) * t,
+		a->clip.z + ( b->clip.z - a->clip.z ) * t,
+		a->clip.w + ( b->clip.w - a->clip.w ) * t
+	};
+	return result;
+}
+
+static Renderer_Software_Screen_Vertex
+software_clip_to_screen( Renderer_Software *software, Vector4_f32 clip ) {
+	f32 one_over_w = 1.0f / clip.w;
+	Renderer_Software_Screen_Vertex vertex = {
+		.x = ( clip.x * one_over_w * 0.5f + 0.5f ) * ( f32 )software->width,
+		.y = ( 0.5f - clip.y * one_over_w * 0.5f ) * ( f32 )software->height,
+		.depth = clip.z * one_over_w * 0.5f + 0.5f,
+		.one_over_w = one_over_w
+	};
+	return vertex;
+}
+
+// Sets the triangle up and bins it, returns false if it covers no pixel or faces away.
+static bool
+software_triangle_add( Renderer_Software *software, Renderer_Software_Setup_Job *job, Renderer_Software_Clip_Vertex *corners[ 3 ], u32 material_id ) {
+	Renderer_Software_Screen_Vertex v0 = software_clip_to_screen( software, corners[ 0 ]->clip );
+	Renderer_Software_Screen_Vertex v1 = software_clip_to_screen( software, corners[ 1 ]->clip );
+	Renderer_Software_Screen_Vertex v2 = software_clip_to_screen( software, corners[ 2 ]->clip );
+
+	// Front faces are clockwise in OpenGL's window space (`glFrontFace( GL_CW )`, back faces are culled),
+	//   which has Y going up.  Rows go down here, so front faces have a positive area.
+	f32 area = ( v1.x - v0.x ) * ( v2.y - v0.y )  -  ( v2.x - v0.x ) * ( v1.y - v0.y );
+	if ( !( area > 1e-6f ) )
+		return false;
+
+	// Pixels whose centers are in the triangle's bounds.
+	f32 min_x = QL_min2( v0.x, QL_min2( v1.x, v2.x ) );
+	f32 min_y = QL_min2( v0.y, QL_min2( v1.y, v2.y ) );
+	f32 max_x = QL_max2( v0.x, QL_max2( v1.x, v2.x ) );
+	f32 max_y = QL_max2( v0.y, QL_max2( v1.y, v2.y ) );
+	s32 pixel_min_x = ( s32 )QL_max2( ceilf( min_x - 0.5f ), 0.0f );
+	s32 pixel_min_y = ( s32 )QL_max2( ceilf( min_y - 0.5f ), 0.0f );
+	s32 pixel_max_x = ( s32 )QL_min2( floorf( max_x - 0.5f ), ( f32 )software->width - 1.0f );
+	s32 pixel_max_y = ( s32 )QL_min2( floorf( max_y - 0.5f ), ( f32 )software->height - 1.0f );
+	if ( pixel_min_x > pixel_max_x || pixel_min_y > pixel_max_y )
+		return false;
+
+	u32 triangle_idx = job->triangles.size;
+	if ( triangle_idx > RENDERER_SOFTWARE_TRIANGLE_INDEX_MASK )
+		return false;
+
+	Renderer_Software_Triangle triangle;
+	triangle.min_x = pixel_min_x;
+	triangle.min_y = pixel_min_y;
+	triangle.max_x = pixel_max_x;
+	triangle.max_y = pixel_max_y;
+
+	// Edge `i` goes from vertex `i` to the next one, its function is the signed area of the edge and the point.
+	// The inside is where the function grows, so a left edge grows to the right ( a > 0 ),
+	//   and a top edge is horizontal and grows downwards ( a == 0, b > 0 ).
+	Renderer_Software_Screen_Vertex vertices[ 3 ] = { v0, v1, v2 };
+	triangle.top_left_edges = 0;
+	for ( u32 edge_idx = 0; edge_idx < 3; edge_idx += 1 ) {
+		Renderer_Software_Screen_Vertex a = vertices[ edge_idx ];
+		Renderer_Software_Screen_Vertex b = vertices[ ( edge_idx + 1 ) % 3 ];
+		triangle.edge_a[ edge_idx ] = a.y - b.y;
+		triangle.edge_b[ edge_idx ] = b.x - a.x;
+		triangle.edge_c[ edge_idx ] = a.x * b.y - b.x * a.y;
+		if ( triangle.edge_a[ edge_idx ] > 0.0f || ( triangle.edge_a[ edge_idx ] == 0.0f && triangle.edge_b[ edge_idx ] > 0.0f ) )
+			triangle.top_left_edges |= ( u8 )( 1u << edge_idx );
+	}
+
+	f32 one_over_area = 1.0f / area;
+	f32 depth_1 = v1.depth - v0.depth;
+	f32 depth_2 = v2.depth - v0.depth;
+	triangle.depth_a = ( depth_1 * ( v2.y - v0.y )  -  depth_2 * ( v1.y - v0.y ) ) * one_over_area;
+	triangle.depth_b = ( depth_2 * ( v1.x - v0.x )  -  depth_1 * ( v2.x - v0.x ) ) * one_over_area;
+	triangle.depth_c = v0.depth  -  triangle.depth_a * v0.x  -  triangle.depth_b * v0.y;
+
+	Renderer_Software_Triangle_Attributes attributes;
+	For( 3 ) {
+		attributes.vertices[ it_index ] = corners[ it_index ]->attributes;
+		attributes.one_over_w[ it_index ] = vertices[ it_index ].one_over_w;
+	}
+	attributes.material_id = material_id;
+
+	array_add( &job->triangles, triangle );
+	array_add( &job->attributes, attributes );
+
+	u32 tile_min_x = ( u32 )pixel_min_x / RENDERER_SOFTWARE_TILE_SIZE;
+	u32 tile_min_y = ( u32 )pixel_min_y / RENDERER_SOFTWARE_TILE_SIZE;
+	u32 tile_max_x = ( u32 )pixel_max_x / RENDERER_SOFTWARE_TILE_SIZE;
+	u32 tile_max_y = ( u32 )pixel_max_y / RENDERER_SOFTWARE_TILE_SIZE;
+	for ( u32 tile_y = tile_min_y; tile_y <= tile_max_y; tile_y += 1 ) {
+		for ( u32 tile_x = tile_min_x; tile_x <= tile_max_x; tile_x += 1 )
+			array_add( &job->tile_bins[ tile_y * software->tiles_x + tile_x ], triangle_idx );
+	}
+	return true;
+}
+
+static inline u32
+software_draw_index( Renderer_Software_Draw *draw, u32 index_idx ) {
+	if ( draw->index_size == sizeof( u16 ) )
+		return ( ( const u16 * )draw->indices )[ index_idx ];
+
+	return ( ( const u32 * )draw->indices )[ index_idx ];
+}
+
+// Transforms the triangle's vertices the way `geometry_vertex.glsl` does, clips it against the near plane, then adds what is left.
+static void
+software_setup_triangle( Renderer_Software *software, Renderer_Software_Setup_Job *job, Renderer_Software_Draw *draw, u32 triangle_idx ) {
+	Renderer_Software_Clip_Vertex corners[ 3 ];
+	For( 3 ) {
+		u32 vertex_idx = software_draw_index( draw, triangle_idx * 3 + ( u32 )it_index );
+		if ( vertex_idx >= draw->vertices_count ) {
+			job->triangles_culled += 1;
+			return;
+		}
+
+		const Vertex_3D *vertex = &draw->vertices[ vertex_idx ];
+		Vector4_f32 world = software_transform( &draw->model, vertex->position, 1.0f );
+		Vector3_f32 position = { world.x, world.y, world.z };
+		Vector3_f32 N = software_normalize3( software_transform_normal( draw->normal_matrix, vertex->normal ) );
+		Vector3_f32 T = software_normalize3( software_transform_normal( draw->normal_matrix, vertex->tangent ) );
+		f32 T_dot_N = software_dot3( T, N );
+		T = software_normalize3( Vector3_f32 { T.x - T_dot_N * N.x, T.y - T_dot_N * N.y, T.z - T_dot_N * N.z } );
+
+		corners[ it_index ].clip = software_transform( &software->frame->view_projection, position, world.w );
+		corners[ it_index ].attributes = Renderer_Software_Vertex {
+			.position = position,
+			.tangent = T,
+			.bitangent = software_cross3( N, T ),
+			.normal = N,
+			.texture_uv = vertex->texture_uv
+		};
+	}
+
+	// Clip against the near plane ( z + w >= 0 ), which adds at most one vertex.
+	Renderer_Software_Clip_Vertex clipped[ 4 ];
+	u32 clipped_count = 0;
+	for ( u32 vertex_idx = 0; vertex_idx < 3; vertex_idx += 1 ) {
+		Renderer_Software_Clip_Vertex *a = &corners[ vertex_idx ];
+		Renderer_Software_Clip_Vertex *b = &corners[ ( vertex_idx + 1 ) % 3 ];
+		f32 distance_a = a->clip.z + a->clip.w;
+		f32 distance_b = b->clip.z + b->clip.w;
+
+		if ( distance_a >= 0.0f )
+			clipped[ clipped_count++ ] = *a;
+
+		if ( ( distance_a >= 0.0f ) != ( distance_b >= 0.0f ) )
+			clipped[ clipped_count++ ] = software_clip_vertex_lerp( a, b, distance_a / ( distance_a - distance_b ) );
+	}
+	if ( clipped_count < 3 ) {
+		job->triangles_culled += 1;
+		return;
+	}
+
+	bool added = false;
+	for ( u32 vertex_idx = 2; vertex_idx < clipped_count; vertex_idx += 1 ) {
+		Renderer_Software_Clip_Vertex *fan[ 3 ] = { &clipped[ 0 ], &clipped[ vertex_idx - 1 ], &clipped[ vertex_idx ] };
+		added |= software_triangle_add( software, job, fan, draw->material_id );
+	}
+	if ( !added )
+		job->triangles_culled += 1;
+}
+
+static void
+software_setup_job( void *data, u32 job_idx ) {
+	Renderer_Software *software = ( Renderer_Software * )data;
+	Renderer_Software_Setup_Job *job = &software->setup_jobs[ job_idx ];
+	array_clear( &job->triangles );
+	array_clear( &job->attributes );
+	job->triangles_culled = 0;
+	For( software->tiles_x * software->tiles_y ) {
+		array_clear( &job->tile_bins[ it_index ] );
+	}
+
+	// The draw the range starts in: the last one that starts at or before it.
+	Array< Renderer_Software_Draw > *draws = &software->draws;
+	u32 low = 0;
+	u32 high = draws->size;
+	while ( high - low > 1 ) {
+		u32 middle = ( low + high ) / 2;
+		if ( draws->data[ middle ].first_triangle <= job->first_triangle )
+			low = middle;
+		else
+			high = middle;
+	}
+
+	u32 triangle_idx = job->first_triangle;
+	for ( u32 draw_idx = low; draw_idx < draws->size && triangle_idx < job->end_triangle; draw_idx += 1 ) {
+		Renderer_Software_Draw *draw = &draws->data[ draw_idx ];
+		u32 end = QL_min2( draw->first_triangle + draw->triangles_count, job->end_triangle );
+		for ( ; triangle_idx < end; triangle_idx += 1 )
+			software_setup_triangle( software, job, draw, triangle_idx - draw->first_triangle );
+	}
+}
+
+/* Tiles */
+
+static Renderer_Software_Lights
+software_frame_lights( Renderer_Software_Frame *frame ) {
+	Renderer_Software_Lights lights = { 0 };
+	if ( frame->lights && frame->lights_size >= sizeof( Shader_Storage_Lights_Header ) ) {
+		const Shader_Storage_Lights_Header *header = ( const Shader_Storage_Lights_Header * )frame->lights;
+		u32 stored_count = ( frame->lights_size - sizeof( Shader_Storage_Lights_Header ) ) / sizeof( Shader_Storage_Light );
+		lights.lights = ( const Shader_Storage_Light * )( frame->lights + sizeof( Shader_Storage_Lights_Header ) );
+		lights.lights_count = QL_min2( header->directional_lights_count + header->positional_lights_count, stored_count );
+		lights.directional_count = QL_min2( header->directional_lights_count, lights.lights_count );
+	}
+
+	if ( frame->light_clusters && frame->light_clusters_size >= sizeof( Shader_Storage_Light_Clusters_Header ) && frame->light_indices ) {
+		lights.clusters_header = ( const Shader_Storage_Light_Clusters_Header * )frame->light_clusters;
+		lights.clusters = ( const Light_Cluster * )( frame->light_clusters + sizeof( Shader_Storage_Light_Clusters_Header ) );
+		lights.clusters_count = ( frame->light_clusters_size - sizeof( Shader_Storage_Light_Clusters_Header ) ) / sizeof( Light_Cluster );
+		lights.indices = ( const u32 * )frame->light_indices;
+		lights.indices_count = frame->light_indices_size / sizeof( u32 );
+	}
+	return lights;
+}
+
+// Cluster of a pixel, as `phong_fragment.glsl` finds it.  `U32_MAX` if there are no clusters.
+static u32
+software_light_cluster( Renderer_Software *software, Renderer_Software_Lights *lights, u32 x, u32 y, Vector3_f32 position ) {
+	const Shader_Storage_Light_Clusters_Header *header = lights->clusters_header;
+	if ( !header || header->dimensions[ 0 ] == 0 || header->dimensions[ 1 ] == 0 || header->dimensions[ 2 ] == 0 )
+		return U32_MAX;
+
+	// Cluster ( 0, 0 ) is the bottom left corner of the screen, row 0 here is the top.
+	f32 u = ( ( f32 )x + 0.5f ) / ( f32 )software->width;
+	f32 v = 1.0f - ( ( f32 )y + 0.5f ) / ( f32 )software->height;
+	const Vector4_f32 *view = header->view.columns;
+	f32 view_depth = -( view[ 0 ].z * position.x  +  view[ 1 ].z * position.y  +  view[ 2 ].z * position.z  +  view[ 3 ].z );
+	f32 slice = logf( QL_max2( view_depth, 1e-4f ) ) * header->depth_scale + header->depth_bias;
+
+	u32 cluster_x = ( u32 )QL_clamp( u * ( f32 )header->dimensions[ 0 ], 0.0f, ( f32 )( header->dimensions[ 0 ] - 1 ) );
+	u32 cluster_y = ( u32 )QL_clamp( v * ( f32 )header->dimensions[ 1 ], 0.0f, ( f32 )( header->dimensions[ 1 ] - 1 ) );
+	u32 cluster_z = ( u32 )QL_clamp( slice, 0.0f, ( f32 )( header->dimensions[ 2 ] - 1 ) );
+	u32 cluster_idx = ( cluster_z * header->dimensions[ 1 ] + cluster_y ) * header->dimensions[ 0 ] + cluster_x;
+	return ( cluster_idx < lights->clusters_count ) ? cluster_idx : U32_MAX;
+}
+
+// `ShadeLight()` of `phong_fragment.glsl` for 4 pixels, added to `color` where `mask` is set.
+// `L` is normalized, `intensity` is the light's intensity times the attenuation.
+static inline void
+software_shade_light_x4( Renderer_Software_Surface_x4 *surface, Renderer_Software_Vector3_x4 L, const Shader_Storage_Light *light, __m128 intensity, __m128 mask, Renderer_Software_Vector3_x4 *color ) {
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps( 1.0f );
+
+	/* Oren-Nayar diffuse */
+
+	__m128 N_dot_L = software_dot3_x4( surface->N, L );
+	__m128 lit = _mm_cmpge_ps( N_dot_L, zero );
+	Renderer_Software_Vector3_x4 L_projected = software_normalize3_x4( software_subtract_scaled3_x4( L, surface->N, N_dot_L ) );
+	__m128 cos_phi = software_dot3_x4( L_projected, surface->V_projected );
+	__m128 cos_larger = _mm_max_ps( N_dot_L, surface->N_dot_V );
+	__m128 cos_smaller = _mm_min_ps( N_dot_L, surface->N_dot_V );
+	__m128 sin_alpha = _mm_sqrt_ps( _mm_max_ps( _mm_sub_ps( one, _mm_mul_ps( cos_smaller, cos_smaller ) ), zero ) );
+	__m128 tan_beta = _mm_div_ps(
+		_mm_sqrt_ps( _mm_max_ps( _mm_sub_ps( one, _mm_mul_ps( cos_larger, cos_larger ) ), zero ) ),
+		_mm_max_ps( cos_larger, _mm_set1_ps( 1e-6f ) )
+	);
+	__m128 oren_nayar = _mm_add_ps( surface->oren_nayar_a, _mm_mul_ps( _mm_mul_ps( surface->oren_nayar_b, _mm_max_ps( cos_phi, zero ) ), _mm_mul_ps( sin_alpha, tan_beta ) ) );
+	__m128 diffuse_term = _mm_and_ps( lit, _mm_mul_ps( N_dot_L, oren_nayar ) );
+
+	/* Phong specular */
+
+	// `reflect( -L, N )`
+	__m128 two_N_dot_L = _mm_add_ps( N_dot_L, N_dot_L );
+	Renderer_Software_Vector3_x4 R = {
+		_mm_sub_ps( _mm_mul_ps( surface->N.x, two_N_dot_L ), L.x ),
+		_mm_sub_ps( _mm_mul_ps( surface->N.y, two_N_dot_L ), L.y ),
+		_mm_sub_ps( _mm_mul_ps( surface->N.z, two_N_dot_L ), L.z )
+	};
+	__m128 V_dot_R = _mm_max_ps( software_dot3_x4( surface->V, R ), zero );
+	__m128 specular_term = _mm_mul_ps( surface->specular, software_pow_x4( V_dot_R, surface->shininess ) );
+
+	__m128 weight = _mm_and_ps( mask, _mm_mul_ps( intensity, _mm_set1_ps( light->color.a ) ) );
+	__m128 red = _mm_add_ps( _mm_mul_ps( diffuse_term, surface->diffuse_r ), specular_term );
+	__m128 green = _mm_add_ps( _mm_mul_ps( diffuse_term, surface->diffuse_g ), specular_term );
+	__m128 blue = _mm_add_ps( _mm_mul_ps( diffuse_term, surface->diffuse_b ), specular_term );
+	color->x = _mm_add_ps( color->x, _mm_mul_ps( red, _mm_mul_ps( weight, _mm_set1_ps( light->color.r ) ) ) );
+	color->y = _mm_add_ps( color->y, _mm_mul_ps( green, _mm_mul_ps( weight, _mm_set1_ps( light->color.g ) ) ) );
+	color->z = _mm_add_ps( color->z, _mm_mul_ps( blue, _mm_mul_ps( weight, _mm_set1_ps( light->color.b ) ) ) );
+}
+
+// Adds a positional light to the pixels of `mask`, attenuated as in `phong_fragment.glsl`.
+static inline void
+software_shade_positional_light_x4( Renderer_Software_Surface_x4 *surface, const Shader_Storage_Light *light, __m128 mask, Renderer_Software_Vector3_x4 *color ) {
+	Renderer_Software_Vector3_x4 to_light = {
+		_mm_sub_ps( _mm_set1_ps( light->position.x ), surface->position_x ),
+		_mm_sub_ps( _mm_set1_ps( light->position.y ), surface->position_y ),
+		_mm_sub_ps( _mm_set1_ps( light->position.z ), surface->position_z )
+	};
+	__m128 distance_squared = software_dot3_x4( to_light, to_light );
+	__m128 distance = _mm_sqrt_ps( distance_squared );
+	__m128 one_over_distance = _mm_div_ps( _mm_set1_ps( 1.0f ), _mm_max_ps( distance, _mm_set1_ps( 1e-4f ) ) );
+	Renderer_Software_Vector3_x4 L = { _mm_mul_ps( to_light.x, one_over_distance ), _mm_mul_ps( to_light.y, one_over_distance ), _mm_mul_ps( to_light.z, one_over_distance ) };
+
+	__m128 attenuation = _mm_div_ps( _mm_set1_ps( 1.0f ), _mm_max_ps( distance_squared, _mm_set1_ps( 1e-4f ) ) );
+	// Smooth window: `( 1 - ( distance / radius )^4 )^2`.
+	__m128 distance_over_radius = _mm_div_ps( distance, _mm_set1_ps( light->position.w ) );
+	__m128 ratio_squared = _mm_mul_ps( distance_over_radius, distance_over_radius );
+	__m128 window = _mm_sub_ps( _mm_set1_ps( 1.0f ), _mm_mul_ps( ratio_squared, ratio_squared ) );
+	window = _mm_min_ps( _mm_max_ps( window, _mm_setzero_ps() ), _mm_set1_ps( 1.0f ) );
+	attenuation = _mm_mul_ps( attenuation, _mm_mul_ps( window, window ) );
+
+	// Lights that do not reach any of the pixels are most of them.
+	__m128 reached = _mm_and_ps( mask, _mm_cmpgt_ps( attenuation, _mm_setzero_ps() ) );
+	if ( _mm_movemask_ps( reached ) == 0 )
+		return;
+
+	software_shade_light_x4( surface, L, light, attenuation, reached, color );
+}
+
+// Fills the G-Buffer of the covered pixels the way `geometry_fragment.glsl` does.
+static void
+software_tile_resolve( Renderer_Software *software, s32 min_x, s32 min_y, s32 max_x, s32 max_y ) {
+	u32 plane_size = software->stride * software->height;
+	f32 *planes = software->gbuffer.data;
+	for ( s32 y = min_y; y <= max_y; y += 1 ) {
+		for ( s32 x = min_x; x <= max_x; x += 1 ) {
+			u32 pixel_idx = ( u32 )y * software->stride + ( u32 )x;
+			u32 triangle_id = software->visibility.data[ pixel_idx ];
+			if ( triangle_id == RENDERER_SOFTWARE_NO_TRIANGLE )
+				continue;
+
+			Renderer_Software_Setup_Job *job = &software->setup_jobs[ triangle_id >> RENDERER_SOFTWARE_TRIANGLE_INDEX_BITS ];
+			u32 triangle_idx = triangle_id & RENDERER_SOFTWARE_TRIANGLE_INDEX_MASK;
+			Renderer_Software_Triangle *triangle = &job->triangles.data[ triangle_idx ];
+			Renderer_Software_Triangle_Attributes *attributes = &job->attributes.data[ triangle_idx ];
+
+			// Edge `i` is 0 on the side facing vertex `i + 2`, so it is that vertex's barycentric weight, up to a scale.
+			// Weights divided by W are linear in screen space, which makes the interpolation perspective-correct.
+			f32 pixel_x = ( f32 )x + 0.5f;
+			f32 pixel_y = ( f32 )y + 0.5f;
+			f32 weights[ 3 ];
+			f32 weights_sum = 0.0f;
+			for ( u32 edge_idx = 0; edge_idx < 3; edge_idx += 1 ) {
+				u32 vertex_idx = ( edge_idx + 2 ) % 3;
+				f32 edge = triangle->edge_a[ edge_idx ] * pixel_x  +  triangle->edge_b[ edge_idx ] * pixel_y  +  triangle->edge_c[ edge_idx ];
+				weights[ vertex_idx ] = QL_max2( edge, 0.0f ) * attributes->one_over_w[ vertex_idx ];
+				weights_sum += weights[ vertex_idx ];
+			}
+			f32 one_over_sum = ( weights_sum > 0.0f ) ? 1.0f / weights_sum : 0.0f;
+
+			Renderer_Software_Vertex vertex;
+			f32 *values = ( f32 * )&vertex;
+			For( sizeof( Renderer_Software_Vertex ) / sizeof( f32 ) ) {
+				const f32 *v0 = ( const f32 * )&attributes->vertices[ 0 ];
+				const f32 *v1 = ( const f32 * )&attributes->vertices[ 1 ];
+				const f32 *v2 = ( const f32 * )&attributes->vertices[ 2 ];
+				values[ it_index ] = ( v0[ it_index ] * weights[ 0 ]  +  v1[ it_index ] * weights[ 1 ]  +  v2[ it_index ] * weights[ 2 ] ) * one_over_sum;
+			}
+
+			u32 material_idx = ( attributes->material_id < software->materials.size ) ? attributes->material_id : 0;
+			Renderer_Software_Material_View *material = &software->materials.data[ material_idx ];
+
+			f32 tangent_normal[ 3 ];
+			software_texture_sample( software, &material->normal_map, vertex.texture_uv, tangent_normal );
+			For( 3 ) {
+				tangent_normal[ it_index ] = tangent_normal[ it_index ] * 2.0f - 1.0f;  // [0; 1] -> [-1; 1]
+			}
+			Vector3_f32 normal = software_normalize3( Vector3_f32 {
+				vertex.tangent.x * tangent_normal[ 0 ]  +  vertex.bitangent.x * tangent_normal[ 1 ]  +  vertex.normal.x * tangent_normal[ 2 ],
+				vertex.tangent.y * tangent_normal[ 0 ]  +  vertex.bitangent.y * tangent_normal[ 1 ]  +  vertex.normal.y * tangent_normal[ 2 ],
+				vertex.tangent.z * tangent_normal[ 0 ]  +  vertex.bitangent.z * tangent_normal[ 1 ]  +  vertex.normal.z * tangent_normal[ 2 ]
+			} );
+
+			f32 diffuse[ 3 ];
+			f32 specular[ 3 ];
+			software_texture_sample( software, &material->diffuse, vertex.texture_uv, diffuse );
+			software_texture_sample( software, &material->specular_map, vertex.texture_uv, specular );
+
+			planes[ RendererSoftwarePlane_PositionX * plane_size + pixel_idx ] = vertex.position.x;
+			planes[ RendererSoftwarePlane_PositionY * plane_size + pixel_idx ] = vertex.position.y;
+			planes[ RendererSoftwarePlane_PositionZ * plane_size + pixel_idx ] = vertex.position.z;
+			planes[ RendererSoftwarePlane_NormalX * plane_size + pixel_idx ] = normal.x;
+			planes[ RendererSoftwarePlane_NormalY * plane_size + pixel_idx ] = normal.y;
+			planes[ RendererSoftwarePlane_NormalZ * plane_size + pixel_idx ] = normal.z;
+			planes[ RendererSoftwarePlane_DiffuseR * plane_size + pixel_idx ] = diffuse[ 0 ];
+			planes[ RendererSoftwarePlane_DiffuseG * plane_size + pixel_idx ] = diffuse[ 1 ];
+			planes[ RendererSoftwarePlane_DiffuseB * plane_size + pixel_idx ] = diffuse[ 2 ];
+			// A roughness map's value is the inverse of the specular intensity.
+			planes[ RendererSoftwarePlane_Specular * plane_size + pixel_idx ] = 1.0f - specular[ 0 ];
+			planes[ RendererSoftwarePlane_Shininess * plane_size + pixel_idx ] = material->shininess_exponent;
+		}
+	}
+}
+
+// Lights the tile's G-Buffer the way `phong_fragment.glsl` does, 4 pixels at a time.
+static void
+software_tile_light( Renderer_Software *software, Renderer_Software_Lights *lights, s32 min_x, s32 min_y, s32 max_x, s32 max_y ) {
+	Renderer_Software_Frame *frame = software->frame;
+	u32 plane_size = software->stride * software->height;
+	const f32 *planes = software->gbuffer.data;
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps( 1.0f );
+	const __m128i no_triangle = _mm_set1_epi32( ( int )RENDERER_SOFTWARE_NO_TRIANGLE );
+	const __m128i black = _mm_set1_epi32( ( int )0xFF000000 );
+
+	for ( s32 y = min_y; y <= max_y; y += 1 ) {
+		for ( s32 x = min_x; x <= max_x; x += 4 ) {
+			u32 pixel_idx = ( u32 )y * software->stride + ( u32 )x;
+			__m128i *color_pixels = ( __m128i * )&software->color.data[ pixel_idx ];
+			__m128i triangle_ids = _mm_loadu_si128( ( const __m128i * )&software->visibility.data[ pixel_idx ] );
+			// Nothing was drawn where there is no triangle, there is nothing to light.
+			__m128 drawn = _mm_castsi128_ps( _mm_andnot_si128( _mm_cmpeq_epi32( triangle_ids, no_triangle ), _mm_set1_epi32( -1 ) ) );
+			if ( _mm_movemask_ps( drawn ) == 0 ) {
+				_mm_storeu_si128( color_pixels, black );
+				continue;
+			}
+
+			Renderer_Software_Surface_x4 surface;
+			surface.position_x = _mm_loadu_ps( &planes[ RendererSoftwarePlane_PositionX * plane_size + pixel_idx ] );
+			surface.position_y = _mm_loadu_ps( &planes[ RendererSoftwarePlane_PositionY * plane_size + pixel_idx ] );
+			surface.position_z = _mm_loadu_ps( &planes[ RendererSoftwarePlane_PositionZ * plane_size + pixel_idx ] );
+			surface.N.x = _mm_loadu_ps( &planes[ RendererSoftwarePlane_NormalX * plane_size + pixel_idx ] );
+			surface.N.y = _mm_loadu_ps( &planes[ RendererSoftwarePlane_NormalY * plane_size + pixel_idx ] );
+			surface.N.z = _mm_loadu_ps( &planes[ RendererSoftwarePlane_NormalZ * plane_size + pixel_idx ] );
+			surface.diffuse_r = _mm_loadu_ps( &planes[ RendererSoftwarePlane_DiffuseR * plane_size + pixel_idx ] );
+			surface.diffuse_g = _mm_loadu_ps( &planes[ RendererSoftwarePlane_DiffuseG * plane_size + pixel_idx ] );
+			surface.diffuse_b = _mm_loadu_ps( &planes[ RendererSoftwarePlane_DiffuseB * plane_size + pixel_idx ] );
+			surface.specular = _mm_loadu_ps( &planes[ RendererSoftwarePlane_Specular * plane_size + pixel_idx ] );
+			surface.shininess = _mm_loadu_ps( &planes[ RendererSoftwarePlane_Shininess * plane_size + pixel_idx ] );
+
+			__m128 red, green, blue;
+			switch ( frame->output_channel ) {
+				case RendererOutputChannel_Position:
+					red = surface.position_x;
+					green = surface.position_y;
+					blue = surface.position_z;
+					break;
+				case RendererOutputChannel_Normal:
+					red = surface.N.x;
+					green = surface.N.y;
+					blue = surface.N.z;
+					break;
+				case RendererOutputChannel_DiffuseSpecular:
+					red = surface.diffuse_r;
+					green = surface.diffuse_g;
+					blue = surface.diffuse_b;
+					break;
+
+				case RendererOutputChannel_FinalColor:
+				default: {
+					Renderer_Software_Vector3_x4 to_camera = {
+						_mm_sub_ps( _mm_set1_ps( frame->camera_position.x ), surface.position_x ),
+						_mm_sub_ps( _mm_set1_ps( frame->camera_position.y ), surface.position_y ),
+						_mm_sub_ps( _mm_set1_ps( frame->camera_position.z ), surface.position_z )
+					};
+					surface.V = software_normalize3_x4( to_camera );
+					surface.N_dot_V = software_dot3_x4( surface.N, surface.V );
+					surface.V_projected = software_normalize3_x4( software_subtract_scaled3_x4( surface.V, surface.N, surface.N_dot_V ) );
+
+					// Roughness is the inverse of specular, mapped to Oren-Nayar's sigma as `roughness^2 * ( PI / 2 )`.
+					__m128 roughness = _mm_sub_ps( one, surface.specular );
+					__m128 sigma = _mm_mul_ps( _mm_mul_ps( roughness, roughness ), _mm_set1_ps( PI * 0.5f ) );
+					__m128 sigma_squared = _mm_mul_ps( sigma, sigma );
+					surface.oren_nayar_a = _mm_sub_ps( one, _mm_mul_ps( _mm_set1_ps( 0.5f ), _mm_div_ps( sigma_squared, _mm_add_ps( sigma_squared, _mm_set1_ps( 0.33f ) ) ) ) );
+					surface.oren_nayar_b = _mm_mul_ps( _mm_set1_ps( 0.45f ), _mm_div_ps( sigma_squared, _mm_add_ps( sigma_squared, _mm_set1_ps( 0.09f ) ) ) );
+
+					Renderer_Software_Vector3_x4 color = {
+						_mm_mul_ps( surface.diffuse_r, _mm_set1_ps( frame->ambient_light.x ) ),
+						_mm_mul_ps( surface.diffuse_g, _mm_set1_ps( frame->ambient_light.y ) ),
+						_mm_mul_ps( surface.diffuse_b, _mm_set1_ps( frame->ambient_light.z ) )
+					};
+
+					// Directional lights reach everything.
+					for ( u32 light_idx = 0; light_idx < lights->directional_count; light_idx += 1 ) {
+						const Shader_Storage_Light *light = &lights->lights[ light_idx ];
+						Vector3_f32 direction = software_normalize3( Vector3_f32 { light->position.x, light->position.y, light->position.z } );
+						Renderer_Software_Vector3_x4 L = { _mm_set1_ps( direction.x ), _mm_set1_ps( direction.y ), _mm_set1_ps( direction.z ) };
+						software_shade_light_x4( &surface, L, light, one, drawn, &color );
+					}
+
+					// Positional lights only come from each pixel's cluster.  Neighbouring pixels mostly
+					//   share one, so the pixels of each distinct cluster are lit together under a mask.
+					f32 positions_x[ 4 ], positions_y[ 4 ], positions_z[ 4 ];
+					_mm_storeu_ps( positions_x, surface.position_x );
+					_mm_storeu_ps( positions_y, surface.position_y );
+					_mm_storeu_ps( positions_z, surface.position_z );
+					u32 drawn_bits = ( u32 )_mm_movemask_ps( drawn );
+					u32 clusters[ 4 ];
+					For( 4 ) {
+						Vector3_f32 position = { positions_x[ it_index ], positions_y[ it_index ], positions_z[ it_index ] };
+						clusters[ it_index ] = ( drawn_bits & ( 1u << it_index ) ) ? software_light_cluster( software, lights, ( u32 )x + ( u32 )it_index, ( u32 )y, position ) : U32_MAX;
+					}
+
+					u32 done_bits = 0;
+					For( 4 ) {
+						u32 cluster_idx = clusters[ it_index ];
+						if ( ( done_bits & ( 1u << it_index ) ) || cluster_idx == U32_MAX )
+							continue;
+
+						u32 lanes[ 4 ];
+						For2( 4 ) {
+							lanes[ it2_index ] = ( clusters[ it2_index ] == cluster_idx ) ? U32_MAX : 0;
+							done_bits |= ( clusters[ it2_index ] == cluster_idx ) ? ( 1u << it2_index ) : 0;
+						}
+						__m128 mask = _mm_castsi128_ps( _mm_loadu_si128( ( const __m128i * )lanes ) );
+
+						const Light_Cluster *cluster = &lights->clusters[ cluster_idx ];
+						for ( u32 entry_idx = 0; entry_idx < cluster->count; entry_idx += 1 ) {
+							u32 index_idx = cluster->offset + entry_idx;
+							if ( index_idx >= lights->indices_count )
+								break;
+
+							u32 light_idx = lights->directional_count + lights->indices[ index_idx ];
+							if ( light_idx < lights->lights_count )
+								software_shade_positional_light_x4( &surface, &lights->lights[ light_idx ], mask, &color );
+						}
+					}
+
+					red = software_linear_to_srgb_x4( color.x );
+					green = software_linear_to_srgb_x4( color.y );
+					blue = software_linear_to_srgb_x4( color.z );
+					break;
+				}
+			}
+
+			red = _mm_and_ps( drawn, _mm_min_ps( _mm_max_ps( red, zero ), one ) );
+			green = _mm_and_ps( drawn, _mm_min_ps( _mm_max_ps( green, zero ), one ) );
+			blue = _mm_and_ps( drawn, _mm_min_ps( _mm_max_ps( blue, zero ), one ) );
+			_mm_storeu_si128( color_pixels, software_pack_rgba8_x4( red, green, blue ) );
+		}
+	}
+}
+
+// All bits set if edge `edge_idx` of the triangle is a top or a left edge.
+static inline __m128
+software_edge_mask_x4( Renderer_Software_Triangle *triangle, u32 edge_idx ) {
+	bool top_left = ( triangle->top_left_edges & ( 1u << edge_idx ) ) != 0;
+	return _mm_castsi128_ps( _mm_set1_epi32( ( top_left ) ? -1 : 0 ) );
+}
+
+// Pixels whose edge function is positive are inside, the ones on the edge only if it is a top or a left edge.
+static inline __m128
+software_edge_inside_x4( __m128 edge, __m128 top_left ) {
+	__m128 zero = _mm_setzero_ps();
+	return _mm_or_ps( _mm_cmpgt_ps( edge, zero ), _mm_and_ps( _mm_cmpeq_ps( edge, zero ), top_left ) );
+}
+
+// Clears the tile, rasterizes the triangles binned into it, then fills and lights its G-Buffer.
+static void
+software_draw_tile( void *data, u32 tile_idx ) {
+	Renderer_Software *software = ( Renderer_Software * )data;
+	s32 tile_min_x = ( s32 )( ( tile_idx % software->tiles_x ) * RENDERER_SOFTWARE_TILE_SIZE );
+	s32 tile_min_y = ( s32 )( ( tile_idx / software->tiles_x ) * RENDERER_SOFTWARE_TILE_SIZE );
+	s32 tile_max_x = ( s32 )QL_min2( ( u32 )tile_min_x + RENDERER_SOFTWARE_TILE_SIZE, software->width ) - 1;
+	s32 tile_max_y = ( s32 )QL_min2( ( u32 )tile_min_y + RENDERER_SOFTWARE_TILE_SIZE, software->height ) - 1;
+
+	// The tile's left edge is a multiple of 4 and rows are padded to one,
+	//   so groups of 4 pixels never leave the tile or the row.
+	const __m128 far_depth = _mm_set1_ps( 1.0f );
+	const __m128i no_triangle = _mm_set1_epi32( ( int )RENDERER_SOFTWARE_NO_TRIANGLE );
+	for ( s32 y = tile_min_y; y <= tile_max_y; y += 1 ) {
+		u32 row_idx = ( u32 )y * software->stride;
+		for ( s32 x = tile_min_x; x <= tile_max_x; x += 4 ) {
+			_mm_storeu_ps( &software->depth.data[ row_idx + x ], far_depth );
+			_mm_storeu_si128( ( __m128i * )&software->visibility.data[ row_idx + x ], no_triangle );
+		}
+	}
+
+	const __m128 pixel_offsets = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+	const __m128 zero = _mm_setzero_ps();
+	for ( u32 job_idx = 0; job_idx < software->setup_jobs_count; job_idx += 1 ) {
+		Renderer_Software_Setup_Job *job = &software->setup_jobs[ job_idx ];
+		Array< u32 > *bin = &job->tile_bins[ tile_idx ];
+		ForIt( bin->data, bin->size ) {
+			Renderer_Software_Triangle *triangle = &job->triangles.data[ it ];
+			s32 min_x = QL_max2( triangle->min_x, tile_min_x );
+			s32 min_y = QL_max2( triangle->min_y, tile_min_y );
+			s32 max_x = QL_min2( triangle->max_x, tile_max_x );
+			s32 max_y = QL_min2( triangle->max_y, tile_max_y );
+			if ( min_x > max_x || min_y > max_y )
+				continue;
+
+			__m128i triangle_id = _mm_set1_epi32( ( int )( ( job_idx << RENDERER_SOFTWARE_TRIANGLE_INDEX_BITS ) | it ) );
+			__m128 edge_a0 = _mm_set1_ps( triangle->edge_a[ 0 ] );
+			__m128 edge_a1 = _mm_set1_ps( triangle->edge_a[ 1 ] );
+			__m128 edge_a2 = _mm_set1_ps( triangle->edge_a[ 2 ] );
+			__m128 top_left0 = software_edge_mask_x4( triangle, 0 );
+			__m128 top_left1 = software_edge_mask_x4( triangle, 1 );
+			__m128 top_left2 = software_edge_mask_x4( triangle, 2 );
+			__m128 depth_a = _mm_set1_ps( triangle->depth_a );
+			s32 start_x = min_x & ~3;
+
+			for ( s32 y = min_y; y <= max_y; y += 1 ) {
+				f32 pixel_y = ( f32 )y + 0.5f;
+				__m128 row0 = _mm_set1_ps( triangle->edge_b[ 0 ] * pixel_y + triangle->edge_c[ 0 ] );
+				__m128 row1 = _mm_set1_ps( triangle->edge_b[ 1 ] * pixel_y + triangle->edge_c[ 1 ] );
+				__m128 row2 = _mm_set1_ps( triangle->edge_b[ 2 ] * pixel_y + triangle->edge_c[ 2 ] );
+				__m128 row_depth = _mm_set1_ps( triangle->depth_b * pixel_y + triangle->depth_c );
+				f32 *row_depths = &software->depth.data[ ( u32 )y * software->stride ];
+				u32 *row_triangles = &software->visibility.data[ ( u32 )y * software->stride ];
+
+				for ( s32 x = start_x; x <= max_x; x += 4 ) {
+					__m128 pixel_x = _mm_add_ps( _mm_set1_ps( ( f32 )x ), pixel_offsets );
+					__m128 edge0 = _mm_add_ps( _mm_mul_ps( edge_a0, pixel_x ), row0 );
+					__m128 edge1 = _mm_add_ps( _mm_mul_ps( edge_a1, pixel_x ), row1 );
+					__m128 edge2 = _mm_add_ps( _mm_mul_ps( edge_a2, pixel_x ), row2 );
+					__m128 inside = _mm_and_ps(
+						_mm_and_ps( software_edge_inside_x4( edge0, top_left0 ), software_edge_inside_x4( edge1, top_left1 ) ),
+						software_edge_inside_x4( edge2, top_left2 )
+					);
+					if ( _mm_movemask_ps( inside ) == 0 )
+						continue;
+
+					// `GL_LESS`: on equal depths the triangle drawn first stays.
+					__m128 depth = _mm_add_ps( _mm_mul_ps( depth_a, pixel_x ), row_depth );
+					__m128 current = _mm_loadu_ps( &row_depths[ x ] );
+					__m128 nearer = _mm_and_ps( inside, _mm_cmplt_ps( depth, current ) );
+					if ( _mm_movemask_ps( nearer ) == 0 )
+						continue;
+
+					_mm_storeu_ps( &row_depths[ x ], software_select_x4( nearer, depth, current ) );
+					__m128i nearer_mask = _mm_castps_si128( nearer );
+					__m128i current_triangles = _mm_loadu_si128( ( const __m128i * )&row_triangles[ x ] );
+					_mm_storeu_si128( ( __m128i * )&row_triangles[ x ], _mm_or_si128( _mm_and_si128( nearer_mask, triangle_id ), _mm_andnot_si128( nearer_mask, current_triangles ) ) );
+				}
+			}
+		}}
+	}
+
+	Renderer_Software_Lights lights = software_frame_lights( software->frame );
+	software_tile_resolve( software, tile_min_x, tile_min_y, tile_max_x, tile_max_y );
+	software_tile_light( software, &lights, tile_min_x, tile_min_y, tile_max_x, tile_max_y );
+}
+
+static f64
+software_milliseconds_between( std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end ) {
+	return std::chrono::duration< f64, std::milli >( end - start ).count();
+}
+
+// Sets up the triangles of `draws` and draws the tiles, the frame's materials and draws are built already.
+static void
+software_draw_triangles( Renderer_Software *software, u32 triangles_count, std::chrono::steady_clock::time_point setup_start ) {
+	// Split by triangles rather than by draws, so a few big meshes do not end up on one job.
+	// The split depends on the frame only, not on the workers, so neither does the image.
+	u32 jobs_count = QL_min2( QL_max2( triangles_count / RENDERER_SOFTWARE_MIN_SETUP_JOB_TRIANGLES, 1u ), RENDERER_SOFTWARE_MAX_SETUP_JOBS );
+	For( jobs_count ) {
+		software->setup_jobs[ it_index ].first_triangle = ( u32 )( ( u64 )triangles_count * it_index / jobs_count );
+		software->setup_jobs[ it_index ].end_triangle = ( u32 )( ( u64 )triangles_count * ( it_index + 1 ) / jobs_count );
+	}
+	software->setup_jobs_count = jobs_count;
+	jobs_run_parallel( jobs_count, software_setup_job, software );
+	auto setup_end = std::chrono::steady_clock::now();
+
+	u32 tiles_count = software->tiles_x * software->tiles_y;
+	jobs_run_parallel( tiles_count, software_draw_tile, software );
+	auto tiles_end = std::chrono::steady_clock::now();
+
+	software->stats = Renderer_Software_Stats {
+		.triangles_submitted = triangles_count,
+		.triangles_binned = 0,
+		.tile_triangles = 0,
+		.setup_jobs = jobs_count,
+		.tiles = tiles_count,
+		.setup_milliseconds = software_milliseconds_between( setup_start, setup_end ),
+		.tiles_milliseconds = software_milliseconds_between( setup_end, tiles_end )
+	};
+	ForIt( software->setup_jobs, jobs_count ) {
+		software->stats.triangles_binned += it.triangles.size;
+		For2( tiles_count ) {
+			software->stats.tile_triangles += it.tile_bins[ it2_index ].size;
+		}
+	}}
+
+	software->frame = NULL;
+	software->has_frame = true;
+}
+
+void
+renderer_software_draw( Renderer_Software *software, Renderer_Software_Frame *frame ) {
+	auto setup_start = std::chrono::steady_clock::now();
+	software_resize( software, frame->dimensions.width, frame->dimensions.height );
+	if ( software->width == 0 || software->height == 0 )
+		return;
+
+	software->frame = frame;
+	software_build_materials( software );
+	u32 triangles_count = software_build_draws( software );
+	software_draw_triangles( software, triangles_count, setup_start );
+}
+
+bool
+renderer_software_write_ppm( Renderer_Software *software, const char *file_path ) {
+	if ( !software->has_frame ) {
+		log_warning( "The software rasterizer has not drawn a frame yet, there is nothing to write into '%s'.", file_path );
+		return false;
+	}
+
+	FILE *file = fopen( file_path, "wb" );
+	if ( !file ) {
+		log_error( "Failed to open '%s' to write the frame into.", file_path );
+		return false;
+	}
+
+	fprintf( file, "P6\n%u %u\n255\n", software->width, software->height );
+	u8 *row = Allocate( software->allocator, software->width * 3, u8 );
+	for ( u32 y = 0; y < software->height; y += 1 ) {
+		const u32 *pixels = &software->color.data[ y * software->stride ];
+		for ( u32 x = 0; x < software->width; x += 1 ) {
+			row[ x * 3 + 0 ] = ( u8 )( pixels[ x ] & 0xFF );
+			row[ x * 3 + 1 ] = ( u8 )( ( pixels[ x ] >> 8 ) & 0xFF );
+			row[ x * 3 + 2 ] = ( u8 )( ( pixels[ x ] >> 16 ) & 0xFF );
+		}
+		fwrite( row, 1, software->width * 3, file );
+	}
+	Deallocate( software->allocator, row );
+
+	bool written = ( ferror( file ) == 0 );
+	fclose( file );
+	if ( written )
+		log_info( "Wrote the %ux%u frame to '%s'.", software->width, software->height, file_path );
+	else
+		log_error( "Failed to write the frame to '%s'.", file_path );
+	return written;
+}
+
+// --- Test
+
+// Of the frame `renderer_software_test()` draws, update it when the image changes on purpose.
+constexpr u32 RENDERER_SOFTWARE_TEST_CHECKSUM = 0x24F6D96D;
+
+// FNV-1a of the last frame's pixels, row by row, without the padding.
+static u32
+software_color_checksum( Renderer_Software *software ) {
+	u32 hash = 0x811C9DC5;
+	for ( u32 y = 0; y < software->height; y += 1 ) {
+		const u8 *row = ( const u8 * )&software->color.data[ y * software->stride ];
+		For( software->width * sizeof( u32 ) ) {
+			hash = ( hash ^ row[ it_index ] ) * 0x01000193;
+		}
+	}
+	return hash;
+}
+
+Renderer_Software_Test renderer_software_test() {
+	// Powers of 2, so pixel centers are exact in normalized device coordinates and back.
+	constexpr u32 SIZE = 128;
+	constexpr u32 QUADS = 12;
+	constexpr u32 QUAD_SIZE = 10;
+	constexpr f32 FIRST_CENTER = 4.5f;
+	Renderer_Software_Test test = { .expected_covered_pixels = QUADS * QUAD_SIZE * QUADS * QUAD_SIZE, .expected_checksum = RENDERER_SOFTWARE_TEST_CHECKSUM };
+
+	Array< Vertex_3D > vertices = array_new< Vertex_3D >( sys_allocator, QUADS * QUADS * 4 );
+	Array< u16 > indices = array_new< u16 >( sys_allocator, QUADS * QUADS * 6 );
+	auto to_ndc = []( f32 pixel ) -> f32 { return pixel / ( f32 )( SIZE / 2 ) - 1.0f; };
+	For( QUADS ) {
+		For2( QUADS ) {
+			f32 left = to_ndc( FIRST_CENTER + ( f32 )( it2_index * QUAD_SIZE ) );
+			f32 right = to_ndc( FIRST_CENTER + ( f32 )( ( it2_index + 1 ) * QUAD_SIZE ) );
+			// Rows go down, normalized device coordinates go up.
+			f32 top = -to_ndc( FIRST_CENTER + ( f32 )( it_index * QUAD_SIZE ) );
+			f32 bottom = -to_ndc( FIRST_CENTER + ( f32 )( ( it_index + 1 ) * QUAD_SIZE ) );
+			// Every quad is nearer than the ones before, so a pixel covered twice would go to the later one.
+			f32 depth = 0.5f - ( f32 )( it_index * QUADS + it2_index ) / 512.0f;
+			// A color of its own, see `RendererOutputChannel_Normal`.
+			Vector3_f32 normal = { 0.2f + 0.05f * ( f32 )it2_index, 0.2f + 0.05f * ( f32 )it_index, 0.5f };
+			u16 first = ( u16 )vertices.size;
+			Vector3_f32 corners[ 4 ] = { { left, top, depth }, { right, top, depth }, { right, bottom, depth }, { left, bottom, depth } };
+			ForIt3( corners, 4 ) {
+				array_add( &vertices, Vertex_3D { .position = it3, .normal = normal, .texture_uv = { 0.0f, 0.0f }, .tangent = { 1.0f, 0.0f, 0.0f } } );
+			}}
+
+			// Diagonals alternate, so edges of all directions are shared.  Clockwise, as front faces are.
+			u16 quad_indices[ 2 ][ 6 ] = {
+				{ 0, 1, 3,  1, 2, 3 },
+				{ 0, 1, 2,  0, 2, 3 }
+			};
+			u16 *split = quad_indices[ ( it_index + it2_index ) % 2 ];
+			For3( 6 ) {
+				array_add( &indices, ( u16 )( first + split[ it3_index ] ) );
+			}
+		}
+	}
+
+	Renderer_Software software;
+	renderer_software_init( &software, sys_allocator );
+	Renderer_Software_Frame frame = { 0 };
+	frame.dimensions = Vector2_u16 { ( u16 )SIZE, ( u16 )SIZE };
+	frame.output_channel = RendererOutputChannel_Normal;
+	software_resize( &software, SIZE, SIZE );
+	software.frame = &frame;
+
+	// Built by hand, so the test needs no mesh or texture to be loaded.
+	Renderer_Software_Texture white = software_white_texture();
+	array_add( &software.materials, Renderer_Software_Material_View { .diffuse = white, .normal_map = white, .specular_map = white, .shininess_exponent = 0.0f } );
+	Renderer_Software_Draw draw = {
+		.vertices = vertices.data,
+		.indices = ( const u8 * )indices.data,
+		.index_size = sizeof( u16 ),
+		.vertices_count = vertices.size,
+		.first_triangle = 0,
+		.triangles_count = indices.size / 3,
+		.model = Matrix4x4_f32(),
+		.normal_matrix = { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f } },
+		.material_id = 0
+	};
+	array_add( &software.draws, draw );
+	software_draw_triangles( &software, draw.triangles_count, std::chrono::steady_clock::now() );
+
+	ForIt( software.visibility.data, software.visibility.size ) {
+		if ( it != RENDERER_SOFTWARE_NO_TRIANGLE )
+			test.covered_pixels += 1;
+	}}
+	test.checksum = software_color_checksum( &software );
+
+	renderer_software_destroy( &software );
+	array_free( &vertices );
+	array_free( &indices );
+	return test;
+}
@@ -0,0 +1,227 @@
+#ifndef QLIGHT_RENDERER_SOFTWARE_H
+#define QLIGHT_RENDERER_SOFTWARE_H
+
+#include "renderer.h"
+#include "renderer_batch.h"
+
+/*
+	Software rasterizer: the deferred pipeline of the OpenGL backend, drawn on the CPU.
+
+	The render queue is drawn into a G-Buffer (position, normal, diffuse, specular) the way
+	  `geometry_fragment.glsl` fills it, which is then lit the way `phong_fragment.glsl` does,
+	  with the frame's lights and light clusters.  It needs neither a window nor a GPU, so
+	  frames can be drawn and compared on any machine.
+
+	A frame is drawn in two parallel steps:
+	  1. Setup: the queue's triangles are split into equal ranges, one per job.  Vertices are
+	     transformed, triangles are clipped against the near plane, back faces are culled,
+	     and the rest is set up and binned into every screen tile its bounds touch.  Every
+	     job bins into its own lists, so nothing is shared.
+	  2. Tiles: one job per tile goes through the bins of all setup jobs in order and depth
+	     tests their triangles 4 pixels at a time with SSE, keeping the nearest triangle's ID.
+	     Then the G-Buffer of every covered pixel is interpolated from its triangle and its
+	     material's textures, and the tile is lit 4 pixels at a time with SSE.
+	Tiles never share pixels and triangles keep their queue order within a tile, so the
+	  image does not depend on the number of workers.
+	Coverage follows the top-left rule, as OpenGL and Direct3D rasterizers do.
+
+	Meshes are drawn from their CPU vertices and indices, which must be `Vertex_3D`.
+	Textures are sampled bilinearly from their CPU bytes at the top mipmap level;
+	  only 8-bit channels can be sampled, other textures are replaced by the fallbacks.
+	Depth is `[ 0, 1 ]` from the near to the far plane and row 0 is the top of the screen.
+*/
+
+constexpr u32 RENDERER_SOFTWARE_TILE_SIZE = 64;
+// Setup jobs of one frame, at most.  Triangle IDs keep their setup job in the top bits.
+constexpr u32 RENDERER_SOFTWARE_MAX_SETUP_JOBS = 32;
+
+// A material's textures and parameters, as the game thread saw them.
+struct Renderer_Software_Material {
+	Texture_ID diffuse;
+	Texture_ID normal_map;
+	Texture_ID specular_map;
+	f32 shininess_exponent;
+};
+
+// Everything a frame is drawn from, see `renderer_software_draw()`.
+struct Renderer_Software_Frame {
+	Vector2_u16 dimensions;
+	Matrix4x4_f32 view_projection;
+	Vector3_f32 camera_position;
+	Vector3_f32 ambient_light;
+	Renderer_Output_Channel output_channel;
+
+	// Visible proxies in the sorted order, their instances are in the mirror.
+	ArrayView< Renderer_Render_Command > render_queue;
+	// Indexed by the instances' material IDs.
+	ArrayView< Renderer_Software_Material > materials;
+	// Stand in for textures that are missing or cannot be sampled.
+	Texture_ID fallback_diffuse;
+	Texture_ID fallback_white;
+
+	// Contents of the lights' storage buffers, see `Shader_Storage_Lights_Header` and the ones after it.
+	// NULL if the frame has none, only the ambient light is applied then.
+	const u8 *lights;
+	const u8 *light_clusters;
+	const u8 *light_indices;
+	u32 lights_size;
+	u32 light_clusters_size;
+	u32 light_indices_size;
+};
+
+// What one pixel of a triangle is interpolated from.  World space, only `f32`s, so it can be interpolated as an array.
+struct Renderer_Software_Vertex {
+	Vector3_f32 position;
+	Vector3_f32 tangent;
+	Vector3_f32 bitangent;
+	Vector3_f32 normal;
+	Vector2_f32 texture_uv;
+};
+static_assert( sizeof( Renderer_Software_Vertex ) == 14 * sizeof( f32 ), "Renderer_Software_Vertex must be made of f32s only" );
+
+// Screen-space triangle, set up for rasterization, see `Occlusion_Triangle`.
+struct Renderer_Software_Triangle {
+	// Pixel rectangle, inclusive.
+	s32 min_x, min_y;
+	s32 max_x, max_y;
+	// Edge functions `a * x + b * y + c`, non-negative inside.  Edge `i` goes from vertex `i` to the next one.
+	f32 edge_a[ 3 ];
+	f32 edge_b[ 3 ];
+	f32 edge_c[ 3 ];
+	// Bit `i` is set if edge `i` is a top or a left edge.  Pixel centers exactly on an edge are
+	//   only covered by it then, so triangles sharing an edge never both cover a pixel.
+	u8 top_left_edges;
+	// Depth plane `depth = depth_a * x + depth_b * y + depth_c`.
+	f32 depth_a, depth_b, depth_c;
+};
+
+// Read only for the pixels a triangle ends up covering, so it is kept apart from the rasterization data.
+struct Renderer_Software_Triangle_Attributes {
+	Renderer_Software_Vertex vertices[ 3 ];
+	f32 one_over_w[ 3 ];  // For perspective-correct interpolation.
+	u32 material_id;
+};
+
+struct Renderer_Software_Setup_Job {
+	// Range of the frame's triangles, end excluded.
+	u32 first_triangle;
+	u32 end_triangle;
+	Array< Renderer_Software_Triangle > triangles;
+	Array< Renderer_Software_Triangle_Attributes > attributes;  // Same order as `triangles`.
+	Array< u32 > *tile_bins;  // One per tile, indices into `triangles`.
+	u32 triangles_culled;
+};
+
+// A render command resolved for the setup jobs.
+struct Renderer_Software_Draw {
+	const Vertex_3D *vertices;
+	const u8 *indices;
+	u32 index_size;
+	u32 vertices_count;
+	u32 first_triangle;  // Of the frame's triangles.
+	u32 triangles_count;
+	Matrix4x4_f32 model;
+	Vector4_f32 normal_matrix[ 3 ];
+	u32 material_id;
+};
+
+// A texture's bytes and how to read a texel out of them.
+struct Renderer_Software_Texture {
+	const u8 *bytes;
+	u32 width;
+	u32 height;
+	u8 texel_size;
+	u8 channel_offsets[ 3 ];  // Of red, green and blue in a texel, `U8_MAX` reads as 0.
+	bool srgb;                // Decoded to linear before filtering, as OpenGL does.
+};
+
+struct Renderer_Software_Material_View {
+	Renderer_Software_Texture diffuse;
+	Renderer_Software_Texture normal_map;
+	Renderer_Software_Texture specular_map;
+	f32 shininess_exponent;
+};
+
+enum Renderer_Software_Plane : u8 {
+	RendererSoftwarePlane_PositionX = 0,
+	RendererSoftwarePlane_PositionY,
+	RendererSoftwarePlane_PositionZ,
+	RendererSoftwarePlane_NormalX,
+	RendererSoftwarePlane_NormalY,
+	RendererSoftwarePlane_NormalZ,
+	RendererSoftwarePlane_DiffuseR,
+	RendererSoftwarePlane_DiffuseG,
+	RendererSoftwarePlane_DiffuseB,
+	RendererSoftwarePlane_Specular,
+	RendererSoftwarePlane_Shininess,
+
+	RendererSoftwarePlane_COUNT
+};
+
+struct Renderer_Software_Stats {
+	u32 triangles_submitted;
+	u32 triangles_binned;    // Left after clipping and culling.
+	u32 tile_triangles;      // Binned triangles summed over every tile they were binned into.
+	u32 setup_jobs;
+	u32 tiles;
+	f64 setup_milliseconds;
+	f64 tiles_milliseconds;  // Rasterization and shading.
+};
+
+struct Renderer_Software {
+	Allocator *allocator;
+	u32 width;
+	u32 height;
+	u32 stride;  // Pixels in a row of every buffer, `width` rounded up to 4.
+	u32 tiles_x;
+	u32 tiles_y;
+
+	// Visibility buffer: depth and ID of the nearest triangle of every pixel.
+	Array< f32 > depth;
+	Array< u32 > visibility;
+	// G-Buffer, a plane of `stride * height` values per `Renderer_Software_Plane`.
+	Array< f32 > gbuffer;
+	// RGBA8 pixels of the last frame.
+	Array< u32 > color;
+	bool has_frame;
+
+	// Mirror of the proxy instance buffer.
+	Array< Renderer_Instance_Data > instances;
+	// Rebuilt every frame.
+	Array< Renderer_Software_Draw > draws;
+	Array< Renderer_Software_Material_View > materials;
+	Renderer_Software_Setup_Job setup_jobs[ RENDERER_SOFTWARE_MAX_SETUP_JOBS ];
+	u32 setup_jobs_count;
+
+	Renderer_Software_Frame *frame;  // Being drawn.
+	Renderer_Software_Stats stats;
+	f32 srgb_to_linear[ 256 ];
+};
+
+void renderer_software_init( Renderer_Software *software, Allocator *allocator );
+void renderer_software_destroy( Renderer_Software *software );
+
+// Writes the instance data that changed.  A different `capacity` re-creates the mirror, all instances are written then.
+void renderer_software_update_instances( Renderer_Software *software, u32 capacity, u32 first_instance, ArrayView< Renderer_Instance_Data > instances );
+// Draws the frame into `color`, re-creating the buffers first if its dimensions changed.
+void renderer_software_draw( Renderer_Software *software, Renderer_Software_Frame *frame );
+// Binary PPM (P6) of the last drawn frame, the alpha is dropped.
+bool renderer_software_write_ppm( Renderer_Software *software, const char *file_path );
+
+struct Renderer_Software_Test {
+	u32 covered_pixels;
+	u32 expected_covered_pixels;  // Pixel centers on the grid's left and top borders are in, on its right and bottom borders out.
+	u32 checksum;                 // Of the frame's pixels.
+	u32 expected_checksum;
+};
+
+// Draws a grid of quads whose corners are on pixel centers, so the edges they share go through pixels,
+//   and checks its coverage and checksum.  Needs the job system.
+Renderer_Software_Test renderer_software_test();
+
+// Implemented by the OpenGL backend, they do nothing unless the software backend is running.
+// Writes the last drawn frame, see `renderer_software_write_ppm()`.
+bool renderer_screenshot_write_ppm( const char *file_path );
+Renderer_Software_Stats renderer_software_stats();
+
+#endif /* QLIGHT_RENDERER_SOFTWARE_H */
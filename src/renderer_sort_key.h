@@ -0,0 +1,23 @@
+#ifndef QLIGHT_RENDERER_SORT_KEY_H
+#define QLIGHT_RENDERER_SORT_KEY_H
+
+#include "common.h"
+
+/*
+	Render proxy sort key layout (from the most significant bit):
+	  [63..60]   4 bits -- Render pass
+	  [59..52]   8 bits -- Shader program index
+	  [51..36]  16 bits -- Material ID
+	  [35..20]  16 bits -- Mesh ID
+	  [19..0]   20 bits -- View depth, unused by proxies
+	Proxies are only re-sorted when they change, so they leave the depth at zero.
+	Proxies with the same material always end up next to each other,
+	  which is what `renderer_batches_build()` relies on.
+*/
+constexpr u32 RENDERER_SORT_KEY_PASS_SHIFT = 60;
+constexpr u32 RENDERER_SORT_KEY_PROGRAM_SHIFT = 52;
+constexpr u32 RENDERER_SORT_KEY_MATERIAL_SHIFT = 36;
+constexpr u32 RENDERER_SORT_KEY_MESH_SHIFT = 20;
+constexpr u32 RENDERER_SORT_KEY_DEPTH_BITS = 20;
+
+#endif /* QLIGHT_RENDERER_SORT_KEY_H */
@@ -0,0 +1,141 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "renderer_thread.h"
+
+#define QL_LOG_CHANNEL "Renderer"
+#include "log.h"
+
+struct G_Renderer_Thread {
+	std::thread thread;
+	GLFWwindow *window;
+	bool running;
+
+	std::mutex mutex;  // Guards everything below.
+	std::condition_variable packet_ready;
+	std::condition_variable packet_done;
+	Renderer_Frame_Packet *packet;  // Submitted and not drawn yet, NULL otherwise.
+	bool quit;
+
+	Renderer_Thread_Stats stats;
+} g_renderer_thread;
+
+static f32
+milliseconds_since( std::chrono::steady_clock::time_point start ) {
+	return std::chrono::duration< f32, std::milli >( std::chrono::steady_clock::now() - start ).count();
+}
+
+static void
+renderer_thread_main() {
+#ifndef QLIGHT_HEADLESS
+	glfwMakeContextCurrent( g_renderer_thread.window );
+	// Swap interval belongs to the context's current thread on some platforms.
+	glfwSwapInterval( 1 );
+#endif
+
+	while ( true ) {
+		Renderer_Frame_Packet *packet;
+		f32 stall_milliseconds;
+		{
+			auto wait_start = std::chrono::steady_clock::now();
+			std::unique_lock< std::mutex > lock( g_renderer_thread.mutex );
+			g_renderer_thread.packet_ready.wait( lock, [] { return g_renderer_thread.quit || g_renderer_thread.packet != NULL; } );
+			if ( g_renderer_thread.quit && g_renderer_thread.packet == NULL )
+				break;
+
+			packet = g_renderer_thread.packet;
+			stall_milliseconds = milliseconds_since( wait_start );
+		}
+
+		auto render_start = std::chrono::steady_clock::now();
+		renderer_frame_packet_execute( packet );
+#ifndef QLIGHT_HEADLESS
+		glfwSwapBuffers( g_renderer_thread.window );
+#endif
+		f32 render_milliseconds = milliseconds_since( render_start );
+
+		{
+			std::lock_guard< std::mutex > lock( g_renderer_thread.mutex );
+			g_renderer_thread.packet = NULL;
+			g_renderer_thread.stats.render_stall_milliseconds = stall_milliseconds;
+			g_renderer_thread.stats.render_milliseconds = render_milliseconds;
+			g_renderer_thread.stats.packets_drawn += 1;
+		}
+		g_renderer_thread.packet_done.notify_all();
+	}
+
+#ifndef QLIGHT_HEADLESS
+	glfwMakeContextCurrent( NULL );
+#endif
+}
+
+bool
+renderer_thread_start( GLFWwindow *window ) {
+	if ( g_renderer_thread.running )
+		return false;
+
+	g_renderer_thread.window = window;
+	g_renderer_thread.packet = NULL;
+	g_renderer_thread.quit = false;
+	g_renderer_thread.stats = Renderer_Thread_Stats { 0 };
+
+#ifndef QLIGHT_HEADLESS
+	// A context can be current on one thread at a time.
+	glfwMakeContextCurrent( NULL );
+#endif
+	g_renderer_thread.thread = std::thread( renderer_thread_main );
+	g_renderer_thread.running = true;
+	log_info( "Started the render thread." );
+	return true;
+}
+
+void
+renderer_thread_stop() {
+	if ( !g_renderer_thread.running )
+		return;
+
+	{
+		std::lock_guard< std::mutex > lock( g_renderer_thread.mutex );
+		g_renderer_thread.quit = true;
+	}
+	g_renderer_thread.packet_ready.notify_all();
+	g_renderer_thread.thread.join();
+	g_renderer_thread.running = false;
+
+#ifndef QLIGHT_HEADLESS
+	glfwMakeContextCurrent( g_renderer_thread.window );
+#endif
+	log_info( "Stopped the render thread after %llu packets.", ( unsigned long long )g_renderer_thread.stats.packets_drawn );
+}
+
+bool
+renderer_thread_running() {
+	return g_renderer_thread.running;
+}
+
+void
+renderer_thread_wait_idle() {
+	auto wait_start = std::chrono::steady_clock::now();
+	std::unique_lock< std::mutex > lock( g_renderer_thread.mutex );
+	g_renderer_thread.packet_done.wait( lock, [] { return g_renderer_thread.packet == NULL; } );
+	g_renderer_thread.stats.game_stall_milliseconds = milliseconds_since( wait_start );
+}
+
+void
+renderer_thread_submit( Renderer_Frame_Packet *packet ) {
+	Assert( g_renderer_thread.running );
+	{
+		std::lock_guard< std::mutex > lock( g_renderer_thread.mutex );
+		Assert( g_renderer_thread.packet == NULL );
+		g_renderer_thread.packet = packet;
+	}
+	g_renderer_thread.packet_ready.notify_one();
+}
+
+Renderer_Thread_Stats
+renderer_thread_stats() {
+	std::lock_guard< std::mutex > lock( g_renderer_thread.mutex );
+	return g_renderer_thread.stats;
+}
@@ -0,0 +1,46 @@
+#ifndef QLIGHT_RENDERER_THREAD_H
+#define QLIGHT_RENDERER_THREAD_H
+
+#include "renderer.h"
+
+/*
+	Render thread: owns the OpenGL context and draws frame packets.
+
+	A frame packet is everything needed to draw one frame, copied out of the game state
+	  by `renderer_draw_frame()`.  Once the thread is started the game thread never calls
+	  OpenGL, it only builds packets, so the render thread draws frame N while the game
+	  thread simulates frame N+1.  Packets live in two ping-pong arenas: the game thread
+	  fills one while the render thread reads the other.
+
+	`renderer_draw_frame()` hands a packet over only after the render thread is done with
+	  the previous one, which frees the arena the next packet is built in.  The frame time
+	  is then the longer of the two threads' frames rather than their sum.
+*/
+
+// Defined by the OpenGL backend.
+struct Renderer_Frame_Packet;
+
+struct Renderer_Thread_Stats {
+	f32 game_stall_milliseconds;    // Game thread waiting for the render thread to finish the previous packet.
+	f32 render_stall_milliseconds;  // Render thread waiting for a packet before the last one.
+	f32 render_milliseconds;        // Render thread drawing the last packet, buffer swap included.
+	u64 packets_drawn;
+};
+
+// Moves the window's context, which must be current on the calling thread, to a new render thread.
+bool renderer_thread_start( GLFWwindow *window );
+// Finishes the packet in flight, stops the thread and makes the context current on the calling thread again.
+void renderer_thread_stop();
+bool renderer_thread_running();
+
+// Blocks until the render thread is done with the last packet.
+void renderer_thread_wait_idle();
+// The render thread must be idle.  The packet must stay untouched until the next `renderer_thread_wait_idle()`.
+void renderer_thread_submit( Renderer_Frame_Packet *packet );
+
+Renderer_Thread_Stats renderer_thread_stats();
+
+// Draws the packet on the calling thread, which must have the context current.  Implemented by the OpenGL backend.
+void renderer_frame_packet_execute( Renderer_Frame_Packet *packet );
+
+#endif /* QLIGHT_RENDERER_THREAD_H */
@@ -61,6 +61,8 @@ Texture_ID texture_create(
 		.opengl_pixel_type = 0,
 		// .bytes
 		// .opengl_id
+		.texture_array_pool_id = INVALID_TEXTURE_ARRAY_POOL_ID,
+		.texture_array_layer = 0
 	};
 
 	if ( allocator ) {
@@ -163,8 +165,10 @@ Texture_ID texture_load_from_file(
 		.channels = desired_channels,
 		.opengl_storage_format = 0,
 		.opengl_pixel_type = 0,
-		.bytes = texture_data
+		.bytes = texture_data,
 		// .opengl_id - generated on upload
+		.texture_array_pool_id = INVALID_TEXTURE_ARRAY_POOL_ID,
+		.texture_array_layer = 0
 	};
 
 	Texture_ID texture_id = array_add( &g_textures.textures, texture );
@@ -23,6 +23,10 @@ enum Texture_Channels : u16 {
 	TextureChannels_DepthStencil
 };
 
+// Index of a texture array pool, i.e. same-sized textures sharing one array texture.
+typedef u8 Texture_Array_Pool_ID;
+constexpr Texture_Array_Pool_ID INVALID_TEXTURE_ARRAY_POOL_ID = U8_MAX;
+
 struct Texture {
 	StringView_ASCII name;
 	StringView_ASCII file_path;
@@ -42,7 +46,10 @@ struct Texture {
 	Array< u8 > bytes;
 
 	// OpenGL-specific:
-	GLuint opengl_id;
+	GLuint opengl_id;  // For textures in a texture array pool, a 2D view of their layer.
+	// `INVALID_TEXTURE_ARRAY_POOL_ID` unless uploaded with `renderer_texture_array_upload()`.
+	Texture_Array_Pool_ID texture_array_pool_id;
+	u16 texture_array_layer;
 };
 
 typedef u16 Texture_ID;
@@ -0,0 +1,816 @@
+#include <stddef.h> // offsetof()
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#if defined(QLIGHT_PLATFORM_WINDOWS)
+	#include <intrin.h> // _BitScanForward(), _BitScanReverse64()
+#endif
+
+#include "tlsf_allocator.h"
+
+#define QL_LOG_CHANNEL "TLSF"
+#include "log.h"
+
+constexpr u64 TLSF_BLOCK_FREE = 1 << 0;
+constexpr u64 TLSF_BLOCK_PREVIOUS_FREE = 1 << 1;
+constexpr u64 TLSF_BLOCK_FLAGS = TLSF_BLOCK_FREE | TLSF_BLOCK_PREVIOUS_FREE;
+
+// Only `size` is paid for by a used block, `previous_physical` is in the previous block.
+constexpr u64 TLSF_BLOCK_HEADER_OVERHEAD = sizeof( u64 );
+// Of a block's memory from its header.
+constexpr u64 TLSF_BLOCK_START_OFFSET = offsetof( TLSF_Block, next_free );
+// Enough to hold the free list links when the block is freed.
+constexpr u64 TLSF_BLOCK_SIZE_MIN = sizeof( TLSF_Block ) - sizeof( TLSF_Block * );
+constexpr u64 TLSF_BLOCK_SIZE_MAX = ( u64 )1 << TLSF_FL_INDEX_MAX;
+constexpr u64 TLSF_SMALL_BLOCK_SIZE = ( u64 )1 << TLSF_FL_INDEX_SHIFT;
+// The first block's header and the zero-sized block closing the arena.
+constexpr u64 TLSF_ARENA_OVERHEAD = 2 * TLSF_BLOCK_HEADER_OVERHEAD;
+
+static_assert( TLSF_ALIGN_SIZE == TLSF_SMALL_BLOCK_SIZE / TLSF_SL_INDEX_COUNT, "Small blocks must fill the first level in 'TLSF_ALIGN_SIZE' steps" );
+static_assert( TLSF_FL_INDEX_COUNT <= 32 && TLSF_SL_INDEX_COUNT <= 32, "Both levels' bitmaps must fit into 'u32'" );
+
+// Lowest set bit.
+static u32
+bit_scan_forward( u32 word ) {
+#if defined(QLIGHT_PLATFORM_WINDOWS)
+	unsigned long index;
+	_BitScanForward( &index, word );
+	return ( u32 )index;
+#else
+	return ( u32 )__builtin_ctz( word );
+#endif
+}
+
+// Highest set bit.
+static u32
+bit_scan_reverse( u64 word ) {
+#if defined(QLIGHT_PLATFORM_WINDOWS)
+	unsigned long index;
+	_BitScanReverse64( &index, word );
+	return ( u32 )index;
+#else
+	return 63 - ( u32 )__builtin_clzll( word );
+#endif
+}
+
+static u64
+align_up( u64 x, u64 alignment ) {
+	return ( x + alignment - 1 ) & ~( alignment - 1 );
+}
+
+// Items are aligned to their size's largest power of 2 divisor, at most 16 bytes, as `Linear_Allocator` does.
+static u64
+item_alignment( u64 size ) {
+	u64 alignment = size & ( ~size + 1 );
+	return ( alignment == 0 || alignment > 16 ) ? 16 : alignment;
+}
+
+/*
+	Blocks.
+*/
+
+static u64
+block_size( TLSF_Block *block ) {
+	return block->size & ~TLSF_BLOCK_FLAGS;
+}
+
+static void
+block_set_size( TLSF_Block *block, u64 size ) {
+	block->size = size | ( block->size & TLSF_BLOCK_FLAGS );
+}
+
+static bool
+block_is_last( TLSF_Block *block ) {
+	return block_size( block ) == 0;
+}
+
+static bool
+block_is_free( TLSF_Block *block ) {
+	return ( block->size & TLSF_BLOCK_FREE ) != 0;
+}
+
+static bool
+block_is_previous_free( TLSF_Block *block ) {
+	return ( block->size & TLSF_BLOCK_PREVIOUS_FREE ) != 0;
+}
+
+static void
+block_set_flag( TLSF_Block *block, u64 flag, bool value ) {
+	block->size = ( value ) ? ( block->size | flag ) : ( block->size & ~flag );
+}
+
+static u8 *
+block_to_memory( TLSF_Block *block ) {
+	return ( u8 * )block + TLSF_BLOCK_START_OFFSET;
+}
+
+static TLSF_Block *
+block_from_memory( void *memory ) {
+	return ( TLSF_Block * )( ( u8 * )memory - TLSF_BLOCK_START_OFFSET );
+}
+
+static TLSF_Block *
+block_next( TLSF_Block *block ) {
+	AssertMessage( !block_is_last( block ), "The last block of a TLSF arena has no next block" );
+	return ( TLSF_Block * )( block_to_memory( block ) + block_size( block ) - TLSF_BLOCK_HEADER_OVERHEAD );
+}
+
+// Tells the next block where this one is, returns it.
+static TLSF_Block *
+block_link_next( TLSF_Block *block ) {
+	TLSF_Block *next = block_next( block );
+	next->previous_physical = block;
+	return next;
+}
+
+static void
+block_mark_as_free( TLSF_Block *block ) {
+	TLSF_Block *next = block_link_next( block );
+	block_set_flag( next, TLSF_BLOCK_PREVIOUS_FREE, true );
+	block_set_flag( block, TLSF_BLOCK_FREE, true );
+}
+
+static void
+block_mark_as_used( TLSF_Block *block ) {
+	TLSF_Block *next = block_next( block );
+	block_set_flag( next, TLSF_BLOCK_PREVIOUS_FREE, false );
+	block_set_flag( block, TLSF_BLOCK_FREE, false );
+}
+
+/*
+	Size classes.
+*/
+
+// Class of a block of that size, the list a free block goes into.
+static void
+mapping_insert( u64 size, u32 *out_fl, u32 *out_sl ) {
+	if ( size < TLSF_SMALL_BLOCK_SIZE ) {
+		*out_fl = 0;
+		*out_sl = ( u32 )( size / ( TLSF_SMALL_BLOCK_SIZE / TLSF_SL_INDEX_COUNT ) );
+	} else {
+		u32 fl = bit_scan_reverse( size );
+		*out_sl = ( u32 )( size >> ( fl - TLSF_SL_INDEX_COUNT_LOG2 ) ) ^ TLSF_SL_INDEX_COUNT;
+		*out_fl = fl - ( TLSF_FL_INDEX_SHIFT - 1 );
+	}
+}
+
+// First class whose every block fits the size, the one a search starts from.
+static void
+mapping_search( u64 size, u32 *out_fl, u32 *out_sl ) {
+	if ( size >= TLSF_SMALL_BLOCK_SIZE )
+		size += ( ( u64 )1 << ( bit_scan_reverse( size ) - TLSF_SL_INDEX_COUNT_LOG2 ) ) - 1;
+	mapping_insert( size, out_fl, out_sl );
+}
+
+// Size of the block that serves a request, 0 if none can.
+static u64
+adjust_request_size( u64 size, u64 alignment ) {
+	u64 aligned = align_up( size, alignment );
+	if ( aligned >= TLSF_BLOCK_SIZE_MAX )
+		return 0;
+	return ( aligned < TLSF_BLOCK_SIZE_MIN ) ? TLSF_BLOCK_SIZE_MIN : aligned;
+}
+
+/*
+	Free lists.
+*/
+
+static void
+free_list_remove( TLSF_Allocator *tlsf, TLSF_Block *block, u32 fl, u32 sl ) {
+	TLSF_Block *previous = block->previous_free;
+	TLSF_Block *next = block->next_free;
+	next->previous_free = previous;
+	previous->next_free = next;
+
+	if ( tlsf->free_lists[ fl ][ sl ] == block ) {
+		tlsf->free_lists[ fl ][ sl ] = next;
+		if ( next == &tlsf->null_block ) {
+			tlsf->sl_bitmaps[ fl ] &= ~( 1u << sl );
+			if ( tlsf->sl_bitmaps[ fl ] == 0 )
+				tlsf->fl_bitmap &= ~( 1u << fl );
+		}
+	}
+}
+
+static void
+free_list_insert( TLSF_Allocator *tlsf, TLSF_Block *block, u32 fl, u32 sl ) {
+	TLSF_Block *current = tlsf->free_lists[ fl ][ sl ];
+	block->next_free = current;
+	block->previous_free = &tlsf->null_block;
+	current->previous_free = block;
+
+	tlsf->free_lists[ fl ][ sl ] = block;
+	tlsf->fl_bitmap |= 1u << fl;
+	tlsf->sl_bitmaps[ fl ] |= 1u << sl;
+}
+
+static void
+block_remove( TLSF_Allocator *tlsf, TLSF_Block *block ) {
+	u32 fl, sl;
+	mapping_insert( block_size( block ), &fl, &sl );
+	free_list_remove( tlsf, block, fl, sl );
+}
+
+static void
+block_insert( TLSF_Allocator *tlsf, TLSF_Block *block ) {
+	u32 fl, sl;
+	mapping_insert( block_size( block ), &fl, &sl );
+	free_list_insert( tlsf, block, fl, sl );
+}
+
+// First free block of the class or of any bigger one.  Updates the class to the block's one.
+static TLSF_Block *
+search_suitable_block( TLSF_Allocator *tlsf, u32 *fl, u32 *sl ) {
+	u32 sl_map = tlsf->sl_bitmaps[ *fl ] & ( ~0u << *sl );
+	if ( sl_map == 0 ) {
+		// `<< 32` is undefined, the last first level has no bigger one.
+		u32 fl_map = ( *fl + 1 < 32 ) ? tlsf->fl_bitmap & ( ~0u << ( *fl + 1 ) ) : 0;
+		if ( fl_map == 0 )
+			return NULL;
+
+		*fl = bit_scan_forward( fl_map );
+		sl_map = tlsf->sl_bitmaps[ *fl ];
+	}
+	*sl = bit_scan_forward( sl_map );
+	return tlsf->free_lists[ *fl ][ *sl ];
+}
+
+/*
+	Splitting and merging.
+*/
+
+static bool
+block_can_split( TLSF_Block *block, u64 size ) {
+	return block_size( block ) >= sizeof( TLSF_Block ) + size;
+}
+
+// Cuts the block down to `size`, returns the free rest.
+static TLSF_Block *
+block_split( TLSF_Block *block, u64 size ) {
+	TLSF_Block *remaining = ( TLSF_Block * )( block_to_memory( block ) + size - TLSF_BLOCK_HEADER_OVERHEAD );
+	u64 remaining_size = block_size( block ) - ( size + TLSF_BLOCK_HEADER_OVERHEAD );
+	AssertMessage( remaining_size >= TLSF_BLOCK_SIZE_MIN, "TLSF block split below the minimum size" );
+
+	remaining->size = remaining_size;
+	block_set_size( block, size );
+	block_mark_as_free( remaining );
+	return remaining;
+}
+
+// Merges the block into the previous one, which is returned.
+static TLSF_Block *
+block_absorb( TLSF_Block *previous, TLSF_Block *block ) {
+	previous->size += block_size( block ) + TLSF_BLOCK_HEADER_OVERHEAD;
+	block_link_next( previous );
+	return previous;
+}
+
+static TLSF_Block *
+block_merge_previous( TLSF_Allocator *tlsf, TLSF_Block *block ) {
+	if ( block_is_previous_free( block ) ) {
+		TLSF_Block *previous = block->previous_physical;
+		block_remove( tlsf, previous );
+		block = block_absorb( previous, block );
+	}
+	return block;
+}
+
+static TLSF_Block *
+block_merge_next( TLSF_Allocator *tlsf, TLSF_Block *block ) {
+	TLSF_Block *next = block_next( block );
+	if ( block_is_free( next ) ) {
+		block_remove( tlsf, next );
+		block = block_absorb( block, next );
+	}
+	return block;
+}
+
+// Gives what a free block has past `size` back to the free lists.
+static void
+block_trim_free( TLSF_Allocator *tlsf, TLSF_Block *block, u64 size ) {
+	if ( block_can_split( block, size ) ) {
+		TLSF_Block *remaining = block_split( block, size );
+		block_link_next( block );
+		block_set_flag( remaining, TLSF_BLOCK_PREVIOUS_FREE, true );
+		block_insert( tlsf, remaining );
+	}
+}
+
+// The same for a used block, the rest is merged with the next block if that is free.
+static void
+block_trim_used( TLSF_Allocator *tlsf, TLSF_Block *block, u64 size ) {
+	if ( block_can_split( block, size ) ) {
+		TLSF_Block *remaining = block_split( block, size );
+		block_set_flag( remaining, TLSF_BLOCK_PREVIOUS_FREE, false );
+		remaining = block_merge_next( tlsf, remaining );
+		block_insert( tlsf, remaining );
+	}
+}
+
+// Gives the first `size` bytes of a free block back, returns the block after them.
+static TLSF_Block *
+block_trim_free_leading( TLSF_Allocator *tlsf, TLSF_Block *block, u64 size ) {
+	TLSF_Block *remaining = block;
+	if ( block_can_split( block, size ) ) {
+		remaining = block_split( block, size - TLSF_BLOCK_HEADER_OVERHEAD );
+		block_set_flag( remaining, TLSF_BLOCK_PREVIOUS_FREE, true );
+		block_link_next( block );
+		block_insert( tlsf, block );
+	}
+	return remaining;
+}
+
+static TLSF_Block *
+block_locate_free( TLSF_Allocator *tlsf, u64 size ) {
+	u32 fl, sl;
+	mapping_search( size, &fl, &sl );
+	if ( fl >= TLSF_FL_INDEX_COUNT )
+		return NULL;
+
+	TLSF_Block *block = search_suitable_block( tlsf, &fl, &sl );
+	if ( block ) {
+		AssertMessage( block_size( block ) >= size, "TLSF free list holds a block too small for its class" );
+		free_list_remove( tlsf, block, fl, sl );
+	}
+	return block;
+}
+
+static u8 *
+block_prepare_used( TLSF_Allocator *tlsf, TLSF_Block *block, u64 size ) {
+	block_trim_free( tlsf, block, size );
+	block_mark_as_used( block );
+	return block_to_memory( block );
+}
+
+/*
+	Arenas.
+*/
+
+// Takes an arena that holds a block of `size` at least, false past the budget.
+static bool
+tlsf_add_arena( TLSF_Allocator *tlsf, u64 size ) {
+	if ( tlsf->arenas_count == TLSF_MAX_ARENAS )
+		return false;
+
+	// Growing with the heap, so `TLSF_MAX_ARENAS` runs out only past what the address space holds.
+	u64 bytes = QL_max2( tlsf->arena_size, tlsf->arenas_size / 2 );
+	bytes = align_up( QL_max2( bytes, size + TLSF_ARENA_OVERHEAD ), TLSF_ALIGN_SIZE );
+	if ( tlsf->budget > 0 ) {
+		u64 budget_left = tlsf->budget - tlsf->arenas_size;
+		if ( bytes > budget_left ) {
+			// The rest of the budget may still do.
+			bytes = budget_left & ~( TLSF_ALIGN_SIZE - 1 );
+			if ( bytes < size + TLSF_ARENA_OVERHEAD )
+				return false;
+		}
+	}
+	if ( bytes - TLSF_ARENA_OVERHEAD >= TLSF_BLOCK_SIZE_MAX )
+		return false;
+
+	u8 *arena = tlsf->backing_allocator->do_allocate( 1, bytes, QL_AllocatorEmptyCaller() );
+	if ( !arena )
+		return false;
+
+	tlsf->arenas[ tlsf->arenas_count ] = arena;
+	tlsf->arena_sizes[ tlsf->arenas_count ] = bytes;
+	tlsf->arenas_count += 1;
+	tlsf->arenas_size += bytes;
+
+	// The first block's `previous_physical` would be in front of the arena, it is never read,
+	//   as there is no previous block to be free.
+	TLSF_Block *block = ( TLSF_Block * )( arena - TLSF_BLOCK_HEADER_OVERHEAD );
+	block->size = bytes - TLSF_ARENA_OVERHEAD;
+	block_set_flag( block, TLSF_BLOCK_FREE, true );
+	block_set_flag( block, TLSF_BLOCK_PREVIOUS_FREE, false );
+	block_insert( tlsf, block );
+
+	// Zero-sized, used, so no block ever merges past the end.
+	TLSF_Block *last = block_link_next( block );
+	last->size = 0;
+	block_set_flag( last, TLSF_BLOCK_FREE, false );
+	block_set_flag( last, TLSF_BLOCK_PREVIOUS_FREE, true );
+	return true;
+}
+
+static TLSF_Block *
+tlsf_locate_or_grow( TLSF_Allocator *tlsf, u64 size ) {
+	TLSF_Block *block = block_locate_free( tlsf, size );
+	if ( block )
+		return block;
+
+	// The new arena's block must be found by `mapping_search()` for this size, so it is rounded up the same way.
+	u64 search_size = size;
+	if ( search_size >= TLSF_SMALL_BLOCK_SIZE )
+		search_size += ( ( u64 )1 << ( bit_scan_reverse( search_size ) - TLSF_SL_INDEX_COUNT_LOG2 ) );
+	if ( !tlsf_add_arena( tlsf, search_size ) )
+		return NULL;
+
+	return block_locate_free( tlsf, size );
+}
+
+void
+TLSF_Allocator::init( Allocator *backing_allocator, u64 arena_size, u64 budget ) {
+	AssertMessage( backing_allocator, "Trying to initialize 'TLSF_Allocator' without a backing allocator" );
+	this->backing_allocator = backing_allocator;
+	this->arena_size = arena_size;
+	this->budget = budget;
+	arenas_count = 0;
+	arenas_size = 0;
+
+	null_block.next_free = &null_block;
+	null_block.previous_free = &null_block;
+	fl_bitmap = 0;
+	For( TLSF_FL_INDEX_COUNT ) {
+		sl_bitmaps[ it_index ] = 0;
+		for ( u32 sl = 0; sl < TLSF_SL_INDEX_COUNT; sl += 1 )
+			free_lists[ it_index ][ sl ] = &null_block;
+	}
+}
+
+void
+TLSF_Allocator::deinit() {
+	For( arenas_count ) {
+		Deallocate( backing_allocator, arenas[ it_index ] );
+	}
+	init( backing_allocator, arena_size, budget );
+}
+
+u8 *
+TLSF_Allocator::allocate_aligned( u64 size, u64 alignment ) {
+	AssertMessage( ( alignment & ( alignment - 1 ) ) == 0, "Allocation alignment must be power of 2" );
+	u64 adjusted = adjust_request_size( size, TLSF_ALIGN_SIZE );
+	if ( adjusted == 0 )
+		return NULL;
+
+	if ( alignment <= TLSF_ALIGN_SIZE ) {
+		TLSF_Block *block = tlsf_locate_or_grow( this, adjusted );
+		return ( block ) ? block_prepare_used( this, block, adjusted ) : NULL;
+	}
+
+	// Room to move the start up to the alignment, leaving a gap big enough to be a free block.
+	u64 gap_minimum = sizeof( TLSF_Block );
+	u64 size_with_gap = adjust_request_size( adjusted + alignment + gap_minimum, alignment );
+	if ( size_with_gap == 0 )
+		return NULL;
+
+	TLSF_Block *block = tlsf_locate_or_grow( this, size_with_gap );
+	if ( !block )
+		return NULL;
+
+	u8 *memory = block_to_memory( block );
+	u8 *aligned = ( u8 * )align_up( ( u64 )memory, alignment );
+	u64 gap = aligned - memory;
+	if ( gap > 0 && gap < gap_minimum ) {
+		u64 offset = QL_max2( gap_minimum - gap, alignment );
+		aligned = ( u8 * )align_up( ( u64 )( aligned + offset ), alignment );
+		gap = aligned - memory;
+	}
+	if ( gap > 0 )
+		block = block_trim_free_leading( this, block, gap );
+
+	return block_prepare_used( this, block, adjusted );
+}
+
+u8 *
+TLSF_Allocator::do_allocate( u64 count, u64 size, CallerInfo caller ) {
+	return allocate_aligned( count * size, item_alignment( size ) );
+}
+
+u8 *
+TLSF_Allocator::do_reallocate( void *memory_pointer, u64 old_count, u64 new_count, u64 size, CallerInfo caller ) {
+	if ( !memory_pointer )
+		return do_allocate( new_count, size, caller );
+
+	TLSF_Block *block = block_from_memory( memory_pointer );
+	AssertMessage( !block_is_free( block ), "Reallocating a TLSF block that is free" );
+	u64 current_size = block_size( block );
+	u64 adjusted = adjust_request_size( new_count * size, TLSF_ALIGN_SIZE );
+	if ( adjusted == 0 )
+		return NULL;
+
+	TLSF_Block *next = block_next( block );
+	u64 combined_size = current_size + block_size( next ) + TLSF_BLOCK_HEADER_OVERHEAD;
+	if ( adjusted > current_size && ( !block_is_free( next ) || adjusted > combined_size ) ) {
+		u8 *moved = do_allocate( new_count, size, caller );
+		if ( !moved )
+			return NULL;
+
+		memcpy( moved, memory_pointer, QL_min2( current_size, new_count * size ) );
+		do_deallocate( memory_pointer, caller );
+		return moved;
+	}
+
+	if ( adjusted > current_size ) {
+		block_merge_next( this, block );
+		block_mark_as_used( block );
+	}
+	block_trim_used( this, block, adjusted );
+	return ( u8 * )memory_pointer;
+}
+
+void
+TLSF_Allocator::do_deallocate( void *memory_pointer, CallerInfo caller ) {
+	TLSF_Block *block = block_from_memory( memory_pointer );
+	AssertMessage( !block_is_free( block ), "Freeing a TLSF block twice" );
+	block_mark_as_free( block );
+	block = block_merge_previous( this, block );
+	block = block_merge_next( this, block );
+	block_insert( this, block );
+}
+
+TLSF_Stats
+TLSF_Allocator::stats() {
+	TLSF_Stats stats = { 0 };
+	stats.arenas_size = arenas_size;
+	For( arenas_count ) {
+		TLSF_Block *block = ( TLSF_Block * )( arenas[ it_index ] - TLSF_BLOCK_HEADER_OVERHEAD );
+		while ( !block_is_last( block ) ) {
+			u64 size = block_size( block );
+			if ( block_is_free( block ) ) {
+				stats.free_bytes += size;
+				stats.largest_free_block = QL_max2( stats.largest_free_block, size );
+				stats.free_blocks_count += 1;
+			} else {
+				stats.used_bytes += size + TLSF_BLOCK_HEADER_OVERHEAD;
+				stats.used_blocks_count += 1;
+			}
+			block = block_next( block );
+		}
+	}
+	return stats;
+}
+
+/*
+	Benchmark.
+*/
+
+// Arenas of the benchmark's allocator, in the range of the texture bytes it will see.
+constexpr u64 TLSF_BENCHMARK_ARENA_SIZE = 64 * 1024 * 1024;
+
+// An event with its block told by an index instead of an address.
+struct TLSF_Replay_Op {
+	u32 block_idx;
+	Heap_Trace_Op op;
+	u32 size;
+	u64 count;
+};
+
+// Open addressing from the trace's addresses to block indices.  Freed entries are kept as
+//   tombstones, as every address is inserted at most once per event there is always room.
+struct TLSF_Replay_Table {
+	u64 *keys;  // 0 - empty, 1 - freed.
+	u32 *values;
+	u64 mask;
+};
+
+static u64 *
+replay_table_find( TLSF_Replay_Table *table, u64 key, bool insert ) {
+	u64 idx = ( key * 0x9E3779B97F4A7C15ull >> 17 ) & table->mask;
+	u64 *tombstone = NULL;
+	while ( true ) {
+		u64 *slot = &table->keys[ idx ];
+		if ( *slot == key )
+			return slot;
+		if ( *slot == 0 )
+			return ( insert ) ? ( ( tombstone ) ? tombstone : slot ) : NULL;
+		if ( *slot == 1 && !tombstone )
+			tombstone = slot;
+		idx = ( idx + 1 ) & table->mask;
+	}
+}
+
+// Turns addresses into indices, drops events on blocks the trace did not see allocated.
+static u32
+replay_ops_build( ArrayView< Heap_Trace_Event > events, TLSF_Replay_Op *ops, u32 *out_blocks_count ) {
+	u64 table_size = 64;
+	while ( table_size < ( u64 )events.size * 2 )
+		table_size *= 2;
+
+	TLSF_Replay_Table table = {
+		.keys = ( u64 * )calloc( table_size, sizeof( u64 ) ),
+		.values = ( u32 * )malloc( table_size * sizeof( u32 ) ),
+		.mask = table_size - 1
+	};
+
+	u32 ops_count = 0;
+	u32 blocks_count = 0;
+	ForIt( events.data, events.size ) {
+		TLSF_Replay_Op op = { 0, it.op, it.size, it.count };
+		if ( it.op == HeapTraceOp_Reallocate ) {
+			u64 *old_slot = replay_table_find( &table, it.old_pointer, false );
+			if ( old_slot ) {
+				op.block_idx = table.values[ old_slot - table.keys ];
+				*old_slot = 1;
+			} else {
+				// Its block is older than the trace, it is a new one from here on.
+				op.op = HeapTraceOp_Allocate;
+				op.block_idx = blocks_count;
+				blocks_count += 1;
+			}
+		} else if ( it.op == HeapTraceOp_Allocate ) {
+			op.block_idx = blocks_count;
+			blocks_count += 1;
+		} else {
+			u64 *slot = replay_table_find( &table, it.pointer, false );
+			if ( !slot )
+				continue;
+
+			op.block_idx = table.values[ slot - table.keys ];
+			*slot = 1;
+			ops[ ops_count ] = op;
+			ops_count += 1;
+			continue;
+		}
+
+		// An address still in the table was freed on another thread without its event making it first.
+		u64 *slot = replay_table_find( &table, it.pointer, true );
+		*slot = it.pointer;
+		table.values[ slot - table.keys ] = op.block_idx;
+		ops[ ops_count ] = op;
+		ops_count += 1;
+	}}
+
+	free( table.keys );
+	free( table.values );
+	*out_blocks_count = blocks_count;
+	return ops_count;
+}
+
+static int
+compare_u64( const void *lhs, const void *rhs ) {
+	u64 a = *( const u64 * )lhs;
+	u64 b = *( const u64 * )rhs;
+	return ( a > b ) - ( a < b );
+}
+
+static TLSF_Latency
+latency_from_samples( u64 *samples, u32 samples_count ) {
+	TLSF_Latency latency = { 0 };
+	if ( samples_count == 0 )
+		return latency;
+
+	u64 total_ns = 0;
+	For( samples_count ) {
+		total_ns += samples[ it_index ];
+	}
+	qsort( samples, samples_count, sizeof( u64 ), compare_u64 );
+	auto percentile = [&]( u32 per_mille ) -> u64 {
+		return samples[ ( u64 )( samples_count - 1 ) * per_mille / 1000 ];
+	};
+	latency.percentile_50_ns = percentile( 500 );
+	latency.percentile_90_ns = percentile( 900 );
+	latency.percentile_99_ns = percentile( 990 );
+	latency.percentile_999_ns = percentile( 999 );
+	latency.max_ns = samples[ samples_count - 1 ];
+	latency.total_milliseconds = ( f64 )total_ns / 1000000.0;
+	return latency;
+}
+
+// Size of the memory a block really takes, header included.
+typedef u64 ( *Replay_Block_Size )( void *memory );
+
+static u64
+system_block_size( void *memory ) {
+	return platform_malloc_usable_size( memory ) + sizeof( u64 );
+}
+
+static u64
+tlsf_block_size( void *memory ) {
+	return block_size( block_from_memory( memory ) ) + TLSF_BLOCK_HEADER_OVERHEAD;
+}
+
+struct TLSF_Replay {
+	Allocator *allocator;
+	Replay_Block_Size block_size;
+	TLSF_Replay_Op *ops;
+	u32 ops_count;
+	u32 peak_op_idx;  // The peak is measured right after this one.
+	u8 **blocks;
+	u64 *block_bytes;  // Real size of every live block.
+	u64 *samples;
+	u64 peak_block_bytes;
+};
+
+static void
+replay_run( TLSF_Replay *replay, u32 blocks_count ) {
+	memset( replay->blocks, 0, ( u64 )blocks_count * sizeof( u8 * ) );
+	u64 live_block_bytes = 0;
+	ForIt( replay->ops, replay->ops_count ) {
+		u8 **block = &replay->blocks[ it.block_idx ];
+		u64 *bytes = &replay->block_bytes[ it.block_idx ];
+		auto start = std::chrono::steady_clock::now();
+		if ( it.op == HeapTraceOp_Allocate )
+			*block = replay->allocator->do_allocate( it.count, it.size, QL_AllocatorEmptyCaller() );
+		else if ( it.op == HeapTraceOp_Reallocate )
+			*block = replay->allocator->do_reallocate( *block, 0, it.count, it.size, QL_AllocatorEmptyCaller() );
+		else
+			replay->allocator->do_deallocate( *block, QL_AllocatorEmptyCaller() );
+		replay->samples[ it_index ] = ( u64 )std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - start ).count();
+		AssertMessage( it.op == HeapTraceOp_Deallocate || *block, "Allocation trace replay ran out of memory" );
+
+		if ( it.op != HeapTraceOp_Allocate )
+			live_block_bytes -= *bytes;
+		if ( it.op == HeapTraceOp_Deallocate ) {
+			*block = NULL;
+			*bytes = 0;
+		} else {
+			*bytes = replay->block_size( *block );
+			live_block_bytes += *bytes;
+		}
+		if ( it_index == replay->peak_op_idx )
+			replay->peak_block_bytes = live_block_bytes;
+	}}
+}
+
+static void
+replay_free_live_blocks( TLSF_Replay *replay, u32 blocks_count ) {
+	For( blocks_count ) {
+		if ( replay->blocks[ it_index ] )
+			replay->allocator->do_deallocate( replay->blocks[ it_index ], QL_AllocatorEmptyCaller() );
+	}
+}
+
+TLSF_Benchmark
+tlsf_allocator_benchmark( ArrayView< Heap_Trace_Event > events ) {
+	TLSF_Benchmark result = { 0 };
+	if ( events.size == 0 )
+		return result;
+
+	// Straight from `malloc()`, so the replay's own memory stays out of both allocators' way.
+	TLSF_Replay_Op *ops = ( TLSF_Replay_Op * )malloc( ( u64 )events.size * sizeof( TLSF_Replay_Op ) );
+	u32 blocks_count = 0;
+	u32 ops_count = replay_ops_build( events, ops, &blocks_count );
+	result.events_count = ops_count;
+
+	// Find the moment most bytes are live, from what was asked for.
+	u64 *requested = ( u64 * )calloc( QL_max2( blocks_count, 1u ), sizeof( u64 ) );
+	u64 live_bytes = 0;
+	u32 live_blocks = 0;
+	u32 peak_op_idx = 0;
+	ForIt( ops, ops_count ) {
+		u64 *bytes = &requested[ it.block_idx ];
+		live_bytes -= *bytes;
+		*bytes = ( it.op == HeapTraceOp_Deallocate ) ? 0 : it.count * it.size;
+		live_bytes += *bytes;
+		if ( it.op == HeapTraceOp_Allocate )
+			live_blocks += 1;
+		else if ( it.op == HeapTraceOp_Deallocate )
+			live_blocks -= 1;
+		if ( live_bytes > result.peak_live_bytes ) {
+			result.peak_live_bytes = live_bytes;
+			result.peak_live_blocks = live_blocks;
+			peak_op_idx = it_index;
+		}
+	}}
+	free( requested );
+
+	System_Allocator system_allocator;
+	TLSF_Allocator tlsf;
+	tlsf.init( &system_allocator, TLSF_BENCHMARK_ARENA_SIZE, 0 );
+
+	TLSF_Replay replay = {
+		.allocator = &system_allocator,
+		.block_size = system_block_size,
+		.ops = ops,
+		.ops_count = ops_count,
+		.peak_op_idx = peak_op_idx,
+		.blocks = ( u8 ** )malloc( QL_max2( blocks_count, 1u ) * sizeof( u8 * ) ),
+		.block_bytes = ( u64 * )calloc( QL_max2( blocks_count, 1u ), sizeof( u64 ) ),
+		.samples = ( u64 * )malloc( QL_max2( ops_count, 1u ) * sizeof( u64 ) ),
+		.peak_block_bytes = 0
+	};
+	// Each allocator replays the trace once first, so the timed replay sees a heap that has been in use,
+	//   not the page faults of memory touched for the first time.
+	replay_run( &replay, blocks_count );
+	replay_free_live_blocks( &replay, blocks_count );
+	replay_run( &replay, blocks_count );
+	replay_free_live_blocks( &replay, blocks_count );
+	result.system = latency_from_samples( replay.samples, ops_count );
+	result.system_block_overhead = ( result.peak_live_bytes > 0 ) ? ( f64 )replay.peak_block_bytes / ( f64 )result.peak_live_bytes : 0.0;
+
+	// The arenas are taken during the warm-up, as a heap of its own would take them.
+	replay.allocator = &tlsf;
+	replay.block_size = tlsf_block_size;
+	replay_run( &replay, blocks_count );
+	replay_free_live_blocks( &replay, blocks_count );
+	replay_run( &replay, blocks_count );
+	result.tlsf = latency_from_samples( replay.samples, ops_count );
+	result.tlsf_block_overhead = ( result.peak_live_bytes > 0 ) ? ( f64 )replay.peak_block_bytes / ( f64 )result.peak_live_bytes : 0.0;
+	result.tlsf_arenas_size = tlsf.arenas_size;
+
+	// Replayed up to the peak once more on fresh arenas, to see how the free memory is scattered right then.
+	replay_free_live_blocks( &replay, blocks_count );
+	tlsf.deinit();
+	replay.ops_count = peak_op_idx + 1;
+	replay_run( &replay, blocks_count );
+	TLSF_Stats stats = tlsf.stats();
+	result.tlsf_external_fragmentation = ( stats.free_bytes > 0 ) ? 1.0 - ( f64 )stats.largest_free_block / ( f64 )stats.free_bytes : 0.0;
+	replay_free_live_blocks( &replay, blocks_count );
+	tlsf.deinit();
+
+	free( replay.blocks );
+	free( replay.block_bytes );
+	free( replay.samples );
+	free( ops );
+	return result;
+}
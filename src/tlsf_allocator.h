@@ -0,0 +1,112 @@
+#ifndef QLIGHT_TLSF_ALLOCATOR_H
+#define QLIGHT_TLSF_ALLOCATOR_H
+
+#include "allocator.h"
+#include "heap_profiler.h"
+
+/*
+	Two-Level Segregated Fit allocator, for variable-sized blocks: names, shader sources,
+	  array buffers, texture bytes.
+
+	Memory comes in arenas taken from the backing allocator and is split into blocks, each
+	  with an 8-byte header.  Free blocks are kept in lists by size class: the first level is
+	  the size's highest bit, the second splits that range into `TLSF_SL_INDEX_COUNT` equal
+	  parts.  A bitmap per level tells which lists have blocks, so finding a block that fits
+	  takes two bit scans and freeing one merges it with its free neighbours in constant time,
+	  whatever the number of blocks.  A block is at most 1/32 of its size bigger than asked for.
+
+	`Allocate()` and arrays are aligned like `Linear_Allocator` aligns them (up to 16 bytes),
+	  `allocate_aligned()` takes any power of 2.  A reallocation grows into a free neighbour
+	  in place.  Arenas are added when no block fits, until they add up to `budget`; past it
+	  allocations fail.  Arenas go back only with `deinit()`.  Not thread-safe.
+	The allocator must not be copied or moved once initialized, it points to itself, see `null_block`.
+*/
+
+constexpr u32 TLSF_SL_INDEX_COUNT_LOG2 = 5;
+constexpr u32 TLSF_SL_INDEX_COUNT = 1 << TLSF_SL_INDEX_COUNT_LOG2;
+constexpr u32 TLSF_ALIGN_SIZE_LOG2 = 3;
+constexpr u64 TLSF_ALIGN_SIZE = 1 << TLSF_ALIGN_SIZE_LOG2;
+// Blocks are smaller than 2^TLSF_FL_INDEX_MAX bytes.
+constexpr u32 TLSF_FL_INDEX_MAX = 32;
+// Blocks smaller than `1 << TLSF_FL_INDEX_SHIFT` all go into the first level, in `TLSF_ALIGN_SIZE` steps.
+constexpr u32 TLSF_FL_INDEX_SHIFT = TLSF_SL_INDEX_COUNT_LOG2 + TLSF_ALIGN_SIZE_LOG2;
+constexpr u32 TLSF_FL_INDEX_COUNT = TLSF_FL_INDEX_MAX - TLSF_FL_INDEX_SHIFT + 1;
+constexpr u32 TLSF_MAX_ARENAS = 64;
+
+// The physically previous block's pointer lives in that block's last 8 bytes,
+//   it is valid only while that block is free.  The free list links only while this one is.
+struct TLSF_Block {
+	TLSF_Block *previous_physical;
+	u64 size;  // The bits below `TLSF_ALIGN_SIZE` are flags.
+	TLSF_Block *next_free;
+	TLSF_Block *previous_free;
+};
+
+struct TLSF_Stats {
+	u64 arenas_size;
+	u64 used_bytes;  // Of used blocks, headers included.
+	u64 free_bytes;
+	u64 largest_free_block;
+	u32 used_blocks_count;
+	u32 free_blocks_count;
+};
+
+struct TLSF_Allocator : Allocator {
+	Allocator *backing_allocator = NULL;
+	u64 arena_size = 0;  // Of the first arena.  Later ones are half of all taken so far, or fit the block that needs them.
+	u64 budget = 0;      // Arenas never add up to more, 0 - no limit.
+
+	u8 *arenas[ TLSF_MAX_ARENAS ];
+	u64 arena_sizes[ TLSF_MAX_ARENAS ];
+	u32 arenas_count = 0;
+	u64 arenas_size = 0;
+
+	u32 fl_bitmap = 0;
+	u32 sl_bitmaps[ TLSF_FL_INDEX_COUNT ];
+	TLSF_Block *free_lists[ TLSF_FL_INDEX_COUNT ][ TLSF_SL_INDEX_COUNT ];
+	// Empty free lists point here instead of NULL, which spares the list code its branches.
+	TLSF_Block null_block;
+
+	u8 *do_allocate( u64 count, u64 size, CallerInfo caller );
+	u8 *do_reallocate( void *memory_pointer, u64 old_count, u64 new_count, u64 size, CallerInfo caller );
+	void do_deallocate( void *memory_pointer, CallerInfo caller );
+
+	void init( Allocator *backing_allocator, u64 arena_size, u64 budget );
+	void deinit();
+
+	// Returns NULL if it does not fit into the budget, unlike `Allocate()`, which asserts.
+	u8 *allocate_aligned( u64 size, u64 alignment );
+
+	// Walks every block of every arena.
+	TLSF_Stats stats();
+};
+
+struct TLSF_Latency {
+	u64 percentile_50_ns;
+	u64 percentile_90_ns;
+	u64 percentile_99_ns;
+	u64 percentile_999_ns;
+	u64 max_ns;
+	f64 total_milliseconds;
+};
+
+struct TLSF_Benchmark {
+	u32 events_count;      // Replayed, those on blocks allocated before the trace began are left out.
+	u64 peak_live_bytes;   // Most bytes asked for and not yet freed at once.
+	u32 peak_live_blocks;  // At that moment.
+
+	TLSF_Latency system;
+	TLSF_Latency tlsf;
+
+	// Bytes the blocks really took at the peak, per byte asked for: 1 + the internal fragmentation.
+	f64 system_block_overhead;
+	f64 tlsf_block_overhead;
+	// Of the TLSF arenas at the peak, `1 - largest free block / free bytes`.
+	f64 tlsf_external_fragmentation;
+	u64 tlsf_arenas_size;
+};
+
+// Replays the trace on `System_Allocator` and on a `TLSF_Allocator`, timing every operation.
+TLSF_Benchmark tlsf_allocator_benchmark( ArrayView< Heap_Trace_Event > events );
+
+#endif /* QLIGHT_TLSF_ALLOCATOR_H */